@@ -43,6 +43,9 @@ class TimestampIndexTest(BitcoinTestFramework):
         hashes = self.nodes[1].getblockhashes(high, low)
         assert_equal(len(hashes), 5)
         assert_equal(sorted(blockhashes), sorted(hashes))
+        self.log.info("Checking the active chain without the index...")
+        assert_equal(self.nodes[2].getblockhashes(high, low), hashes)
+        assert_equal(self.nodes[2].getblockhashes(low - 1, 0), [])
         self.log.info("Passed")
 
 
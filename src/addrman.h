@@ -13,8 +13,10 @@
 #include "timedata.h"
 #include "util.h"
 
+#include <atomic>
 #include <map>
 #include <set>
+#include <shared_mutex>
 #include <stdint.h>
 #include <vector>
 
@@ -133,6 +135,10 @@ public:
  *      be observable by adversaries.
  *    * Several indexes are kept for high performance. Defining DEBUG_ADDRMAN will introduce frequent (and expensive)
  *      consistency checks for the entire data structure.
+ *    * The occupied positions of both tables are also kept in a dense list, so selection picks a random entry in
+ *      constant time, no matter how sparse the tables are.
+ *  * Lookups (Select, GetAddressInfo, size, serialization) only take the lock shared, so connection threads don't
+ *    wait for each other or for a peers.dat dump.
  */
 
 //! total number of buckets for tried addresses
@@ -177,8 +183,14 @@ public:
 class CAddrMan
 {
 private:
-    //! critical section to protect the inner data structures
-    mutable CCriticalSection cs;
+    typedef std::unique_lock<std::shared_timed_mutex> WriteLock;
+    typedef std::shared_lock<std::shared_timed_mutex> ReadLock;
+
+    //! protects the inner data structures, lookups which don't modify them only take it shared
+    mutable std::shared_timed_mutex cs;
+
+    //! number of calls which may have modified the tables, see GetModificationCount()
+    std::atomic<uint64_t> nModifications{0};
 
     //! last used nId
     int nIdCount;
@@ -204,6 +216,14 @@ private:
     //! list of "new" buckets
     int vvNew[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE];
 
+    //! occupied positions in vvTried and vvNew, as bucket * ADDRMAN_BUCKET_SIZE + position, in no particular order
+    std::vector<int> vTriedSlots;
+    std::vector<int> vNewSlots;
+
+    //! index in vTriedSlots/vNewSlots of every position of vvTried/vvNew, -1 if the position is empty
+    std::vector<int> vTriedSlotIndex;
+    std::vector<int> vNewSlotIndex;
+
     //! last time Good was called (memory only)
     int64_t nLastGood;
 
@@ -227,9 +247,16 @@ protected:
     //! Swap two elements in vRandom.
     void SwapRandom(unsigned int nRandomPos1, unsigned int nRandomPos2);
 
+    //! Store nId (or -1 to clear it) at a position of the "new" or "tried" table, keeping the slot lists up to date.
+    void SetNew(int nUBucket, int nUBucketPos, int nId);
+    void SetTried(int nKBucket, int nKBucketPos, int nId);
+
     //! Move an entry from the "new" table(s) to the "tried" table
     void MakeTried(CAddrInfo& info, int nId);
 
+    //! Reset both tables and pick a new key.
+    void Clear_();
+
     //! Delete an entry. It must not be in tried, and have refcount 0.
     void Delete(int nId);
 
@@ -246,6 +273,7 @@ protected:
     void Attempt_(const CService &addr, bool fCountFailure, int64_t nTime);
 
     //! Select an address to connect to, if newOnly is set to true, only the new table is selected from.
+    //! Only reads the tables, so it may run under a shared lock.
     CAddrInfo Select_(bool newOnly);
 
     //! Wraps GetRandInt to allow tests to override RandomInt and make it determinismistic.
@@ -256,6 +284,16 @@ protected:
     int Check_();
 #endif
 
+    //! Run Check_() and log a failure, requires cs to be held exclusively.
+    void CheckConsistency()
+    {
+#ifdef DEBUG_ADDRMAN
+        int err;
+        if ((err=Check_()))
+            LogPrintf("ADDRMAN CONSISTENCY CHECK FAILED!!! err=%i\n", err);
+#endif
+    }
+
     //! Select several addresses at once.
     void GetAddr_(std::vector<CAddress> &vAddr);
 
@@ -265,7 +303,7 @@ protected:
     //! Update an entry's service bits.
     void SetServices_(const CService &addr, ServiceFlags nServices);
 
-    //! Get address info for address
+    //! Get address info for address. Only reads the tables, so it may run under a shared lock.
     CAddrInfo GetAddressInfo_(const CService& addr);
 
 public:
@@ -301,7 +339,7 @@ public:
     template<typename Stream>
     void Serialize(Stream &s) const
     {
-        LOCK(cs);
+        ReadLock lock(cs);
 
         unsigned char nVersion = 1;
         s << nVersion;
@@ -351,9 +389,9 @@ public:
     template<typename Stream>
     void Unserialize(Stream& s)
     {
-        LOCK(cs);
+        WriteLock lock(cs);
 
-        Clear();
+        Clear_();
 
         unsigned char nVersion;
         s >> nVersion;
@@ -390,7 +428,7 @@ public:
                 int nUBucket = info.GetNewBucket(nKey);
                 int nUBucketPos = info.GetBucketPosition(nKey, true, nUBucket);
                 if (vvNew[nUBucket][nUBucketPos] == -1) {
-                    vvNew[nUBucket][nUBucketPos] = n;
+                    SetNew(nUBucket, nUBucketPos, n);
                     info.nRefCount++;
                 }
             }
@@ -410,7 +448,7 @@ public:
                 vRandom.push_back(nIdCount);
                 mapInfo[nIdCount] = info;
                 mapAddr[info] = nIdCount;
-                vvTried[nKBucket][nKBucketPos] = nIdCount;
+                SetTried(nKBucket, nKBucketPos, nIdCount);
                 nIdCount++;
             } else {
                 nLost++;
@@ -430,7 +468,7 @@ public:
                     int nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
                     if (nVersion == 1 && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && vvNew[bucket][nUBucketPos] == -1 && info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS) {
                         info.nRefCount++;
-                        vvNew[bucket][nUBucketPos] = nIndex;
+                        SetNew(bucket, nUBucketPos, nIndex);
                     }
                 }
             }
@@ -451,34 +489,19 @@ public:
             LogPrint("addrman", "addrman lost %i new and %i tried addresses due to collisions\n", nLostUnk, nLost);
         }
 
-        Check();
+        CheckConsistency();
     }
 
     void Clear()
     {
-        std::vector<int>().swap(vRandom);
-        nKey = GetRandHash();
-        for (size_t bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
-            for (size_t entry = 0; entry < ADDRMAN_BUCKET_SIZE; entry++) {
-                vvNew[bucket][entry] = -1;
-            }
-        }
-        for (size_t bucket = 0; bucket < ADDRMAN_TRIED_BUCKET_COUNT; bucket++) {
-            for (size_t entry = 0; entry < ADDRMAN_BUCKET_SIZE; entry++) {
-                vvTried[bucket][entry] = -1;
-            }
-        }
-
-        nIdCount = 0;
-        nTried = 0;
-        nNew = 0;
-        nLastGood = 1; //Initially at 1 so that "never" is strictly worse.
+        WriteLock lock(cs);
+        Clear_();
     }
 
     CAddrMan(bool _discriminatePorts = false) :
         discriminatePorts(_discriminatePorts)
     {
-        Clear();
+        Clear_();
     }
 
     ~CAddrMan()
@@ -489,31 +512,37 @@ public:
     //! Return the number of (unique) addresses in all tables.
     size_t size() const
     {
-        LOCK(cs); // TODO: Cache this in an atomic to avoid this overhead
+        ReadLock lock(cs);
         return vRandom.size();
     }
 
+    /**
+     * Changes whenever the tables may have been modified. Lets a dump of peers.dat be skipped when nothing
+     * happened since the last one.
+     */
+    uint64_t GetModificationCount() const
+    {
+        return nModifications;
+    }
+
     //! Consistency check
     void Check()
     {
 #ifdef DEBUG_ADDRMAN
-        {
-            LOCK(cs);
-            int err;
-            if ((err=Check_()))
-                LogPrintf("ADDRMAN CONSISTENCY CHECK FAILED!!! err=%i\n", err);
-        }
+        WriteLock lock(cs);
+        CheckConsistency();
 #endif
     }
 
     //! Add a single address.
     bool Add(const CAddress &addr, const CNetAddr& source, int64_t nTimePenalty = 0)
     {
-        LOCK(cs);
+        WriteLock lock(cs);
         bool fRet = false;
-        Check();
+        CheckConsistency();
         fRet |= Add_(addr, source, nTimePenalty);
-        Check();
+        CheckConsistency();
+        nModifications++;
         if (fRet)
             LogPrint("addrman", "Added %s from %s: %i tried, %i new\n", addr.ToStringIPPort(), source.ToString(), nTried, nNew);
         return fRet;
@@ -522,12 +551,13 @@ public:
     //! Add multiple addresses.
     bool Add(const std::vector<CAddress> &vAddr, const CNetAddr& source, int64_t nTimePenalty = 0)
     {
-        LOCK(cs);
+        WriteLock lock(cs);
         int nAdd = 0;
-        Check();
+        CheckConsistency();
         for (std::vector<CAddress>::const_iterator it = vAddr.begin(); it != vAddr.end(); it++)
             nAdd += Add_(*it, source, nTimePenalty) ? 1 : 0;
-        Check();
+        CheckConsistency();
+        nModifications++;
         if (nAdd)
             LogPrint("addrman", "Added %i addresses from %s: %i tried, %i new\n", nAdd, source.ToString(), nTried, nNew);
         return nAdd > 0;
@@ -536,19 +566,21 @@ public:
     //! Mark an entry as accessible.
     void Good(const CService &addr, int64_t nTime = GetAdjustedTime())
     {
-        LOCK(cs);
-        Check();
+        WriteLock lock(cs);
+        CheckConsistency();
         Good_(addr, nTime);
-        Check();
+        CheckConsistency();
+        nModifications++;
     }
 
     //! Mark an entry as connection attempted to.
     void Attempt(const CService &addr, bool fCountFailure, int64_t nTime = GetAdjustedTime())
     {
-        LOCK(cs);
-        Check();
+        WriteLock lock(cs);
+        CheckConsistency();
         Attempt_(addr, fCountFailure, nTime);
-        Check();
+        CheckConsistency();
+        nModifications++;
     }
 
     /**
@@ -556,56 +588,45 @@ public:
      */
     CAddrInfo Select(bool newOnly = false)
     {
-        CAddrInfo addrRet;
-        {
-            LOCK(cs);
-            Check();
-            addrRet = Select_(newOnly);
-            Check();
-        }
-        return addrRet;
+        ReadLock lock(cs);
+        return Select_(newOnly);
     }
 
     //! Return a bunch of addresses, selected at random.
     std::vector<CAddress> GetAddr()
     {
-        Check();
+        // Not a lookup: GetAddr_ shuffles vRandom
+        WriteLock lock(cs);
+        CheckConsistency();
         std::vector<CAddress> vAddr;
-        {
-            LOCK(cs);
-            GetAddr_(vAddr);
-        }
-        Check();
+        GetAddr_(vAddr);
+        CheckConsistency();
         return vAddr;
     }
 
     //! Mark an entry as currently-connected-to.
     void Connected(const CService &addr, int64_t nTime = GetAdjustedTime())
     {
-        LOCK(cs);
-        Check();
+        WriteLock lock(cs);
+        CheckConsistency();
         Connected_(addr, nTime);
-        Check();
+        CheckConsistency();
+        nModifications++;
     }
 
     void SetServices(const CService &addr, ServiceFlags nServices)
     {
-        LOCK(cs);
-        Check();
+        WriteLock lock(cs);
+        CheckConsistency();
         SetServices_(addr, nServices);
-        Check();
+        CheckConsistency();
+        nModifications++;
     }
 
     CAddrInfo GetAddressInfo(const CService& addr)
     {
-        CAddrInfo addrRet;
-        {
-            LOCK(cs);
-            Check();
-            addrRet = GetAddressInfo_(addr);
-            Check();
-        }
-        return addrRet;
+        ReadLock lock(cs);
+        return GetAddressInfo_(addr);
     }
 
 };
@@ -1,5 +1,8 @@
 // barrystyle 29092019
-#include "validation.h"
+#include "banned.h"
+
+#include <algorithm>
+#include <bitset>
 
 typedef std::map<uint256, int> BannedInputs;
 
@@ -392,9 +395,63 @@ const BannedInputs bannedFunds =
     }
 };
 
-bool areBannedInputs(uint256 txid, int vout) {
-  for (auto inputs : bannedFunds)
-    if (inputs.first == txid && inputs.second == vout)
-      return true;
-  return false;
+namespace {
+
+/**
+ * bannedFunds as a table sorted by the first 64 bits of the txid, with a bitset over some of
+ * those bits in front of it. Nearly every input misses the bitset and costs a single bit test,
+ * the rest a binary search over the sorted fingerprints.
+ */
+class CBannedInputsFilter
+{
+private:
+    static const size_t FILTER_BITS = 1 << 14;
+
+    struct Entry {
+        uint64_t nFingerprint;
+        uint256 txid;
+        int vout;
+    };
+
+    std::bitset<FILTER_BITS> filter;
+    std::vector<Entry> vecEntries;
+
+public:
+    explicit CBannedInputsFilter(const BannedInputs& banned)
+    {
+        vecEntries.reserve(banned.size());
+        for (const auto& p : banned) {
+            uint64_t nFingerprint = p.first.GetCheapHash();
+            filter.set(nFingerprint % FILTER_BITS);
+            vecEntries.push_back(Entry{nFingerprint, p.first, p.second});
+        }
+        std::sort(vecEntries.begin(), vecEntries.end(), [](const Entry& a, const Entry& b) {
+            return a.nFingerprint < b.nFingerprint;
+        });
+    }
+
+    bool Contains(const uint256& txid, int vout) const
+    {
+        uint64_t nFingerprint = txid.GetCheapHash();
+        if (!filter.test(nFingerprint % FILTER_BITS)) {
+            return false;
+        }
+        auto it = std::lower_bound(vecEntries.begin(), vecEntries.end(), nFingerprint, [](const Entry& e, uint64_t n) {
+            return e.nFingerprint < n;
+        });
+        for (; it != vecEntries.end() && it->nFingerprint == nFingerprint; ++it) {
+            if (it->txid == txid && it->vout == vout) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+} // namespace
+
+bool areBannedInputs(const uint256& txid, int vout) {
+  // built on first use, bannedFunds is initialized at startup from the same translation unit
+  static const CBannedInputsFilter filter(bannedFunds);
+  return filter.Contains(txid, vout);
 }
@@ -1,3 +1,3 @@
 #include "validation.h"
 
-bool areBannedInputs(uint256 txid, int vout);
+bool areBannedInputs(const uint256& txid, int vout);
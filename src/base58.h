@@ -21,6 +21,7 @@
 #include "script/standard.h"
 #include "support/allocators/zeroafterfree.h"
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -95,6 +96,29 @@ public:
     bool operator> (const CBase58Data& b58) const { return CompareTo(b58) >  0; }
 };
 
+/**
+ * Remembers the addresses CBitcoinAddress::ToString encodes on this thread while alive, for
+ * the RPCs which print the same addresses over and over, like getblock with verbosity 2 or
+ * listunspent. The RPC server keeps one for every request. A memo created while another one
+ * is alive on the same thread does nothing. At most MAX_ENTRIES addresses are kept.
+ */
+class CAddressMemo
+{
+    friend class CBitcoinAddress;
+
+    bool fActive;
+    std::map<std::vector<unsigned char>, std::string> mapAddresses;
+
+public:
+    static const size_t MAX_ENTRIES = 10000;
+
+    CAddressMemo();
+    ~CAddressMemo();
+
+    CAddressMemo(const CAddressMemo&) = delete;
+    CAddressMemo& operator=(const CAddressMemo&) = delete;
+};
+
 /** base58-encoded EPMCoin addresses.
  * Public-key-hash-addresses have version 76 (or 140 testnet).
  * The data vector contains RIPEMD160(SHA256(pubkey)), where pubkey is the serialized public key.
@@ -114,6 +138,9 @@ public:
     CBitcoinAddress(const std::string& strAddress) { SetString(strAddress); }
     CBitcoinAddress(const char* pszAddress) { SetString(pszAddress); }
 
+    //! Uses the CAddressMemo of the thread if there is one
+    std::string ToString() const;
+
     CTxDestination Get() const;
     bool GetKeyID(CKeyID &keyID) const;
     bool GetIndexKey(uint160& hashBytes, int& type) const;
@@ -6,6 +6,7 @@
 
 #include "validation.h"
 #include "base58.h"
+#include "utilstrencodings.h"
 
 #include <vector>
 #include <string>
@@ -51,6 +52,42 @@ static void Base58Decode(benchmark::State& state)
 }
 
 
+static void Base58AddressEncode(benchmark::State& state)
+{
+    CBitcoinAddress addr(CKeyID(uint160(ParseHex("114f086396bdd0a21617cba3243a93e38b02d764"))));
+    while (state.KeepRunning()) {
+        addr.ToString();
+    }
+}
+
+
+// What an RPC printing many outputs to the same few addresses pays per address
+static void Base58AddressEncodeMemo(benchmark::State& state)
+{
+    CAddressMemo memo;
+    CBitcoinAddress addr(CKeyID(uint160(ParseHex("114f086396bdd0a21617cba3243a93e38b02d764"))));
+    while (state.KeepRunning()) {
+        addr.ToString();
+    }
+}
+
+
+static void HexStrScript(benchmark::State& state)
+{
+    // about the size of a P2PKH scriptSig
+    std::vector<unsigned char> vch(107);
+    for (size_t i = 0; i < vch.size(); i++) {
+        vch[i] = (unsigned char)(i * 37);
+    }
+    while (state.KeepRunning()) {
+        HexStr(vch);
+    }
+}
+
+
 BENCHMARK(Base58Encode);
 BENCHMARK(Base58CheckEncode);
 BENCHMARK(Base58Decode);
+BENCHMARK(Base58AddressEncode);
+BENCHMARK(Base58AddressEncodeMemo);
+BENCHMARK(HexStrScript);
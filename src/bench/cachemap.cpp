@@ -0,0 +1,96 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "cachemap.h"
+#include "cachemultimap.h"
+#include "saltedhasher.h"
+#include "uint256.h"
+
+#include <list>
+#include <map>
+
+// The governance vote caches under a vote flood: a full cache where every accepted vote
+// evicts the oldest one, and most lookups are for votes which are already known.
+
+static const uint32_t CACHE_SIZE = 100000;
+
+/** The std::list + std::map layout CacheMap used before, for comparison */
+class LegacyCacheMap
+{
+    typedef std::list<CacheItem<uint256, uint32_t>> list_t;
+    uint32_t nMaxSize;
+    list_t listItems;
+    std::map<uint256, list_t::iterator> mapIndex;
+
+public:
+    explicit LegacyCacheMap(uint32_t nMaxSizeIn) : nMaxSize(nMaxSizeIn) {}
+
+    bool Insert(const uint256& key, uint32_t value)
+    {
+        if (mapIndex.count(key)) {
+            return false;
+        }
+        if (listItems.size() == nMaxSize) {
+            mapIndex.erase(listItems.back().key);
+            listItems.pop_back();
+        }
+        listItems.emplace_front(key, value);
+        mapIndex.emplace(key, listItems.begin());
+        return true;
+    }
+
+    bool HasKey(const uint256& key) const { return mapIndex.count(key) != 0; }
+};
+
+static std::vector<uint256> MakeKeys(size_t nCount)
+{
+    std::vector<uint256> vecKeys(nCount);
+    for (size_t i = 0; i < nCount; i++) {
+        vecKeys[i] = ::SerializeHash((uint64_t)i);
+    }
+    return vecKeys;
+}
+
+template<typename Cache>
+static void CacheChurn(benchmark::State& state, Cache& cache)
+{
+    static const std::vector<uint256> vecKeys = MakeKeys(2 * CACHE_SIZE);
+    for (uint32_t i = 0; i < CACHE_SIZE; i++) {
+        cache.Insert(vecKeys[i], i);
+    }
+    uint32_t n = CACHE_SIZE;
+    uint64_t nFound = 0;
+    while (state.KeepRunning()) {
+        const uint256& key = vecKeys[n % vecKeys.size()];
+        for (uint32_t j = 1; j <= 4; j++) {
+            nFound += cache.HasKey(vecKeys[(n - j * 7919) % vecKeys.size()]);
+        }
+        cache.Insert(key, n);
+        n++;
+    }
+    assert(nFound > 0);
+}
+
+static void CacheMapChurn(benchmark::State& state)
+{
+    CacheMap<uint256, uint32_t, StaticSaltedHasher> cache(CACHE_SIZE);
+    CacheChurn(state, cache);
+}
+
+static void CacheMapChurnLegacy(benchmark::State& state)
+{
+    LegacyCacheMap cache(CACHE_SIZE);
+    CacheChurn(state, cache);
+}
+
+static void CacheMultiMapChurn(benchmark::State& state)
+{
+    CacheMultiMap<uint256, uint32_t, StaticSaltedHasher> cache(CACHE_SIZE);
+    CacheChurn(state, cache);
+}
+
+BENCHMARK(CacheMapChurn);
+BENCHMARK(CacheMapChurnLegacy);
+BENCHMARK(CacheMultiMapChurn);
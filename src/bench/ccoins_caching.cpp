@@ -5,6 +5,7 @@
 #include "bench.h"
 #include "coins.h"
 #include "policy/policy.h"
+#include "random.h"
 #include "wallet/crypter.h"
 
 #include <vector>
@@ -84,4 +85,28 @@ static void CCoinsCaching(benchmark::State& state)
     }
 }
 
+// Fill a cache with fresh coins and flush it into its parent, like connecting a block does
+static void CCoinsCacheFillFlush(benchmark::State& state)
+{
+    CCoinsView coinsDummy;
+    CCoinsViewCache base(&coinsDummy);
+    std::vector<uint256> vHashes(10000);
+    for (uint256& hash : vHashes) {
+        hash = GetRandHash();
+    }
+    Coin coin(CTxOut(COIN, CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 1) << OP_EQUALVERIFY << OP_CHECKSIG), 1, false, false);
+
+    while (state.KeepRunning()) {
+        CCoinsViewCache view(&base);
+        for (const uint256& hash : vHashes) {
+            view.AddCoin(COutPoint(hash, 0), Coin(coin), true);
+        }
+        view.Flush();
+        for (const uint256& hash : vHashes) {
+            base.SpendCoin(COutPoint(hash, 0));
+        }
+    }
+}
+
 BENCHMARK(CCoinsCaching);
+BENCHMARK(CCoinsCacheFillFlush);
@@ -20,7 +20,16 @@ static const size_t BATCHES = 101;
 static const size_t BATCH_SIZE = 30;
 static const int PREVECTOR_SIZE = 28;
 static const int QUEUE_BATCH_SIZE = 128;
-static void CCheckQueueSpeed(benchmark::State& state)
+// A small block, too few checks for a shared queue to keep all threads busy
+static const size_t SMALL_BATCHES = 4;
+
+// Number of work queues for a given mode, one per thread including the master
+static unsigned int WorkQueues(bool fWorkStealing)
+{
+    return fWorkStealing ? std::max(MIN_CORES, GetNumCores()) + 1 : 0;
+}
+
+static void CheckQueueNoWork(benchmark::State& state, bool fWorkStealing, size_t nBatches)
 {
     struct FakeJobNoWork {
         bool operator()()
@@ -29,7 +38,7 @@ static void CCheckQueueSpeed(benchmark::State& state)
         }
         void swap(FakeJobNoWork& x){};
     };
-    CCheckQueue<FakeJobNoWork> queue {QUEUE_BATCH_SIZE};
+    CCheckQueue<FakeJobNoWork> queue(QUEUE_BATCH_SIZE, WorkQueues(fWorkStealing));
     boost::thread_group tg;
     for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()); ++x) {
        tg.create_thread([&]{queue.Thread();});
@@ -40,7 +49,7 @@ static void CCheckQueueSpeed(benchmark::State& state)
         // We call Add a number of times to simulate the behavior of adding
         // a block of transactions at once.
 
-        std::vector<std::vector<FakeJobNoWork>> vBatches(BATCHES);
+        std::vector<std::vector<FakeJobNoWork>> vBatches(nBatches);
         for (auto& vChecks : vBatches) {
             vChecks.resize(BATCH_SIZE);
         }
@@ -61,7 +70,7 @@ static void CCheckQueueSpeed(benchmark::State& state)
 // This Benchmark tests the CheckQueue with a slightly realistic workload,
 // where checks all contain a prevector that is indirect 50% of the time
 // and there is a little bit of work done between calls to Add.
-static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
+static void CheckQueuePrevectorJob(benchmark::State& state, bool fWorkStealing)
 {
     struct PrevectorJob {
         prevector<PREVECTOR_SIZE, uint8_t> p;
@@ -76,7 +85,7 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
         }
         void swap(PrevectorJob& x){p.swap(x.p);};
     };
-    CCheckQueue<PrevectorJob> queue {QUEUE_BATCH_SIZE};
+    CCheckQueue<PrevectorJob> queue(QUEUE_BATCH_SIZE, WorkQueues(fWorkStealing));
     boost::thread_group tg;
     for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()); ++x) {
        tg.create_thread([&]{queue.Thread();});
@@ -99,5 +108,17 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.interrupt_all();
     tg.join_all();
 }
+
+static void CCheckQueueSpeed(benchmark::State& state) { CheckQueueNoWork(state, false, BATCHES); }
+static void CCheckQueueSpeedWorkStealing(benchmark::State& state) { CheckQueueNoWork(state, true, BATCHES); }
+static void CCheckQueueSpeedSmallBlock(benchmark::State& state) { CheckQueueNoWork(state, false, SMALL_BATCHES); }
+static void CCheckQueueSpeedSmallBlockWorkStealing(benchmark::State& state) { CheckQueueNoWork(state, true, SMALL_BATCHES); }
+static void CCheckQueueSpeedPrevectorJob(benchmark::State& state) { CheckQueuePrevectorJob(state, false); }
+static void CCheckQueueSpeedPrevectorJobWorkStealing(benchmark::State& state) { CheckQueuePrevectorJob(state, true); }
+
 BENCHMARK(CCheckQueueSpeed);
+BENCHMARK(CCheckQueueSpeedWorkStealing);
+BENCHMARK(CCheckQueueSpeedSmallBlock);
+BENCHMARK(CCheckQueueSpeedSmallBlockWorkStealing);
 BENCHMARK(CCheckQueueSpeedPrevectorJob);
+BENCHMARK(CCheckQueueSpeedPrevectorJobWorkStealing);
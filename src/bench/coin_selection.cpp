@@ -57,4 +57,31 @@ static void CoinSelection(benchmark::State& state)
     }
 }
 
+// A large hot wallet, with many coins of varying value
+static void CoinSelectionLarge(benchmark::State& state, CAmount nTargetValue)
+{
+    const CWallet wallet;
+    std::vector<COutput> vCoins;
+    LOCK(wallet.cs_wallet);
+
+    for (int i = 0; i < 100000; i++)
+        addCoin((i * 7919 % 10000 + 1) * CENT, wallet, vCoins);
+
+    while (state.KeepRunning()) {
+        std::set<std::pair<const CWalletTx*, unsigned int> > setCoinsRet;
+        CAmount nValueRet;
+        bool success = wallet.SelectCoinsMinConf(nTargetValue, 1, 6, 0, vCoins, setCoinsRet, nValueRet);
+        assert(success);
+        assert(nValueRet >= nTargetValue);
+    }
+
+    BOOST_FOREACH (COutput output, vCoins)
+        delete output.tx;
+}
+
+static void CoinSelectionLargeExact(benchmark::State& state) { CoinSelectionLarge(state, 1234 * COIN + 56 * CENT); }
+static void CoinSelectionLargeChange(benchmark::State& state) { CoinSelectionLarge(state, 1234 * COIN + 56 * CENT + 1); }
+
 BENCHMARK(CoinSelection);
+BENCHMARK(CoinSelectionLargeExact);
+BENCHMARK(CoinSelectionLargeChange);
@@ -7,6 +7,12 @@
 #include "bench.h"
 
 #include "key.h"
+#include "keystore.h"
+#include "policy/policy.h"
+#include "primitives/transaction.h"
+#include "script/interpreter.h"
+#include "script/sign.h"
+#include "script/standard.h"
 
 static void ECDSASign(benchmark::State& state)
 {
@@ -74,6 +80,43 @@ static void ECDSAVerify_LargeBlock(benchmark::State& state)
     }
 }
 
+// The whole per input script check of a transaction spending 100 P2PKH outputs of 10 keys, like a
+// payout consolidation. Besides the signature check this includes parsing the key and signature.
+static void ECDSAVerify_P2PKHScripts(benchmark::State& state)
+{
+    CBasicKeyStore keystore;
+    std::vector<CScript> scriptPubKeys;
+    for (size_t i = 0; i < 10; i++) {
+        CKey k;
+        k.MakeNewKey(true);
+        keystore.AddKey(k);
+        scriptPubKeys.emplace_back(GetScriptForDestination(k.GetPubKey().GetID()));
+    }
+
+    CMutableTransaction mtx;
+    mtx.vin.resize(100);
+    for (size_t i = 0; i < mtx.vin.size(); i++) {
+        mtx.vin[i].prevout = COutPoint(::SerializeHash((int)i), 0);
+    }
+    mtx.vout.resize(1);
+    mtx.vout[0].scriptPubKey = scriptPubKeys[0];
+    mtx.vout[0].nValue = 1;
+    for (size_t i = 0; i < mtx.vin.size(); i++) {
+        SignSignature(keystore, scriptPubKeys[i % scriptPubKeys.size()], mtx, i);
+    }
+    const CTransaction tx(mtx);
+    PrecomputedTransactionData txdata(tx);
+
+    // Benchmark.
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < tx.vin.size(); i++) {
+            bool ret = VerifyScript(tx.vin[i].scriptSig, scriptPubKeys[i % scriptPubKeys.size()], STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, i, &txdata));
+            assert(ret);
+        }
+    }
+}
+
 BENCHMARK(ECDSASign)
 BENCHMARK(ECDSAVerify)
 BENCHMARK(ECDSAVerify_LargeBlock)
+BENCHMARK(ECDSAVerify_P2PKHScripts)
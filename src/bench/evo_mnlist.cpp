@@ -0,0 +1,87 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "random.h"
+
+#include "evo/deterministicmns.h"
+
+static CDeterministicMNList BuildMNList(size_t nCount)
+{
+    CDeterministicMNList mnList(GetRandHash(), 100000, nCount);
+    for (size_t i = 0; i < nCount; i++) {
+        auto dmn = std::make_shared<CDeterministicMN>();
+        dmn->proTxHash = GetRandHash();
+        dmn->internalId = i;
+        dmn->collateralOutpoint = COutPoint(GetRandHash(), 0);
+        dmn->nOperatorReward = 0;
+
+        auto state = std::make_shared<CDeterministicMNState>();
+        state->nRegisteredHeight = GetRandInt(100000);
+        state->nLastPaidHeight = GetRandInt(2) ? GetRandInt(100000) : 0;
+        uint256 keyHash = GetRandHash();
+        state->keyIDOwner = CKeyID(uint160(std::vector<unsigned char>(keyHash.begin(), keyHash.begin() + 20)));
+        state->UpdateConfirmedHash(dmn->proTxHash, GetRandHash());
+        dmn->pdmnState = state;
+
+        mnList.AddMN(dmn);
+    }
+    return mnList;
+}
+
+// The old way of building a quorum, scoring into pairs and sorting all of them, for comparison
+static void CalculateQuorumFullSort(benchmark::State& state, size_t nMNs, size_t nQuorumSize)
+{
+    auto mnList = BuildMNList(nMNs);
+    uint256 modifier = GetRandHash();
+
+    while (state.KeepRunning()) {
+        auto scores = mnList.CalculateScores(modifier);
+        std::sort(scores.rbegin(), scores.rend(), [](const std::pair<arith_uint256, CDeterministicMNCPtr>& a, const std::pair<arith_uint256, CDeterministicMNCPtr>& b) {
+            if (a.first == b.first) {
+                return a.second->collateralOutpoint < b.second->collateralOutpoint;
+            }
+            return a.first < b.first;
+        });
+        std::vector<CDeterministicMNCPtr> result;
+        result.resize(std::min(nQuorumSize, scores.size()));
+        for (size_t i = 0; i < result.size(); i++) {
+            result[i] = std::move(scores[i].second);
+        }
+        assert(result.size() == nQuorumSize);
+    }
+}
+
+static void CalculateQuorum(benchmark::State& state, size_t nMNs, size_t nQuorumSize)
+{
+    auto mnList = BuildMNList(nMNs);
+    uint256 modifier = GetRandHash();
+
+    while (state.KeepRunning()) {
+        auto result = mnList.CalculateQuorum(nQuorumSize, modifier);
+        assert(result.size() == nQuorumSize);
+    }
+}
+
+static void GetProjectedMNPayees(benchmark::State& state, size_t nMNs, int nCount)
+{
+    auto mnList = BuildMNList(nMNs);
+
+    while (state.KeepRunning()) {
+        auto result = mnList.GetProjectedMNPayees(nCount);
+        assert((int)result.size() == nCount);
+    }
+}
+
+static void MNList_CalculateQuorumFullSort_5000_50(benchmark::State& state) { CalculateQuorumFullSort(state, 5000, 50); }
+static void MNList_CalculateQuorumFullSort_5000_400(benchmark::State& state) { CalculateQuorumFullSort(state, 5000, 400); }
+static void MNList_CalculateQuorum_5000_50(benchmark::State& state) { CalculateQuorum(state, 5000, 50); }
+static void MNList_CalculateQuorum_5000_400(benchmark::State& state) { CalculateQuorum(state, 5000, 400); }
+static void MNList_GetProjectedMNPayees_5000_20(benchmark::State& state) { GetProjectedMNPayees(state, 5000, 20); }
+
+BENCHMARK(MNList_CalculateQuorumFullSort_5000_50);
+BENCHMARK(MNList_CalculateQuorumFullSort_5000_400);
+BENCHMARK(MNList_CalculateQuorum_5000_50);
+BENCHMARK(MNList_CalculateQuorum_5000_400);
+BENCHMARK(MNList_GetProjectedMNPayees_5000_20);
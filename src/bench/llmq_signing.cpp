@@ -0,0 +1,229 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "random.h"
+#include "utiltime.h"
+#include "bls/bls_batchverifier.h"
+#include "bls/bls_worker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <list>
+
+// The path of a signing request through a node which isn't a member of the quorum, the one which limits how
+// many InstantSend locks the network can take: the sig shares of all members arrive (QBSIGSHARES), are batch
+// verified against the public key shares on the BLS workers (CSigSharesManager::ProcessPendingSigShares), the
+// signature is recovered once the threshold is reached (TryRecoverSig), and the recovered signature is verified
+// against the quorum public key and handed to the listeners (CSigningManager::ProcessPendingRecoveredSigs).
+// Creating the shares is the members' work and happens before the clock starts.
+//
+// Requests arrive at a fixed rate, 0 keeps a backlog of requests waiting instead. The summary printed after
+// the run tells the signatures per second which were recovered and the latency from the arrival of a request
+// until its recovered signature was processed. A backlog left at the end means the rate wasn't sustainable.
+
+// Same as in CSigSharesManager
+static const int64_t SIG_SHARES_VERIFY_BUDGET = 50 * 1000;
+static const size_t MIN_SIG_SHARES_PER_BATCH = 32;
+static const size_t MAX_SIG_SHARES_PER_BATCH = 2048;
+static const size_t SIG_SHARES_PER_VERIFY_CHUNK = 64;
+
+// Distinct messages to sign, requests cycle through them
+static const size_t SIGNING_MESSAGES = 32;
+// Requests kept waiting without a rate
+static const size_t SATURATED_BACKLOG = 64;
+
+struct SigningQuorum {
+    size_t nThreshold;
+    std::vector<CBLSId> ids;
+    std::vector<CBLSPublicKey> pubKeyShares;
+    CBLSPublicKey quorumPublicKey;
+    std::vector<uint256> msgHashes;
+    //! sigShares[msg][member]
+    std::vector<BLSSignatureVector> sigShares;
+
+    SigningQuorum(CBLSWorker& worker, size_t nMembers, size_t _nThreshold) : nThreshold(_nThreshold)
+    {
+        ids.resize(nMembers);
+        for (size_t i = 0; i < nMembers; i++) {
+            ids[i].SetInt(i + 1);
+        }
+        // a single contribution makes a quorum as good as a full DKG would
+        BLSVerificationVectorPtr vvec;
+        BLSSecretKeyVector skShares;
+        worker.GenerateContributions(nThreshold, ids, vvec, skShares);
+        quorumPublicKey = (*vvec)[0];
+        for (size_t i = 0; i < nMembers; i++) {
+            pubKeyShares.emplace_back(worker.BuildPubKeyShare(vvec, ids[i]));
+        }
+        for (size_t m = 0; m < SIGNING_MESSAGES; m++) {
+            msgHashes.emplace_back(GetRandHash());
+            sigShares.emplace_back();
+            for (size_t i = 0; i < nMembers; i++) {
+                sigShares.back().emplace_back(skShares[i].Sign(msgHashes.back()));
+            }
+        }
+    }
+};
+
+struct SigningRequest {
+    size_t nMsg;
+    int64_t nArrivalTime;
+    BLSSignatureVector sigShares;
+    BLSIdVector ids;
+    bool fRecovering{false};
+};
+
+static void LLMQSigning(benchmark::State& state, size_t nMembers, size_t nThreshold, double nRate)
+{
+    CBLSWorker worker;
+    worker.Start();
+    SigningQuorum quorum(worker, nMembers, nThreshold);
+
+    // the shares are queued like in the node states, one request after the other
+    std::list<SigningRequest> requests;
+    std::deque<std::pair<SigningRequest*, size_t>> pendingSigShares;
+    std::list<std::pair<SigningRequest*, std::future<CBLSSignature>>> pendingRecoveries;
+    size_t nSigSharesPerBatch = MIN_SIG_SHARES_PER_BATCH;
+
+    size_t nArrived = 0;
+    size_t nRecovered = 0;
+    uint64_t nListenerCalls = 0;
+    std::vector<int64_t> vLatencies;
+    int64_t nStartTime = GetTimeMicros();
+
+    auto arrive = [&](int64_t nNow) {
+        requests.emplace_back();
+        SigningRequest& request = requests.back();
+        request.nMsg = nArrived++ % SIGNING_MESSAGES;
+        request.nArrivalTime = nNow;
+        for (size_t i = 0; i < nMembers; i++) {
+            pendingSigShares.emplace_back(&request, i);
+        }
+    };
+
+    while (state.KeepRunning()) {
+        int64_t nNow = GetTimeMicros();
+        if (nRate > 0) {
+            size_t nDue = (size_t)((nNow - nStartTime) * nRate / 1000000);
+            while (nArrived < nDue) {
+                arrive(nNow);
+            }
+        } else {
+            while (requests.size() < SATURATED_BACKLOG) {
+                arrive(nNow);
+            }
+        }
+
+        // verify the next batch of sig shares
+        size_t nBatch = std::min(nSigSharesPerBatch, pendingSigShares.size());
+        if (nBatch != 0) {
+            CBLSBatchVerifier<size_t, std::pair<SigningRequest*, size_t>> batchVerifier(false, true);
+            std::vector<std::pair<SigningRequest*, size_t>> vBatch(pendingSigShares.begin(), pendingSigShares.begin() + nBatch);
+            pendingSigShares.erase(pendingSigShares.begin(), pendingSigShares.begin() + nBatch);
+            for (const auto& p : vBatch) {
+                // a request which is recovering already doesn't need more shares, the node skips those too
+                if (p.first->fRecovering) continue;
+                batchVerifier.PushMessage(p.second, p, quorum.msgHashes[p.first->nMsg], quorum.sigShares[p.first->nMsg][p.second], quorum.pubKeyShares[p.second]);
+            }
+            int64_t nVerifyStart = GetTimeMicros();
+            size_t nChunks = std::max<size_t>(1, nBatch / SIG_SHARES_PER_VERIFY_CHUNK);
+            batchVerifier.VerifyBisect(nChunks, [&](std::function<void()> job) {
+                return worker.AsyncRun(std::move(job));
+            });
+            int64_t nVerifyTime = GetTimeMicros() - nVerifyStart;
+            assert(batchVerifier.badMessages.empty());
+
+            int64_t nPerShare = std::max<int64_t>(1, nVerifyTime / (int64_t)nBatch);
+            size_t nTarget = (size_t)(SIG_SHARES_VERIFY_BUDGET / nPerShare);
+            if (nBatch >= nSigSharesPerBatch || nTarget < nSigSharesPerBatch) {
+                nSigSharesPerBatch = std::max(MIN_SIG_SHARES_PER_BATCH, std::min(MAX_SIG_SHARES_PER_BATCH, (nSigSharesPerBatch + nTarget) / 2));
+            }
+
+            for (const auto& p : vBatch) {
+                SigningRequest& request = *p.first;
+                if (request.fRecovering) continue;
+                request.sigShares.emplace_back(quorum.sigShares[request.nMsg][p.second]);
+                request.ids.emplace_back(quorum.ids[p.second]);
+                if (request.sigShares.size() == nThreshold) {
+                    request.fRecovering = true;
+                    pendingRecoveries.emplace_back(&request, worker.AsyncRecoverSig(request.sigShares, request.ids, quorum.quorumPublicKey, quorum.msgHashes[request.nMsg]));
+                }
+            }
+        }
+
+        // process the finished recoveries like recovered sigs which came in from other nodes
+        CBLSBatchVerifier<size_t, size_t> recSigVerifier(false, false);
+        std::vector<std::pair<SigningRequest*, CBLSSignature>> vRecovered;
+        for (auto it = pendingRecoveries.begin(); it != pendingRecoveries.end(); ) {
+            bool fWait = nBatch == 0 && it == pendingRecoveries.begin();
+            if (!fWait && it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                ++it;
+                continue;
+            }
+            CBLSSignature sig = it->second.get();
+            assert(sig.IsValid());
+            recSigVerifier.PushMessage(0, vRecovered.size(), quorum.msgHashes[it->first->nMsg], sig, quorum.quorumPublicKey);
+            vRecovered.emplace_back(it->first, sig);
+            it = pendingRecoveries.erase(it);
+        }
+        if (!vRecovered.empty()) {
+            recSigVerifier.Verify();
+            assert(recSigVerifier.badSources.empty());
+            int64_t nDone = GetTimeMicros();
+            for (const auto& p : vRecovered) {
+                // the listeners, InstantSend and ChainLocks, do little with a recovered sig
+                nListenerCalls += p.second.IsValid();
+                vLatencies.emplace_back(nDone - p.first->nArrivalTime);
+                requests.remove_if([&](const SigningRequest& r) { return &r == p.first; });
+                nRecovered++;
+            }
+        }
+    }
+
+    int64_t nElapsed = std::max<int64_t>(1, GetTimeMicros() - nStartTime);
+    std::sort(vLatencies.begin(), vLatencies.end());
+    auto percentile = [&](double q) -> double {
+        if (vLatencies.empty()) return 0;
+        return vLatencies[std::min(vLatencies.size() - 1, (size_t)(vLatencies.size() * q))] * 0.001;
+    };
+    std::cout << "#LLMQSigning members=" << nMembers << " threshold=" << nThreshold << " rate=" << nRate
+              << " sigs/s=" << nRecovered * 1000000.0 / nElapsed
+              << " latency_ms p50=" << percentile(0.5) << " p90=" << percentile(0.9) << " p99=" << percentile(0.99)
+              << " backlog=" << (nRate > 0 ? requests.size() : 0) << std::endl;
+    assert(nListenerCalls == nRecovered);
+
+    // let the workers finish what's still queued
+    for (auto& p : pendingRecoveries) {
+        p.second.wait();
+    }
+    worker.Stop();
+}
+
+static void LLMQSigning_50_60_Saturated(benchmark::State& state)
+{
+    LLMQSigning(state, 50, 30, 0);
+}
+
+static void LLMQSigning_50_60_100PerSec(benchmark::State& state)
+{
+    LLMQSigning(state, 50, 30, 100);
+}
+
+static void LLMQSigning_50_60_400PerSec(benchmark::State& state)
+{
+    LLMQSigning(state, 50, 30, 400);
+}
+
+static void LLMQSigning_400_60_Saturated(benchmark::State& state)
+{
+    LLMQSigning(state, 400, 240, 0);
+}
+
+BENCHMARK(LLMQSigning_50_60_Saturated);
+BENCHMARK(LLMQSigning_50_60_100PerSec);
+BENCHMARK(LLMQSigning_50_60_400PerSec);
+BENCHMARK(LLMQSigning_400_60_Saturated);
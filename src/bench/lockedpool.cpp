@@ -7,6 +7,7 @@
 #include "support/lockedpool.h"
 
 #include <iostream>
+#include <thread>
 #include <vector>
 
 #define ASIZE 2048
@@ -43,5 +44,28 @@ static void BenchLockedPool(benchmark::State& state)
     addr.clear();
 }
 
+// Threads making and dropping key sized secrets, like the BLS workers during a DKG
+static void BenchLockedPoolManagerThreads(benchmark::State& state)
+{
+    LockedPoolManager& pool = LockedPoolManager::Instance();
+    while (state.KeepRunning()) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&pool] {
+                void* held[8];
+                for (int x = 0; x < BITER; ++x) {
+                    for (size_t i = 0; i < 8; i++)
+                        held[i] = pool.alloc(32 + 16 * (i & 1));
+                    for (size_t i = 0; i < 8; i++)
+                        pool.free(held[i], 32 + 16 * (i & 1));
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+    }
+}
+
 BENCHMARK(BenchLockedPool);
+BENCHMARK(BenchLockedPoolManagerThreads);
 
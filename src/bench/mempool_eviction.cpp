@@ -111,4 +111,42 @@ static void MempoolEviction(benchmark::State& state)
     }
 }
 
+// Eviction from a pool of many chains of dependent transactions, like a spam wave of
+// chained payments. Trimming removes whole chains and updates the ancestors they leave behind.
+static void MempoolEvictionChains(benchmark::State& state)
+{
+    const int nChains = 200;
+    const int nChainLength = 25;
+
+    std::vector<CTransaction> vtx;
+    std::vector<CAmount> vFees;
+    for (int c = 0; c < nChains; c++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(uint256(), c);
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vout.resize(2);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        tx.vout[1].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+        tx.vout[1].nValue = 10 * COIN;
+        for (int i = 0; i < nChainLength; i++) {
+            vtx.emplace_back(tx);
+            // spread the fee rates so chains and their tails get evicted in a mixed order
+            vFees.push_back(1000 + ((c * 7919 + i * 104729) % 10000));
+            tx.vin[0].prevout = COutPoint(vtx.back().GetHash(), 0);
+        }
+    }
+
+    while (state.KeepRunning()) {
+        CTxMemPool pool;
+        for (size_t i = 0; i < vtx.size(); i++) {
+            AddTx(vtx[i], vFees[i], pool);
+        }
+        pool.TrimToSize(pool.DynamicMemoryUsage() / 2);
+        pool.TrimToSize(0);
+    }
+}
+
 BENCHMARK(MempoolEviction);
+BENCHMARK(MempoolEvictionChains);
@@ -6,6 +6,8 @@
 
 #include "bench.h"
 #include "bloom.h"
+#include "primitives/transaction.h"
+#include "script/script.h"
 #include "utiltime.h"
 
 static void RollingBloom(benchmark::State& state)
@@ -40,4 +42,60 @@ static void RollingBloom(benchmark::State& state)
     }
 }
 
+// A 2-in 2-out P2PKH transaction relayed to peers with unrelated filters, as SPV wallets have them
+static const int RELAY_PEERS = 50;
+
+static CTransaction MakeRelayTx()
+{
+    CMutableTransaction tx;
+    tx.vin.resize(2);
+    tx.vout.resize(2);
+    for (int i = 0; i < 2; i++) {
+        tx.vin[i].prevout = COutPoint(uint256S(i == 0 ? "01" : "02"), i);
+        tx.vin[i].scriptSig << std::vector<unsigned char>(72, i + 1) << std::vector<unsigned char>(33, i + 2);
+        tx.vout[i].scriptPubKey << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, i + 3) << OP_EQUALVERIFY << OP_CHECKSIG;
+        tx.vout[i].nValue = 1000;
+    }
+    return CTransaction(tx);
+}
+
+static std::vector<CBloomFilter> MakeRelayFilters()
+{
+    std::vector<CBloomFilter> filters;
+    for (int i = 0; i < RELAY_PEERS; i++) {
+        filters.emplace_back(100, 0.0001, i, BLOOM_UPDATE_ALL);
+        for (uint32_t j = 0; j < 100; j++) {
+            std::vector<unsigned char> key(20, j);
+            key[0] = i;
+            filters.back().insert(key);
+        }
+    }
+    return filters;
+}
+
+static void BloomRelayPerPeer(benchmark::State& state)
+{
+    CTransaction tx = MakeRelayTx();
+    std::vector<CBloomFilter> filters = MakeRelayFilters();
+    uint64_t nMatches = 0;
+    while (state.KeepRunning()) {
+        for (auto& filter : filters)
+            nMatches += filter.IsRelevantAndUpdate(tx);
+    }
+}
+
+static void BloomRelayShared(benchmark::State& state)
+{
+    CTransaction tx = MakeRelayTx();
+    std::vector<CBloomFilter> filters = MakeRelayFilters();
+    uint64_t nMatches = 0;
+    while (state.KeepRunning()) {
+        CBloomTxElements elements(tx);
+        for (auto& filter : filters)
+            nMatches += filter.IsRelevantAndUpdate(elements);
+    }
+}
+
 BENCHMARK(RollingBloom);
+BENCHMARK(BloomRelayPerPeer);
+BENCHMARK(BloomRelayShared);
@@ -0,0 +1,126 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "hash.h"
+#include "kernel.h"
+#include "random.h"
+#include "streams.h"
+
+#include <limits>
+#include <vector>
+
+// Number of time slots a minting round checks per stake input (see CWallet::nHashDrift)
+static const unsigned int BENCH_HASH_DRIFT = 45;
+// Unreachable target, so every slot of every kernel gets hashed
+static const unsigned int BENCH_NBITS = 0x01010000;
+
+static std::vector<CStakeKernel> BuildKernels(size_t nCount, int64_t nTimeBlockFrom)
+{
+    std::vector<CStakeKernel> vKernels(nCount);
+    for (size_t i = 0; i < nCount; i++) {
+        COutPoint prevout(GetRandHash(), GetRandInt(4));
+        vKernels[i].SetKernel(GetRand(std::numeric_limits<uint64_t>::max()), BENCH_NBITS, nTimeBlockFrom, sizeof(CBlock), 20000 * COIN, prevout);
+    }
+    return vKernels;
+}
+
+// The old way of hashing a single time slot, for comparison
+static void StakeKernelHashDataStream(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    uint64_t nStakeModifier = 0x0123456789abcdefULL;
+    unsigned int nTimeBlockFrom = 1560000000;
+    unsigned int nTxPrevOffset = sizeof(CBlock);
+    int64_t txPrevTime = nTimeBlockFrom;
+    COutPoint prevout(GetRandHash(), 1);
+    unsigned int nTimeTx = nTimeBlockFrom + Params().GetConsensus().nStakeMinAge + 1000;
+
+    while (state.KeepRunning()) {
+        for (unsigned int i = 0; i < BENCH_HASH_DRIFT; i++) {
+            CDataStream ss(SER_GETHASH, 0);
+            ss << nStakeModifier;
+            ss << nTimeBlockFrom << nTxPrevOffset << txPrevTime << prevout.n << (nTimeTx - i);
+            uint256 hashProofOfStake = Hash(ss.begin(), ss.end());
+            (void)hashProofOfStake;
+        }
+    }
+}
+
+static void StakeKernelCheckTime(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    int64_t nTimeBlockFrom = 1560000000;
+    std::vector<CStakeKernel> vKernels = BuildKernels(1, nTimeBlockFrom);
+    unsigned int nTimeTx = nTimeBlockFrom + Params().GetConsensus().nStakeMinAge + 1000;
+
+    while (state.KeepRunning()) {
+        unsigned int nTimeTxRet;
+        uint256 hashProofOfStake;
+        bool fFound = vKernels[0].FindTime(nTimeTx, BENCH_HASH_DRIFT, 0, nTimeTxRet, hashProofOfStake);
+        assert(!fFound);
+    }
+}
+
+static void StakeKernelSearch(benchmark::State& state, size_t nKernels)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    int64_t nTimeBlockFrom = 1560000000;
+    std::vector<CStakeKernel> vKernels = BuildKernels(nKernels, nTimeBlockFrom);
+    unsigned int nTimeTx = nTimeBlockFrom + Params().GetConsensus().nStakeMinAge + 1000;
+
+    while (state.KeepRunning()) {
+        size_t nKernel;
+        unsigned int nTimeTxRet;
+        uint256 hashProofOfStake;
+        bool fFound = FindStakeKernel(vKernels, nTimeTx, BENCH_HASH_DRIFT, 0, nKernel, nTimeTxRet, hashProofOfStake);
+        assert(!fFound);
+    }
+}
+
+static void StakeKernelSearch_1k(benchmark::State& state) { StakeKernelSearch(state, 1000); }
+static void StakeKernelSearch_10k(benchmark::State& state) { StakeKernelSearch(state, 10000); }
+
+// Synthetic chain without any generated modifier but genesis, so every call has to do a full selection
+static void ComputeStakeModifierDeepChain(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const Consensus::Params& params = Params().GetConsensus();
+    const int nChainLength = 10000;
+
+    std::vector<uint256> vHashes(nChainLength);
+    std::vector<CBlockIndex> vIndex(nChainLength);
+    for (int i = 0; i < nChainLength; i++) {
+        vHashes[i] = GetRandHash();
+        CBlockIndex& index = vIndex[i];
+        index.phashBlock = &vHashes[i];
+        index.nHeight = i;
+        index.nTime = 1560000000 + i * params.nPosTargetSpacing;
+        index.pprev = i > 0 ? &vIndex[i - 1] : nullptr;
+        if (i % 2) {
+            index.SetProofOfStake();
+            index.hashProofOfStake = GetRandHash();
+        }
+        index.SetStakeEntropyBit(vHashes[i].GetCheapHash() & 1);
+        index.SetStakeModifier(0, i == 0);
+        index.BuildSkip();
+    }
+
+    const CBlockIndex* pindexCurrent = &vIndex.back();
+    while (state.KeepRunning()) {
+        uint64_t nStakeModifier;
+        bool fGeneratedStakeModifier;
+        bool fSuccess = ComputeNextStakeModifier(pindexCurrent, nStakeModifier, fGeneratedStakeModifier);
+        assert(fSuccess && fGeneratedStakeModifier);
+    }
+}
+
+BENCHMARK(StakeKernelHashDataStream);
+BENCHMARK(StakeKernelCheckTime);
+BENCHMARK(StakeKernelSearch_1k);
+BENCHMARK(StakeKernelSearch_10k);
+BENCHMARK(ComputeStakeModifierDeepChain);
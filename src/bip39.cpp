@@ -26,10 +26,12 @@
 
 #include "bip39.h"
 #include "bip39_english.h"
+#include "crypto/hmac_sha512.h"
 #include "crypto/sha256.h"
 #include "random.h"
+#include "support/cleanse.h"
 
-#include <openssl/evp.h>
+#include <string.h>
 
 SecureString CMnemonic::Generate(int strength)
 {
@@ -148,15 +150,36 @@ bool CMnemonic::Check(SecureString mnemonic)
     return fResult;
 }
 
-// passphrase must be at most 256 characters or code may crash
+// PBKDF2 with HMAC-SHA512 for a single 64 byte output block, which is all BIP39 needs.
+// The HMAC is keyed with the password once, every iteration then starts from a copy of the
+// hashed inner and outer pads instead of hashing them again.
+static void PBKDF2_HMAC_SHA512(const unsigned char* pass, size_t passlen, const unsigned char* salt, size_t saltlen, int iterations, unsigned char out[CHMAC_SHA512::OUTPUT_SIZE])
+{
+    static const unsigned char blockIndex[4] = {0, 0, 0, 1};
+
+    CHMAC_SHA512 keyed(pass, passlen);
+    unsigned char u[CHMAC_SHA512::OUTPUT_SIZE];
+
+    CHMAC_SHA512 hmac = keyed;
+    hmac.Write(salt, saltlen).Write(blockIndex, sizeof(blockIndex)).Finalize(u);
+    memcpy(out, u, sizeof(u));
+
+    for (int i = 1; i < iterations; i++) {
+        hmac = keyed;
+        hmac.Write(u, sizeof(u)).Finalize(u);
+        for (size_t j = 0; j < sizeof(u); j++) {
+            out[j] ^= u[j];
+        }
+    }
+
+    memory_cleanse(u, sizeof(u));
+    memory_cleanse(&hmac, sizeof(hmac));
+    memory_cleanse(&keyed, sizeof(keyed));
+}
+
 void CMnemonic::ToSeed(SecureString mnemonic, SecureString passphrase, SecureVector& seedRet)
 {
     SecureString ssSalt = SecureString("mnemonic") + passphrase;
-    SecureVector vchSalt(ssSalt.begin(), ssSalt.end());
-    seedRet.resize(64);
-    // int PKCS5_PBKDF2_HMAC(const char *pass, int passlen,
-    //                    const unsigned char *salt, int saltlen, int iter,
-    //                    const EVP_MD *digest,
-    //                    int keylen, unsigned char *out);
-    PKCS5_PBKDF2_HMAC(mnemonic.c_str(), mnemonic.size(), &vchSalt[0], vchSalt.size(), 2048, EVP_sha512(), 64, &seedRet[0]);
+    seedRet.resize(CHMAC_SHA512::OUTPUT_SIZE);
+    PBKDF2_HMAC_SHA512((const unsigned char*)mnemonic.data(), mnemonic.size(), (const unsigned char*)ssSalt.data(), ssSalt.size(), 2048, &seedRet[0]);
 }
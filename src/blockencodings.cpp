@@ -19,13 +19,20 @@
 
 CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block) :
         nonce(GetRand(std::numeric_limits<uint64_t>::max())),
-        shorttxids(block.vtx.size() - 1), prefilledtxn(1), header(block), vchBlockSig(block.vchBlockSig) {
+        header(block), vchBlockSig(block.vchBlockSig) {
     FillShortTxIDSelector();
     //TODO: Use our mempool prior to block acceptance to predictively fill more than just the coinbase
+    // The coinstake of a PoS block spends the staker's own coins and is never relayed
+    // on its own, so no peer can have it in its mempool
+    const size_t nPrefilled = block.IsProofOfStake() ? 2 : 1;
+    shorttxids.resize(block.vtx.size() - nPrefilled);
+    prefilledtxn.resize(nPrefilled);
     prefilledtxn[0] = {0, block.vtx[0]};
-    for (size_t i = 1; i < block.vtx.size(); i++) {
+    if (nPrefilled == 2)
+        prefilledtxn[1] = {0, block.vtx[1]};
+    for (size_t i = nPrefilled; i < block.vtx.size(); i++) {
         const CTransaction& tx = *block.vtx[i];
-        shorttxids[i - 1] = GetShortID(tx.GetHash());
+        shorttxids[i - nPrefilled] = GetShortID(tx.GetHash());
     }
 }
 
@@ -30,10 +30,8 @@ bool GetKeyIDFromUTXO(const CTxOut& txout, CKeyID& keyID)
     return true;
 }
 
-bool SignBlock(CBlock& block, const CKeyStore& keystore)
+bool GetBlockSigningKeyID(const CBlock& block, CKeyID& keyID)
 {
-    std::vector<valtype> vSolutions;
-    CKeyID keyID;
     if (block.IsProofOfWork()) {
         bool fFoundID = false;
         for (const CTxOut& txout :block.vtx[0]->vout) {
@@ -49,6 +47,15 @@ bool SignBlock(CBlock& block, const CKeyStore& keystore)
             return error("%s: failed to find key for PoS", __func__);
     }
 
+    return true;
+}
+
+bool SignBlock(CBlock& block, const CKeyStore& keystore)
+{
+    CKeyID keyID;
+    if (!GetBlockSigningKeyID(block, keyID))
+        return false;
+
     CKey key;
     if (!keystore.GetKey(keyID, key))
         return error("%s: failed to get key from keystore", __func__);
@@ -56,17 +63,13 @@ bool SignBlock(CBlock& block, const CKeyStore& keystore)
     return SignBlockWithKey(block, key);
 }
 
-bool CheckBlockSignature(const CBlock& block)
+bool CBlockSignatureCheck::Init(const CBlock& block)
 {
     std::vector<valtype> vSolutions;
 
-    if (block.IsProofOfWork())
-        return block.vchBlockSig.empty();
-
     if (block.vchBlockSig.empty())
         return error("%s: vchBlockSig is empty!", __func__);
 
-    CPubKey pubkey;
     txnouttype whichType;
     const CTxOut& txout = block.vtx[1]->vout[1];
     if (!Solver(txout.scriptPubKey, whichType, vSolutions))
@@ -79,5 +82,24 @@ bool CheckBlockSignature(const CBlock& block)
     if (!pubkey.IsValid())
         return error("%s: invalid pubkey %s", __func__, HexStr(pubkey));
 
-    return pubkey.Verify(block.GetHash(), block.vchBlockSig);
+    hash = block.GetHash();
+    vchSig = block.vchBlockSig;
+    return true;
+}
+
+bool CBlockSignatureCheck::operator()()
+{
+    return pubkey.Verify(hash, vchSig);
+}
+
+bool CheckBlockSignature(const CBlock& block)
+{
+    if (block.IsProofOfWork())
+        return block.vchBlockSig.empty();
+
+    CBlockSignatureCheck check;
+    if (!check.Init(block))
+        return false;
+
+    return check();
 }
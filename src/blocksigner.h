@@ -1,13 +1,46 @@
 #ifndef BLOCKSIGNER_H
 #define BLOCKSIGNER_H
 
+#include <pubkey.h>
+#include <uint256.h>
+
+#include <vector>
+
 class CBlock;
-class CPubKey;
 class CKey;
 class CKeyStore;
 
 bool SignBlockWithKey(CBlock& block, const CKey& key);
+//! The key a block has to be signed with, the one of the coinstake (PoS) or coinbase (PoW)
+bool GetBlockSigningKeyID(const CBlock& block, CKeyID& keyID);
 bool SignBlock(CBlock& block, const CKeyStore& keystore);
 bool CheckBlockSignature(const CBlock& block);
 
+/**
+ * Closure representing the ECDSA part of a block signature check, so it can be queued
+ * on a CCheckQueue next to the script checks of the same block.
+ * Init() does the cheap structural checks up front.
+ */
+class CBlockSignatureCheck
+{
+private:
+    CPubKey pubkey;
+    uint256 hash;
+    std::vector<unsigned char> vchSig;
+
+public:
+    CBlockSignatureCheck() {}
+
+    // Returns false if the block can't possibly carry a valid signature, true if only the ECDSA verification is left
+    bool Init(const CBlock& block);
+
+    bool operator()();
+
+    void swap(CBlockSignatureCheck& check) {
+        std::swap(pubkey, check.pubkey);
+        std::swap(hash, check.hash);
+        vchSig.swap(check.vchSig);
+    }
+};
+
 #endif // BLOCKSIGNER_H
@@ -9,6 +9,7 @@
 #include "evo/providertx.h"
 #include "evo/cbtx.h"
 #include "llmq/quorums_commitment.h"
+#include "crypto/common.h"
 #include "hash.h"
 #include "script/script.h"
 #include "script/standard.h"
@@ -17,6 +18,7 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <boost/foreach.hpp>
 
@@ -54,73 +56,132 @@ CBloomFilter::CBloomFilter(unsigned int nElements, double nFPRate, unsigned int
 {
 }
 
-inline unsigned int CBloomFilter::Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const
+// Calls f with data and size of every non-empty push in script
+template <typename F>
+static void ForEachPush(const CScript& script, F f)
 {
-    // 0xFBA4C795 chosen as it guarantees a reasonable bit difference between nHashNum values.
-    return MurmurHash3(nHashNum * 0xFBA4C795 + nTweak, vDataToHash) % (vData.size() * 8);
+    CScript::const_iterator pc = script.begin();
+    while (pc < script.end()) {
+        CScript::const_iterator pcOp = pc;
+        opcodetype opcode;
+        if (!script.GetOp(pc, opcode))
+            break;
+        if (opcode > OP_PUSHDATA4)
+            continue;
+        // the pushed data is the end of the op, behind the opcode and its size
+        size_t nHeader = 1 + (opcode == OP_PUSHDATA1 ? 1 : opcode == OP_PUSHDATA2 ? 2 : opcode == OP_PUSHDATA4 ? 4 : 0);
+        size_t nSize = (pc - pcOp) - nHeader;
+        if (nSize != 0)
+            f(&pcOp[nHeader], nSize);
+    }
+}
+
+static void SerializeOutPoint(const COutPoint& outpoint, unsigned char* out)
+{
+    // same as CDataStream << outpoint
+    memcpy(out, outpoint.hash.begin(), 32);
+    WriteLE32(out + 32, outpoint.n);
+}
+
+CBloomTxElements::CBloomTxElements(const CTransaction& txIn) : tx(txIn)
+{
+    auto add = [&](const unsigned char* data, size_t len) {
+        vPushes.push_back(Element{data, (uint32_t)len});
+    };
+    vOutputPushesEnd.reserve(tx.vout.size());
+    for (const CTxOut& txout : tx.vout) {
+        ForEachPush(txout.scriptPubKey, add);
+        vOutputPushesEnd.push_back(vPushes.size());
+    }
+    vInputPushesEnd.reserve(tx.vin.size());
+    vPrevouts.resize(tx.vin.size() * OUTPOINT_SIZE);
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        SerializeOutPoint(tx.vin[i].prevout, &vPrevouts[i * OUTPOINT_SIZE]);
+        ForEachPush(tx.vin[i].scriptSig, add);
+        vInputPushesEnd.push_back(vPushes.size());
+    }
+}
+
+template <typename F>
+bool CBloomFilter::ForEachBit(const unsigned char* data, size_t len, F f) const
+{
+    for (unsigned int i = 0; i < nHashFuncs; i += 4)
+    {
+        // 0xFBA4C795 chosen as it guarantees a reasonable bit difference between hash function seeds.
+        uint32_t seeds[4], hashes[4];
+        for (unsigned int j = 0; j < 4; j++)
+            seeds[j] = (i + j) * 0xFBA4C795 + nTweak;
+        MurmurHash3x4(seeds, data, len, hashes);
+        for (unsigned int j = 0; j < 4 && i + j < nHashFuncs; j++)
+        {
+            if (!f(hashes[j] % (vData.size() * 8)))
+                return false;
+        }
+    }
+    return true;
 }
 
 void CBloomFilter::insert(const std::vector<unsigned char>& vKey)
+{
+    insert(vKey.data(), vKey.size());
+}
+
+void CBloomFilter::insert(const unsigned char* data, size_t len)
 {
     if (isFull)
         return;
-    for (unsigned int i = 0; i < nHashFuncs; i++)
-    {
-        unsigned int nIndex = Hash(i, vKey);
+    ForEachBit(data, len, [&](unsigned int nIndex) {
         // Sets bit nIndex of vData
         vData[nIndex >> 3] |= (1 << (7 & nIndex));
-    }
+        return true;
+    });
     isEmpty = false;
 }
 
 void CBloomFilter::insert(const COutPoint& outpoint)
 {
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << outpoint;
-    std::vector<unsigned char> data(stream.begin(), stream.end());
-    insert(data);
+    unsigned char data[CBloomTxElements::OUTPOINT_SIZE];
+    SerializeOutPoint(outpoint, data);
+    insert(data, sizeof(data));
 }
 
 void CBloomFilter::insert(const uint256& hash)
 {
-    std::vector<unsigned char> data(hash.begin(), hash.end());
-    insert(data);
+    insert(hash.begin(), hash.size());
 }
 
 bool CBloomFilter::contains(const std::vector<unsigned char>& vKey) const
+{
+    return contains(vKey.data(), vKey.size());
+}
+
+bool CBloomFilter::contains(const unsigned char* data, size_t len) const
 {
     if (isFull)
         return true;
     if (isEmpty)
         return false;
-    for (unsigned int i = 0; i < nHashFuncs; i++)
-    {
-        unsigned int nIndex = Hash(i, vKey);
+    return ForEachBit(data, len, [&](unsigned int nIndex) {
         // Checks bit nIndex of vData
-        if (!(vData[nIndex >> 3] & (1 << (7 & nIndex))))
-            return false;
-    }
-    return true;
+        return (vData[nIndex >> 3] & (1 << (7 & nIndex))) != 0;
+    });
 }
 
 bool CBloomFilter::contains(const COutPoint& outpoint) const
 {
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << outpoint;
-    std::vector<unsigned char> data(stream.begin(), stream.end());
-    return contains(data);
+    unsigned char data[CBloomTxElements::OUTPOINT_SIZE];
+    SerializeOutPoint(outpoint, data);
+    return contains(data, sizeof(data));
 }
 
 bool CBloomFilter::contains(const uint256& hash) const
 {
-    std::vector<unsigned char> data(hash.begin(), hash.end());
-    return contains(data);
+    return contains(hash.begin(), hash.size());
 }
 
 bool CBloomFilter::contains(const uint160& hash) const
 {
-    std::vector<unsigned char> data(hash.begin(), hash.end());
-    return contains(data);
+    return contains(hash.begin(), hash.size());
 }
 
 void CBloomFilter::clear()
@@ -144,16 +205,11 @@ bool CBloomFilter::IsWithinSizeConstraints() const
 // Match if the filter contains any arbitrary script data element in script
 bool CBloomFilter::CheckScript(const CScript &script) const
 {
-    CScript::const_iterator pc = script.begin();
-    std::vector<unsigned char> data;
-    while (pc < script.end()) {
-        opcodetype opcode;
-        if (!script.GetOp(pc, opcode, data))
-            break;
-        if (data.size() != 0 && contains(data))
-            return true;
-    }
-    return false;
+    bool fFound = false;
+    ForEachPush(script, [&](const unsigned char* data, size_t len) {
+        fFound = fFound || contains(data, len);
+    });
+    return fFound;
 }
 
 // If the transaction is a special transaction that has a registration
@@ -233,6 +289,16 @@ bool CBloomFilter::CheckSpecialTransactionMatchesAndUpdate(const CTransaction &t
 
 bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
 {
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
+    return IsRelevantAndUpdate(CBloomTxElements(tx));
+}
+
+bool CBloomFilter::IsRelevantAndUpdate(const CBloomTxElements& elements)
+{
+    const CTransaction& tx = elements.tx;
     bool fFound = false;
     // Match if the filter contains the hash of tx
     //  for finding tx when they appear in a block
@@ -247,14 +313,25 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     // Check additional matches for special transactions
     fFound = fFound || CheckSpecialTransactionMatchesAndUpdate(tx);
 
+    auto containsAny = [&](uint32_t nBegin, uint32_t nEnd) {
+        for (uint32_t j = nBegin; j < nEnd; j++) {
+            if (contains(elements.vPushes[j].begin, elements.vPushes[j].size))
+                return true;
+        }
+        return false;
+    };
+
+    uint32_t nPush = 0;
     for (unsigned int i = 0; i < tx.vout.size(); i++)
     {
         const CTxOut& txout = tx.vout[i];
+        uint32_t nBegin = nPush;
+        nPush = elements.vOutputPushesEnd[i];
         // Match if the filter contains any arbitrary script data element in any scriptPubKey in tx
         // If this matches, also add the specific output that was matched.
         // This means clients don't have to update the filter themselves when a new relevant tx 
         // is discovered in order to find spending transactions, which avoids round-tripping and race conditions.
-        if(CheckScript(txout.scriptPubKey)) {
+        if(containsAny(nBegin, nPush)) {
             fFound = true;
             if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL)
                 insert(COutPoint(hash, i));
@@ -272,14 +349,16 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     if (fFound)
         return true;
 
-    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    for (unsigned int i = 0; i < tx.vin.size(); i++)
     {
         // Match if the filter contains an outpoint tx spends
-        if (contains(txin.prevout))
+        if (contains(&elements.vPrevouts[i * CBloomTxElements::OUTPOINT_SIZE], CBloomTxElements::OUTPOINT_SIZE))
             return true;
 
         // Match if the filter contains any arbitrary script data element in any scriptSig in tx
-        if(CheckScript(txin.scriptSig))
+        uint32_t nBegin = nPush;
+        nPush = elements.vInputPushesEnd[i];
+        if (containsAny(nBegin, nPush))
             return true;
     }
 
@@ -32,6 +32,34 @@ enum bloomflags
     BLOOM_UPDATE_MASK = 3,
 };
 
+/**
+ * The data elements of a transaction which bloom filters are matched against: the pushes of its
+ * scripts and the serialized outpoints it spends. Extracting them takes more time than hashing a
+ * few of them, so a transaction which is checked against the filters of many peers is only parsed
+ * once. The elements point into tx, which has to outlive this.
+ */
+class CBloomTxElements
+{
+public:
+    struct Element {
+        const unsigned char* begin;
+        uint32_t size;
+    };
+
+    const CTransaction& tx;
+    //! Non-empty pushes of all scriptPubKeys, then of all scriptSigs
+    std::vector<Element> vPushes;
+    //! End of the pushes of every output resp. input in vPushes
+    std::vector<uint32_t> vOutputPushesEnd;
+    std::vector<uint32_t> vInputPushesEnd;
+    //! The serialized prevout of every input
+    std::vector<unsigned char> vPrevouts;
+
+    static const size_t OUTPOINT_SIZE = 36;
+
+    explicit CBloomTxElements(const CTransaction& txIn);
+};
+
 /**
  * BloomFilter is a probabilistic filter which SPV clients provide
  * so that we can filter the transactions we send them.
@@ -53,7 +81,9 @@ private:
     unsigned int nTweak;
     unsigned char nFlags;
 
-    unsigned int Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const;
+    // Computes the hash functions 4 at a time and calls f with every bit index until it returns false
+    template <typename F>
+    bool ForEachBit(const unsigned char* data, size_t len, F f) const;
 
     // Private constructor for CRollingBloomFilter, no restrictions on size
     CBloomFilter(unsigned int nElements, double nFPRate, unsigned int nTweak);
@@ -87,10 +117,12 @@ public:
     }
 
     void insert(const std::vector<unsigned char>& vKey);
+    void insert(const unsigned char* data, size_t len);
     void insert(const COutPoint& outpoint);
     void insert(const uint256& hash);
 
     bool contains(const std::vector<unsigned char>& vKey) const;
+    bool contains(const unsigned char* data, size_t len) const;
     bool contains(const COutPoint& outpoint) const;
     bool contains(const uint256& hash) const;
     bool contains(const uint160& hash) const;
@@ -104,6 +136,8 @@ public:
 
     //! Also adds any outputs which match the filter to the filter (to match their spending txes)
     bool IsRelevantAndUpdate(const CTransaction& tx);
+    //! The same with the elements of the tx extracted up front, for checking it against many filters
+    bool IsRelevantAndUpdate(const CBloomTxElements& elements);
 
     //! Checks for empty and full filters to avoid wasting cpu
     void UpdateEmptyFull();
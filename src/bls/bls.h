@@ -20,6 +20,7 @@
 #undef DOUBLE
 
 #include <array>
+#include <memory>
 #include <mutex>
 #include <unistd.h>
 
@@ -421,6 +422,21 @@ public:
         return obj;
     }
 
+    //! Same as Get().IsValid(), but the all-zero buf of a null object is not deserialized to find out
+    bool IsValid() const
+    {
+        {
+            std::unique_lock<std::mutex> l(mutex);
+            if (bufValid && !objInitialized) {
+                static const char zeroBuf[BLSObject::SerSize] = {};
+                if (memcmp(buf, zeroBuf, sizeof(buf)) == 0) {
+                    return false;
+                }
+            }
+        }
+        return Get().IsValid();
+    }
+
     bool operator==(const CBLSLazyWrapper& r) const
     {
         if (bufValid && r.bufValid) {
@@ -461,6 +477,67 @@ private:
 typedef CBLSLazyWrapper<CBLSSignature> CBLSLazySignature;
 typedef CBLSLazyWrapper<CBLSPublicKey> CBLSLazyPublicKey;
 typedef CBLSLazyWrapper<CBLSSecretKey> CBLSLazySecretKey;
+
+/**
+ * An immutable CBLSLazyWrapper shared between copies, for objects which are copied much more
+ * often than they change, like the operator keys in the masternode states of every MN list.
+ * A copy only takes a reference, and all copies deserialize the object once between them.
+ */
+template <typename BLSObject>
+class CBLSSharedLazyWrapper
+{
+private:
+    typedef CBLSLazyWrapper<BLSObject> Wrapper;
+
+    // never null, all default constructed instances share the same null object
+    std::shared_ptr<const Wrapper> ptr;
+
+    static const std::shared_ptr<const Wrapper>& NullWrapper()
+    {
+        static const std::shared_ptr<const Wrapper> nullWrapper = std::make_shared<const Wrapper>();
+        return nullWrapper;
+    }
+
+public:
+    CBLSSharedLazyWrapper() : ptr(NullWrapper()) {}
+
+    operator const Wrapper&() const { return *ptr; }
+
+    template<typename Stream>
+    inline void Serialize(Stream& s) const
+    {
+        ptr->Serialize(s);
+    }
+
+    template<typename Stream>
+    inline void Unserialize(Stream& s)
+    {
+        auto p = std::make_shared<Wrapper>();
+        p->Unserialize(s);
+        ptr = std::move(p);
+    }
+
+    void Set(const BLSObject& _obj)
+    {
+        auto p = std::make_shared<Wrapper>();
+        p->Set(_obj);
+        ptr = std::move(p);
+    }
+    const BLSObject& Get() const { return ptr->Get(); }
+    bool IsValid() const { return ptr->IsValid(); }
+    uint256 GetHash() const { return ptr->GetHash(); }
+
+    bool operator==(const CBLSSharedLazyWrapper& r) const
+    {
+        return ptr == r.ptr || *ptr == *r.ptr;
+    }
+
+    bool operator!=(const CBLSSharedLazyWrapper& r) const
+    {
+        return !(*this == r);
+    }
+};
+typedef CBLSSharedLazyWrapper<CBLSPublicKey> CBLSSharedLazyPublicKey;
 #endif
 
 typedef std::vector<CBLSId> BLSIdVector;
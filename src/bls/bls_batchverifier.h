@@ -9,6 +9,8 @@
 
 #include "bls.h"
 
+#include <functional>
+#include <future>
 #include <map>
 #include <vector>
 
@@ -116,7 +118,84 @@ public:
         }
     }
 
+    // Alternative to Verify(). Messages are split into up to nChunks chunks, which are handed to runAsync (e.g. to run
+    // them on CBLSWorker threads). A chunk that fails is bisected until the invalid messages are found, so a single bad
+    // message costs a few extra pairings instead of re-verifying everything per source and per message. Sources of
+    // invalid messages end up in badSources.
+    void VerifyBisect(size_t nChunks, const std::function<std::future<void>(std::function<void()>)>& runAsync)
+    {
+        std::vector<MessageMapIterator> allMessages;
+        allMessages.reserve(messages.size());
+        for (auto it = messages.begin(); it != messages.end(); ++it) {
+            allMessages.emplace_back(it);
+        }
+        if (allMessages.empty()) {
+            return;
+        }
+
+        nChunks = std::max<size_t>(1, std::min(nChunks, allMessages.size()));
+        size_t chunkSize = (allMessages.size() + nChunks - 1) / nChunks;
+        std::vector<std::vector<MessageMapIterator>> chunks;
+        for (size_t i = 0; i < allMessages.size(); i += chunkSize) {
+            chunks.emplace_back(allMessages.begin() + i, allMessages.begin() + std::min(i + chunkSize, allMessages.size()));
+        }
+
+        std::vector<std::vector<MessageId>> chunkBadMessages(chunks.size());
+        std::vector<std::future<void>> futures;
+        for (size_t i = 1; i < chunks.size(); i++) {
+            futures.emplace_back(runAsync([this, &chunks, &chunkBadMessages, i]() {
+                Bisect(chunks[i].begin(), chunks[i].end(), chunkBadMessages[i]);
+            }));
+        }
+        // the first chunk is done by the calling thread
+        Bisect(chunks[0].begin(), chunks[0].end(), chunkBadMessages[0]);
+        for (size_t i = 1; i < chunks.size(); i++) {
+            try {
+                futures[i - 1].get();
+            } catch (...) {
+                // the job was dropped (e.g. the worker is shutting down), so do it here
+                chunkBadMessages[i].clear();
+                Bisect(chunks[i].begin(), chunks[i].end(), chunkBadMessages[i]);
+            }
+        }
+
+        for (const auto& v : chunkBadMessages) {
+            badMessages.insert(v.begin(), v.end());
+        }
+        for (const auto& p : messagesBySource) {
+            for (const auto& msgIt : p.second) {
+                if (badMessages.count(msgIt->first)) {
+                    badSources.emplace(p.first);
+                    break;
+                }
+            }
+        }
+    }
+
 private:
+    typedef typename std::vector<MessageMapIterator>::const_iterator ChunkIterator;
+
+    void Bisect(ChunkIterator begin, ChunkIterator end, std::vector<MessageId>& badMessagesRet) const
+    {
+        if (begin == end) {
+            return;
+        }
+        std::map<uint256, std::vector<MessageMapIterator>> byMessageHash;
+        for (auto it = begin; it != end; ++it) {
+            byMessageHash[(*it)->second.msgHash].emplace_back(*it);
+        }
+        if (secureVerification ? VerifyBatchSecure(byMessageHash) : VerifyBatchInsecure(byMessageHash)) {
+            return;
+        }
+        if (end - begin == 1) {
+            badMessagesRet.emplace_back((*begin)->first);
+            return;
+        }
+        auto mid = begin + (end - begin) / 2;
+        Bisect(begin, mid, badMessagesRet);
+        Bisect(mid, end, badMessagesRet);
+    }
+
     // All Verify methods take ownership of the passed byMessageHash map and thus might modify the map. This is to avoid
     // unnecessary copies
 
@@ -129,15 +208,15 @@ private:
         }
     }
 
-    bool VerifyBatchInsecure(const std::map<uint256, std::vector<MessageMapIterator>>& byMessageHash)
+    bool VerifyBatchInsecure(const std::map<uint256, std::vector<MessageMapIterator>>& byMessageHash) const
     {
         CBLSSignature aggSig;
         std::vector<uint256> msgHashes;
         std::vector<CBLSPublicKey> pubKeys;
         std::set<MessageId> dups;
 
-        msgHashes.reserve(messages.size());
-        pubKeys.reserve(messages.size());
+        msgHashes.reserve(byMessageHash.size());
+        pubKeys.reserve(byMessageHash.size());
 
         for (const auto& p : byMessageHash) {
             const auto& msgHash = p.first;
@@ -180,7 +259,7 @@ private:
         return aggSig.VerifyInsecureAggregated(pubKeys, msgHashes);
     }
 
-    bool VerifyBatchSecure(std::map<uint256, std::vector<MessageMapIterator>>& byMessageHash)
+    bool VerifyBatchSecure(std::map<uint256, std::vector<MessageMapIterator>>& byMessageHash) const
     {
         // Loop until the byMessageHash map is empty, which means that all messages were verified
         // The secure form of verification will only aggregate one message for the same message hash, even if multiple
@@ -194,15 +273,15 @@ private:
         return true;
     }
 
-    bool VerifyBatchSecureStep(std::map<uint256, std::vector<MessageMapIterator>>& byMessageHash)
+    bool VerifyBatchSecureStep(std::map<uint256, std::vector<MessageMapIterator>>& byMessageHash) const
     {
         CBLSSignature aggSig;
         std::vector<uint256> msgHashes;
         std::vector<CBLSPublicKey> pubKeys;
         std::set<MessageId> dups;
 
-        msgHashes.reserve(messages.size());
-        pubKeys.reserve(messages.size());
+        msgHashes.reserve(byMessageHash.size());
+        pubKeys.reserve(byMessageHash.size());
 
         for (auto it = byMessageHash.begin(); it != byMessageHash.end(); ) {
             const auto& msgHash = it->first;
@@ -0,0 +1,138 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bls_sigcache.h"
+
+#include "crypto/sha256.h"
+#include "cuckoocache.h"
+#include "hash.h"
+#include "random.h"
+#include "util.h"
+
+#include <boost/thread.hpp>
+
+namespace {
+
+/** Entries are salted hashes already, see SignatureCacheHasher */
+class BLSSignatureCacheHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        static_assert(hash_select < 8, "BLSSignatureCacheHasher only has 8 hashes available.");
+        uint32_t u;
+        std::memcpy(&u, key.begin() + 4 * hash_select, 4);
+        return u;
+    }
+};
+
+/**
+ * Valid BLS signatures, the same as CSignatureCache does for ECDSA. Recovered sigs, ISLOCKs,
+ * CLSIGs and quorum commitments are verified when they are received and again when they are
+ * used, so without this every one of them needs its pairings computed twice.
+ */
+class CBLSSignatureCache
+{
+private:
+    //! Entries are SHA256(nonce || public key hash || message hash || signature hash)
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, BLSSignatureCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_sigcache;
+
+public:
+    CBLSSignatureCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    void ComputeEntry(uint256& entry, const uint256& pubKeyHash, const uint256& msgHash, const CBLSSignature& sig)
+    {
+        // the wrappers cache the hashes of their serialization, so this is three compressions
+        CSHA256().Write(nonce.begin(), 32).Write(pubKeyHash.begin(), 32).Write(msgHash.begin(), 32).Write(sig.GetHash().begin(), 32).Finalize(entry.begin());
+    }
+
+    bool Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.contains(entry, false);
+    }
+
+    void Set(uint256 entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        setValid.insert(entry);
+    }
+
+    uint32_t setup_bytes(size_t n)
+    {
+        return setValid.setup_bytes(n);
+    }
+};
+
+static CBLSSignatureCache blsSignatureCache;
+} // namespace
+
+// To be called once in AppInitMain/BasicTestingSetup, next to InitSignatureCache
+void InitBLSSignatureCache()
+{
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, GetArg("-maxblssigcachesize", DEFAULT_MAX_BLS_SIG_CACHE_SIZE)), MAX_MAX_BLS_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = blsSignatureCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for BLS signature cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
+
+uint256 ComputeBLSSignatureCacheEntry(const uint256& pubKeyHash, const uint256& msgHash, const CBLSSignature& sig)
+{
+    uint256 entry;
+    blsSignatureCache.ComputeEntry(entry, pubKeyHash, msgHash, sig);
+    return entry;
+}
+
+bool BLSSignatureCacheContains(const uint256& entry)
+{
+    return blsSignatureCache.Get(entry);
+}
+
+void BLSSignatureCacheAdd(const uint256& entry)
+{
+    blsSignatureCache.Set(entry);
+}
+
+bool VerifyBLSSignatureCached(const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& msgHash)
+{
+    if (!sig.IsValid() || !pubKey.IsValid()) {
+        return false;
+    }
+    uint256 entry = ComputeBLSSignatureCacheEntry(pubKey.GetHash(), msgHash, sig);
+    if (blsSignatureCache.Get(entry)) {
+        return true;
+    }
+    if (!sig.VerifyInsecure(pubKey, msgHash)) {
+        return false;
+    }
+    blsSignatureCache.Set(entry);
+    return true;
+}
+
+bool VerifyBLSAggregatedSignatureCached(const CBLSSignature& sig, const std::vector<CBLSPublicKey>& pubKeys, const uint256& msgHash)
+{
+    if (!sig.IsValid()) {
+        return false;
+    }
+    CHashWriter hw(SER_GETHASH, 0);
+    for (const auto& pubKey : pubKeys) {
+        hw << pubKey.GetHash();
+    }
+    uint256 entry = ComputeBLSSignatureCacheEntry(hw.GetHash(), msgHash, sig);
+    if (blsSignatureCache.Get(entry)) {
+        return true;
+    }
+    if (!sig.VerifySecureAggregated(pubKeys, msgHash)) {
+        return false;
+    }
+    blsSignatureCache.Set(entry);
+    return true;
+}
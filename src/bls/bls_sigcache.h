@@ -0,0 +1,34 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPMCOIN_CRYPTO_BLS_SIGCACHE_H
+#define EPMCOIN_CRYPTO_BLS_SIGCACHE_H
+
+#include "bls.h"
+
+#include <vector>
+
+// Far fewer BLS signatures than ECDSA ones are seen, but each one costs a pairing
+static const unsigned int DEFAULT_MAX_BLS_SIG_CACHE_SIZE = 4;
+static const int64_t MAX_MAX_BLS_SIG_CACHE_SIZE = 1024;
+
+void InitBLSSignatureCache();
+
+/**
+ * Salted cache entry for sig over msgHash. pubKeyHash is the hash of the public key, or of all
+ * public keys for an aggregated signature.
+ */
+uint256 ComputeBLSSignatureCacheEntry(const uint256& pubKeyHash, const uint256& msgHash, const CBLSSignature& sig);
+bool BLSSignatureCacheContains(const uint256& entry);
+//! Only to be called for signatures which were verified, e.g. as part of a batch
+void BLSSignatureCacheAdd(const uint256& entry);
+
+/**
+ * CBLSSignature::VerifyInsecure and VerifySecureAggregated, but signatures which were verified
+ * before (e.g. on P2P receipt and again when connecting the block) skip the pairing.
+ */
+bool VerifyBLSSignatureCached(const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& msgHash);
+bool VerifyBLSAggregatedSignatureCached(const CBLSSignature& sig, const std::vector<CBLSPublicKey>& pubKeys, const uint256& msgHash);
+
+#endif // EPMCOIN_CRYPTO_BLS_SIGCACHE_H
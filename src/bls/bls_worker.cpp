@@ -74,6 +74,13 @@ void CBLSWorker::Stop()
     workerPool.stop(true);
 }
 
+std::future<void> CBLSWorker::AsyncRun(std::function<void()> job)
+{
+    return workerPool.push([job](int threadId) {
+        job();
+    });
+}
+
 bool CBLSWorker::GenerateContributions(int quorumThreshold, const BLSIdVector& ids, BLSVerificationVectorPtr& vvecRet, BLSSecretKeyVector& skShares)
 {
     BLSSecretKeyVectorPtr svec = std::make_shared<BLSSecretKeyVector>((size_t)quorumThreshold);
@@ -846,6 +853,27 @@ std::future<CBLSSignature> CBLSWorker::AsyncSign(const CBLSSecretKey& secKey, co
     return std::move(p.second);
 }
 
+void CBLSWorker::AsyncRecoverSig(BLSSignatureVector sigShares, BLSIdVector ids, const CBLSPublicKey& verifyPubKey, const uint256& msgHash,
+                                 CBLSWorker::SignDoneCallback doneCallback)
+{
+    auto sharesPtr = std::make_shared<BLSSignatureVector>(std::move(sigShares));
+    auto idsPtr = std::make_shared<BLSIdVector>(std::move(ids));
+    workerPool.push([sharesPtr, idsPtr, verifyPubKey, msgHash, doneCallback](int threadId) {
+        CBLSSignature sig;
+        if (sig.Recover(*sharesPtr, *idsPtr) && verifyPubKey.IsValid() && !sig.VerifyInsecure(verifyPubKey, msgHash)) {
+            sig = CBLSSignature();
+        }
+        doneCallback(sig);
+    });
+}
+
+std::future<CBLSSignature> CBLSWorker::AsyncRecoverSig(BLSSignatureVector sigShares, BLSIdVector ids, const CBLSPublicKey& verifyPubKey, const uint256& msgHash)
+{
+    auto p = BuildFutureDoneCallback<CBLSSignature>();
+    AsyncRecoverSig(std::move(sigShares), std::move(ids), verifyPubKey, msgHash, std::move(p.first));
+    return std::move(p.second);
+}
+
 void CBLSWorker::AsyncVerifySig(const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& msgHash,
                                 CBLSWorker::SigVerifyDoneCallback doneCallback, CancelCond cancelCond)
 {
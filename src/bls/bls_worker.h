@@ -11,6 +11,7 @@
 
 #include "ctpl.h"
 
+#include <functional>
 #include <future>
 #include <mutex>
 
@@ -60,6 +61,9 @@ public:
 
     bool GenerateContributions(int threshold, const BLSIdVector& ids, BLSVerificationVectorPtr& vvecRet, BLSSecretKeyVector& skShares);
 
+    // Runs a job on the worker threads, for work that is put together elsewhere (e.g. CBLSBatchVerifier::VerifyBisect)
+    std::future<void> AsyncRun(std::function<void()> job);
+
     // The following functions are all used to aggregate verification (public key) vectors
     // Inputs are in the following form:
     //   [
@@ -141,6 +145,11 @@ public:
     std::future<bool> AsyncVerifySig(const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& msgHash, CancelCond cancelCond = [] { return false; });
     bool IsAsyncVerifyInProgress();
 
+    // Recovers the threshold signature from the given shares and, if verifyPubKey is valid, verifies it against msgHash
+    // The result is invalid if either of both failed
+    void AsyncRecoverSig(BLSSignatureVector sigShares, BLSIdVector ids, const CBLSPublicKey& verifyPubKey, const uint256& msgHash, SignDoneCallback doneCallback);
+    std::future<CBLSSignature> AsyncRecoverSig(BLSSignatureVector sigShares, BLSIdVector ids, const CBLSPublicKey& verifyPubKey, const uint256& msgHash);
+
 private:
     void PushSigVerifyBatch();
 };
@@ -181,6 +190,22 @@ public:
             return worker.BuildPubKeyShare(vvec, id);
         });
     }
+    // Same as above, but tries load before building the share and hands a freshly built share to save
+    CBLSPublicKey BuildPubKeyShare(const uint256& cacheKey, const BLSVerificationVectorPtr& vvec, const CBLSId& id,
+                                   const std::function<bool(CBLSPublicKey&)>& load, const std::function<void(const CBLSPublicKey&)>& save)
+    {
+        return GetOrBuild(cacheKey, publicKeyShareCache, [&]() {
+            CBLSPublicKey pubKeyShare;
+            if (load(pubKeyShare)) {
+                return pubKeyShare;
+            }
+            pubKeyShare = worker.BuildPubKeyShare(vvec, id);
+            if (pubKeyShare.IsValid()) {
+                save(pubKeyShare);
+            }
+            return pubKeyShare;
+        });
+    }
 
 private:
     template <typename T, typename Builder>
@@ -7,10 +7,16 @@
 #ifndef CACHEMAP_H_
 #define CACHEMAP_H_
 
-#include <map>
-#include <list>
 #include <cstddef>
-
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "memusage.h"
 #include "serialize.h"
 
 /**
@@ -40,11 +46,329 @@ struct CacheItem
     }
 };
 
+/**
+ * The items of a CacheMap or CacheMultiMap, newest first.
+ *
+ * A doubly linked list threaded through nodes that live in fixed size chunks and are addressed
+ * by index. Erased nodes are kept on a free list and reused, so once a cache is full evicting
+ * and inserting doesn't allocate at all (besides what the items themselves allocate). Items are
+ * constructed in place and never move, references to them stay valid until they are erased,
+ * like with the std::list this replaces. Iterates and serializes the same way.
+ */
+template<typename T>
+class CacheItemList
+{
+public:
+    typedef uint32_t index_t;
+    static const index_t NONE = std::numeric_limits<index_t>::max();
+
+private:
+    static const index_t CHUNK_SIZE = 64;
+
+    struct Node {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+        index_t prev;
+        index_t next;
+
+        T& Item() { return *reinterpret_cast<T*>(&storage); }
+        const T& Item() const { return *reinterpret_cast<const T*>(&storage); }
+    };
+
+    std::vector<std::unique_ptr<Node[]>> vecChunks;
+    index_t nUsed{0};
+    index_t nFree{NONE};
+    index_t nHead{NONE};
+    index_t nTail{NONE};
+    size_t nSize{0};
+
+    Node& GetNode(index_t n) { return vecChunks[n / CHUNK_SIZE][n % CHUNK_SIZE]; }
+    const Node& GetNode(index_t n) const { return vecChunks[n / CHUNK_SIZE][n % CHUNK_SIZE]; }
+
+    index_t NewNode(const T& item)
+    {
+        index_t n = nFree;
+        if (n != NONE) {
+            nFree = GetNode(n).next;
+        } else {
+            if (nUsed == vecChunks.size() * CHUNK_SIZE) {
+                vecChunks.emplace_back(new Node[CHUNK_SIZE]);
+            }
+            n = nUsed++;
+        }
+        new (&GetNode(n).storage) T(item);
+        nSize++;
+        return n;
+    }
+
+public:
+    class const_iterator : public std::iterator<std::bidirectional_iterator_tag, const T>
+    {
+        const CacheItemList* list;
+        index_t n;
+
+    public:
+        const_iterator() : list(nullptr), n(NONE) {}
+        const_iterator(const CacheItemList* listIn, index_t nIn) : list(listIn), n(nIn) {}
+
+        const T& operator*() const { return list->GetNode(n).Item(); }
+        const T* operator->() const { return &list->GetNode(n).Item(); }
+        const_iterator& operator++() { n = list->GetNode(n).next; return *this; }
+        const_iterator operator++(int) { const_iterator copy(*this); ++(*this); return copy; }
+        const_iterator& operator--() { n = n == NONE ? list->nTail : list->GetNode(n).prev; return *this; }
+        const_iterator operator--(int) { const_iterator copy(*this); --(*this); return copy; }
+        bool operator==(const_iterator other) const { return n == other.n; }
+        bool operator!=(const_iterator other) const { return n != other.n; }
+
+        index_t GetIndex() const { return n; }
+    };
+
+    CacheItemList() {}
+
+    ~CacheItemList()
+    {
+        clear();
+    }
+
+    CacheItemList(const CacheItemList& other)
+    {
+        *this = other;
+    }
+
+    CacheItemList& operator=(const CacheItemList& other)
+    {
+        if (this != &other) {
+            clear();
+            for (index_t n = other.nHead; n != NONE; n = other.GetNode(n).next) {
+                push_back(other.GetNode(n).Item());
+            }
+        }
+        return *this;
+    }
+
+    const_iterator begin() const { return const_iterator(this, nHead); }
+    const_iterator end() const { return const_iterator(this, NONE); }
+    size_t size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+
+    T& operator[](index_t n) { return GetNode(n).Item(); }
+    const T& operator[](index_t n) const { return GetNode(n).Item(); }
+
+    index_t front_index() const { return nHead; }
+    index_t back_index() const { return nTail; }
+
+    index_t push_front(const T& item)
+    {
+        index_t n = NewNode(item);
+        Node& node = GetNode(n);
+        node.prev = NONE;
+        node.next = nHead;
+        if (nHead != NONE) {
+            GetNode(nHead).prev = n;
+        } else {
+            nTail = n;
+        }
+        nHead = n;
+        return n;
+    }
+
+    index_t push_back(const T& item)
+    {
+        index_t n = NewNode(item);
+        Node& node = GetNode(n);
+        node.prev = nTail;
+        node.next = NONE;
+        if (nTail != NONE) {
+            GetNode(nTail).next = n;
+        } else {
+            nHead = n;
+        }
+        nTail = n;
+        return n;
+    }
+
+    void erase(index_t n)
+    {
+        Node& node = GetNode(n);
+        if (node.prev != NONE) {
+            GetNode(node.prev).next = node.next;
+        } else {
+            nHead = node.next;
+        }
+        if (node.next != NONE) {
+            GetNode(node.next).prev = node.prev;
+        } else {
+            nTail = node.prev;
+        }
+        // the node itself is kept for the next insert
+        node.Item().~T();
+        node.next = nFree;
+        nFree = n;
+        nSize--;
+    }
+
+    void clear()
+    {
+        for (index_t n = nHead; n != NONE; n = GetNode(n).next) {
+            GetNode(n).Item().~T();
+        }
+        vecChunks.clear();
+        nUsed = 0;
+        nFree = nHead = nTail = NONE;
+        nSize = 0;
+    }
+
+    //! Memory taken by the nodes, not counting what the items allocate themselves
+    size_t DynamicMemoryUsage() const
+    {
+        return memusage::DynamicUsage(vecChunks) + vecChunks.size() * memusage::MallocUsage(sizeof(Node) * CHUNK_SIZE);
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        WriteCompactSize(s, nSize);
+        for (index_t n = nHead; n != NONE; n = GetNode(n).next) {
+            s << GetNode(n).Item();
+        }
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        clear();
+        uint64_t nCount = ReadCompactSize(s);
+        T item;
+        for (uint64_t i = 0; i < nCount; i++) {
+            s >> item;
+            push_back(item);
+        }
+    }
+};
+
+/**
+ * Open addressing hash index into a CacheItemList, from a key to the index of a node.
+ *
+ * Linear probing with backward shift deletion, so there are no tombstones to clean up and
+ * lookups stay short under constant insert/erase churn. The keys themselves are not stored,
+ * only the node index and 32 bits of the hash, which also make resizing cheap. Callers pass
+ * the hash and a predicate telling whether a node holds the key they look for.
+ */
+class CacheIndex
+{
+public:
+    typedef uint32_t index_t;
+    static const index_t NONE = std::numeric_limits<index_t>::max();
+
+private:
+    struct Slot {
+        index_t node;
+        uint32_t hash;
+    };
+
+    std::vector<Slot> vecSlots;
+    size_t nCount{0};
+
+    size_t Mask() const { return vecSlots.size() - 1; }
+
+    void Resize(size_t nSlots)
+    {
+        std::vector<Slot> vecOld(nSlots, Slot{NONE, 0});
+        vecOld.swap(vecSlots);
+        for (const Slot& slot : vecOld) {
+            if (slot.node != NONE) {
+                size_t i = slot.hash & Mask();
+                while (vecSlots[i].node != NONE) {
+                    i = (i + 1) & Mask();
+                }
+                vecSlots[i] = slot;
+            }
+        }
+    }
+
+public:
+    size_t size() const { return nCount; }
+
+    void clear()
+    {
+        vecSlots.clear();
+        nCount = 0;
+    }
+
+    //! The node eq returns true for, or NONE
+    template<typename Eq>
+    index_t Find(size_t nHash, Eq eq) const
+    {
+        if (vecSlots.empty()) {
+            return NONE;
+        }
+        for (size_t i = (uint32_t)nHash & Mask(); vecSlots[i].node != NONE; i = (i + 1) & Mask()) {
+            if (vecSlots[i].hash == (uint32_t)nHash && eq(vecSlots[i].node)) {
+                return vecSlots[i].node;
+            }
+        }
+        return NONE;
+    }
+
+    //! Does not check for duplicates
+    void Insert(size_t nHash, index_t node)
+    {
+        // at most half full
+        if ((nCount + 1) * 2 > vecSlots.size()) {
+            Resize(std::max<size_t>(16, vecSlots.size() * 2));
+        }
+        size_t i = (uint32_t)nHash & Mask();
+        while (vecSlots[i].node != NONE) {
+            i = (i + 1) & Mask();
+        }
+        vecSlots[i] = Slot{node, (uint32_t)nHash};
+        nCount++;
+    }
+
+    //! Points the entry of node at nodeNew instead
+    void Replace(size_t nHash, index_t node, index_t nodeNew)
+    {
+        for (size_t i = (uint32_t)nHash & Mask(); vecSlots[i].node != NONE; i = (i + 1) & Mask()) {
+            if (vecSlots[i].node == node) {
+                vecSlots[i].node = nodeNew;
+                return;
+            }
+        }
+    }
+
+    void Erase(size_t nHash, index_t node)
+    {
+        if (vecSlots.empty()) {
+            return;
+        }
+        size_t i = (uint32_t)nHash & Mask();
+        while (vecSlots[i].node != node) {
+            if (vecSlots[i].node == NONE) {
+                return;
+            }
+            i = (i + 1) & Mask();
+        }
+        // move back every following entry of the run that would no longer be found otherwise
+        for (size_t j = (i + 1) & Mask(); vecSlots[j].node != NONE; j = (j + 1) & Mask()) {
+            size_t k = vecSlots[j].hash & Mask();
+            if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+                vecSlots[i] = vecSlots[j];
+                i = j;
+            }
+        }
+        vecSlots[i].node = NONE;
+        nCount--;
+    }
+
+    size_t DynamicMemoryUsage() const
+    {
+        return memusage::DynamicUsage(vecSlots);
+    }
+};
 
 /**
  * Map like container that keeps the N most recently added items
  */
-template<typename K, typename V, typename Size = uint32_t>
+template<typename K, typename V, typename Hasher = std::hash<K>, typename Size = uint32_t>
 class CacheMap
 {
 public:
@@ -52,43 +376,44 @@ public:
 
     typedef CacheItem<K,V> item_t;
 
-    typedef std::list<item_t> list_t;
+    typedef CacheItemList<item_t> list_t;
 
-    typedef typename list_t::iterator list_it;
+    typedef typename list_t::const_iterator list_it;
 
     typedef typename list_t::const_iterator list_cit;
 
-    typedef std::map<K, list_it> map_t;
-
-    typedef typename map_t::iterator map_it;
-
-    typedef typename map_t::const_iterator map_cit;
-
 private:
     size_type nMaxSize;
 
     list_t listItems;
 
-    map_t mapIndex;
+    CacheIndex index;
+
+    Hasher hasher;
+
+    CacheIndex::index_t Find(const K& key, size_t nHash) const
+    {
+        return index.Find(nHash, [&](CacheIndex::index_t n) { return listItems[n].key == key; });
+    }
 
 public:
     CacheMap(size_type nMaxSizeIn = 0)
         : nMaxSize(nMaxSizeIn),
           listItems(),
-          mapIndex()
+          index()
     {}
 
-    CacheMap(const CacheMap<K,V>& other)
+    CacheMap(const CacheMap& other)
         : nMaxSize(other.nMaxSize),
           listItems(other.listItems),
-          mapIndex()
+          index()
     {
         RebuildIndex();
     }
 
     void Clear()
     {
-        mapIndex.clear();
+        index.clear();
         listItems.clear();
     }
 
@@ -105,50 +430,55 @@ public:
         return listItems.size();
     }
 
+    //! Not counting what the keys and values allocate themselves
+    size_t DynamicMemoryUsage() const {
+        return listItems.DynamicMemoryUsage() + index.DynamicMemoryUsage();
+    }
+
     bool Insert(const K& key, const V& value)
     {
-        if(mapIndex.find(key) != mapIndex.end()) {
+        size_t nHash = hasher(key);
+        if(Find(key, nHash) != CacheIndex::NONE) {
             return false;
         }
         if(listItems.size() == nMaxSize) {
             PruneLast();
         }
-        listItems.push_front(item_t(key, value));
-        mapIndex.emplace(key, listItems.begin());
+        index.Insert(nHash, listItems.push_front(item_t(key, value)));
         return true;
     }
 
     bool HasKey(const K& key) const
     {
-        return (mapIndex.find(key) != mapIndex.end());
+        return Find(key, hasher(key)) != CacheIndex::NONE;
     }
 
     bool Get(const K& key, V& value) const
     {
-        map_cit it = mapIndex.find(key);
-        if(it == mapIndex.end()) {
+        CacheIndex::index_t n = Find(key, hasher(key));
+        if(n == CacheIndex::NONE) {
             return false;
         }
-        item_t& item = *(it->second);
-        value = item.value;
+        value = listItems[n].value;
         return true;
     }
 
     void Erase(const K& key)
     {
-        map_it it = mapIndex.find(key);
-        if(it == mapIndex.end()) {
+        size_t nHash = hasher(key);
+        CacheIndex::index_t n = Find(key, nHash);
+        if(n == CacheIndex::NONE) {
             return;
         }
-        listItems.erase(it->second);
-        mapIndex.erase(it);
+        index.Erase(nHash, n);
+        listItems.erase(n);
     }
 
     const list_t& GetItemList() const {
         return listItems;
     }
 
-    CacheMap<K,V>& operator=(const CacheMap<K,V>& other)
+    CacheMap& operator=(const CacheMap& other)
     {
         nMaxSize = other.nMaxSize;
         listItems = other.listItems;
@@ -174,16 +504,16 @@ private:
         if(listItems.empty()) {
             return;
         }
-        item_t& item = listItems.back();
-        mapIndex.erase(item.key);
-        listItems.pop_back();
+        CacheIndex::index_t n = listItems.back_index();
+        index.Erase(hasher(listItems[n].key), n);
+        listItems.erase(n);
     }
 
     void RebuildIndex()
     {
-        mapIndex.clear();
-        for(list_it it = listItems.begin(); it != listItems.end(); ++it) {
-            mapIndex.emplace(it->key, it);
+        index.clear();
+        for(list_cit it = listItems.begin(); it != listItems.end(); ++it) {
+            index.Insert(hasher(it->key), it.GetIndex());
         }
     }
 };
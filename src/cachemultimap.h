@@ -7,19 +7,22 @@
 #ifndef CACHEMULTIMAP_H_
 #define CACHEMULTIMAP_H_
 
+#include <algorithm>
 #include <cstddef>
-#include <map>
-#include <list>
-#include <set>
+#include <functional>
+#include <vector>
 
 #include "serialize.h"
 
 #include "cachemap.h"
 
 /**
- * Map like container that keeps the N most recently added items
+ * Map like container that keeps the N most recently added items, several values per key.
+ *
+ * Values are told apart by operator<, like the std::map they used to be indexed with. The
+ * values of a key are chained through their nodes, so this assumes few values per key.
  */
-template<typename K, typename V, typename Size = uint32_t>
+template<typename K, typename V, typename Hasher = std::hash<K>, typename Size = uint32_t>
 class CacheMultiMap
 {
 public:
@@ -27,49 +30,103 @@ public:
 
     typedef CacheItem<K,V> item_t;
 
-    typedef std::list<item_t> list_t;
+    typedef CacheItemList<item_t> list_t;
 
-    typedef typename list_t::iterator list_it;
+    typedef typename list_t::const_iterator list_it;
 
     typedef typename list_t::const_iterator list_cit;
 
-    typedef std::map<V,list_it> it_map_t;
+private:
+    typedef CacheIndex::index_t index_t;
 
-    typedef typename it_map_t::iterator it_map_it;
+    //! Links of a node to the other nodes with the same key
+    struct KeyLinks {
+        index_t prev;
+        index_t next;
+    };
 
-    typedef typename it_map_t::const_iterator it_map_cit;
+    size_type nMaxSize;
 
-    typedef std::map<K, it_map_t> map_t;
+    list_t listItems;
 
-    typedef typename map_t::iterator map_it;
+    //! From a key to the newest of its nodes
+    CacheIndex index;
 
-    typedef typename map_t::const_iterator map_cit;
+    //! By node index
+    std::vector<KeyLinks> vecKeyLinks;
 
-private:
-    size_type nMaxSize;
+    Hasher hasher;
 
-    list_t listItems;
+    static bool IsEquivalent(const V& a, const V& b)
+    {
+        return !(a < b) && !(b < a);
+    }
+
+    index_t FindKey(const K& key, size_t nHash) const
+    {
+        return index.Find(nHash, [&](index_t n) { return listItems[n].key == key; });
+    }
+
+    index_t FindValue(index_t nHead, const V& value) const
+    {
+        for (index_t n = nHead; n != CacheIndex::NONE; n = vecKeyLinks[n].next) {
+            if (IsEquivalent(listItems[n].value, value)) {
+                return n;
+            }
+        }
+        return CacheIndex::NONE;
+    }
 
-    map_t mapIndex;
+    void Link(index_t n, size_t nHash, index_t nHead)
+    {
+        if (vecKeyLinks.size() <= n) {
+            vecKeyLinks.resize(n + 1);
+        }
+        vecKeyLinks[n] = KeyLinks{CacheIndex::NONE, nHead};
+        if (nHead != CacheIndex::NONE) {
+            vecKeyLinks[nHead].prev = n;
+            index.Replace(nHash, nHead, n);
+        } else {
+            index.Insert(nHash, n);
+        }
+    }
+
+    void Unlink(index_t n, size_t nHash)
+    {
+        const KeyLinks& links = vecKeyLinks[n];
+        if (links.prev == CacheIndex::NONE) {
+            if (links.next != CacheIndex::NONE) {
+                index.Replace(nHash, n, links.next);
+            } else {
+                index.Erase(nHash, n);
+            }
+        } else {
+            vecKeyLinks[links.prev].next = links.next;
+        }
+        if (links.next != CacheIndex::NONE) {
+            vecKeyLinks[links.next].prev = links.prev;
+        }
+    }
 
 public:
     CacheMultiMap(size_type nMaxSizeIn = 0)
         : nMaxSize(nMaxSizeIn),
           listItems(),
-          mapIndex()
+          index()
     {}
 
-    CacheMultiMap(const CacheMap<K,V>& other)
+    CacheMultiMap(const CacheMultiMap& other)
         : nMaxSize(other.nMaxSize),
           listItems(other.listItems),
-          mapIndex()
+          index()
     {
         RebuildIndex();
     }
 
     void Clear()
     {
-        mapIndex.clear();
+        index.clear();
+        vecKeyLinks.clear();
         listItems.clear();
     }
 
@@ -86,15 +143,15 @@ public:
         return listItems.size();
     }
 
+    //! Not counting what the keys and values allocate themselves
+    size_t DynamicMemoryUsage() const {
+        return listItems.DynamicMemoryUsage() + index.DynamicMemoryUsage() + memusage::DynamicUsage(vecKeyLinks);
+    }
+
     bool Insert(const K& key, const V& value)
     {
-        map_it mit = mapIndex.find(key);
-        if(mit == mapIndex.end()) {
-            mit = mapIndex.emplace(key, it_map_t()).first;
-        }
-        it_map_t& mapIt = mit->second;
-
-        if(mapIt.count(value) > 0) {
+        size_t nHash = hasher(key);
+        if(FindValue(FindKey(key, nHash), value) != CacheIndex::NONE) {
             // Don't insert duplicates
             return false;
         }
@@ -102,91 +159,97 @@ public:
         if(listItems.size() == nMaxSize) {
             PruneLast();
         }
-        listItems.push_front(item_t(key, value));
-        mapIt.emplace(value, listItems.begin());
+        // looked up again, pruning might just have removed the node the index points at
+        index_t nHead = FindKey(key, nHash);
+        Link(listItems.push_front(item_t(key, value)), nHash, nHead);
         return true;
     }
 
     bool HasKey(const K& key) const
     {
-        return (mapIndex.find(key) != mapIndex.end());
+        return FindKey(key, hasher(key)) != CacheIndex::NONE;
     }
 
+    //! The smallest of the values of key
     bool Get(const K& key, V& value) const
     {
-        map_cit it = mapIndex.find(key);
-        if(it == mapIndex.end()) {
+        index_t n = FindKey(key, hasher(key));
+        if(n == CacheIndex::NONE) {
             return false;
         }
-        const it_map_t& mapIt = it->second;
-        const item_t& item = *(mapIt.begin()->second);
-        value = item.value;
+        const V* pValue = &listItems[n].value;
+        for(n = vecKeyLinks[n].next; n != CacheIndex::NONE; n = vecKeyLinks[n].next) {
+            if(listItems[n].value < *pValue) {
+                pValue = &listItems[n].value;
+            }
+        }
+        value = *pValue;
         return true;
     }
 
+    //! Appends the values of key in ascending order
     bool GetAll(const K& key, std::vector<V>& vecValues)
     {
-        map_cit mit = mapIndex.find(key);
-        if(mit == mapIndex.end()) {
+        index_t n = FindKey(key, hasher(key));
+        if(n == CacheIndex::NONE) {
             return false;
         }
-        const it_map_t& mapIt = mit->second;
-
-        for(it_map_cit it = mapIt.begin(); it != mapIt.end(); ++it) {
-            const item_t& item = *(it->second);
-            vecValues.push_back(item.value);
+        std::vector<const V*> vecSorted;
+        for(; n != CacheIndex::NONE; n = vecKeyLinks[n].next) {
+            vecSorted.push_back(&listItems[n].value);
+        }
+        // by pointer, values don't have to be assignable
+        std::sort(vecSorted.begin(), vecSorted.end(), [](const V* a, const V* b) { return *a < *b; });
+        for(const V* pValue : vecSorted) {
+            vecValues.push_back(*pValue);
         }
         return true;
     }
 
+    //! Appends all keys in ascending order
     void GetKeys(std::vector<K>& vecKeys)
     {
-        for(map_cit it = mapIndex.begin(); it != mapIndex.end(); ++it) {
-            vecKeys.push_back(it->first);
+        size_t nStart = vecKeys.size();
+        for(list_cit it = listItems.begin(); it != listItems.end(); ++it) {
+            if(vecKeyLinks[it.GetIndex()].prev == CacheIndex::NONE) {
+                vecKeys.push_back(it->key);
+            }
         }
+        std::sort(vecKeys.begin() + nStart, vecKeys.end());
     }
 
     void Erase(const K& key)
     {
-        map_it mit = mapIndex.find(key);
-        if(mit == mapIndex.end()) {
+        size_t nHash = hasher(key);
+        index_t n = FindKey(key, nHash);
+        if(n == CacheIndex::NONE) {
             return;
         }
-        it_map_t& mapIt = mit->second;
-
-        for(it_map_it it = mapIt.begin(); it != mapIt.end(); ++it) {
-            listItems.erase(it->second);
+        index.Erase(nHash, n);
+        while(n != CacheIndex::NONE) {
+            index_t nNext = vecKeyLinks[n].next;
+            listItems.erase(n);
+            n = nNext;
         }
-
-        mapIndex.erase(mit);
     }
 
     void Erase(const K& key, const V& value)
     {
-        map_it mit = mapIndex.find(key);
-        if(mit == mapIndex.end()) {
-            return;
-        }
-        it_map_t& mapIt = mit->second;
-
-        it_map_it it = mapIt.find(value);
-        if(it == mapIt.end()) {
+        size_t nHash = hasher(key);
+        index_t n = FindValue(FindKey(key, nHash), value);
+        if(n == CacheIndex::NONE) {
             return;
         }
-
-        listItems.erase(it->second);
-        mapIt.erase(it);
-
-        if(mapIt.empty()) {
-            mapIndex.erase(mit);
-        }
+        Unlink(n, nHash);
+        // last, key and value may refer to the item itself
+        listItems.erase(n);
     }
 
     const list_t& GetItemList() const {
         return listItems;
     }
 
-    CacheMap<K,V>& operator=(const CacheMap<K,V>& other)
+    CacheMultiMap& operator=(const CacheMultiMap& other)
     {
         nMaxSize = other.nMaxSize;
         listItems = other.listItems;
@@ -212,37 +275,31 @@ private:
         if(listItems.empty()) {
             return;
         }
-
-        list_it lit = listItems.end();
-        --lit;
-        item_t& item = *lit;
-
-        map_it mit = mapIndex.find(item.key);
-
-        if(mit != mapIndex.end()) {
-            it_map_t& mapIt = mit->second;
-
-            mapIt.erase(item.value);
-
-            if(mapIt.empty()) {
-                mapIndex.erase(item.key);
-            }
-        }
-
-        listItems.pop_back();
+        index_t n = listItems.back_index();
+        Unlink(n, hasher(listItems[n].key));
+        listItems.erase(n);
     }
 
     void RebuildIndex()
     {
-        mapIndex.clear();
-        for(list_it lit = listItems.begin(); lit != listItems.end(); ++lit) {
-            item_t& item = *lit;
-            map_it mit = mapIndex.find(item.key);
-            if(mit == mapIndex.end()) {
-                mit = mapIndex.emplace(item.key, it_map_t()).first;
+        index.clear();
+        vecKeyLinks.clear();
+        std::vector<index_t> vecNodes;
+        vecNodes.reserve(listItems.size());
+        for(list_cit it = listItems.begin(); it != listItems.end(); ++it) {
+            vecNodes.push_back(it.GetIndex());
+        }
+        // the order within a key doesn't matter, all lookups go over every value of it
+        for(index_t n : vecNodes) {
+            const item_t& item = listItems[n];
+            size_t nHash = hasher(item.key);
+            index_t nHead = FindKey(item.key, nHash);
+            if(FindValue(nHead, item.value) != CacheIndex::NONE) {
+                // an older duplicate could never be found or erased, drop it
+                listItems.erase(n);
+                continue;
             }
-            it_map_t& mapIt = mit->second;
-            mapIt.emplace(item.value, lit);
+            Link(n, nHash, nHead);
         }
     }
 };
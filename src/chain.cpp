@@ -66,6 +66,26 @@ CBlockIndex* CChain::FindEarliestAtLeast(int64_t nTime) const
     return (lower == vChain.end() ? NULL : *lower);
 }
 
+void CChain::FindByTimestamp(int64_t nTimeLow, int64_t nTimeHigh, std::vector<CBlockIndex*>& vRet) const
+{
+    vRet.clear();
+    if (nTimeLow > nTimeHigh) {
+        return;
+    }
+    for (CBlockIndex* pindex = FindEarliestAtLeast(nTimeLow); pindex; pindex = Next(pindex)) {
+        if (pindex->GetBlockTime() >= nTimeLow && pindex->GetBlockTime() <= nTimeHigh) {
+            vRet.push_back(pindex);
+        }
+        if (pindex->GetMedianTimePast() > nTimeHigh) {
+            break;
+        }
+    }
+    std::sort(vRet.begin(), vRet.end(), [](const CBlockIndex* a, const CBlockIndex* b) {
+        if (a->nTime != b->nTime) return a->nTime < b->nTime;
+        return a->GetBlockHash() < b->GetBlockHash();
+    });
+}
+
 /** Turn the lowest '1' bit in the binary representation of a number into a '0'. */
 int static inline InvertLowestOne(int n) { return n & (n - 1); }
 
@@ -125,6 +145,15 @@ void CBlockIndex::SetStakeModifier(uint64_t nModifier, bool fGeneratedStakeModif
     nStakeModifier = nModifier;
     if (fGeneratedStakeModifier)
         nFlags |= BLOCK_STAKE_MODIFIER;
+    BuildStakeModifierLast();
+}
+
+void CBlockIndex::BuildStakeModifierLast()
+{
+    if (GeneratedStakeModifier())
+        pstakeModifierLast = this;
+    else
+        pstakeModifierLast = pprev ? pprev->pstakeModifierLast : NULL;
 }
 
 void CBlockIndex::BuildSkip()
@@ -13,6 +13,7 @@
 #include "uint256.h"
 #include "util.h"
 
+#include <utility>
 #include <vector>
 
 /**
@@ -219,6 +220,7 @@ public:
     arith_uint256 GetBlockTrust() const;
     uint64_t nStakeModifier;             // hash modifier for proof-of-stake
     unsigned int nStakeModifierChecksum; // checksum of index; in-memeory only
+    const CBlockIndex* pstakeModifierLast; // last block up to and including this one which generated a stake modifier; in-memory only
     COutPoint prevoutStake;
     unsigned int nStakeTime;
     uint256 hashProofOfStake;
@@ -259,6 +261,7 @@ public:
         nFlags = 0;
         nStakeModifier = 0;
         nStakeModifierChecksum = 0;
+        pstakeModifierLast = NULL;
         hashProofOfStake = uint256();
         prevoutStake.SetNull();
         nStakeTime = 0;
@@ -332,6 +335,8 @@ public:
         block.nTime          = nTime;
         block.nBits          = nBits;
         block.nNonce         = nNonce;
+        if (phashBlock)
+            block.SetHashCache(*phashBlock);
         return block;
     }
 
@@ -398,6 +403,9 @@ public:
 
     void SetStakeModifier(uint64_t nModifier, bool fGeneratedStakeModifier);
 
+    //! Link pstakeModifierLast, requires pprev to be linked already
+    void BuildStakeModifierLast();
+
     std::string ToString() const
     {
         return strprintf("CBlockIndex(pprev=%p, nHeight=%d, merkle=%s, hashBlock=%s)",
@@ -527,6 +535,53 @@ public:
     }
 };
 
+/** Allocates block index entries in chunks instead of one heap allocation each.
+ * Entries are never freed one by one, only all at once with Clear() when the whole
+ * block index is unloaded, and their addresses stay stable until then. Entries
+ * allocated one after another, e.g. during header sync, end up next to each other,
+ * which helps walking pprev/pskip.
+ */
+class CBlockIndexArena
+{
+public:
+    static const size_t CHUNK_SIZE = 4096;
+
+    template<typename... Args>
+    CBlockIndex* Allocate(Args&&... args)
+    {
+        if (vChunks.empty() || vChunks.back().size() == CHUNK_SIZE) {
+            vChunks.emplace_back();
+            vChunks.back().reserve(CHUNK_SIZE);
+        }
+        // Never exceeds the reserved capacity, so earlier entries don't move
+        vChunks.back().emplace_back(std::forward<Args>(args)...);
+        return &vChunks.back().back();
+    }
+
+    void Clear()
+    {
+        vChunks.clear();
+    }
+
+    size_t Size() const
+    {
+        return vChunks.empty() ? 0 : (vChunks.size() - 1) * CHUNK_SIZE + vChunks.back().size();
+    }
+
+    size_t Chunks() const
+    {
+        return vChunks.size();
+    }
+
+    size_t DynamicUsage() const
+    {
+        return vChunks.size() * (CHUNK_SIZE * sizeof(CBlockIndex) + sizeof(std::vector<CBlockIndex>));
+    }
+
+private:
+    std::vector<std::vector<CBlockIndex>> vChunks;
+};
+
 /** An in-memory indexed chain of blocks. */
 class CChain {
 private:
@@ -585,6 +640,13 @@ public:
 
     /** Find the earliest block with timestamp equal or greater than the given. */
     CBlockIndex* FindEarliestAtLeast(int64_t nTime) const;
+
+    /**
+     * Find the blocks with a timestamp in [nTimeLow, nTimeHigh], ordered by timestamp and
+     * then hash like the timestamp index. Starts with a binary search on nTimeMax and stops
+     * once the median time past passes nTimeHigh, as no later block can be older.
+     */
+    void FindByTimestamp(int64_t nTimeLow, int64_t nTimeHigh, std::vector<CBlockIndex*>& vRet) const;
 };
 
 #endif // BITCOIN_CHAIN_H
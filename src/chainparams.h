@@ -30,6 +30,15 @@ struct CCheckpointData {
     MapCheckpoints mapCheckpoints;
 };
 
+/** The UTXO set after a block, for checking snapshots written by dumptxoutset */
+struct AssumeutxoData {
+    uint256 hashBlock;
+    //! As reported by gettxoutsetinfo "muhash"
+    uint256 hashMuHash;
+};
+
+typedef std::map<int, AssumeutxoData> MapAssumeutxo;
+
 struct ChainTxData {
     int64_t nTime;
     int64_t nTxCount;
@@ -87,6 +96,7 @@ public:
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
     const ChainTxData& TxData() const { return chainTxData; }
+    const MapAssumeutxo& Assumeutxo() const { return mapAssumeutxo; }
     int PoolMinParticipants() const { return nPoolMinParticipants; }
     int PoolMaxParticipants() const { return nPoolMaxParticipants; }
     int FulfilledRequestExpireTime() const { return nFulfilledRequestExpireTime; }
@@ -118,6 +128,7 @@ protected:
     bool fAllowMultiplePorts;
     CCheckpointData checkpointData;
     ChainTxData chainTxData;
+    MapAssumeutxo mapAssumeutxo;
     int nPoolMinParticipants;
     int nPoolMaxParticipants;
     int nFulfilledRequestExpireTime;
@@ -6,6 +6,9 @@
 #define BITCOIN_CHECKQUEUE_H
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
 #include <vector>
 
 #include <boost/foreach.hpp>
@@ -25,6 +28,12 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * With work queues configured, every worker has its own queue and lock
+  * instead of sharing a single one. Add spreads the checks over all queues,
+  * workers take adaptively sized batches from their own queue and steal
+  * half of another queue when theirs runs dry, so the shared mutex is only
+  * touched to sleep and wake up.
   */
 template <typename T>
 class CCheckQueue
@@ -65,6 +74,106 @@ private:
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    //! Per-worker queue for the work-stealing mode
+    struct WorkQueue {
+        boost::mutex mutex;
+        std::vector<T> queue;
+        //! Size of queue, readable without the lock to skip empty queues
+        std::atomic<unsigned int> nSize{0};
+    };
+
+    //! Work queues, the master uses the first one. Empty when all workers share queue.
+    std::vector<std::unique_ptr<WorkQueue> > vWorkQueues;
+
+    //! Work-stealing counterparts of nTodo/fAllOk, plus the number of checks still queued
+    std::atomic<unsigned int> nTodoStealing;
+    std::atomic<unsigned int> nQueued;
+    std::atomic<bool> fAllOkStealing;
+
+    //! Hands out work queues to the worker threads
+    std::atomic<unsigned int> nNextWorker;
+
+    //! Queue in which Add starts spreading checks
+    unsigned int nNextQueue;
+
+    /** Move a batch out of the given worker's queue, or out of another one if it is empty. */
+    unsigned int TakeBatch(unsigned int nId, std::vector<T>& vChecks)
+    {
+        for (unsigned int i = 0; i < vWorkQueues.size(); i++) {
+            WorkQueue& work = *vWorkQueues[(nId + i) % vWorkQueues.size()];
+            if (work.nSize == 0)
+                continue;
+            boost::unique_lock<boost::mutex> lock(work.mutex);
+            if (work.queue.empty())
+                continue;
+            // Take half of what is there, so batches get smaller as the queue
+            // drains and a thief leaves the rest to the owner.
+            unsigned int nNow = std::max(1U, std::min(nBatchSize, (unsigned int)work.queue.size() / 2));
+            vChecks.resize(nNow);
+            for (unsigned int j = 0; j < nNow; j++) {
+                vChecks[j].swap(work.queue.back());
+                work.queue.pop_back();
+            }
+            work.nSize = work.queue.size();
+            nQueued -= nNow;
+            return nNow;
+        }
+        return 0;
+    }
+
+    /** Run a batch and account for it, returns whether the last outstanding check was done. */
+    bool RunBatch(std::vector<T>& vChecks)
+    {
+        bool fOk = fAllOkStealing;
+        BOOST_FOREACH (T& check, vChecks)
+            if (fOk)
+                fOk = check();
+        if (!fOk)
+            fAllOkStealing = false;
+        unsigned int nNow = vChecks.size();
+        vChecks.clear();
+        return (nTodoStealing -= nNow) == 0;
+    }
+
+    /** Work-stealing version of Loop. */
+    bool LoopStealing(unsigned int nId, bool fMaster = false)
+    {
+        std::vector<T> vChecks;
+        vChecks.reserve(nBatchSize);
+        do {
+            if (TakeBatch(nId, vChecks)) {
+                if (RunBatch(vChecks) && !fMaster) {
+                    // We processed the last element; inform the master it can exit and return the result
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    condMaster.notify_one();
+                }
+                continue;
+            }
+            if (nQueued != 0) {
+                // Checks are counted before Add has pushed them
+                std::this_thread::yield();
+                continue;
+            }
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (fMaster) {
+                while (nTodoStealing != 0 && nQueued == 0)
+                    condMaster.wait(lock);
+                if (nTodoStealing == 0) {
+                    bool fRet = fAllOkStealing;
+                    // reset the status for new work later
+                    fAllOkStealing = true;
+                    return fRet;
+                }
+            } else {
+                while (nQueued == 0) {
+                    if (fQuit)
+                        return fAllOkStealing;
+                    condWorker.wait(lock);
+                }
+            }
+        } while (true);
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
@@ -126,28 +235,87 @@ private:
         } while (true);
     }
 
+    //! Work-stealing version of Add, spreads the checks evenly over the work queues
+    void AddStealing(std::vector<T>& vChecks)
+    {
+        if (vChecks.empty())
+            return;
+        // Count first, so nobody sees fewer queued checks than can be taken
+        nTodoStealing += vChecks.size();
+        nQueued += vChecks.size();
+        size_t nChunk = (vChecks.size() + vWorkQueues.size() - 1) / vWorkQueues.size();
+        for (size_t nFirst = 0; nFirst < vChecks.size(); nFirst += nChunk) {
+            WorkQueue& work = *vWorkQueues[nNextQueue];
+            nNextQueue = (nNextQueue + 1) % vWorkQueues.size();
+            boost::unique_lock<boost::mutex> lock(work.mutex);
+            for (size_t i = nFirst; i < std::min(nFirst + nChunk, vChecks.size()); i++) {
+                work.queue.push_back(T());
+                vChecks[i].swap(work.queue.back());
+            }
+            work.nSize = work.queue.size();
+        }
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (vChecks.size() == 1)
+            condWorker.notify_one();
+        else
+            condWorker.notify_all();
+    }
+
 public:
     //! Mutex to ensure only one concurrent CCheckQueueControl
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    CCheckQueue(unsigned int nBatchSizeIn, unsigned int nWorkQueues = 0) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn),
+        nTodoStealing(0), nQueued(0), fAllOkStealing(true), nNextWorker(0), nNextQueue(0)
+    {
+        Configure(nBatchSizeIn, nWorkQueues);
+    }
+
+    /**
+     * Set the batch size, and the number of work queues for the work-stealing
+     * mode (one per thread including the master, 0 to share a single queue).
+     * Only call while no worker threads are running.
+     */
+    void Configure(unsigned int nBatchSizeIn, unsigned int nWorkQueues)
+    {
+        nBatchSize = std::max(1U, nBatchSizeIn);
+        vWorkQueues.clear();
+        for (unsigned int i = 0; i < nWorkQueues; i++)
+            vWorkQueues.emplace_back(new WorkQueue());
+        nNextWorker = 0;
+        nNextQueue = 0;
+    }
+
+    bool IsWorkStealing() const { return !vWorkQueues.empty(); }
 
     //! Worker thread
     void Thread()
     {
-        Loop();
+        if (IsWorkStealing()) {
+            // Queue 0 belongs to the master, spread any extra threads over the others
+            unsigned int nId = vWorkQueues.size() > 1 ? 1 + nNextWorker++ % (vWorkQueues.size() - 1) : 0;
+            LoopStealing(nId);
+        } else {
+            Loop();
+        }
     }
 
     //! Wait until execution finishes, and return whether all evaluations were successful.
     bool Wait()
     {
+        if (IsWorkStealing())
+            return LoopStealing(0, true);
         return Loop(true);
     }
 
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
+        if (IsWorkStealing()) {
+            AddStealing(vChecks);
+            return;
+        }
         boost::unique_lock<boost::mutex> lock(mutex);
         BOOST_FOREACH (T& check, vChecks) {
             queue.push_back(T());
@@ -33,9 +33,81 @@ bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock)
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
 size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
+CCoinsViewPrefetch::CCoinsViewPrefetch(CCoinsView *viewIn, size_t nMaxEntriesIn) : CCoinsViewBacked(viewIn), nGeneration(0), nMaxEntries(nMaxEntriesIn) { }
+
+bool CCoinsViewPrefetch::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        auto it = mapPrefetched.find(outpoint);
+        if (it != mapPrefetched.end()) {
+            // The cache above keeps it from here on
+            coin = std::move(it->second);
+            mapPrefetched.erase(it);
+            return true;
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewPrefetch::HaveCoin(const COutPoint &outpoint) const {
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (mapPrefetched.count(outpoint))
+            return true;
+    }
+    return base->HaveCoin(outpoint);
+}
+
+bool CCoinsViewPrefetch::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        nGeneration++;
+        mapPrefetched.clear();
+    }
+    bool fOk = base->BatchWrite(mapCoins, hashBlock);
+    {
+        // Reads racing with the write may have seen either state
+        std::lock_guard<std::mutex> lock(cs);
+        nGeneration++;
+        mapPrefetched.clear();
+    }
+    return fOk;
+}
+
+void CCoinsViewPrefetch::Prefetch(const std::vector<COutPoint> &vOutPoints) {
+    uint64_t nGenerationStart;
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        nGenerationStart = nGeneration;
+    }
+
+    std::vector<std::pair<COutPoint, Coin> > vCoins;
+    vCoins.reserve(vOutPoints.size());
+    for (const COutPoint &outpoint : vOutPoints) {
+        Coin coin;
+        if (base->GetCoin(outpoint, coin) && !coin.IsSpent())
+            vCoins.emplace_back(outpoint, std::move(coin));
+    }
+
+    std::lock_guard<std::mutex> lock(cs);
+    if (nGeneration != nGenerationStart)
+        return;
+    for (auto &entry : vCoins) {
+        if (mapPrefetched.size() >= nMaxEntries)
+            break;
+        mapPrefetched.emplace(entry.first, std::move(entry.second));
+    }
+}
+
+size_t CCoinsViewPrefetch::Size() const {
+    std::lock_guard<std::mutex> lock(cs);
+    return mapPrefetched.size();
+}
+
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn),
+    cacheCoins(0, SaltedOutpointHasher(), std::equal_to<COutPoint>(), &cacheCoinsMemoryResource), cachedCoinsUsage(0) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
     return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
@@ -205,10 +277,21 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
 bool CCoinsViewCache::Flush() {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
     cacheCoins.clear();
+    ReallocateCache();
     cachedCoinsUsage = 0;
     return fOk;
 }
 
+void CCoinsViewCache::ReallocateCache()
+{
+    // Cache should be empty when we're calling this.
+    assert(cacheCoins.size() == 0);
+    cacheCoins.~CCoinsMap();
+    cacheCoinsMemoryResource.~CCoinsMapMemoryResource();
+    ::new (&cacheCoinsMemoryResource) CCoinsMapMemoryResource();
+    ::new (&cacheCoins) CCoinsMap(0, SaltedOutpointHasher(), std::equal_to<COutPoint>(), &cacheCoinsMemoryResource);
+}
+
 void CCoinsViewCache::Uncache(const COutPoint& hash)
 {
     CCoinsMap::iterator it = cacheCoins.find(hash);
@@ -12,11 +12,13 @@
 #include "hash.h"
 #include "memusage.h"
 #include "serialize.h"
+#include "support/allocators/pool.h"
 #include "uint256.h"
 
 #include <assert.h>
 #include <stdint.h>
 #include <bitset>
+#include <mutex>
 #include <unordered_map>
 
 /**
@@ -118,8 +120,11 @@ public:
      * This *must* return size_t. With Boost 1.46 on 32-bit systems the
      * unordered_map will behave unpredictably if the custom hasher returns a
      * uint64_t, resulting in failures when syncing the chain (#4634).
+     *
+     * Having it noexcept makes libstdc++ recompute the hash instead of storing it
+     * in every node of the coins cache, which keeps the nodes 8 bytes smaller.
      */
-    size_t operator()(const COutPoint& id) const {
+    size_t operator()(const COutPoint& id) const noexcept {
         return SipHashUint256Extra(k0, k1, id.hash, id.n);
     }
 };
@@ -143,7 +148,15 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * The nodes of the coins cache come from a PoolResource, see CCoinsViewCache. The block size
+ * leaves room for the node overhead of the standard library on top of the key/value pair.
+ */
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher, std::equal_to<COutPoint>,
+                           PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                                         sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4>>
+    CCoinsMap;
+typedef CCoinsMap::allocator_type::ResourceType CCoinsMapMemoryResource;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -221,6 +234,32 @@ public:
 };
 
 
+/** CCoinsView layer between the coins cache and the database, holding coins that were read
+ * ahead of time by other threads (see PrefetchBlockInputs). Every entry is handed out once
+ * by GetCoin, and all of them are dropped whenever the database gets written, so it never
+ * returns anything the backing view wouldn't. Unlike the other views this one is thread safe.
+ */
+class CCoinsViewPrefetch : public CCoinsViewBacked
+{
+private:
+    mutable std::mutex cs;
+    mutable std::unordered_map<COutPoint, Coin, SaltedOutpointHasher> mapPrefetched;
+    //! Bumped before and after every BatchWrite, reads that started earlier are discarded
+    uint64_t nGeneration;
+    const size_t nMaxEntries;
+
+public:
+    CCoinsViewPrefetch(CCoinsView *viewIn, size_t nMaxEntriesIn);
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+
+    //! Read the given coins from the backing view and keep the unspent ones for GetCoin
+    void Prefetch(const std::vector<COutPoint> &vOutPoints);
+    size_t Size() const;
+};
+
 /** CCoinsView that adds a memory cache for transactions to another CCoinsView */
 class CCoinsViewCache : public CCoinsViewBacked
 {
@@ -230,6 +269,8 @@ protected:
      * declared as "const".  
      */
     mutable uint256 hashBlock;
+    //! Backs the nodes of cacheCoins, so it has to be declared (and destroyed) around it
+    mutable CCoinsMapMemoryResource cacheCoinsMemoryResource;
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
@@ -317,6 +358,12 @@ public:
     //! Check whether all prevouts of the transaction are present in the UTXO set represented by this view
     bool HaveInputs(const CTransaction& tx) const;
 
+    /**
+     * Drop the empty cache together with all the memory its pool holds, so the memory
+     * usage goes back down after a flush. The cache must not hold any entries.
+     */
+    void ReallocateCache();
+
 private:
     CCoinsMap::iterator FetchCoin(const COutPoint &outpoint) const;
 };
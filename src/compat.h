@@ -47,6 +47,11 @@
 #include <unistd.h>
 #endif
 
+#if defined(HAVE_POLL) && !defined(WIN32)
+#define USE_POLL
+#include <poll.h>
+#endif
+
 #ifdef WIN32
 #define MSG_DONTWAIT        0
 #else
@@ -94,8 +99,9 @@ typedef u_int SOCKET;
 size_t strnlen( const char *start, size_t max_len);
 #endif // HAVE_DECL_STRNLEN
 
+/** Whether a socket can be waited on, which with only select() available means fd < FD_SETSIZE */
 bool static inline IsSelectableSocket(SOCKET s) {
-#ifdef WIN32
+#if defined(WIN32) || defined(USE_POLL)
     return true;
 #else
     return (s < FD_SETSIZE);
@@ -0,0 +1,95 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// AES-NI version of the ECHO-384/512 compression function, bit-exact with
+// echo_big_compress_ref in echo.c. ECHO keeps its 2048 bit state as sixteen
+// AES states in little-endian column order, which is exactly the layout
+// AESENC works on, so each BigSubWords step is two AESENC instructions.
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__amd64__)
+
+#include "crypto/sph_echo.h"
+
+#include <immintrin.h>
+
+namespace echo_aesni
+{
+namespace
+{
+
+/** Multiply every byte by 2 in GF(2^8), like the 0x80/0x7F masks in echo.c */
+__attribute__((target("sse2"))) inline __m128i XTime(__m128i x)
+{
+    const __m128i poly = _mm_set1_epi8(0x1b);
+    __m128i hi = _mm_cmplt_epi8(x, _mm_setzero_si128());
+    return _mm_xor_si128(_mm_add_epi8(x, x), _mm_and_si128(hi, poly));
+}
+
+__attribute__((target("sse2"))) inline void MixColumn(__m128i* W, int ia, int ib, int ic, int id)
+{
+    __m128i a = W[ia], b = W[ib], c = W[ic], d = W[id];
+    __m128i ab = _mm_xor_si128(a, b);
+    __m128i bc = _mm_xor_si128(b, c);
+    __m128i cd = _mm_xor_si128(c, d);
+    __m128i abx = XTime(ab);
+    __m128i bcx = XTime(bc);
+    __m128i cdx = XTime(cd);
+    W[ia] = _mm_xor_si128(abx, _mm_xor_si128(bc, d));
+    W[ib] = _mm_xor_si128(bcx, _mm_xor_si128(a, cd));
+    W[ic] = _mm_xor_si128(cdx, _mm_xor_si128(ab, d));
+    W[id] = _mm_xor_si128(_mm_xor_si128(abx, bcx), _mm_xor_si128(cdx, _mm_xor_si128(ab, c)));
+}
+
+} // namespace
+
+__attribute__((target("aes,sse2"))) void Compress(sph_echo_big_context* sc)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i* V = reinterpret_cast<const __m128i*>(&sc->u);
+    const __m128i* M = reinterpret_cast<const __m128i*>(sc->buf);
+    uint32_t K0 = sc->C0, K1 = sc->C1, K2 = sc->C2, K3 = sc->C3;
+    __m128i W[16];
+
+    for (int u = 0; u < 8; u++) {
+        W[u] = _mm_loadu_si128(V + u);
+        W[u + 8] = _mm_loadu_si128(M + u);
+    }
+
+    for (int r = 0; r < 10; r++) {
+        // BigSubWords, with the 128 bit counter as the first round key
+        for (int n = 0; n < 16; n++) {
+            __m128i K = _mm_set_epi32(K3, K2, K1, K0);
+            W[n] = _mm_aesenc_si128(_mm_aesenc_si128(W[n], K), zero);
+            if (++K0 == 0 && ++K1 == 0 && ++K2 == 0)
+                ++K3;
+        }
+
+        // BigShiftRows
+        __m128i t = W[1];
+        W[1] = W[5]; W[5] = W[9]; W[9] = W[13]; W[13] = t;
+        t = W[2]; W[2] = W[10]; W[10] = t;
+        t = W[6]; W[6] = W[14]; W[14] = t;
+        t = W[15];
+        W[15] = W[11]; W[11] = W[7]; W[7] = W[3]; W[3] = t;
+
+        // BigMixColumns
+        MixColumn(W, 0, 1, 2, 3);
+        MixColumn(W, 4, 5, 6, 7);
+        MixColumn(W, 8, 9, 10, 11);
+        MixColumn(W, 12, 13, 14, 15);
+    }
+
+    __m128i* VOut = reinterpret_cast<__m128i*>(&sc->u);
+    for (int u = 0; u < 8; u++) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(V + u), _mm_loadu_si128(M + u));
+        v = _mm_xor_si128(v, _mm_xor_si128(W[u], W[u + 8]));
+        _mm_storeu_si128(VOut + u, v);
+    }
+}
+
+} // namespace echo_aesni
+
+#endif
@@ -0,0 +1,128 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// Double SHA-256 of four 64-byte inputs at once, one input per 32-bit lane of
+// the SSE registers, for CPUs without AVX2. The same code as sha256_avx2.cpp
+// on half as wide registers.
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__amd64__)
+
+#include "crypto/common.h"
+
+#include <immintrin.h>
+
+namespace sha256d64_sse41
+{
+namespace
+{
+
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+const uint32_t INIT[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+/** K plus the message schedule of the padding block of a 64-byte message */
+struct PaddingSchedule {
+    uint32_t kw[64];
+
+    PaddingSchedule()
+    {
+        uint32_t w[64] = {0x80000000};
+        w[15] = 512;
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = (w[i - 15] >> 7 | w[i - 15] << 25) ^ (w[i - 15] >> 18 | w[i - 15] << 14) ^ (w[i - 15] >> 3);
+            uint32_t s1 = (w[i - 2] >> 17 | w[i - 2] << 15) ^ (w[i - 2] >> 19 | w[i - 2] << 13) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        for (int i = 0; i < 64; i++)
+            kw[i] = K[i] + w[i];
+    }
+};
+
+const PaddingSchedule padding;
+
+__attribute__((target("sse4.1"))) inline __m128i Set(uint32_t x) { return _mm_set1_epi32(x); }
+__attribute__((target("sse4.1"))) inline __m128i Add(__m128i x, __m128i y) { return _mm_add_epi32(x, y); }
+__attribute__((target("sse4.1"))) inline __m128i Xor(__m128i x, __m128i y) { return _mm_xor_si128(x, y); }
+__attribute__((target("sse4.1"))) inline __m128i Rotr(__m128i x, int n) { return _mm_or_si128(_mm_srli_epi32(x, n), _mm_slli_epi32(x, 32 - n)); }
+__attribute__((target("sse4.1"))) inline __m128i Ch(__m128i x, __m128i y, __m128i z) { return Xor(z, _mm_and_si128(x, Xor(y, z))); }
+__attribute__((target("sse4.1"))) inline __m128i Maj(__m128i x, __m128i y, __m128i z) { return _mm_or_si128(_mm_and_si128(x, y), _mm_and_si128(z, _mm_or_si128(x, y))); }
+__attribute__((target("sse4.1"))) inline __m128i Sigma0(__m128i x) { return Xor(Xor(Rotr(x, 2), Rotr(x, 13)), Rotr(x, 22)); }
+__attribute__((target("sse4.1"))) inline __m128i Sigma1(__m128i x) { return Xor(Xor(Rotr(x, 6), Rotr(x, 11)), Rotr(x, 25)); }
+__attribute__((target("sse4.1"))) inline __m128i sigma0(__m128i x) { return Xor(Xor(Rotr(x, 7), Rotr(x, 18)), _mm_srli_epi32(x, 3)); }
+__attribute__((target("sse4.1"))) inline __m128i sigma1(__m128i x) { return Xor(Xor(Rotr(x, 17), Rotr(x, 19)), _mm_srli_epi32(x, 10)); }
+
+/** 64 rounds on s. With w the message words are extended from it, without kw is used as is. */
+__attribute__((target("sse4.1"))) inline void Rounds(__m128i s[8], __m128i* w, const uint32_t* kw)
+{
+    __m128i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; i++) {
+        __m128i k;
+        if (w) {
+            if (i >= 16)
+                w[i & 15] = Add(Add(w[i & 15], sigma0(w[(i + 1) & 15])), Add(w[(i + 9) & 15], sigma1(w[(i + 14) & 15])));
+            k = Add(Set(K[i]), w[i & 15]);
+        } else {
+            k = Set(kw[i]);
+        }
+        __m128i t1 = Add(Add(h, Sigma1(e)), Add(Ch(e, f, g), k));
+        __m128i t2 = Add(Sigma0(a), Maj(a, b, c));
+        h = g; g = f; f = e; e = Add(d, t1);
+        d = c; c = b; b = a; a = Add(t1, t2);
+    }
+    s[0] = Add(s[0], a); s[1] = Add(s[1], b); s[2] = Add(s[2], c); s[3] = Add(s[3], d);
+    s[4] = Add(s[4], e); s[5] = Add(s[5], f); s[6] = Add(s[6], g); s[7] = Add(s[7], h);
+}
+
+} // namespace
+
+__attribute__((target("sse4.1"))) void Transform_4way(unsigned char* out, const unsigned char* in)
+{
+    __m128i s[8], w[16];
+
+    // First hash, the inputs and then their padding
+    for (int i = 0; i < 8; i++)
+        s[i] = Set(INIT[i]);
+    for (int i = 0; i < 16; i++) {
+        const unsigned char* p = in + 4 * i;
+        w[i] = _mm_set_epi32(ReadBE32(p + 192), ReadBE32(p + 128), ReadBE32(p + 64), ReadBE32(p));
+    }
+    Rounds(s, w, nullptr);
+    Rounds(s, nullptr, padding.kw);
+
+    // Second hash of the 32-byte result, padded in the same block
+    for (int i = 0; i < 8; i++) {
+        w[i] = s[i];
+        s[i] = Set(INIT[i]);
+    }
+    w[8] = Set(0x80000000);
+    for (int i = 9; i < 15; i++)
+        w[i] = _mm_setzero_si128();
+    w[15] = Set(256);
+    Rounds(s, w, nullptr);
+
+    // All inputs are read by now, so out may overlap in
+    alignas(16) uint32_t lanes[8][4];
+    for (int i = 0; i < 8; i++)
+        _mm_store_si128((__m128i*)lanes[i], s[i]);
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 8; i++)
+            WriteBE32(out + 32 * j + 4 * i, lanes[i][j]);
+    }
+}
+
+} // namespace sha256d64_sse41
+
+#endif
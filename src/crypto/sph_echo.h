@@ -312,6 +312,13 @@ void sph_echo512_close(void *cc, void *dst);
  */
 void sph_echo512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
+
+/**
+ * Compression function used by ECHO-384 and ECHO-512. It defaults to the
+ * portable implementation and may be replaced at startup by a bit-exact
+ * accelerated one, see X11AutoDetect().
+ */
+extern void (*sph_echo_big_compress)(sph_echo_big_context *sc);
 	
 #ifdef __cplusplus
 }
@@ -15,6 +15,10 @@
 #include <memenv.h>
 #include <stdint.h>
 #include <algorithm>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <tuple>
 
 class CBitcoinLevelDBLogger : public leveldb::Logger {
 public:
@@ -73,14 +77,81 @@ public:
     }
 };
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+CDBTuning::CDBTuning(size_t nCacheSize) :
+    nBlockCacheSize(nCacheSize / 2),
+    nWriteBufferSize(nCacheSize / 4), // up to two write buffers may be held in memory simultaneously
+    nMaxOpenFiles(64),
+    fCompression(false),
+    nBloomBits(10)
+{
+}
+
+// Parses "<name>:<option>=<value>", applying it to tuning if the name matches (or pTuning is null)
+static bool ParseDBTuningArg(const std::string& strArg, const std::string& strName, CDBTuning* pTuning, std::string& strError)
+{
+    size_t nColon = strArg.find(':');
+    size_t nEquals = strArg.find('=', nColon == std::string::npos ? 0 : nColon);
+    if (nColon == std::string::npos || nEquals == std::string::npos || nColon == 0) {
+        strError = strprintf("Invalid -dbtuning=%s, expected <database>:<option>=<value>", strArg);
+        return false;
+    }
+    std::string strDB = strArg.substr(0, nColon);
+    std::string strOption = strArg.substr(nColon + 1, nEquals - nColon - 1);
+    int64_t nValue;
+    if (!ParseInt64(strArg.substr(nEquals + 1), &nValue) || nValue < 0) {
+        strError = strprintf("Invalid value in -dbtuning=%s", strArg);
+        return false;
+    }
+
+    CDBTuning dummy(0);
+    CDBTuning& tuning = (pTuning && strDB == strName) ? *pTuning : dummy;
+    if (strOption == "cache") {
+        tuning.nBlockCacheSize = nValue << 20;
+    } else if (strOption == "writebuffer") {
+        tuning.nWriteBufferSize = nValue << 20;
+    } else if (strOption == "maxopenfiles") {
+        tuning.nMaxOpenFiles = std::max<int64_t>(1, std::min<int64_t>(nValue, std::numeric_limits<int>::max()));
+    } else if (strOption == "compression") {
+        tuning.fCompression = nValue != 0;
+    } else if (strOption == "bloombits") {
+        tuning.nBloomBits = std::min<int64_t>(nValue, 64);
+    } else {
+        strError = strprintf("Unknown option %s in -dbtuning=%s, use cache, writebuffer, maxopenfiles, compression or bloombits", strOption, strArg);
+        return false;
+    }
+    return true;
+}
+
+bool ApplyDBTuningArgs(const std::string& strName, CDBTuning& tuning, std::string& strError)
+{
+    if (!mapMultiArgs.count("-dbtuning"))
+        return true;
+    for (const std::string& strArg : mapMultiArgs.at("-dbtuning")) {
+        if (!ParseDBTuningArg(strArg, strName, &tuning, strError))
+            return false;
+    }
+    return true;
+}
+
+bool CheckDBTuningArgs(std::string& strError)
+{
+    if (!mapMultiArgs.count("-dbtuning"))
+        return true;
+    for (const std::string& strArg : mapMultiArgs.at("-dbtuning")) {
+        if (!ParseDBTuningArg(strArg, "", nullptr, strError))
+            return false;
+    }
+    return true;
+}
+
+static leveldb::Options GetOptions(const CDBTuning& tuning)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
-    options.max_open_files = 64;
+    options.block_cache = leveldb::NewLRUCache(tuning.nBlockCacheSize);
+    options.write_buffer_size = tuning.nWriteBufferSize;
+    options.filter_policy = tuning.nBloomBits > 0 ? leveldb::NewBloomFilterPolicy(tuning.nBloomBits) : nullptr;
+    options.compression = tuning.fCompression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+    options.max_open_files = tuning.nMaxOpenFiles;
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -90,14 +161,27 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+// All open databases, for getdbstats
+static std::mutex cs_openDatabases;
+static std::set<const CDBWrapper*> setOpenDatabases;
+
+CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const std::string& name) :
+    strName(name),
+    strPath(fMemory ? "" : path.string()),
+    tuning(nCacheSize)
 {
     penv = NULL;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    std::string strError;
+    if (!ApplyDBTuningArgs(strName, tuning, strError)) {
+        // already reported by CheckDBTuningArgs at startup
+        LogPrintf("%s: %s, using the defaults\n", __func__, strError);
+        tuning = CDBTuning(nCacheSize);
+    }
+    options = GetOptions(tuning);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -139,10 +223,17 @@ CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, b
     }
 
     LogPrintf("Using obfuscation key for %s: %s\n", path.string(), HexStr(obfuscate_key));
+
+    std::lock_guard<std::mutex> lock(cs_openDatabases);
+    setOpenDatabases.insert(this);
 }
 
 CDBWrapper::~CDBWrapper()
 {
+    {
+        std::lock_guard<std::mutex> lock(cs_openDatabases);
+        setOpenDatabases.erase(this);
+    }
     delete pdb;
     pdb = NULL;
     delete options.filter_policy;
@@ -159,9 +250,48 @@ bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
 {
     leveldb::Status status = pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch);
     dbwrapper_private::HandleError(status);
+    nBatchesWritten++;
+    nBytesWritten += batch.SizeEstimate();
     return true;
 }
 
+CDBStats CDBWrapper::GetStats() const
+{
+    CDBStats stats;
+    stats.strName = strName;
+    stats.strPath = strPath;
+    stats.tuning = tuning;
+    pdb->GetProperty("leveldb.stats", &stats.strLevelDBStats);
+    std::string strFiles;
+    while (pdb->GetProperty(strprintf("leveldb.num-files-at-level%d", stats.vFilesPerLevel.size()), &strFiles)) {
+        stats.vFilesPerLevel.push_back(atoi(strFiles));
+    }
+    std::string strMemory;
+    if (pdb->GetProperty("leveldb.approximate-memory-usage", &strMemory))
+        stats.nApproximateMemoryUsage = atoi64(strMemory);
+    else
+        stats.nApproximateMemoryUsage = 0;
+    stats.nBlockCacheUsage = options.block_cache->TotalCharge();
+    stats.nBatchesWritten = nBatchesWritten;
+    stats.nBytesWritten = nBytesWritten;
+    stats.nManualCompactions = nManualCompactions;
+    return stats;
+}
+
+std::vector<CDBStats> CDBWrapper::GetAllStats()
+{
+    std::lock_guard<std::mutex> lock(cs_openDatabases);
+    std::vector<CDBStats> vStats;
+    vStats.reserve(setOpenDatabases.size());
+    for (const CDBWrapper* db : setOpenDatabases) {
+        vStats.push_back(db->GetStats());
+    }
+    std::sort(vStats.begin(), vStats.end(), [](const CDBStats& a, const CDBStats& b) {
+        return std::tie(a.strName, a.strPath) < std::tie(b.strName, b.strPath);
+    });
+    return vStats;
+}
+
 // Prefixed with null character to avoid collisions with other keys
 //
 // We must use a string constructor which specifies length so that we copy
@@ -12,6 +12,9 @@
 #include "utilstrencodings.h"
 #include "version.h"
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <typeindex>
 
 #include <boost/filesystem/path.hpp>
@@ -30,6 +33,46 @@ public:
 
 class CDBWrapper;
 
+/**
+ * LevelDB settings of a single database. The defaults are derived from the cache size the database
+ * is opened with, each of them can be overridden with -dbtuning=<name>:<option>=<value>.
+ */
+struct CDBTuning
+{
+    size_t nBlockCacheSize;
+    size_t nWriteBufferSize;
+    int nMaxOpenFiles;
+    bool fCompression;
+    //! bits per key of the bloom filter, 0 for none
+    int nBloomBits;
+
+    explicit CDBTuning(size_t nCacheSize);
+};
+
+/** Apply the -dbtuning options for the database strName, returns false with strError set for a malformed one */
+bool ApplyDBTuningArgs(const std::string& strName, CDBTuning& tuning, std::string& strError);
+
+/** Check the syntax of all -dbtuning options */
+bool CheckDBTuningArgs(std::string& strError);
+
+/** Runtime statistics of an open database, see CDBWrapper::GetAllStats */
+struct CDBStats
+{
+    std::string strName;
+    std::string strPath;
+    CDBTuning tuning;
+    //! LevelDB's own compaction stats table ("leveldb.stats")
+    std::string strLevelDBStats;
+    std::vector<int> vFilesPerLevel;
+    uint64_t nApproximateMemoryUsage;
+    size_t nBlockCacheUsage;
+    uint64_t nBatchesWritten;
+    uint64_t nBytesWritten;
+    uint64_t nManualCompactions;
+
+    CDBStats() : tuning(0) {}
+};
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private {
@@ -46,6 +89,40 @@ const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w);
 
 };
 
+/**
+ * Key of a single lookup. It is serialized into a buffer inside the object unless it is
+ * unusually long, so looking up a key doesn't need the heap.
+ */
+class CDBKeyWriter
+{
+private:
+    prevector<DBWRAPPER_PREALLOC_KEY_SIZE, char> vch;
+
+public:
+    template <typename K>
+    explicit CDBKeyWriter(const K& key)
+    {
+        ::Serialize(*this, key);
+    }
+
+    void write(const char* pch, size_t nSize)
+    {
+        vch.insert(vch.end(), pch, pch + nSize);
+    }
+
+    template <typename T>
+    CDBKeyWriter& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj);
+        return *this;
+    }
+
+    int GetType() const { return SER_DISK; }
+    int GetVersion() const { return CLIENT_VERSION; }
+
+    leveldb::Slice GetSlice() const { return leveldb::Slice(vch.data(), vch.size()); }
+};
+
 /** Batch of changes queued to be written to a CDBWrapper */
 class CDBBatch
 {
@@ -129,6 +206,8 @@ class CDBIterator
 private:
     const CDBWrapper &parent;
     leveldb::Iterator *piter;
+    //! reused for deserializing keys and values
+    CDataStream ssBuf;
 
 public:
 
@@ -137,7 +216,7 @@ public:
      * @param[in] _piter           The original leveldb iterator.
      */
     CDBIterator(const CDBWrapper &_parent, leveldb::Iterator *_piter) :
-        parent(_parent), piter(_piter) { };
+        parent(_parent), piter(_piter), ssBuf(SER_DISK, CLIENT_VERSION) { };
     ~CDBIterator();
 
     bool Valid();
@@ -159,15 +238,21 @@ public:
     void Next();
 
     template<typename K> bool GetKey(K& key) {
+        leveldb::Slice slKey = piter->key();
         try {
-            CDataStream ssKey = GetKey();
-            ssKey >> key;
+            ssBuf.clear();
+            ssBuf.write(slKey.data(), slKey.size());
+            ssBuf >> key;
         } catch (const std::exception&) {
             return false;
         }
         return true;
     }
 
+    bool KeyStartsWith(const CDataStream& ssPrefix) {
+        return piter->key().starts_with(leveldb::Slice(ssPrefix.data(), ssPrefix.size()));
+    }
+
     CDataStream GetKey() {
         leveldb::Slice slKey = piter->key();
         return CDataStream(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
@@ -180,9 +265,10 @@ public:
     template<typename V> bool GetValue(V& value) {
         leveldb::Slice slValue = piter->value();
         try {
-            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-            ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
-            ssValue >> value;
+            ssBuf.clear();
+            ssBuf.write(slValue.data(), slValue.size());
+            ssBuf.Xor(dbwrapper_private::GetObfuscateKey(parent));
+            ssBuf >> value;
         } catch (const std::exception&) {
             return false;
         }
@@ -220,6 +306,20 @@ private:
     //! the database itself
     leveldb::DB* pdb;
 
+    //! name of the database, selects its -dbtuning options
+    std::string strName;
+
+    //! location of the database, empty for memory databases
+    std::string strPath;
+
+    //! settings the database was opened with
+    CDBTuning tuning;
+
+    //! counters reported by GetAllStats
+    std::atomic<uint64_t> nBatchesWritten{0};
+    std::atomic<uint64_t> nBytesWritten{0};
+    mutable std::atomic<uint64_t> nManualCompactions{0};
+
     //! a key used for optional XOR-obfuscation of the database
     std::vector<unsigned char> obfuscate_key;
 
@@ -239,8 +339,9 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] name        Name used for the -dbtuning options and in getdbstats.
      */
-    CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, const std::string& name = "default");
     ~CDBWrapper();
 
     template <typename K>
@@ -273,21 +374,37 @@ public:
     template <typename K, typename V>
     bool Read(const K& key, V& value) const
     {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
-        ssKey << key;
-        return Read(ssKey, value);
+        return ReadSlice(CDBKeyWriter(key).GetSlice(), value);
     }
 
     template <typename V>
     bool Read(const CDataStream& ssKey, V& value) const
     {
-        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-        if (!ReadDataStream(ssKey, ssValue)) {
-            return false;
+        return ReadSlice(leveldb::Slice(ssKey.data(), ssKey.size()), value);
+    }
+
+    template <typename V>
+    bool ReadSlice(const leveldb::Slice& slKey, V& value) const
+    {
+        std::string strValue;
+        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        if (!status.ok()) {
+            if (status.IsNotFound())
+                return false;
+            LogPrintf("LevelDB read failure: %s\n", status.ToString());
+            dbwrapper_private::HandleError(status);
         }
 
+        // deobfuscated in place and read from there, values aren't secret and need no wiping
+        if (!obfuscate_key.empty()) {
+            for (size_t i = 0, j = 0; i != strValue.size(); i++) {
+                strValue[i] ^= obfuscate_key[j++];
+                if (j == obfuscate_key.size())
+                    j = 0;
+            }
+        }
         try {
+            CSpanReader ssValue(SER_DISK, CLIENT_VERSION, Span<const unsigned char>((const unsigned char*)strValue.data(), strValue.size()));
             ssValue >> value;
         } catch (const std::exception&) {
             return false;
@@ -295,6 +412,78 @@ public:
         return true;
     }
 
+    /**
+     * Read the values of many keys at once. The keys are looked up in sorted order through a single
+     * iterator, so keys close to each other are served from the same blocks, and the entry following
+     * the previous key is tried before seeking. Returns the number of keys found, vFound tells which.
+     */
+    template <typename K, typename V>
+    size_t ReadMany(const std::vector<K>& keys, std::vector<V>& values, std::vector<bool>& vFound) const
+    {
+        // all keys serialized back to back into a single buffer
+        CDataStream ssKeys(SER_DISK, CLIENT_VERSION);
+        std::vector<size_t> vOffsets;
+        vOffsets.reserve(keys.size() + 1);
+        for (const K& key : keys) {
+            vOffsets.push_back(ssKeys.size());
+            ssKeys << key;
+        }
+        vOffsets.push_back(ssKeys.size());
+        auto keySlice = [&](size_t i) {
+            return leveldb::Slice(ssKeys.data() + vOffsets[i], vOffsets[i + 1] - vOffsets[i]);
+        };
+
+        std::vector<size_t> vOrder(keys.size());
+        for (size_t i = 0; i < vOrder.size(); i++) {
+            vOrder[i] = i;
+        }
+        std::sort(vOrder.begin(), vOrder.end(), [&](size_t a, size_t b) {
+            return keySlice(a).compare(keySlice(b)) < 0;
+        });
+
+        values.clear();
+        values.resize(keys.size());
+        vFound.assign(keys.size(), false);
+
+        std::unique_ptr<leveldb::Iterator> piter(pdb->NewIterator(readoptions));
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        size_t nFound = 0;
+        bool fPositioned = false;
+        for (size_t i : vOrder) {
+            leveldb::Slice slKey = keySlice(i);
+            if (!fPositioned || piter->key().compare(slKey) < 0) {
+                if (fPositioned) {
+                    piter->Next();
+                }
+                if (!piter->Valid() || piter->key().compare(slKey) < 0) {
+                    piter->Seek(slKey);
+                }
+                fPositioned = true;
+            }
+            if (!piter->Valid()) {
+                // nothing left at or after this key, so neither for the following ones
+                break;
+            }
+            if (piter->key() != slKey) {
+                continue;
+            }
+
+            leveldb::Slice slValue = piter->value();
+            try {
+                ssValue.clear();
+                ssValue.write(slValue.data(), slValue.size());
+                ssValue.Xor(obfuscate_key);
+                ssValue >> values[i];
+            } catch (const std::exception&) {
+                continue;
+            }
+            vFound[i] = true;
+            nFound++;
+        }
+        dbwrapper_private::HandleError(piter->status());
+        return nFound;
+    }
+
     template <typename K, typename V>
     bool Write(const K& key, const V& value, bool fSync = false)
     {
@@ -306,16 +495,16 @@ public:
     template <typename K>
     bool Exists(const K& key) const
     {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
-        ssKey << key;
-        return Exists(ssKey);
+        return ExistsSlice(CDBKeyWriter(key).GetSlice());
     }
 
     bool Exists(const CDataStream& key) const
     {
-        leveldb::Slice slKey(key.data(), key.size());
+        return ExistsSlice(leveldb::Slice(key.data(), key.size()));
+    }
 
+    bool ExistsSlice(const leveldb::Slice& slKey) const
+    {
         std::string strValue;
         leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
         if (!status.ok()) {
@@ -389,12 +578,47 @@ public:
         leveldb::Slice slKey1(ssKey1.data(), ssKey1.size());
         leveldb::Slice slKey2(ssKey2.data(), ssKey2.size());
         pdb->CompactRange(&slKey1, &slKey2);
+        nManualCompactions++;
     }
 
 	void CompactFull() const
 	{
 		pdb->CompactRange(nullptr, nullptr);
+		nManualCompactions++;
 	}
+
+    CDBStats GetStats() const;
+
+    /** Statistics of all currently open databases */
+    static std::vector<CDBStats> GetAllStats();
+};
+
+/**
+ * Iterates over all entries of a database whose key starts with the serialized prefix, e.g.
+ * std::make_tuple(std::string("is_in"), txid) for all (std::string("is_in"), outpoint) keys of txid.
+ * Stops at the first key not matching the prefix bytes, without having to deserialize it.
+ */
+class CDBPrefixIterator
+{
+private:
+    std::unique_ptr<CDBIterator> pcursor;
+    CDataStream ssPrefix;
+
+public:
+    template<typename P>
+    CDBPrefixIterator(CDBWrapper& db, const P& prefix) :
+        pcursor(db.NewIterator()),
+        ssPrefix(SER_DISK, CLIENT_VERSION)
+    {
+        ssPrefix.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+        ssPrefix << prefix;
+        pcursor->Seek(ssPrefix);
+    }
+
+    bool Valid() { return pcursor->Valid() && pcursor->KeyStartsWith(ssPrefix); }
+    void Next() { pcursor->Next(); }
+    template<typename K> bool GetKey(K& key) { return pcursor->GetKey(key); }
+    template<typename V> bool GetValue(V& value) { return pcursor->GetValue(value); }
 };
 
 template<typename CDBTransaction>
@@ -20,6 +20,7 @@
 
 #include "evo/deterministicmns.h"
 #include "evo/mnauth.h"
+#include "evo/simplifiedmns.h"
 
 #include "llmq/quorums.h"
 #include "llmq/quorums_chainlocks.h"
@@ -65,6 +66,8 @@ void CDSNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, con
     if (fInitialDownload)
         return;
 
+    PrecomputeSimplifiedMNListDiffs(pindexNew);
+
     if (fLiteMode)
         return;
 
@@ -21,6 +21,11 @@
 #include <boost/filesystem/operations.hpp>
 #include <stdio.h>
 
+#ifndef WIN32
+#include <poll.h>
+#include <unistd.h>
+#endif
+
 #include <event2/buffer.h>
 #include <event2/keyvalq_struct.h>
 #include "support/events.h"
@@ -31,6 +36,7 @@ static const char DEFAULT_RPCCONNECT[] = "127.0.0.1";
 static const int DEFAULT_HTTP_CLIENT_TIMEOUT=900;
 static const bool DEFAULT_NAMED=false;
 static const int CONTINUE_EXECUTION=-1;
+static const int DEFAULT_BATCH_SIZE=100;
 
 std::string HelpMessageCli()
 {
@@ -48,6 +54,9 @@ std::string HelpMessageCli()
     strUsage += HelpMessageOpt("-rpcpassword=<pw>", _("Password for JSON-RPC connections"));
     strUsage += HelpMessageOpt("-rpcclienttimeout=<n>", strprintf(_("Timeout in seconds during HTTP requests, or 0 for no timeout. (default: %d)"), DEFAULT_HTTP_CLIENT_TIMEOUT));
     strUsage += HelpMessageOpt("-stdin", _("Read extra arguments from standard input, one per line until EOF/Ctrl-D (recommended for sensitive information such as passphrases)"));
+    strUsage += HelpMessageOpt("-batch", _("Read commands from standard input, one per line like on the command line, and send them over a single connection. "
+        "Every reply is printed as a JSON object on one line, in the order of the commands and with the line number as id"));
+    strUsage += HelpMessageOpt("-batchsize=<n>", strprintf(_("Maximum number of commands of -batch sent as one JSON-RPC batch, commands are sent earlier when no more input is waiting (default: %d)"), DEFAULT_BATCH_SIZE));
 
     return strUsage;
 }
@@ -88,7 +97,8 @@ static int AppInitRPC(int argc, char* argv[])
                   "  epmcoin-cli [options] <command> [params]  " + strprintf(_("Send command to %s"), _(PACKAGE_NAME)) + "\n" +
                   "  epmcoin-cli [options] -named <command> [name=value] ... " + strprintf(_("Send command to %s (with named arguments)"), _(PACKAGE_NAME)) + "\n" +
                   "  epmcoin-cli [options] help                " + _("List commands") + "\n" +
-                  "  epmcoin-cli [options] help <command>      " + _("Get help for a command") + "\n";
+                  "  epmcoin-cli [options] help <command>      " + _("Get help for a command") + "\n" +
+                  "  epmcoin-cli [options] -batch              " + _("Send the commands read from standard input") + "\n";
 
             strUsage += "\n" + HelpMessageCli();
         }
@@ -134,11 +144,13 @@ static int AppInitRPC(int argc, char* argv[])
 /** Reply structure for request_done to fill in */
 struct HTTPReply
 {
-    HTTPReply(): status(0), error(-1) {}
+    HTTPReply(): status(0), error(-1), base(NULL) {}
 
     int status;
     int error;
     std::string body;
+    //! Stopped when the request is done, a kept alive connection would keep its loop running otherwise
+    struct event_base* base;
 };
 
 const char *http_errorstring(int code)
@@ -166,6 +178,8 @@ const char *http_errorstring(int code)
 static void http_request_done(struct evhttp_request *req, void *ctx)
 {
     HTTPReply *reply = static_cast<HTTPReply*>(ctx);
+    if (reply->base)
+        event_base_loopbreak(reply->base);
 
     if (req == NULL) {
         /* If req is NULL, it means an error occurred while connecting: the
@@ -196,80 +210,246 @@ static void http_error_cb(enum evhttp_request_error err, void *ctx)
 }
 #endif
 
-UniValue CallRPC(const std::string& strMethod, const UniValue& params)
+/**
+ * A connection to the RPC server. With keep-alive it stays open for all requests sent through it,
+ * libevent connects again by itself if the server closed it in between.
+ */
+class CRPCConnection
 {
-    std::string host = GetArg("-rpcconnect", DEFAULT_RPCCONNECT);
-    int port = GetArg("-rpcport", BaseParams().RPCPort());
+private:
+    std::string host;
+    int port;
+    bool fKeepAlive;
+    std::string strRPCUserColonPass;
+    raii_event_base base;
+    raii_evhttp_connection evcon;
+
+public:
+    explicit CRPCConnection(bool fKeepAliveIn) :
+        host(GetArg("-rpcconnect", DEFAULT_RPCCONNECT)),
+        port(GetArg("-rpcport", BaseParams().RPCPort())),
+        fKeepAlive(fKeepAliveIn)
+    {
+        // Obtain event base
+        base = obtain_event_base();
+
+        // Synchronously look up hostname
+        evcon = obtain_evhttp_connection_base(base.get(), host, port);
+        evhttp_connection_set_timeout(evcon.get(), GetArg("-rpcclienttimeout", DEFAULT_HTTP_CLIENT_TIMEOUT));
 
-    // Obtain event base
-    raii_event_base base = obtain_event_base();
+        // Get credentials
+        if (GetArg("-rpcpassword", "") == "") {
+            // Try fall back to cookie-based authentication if no password is provided
+            if (!GetAuthCookie(&strRPCUserColonPass)) {
+                throw std::runtime_error(strprintf(
+                    _("Could not locate RPC credentials. No authentication cookie could be found, and no rpcpassword is set in the configuration file (%s)"),
+                        GetConfigFile(GetArg("-conf", BITCOIN_CONF_FILENAME)).string().c_str()));
 
-    // Synchronously look up hostname
-    raii_evhttp_connection evcon = obtain_evhttp_connection_base(base.get(), host, port);
-    evhttp_connection_set_timeout(evcon.get(), GetArg("-rpcclienttimeout", DEFAULT_HTTP_CLIENT_TIMEOUT));
+            }
+        } else {
+            strRPCUserColonPass = GetArg("-rpcuser", "") + ":" + GetArg("-rpcpassword", "");
+        }
+    }
 
-    HTTPReply response;
-    raii_evhttp_request req = obtain_evhttp_request(http_request_done, (void*)&response);
-    if (req == NULL)
-        throw std::runtime_error("create http request failed");
+    /** Sends a request object or a batch of them and returns the reply, an object or an array of them */
+    UniValue Send(const UniValue& request)
+    {
+        HTTPReply response;
+        response.base = base.get();
+        raii_evhttp_request req = obtain_evhttp_request(http_request_done, (void*)&response);
+        if (req == NULL)
+            throw std::runtime_error("create http request failed");
 #if LIBEVENT_VERSION_NUMBER >= 0x02010300
-    evhttp_request_set_error_cb(req.get(), http_error_cb);
+        evhttp_request_set_error_cb(req.get(), http_error_cb);
 #endif
 
-    // Get credentials
-    std::string strRPCUserColonPass;
-    if (GetArg("-rpcpassword", "") == "") {
-        // Try fall back to cookie-based authentication if no password is provided
-        if (!GetAuthCookie(&strRPCUserColonPass)) {
-            throw std::runtime_error(strprintf(
-                _("Could not locate RPC credentials. No authentication cookie could be found, and no rpcpassword is set in the configuration file (%s)"),
-                    GetConfigFile(GetArg("-conf", BITCOIN_CONF_FILENAME)).string().c_str()));
-
+        struct evkeyvalq* output_headers = evhttp_request_get_output_headers(req.get());
+        assert(output_headers);
+        evhttp_add_header(output_headers, "Host", host.c_str());
+        evhttp_add_header(output_headers, "Connection", fKeepAlive ? "keep-alive" : "close");
+        evhttp_add_header(output_headers, "Authorization", (std::string("Basic ") + EncodeBase64(strRPCUserColonPass)).c_str());
+
+        // Attach request data
+        std::string strRequest = request.write() + "\n";
+        struct evbuffer* output_buffer = evhttp_request_get_output_buffer(req.get());
+        assert(output_buffer);
+        evbuffer_add(output_buffer, strRequest.data(), strRequest.size());
+
+        int r = evhttp_make_request(evcon.get(), req.get(), EVHTTP_REQ_POST, "/");
+        req.release(); // ownership moved to evcon in above call
+        if (r != 0) {
+            throw CConnectionFailed("send http request failed");
         }
-    } else {
-        strRPCUserColonPass = GetArg("-rpcuser", "") + ":" + GetArg("-rpcpassword", "");
-    }
 
-    struct evkeyvalq* output_headers = evhttp_request_get_output_headers(req.get());
-    assert(output_headers);
-    evhttp_add_header(output_headers, "Host", host.c_str());
-    evhttp_add_header(output_headers, "Connection", "close");
-    evhttp_add_header(output_headers, "Authorization", (std::string("Basic ") + EncodeBase64(strRPCUserColonPass)).c_str());
-
-    // Attach request data
-    std::string strRequest = JSONRPCRequestObj(strMethod, params, 1).write() + "\n";
-    struct evbuffer* output_buffer = evhttp_request_get_output_buffer(req.get());
-    assert(output_buffer);
-    evbuffer_add(output_buffer, strRequest.data(), strRequest.size());
-
-    int r = evhttp_make_request(evcon.get(), req.get(), EVHTTP_REQ_POST, "/");
-    req.release(); // ownership moved to evcon in above call
-    if (r != 0) {
-        throw CConnectionFailed("send http request failed");
+        event_base_dispatch(base.get());
+
+        if (response.status == 0)
+            throw CConnectionFailed(strprintf("couldn't connect to server: %s (code %d)\n(make sure server is running and you are connecting to the correct RPC port)", http_errorstring(response.error), response.error));
+        else if (response.status == HTTP_UNAUTHORIZED)
+            throw std::runtime_error("incorrect rpcuser or rpcpassword (authorization failed)");
+        else if (response.status >= 400 && response.status != HTTP_BAD_REQUEST && response.status != HTTP_NOT_FOUND && response.status != HTTP_INTERNAL_SERVER_ERROR)
+            throw std::runtime_error(strprintf("server returned HTTP error %d", response.status));
+        else if (response.body.empty())
+            throw std::runtime_error("no response from server");
+
+        // Parse reply
+        UniValue valReply(UniValue::VSTR);
+        if (!valReply.read(response.body))
+            throw std::runtime_error("couldn't parse reply from server");
+        if ((!valReply.isObject() && !valReply.isArray()) || valReply.empty())
+            throw std::runtime_error("expected reply to have result, error and id properties");
+        return valReply;
     }
+};
 
-    event_base_dispatch(base.get());
-
-    if (response.status == 0)
-        throw CConnectionFailed(strprintf("couldn't connect to server: %s (code %d)\n(make sure server is running and you are connecting to the correct RPC port)", http_errorstring(response.error), response.error));
-    else if (response.status == HTTP_UNAUTHORIZED)
-        throw std::runtime_error("incorrect rpcuser or rpcpassword (authorization failed)");
-    else if (response.status >= 400 && response.status != HTTP_BAD_REQUEST && response.status != HTTP_NOT_FOUND && response.status != HTTP_INTERNAL_SERVER_ERROR)
-        throw std::runtime_error(strprintf("server returned HTTP error %d", response.status));
-    else if (response.body.empty())
-        throw std::runtime_error("no response from server");
-
-    // Parse reply
-    UniValue valReply(UniValue::VSTR);
-    if (!valReply.read(response.body))
-        throw std::runtime_error("couldn't parse reply from server");
-    const UniValue& reply = valReply.get_obj();
-    if (reply.empty())
+UniValue CallRPC(const std::string& strMethod, const UniValue& params)
+{
+    CRPCConnection connection(false);
+    UniValue reply = connection.Send(JSONRPCRequestObj(strMethod, params, 1));
+    if (!reply.isObject())
         throw std::runtime_error("expected reply to have result, error and id properties");
-
     return reply;
 }
 
+/**
+ * Splits a line of -batch into arguments like a shell would: at whitespace, except within
+ * single or double quotes, and a backslash outside of single quotes escapes the next character.
+ */
+static bool SplitCommandLine(const std::string& strLine, std::vector<std::string>& args)
+{
+    args.clear();
+    std::string strArg;
+    bool fArg = false;
+    char cQuote = 0;
+    for (size_t i = 0; i < strLine.size(); i++) {
+        char c = strLine[i];
+        if (c == '\\' && cQuote != '\'') {
+            if (++i == strLine.size())
+                return false;
+            strArg += strLine[i];
+            fArg = true;
+        } else if (cQuote) {
+            if (c == cQuote)
+                cQuote = 0;
+            else
+                strArg += c;
+        } else if (c == '\'' || c == '"') {
+            cQuote = c;
+            fArg = true;
+        } else if (c == ' ' || c == '\t' || c == '\r') {
+            if (fArg)
+                args.push_back(strArg);
+            strArg.clear();
+            fArg = false;
+        } else {
+            strArg += c;
+            fArg = true;
+        }
+    }
+    if (fArg)
+        args.push_back(strArg);
+    return cQuote == 0;
+}
+
+/** Whether more of stdin can be read right away */
+static bool StdinPending()
+{
+    if (std::cin.rdbuf()->in_avail() > 0)
+        return true;
+#ifndef WIN32
+    struct pollfd pfd;
+    pfd.fd = STDIN_FILENO;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) > 0;
+#else
+    return true;
+#endif
+}
+
+/**
+ * Reads commands from stdin and sends them as JSON-RPC batches over one kept alive connection.
+ * A batch is sent when it's full, at the end of the input or when no more input is waiting, so
+ * an interactive caller gets its replies right away and a piped file goes out in large batches.
+ */
+static int BatchRPC()
+{
+    const bool fNamed = GetBoolArg("-named", DEFAULT_NAMED);
+    const bool fWait = GetBoolArg("-rpcwait", false);
+    const size_t nBatchSize = std::max<int64_t>(1, GetArg("-batchsize", DEFAULT_BATCH_SIZE));
+    CRPCConnection connection(true);
+    int nRet = 0;
+
+    // the replies of the current batch by line, those of lines which weren't sent are filled in already
+    std::vector<std::pair<int64_t, UniValue> > vReplies;
+    UniValue batch(UniValue::VARR);
+    auto flush = [&]() {
+        if (!batch.empty()) {
+            UniValue reply;
+            do {
+                try {
+                    reply = connection.Send(batch);
+                    const UniValue& error = find_value(reply, "error");
+                    if (fWait && !error.isNull() && error["code"].get_int() == RPC_IN_WARMUP)
+                        throw CConnectionFailed("server in warmup");
+                    break;
+                } catch (const CConnectionFailed&) {
+                    if (!fWait)
+                        throw;
+                    MilliSleep(1000);
+                }
+            } while (fWait);
+            if (!reply.isArray())
+                throw std::runtime_error("server rejected the batch: " + reply.write());
+            for (size_t i = 0; i < reply.size(); i++) {
+                const UniValue& id = find_value(reply[i], "id");
+                if (!id.isNum())
+                    throw std::runtime_error("reply without id: " + reply[i].write());
+                int64_t nLine = id.get_int64();
+                auto it = std::find_if(vReplies.begin(), vReplies.end(), [&](const std::pair<int64_t, UniValue>& p) { return p.first == nLine; });
+                if (it == vReplies.end())
+                    throw std::runtime_error("reply with unknown id: " + reply[i].write());
+                it->second = reply[i];
+            }
+            batch = UniValue(UniValue::VARR);
+        }
+        for (const auto& p : vReplies) {
+            if (p.second.isNull())
+                throw std::runtime_error(strprintf("no reply for line %d", p.first));
+            if (!find_value(p.second, "error").isNull())
+                nRet = EXIT_FAILURE;
+            fprintf(stdout, "%s\n", p.second.write().c_str());
+        }
+        fflush(stdout);
+        vReplies.clear();
+    };
+
+    std::ios::sync_with_stdio(false);
+    std::string strLine;
+    int64_t nLine = 0;
+    while (std::getline(std::cin, strLine)) {
+        nLine++;
+        std::vector<std::string> args;
+        if (!SplitCommandLine(strLine, args)) {
+            vReplies.emplace_back(nLine, JSONRPCReplyObj(NullUniValue, JSONRPCError(RPC_PARSE_ERROR, "unterminated quote or escape"), nLine));
+        } else if (!args.empty() && args[0][0] != '#') {
+            std::string strMethod = args[0];
+            args.erase(args.begin());
+            try {
+                UniValue params = fNamed ? RPCConvertNamedValues(strMethod, args) : RPCConvertValues(strMethod, args);
+                batch.push_back(JSONRPCRequestObj(strMethod, params, nLine));
+                vReplies.emplace_back(nLine, NullUniValue);
+            } catch (const std::exception& e) {
+                vReplies.emplace_back(nLine, JSONRPCReplyObj(NullUniValue, JSONRPCError(RPC_PARSE_ERROR, e.what()), nLine));
+            }
+        }
+        if (!vReplies.empty() && (vReplies.size() >= nBatchSize || !StdinPending()))
+            flush();
+    }
+    flush();
+    return nRet;
+}
+
 int CommandLineRPC(int argc, char *argv[])
 {
     std::string strPrint;
@@ -281,6 +461,11 @@ int CommandLineRPC(int argc, char *argv[])
             argv++;
         }
         std::vector<std::string> args = std::vector<std::string>(&argv[1], &argv[argc]);
+        if (GetBoolArg("-batch", false)) {
+            if (!args.empty() || GetBoolArg("-stdin", false))
+                throw std::runtime_error("-batch takes its commands from standard input only");
+            return BatchRPC();
+        }
         if (GetBoolArg("-stdin", false)) {
             // Read one arg per line from stdin and append
             std::string line;
@@ -23,6 +23,14 @@
 
 #include <stdio.h>
 
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <thread>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/assign/list_of.hpp>
 
@@ -31,6 +39,10 @@
 static bool fCreateBlank;
 static std::map<std::string,UniValue> registers;
 static const int CONTINUE_EXECUTION=-1;
+/** Default for -signthreads, 0 means one per core */
+static const int DEFAULT_SIGNBATCH_THREADS = 0;
+/** Lines of -signbatch read ahead per signing thread */
+static const size_t SIGNBATCH_LINES_PER_THREAD = 64;
 
 //
 // This function returns either one of EXIT_ codes when it's expected to stop the process or
@@ -60,6 +72,7 @@ static int AppInitRawTx(int argc, char* argv[])
             _("Usage:") + "\n" +
               "  epmcoin-tx [options] <hex-tx> [commands]  " + _("Update hex-encoded epmcoin transaction") + "\n" +
               "  epmcoin-tx [options] -create [commands]   " + _("Create hex-encoded epmcoin transaction") + "\n" +
+              "  epmcoin-tx [options] -signbatch=<file> [register commands]  " + _("Sign the transactions read from <file>") + "\n" +
               "\n";
 
         fprintf(stdout, "%s", strUsage.c_str());
@@ -69,6 +82,11 @@ static int AppInitRawTx(int argc, char* argv[])
         strUsage += HelpMessageOpt("-create", _("Create new, empty TX."));
         strUsage += HelpMessageOpt("-json", _("Select JSON output"));
         strUsage += HelpMessageOpt("-txid", _("Output only the hex-encoded transaction id of the resultant transaction."));
+        strUsage += HelpMessageOpt("-signbatch=<file>", _("Sign many transactions with the keys of the privatekeys register, - reads them from standard input. "
+            "Each line is a JSON object with the transaction as \"hex\", optionally its \"prevtxs\" and a \"sighashtype\" (default: ALL). "
+            "The prevtxs register, if set, holds previous outputs for all of them. "
+            "For each line one line of JSON is written in the order of the input, with \"line\" and either \"hex\" and \"complete\" or \"error\""));
+        strUsage += HelpMessageOpt("-signthreads=<n>", strprintf(_("Number of threads signing the transactions of -signbatch, 0 for one per core (default: %d)"), DEFAULT_SIGNBATCH_THREADS));
         AppendParamsHelpMessages(strUsage);
 
         fprintf(stdout, "%s", strUsage.c_str());
@@ -487,29 +505,11 @@ std::vector<unsigned char> ParseHexUO(std::map<std::string,UniValue>& o, std::st
     return ParseHexUV(o[strKey], strKey);
 }
 
-static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr)
-{
-    int nHashType = SIGHASH_ALL;
-
-    if (flagStr.size() > 0)
-        if (!findSighashFlags(nHashType, flagStr))
-            throw std::runtime_error("unknown sighash flag/sign option");
-
-    std::vector<CTransaction> txVariants;
-    txVariants.push_back(tx);
-
-    // mergedTx will end up with all the signatures; it
-    // starts as a clone of the raw tx:
-    CMutableTransaction mergedTx(txVariants[0]);
-    bool fComplete = true;
-    CCoinsView viewDummy;
-    CCoinsViewCache view(&viewDummy);
-
-    if (!registers.count("privatekeys"))
-        throw std::runtime_error("privatekeys register variable must be set.");
-    CBasicKeyStore tempKeystore;
-    UniValue keysObj = registers["privatekeys"];
+/** A previous output given with prevtxs, its value is not known */
+typedef std::pair<COutPoint, CScript> PrevOut;
 
+static void LoadPrivateKeys(const UniValue& keysObj, CBasicKeyStore& keystore)
+{
     for (unsigned int kidx = 0; kidx < keysObj.size(); kidx++) {
         if (!keysObj[kidx].isStr())
             throw std::runtime_error("privatekey not a std::string");
@@ -519,93 +519,129 @@ static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr)
             throw std::runtime_error("privatekey not valid");
 
         CKey key = vchSecret.GetKey();
-        tempKeystore.AddKey(key);
+        keystore.AddKey(key);
     }
+}
 
-    // Add previous txouts given in the RPC call:
-    if (!registers.count("prevtxs"))
-        throw std::runtime_error("prevtxs register variable must be set.");
-    UniValue prevtxsObj = registers["prevtxs"];
-    {
-        for (unsigned int previdx = 0; previdx < prevtxsObj.size(); previdx++) {
-            UniValue prevOut = prevtxsObj[previdx];
-            if (!prevOut.isObject())
-                throw std::runtime_error("expected prevtxs internal object");
-
-            std::map<std::string,UniValue::VType> types = boost::assign::map_list_of("txid", UniValue::VSTR)("vout",UniValue::VNUM)("scriptPubKey",UniValue::VSTR);
-            if (!prevOut.checkObject(types))
-                throw std::runtime_error("prevtxs internal object typecheck fail");
-
-            uint256 txid = ParseHashUV(prevOut["txid"], "txid");
-
-            int nOut = atoi(prevOut["vout"].getValStr());
-            if (nOut < 0)
-                throw std::runtime_error("vout must be positive");
-
-            COutPoint out(txid, nOut);
-            std::vector<unsigned char> pkData(ParseHexUV(prevOut["scriptPubKey"], "scriptPubKey"));
-            CScript scriptPubKey(pkData.begin(), pkData.end());
-
-            {
-                const Coin& coin = view.AccessCoin(out);
-                if (!coin.IsSpent() && coin.out.scriptPubKey != scriptPubKey) {
-                    std::string err("Previous output scriptPubKey mismatch:\n");
-                    err = err + ScriptToAsmStr(coin.out.scriptPubKey) + "\nvs:\n"+
-                        ScriptToAsmStr(scriptPubKey);
-                    throw std::runtime_error(err);
-                }
-                Coin newcoin;
-                newcoin.out.scriptPubKey = scriptPubKey;
-                newcoin.out.nValue = 0; // we don't know the actual output value
-                newcoin.nHeight = 1;
-                view.AddCoin(out, std::move(newcoin), true);
-            }
+/** Parses a prevtxs array like the one of signrawtransaction, redeem scripts go to the keystore */
+static void ParsePrevTxs(const UniValue& prevtxsObj, CBasicKeyStore& keystore, std::vector<PrevOut>& vPrevOuts)
+{
+    for (unsigned int previdx = 0; previdx < prevtxsObj.size(); previdx++) {
+        UniValue prevOut = prevtxsObj[previdx];
+        if (!prevOut.isObject())
+            throw std::runtime_error("expected prevtxs internal object");
+
+        std::map<std::string,UniValue::VType> types = boost::assign::map_list_of("txid", UniValue::VSTR)("vout",UniValue::VNUM)("scriptPubKey",UniValue::VSTR);
+        if (!prevOut.checkObject(types))
+            throw std::runtime_error("prevtxs internal object typecheck fail");
+
+        uint256 txid = ParseHashUV(prevOut["txid"], "txid");
+
+        int nOut = atoi(prevOut["vout"].getValStr());
+        if (nOut < 0)
+            throw std::runtime_error("vout must be positive");
+
+        std::vector<unsigned char> pkData(ParseHexUV(prevOut["scriptPubKey"], "scriptPubKey"));
+        CScript scriptPubKey(pkData.begin(), pkData.end());
+        vPrevOuts.emplace_back(COutPoint(txid, nOut), scriptPubKey);
+
+        // if redeemScript given and private keys given,
+        // add redeemScript to the keystore so it can be signed:
+        if (scriptPubKey.IsPayToScriptHash() &&
+            prevOut.exists("redeemScript")) {
+            UniValue v = prevOut["redeemScript"];
+            std::vector<unsigned char> rsData(ParseHexUV(v, "redeemScript"));
+            CScript redeemScript(rsData.begin(), rsData.end());
+            keystore.AddCScript(redeemScript);
+        }
+    }
+}
 
-            // if redeemScript given and private keys given,
-            // add redeemScript to the tempKeystore so it can be signed:
-            if (scriptPubKey.IsPayToScriptHash() &&
-                prevOut.exists("redeemScript")) {
-                UniValue v = prevOut["redeemScript"];
-                std::vector<unsigned char> rsData(ParseHexUV(v, "redeemScript"));
-                CScript redeemScript(rsData.begin(), rsData.end());
-                tempKeystore.AddCScript(redeemScript);
-            }
+static void AddPrevOuts(CCoinsViewCache& view, const std::vector<PrevOut>& vPrevOuts)
+{
+    for (const PrevOut& prevOut : vPrevOuts) {
+        const Coin& coin = view.AccessCoin(prevOut.first);
+        if (!coin.IsSpent() && coin.out.scriptPubKey != prevOut.second) {
+            std::string err("Previous output scriptPubKey mismatch:\n");
+            err = err + ScriptToAsmStr(coin.out.scriptPubKey) + "\nvs:\n"+
+                ScriptToAsmStr(prevOut.second);
+            throw std::runtime_error(err);
         }
+        Coin newcoin;
+        newcoin.out.scriptPubKey = prevOut.second;
+        newcoin.out.nValue = 0; // we don't know the actual output value
+        newcoin.nHeight = 1;
+        view.AddCoin(prevOut.first, std::move(newcoin), true);
     }
+}
 
-    const CKeyStore& keystore = tempKeystore;
+/**
+ * Signs what it can of tx and merges in the signatures it had already. Returns whether all
+ * inputs are signed completely. The keystore is only read, so it can be shared by threads.
+ */
+static bool SignTx(CMutableTransaction& tx, const CKeyStore& keystore, const CCoinsViewCache& view, int nHashType)
+{
+    // The signature hashes don't depend on the scriptSigs, so all inputs share the precomputed parts
+    const CTransaction txConst(tx);
+    PrecomputedTransactionData txdata(txConst);
+    bool fComplete = true;
 
     bool fHashSingle = ((nHashType & ~SIGHASH_ANYONECANPAY) == SIGHASH_SINGLE);
 
     // Sign what we can:
-    for (unsigned int i = 0; i < mergedTx.vin.size(); i++) {
-        CTxIn& txin = mergedTx.vin[i];
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        CTxIn& txin = tx.vin[i];
         const Coin& coin = view.AccessCoin(txin.prevout);
         if (coin.IsSpent()) {
             fComplete = false;
             continue;
         }
         const CScript& prevPubKey = coin.out.scriptPubKey;
+        TransactionSignatureChecker checker(&txConst, i, &txdata);
 
-        txin.scriptSig.clear();
+        CScript scriptSig;
         // Only sign SIGHASH_SINGLE if there's a corresponding output:
-        if (!fHashSingle || (i < mergedTx.vout.size()))
-            SignSignature(keystore, prevPubKey, mergedTx, i, nHashType);
+        if (!fHashSingle || (i < tx.vout.size()))
+            ProduceSignature(TransactionSignatureCreator(&keystore, &txConst, i, nHashType, &txdata), prevPubKey, scriptSig);
 
         // ... and merge in other signatures:
-        BOOST_FOREACH(const CTransaction& txv, txVariants) {
-            txin.scriptSig = CombineSignatures(prevPubKey, mergedTx, i, txin.scriptSig, txv.vin[i].scriptSig);
-        }
-        if (!VerifyScript(txin.scriptSig, prevPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, MutableTransactionSignatureChecker(&mergedTx, i)))
+        txin.scriptSig = CombineSignatures(prevPubKey, checker, scriptSig, txConst.vin[i].scriptSig);
+        if (!VerifyScript(txin.scriptSig, prevPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, checker))
             fComplete = false;
     }
 
+    return fComplete;
+}
+
+static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr)
+{
+    int nHashType = SIGHASH_ALL;
+
+    if (flagStr.size() > 0)
+        if (!findSighashFlags(nHashType, flagStr))
+            throw std::runtime_error("unknown sighash flag/sign option");
+
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+
+    if (!registers.count("privatekeys"))
+        throw std::runtime_error("privatekeys register variable must be set.");
+    CBasicKeyStore tempKeystore;
+    LoadPrivateKeys(registers["privatekeys"], tempKeystore);
+
+    // Add previous txouts given in the RPC call:
+    if (!registers.count("prevtxs"))
+        throw std::runtime_error("prevtxs register variable must be set.");
+    std::vector<PrevOut> vPrevOuts;
+    ParsePrevTxs(registers["prevtxs"], tempKeystore, vPrevOuts);
+    AddPrevOuts(view, vPrevOuts);
+
+    bool fComplete = SignTx(tx, tempKeystore, view, nHashType);
+
     if (fComplete) {
         // do nothing... for now
         // perhaps store this for later optional JSON output
     }
-
-    tx = mergedTx;
 }
 
 class Secp256k1Init
@@ -717,6 +753,177 @@ static std::string readStdin()
     return ret;
 }
 
+/** Signs the transaction of one line of -signbatch and returns the line to print for it */
+static std::string SignBatchLine(size_t nLine, const std::string& strLine, CBasicKeyStore& keystore,
+                                 const std::vector<PrevOut>& vCommonPrevOuts, bool& fErrorRet)
+{
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("line", (uint64_t)nLine));
+    try {
+        UniValue obj;
+        if (!obj.read(strLine) || !obj.isObject())
+            throw std::runtime_error("line is not a JSON object");
+
+        CMutableTransaction tx;
+        if (!obj["hex"].isStr() || !DecodeHexTx(tx, obj["hex"].get_str()))
+            throw std::runtime_error("invalid transaction encoding");
+
+        int nHashType = SIGHASH_ALL;
+        if (obj.exists("sighashtype"))
+            if (!obj["sighashtype"].isStr() || !findSighashFlags(nHashType, obj["sighashtype"].get_str()))
+                throw std::runtime_error("unknown sighash flag/sign option");
+
+        // the redeem scripts are added to the shared keystore, which is thread safe
+        std::vector<PrevOut> vPrevOuts;
+        if (obj.exists("prevtxs"))
+            ParsePrevTxs(obj["prevtxs"].get_array(), keystore, vPrevOuts);
+
+        CCoinsView viewDummy;
+        CCoinsViewCache view(&viewDummy);
+        AddPrevOuts(view, vCommonPrevOuts);
+        AddPrevOuts(view, vPrevOuts);
+
+        bool fComplete = SignTx(tx, keystore, view, nHashType);
+        result.push_back(Pair("hex", EncodeHexTx(tx)));
+        result.push_back(Pair("complete", fComplete));
+    } catch (const std::exception& e) {
+        result.push_back(Pair("error", std::string(e.what())));
+        fErrorRet = true;
+    }
+    return result.write();
+}
+
+/** A line of -signbatch on its way from the reader through a signing thread to the writer */
+struct SignBatchItem {
+    size_t nLine;
+    std::string strLine;
+    std::string strResult;
+    bool fError = false;
+    bool fDone = false;
+};
+
+/**
+ * Signs the transactions read line by line from strFile with the keys loaded once from the
+ * privatekeys register. The lines are handed to -signthreads signing threads and the results
+ * written in the order of the input as soon as they are ready, with at most a few lines per
+ * thread read ahead. Returns EXIT_FAILURE if any line failed.
+ */
+static int SignBatch(const std::string& strFile)
+{
+    if (!registers.count("privatekeys"))
+        throw std::runtime_error("privatekeys register variable must be set.");
+    CBasicKeyStore keystore;
+    LoadPrivateKeys(registers["privatekeys"], keystore);
+
+    std::vector<PrevOut> vCommonPrevOuts;
+    if (registers.count("prevtxs"))
+        ParsePrevTxs(registers["prevtxs"], keystore, vCommonPrevOuts);
+
+    std::ifstream file;
+    if (strFile != "-") {
+        file.open(strFile);
+        if (!file.is_open())
+            throw std::runtime_error("Cannot open file " + strFile);
+    }
+    std::istream& input = strFile == "-" ? std::cin : file;
+
+    int nThreads = GetArg("-signthreads", DEFAULT_SIGNBATCH_THREADS);
+    if (nThreads <= 0)
+        nThreads = std::max(1, GetNumCores());
+    const size_t nMaxPending = nThreads * SIGNBATCH_LINES_PER_THREAD;
+
+    Secp256k1Init ecc;
+
+    std::mutex cs;
+    std::condition_variable cvWork, cvDone, cvSpace;
+    // in the order of the input, from the first line not written yet
+    std::list<SignBatchItem> pending;
+    // the lines no signing thread took yet
+    std::deque<SignBatchItem*> queue;
+    bool fEndOfInput = false;
+    bool fAnyError = false;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nThreads; i++) {
+        threads.emplace_back([&]() {
+            std::unique_lock<std::mutex> lock(cs);
+            while (true) {
+                cvWork.wait(lock, [&]() { return !queue.empty() || fEndOfInput; });
+                if (queue.empty())
+                    return;
+                SignBatchItem* item = queue.front();
+                queue.pop_front();
+                lock.unlock();
+
+                bool fError = false;
+                std::string strResult = SignBatchLine(item->nLine, item->strLine, keystore, vCommonPrevOuts, fError);
+
+                lock.lock();
+                item->strResult = std::move(strResult);
+                item->fError = fError;
+                item->fDone = true;
+                if (item == &pending.front())
+                    cvDone.notify_one();
+            }
+        });
+    }
+
+    std::thread writer([&]() {
+        std::unique_lock<std::mutex> lock(cs);
+        while (true) {
+            cvDone.wait(lock, [&]() { return (!pending.empty() && pending.front().fDone) || (pending.empty() && fEndOfInput); });
+            if (pending.empty())
+                return;
+            std::vector<std::string> vResults;
+            while (!pending.empty() && pending.front().fDone) {
+                fAnyError |= pending.front().fError;
+                vResults.emplace_back(std::move(pending.front().strResult));
+                pending.pop_front();
+            }
+            cvSpace.notify_one();
+            lock.unlock();
+
+            for (const std::string& strResult : vResults)
+                fprintf(stdout, "%s\n", strResult.c_str());
+            fflush(stdout);
+
+            lock.lock();
+        }
+    });
+
+    std::string strLine;
+    size_t nLine = 0;
+    while (std::getline(input, strLine)) {
+        nLine++;
+        boost::algorithm::trim(strLine);
+        if (strLine.empty())
+            continue;
+
+        std::unique_lock<std::mutex> lock(cs);
+        cvSpace.wait(lock, [&]() { return pending.size() < nMaxPending; });
+        pending.emplace_back();
+        pending.back().nLine = nLine;
+        pending.back().strLine = std::move(strLine);
+        queue.push_back(&pending.back());
+        cvWork.notify_one();
+    }
+    bool fReadError = input.bad();
+
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fEndOfInput = true;
+    }
+    cvWork.notify_all();
+    cvDone.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+    writer.join();
+
+    if (fReadError)
+        throw std::runtime_error("Error reading file " + strFile);
+    return fAnyError ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 static int CommandLineRawTx(int argc, char* argv[])
 {
     std::string strPrint;
@@ -730,6 +937,19 @@ static int CommandLineRawTx(int argc, char* argv[])
         }
 
         CMutableTransaction tx;
+
+        if (IsArgSet("-signbatch")) {
+            for (int i = 1; i < argc; i++) {
+                std::string arg = argv[i];
+                size_t eqpos = arg.find('=');
+                std::string key = arg.substr(0, eqpos);
+                if (key != "load" && key != "set")
+                    throw std::runtime_error("-signbatch only takes register commands");
+                MutateTx(tx, key, eqpos == std::string::npos ? "" : arg.substr(eqpos + 1));
+            }
+            return SignBatch(GetArg("-signbatch", ""));
+        }
+
         int startArg;
 
         if (!fCreateBlank) {
@@ -9,6 +9,7 @@
 
 #include "base58.h"
 #include "chainparams.h"
+#include "core_memusage.h"
 #include "core_io.h"
 #include "script/standard.h"
 #include "ui_interface.h"
@@ -20,6 +21,8 @@
 
 #include <univalue.h>
 
+#include <unordered_set>
+
 static const std::string DB_LIST_SNAPSHOT = "dmn_S";
 static const std::string DB_LIST_DIFF = "dmn_D";
 
@@ -186,11 +189,11 @@ CDeterministicMNCPtr CDeterministicMNList::GetValidMNByService(const CService& s
 
 CDeterministicMNCPtr CDeterministicMNList::GetMNByInternalId(uint64_t internalId) const
 {
-	auto proTxHash = mnInternalIdMap.find(internalId);
-	if (!proTxHash) {
+	auto dmn = mnInternalIdMap.find(internalId);
+	if (!dmn) {
 		return nullptr;
 	}
-	return GetMN(*proTxHash);
+	return *dmn;
 }
 
 
@@ -243,12 +246,13 @@ std::vector<CDeterministicMNCPtr> CDeterministicMNList::GetProjectedMNPayees(int
     }
 
     std::vector<CDeterministicMNCPtr> result;
-    result.reserve(nCount);
+    result.reserve(GetValidMNsCount());
 
     ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
         result.emplace_back(dmn);
     });
-    std::sort(result.begin(), result.end(), [&](const CDeterministicMNCPtr& a, const CDeterministicMNCPtr& b) {
+    // only the first nCount entries have to be in order
+    std::partial_sort(result.begin(), result.begin() + nCount, result.end(), [&](const CDeterministicMNCPtr& a, const CDeterministicMNCPtr& b) {
         return CompareByLastPaid(a, b);
     });
 
@@ -259,30 +263,42 @@ std::vector<CDeterministicMNCPtr> CDeterministicMNList::GetProjectedMNPayees(int
 
 std::vector<CDeterministicMNCPtr> CDeterministicMNList::CalculateQuorum(size_t maxSize, const uint256& modifier) const
 {
-    auto scores = CalculateScores(modifier);
-
-    // sort is descending order
-    std::sort(scores.rbegin(), scores.rend(), [](const std::pair<arith_uint256, CDeterministicMNCPtr>& a, std::pair<arith_uint256, CDeterministicMNCPtr>& b) {
-        if (a.first == b.first) {
+    std::vector<arith_uint256> scores;
+    std::vector<CDeterministicMNCPtr> mns;
+    CalculateScores(modifier, scores, mns);
+
+    // descending by score, only the top maxSize entries have to be found and sorted
+    std::vector<uint32_t> order(scores.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = (uint32_t)i;
+    }
+    auto cmp = [&](uint32_t a, uint32_t b) {
+        if (scores[a] == scores[b]) {
             // this should actually never happen, but we should stay compatible with how the non deterministic MNs did the sorting
-            return a.second->collateralOutpoint < b.second->collateralOutpoint;
+            return mns[b]->collateralOutpoint < mns[a]->collateralOutpoint;
         }
-        return a.first < b.first;
-    });
+        return scores[b] < scores[a];
+    };
+    size_t nSize = std::min(maxSize, order.size());
+    if (nSize < order.size()) {
+        std::nth_element(order.begin(), order.begin() + nSize, order.end(), cmp);
+    }
+    std::sort(order.begin(), order.begin() + nSize, cmp);
 
-    // take top maxSize entries and return it
     std::vector<CDeterministicMNCPtr> result;
-    result.resize(std::min(maxSize, scores.size()));
+    result.resize(nSize);
     for (size_t i = 0; i < result.size(); i++) {
-        result[i] = std::move(scores[i].second);
+        result[i] = std::move(mns[order[i]]);
     }
     return result;
 }
 
-std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> CDeterministicMNList::CalculateScores(const uint256& modifier) const
+void CDeterministicMNList::CalculateScores(const uint256& modifier, std::vector<arith_uint256>& scoresRet, std::vector<CDeterministicMNCPtr>& mnsRet) const
 {
-    std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> scores;
-    scores.reserve(GetAllMNsCount());
+    scoresRet.clear();
+    mnsRet.clear();
+    scoresRet.reserve(GetAllMNsCount());
+    mnsRet.reserve(GetAllMNsCount());
     ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
         if (dmn->pdmnState->confirmedHash.IsNull()) {
             // we only take confirmed MNs into account to avoid hash grinding on the ProRegTxHash to sneak MNs into a
@@ -299,10 +315,23 @@ std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> CDeterministicMNList
         sha256.Write(modifier.begin(), modifier.size());
         sha256.Finalize(h.begin());
 
-        scores.emplace_back(UintToArith256(h), dmn);
+        scoresRet.emplace_back(UintToArith256(h));
+        mnsRet.emplace_back(dmn);
     });
+}
 
-    return scores;
+std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> CDeterministicMNList::CalculateScores(const uint256& modifier) const
+{
+    std::vector<arith_uint256> scores;
+    std::vector<CDeterministicMNCPtr> mns;
+    CalculateScores(modifier, scores, mns);
+
+    std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> result;
+    result.reserve(scores.size());
+    for (size_t i = 0; i < scores.size(); i++) {
+        result.emplace_back(scores[i], std::move(mns[i]));
+    }
+    return result;
 }
 
 int CDeterministicMNList::CalcMaxPoSePenalty() const
@@ -445,11 +474,48 @@ CDeterministicMNList CDeterministicMNList::ApplyDiff(const CBlockIndex* pindex,
     return result;
 }
 
+bool CDeterministicMNListDiff::Merge(const CDeterministicMNListDiff& next)
+{
+	// addedMNs is sorted by internalId
+	auto findAdded = [&](uint64_t internalId) {
+		auto it = std::lower_bound(addedMNs.begin(), addedMNs.end(), internalId, [](const CDeterministicMNCPtr& dmn, uint64_t id) {
+			return dmn->internalId < id;
+		});
+		return (it != addedMNs.end() && (*it)->internalId == internalId) ? it : addedMNs.end();
+	};
+
+	for (const auto& id : next.removedMns) {
+		if (findAdded(id) != addedMNs.end()) {
+			return false;
+		}
+	}
+
+	for (const auto& id : next.removedMns) {
+		updatedMNs.erase(id);
+		removedMns.emplace(id);
+	}
+	addedMNs.insert(addedMNs.end(), next.addedMNs.begin(), next.addedMNs.end());
+	for (const auto& p : next.updatedMNs) {
+		auto it = findAdded(p.first);
+		if (it == addedMNs.end()) {
+			updatedMNs[p.first].Merge(p.second);
+			continue;
+		}
+		// added by an earlier diff, it's added with the new state right away
+		auto dmn = std::make_shared<CDeterministicMN>(**it);
+		auto newState = std::make_shared<CDeterministicMNState>(*dmn->pdmnState);
+		p.second.ApplyToState(*newState);
+		dmn->pdmnState = newState;
+		*it = dmn;
+	}
+	return true;
+}
+
 void CDeterministicMNList::AddMN(const CDeterministicMNCPtr& dmn)
 {
     assert(!mnMap.find(dmn->proTxHash));
     mnMap = mnMap.set(dmn->proTxHash, dmn);
-	mnInternalIdMap = mnInternalIdMap.set(dmn->internalId, dmn->proTxHash);
+	mnInternalIdMap = mnInternalIdMap.set(dmn->internalId, dmn);
     AddUniqueProperty(dmn, dmn->collateralOutpoint);
     if (dmn->pdmnState->addr != CService()) {
         AddUniqueProperty(dmn, dmn->pdmnState->addr);
@@ -467,6 +533,7 @@ void CDeterministicMNList::UpdateMN(const CDeterministicMNCPtr& oldDmn, const CD
     auto oldState = dmn->pdmnState;
     dmn->pdmnState = pdmnState;
 	mnMap = mnMap.set(oldDmn->proTxHash, dmn);
+	mnInternalIdMap = mnInternalIdMap.set(dmn->internalId, dmn);
 
     UpdateUniqueProperty(dmn, oldState->addr, pdmnState->addr);
     UpdateUniqueProperty(dmn, oldState->keyIDOwner, pdmnState->keyIDOwner);
@@ -596,6 +663,7 @@ bool CDeterministicMNManager::UndoBlock(const CBlock& block, const CBlockIndex*
         evoDb.Erase(std::make_pair(DB_LIST_SNAPSHOT, blockHash));
 
         mnListsCache.erase(blockHash);
+        mnListsColdCache.erase(blockHash);
     }
 
     if (diff.HasChanges()) {
@@ -617,6 +685,9 @@ void CDeterministicMNManager::UpdatedBlockTip(const CBlockIndex* pindex)
     LOCK(cs);
 
 	tipIndex = pindex;
+    auto newTipList = std::make_shared<const CDeterministicMNList>(GetListForBlock(pindex));
+    std::atomic_store(&tipList, std::move(newTipList));
+    tipHeight = pindex->nHeight;
 }
 
 bool CDeterministicMNManager::BuildNewListFromBlock(const CBlock& block, const CBlockIndex* pindexPrev, CValidationState& _state, CDeterministicMNList& mnListRet, bool debugLogs)
@@ -899,6 +970,18 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
 {
     LOCK(cs);
 
+    const uint256 blockHashRequested = pindex->GetBlockHash();
+    const int nHotHeight = tipIndex ? tipIndex->nHeight - LISTS_CACHE_SIZE : -1;
+    auto isCached = [&](const CBlockIndex* pindexList, bool fCheckpoint) {
+        return pindexList->nHeight >= nHotHeight || fCheckpoint || pindexList->nHeight % LISTS_COLD_CHECKPOINT_PERIOD == 0;
+    };
+    auto cacheList = [&](const CBlockIndex* pindexList, const CDeterministicMNList& list, bool fCheckpoint) {
+        if (pindexList->nHeight >= nHotHeight) {
+            mnListsCache.emplace(pindexList->GetBlockHash(), list);
+        } else if (fCheckpoint || pindexList->nHeight % LISTS_COLD_CHECKPOINT_PERIOD == 0) {
+            mnListsColdCache.insert(pindexList->GetBlockHash(), list);
+        }
+    };
 
     CDeterministicMNList snapshot;
     std::list<std::pair<const CBlockIndex*, CDeterministicMNListDiff>> listDiff;
@@ -908,18 +991,29 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
 		auto it = mnListsCache.find(pindex->GetBlockHash());
         if (it != mnListsCache.end()) {
             snapshot = it->second;
+            if (listDiff.empty()) {
+                nCacheHotHits++;
+                return snapshot;
+            }
+            break;
+        }
+        if (mnListsColdCache.get(pindex->GetBlockHash(), snapshot)) {
+            if (listDiff.empty()) {
+                nCacheColdHits++;
+                return snapshot;
+            }
             break;
         }
 
 		if (evoDb.Read(std::make_pair(DB_LIST_SNAPSHOT, pindex->GetBlockHash()), snapshot)) {
-			mnListsCache.emplace(pindex->GetBlockHash(), snapshot);
+			cacheList(pindex, snapshot, true);
             break;
         }
 
         CDeterministicMNListDiff diff;
 		if (!evoDb.Read(std::make_pair(DB_LIST_DIFF, pindex->GetBlockHash()), diff)) {
 			snapshot = CDeterministicMNList(pindex->GetBlockHash(), -1, 0);
-			mnListsCache.emplace(pindex->GetBlockHash(), snapshot);
+			cacheList(pindex, snapshot, true);
             break;
         }
 
@@ -927,17 +1021,47 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
 		pindex = pindex->pprev;
     }
 
-	for (const auto& p : listDiff) {
+    nCacheMisses++;
+    nCacheDiffsApplied += listDiff.size();
+
+    // The lists between the cached ones are never looked at, so the diffs in between are merged
+    // and applied at once. That's one new version of the maps for every MN changed instead of one
+    // for every block it changed in, PoSe penalties for example go down in every block.
+    CDeterministicMNListDiff pendingDiff;
+    const CBlockIndex* pindexPending = nullptr;
+    auto applyPending = [&]() {
+        if (pindexPending != nullptr) {
+            snapshot = snapshot.ApplyDiff(pindexPending, pendingDiff);
+            pendingDiff = CDeterministicMNListDiff();
+            pindexPending = nullptr;
+        }
+    };
+
+	for (auto& p : listDiff) {
 		auto diffIndex = p.first;
 		auto& diff = p.second;
         if (diff.HasChanges()) {
-			snapshot = snapshot.ApplyDiff(diffIndex, diff);
-        } else {
+            if (pindexPending != nullptr && !pendingDiff.Merge(diff)) {
+                applyPending();
+            }
+            if (pindexPending == nullptr) {
+                pendingDiff = std::move(diff);
+            }
+            pindexPending = diffIndex;
+        }
+
+        bool fCheckpoint = diffIndex->GetBlockHash() == blockHashRequested;
+        if (isCached(diffIndex, fCheckpoint)) {
+            applyPending();
 			snapshot.SetBlockHash(diffIndex->GetBlockHash());
 			snapshot.SetHeight(diffIndex->nHeight);
-		}
-
-		mnListsCache.emplace(diffIndex->GetBlockHash(), snapshot);
+            cacheList(diffIndex, snapshot, fCheckpoint);
+        }
+    }
+    if (!listDiff.empty()) {
+        applyPending();
+        snapshot.SetBlockHash(listDiff.back().first->GetBlockHash());
+        snapshot.SetHeight(listDiff.back().first->nHeight);
     }
 
     return snapshot;
@@ -945,11 +1069,12 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
 
 CDeterministicMNList CDeterministicMNManager::GetListAtChainTip()
 {
-    LOCK(cs);
-	if (!tipIndex) {
+    auto list = std::atomic_load(&tipList);
+	if (!list) {
 		return{};
 	}
-	return GetListForBlock(tipIndex);
+    // lists are persistent maps, copying one only copies a few pointers
+	return *list;
 }
 
 bool CDeterministicMNManager::IsProTxWithCollateral(const CTransactionRef& tx, uint32_t n)
@@ -976,15 +1101,63 @@ bool CDeterministicMNManager::IsProTxWithCollateral(const CTransactionRef& tx, u
 
 bool CDeterministicMNManager::IsDIP3Enforced(int nHeight)
 {
-    LOCK(cs);
-
     if (nHeight == -1) {
-        nHeight = tipIndex->nHeight;
+        nHeight = tipHeight;
     }
 
     return nHeight >= Params().GetConsensus().DIP0003EnforcementHeight;
 }
 
+CDeterministicMNListCacheStats CDeterministicMNManager::GetListCacheStats()
+{
+    LOCK(cs);
+    CDeterministicMNListCacheStats stats;
+    stats.nHotEntries = mnListsCache.size();
+    stats.nColdEntries = mnListsColdCache.size();
+    stats.nHotHits = nCacheHotHits;
+    stats.nColdHits = nCacheColdHits;
+    stats.nMisses = nCacheMisses;
+    stats.nDiffsApplied = nCacheDiffsApplied;
+    return stats;
+}
+
+memusage::SubsystemUsage CDeterministicMNManager::GetListCacheMemoryUsage()
+{
+    LOCK(cs);
+    memusage::SubsystemUsage usage;
+    usage.nEntries = mnListsCache.size() + mnListsColdCache.size();
+    usage.nBytes = memusage::DynamicUsage(mnListsCache) + mnListsColdCache.DynamicMemoryUsage();
+
+    // The lists share most of their maps and masternodes, so each masternode and state is counted once and
+    // the maps only for the newest list. The older lists each hold some more map nodes than that
+    std::unordered_set<const void*> setSeen;
+    const CDeterministicMNList* pnewestList = nullptr;
+    auto countList = [&](const CDeterministicMNList& mnList) {
+        if (!pnewestList || mnList.GetHeight() > pnewestList->GetHeight()) {
+            pnewestList = &mnList;
+        }
+        mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+            if (setSeen.emplace(dmn.get()).second) {
+                usage.nBytes += memusage::DynamicUsage(dmn);
+            }
+            const CDeterministicMNStateCPtr& state = dmn->pdmnState;
+            if (setSeen.emplace(state.get()).second) {
+                usage.nBytes += memusage::DynamicUsage(state) + RecursiveDynamicUsage(state->scriptPayout) + RecursiveDynamicUsage(state->scriptOperatorPayout);
+            }
+        });
+    };
+    for (const auto& p : mnListsCache) {
+        countList(p.second);
+    }
+    mnListsColdCache.ForEach([&](const uint256& blockHash, const CDeterministicMNList& mnList) {
+        countList(mnList);
+    });
+    if (pnewestList) {
+        usage.nBytes += pnewestList->GetMapsMemoryUsage();
+    }
+    return usage;
+}
+
 void CDeterministicMNManager::CleanupCache(int nHeight)
 {
     AssertLockHeld(cs);
@@ -11,14 +11,19 @@
 #include "bls/bls.h"
 #include "dbwrapper.h"
 #include "evodb.h"
+#include "memusage.h"
 #include "providertx.h"
 #include "simplifiedmns.h"
+#include "saltedhasher.h"
 #include "sync.h"
+#include "unordered_lru_cache.h"
 
 #include "immer/map.hpp"
 #include "immer/map_transient.hpp"
 
+#include <atomic>
 #include <map>
+#include <memory>
 
 class CBlock;
 class CBlockIndex;
@@ -46,7 +51,8 @@ public:
     uint256 confirmedHashWithProRegTxHash;
 
     CKeyID keyIDOwner;
-    CBLSLazyPublicKey pubKeyOperator;
+    // shared with the copies of this state in the next MN lists
+    CBLSSharedLazyPublicKey pubKeyOperator;
     CKeyID keyIDVoting;
     CService addr;
     CScript scriptPayout;
@@ -185,6 +191,14 @@ public:
 	{
 #define DMN_STATE_DIFF_LINE(f) if (fields & Field_##f) target.f = state.f;
 		DMN_STATE_DIFF_ALL_FIELDS
+#undef DMN_STATE_DIFF_LINE
+	}
+
+	// makes this diff do what applying it and then next does
+	void Merge(const CDeterministicMNStateDiff& next)
+	{
+#define DMN_STATE_DIFF_LINE(f) if (next.fields & Field_##f) { state.f = next.state.f; fields |= Field_##f; }
+		DMN_STATE_DIFF_ALL_FIELDS
 #undef DMN_STATE_DIFF_LINE
 	}
 };
@@ -280,7 +294,7 @@ class CDeterministicMNList
 {
 public:
     typedef immer::map<uint256, CDeterministicMNCPtr> MnMap;
-	typedef immer::map<uint64_t, uint256> MnInternalIdMap;
+	typedef immer::map<uint64_t, CDeterministicMNCPtr> MnInternalIdMap;
     typedef immer::map<uint256, std::pair<uint256, uint32_t> > MnUniquePropertyMap;
 
 private:
@@ -345,6 +359,14 @@ public:
         return mnMap.size();
     }
 
+    //! What the maps take, but not the masternodes in them. Lists share both with the ones they were built from
+    size_t GetMapsMemoryUsage() const
+    {
+        return mnMap.size() * sizeof(MnMap::value_type) +
+               mnInternalIdMap.size() * sizeof(MnInternalIdMap::value_type) +
+               mnUniquePropertyMap.size() * sizeof(MnUniquePropertyMap::value_type);
+    }
+
     size_t GetValidMNsCount() const
     {
         size_t count = 0;
@@ -439,6 +461,8 @@ public:
      */
     std::vector<CDeterministicMNCPtr> CalculateQuorum(size_t maxSize, const uint256& modifier) const;
     std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> CalculateScores(const uint256& modifier) const;
+    // Same scores as above, but in two separate arrays so ranking them touches less memory
+    void CalculateScores(const uint256& modifier, std::vector<arith_uint256>& scoresRet, std::vector<CDeterministicMNCPtr>& mnsRet) const;
 
     /**
      * Calculates the maximum penalty which is allowed at the height of this MN list. It is dynamic and might change
@@ -600,6 +624,13 @@ public:
     {
         return !addedMNs.empty() || !updatedMNs.empty() || !removedMns.empty();
     }
+
+    /**
+     * Makes this diff do what applying it and then next does, so a replay of several diffs
+     * builds one list instead of one per block. Fails without changing anything if next
+     * removes a MN this diff adds, the internalIds of the merged additions would have a gap.
+     */
+    bool Merge(const CDeterministicMNListDiff& next);
 };
 
 // TODO can be removed in a future version
@@ -633,10 +664,25 @@ public:
 	}
 };
 
+struct CDeterministicMNListCacheStats
+{
+    size_t nHotEntries;
+    size_t nColdEntries;
+    uint64_t nHotHits;
+    uint64_t nColdHits;
+    uint64_t nMisses;
+    uint64_t nDiffsApplied;
+};
+
 class CDeterministicMNManager
 {
     static const int SNAPSHOT_LIST_PERIOD = 576; // once per day
     static const int LISTS_CACHE_SIZE = 576;
+    // Lists older than LISTS_CACHE_SIZE blocks go to a small LRU instead. Of the lists replayed to
+    // get there, only every LISTS_COLD_CHECKPOINT_PERIOD'th one is kept, enough to keep the next
+    // lookup close by short without filling the LRU.
+    static const int LISTS_COLD_CACHE_SIZE = 64;
+    static const int LISTS_COLD_CHECKPOINT_PERIOD = 32;
 
 public:
     CCriticalSection cs;
@@ -644,8 +690,16 @@ public:
 private:
     CEvoDB& evoDb;
 
-    std::map<uint256, CDeterministicMNList> mnListsCache;
+    std::map<uint256, CDeterministicMNList> mnListsCache; // lists for the last LISTS_CACHE_SIZE blocks
+    unordered_lru_cache<uint256, CDeterministicMNList, StaticSaltedHasher, LISTS_COLD_CACHE_SIZE> mnListsColdCache;
+    uint64_t nCacheHotHits{0};
+    uint64_t nCacheColdHits{0};
+    uint64_t nCacheMisses{0};
+    uint64_t nCacheDiffsApplied{0};
 	const CBlockIndex* tipIndex{ nullptr };
+    // Published by UpdatedBlockTip and read without cs, always through std::atomic_load/atomic_store
+    std::shared_ptr<const CDeterministicMNList> tipList;
+    std::atomic<int> tipHeight{-1};
 
 public:
     CDeterministicMNManager(CEvoDB& _evoDb);
@@ -662,7 +716,10 @@ public:
     void DecreasePoSePenalties(CDeterministicMNList& mnList);
 
 	CDeterministicMNList GetListForBlock(const CBlockIndex* pindex);
+    // Doesn't take cs, so it never waits for a block being processed
     CDeterministicMNList GetListAtChainTip();
+    CDeterministicMNListCacheStats GetListCacheStats();
+    memusage::SubsystemUsage GetListCacheMemoryUsage();
 
     // Test if given TX is a ProRegTx which also contains the collateral at index n
     bool IsProTxWithCollateral(const CTransactionRef& tx, uint32_t n);
@@ -7,7 +7,9 @@
 #include "mnauth.h"
 
 #include "activemasternode.h"
+#include "bls/bls_worker.h"
 #include "evo/deterministicmns.h"
+#include "llmq/quorums_init.h"
 #include "masternode-sync.h"
 #include "net.h"
 #include "net_processing.h"
@@ -60,11 +62,12 @@ void CMNAuth::ProcessMessage(CNode* pnode, const std::string& strCommand, CDataS
         {
             LOCK(pnode->cs_mnauth);
             // only one MNAUTH allowed
-            if (!pnode->verifiedProRegTxHash.IsNull()) {
+            if (pnode->fReceivedMNAuth) {
                 LOCK(cs_main);
                 Misbehaving(pnode->id, 100);
                 return;
             }
+            pnode->fReceivedMNAuth = true;
         }
 
         if (mnauth.proRegTxHash.IsNull() || !mnauth.sig.IsValid()) {
@@ -91,29 +94,37 @@ void CMNAuth::ProcessMessage(CNode* pnode, const std::string& strCommand, CDataS
             signHash = ::SerializeHash(std::make_tuple(dmn->pdmnState->pubKeyOperator, pnode->sentMNAuthChallenge, !pnode->fInbound));
         }
 
-        if (!mnauth.sig.VerifyInsecure(dmn->pdmnState->pubKeyOperator.Get(), signHash)) {
-            LOCK(cs_main);
-            // Same as above, MN seems to not know about his fate yet, so give him a chance to update. If this is a
-            // malicious actor (DoSing us), we'll ban him soon.
-            Misbehaving(pnode->id, 10);
-            return;
-        }
+        // The signature is checked in a batch on the BLS worker threads, so a burst of MNAUTHs at the start of a DKG
+        // doesn't hold up the message handler. The result is applied to the node by id as it may be gone by then.
+        NodeId nodeId = pnode->id;
+        uint256 proTxHash = mnauth.proRegTxHash;
+        uint256 pubKeyHash = dmn->pdmnState->pubKeyOperator.GetHash();
+        auto doneCallback = [nodeId, proTxHash, pubKeyHash, &connman](bool fValid) {
+            if (!fValid) {
+                LOCK(cs_main);
+                // Same as above, MN seems to not know about his fate yet, so give him a chance to update. If this is a
+                // malicious actor (DoSing us), we'll ban him soon.
+                Misbehaving(nodeId, 10);
+                return;
+            }
 
-        connman.ForEachNode([&](CNode* pnode2) {
-            if (pnode2->verifiedProRegTxHash == mnauth.proRegTxHash) {
-                LogPrint("net", "CMNAuth::ProcessMessage -- Masternode %s has already verified as peer %d, dropping old connection. peer=%d\n",
-                        mnauth.proRegTxHash.ToString(), pnode2->id, pnode->id);
-                pnode2->fDisconnect = true;
+            // The key might have changed while we were verifying, NotifyMasternodeListChanged only sees verified nodes
+            auto dmnTip = deterministicMNManager->GetListAtChainTip().GetMN(proTxHash);
+            if (!dmnTip || dmnTip->pdmnState->pubKeyOperator.GetHash() != pubKeyHash) {
+                LogPrint("net", "CMNAuth::ProcessMessage -- MNAUTH for %s outdated by MN list change, peer=%d\n", proTxHash.ToString(), nodeId);
+                return;
             }
-        });
 
-        {
-            LOCK(pnode->cs_mnauth);
-            pnode->verifiedProRegTxHash = mnauth.proRegTxHash;
-            pnode->verifiedPubKeyHash = dmn->pdmnState->pubKeyOperator.GetHash();
-        }
+            if (connman.SetVerifiedMasternode(nodeId, proTxHash, pubKeyHash)) {
+                LogPrint("net", "CMNAuth::ProcessMessage -- Valid MNAUTH for %s, peer=%d\n", proTxHash.ToString(), nodeId);
+            }
+        };
 
-        LogPrint("net", "CMNAuth::%s -- Valid MNAUTH for %s, peer=%d\n", __func__, mnauth.proRegTxHash.ToString(), pnode->id);
+        if (llmq::blsWorker) {
+            llmq::blsWorker->AsyncVerifySig(mnauth.sig, dmn->pdmnState->pubKeyOperator.Get(), signHash, doneCallback);
+        } else {
+            doneCallback(mnauth.sig.VerifyInsecure(dmn->pdmnState->pubKeyOperator.Get(), signHash));
+        }
     }
 }
 
@@ -124,31 +135,29 @@ void CMNAuth::NotifyMasternodeListChanged(bool undo, const CDeterministicMNList&
         return;
     }
 
-    g_connman->ForEachNode([&](CNode* pnode) {
-        LOCK(pnode->cs_mnauth);
-        if (pnode->verifiedProRegTxHash.IsNull()) {
+    // look up the connections of the affected MNs instead of going through all nodes
+    auto disconnect = [&](uint64_t internalId, const CDeterministicMNStateDiff* stateDiff) {
+        auto verifiedDmn = oldMNList.GetMNByInternalId(internalId);
+        if (!verifiedDmn) {
             return;
         }
-		auto verifiedDmn = oldMNList.GetMN(pnode->verifiedProRegTxHash);
-		if (!verifiedDmn) {
-			return;
-		}
-        bool doRemove = false;
-		if (diff.removedMns.count(verifiedDmn->internalId)) {
-            doRemove = true;
-        } else {
-			auto it = diff.updatedMNs.find(verifiedDmn->internalId);
-            if (it != diff.updatedMNs.end()) {
-				if ((it->second.fields & CDeterministicMNStateDiff::Field_pubKeyOperator) && it->second.state.pubKeyOperator.GetHash() != pnode->verifiedPubKeyHash) {
-                    doRemove = true;
-                }
+        g_connman->ForVerifiedMasternode(verifiedDmn->proTxHash, [&](CNode* pnode) {
+            LOCK(pnode->cs_mnauth);
+            if (stateDiff && stateDiff->state.pubKeyOperator.GetHash() == pnode->verifiedPubKeyHash) {
+                return;
             }
-        }
-
-        if (doRemove) {
             LogPrint("net", "CMNAuth::NotifyMasternodeListChanged -- Disconnecting MN %s due to key changed/removed, peer=%d\n",
                      pnode->verifiedProRegTxHash.ToString(), pnode->id);
             pnode->fDisconnect = true;
+        });
+    };
+
+    for (const auto& internalId : diff.removedMns) {
+        disconnect(internalId, nullptr);
+    }
+    for (const auto& p : diff.updatedMNs) {
+        if (p.second.fields & CDeterministicMNStateDiff::Field_pubKeyOperator) {
+            disconnect(p.first, &p.second);
         }
-    });
+    }
 }
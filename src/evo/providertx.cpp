@@ -9,6 +9,7 @@
 #include "specialtx.h"
 
 #include "base58.h"
+#include "bls/bls_sigcache.h"
 #include "chainparams.h"
 #include "clientversion.h"
 #include "core_io.h"
@@ -68,7 +69,7 @@ static bool CheckStringSig(const ProTx& proTx, const CKeyID& keyID, CValidationS
 template <typename ProTx>
 static bool CheckHashSig(const ProTx& proTx, const CBLSPublicKey& pubKey, CValidationState& state)
 {
-    if (!proTx.sig.VerifyInsecure(pubKey, ::SerializeHash(proTx))) {
+    if (!VerifyBLSSignatureCached(proTx.sig, pubKey, ::SerializeHash(proTx))) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig", false);
     }
     return true;
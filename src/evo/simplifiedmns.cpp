@@ -14,9 +14,14 @@
 #include "base58.h"
 #include "chainparams.h"
 #include "consensus/merkle.h"
+#include "saltedhasher.h"
+#include "streams.h"
 #include "univalue.h"
+#include "unordered_lru_cache.h"
 #include "validation.h"
 
+#include <atomic>
+
 CSimplifiedMNListEntry::CSimplifiedMNListEntry(const CDeterministicMN& dmn) :
     proRegTxHash(dmn.proTxHash),
     confirmedHash(dmn.pdmnState->confirmedHash),
@@ -85,7 +90,46 @@ uint256 CSimplifiedMNList::CalcMerkleRoot(bool* pmutated) const
     for (const auto& e : mnList) {
         leaves.emplace_back(e->CalcHash());
     }
-    return ComputeMerkleRoot(leaves, pmutated);
+    return ComputeMerkleRoot(std::move(leaves), pmutated);
+}
+
+uint256 CSimplifiedMNListMerkleCache::CalcMerkleRoot(const CDeterministicMNList& dmnList, bool* pmutated)
+{
+    nGeneration++;
+
+    // leaves in the order of CSimplifiedMNList, by proRegTxHash
+    std::vector<std::pair<uint256, uint256>> sorted;
+    sorted.reserve(dmnList.GetAllMNsCount());
+    dmnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+        Leaf& leaf = leaves[dmn->proTxHash];
+        if (leaf.state != dmn->pdmnState || leaf.state == nullptr) {
+            leaf.state = dmn->pdmnState;
+            leaf.hash = CSimplifiedMNListEntry(*dmn).CalcHash();
+        }
+        leaf.nGeneration = nGeneration;
+        sorted.emplace_back(dmn->proTxHash, leaf.hash);
+    });
+
+    // forget the masternodes that are gone, so their states aren't kept alive
+    if (leaves.size() != sorted.size()) {
+        for (auto it = leaves.begin(); it != leaves.end(); ) {
+            if (it->second.nGeneration != nGeneration) {
+                it = leaves.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<uint256, uint256>& a, const std::pair<uint256, uint256>& b) {
+        return a.first.Compare(b.first) < 0;
+    });
+    std::vector<uint256> hashes;
+    hashes.reserve(sorted.size());
+    for (const auto& p : sorted) {
+        hashes.emplace_back(p.second);
+    }
+    return ComputeMerkleRoot(std::move(hashes), pmutated);
 }
 
 CSimplifiedMNListDiff::CSimplifiedMNListDiff()
@@ -185,10 +229,9 @@ void CSimplifiedMNListDiff::ToJson(UniValue& obj) const
     }
 }
 
-bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet)
+static bool GetMNListDiffBlocks(const uint256& baseBlockHash, const uint256& blockHash, const CBlockIndex*& baseBlockIndexRet, const CBlockIndex*& blockIndexRet, std::string& errorRet)
 {
     AssertLockHeld(cs_main);
-    mnListDiffRet = CSimplifiedMNListDiff();
 
     const CBlockIndex* baseBlockIndex = chainActive.Genesis();
     if (!baseBlockHash.IsNull()) {
@@ -215,6 +258,22 @@ bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& bloc
         return false;
     }
 
+    baseBlockIndexRet = baseBlockIndex;
+    blockIndexRet = blockIndex;
+    return true;
+}
+
+bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet)
+{
+    AssertLockHeld(cs_main);
+    mnListDiffRet = CSimplifiedMNListDiff();
+
+    const CBlockIndex* baseBlockIndex;
+    const CBlockIndex* blockIndex;
+    if (!GetMNListDiffBlocks(baseBlockHash, blockHash, baseBlockIndex, blockIndex, errorRet)) {
+        return false;
+    }
+
     LOCK(deterministicMNManager->cs);
 
 	auto baseDmnList = deterministicMNManager->GetListForBlock(baseBlockIndex);
@@ -250,3 +309,60 @@ bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& bloc
 
     return true;
 }
+
+// by the (baseBlockHash, blockHash) as asked for, protected by cs_main
+static unordered_lru_cache<std::pair<uint256, uint256>, CCachedSimplifiedMNListDiffCPtr, StaticSaltedHasher, 256> mnListDiffCache;
+static std::atomic<bool> fMNListDiffRequested{false};
+
+static bool GetOrBuildMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CCachedSimplifiedMNListDiffCPtr& mnListDiffRet, std::string& errorRet)
+{
+    AssertLockHeld(cs_main);
+
+    // the blocks have to be checked every time, the chain might have been reorganized since
+    const CBlockIndex* baseBlockIndex;
+    const CBlockIndex* blockIndex;
+    if (!GetMNListDiffBlocks(baseBlockHash, blockHash, baseBlockIndex, blockIndex, errorRet)) {
+        return false;
+    }
+
+    auto key = std::make_pair(baseBlockHash, blockHash);
+    if (mnListDiffCache.get(key, mnListDiffRet)) {
+        return true;
+    }
+
+    auto entry = std::make_shared<CCachedSimplifiedMNListDiff>();
+    if (!BuildSimplifiedMNListDiff(baseBlockHash, blockHash, entry->diff, errorRet)) {
+        return false;
+    }
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, entry->vchData, 0, entry->diff);
+
+    mnListDiffRet = entry;
+    mnListDiffCache.insert(key, mnListDiffRet);
+    return true;
+}
+
+bool GetSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CCachedSimplifiedMNListDiffCPtr& mnListDiffRet, std::string& errorRet)
+{
+    fMNListDiffRequested = true;
+    return GetOrBuildMNListDiff(baseBlockHash, blockHash, mnListDiffRet, errorRet);
+}
+
+void PrecomputeSimplifiedMNListDiffs(const CBlockIndex* pindexNew)
+{
+    if (!fMNListDiffRequested.exchange(false)) {
+        return;
+    }
+
+    LOCK(cs_main);
+    std::vector<uint256> vBases = {uint256()};
+    if (pindexNew->pprev) {
+        vBases.emplace_back(pindexNew->pprev->GetBlockHash());
+    }
+    for (const auto& baseBlockHash : vBases) {
+        CCachedSimplifiedMNListDiffCPtr mnListDiff;
+        std::string strError;
+        if (!GetOrBuildMNListDiff(baseBlockHash, pindexNew->GetBlockHash(), mnListDiff, strError)) {
+            LogPrint("net", "%s -- failed for baseBlockHash=%s, blockHash=%s. error=%s\n", __func__, baseBlockHash.ToString(), pindexNew->GetBlockHash().ToString(), strError);
+        }
+    }
+}
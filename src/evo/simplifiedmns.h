@@ -9,12 +9,16 @@
 #include "merkleblock.h"
 #include "netaddress.h"
 #include "pubkey.h"
+#include "saltedhasher.h"
 #include "serialize.h"
 #include "version.h"
 
+#include <unordered_map>
+
 class UniValue;
 class CDeterministicMNList;
 class CDeterministicMN;
+class CDeterministicMNState;
 
 namespace llmq
 {
@@ -84,6 +88,30 @@ public:
     uint256 CalcMerkleRoot(bool* pmutated = NULL) const;
 };
 
+/**
+ * Computes the merkle root of the simplified MN list of one CDeterministicMNList after
+ * another, keeping the hash of every entry. An entry only depends on the proTxHash and the
+ * state of a masternode and states are immutable, so entries whose state object is the same
+ * as last time are not built and hashed again. Between two blocks this leaves only the
+ * masternodes the block touched, the inner nodes of the tree are cheap in comparison.
+ * Not thread safe.
+ */
+class CSimplifiedMNListMerkleCache
+{
+private:
+    struct Leaf {
+        std::shared_ptr<const CDeterministicMNState> state;
+        uint256 hash;
+        uint64_t nGeneration;
+    };
+    std::unordered_map<uint256, Leaf, StaticSaltedHasher> leaves;
+    uint64_t nGeneration{0};
+
+public:
+    //! Same result as CSimplifiedMNList(dmnList).CalcMerkleRoot(pmutated)
+    uint256 CalcMerkleRoot(const CDeterministicMNList& dmnList, bool* pmutated = nullptr);
+};
+
 /// P2P messages
 
 class CGetSimplifiedMNListDiff
@@ -147,4 +175,26 @@ public:
 
 bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet);
 
+/** A diff together with its serialization for PROTOCOL_VERSION, shared by everyone asking for it */
+struct CCachedSimplifiedMNListDiff
+{
+    CSimplifiedMNListDiff diff;
+    std::vector<unsigned char> vchData;
+};
+typedef std::shared_ptr<const CCachedSimplifiedMNListDiff> CCachedSimplifiedMNListDiffCPtr;
+
+/**
+ * Like BuildSimplifiedMNListDiff, but the last few hundred diffs are kept. A diff only depends on
+ * the two blocks, so light clients asking for the same (baseBlockHash, blockHash) all get the
+ * same object and the same serialized bytes. Requires cs_main.
+ */
+bool GetSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CCachedSimplifiedMNListDiffCPtr& mnListDiffRet, std::string& errorRet);
+
+/**
+ * Called for every new tip. If diffs were asked for since the last one, the diffs from the genesis
+ * block and from the previous tip to the new tip are built right away, as these are what synced
+ * light clients ask for next.
+ */
+void PrecomputeSimplifiedMNListDiffs(const CBlockIndex* pindexNew);
+
 #endif //EPM_SIMPLIFIEDMNS_H
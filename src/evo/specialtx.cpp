@@ -108,6 +108,7 @@ bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CV
     }
 
     int64_t nTime2 = GetTimeMicros(); nTimeLoop += nTime2 - nTime1;
+    RecordBlockStageTime(BLOCK_STAGE_SPECIAL_TX_LOOP, nTime2 - nTime1);
     LogPrint("bench", "        - Loop: %.2fms [%.2fs]\n", 0.001 * (nTime2 - nTime1), nTimeLoop * 0.000001);
 
     if (!llmq::quorumBlockProcessor->ProcessBlock(block, pindex, state)) {
@@ -115,6 +116,7 @@ bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CV
     }
 
     int64_t nTime3 = GetTimeMicros(); nTimeQuorum += nTime3 - nTime2;
+    RecordBlockStageTime(BLOCK_STAGE_QUORUM_BLOCK_PROCESSOR, nTime3 - nTime2);
     LogPrint("bench", "        - quorumBlockProcessor: %.2fms [%.2fs]\n", 0.001 * (nTime3 - nTime2), nTimeQuorum * 0.000001);
 
     if (!deterministicMNManager->ProcessBlock(block, pindex, state, fJustCheck)) {
@@ -122,6 +124,7 @@ bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CV
     }
 
     int64_t nTime4 = GetTimeMicros(); nTimeDMN += nTime4 - nTime3;
+    RecordBlockStageTime(BLOCK_STAGE_DETERMINISTIC_MNS, nTime4 - nTime3);
     LogPrint("bench", "        - deterministicMNManager: %.2fms [%.2fs]\n", 0.001 * (nTime4 - nTime3), nTimeDMN * 0.000001);
 
     if (fCheckCbTxMerleRoots && !CheckCbTxMerkleRoots(block, pindex, state)) {
@@ -129,6 +132,7 @@ bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CV
     }
 
     int64_t nTime5 = GetTimeMicros(); nTimeMerkle += nTime5 - nTime4;
+    RecordBlockStageTime(BLOCK_STAGE_CBTX_MERKLE_ROOTS, nTime5 - nTime4);
     LogPrint("bench", "        - CheckCbTxMerkleRoots: %.2fms [%.2fs]\n", 0.001 * (nTime5 - nTime4), nTimeMerkle * 0.000001);
 
     return true;
@@ -156,6 +160,11 @@ bool UndoSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex)
 
 uint256 CalcTxInputsHash(const CTransaction& tx)
 {
+    auto entry = tx.GetPayloadCache();
+    if (entry) {
+        return entry->inputsHash;
+    }
+
     CHashWriter hw(CLIENT_VERSION, SER_GETHASH);
     for (const auto& in : tx.vin) {
         hw << in.prevout;
@@ -11,6 +11,9 @@
 #include "streams.h"
 #include "version.h"
 
+#include <memory>
+#include <typeindex>
+
 class CBlock;
 class CBlockIndex;
 class CValidationState;
@@ -35,10 +38,41 @@ inline bool GetTxPayload(const CMutableTransaction& tx, T& obj)
 {
     return GetTxPayload(tx.vExtraPayload, obj);
 }
+
+uint256 CalcTxInputsHash(const CTransaction& tx);
+
+/**
+ * The payload of a special transaction decoded as T, nullptr if it isn't one. It is
+ * only decoded the first time and then cached in the transaction, together with the
+ * inputs hash, so all the checks, the mempool, block processing and the RPCs of the
+ * same CTransaction share one copy.
+ */
+template <typename T>
+std::shared_ptr<const T> GetTxPayloadShared(const CTransaction& tx)
+{
+    auto entry = tx.GetPayloadCache();
+    if (entry && entry->type == std::type_index(typeid(T))) {
+        return std::static_pointer_cast<const T>(entry->obj);
+    }
+
+    auto obj = std::make_shared<T>();
+    std::shared_ptr<const T> ret;
+    if (GetTxPayload(tx.vExtraPayload, *obj)) {
+        ret = std::move(obj);
+    }
+    tx.SetPayloadCache(std::make_shared<const CTxPayloadCacheEntry>(std::type_index(typeid(T)), ret, CalcTxInputsHash(tx)));
+    return ret;
+}
+
 template <typename T>
 inline bool GetTxPayload(const CTransaction& tx, T& obj)
 {
-    return GetTxPayload(tx.vExtraPayload, obj);
+    auto ptr = GetTxPayloadShared<T>(tx);
+    if (!ptr) {
+        return false;
+    }
+    obj = *ptr;
+    return true;
 }
 
 template <typename T>
@@ -49,6 +83,4 @@ void SetTxPayload(CMutableTransaction& tx, const T& payload)
     tx.vExtraPayload.assign(ds.begin(), ds.end());
 }
 
-uint256 CalcTxInputsHash(const CTransaction& tx);
-
 #endif //EPM_SPECIALTX_H
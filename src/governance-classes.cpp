@@ -10,6 +10,11 @@
 #include "utilstrencodings.h"
 #include "validation.h"
 
+#include "evo/deterministicmns.h"
+
+#include <cstdlib>
+#include <iterator>
+
 #include <boost/algorithm/string.hpp>
 
 #include <univalue.h>
@@ -17,6 +22,8 @@
 // DECLARE GLOBAL VARIABLES FOR GOVERNANCE CLASSES
 CGovernanceTriggerManager triggerman;
 
+std::map<int, CSuperblockManager::CSuperblockCacheEntry> CSuperblockManager::mapCache;
+
 // SPLIT UP STRING BY DELIMITER
 // http://www.boost.org/doc/libs/1_58_0/doc/html/boost/algorithm/split_idp202406848.html
 std::vector<std::string> SplitBy(const std::string& strCommand, const std::string& strDelimit)
@@ -122,6 +129,7 @@ bool CGovernanceTriggerManager::AddNewTrigger(uint256 nHash)
     pSuperblock->SetStatus(SEEN_OBJECT_IS_VALID);
 
     mapTrigger.insert(std::make_pair(nHash, pSuperblock));
+    nRevision++;
 
     return true;
 }
@@ -186,6 +194,7 @@ void CGovernanceTriggerManager::CleanAndRemove()
             }
             // delete the trigger
             mapTrigger.erase(it++);
+            nRevision++;
         } else {
             ++it;
         }
@@ -229,62 +238,52 @@ bool CSuperblockManager::IsSuperblockTriggered(int nBlockHeight)
     }
 
     LOCK(governance.cs);
-    // GET ALL ACTIVE TRIGGERS
-    std::vector<CSuperblock_sptr> vecTriggers = triggerman.GetActiveTriggers();
+    return GetCacheEntry(nBlockHeight).fTriggered;
+}
 
-    LogPrint("gobject", "CSuperblockManager::IsSuperblockTriggered -- vecTriggers.size() = %d\n", vecTriggers.size());
+/**
+*   Get Cache Entry
+*
+*   - Returns the triggers for this height and their vote results, only recounting the votes when something changed
+*/
 
-    for (const auto& pSuperblock : vecTriggers) {
-        if (!pSuperblock) {
-            LogPrintf("CSuperblockManager::IsSuperblockTriggered -- Non-superblock found, continuing\n");
-            continue;
-        }
+const CSuperblockManager::CSuperblockCacheEntry& CSuperblockManager::GetCacheEntry(int nBlockHeight)
+{
+    AssertLockHeld(governance.cs);
 
-        CGovernanceObject* pObj = pSuperblock->GetGovernanceObject();
+    uint256 mnListBlockHash = deterministicMNManager->GetListAtChainTip().GetBlockHash();
 
-        if (!pObj) {
-            LogPrintf("CSuperblockManager::IsSuperblockTriggered -- pObj == nullptr, continuing\n");
-            continue;
+    auto it = mapCache.find(nBlockHeight);
+    if (it != mapCache.end() && it->second.nTriggersRevision == triggerman.nRevision && it->second.mnListBlockHash == mnListBlockHash) {
+        bool fValid = true;
+        for (const auto& p : it->second.vecTriggerRevisions) {
+            CGovernanceObject* pObj = governance.FindGovernanceObject(p.first);
+            if (!pObj || pObj->GetVoteRevision() != p.second) {
+                fValid = false;
+                break;
+            }
         }
-
-        LogPrint("gobject", "CSuperblockManager::IsSuperblockTriggered -- data = %s\n", pObj->GetDataAsPlainString());
-
-        // note : 12.1 - is epoch calculation correct?
-
-        if (nBlockHeight != pSuperblock->GetBlockHeight()) {
-            LogPrint("gobject", "CSuperblockManager::IsSuperblockTriggered -- block height doesn't match nBlockHeight = %d, blockStart = %d, continuing\n",
-                nBlockHeight,
-                pSuperblock->GetBlockHeight());
-            continue;
+        if (fValid) {
+            return it->second;
         }
+    }
 
-        // MAKE SURE THIS TRIGGER IS ACTIVE VIA FUNDING CACHE FLAG
-
-        pObj->UpdateSentinelVariables();
-
-        if (pObj->IsSetCachedFunding()) {
-            LogPrint("gobject", "CSuperblockManager::IsSuperblockTriggered -- fCacheFunding = true, returning true\n");
-            return true;
-        } else {
-            LogPrint("gobject", "CSuperblockManager::IsSuperblockTriggered -- fCacheFunding = false, continuing\n");
+    if (it == mapCache.end()) {
+        if (mapCache.size() >= MAX_CACHED_HEIGHTS) {
+            // heights are only asked for around the tip, drop the one furthest away
+            auto itFar = std::abs(mapCache.begin()->first - nBlockHeight) > std::abs(mapCache.rbegin()->first - nBlockHeight) ? mapCache.begin() : std::prev(mapCache.end());
+            mapCache.erase(itFar);
         }
+        it = mapCache.emplace(nBlockHeight, CSuperblockCacheEntry()).first;
     }
 
-    return false;
-}
-
-
-bool CSuperblockManager::GetBestSuperblock(CSuperblock_sptr& pSuperblockRet, int nBlockHeight)
-{
-    if (!CSuperblock::IsValidBlockHeight(nBlockHeight)) {
-        return false;
-    }
+    CSuperblockCacheEntry& entry = it->second;
+    entry = CSuperblockCacheEntry();
+    entry.nTriggersRevision = triggerman.nRevision;
+    entry.mnListBlockHash = mnListBlockHash;
 
-    AssertLockHeld(governance.cs);
-    std::vector<CSuperblock_sptr> vecTriggers = triggerman.GetActiveTriggers();
     int nYesCount = 0;
-
-    for (const auto& pSuperblock : vecTriggers) {
+    for (const auto& pSuperblock : triggerman.GetActiveTriggers()) {
         if (!pSuperblock || nBlockHeight != pSuperblock->GetBlockHeight()) {
             continue;
         }
@@ -295,16 +294,43 @@ bool CSuperblockManager::GetBestSuperblock(CSuperblock_sptr& pSuperblockRet, int
             continue;
         }
 
+        LogPrint("gobject", "CSuperblockManager::GetCacheEntry -- data = %s\n", pObj->GetDataAsPlainString());
+
+        entry.vecTriggerRevisions.emplace_back(pObj->GetHash(), pObj->GetVoteRevision());
+
+        // MAKE SURE THIS TRIGGER IS ACTIVE VIA FUNDING CACHE FLAG
+
+        pObj->UpdateSentinelVariables();
+        entry.fTriggered |= pObj->IsSetCachedFunding();
+
         // DO WE HAVE A NEW WINNER?
 
         int nTempYesCount = pObj->GetAbsoluteYesCount(VOTE_SIGNAL_FUNDING);
         if (nTempYesCount > nYesCount) {
             nYesCount = nTempYesCount;
-            pSuperblockRet = pSuperblock;
+            entry.pBestSuperblock = pSuperblock;
         }
     }
 
-    return nYesCount > 0;
+    LogPrint("gobject", "CSuperblockManager::GetCacheEntry -- nBlockHeight = %d, triggers = %d, fTriggered = %d, nYesCount = %d\n",
+        nBlockHeight, entry.vecTriggerRevisions.size(), entry.fTriggered, nYesCount);
+
+    return entry;
+}
+
+bool CSuperblockManager::GetBestSuperblock(CSuperblock_sptr& pSuperblockRet, int nBlockHeight)
+{
+    if (!CSuperblock::IsValidBlockHeight(nBlockHeight)) {
+        return false;
+    }
+
+    AssertLockHeld(governance.cs);
+    const CSuperblockCacheEntry& entry = GetCacheEntry(nBlockHeight);
+    if (!entry.pBestSuperblock) {
+        return false;
+    }
+    pSuperblockRet = entry.pBestSuperblock;
+    return true;
 }
 
 /**
@@ -336,26 +362,20 @@ bool CSuperblockManager::GetSuperblockPayments(int nBlockHeight, std::vector<CTx
     //       Consider at least following limits:
     //          - max coinbase tx size
     //          - max "budget" available
-    for (int i = 0; i < pSuperblock->CountPayments(); i++) {
-        CGovernancePayment payment;
-        if (pSuperblock->GetPayment(i, payment)) {
-            // SET COINBASE OUTPUT TO SUPERBLOCK SETTING
-
-            CTxOut txout = CTxOut(payment.nAmount, payment.script);
-            voutSuperblockRet.push_back(txout);
+    voutSuperblockRet = pSuperblock->GetPaymentOutputs();
 
+    if (LogAcceptCategory("gobject")) {
+        for (size_t i = 0; i < voutSuperblockRet.size(); i++) {
             // PRINT NICE LOG OUTPUT FOR SUPERBLOCK PAYMENT
 
             CTxDestination address1;
-            ExtractDestination(payment.script, address1);
+            ExtractDestination(voutSuperblockRet[i].scriptPubKey, address1);
             CBitcoinAddress address2(address1);
 
             // TODO: PRINT NICE N.N EPM OUTPUT
 
             LogPrint("gobject", "CSuperblockManager::GetSuperblockPayments -- NEW Superblock: output %d (addr %s, amount %lld)\n",
-                        i, address2.ToString(), payment.nAmount);
-        } else {
-            LogPrint("gobject", "CSuperblockManager::GetSuperblockPayments -- Payment not found\n");
+                        i, address2.ToString(), voutSuperblockRet[i].nValue);
         }
     }
 
@@ -392,7 +412,9 @@ CSuperblock::
     nGovObjHash(),
     nBlockHeight(0),
     nStatus(SEEN_OBJECT_UNKNOWN),
-    vecPayments()
+    vecPayments(),
+    voutPayments(),
+    nPaymentsTotalAmount(0)
 {
 }
 
@@ -401,7 +423,9 @@ CSuperblock::
     nGovObjHash(nHash),
     nBlockHeight(0),
     nStatus(SEEN_OBJECT_UNKNOWN),
-    vecPayments()
+    vecPayments(),
+    voutPayments(),
+    nPaymentsTotalAmount(0)
 {
     CGovernanceObject* pGovObj = GetGovernanceObject();
 
@@ -539,8 +563,12 @@ void CSuperblock::ParsePaymentSchedule(const std::string& strPaymentAddresses, c
         CGovernancePayment payment(address, nAmount);
         if (payment.IsValid()) {
             vecPayments.push_back(payment);
+            voutPayments.emplace_back(payment.nAmount, payment.script);
+            nPaymentsTotalAmount += payment.nAmount;
         } else {
             vecPayments.clear();
+            voutPayments.clear();
+            nPaymentsTotalAmount = 0;
             std::ostringstream ostr;
             ostr << "CSuperblock::ParsePaymentSchedule -- Invalid payment found: address = " << address.ToString()
                  << ", amount = " << nAmount;
@@ -560,18 +588,6 @@ bool CSuperblock::GetPayment(int nPaymentIndex, CGovernancePayment& paymentRet)
     return true;
 }
 
-CAmount CSuperblock::GetPaymentsTotalAmount()
-{
-    CAmount nPaymentsTotalAmount = 0;
-    int nPayments = CountPayments();
-
-    for (int i = 0; i < nPayments; i++) {
-        nPaymentsTotalAmount += vecPayments[i].nAmount;
-    }
-
-    return nPaymentsTotalAmount;
-}
-
 /**
 *   Is Transaction Valid
 *
@@ -39,13 +39,17 @@ private:
 
     trigger_m_t mapTrigger;
 
+    // changed whenever triggers are added or removed
+    int64_t nRevision;
+
     std::vector<CSuperblock_sptr> GetActiveTriggers();
     bool AddNewTrigger(uint256 nHash);
     void CleanAndRemove();
 
 public:
     CGovernanceTriggerManager() :
-        mapTrigger() {}
+        mapTrigger(),
+        nRevision(0) {}
 };
 
 /**
@@ -57,6 +61,26 @@ public:
 class CSuperblockManager
 {
 private:
+    /**
+     * The triggers of one superblock height and what was concluded from their votes. Valid as long as the set of
+     * triggers, the vote revisions of their objects and the masternode list it was computed for don't change.
+     */
+    struct CSuperblockCacheEntry {
+        int64_t nTriggersRevision{-1};
+        uint256 mnListBlockHash;
+        std::vector<std::pair<uint256, int64_t>> vecTriggerRevisions;
+        // trigger with the most funding votes, null if none has any
+        CSuperblock_sptr pBestSuperblock;
+        // any of the triggers has reached the funding threshold
+        bool fTriggered{false};
+    };
+
+    static const size_t MAX_CACHED_HEIGHTS = 8;
+
+    // protected by governance.cs
+    static std::map<int, CSuperblockCacheEntry> mapCache;
+
+    static const CSuperblockCacheEntry& GetCacheEntry(int nBlockHeight);
     static bool GetBestSuperblock(CSuperblock_sptr& pSuperblockRet, int nBlockHeight);
 
 public:
@@ -138,6 +162,9 @@ private:
     int nBlockHeight;
     int nStatus;
     std::vector<CGovernancePayment> vecPayments;
+    // parsed along with vecPayments
+    std::vector<CTxOut> voutPayments;
+    CAmount nPaymentsTotalAmount;
 
     void ParsePaymentSchedule(const std::string& strPaymentAddresses, const std::string& strPaymentAmounts);
 
@@ -171,7 +198,8 @@ public:
 
     int CountPayments() { return (int)vecPayments.size(); }
     bool GetPayment(int nPaymentIndex, CGovernancePayment& paymentRet);
-    CAmount GetPaymentsTotalAmount();
+    CAmount GetPaymentsTotalAmount() { return nPaymentsTotalAmount; }
+    const std::vector<CTxOut>& GetPaymentOutputs() { return voutPayments; }
 
     bool IsValid(const CTransaction& txNew, int nBlockHeight, CAmount blockReward);
     bool IsExpired();
@@ -17,6 +17,7 @@
 #include "util.h"
 #include "validation.h"
 
+#include <atomic>
 #include <string>
 #include <univalue.h>
 
@@ -42,7 +43,10 @@ CGovernanceObject::CGovernanceObject() :
     fUnparsable(false),
     mapCurrentMNVotes(),
     cmmapOrphanVotes(),
-    fileVotes()
+    fileVotes(),
+    nCollateralBlockHash(),
+    hashVerifiedKey(),
+    nVoteRevision(NewVoteRevision())
 {
     // PARSE JSON DATA STORAGE (VCHDATA)
     LoadData();
@@ -70,7 +74,10 @@ CGovernanceObject::CGovernanceObject(const uint256& nHashParentIn, int nRevision
     fUnparsable(false),
     mapCurrentMNVotes(),
     cmmapOrphanVotes(),
-    fileVotes()
+    fileVotes(),
+    nCollateralBlockHash(),
+    hashVerifiedKey(),
+    nVoteRevision(NewVoteRevision())
 {
     // PARSE JSON DATA STORAGE (VCHDATA)
     LoadData();
@@ -98,14 +105,24 @@ CGovernanceObject::CGovernanceObject(const CGovernanceObject& other) :
     fUnparsable(other.fUnparsable),
     mapCurrentMNVotes(other.mapCurrentMNVotes),
     cmmapOrphanVotes(other.cmmapOrphanVotes),
-    fileVotes(other.fileVotes)
+    fileVotes(other.fileVotes),
+    nCollateralBlockHash(other.nCollateralBlockHash),
+    hashVerifiedKey(other.hashVerifiedKey),
+    nVoteRevision(other.nVoteRevision)
 {
 }
 
+int64_t CGovernanceObject::NewVoteRevision()
+{
+    static std::atomic<int64_t> nLastRevision{0};
+    return ++nLastRevision;
+}
+
 bool CGovernanceObject::ProcessVote(CNode* pfrom,
     const CGovernanceVote& vote,
     CGovernanceException& exception,
-    CConnman& connman)
+    CConnman& connman,
+    const bool* pfVoteValid)
 {
     LOCK(cs);
 
@@ -198,7 +215,8 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
     bool onlyVotingKeyAllowed = nObjectType == GOVERNANCE_OBJECT_PROPOSAL && vote.GetSignal() == VOTE_SIGNAL_FUNDING;
 
     // Finally check that the vote is actually valid (done last because of cost of signature verification)
-    if (!vote.IsValid(onlyVotingKeyAllowed)) {
+    bool fVoteValid = pfVoteValid ? *pfVoteValid : vote.IsValid(onlyVotingKeyAllowed);
+    if (!fVoteValid) {
         std::ostringstream ostr;
         ostr << "CGovernanceObject::ProcessVote -- Invalid vote"
              << ", MN outpoint = " << vote.GetMasternodeOutpoint().ToStringShort()
@@ -223,6 +241,7 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
     voteInstanceRef = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
     fileVotes.AddVote(vote);
     fDirtyCache = true;
+    nVoteRevision = NewVoteRevision();
     return true;
 }
 
@@ -237,6 +256,7 @@ void CGovernanceObject::ClearMasternodeVotes()
         if (!mnList.HasMNByCollateral(it->first)) {
             fileVotes.RemoveVotesFromMasternode(it->first);
             mapCurrentMNVotes.erase(it++);
+            nVoteRevision = NewVoteRevision();
         } else {
             ++it;
         }
@@ -271,6 +291,7 @@ std::set<uint256> CGovernanceObject::RemoveInvalidVotes(const COutPoint& mnOutpo
     if (it->second.mapInstances.empty()) {
         mapCurrentMNVotes.erase(it);
     }
+    nVoteRevision = NewVoteRevision();
 
     if (!removedVotes.empty()) {
         std::string removedStr;
@@ -441,10 +462,25 @@ std::string CGovernanceObject::GetDataAsPlainString() const
     return std::string(vchData.begin(), vchData.end());
 }
 
+void CGovernanceObject::GetMemoryUsage(size_t& nObjectBytesRet, size_t& nVoteBytesRet, size_t& nVotesRet) const
+{
+    LOCK(cs);
+    nObjectBytesRet = memusage::DynamicUsage(vchData) + memusage::DynamicUsage(vchSig);
+
+    nVoteBytesRet = memusage::DynamicUsage(mapCurrentMNVotes) + cmmapOrphanVotes.DynamicMemoryUsage() + fileVotes.DynamicMemoryUsage();
+    for (const auto& p : mapCurrentMNVotes) {
+        nVoteBytesRet += memusage::DynamicUsage(p.second.mapInstances);
+    }
+    for (const auto& item : cmmapOrphanVotes.GetItemList()) {
+        nVoteBytesRet += item.value.first.DynamicMemoryUsage();
+    }
+    nVotesRet = fileVotes.GetVotes().size() + cmmapOrphanVotes.GetSize();
+}
+
 void CGovernanceObject::UpdateLocalValidity()
 {
-    LOCK(cs_main);
     // THIS DOES NOT CHECK COLLATERAL, THIS IS CHECKED UPON ORIGINAL ARRIVAL
+    // so it doesn't need cs_main and is run for many objects in parallel
     fCachedLocalValidity = IsValidLocally(strLocalValidityError, false);
 };
 
@@ -498,10 +534,14 @@ bool CGovernanceObject::IsValidLocally(std::string& strError, bool& fMissingMast
             return false;
         }
 
-        // Check that we have a valid MN signature
-        if (!CheckSignature(dmn->pdmnState->pubKeyOperator.Get())) {
-            strError = "Invalid masternode signature for: " + strOutpoint + ", pubkey = " + dmn->pdmnState->pubKeyOperator.Get().ToString();
-            return false;
+        // Check that we have a valid MN signature, again only if the operator key changed
+        uint256 hashKey = ::SerializeHash(dmn->pdmnState->pubKeyOperator);
+        if (hashKey != hashVerifiedKey) {
+            if (!CheckSignature(dmn->pdmnState->pubKeyOperator.Get())) {
+                strError = "Invalid masternode signature for: " + strOutpoint + ", pubkey = " + dmn->pdmnState->pubKeyOperator.Get().ToString();
+                return false;
+            }
+            hashVerifiedKey = hashKey;
         }
 
         return true;
@@ -526,25 +566,22 @@ CAmount CGovernanceObject::GetMinCollateralFee() const
     }
 }
 
-bool CGovernanceObject::IsCollateralValid(std::string& strError, bool& fMissingConfirmations) const
+bool CGovernanceObject::CheckCollateralTx(std::string& strError, uint256& nBlockHashRet) const
 {
-    strError = "";
-    fMissingConfirmations = false;
     CAmount nMinFee = GetMinCollateralFee();
     uint256 nExpectedHash = GetHash();
 
     CTransactionRef txCollateral;
-    uint256 nBlockHash;
 
     // RETRIEVE TRANSACTION IN QUESTION
 
-    if (!GetTransaction(nCollateralHash, txCollateral, Params().GetConsensus(), nBlockHash, true)) {
+    if (!GetTransaction(nCollateralHash, txCollateral, Params().GetConsensus(), nBlockHashRet, true)) {
         strError = strprintf("Can't find collateral tx %s", nCollateralHash.ToString());
         LogPrintf("CGovernanceObject::IsCollateralValid -- %s\n", strError);
         return false;
     }
 
-    if (nBlockHash == uint256()) {
+    if (nBlockHashRet == uint256()) {
         strError = strprintf("Collateral tx %s is not mined yet", txCollateral->ToString());
         LogPrintf("CGovernanceObject::IsCollateralValid -- %s\n", strError);
         return false;
@@ -584,9 +621,37 @@ bool CGovernanceObject::IsCollateralValid(std::string& strError, bool& fMissingC
         return false;
     }
 
-    // GET CONFIRMATIONS FOR TRANSACTION
+    return true;
+}
+
+bool CGovernanceObject::IsCollateralValid(std::string& strError, bool& fMissingConfirmations) const
+{
+    strError = "";
+    fMissingConfirmations = false;
 
     AssertLockHeld(cs_main);
+
+    // Postponed objects are checked again on every block until their collateral is deep enough,
+    // and the tx lookup may have to read it from the block files. Once the tx checked out only
+    // its confirmations are recomputed, for as long as its block stays in the active chain.
+    uint256 nBlockHash;
+    if (!nCollateralBlockHash.IsNull()) {
+        BlockMap::iterator mi = mapBlockIndex.find(nCollateralBlockHash);
+        if (mi != mapBlockIndex.end() && chainActive.Contains(mi->second)) {
+            nBlockHash = nCollateralBlockHash;
+        } else {
+            nCollateralBlockHash.SetNull();
+        }
+    }
+    if (nBlockHash.IsNull()) {
+        if (!CheckCollateralTx(strError, nBlockHash)) {
+            return false;
+        }
+        nCollateralBlockHash = nBlockHash;
+    }
+
+    // GET CONFIRMATIONS FOR TRANSACTION
+
     int nConfirmationsIn = 0;
     if (nBlockHash != uint256()) {
         BlockMap::iterator mi = mapBlockIndex.find(nBlockHash);
@@ -13,6 +13,7 @@
 #include "governance-votedb.h"
 #include "key.h"
 #include "net.h"
+#include "saltedhasher.h"
 #include "sync.h"
 #include "util.h"
 #include "utilstrencodings.h"
@@ -121,7 +122,7 @@ public: // Types
 
     typedef vote_m_t::const_iterator vote_m_cit;
 
-    typedef CacheMultiMap<COutPoint, vote_time_pair_t> vote_cmm_t;
+    typedef CacheMultiMap<COutPoint, vote_time_pair_t, StaticSaltedHasher> vote_cmm_t;
 
 private:
     /// critical section to protect the inner data structures
@@ -188,6 +189,15 @@ private:
 
     CGovernanceObjectVoteFile fileVotes;
 
+    /** Memory only. Block of the collateral tx, set once the tx itself passed IsCollateralValid */
+    mutable uint256 nCollateralBlockHash;
+
+    /** Memory only. Hash of the operator key the trigger signature was last verified with */
+    mutable uint256 hashVerifiedKey;
+
+    /** Memory only. Unique among all objects and changed whenever mapCurrentMNVotes is, see CSuperblockManager */
+    int64_t nVoteRevision;
+
 public:
     CGovernanceObject();
 
@@ -252,6 +262,12 @@ public:
         return fExpired;
     }
 
+    int64_t GetVoteRevision() const
+    {
+        LOCK(cs);
+        return nVoteRevision;
+    }
+
     const CGovernanceObjectVoteFile& GetVoteFile() const
     {
         return fileVotes;
@@ -304,6 +320,9 @@ public:
     std::string GetDataAsHexString() const;
     std::string GetDataAsPlainString() const;
 
+    /** Estimated heap usage of the object itself and of the votes it holds, see getmemoryinfo */
+    void GetMemoryUsage(size_t& nObjectBytesRet, size_t& nVoteBytesRet, size_t& nVotesRet) const;
+
     // SERIALIZER
 
     ADD_SERIALIZE_METHODS;
@@ -331,19 +350,31 @@ public:
             READWRITE(fileVotes);
             LogPrint("gobject", "CGovernanceObject::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
         }
+        if (ser_action.ForRead()) {
+            nCollateralBlockHash.SetNull();
+            hashVerifiedKey.SetNull();
+            nVoteRevision = NewVoteRevision();
+        }
 
         // AFTER DESERIALIZATION OCCURS, CACHED VARIABLES MUST BE CALCULATED MANUALLY
     }
 
 private:
+    static int64_t NewVoteRevision();
+
+    /// Looks up the collateral tx and checks its outputs, everything but its confirmations
+    bool CheckCollateralTx(std::string& strError, uint256& nBlockHashRet) const;
+
     // FUNCTIONS FOR DEALING WITH DATA STRING
     void LoadData();
     void GetData(UniValue& objResult);
 
+    /// pfVoteValid, when set, carries the result of vote.IsValid() already computed by the caller
     bool ProcessVote(CNode* pfrom,
         const CGovernanceVote& vote,
         CGovernanceException& exception,
-        CConnman& connman);
+        CConnman& connman,
+        const bool* pfVoteValid = nullptr);
 
     /// Called when MN's which have voted on this object have been removed
     void ClearMasternodeVotes();
@@ -6,6 +6,7 @@
 
 #include "governance-vote.h"
 #include "governance-object.h"
+#include "hash.h"
 #include "masternode-sync.h"
 #include "messagesigner.h"
 #include "spork.h"
@@ -165,6 +166,7 @@ uint256 CGovernanceVote::GetSignatureHash() const
 bool CGovernanceVote::Sign(const CKey& key, const CKeyID& keyID)
 {
     std::string strError;
+    hashVerifiedKey.SetNull();
 
     if (sporkManager.IsSporkActive(SPORK_6_NEW_SIGS)) {
         uint256 hash = GetSignatureHash();
@@ -233,6 +235,7 @@ bool CGovernanceVote::CheckSignature(const CKeyID& keyID) const
 
 bool CGovernanceVote::Sign(const CBLSSecretKey& key)
 {
+    hashVerifiedKey.SetNull();
     uint256 hash = GetSignatureHash();
     CBLSSignature sig = key.Sign(hash);
     if (!sig.IsValid()) {
@@ -279,11 +282,25 @@ bool CGovernanceVote::IsValid(bool useVotingKey) const
         return false;
     }
 
+    // Stored votes get revalidated on every sync and MN list change, but the signature
+    // only needs to be checked again when the masternode's key changed since the last check
+    // (the voting key signature format depends on SPORK_6_NEW_SIGS, so that's part of it too)
+    uint256 hashKey = useVotingKey ? ::SerializeHash(std::make_pair(dmn->pdmnState->keyIDVoting, sporkManager.IsSporkActive(SPORK_6_NEW_SIGS)))
+                                   : ::SerializeHash(dmn->pdmnState->pubKeyOperator);
+    if (hashKey == hashVerifiedKey) {
+        return true;
+    }
+
+    bool fSigValid;
     if (useVotingKey) {
-        return CheckSignature(dmn->pdmnState->keyIDVoting);
+        fSigValid = CheckSignature(dmn->pdmnState->keyIDVoting);
     } else {
-        return CheckSignature(dmn->pdmnState->pubKeyOperator.Get());
+        fSigValid = CheckSignature(dmn->pdmnState->pubKeyOperator.Get());
+    }
+    if (fSigValid) {
+        hashVerifiedKey = hashKey;
     }
+    return fSigValid;
 }
 
 bool operator==(const CGovernanceVote& vote1, const CGovernanceVote& vote2)
@@ -8,6 +8,7 @@
 #define GOVERNANCE_VOTE_H
 
 #include "key.h"
+#include "memusage.h"
 #include "primitives/transaction.h"
 #include "bls/bls.h"
 
@@ -73,6 +74,9 @@ private:
     const uint256 hash;
     void UpdateHash() const;
 
+    /** Memory only. Hash of the key the signature was last successfully verified with */
+    mutable uint256 hashVerifiedKey;
+
 public:
     CGovernanceVote();
     CGovernanceVote(const COutPoint& outpointMasternodeIn, const uint256& nParentHashIn, vote_signal_enum_t eVoteSignalIn, vote_outcome_enum_t eVoteOutcomeIn);
@@ -93,9 +97,14 @@ public:
     {
         nTime = nTimeIn;
         UpdateHash();
+        hashVerifiedKey.SetNull();
     }
 
-    void SetSignature(const std::vector<unsigned char>& vchSigIn) { vchSig = vchSigIn; }
+    void SetSignature(const std::vector<unsigned char>& vchSigIn)
+    {
+        vchSig = vchSigIn;
+        hashVerifiedKey.SetNull();
+    }
 
     bool Sign(const CKey& key, const CKeyID& keyID);
     bool CheckSignature(const CKeyID& keyID) const;
@@ -106,6 +115,8 @@ public:
 
     const COutPoint& GetMasternodeOutpoint() const { return masternodeOutpoint; }
 
+    size_t DynamicMemoryUsage() const { return memusage::DynamicUsage(vchSig); }
+
     /**
     *   GetHash()
     *
@@ -130,8 +141,10 @@ public:
         if (!(s.GetType() & SER_GETHASH)) {
             READWRITE(vchSig);
         }
-        if (ser_action.ForRead())
+        if (ser_action.ForRead()) {
             UpdateHash();
+            hashVerifiedKey.SetNull();
+        }
     }
 };
 
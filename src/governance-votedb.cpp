@@ -9,18 +9,31 @@
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile() :
     nMemoryVotes(0),
     listVotes(),
-    mapVoteIndex()
+    mapVoteIndex(),
+    mapMasternodeVotes()
 {
 }
 
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other) :
     nMemoryVotes(other.nMemoryVotes),
     listVotes(other.listVotes),
-    mapVoteIndex()
+    mapVoteIndex(),
+    mapMasternodeVotes()
 {
     RebuildIndex();
 }
 
+CGovernanceObjectVoteFile& CGovernanceObjectVoteFile::operator=(const CGovernanceObjectVoteFile& other)
+{
+    if (this != &other) {
+        // votes are not assignable, so copy and swap the list
+        vote_l_t listCopy(other.listVotes);
+        listVotes.swap(listCopy);
+        RebuildIndex();
+    }
+    return *this;
+}
+
 void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
 {
     uint256 nHash = vote.GetHash();
@@ -29,6 +42,7 @@ void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
         return;
     listVotes.push_front(vote);
     mapVoteIndex.emplace(nHash, listVotes.begin());
+    mapMasternodeVotes.emplace(vote.GetMasternodeOutpoint(), listVotes.begin());
     ++nMemoryVotes;
     RemoveOldVotes(vote);
 }
@@ -48,26 +62,12 @@ bool CGovernanceObjectVoteFile::SerializeVoteToStream(const uint256& nHash, CDat
     return true;
 }
 
-std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
-{
-    std::vector<CGovernanceVote> vecResult;
-    for (vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
-        vecResult.push_back(*it);
-    }
-    return vecResult;
-}
-
 void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const COutPoint& outpointMasternode)
 {
-    vote_l_it it = listVotes.begin();
-    while (it != listVotes.end()) {
-        if (it->GetMasternodeOutpoint() == outpointMasternode) {
-            --nMemoryVotes;
-            mapVoteIndex.erase(it->GetHash());
-            listVotes.erase(it++);
-        } else {
-            ++it;
-        }
+    auto range = mapMasternodeVotes.equal_range(outpointMasternode);
+    vote_mn_m_it it = range.first;
+    while (it != range.second) {
+        RemoveVote(it++);
     }
 }
 
@@ -75,17 +75,15 @@ std::set<uint256> CGovernanceObjectVoteFile::RemoveInvalidVotes(const COutPoint&
 {
     std::set<uint256> removedVotes;
 
-    vote_l_it it = listVotes.begin();
-    while (it != listVotes.end()) {
-        if (it->GetMasternodeOutpoint() == outpointMasternode) {
-            bool useVotingKey = fProposal && (it->GetSignal() == VOTE_SIGNAL_FUNDING);
-            if (!it->IsValid(useVotingKey)) {
-                removedVotes.emplace(it->GetHash());
-                --nMemoryVotes;
-                mapVoteIndex.erase(it->GetHash());
-                listVotes.erase(it++);
-                continue;
-            }
+    auto range = mapMasternodeVotes.equal_range(outpointMasternode);
+    vote_mn_m_it it = range.first;
+    while (it != range.second) {
+        const CGovernanceVote& vote = *it->second;
+        bool useVotingKey = fProposal && (vote.GetSignal() == VOTE_SIGNAL_FUNDING);
+        if (!vote.IsValid(useVotingKey)) {
+            removedVotes.emplace(vote.GetHash());
+            RemoveVote(it++);
+            continue;
         }
         ++it;
     }
@@ -95,25 +93,43 @@ std::set<uint256> CGovernanceObjectVoteFile::RemoveInvalidVotes(const COutPoint&
 
 void CGovernanceObjectVoteFile::RemoveOldVotes(const CGovernanceVote& vote)
 {
-    vote_l_it it = listVotes.begin();
-    while (it != listVotes.end()) {
-        if (it->GetMasternodeOutpoint() == vote.GetMasternodeOutpoint() // same masternode
-            && it->GetParentHash() == vote.GetParentHash() // same governance object (e.g. same proposal)
-            && it->GetSignal() == vote.GetSignal() // same signal (e.g. "funding", "delete", etc.)
-            && it->GetTimestamp() < vote.GetTimestamp()) // older than new vote
+    auto range = mapMasternodeVotes.equal_range(vote.GetMasternodeOutpoint());
+    vote_mn_m_it it = range.first;
+    while (it != range.second) {
+        const CGovernanceVote& oldVote = *it->second;
+        if (oldVote.GetParentHash() == vote.GetParentHash() // same governance object (e.g. same proposal)
+            && oldVote.GetSignal() == vote.GetSignal() // same signal (e.g. "funding", "delete", etc.)
+            && oldVote.GetTimestamp() < vote.GetTimestamp()) // older than new vote
         {
-            --nMemoryVotes;
-            mapVoteIndex.erase(it->GetHash());
-            listVotes.erase(it++);
+            RemoveVote(it++);
         } else {
             ++it;
         }
     }
 }
 
+void CGovernanceObjectVoteFile::RemoveVote(vote_mn_m_it itMasternodeVote)
+{
+    vote_l_it it = itMasternodeVote->second;
+    --nMemoryVotes;
+    mapVoteIndex.erase(it->GetHash());
+    mapMasternodeVotes.erase(itMasternodeVote);
+    listVotes.erase(it);
+}
+
+size_t CGovernanceObjectVoteFile::DynamicMemoryUsage() const
+{
+    size_t nUsage = memusage::DynamicUsage(listVotes) + memusage::DynamicUsage(mapVoteIndex) + memusage::DynamicUsage(mapMasternodeVotes);
+    for (const auto& vote : listVotes) {
+        nUsage += vote.DynamicMemoryUsage();
+    }
+    return nUsage;
+}
+
 void CGovernanceObjectVoteFile::RebuildIndex()
 {
     mapVoteIndex.clear();
+    mapMasternodeVotes.clear();
     nMemoryVotes = 0;
     vote_l_it it = listVotes.begin();
     while (it != listVotes.end()) {
@@ -121,6 +137,7 @@ void CGovernanceObjectVoteFile::RebuildIndex()
         uint256 nHash = vote.GetHash();
         if (mapVoteIndex.find(nHash) == mapVoteIndex.end()) {
             mapVoteIndex[nHash] = it;
+            mapMasternodeVotes.emplace(vote.GetMasternodeOutpoint(), it);
             ++nMemoryVotes;
             ++it;
         } else {
@@ -38,6 +38,10 @@ public: // Types
 
     typedef vote_m_t::const_iterator vote_m_cit;
 
+    typedef std::multimap<COutPoint, vote_l_it> vote_mn_m_t;
+
+    typedef vote_mn_m_t::iterator vote_mn_m_it;
+
 private:
     static const int MAX_MEMORY_VOTES = -1;
 
@@ -47,11 +51,16 @@ private:
 
     vote_m_t mapVoteIndex;
 
+    // Votes of each masternode, so that per masternode operations don't have to scan all votes
+    vote_mn_m_t mapMasternodeVotes;
+
 public:
     CGovernanceObjectVoteFile();
 
     CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other);
 
+    CGovernanceObjectVoteFile& operator=(const CGovernanceObjectVoteFile& other);
+
     /**
      * Add a vote to the file
      */
@@ -72,7 +81,15 @@ public:
         return nMemoryVotes;
     }
 
-    std::vector<CGovernanceVote> GetVotes() const;
+    /**
+     * Access all votes without copying them, only valid while the owning object is locked
+     */
+    const vote_l_t& GetVotes() const
+    {
+        return listVotes;
+    }
+
+    size_t DynamicMemoryUsage() const;
 
     void RemoveVotesFromMasternode(const COutPoint& outpointMasternode);
     std::set<uint256> RemoveInvalidVotes(const COutPoint& outpointMasternode, bool fProposal);
@@ -93,6 +110,8 @@ private:
     // Drop older votes for the same gobject from the same masternode
     void RemoveOldVotes(const CGovernanceVote& vote);
 
+    void RemoveVote(vote_mn_m_it itMasternodeVote);
+
     void RebuildIndex();
 };
 
@@ -22,6 +22,8 @@
 #include "validation.h"
 #include "validationinterface.h"
 
+#include "ctpl.h"
+
 CGovernanceManager governance;
 
 int nSubmittedFinalBudget;
@@ -30,6 +32,35 @@ const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanc
 const int CGovernanceManager::MAX_TIME_FUTURE_DEVIATION = 60 * 60;
 const int CGovernanceManager::RELIABLE_PROPAGATION_TIME = 60;
 
+//! Objects per task when revalidating them in UpdateCachesAndClean
+static const size_t GOVERNANCE_VALIDATION_BATCH_SIZE = 32;
+static const int MAX_GOVERNANCE_VALIDATION_THREADS = 8;
+
+static CCriticalSection cs_governanceWorkers;
+static std::unique_ptr<ctpl::thread_pool> governanceWorkers;
+
+static ctpl::thread_pool& GetGovernanceWorkers()
+{
+    LOCK(cs_governanceWorkers);
+    if (!governanceWorkers) {
+        int nThreads = std::max(std::min(GetNumCores(), MAX_GOVERNANCE_VALIDATION_THREADS), 1);
+        governanceWorkers.reset(new ctpl::thread_pool(nThreads));
+        RenameThreadPool(*governanceWorkers, "epmcoin-gov");
+        LogPrintf("%s: started %d governance validation threads\n", __func__, nThreads);
+    }
+    return *governanceWorkers;
+}
+
+void StopGovernanceWorkers()
+{
+    LOCK(cs_governanceWorkers);
+    if (governanceWorkers) {
+        governanceWorkers->clear_queue();
+        governanceWorkers->stop(true);
+        governanceWorkers.reset();
+    }
+}
+
 CGovernanceManager::CGovernanceManager() :
     nTimeLastDiff(0),
     nCachedBlockHeight(0),
@@ -120,7 +151,7 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strComm
         }
 
         if (nProp == uint256()) {
-            SyncObjects(pfrom, connman);
+            SyncObjects(pfrom, filter, connman);
         } else {
             SyncSingleObjVotes(pfrom, nProp, filter, connman);
         }
@@ -373,29 +404,60 @@ void CGovernanceManager::UpdateCachesAndClean()
     // Clean up any expired or invalid triggers
     triggerman.CleanAndRemove();
 
+    // The per object work below only reads the object itself and the MN list (no collateral), and
+    // after a restart every object is dirty. So it is done up front, spread over a few threads,
+    // and the loop after it only applies the results.
+    std::vector<CGovernanceObject*> vecObjects;
+    vecObjects.reserve(mapObjects.size());
+    for (auto& objPair : mapObjects) {
+        vecObjects.emplace_back(&objPair.second);
+    }
+    std::vector<char> vecProposalValid(vecObjects.size(), 1);
+    auto updateObjects = [&](size_t nBegin, size_t nEnd) {
+        for (size_t i = nBegin; i < nEnd; i++) {
+            CGovernanceObject* pObj = vecObjects[i];
+
+            // IF CACHE IS NOT DIRTY, WHY DO THIS?
+            if (pObj->IsSetDirtyCache()) {
+                // UPDATE LOCAL VALIDITY AGAINST CRYPTO DATA
+                pObj->UpdateLocalValidity();
+
+                // UPDATE SENTINEL SIGNALING VARIABLES
+                pObj->UpdateSentinelVariables();
+            }
+
+            // NOTE: triggers are handled via triggerman
+            if (pObj->GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL) {
+                CProposalValidator validator(pObj->GetDataAsHexString(), true);
+                vecProposalValid[i] = validator.Validate();
+            }
+        }
+    };
+    if (vecObjects.size() <= GOVERNANCE_VALIDATION_BATCH_SIZE) {
+        updateObjects(0, vecObjects.size());
+    } else {
+        std::vector<std::future<void>> futures;
+        auto& workers = GetGovernanceWorkers();
+        for (size_t nBegin = 0; nBegin < vecObjects.size(); nBegin += GOVERNANCE_VALIDATION_BATCH_SIZE) {
+            size_t nEnd = std::min(nBegin + GOVERNANCE_VALIDATION_BATCH_SIZE, vecObjects.size());
+            futures.emplace_back(workers.push([&, nBegin, nEnd](int threadId) { updateObjects(nBegin, nEnd); }));
+        }
+        for (auto& f : futures) {
+            f.get();
+        }
+    }
+
     object_m_it it = mapObjects.begin();
     int64_t nNow = GetAdjustedTime();
+    size_t nObjectIndex = 0;
 
     while (it != mapObjects.end()) {
         CGovernanceObject* pObj = &((*it).second);
-
-        if (!pObj) {
-            ++it;
-            continue;
-        }
+        bool fProposalValid = vecProposalValid[nObjectIndex++];
 
         uint256 nHash = it->first;
         std::string strHash = nHash.ToString();
 
-        // IF CACHE IS NOT DIRTY, WHY DO THIS?
-        if (pObj->IsSetDirtyCache()) {
-            // UPDATE LOCAL VALIDITY AGAINST CRYPTO DATA
-            pObj->UpdateLocalValidity();
-
-            // UPDATE SENTINEL SIGNALING VARIABLES
-            pObj->UpdateSentinelVariables();
-        }
-
         // IF DELETE=TRUE, THEN CLEAN THE MESS UP!
 
         int64_t nTimeSinceDeletion = nNow - pObj->GetDeletionTime();
@@ -433,8 +495,7 @@ void CGovernanceManager::UpdateCachesAndClean()
         } else {
             // NOTE: triggers are handled via triggerman
             if (pObj->GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL) {
-                CProposalValidator validator(pObj->GetDataAsHexString(), true);
-                if (!validator.Validate()) {
+                if (!fProposalValid) {
                     pObj->fCachedDelete = true;
                     if (pObj->nDeletionTime == 0) {
                         pObj->nDeletionTime = nNow;
@@ -638,7 +699,7 @@ void CGovernanceManager::SyncSingleObjVotes(CNode* pnode, const uint256& nProp,
         return;
     }
 
-    auto fileVotes = govobj.GetVoteFile();
+    const auto& fileVotes = govobj.GetVoteFile();
 
     for (const auto& vote : fileVotes.GetVotes()) {
         uint256 nVoteHash = vote.GetHash();
@@ -657,7 +718,7 @@ void CGovernanceManager::SyncSingleObjVotes(CNode* pnode, const uint256& nProp,
     LogPrintf("CGovernanceManager::%s -- sent %d votes to peer=%d\n", __func__, nVoteCount, pnode->id);
 }
 
-void CGovernanceManager::SyncObjects(CNode* pnode, CConnman& connman) const
+void CGovernanceManager::SyncObjects(CNode* pnode, const CBloomFilter& filter, CConnman& connman) const
 {
     // do not provide any data until our node is synced
     if (!masternodeSync.IsSynced()) return;
@@ -693,6 +754,11 @@ void CGovernanceManager::SyncObjects(CNode* pnode, CConnman& connman) const
             continue;
         }
 
+        if (filter.contains(nHash)) {
+            LogPrint("gobject", "CGovernanceManager::%s -- peer already has govobj: %s, peer=%d\n", __func__, strHash, pnode->id);
+            continue;
+        }
+
         // Push the inventory budget proposal message over to the other client
         LogPrint("gobject", "CGovernanceManager::%s -- syncing govobj: %s, peer=%d\n", __func__, strHash, pnode->id);
         pnode->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, nHash));
@@ -704,6 +770,31 @@ void CGovernanceManager::SyncObjects(CNode* pnode, CConnman& connman) const
     LogPrintf("CGovernanceManager::%s -- sent %d objects to peer=%d\n", __func__, nObjCount, pnode->id);
 }
 
+CBloomFilter CGovernanceManager::GetKnownObjectsFilter() const
+{
+    LOCK(cs);
+
+    CBloomFilter filter;
+    filter.clear();
+
+    unsigned int nMaxElements = Params().GetConsensus().nGovernanceFilterElements;
+    if (mapObjects.size() + mapErasedGovernanceObjects.size() > nMaxElements) {
+        LogPrint("gobject", "CGovernanceManager::%s -- too many known objects for a filter, requesting all of them\n", __func__);
+        return filter;
+    }
+
+    filter = CBloomFilter(nMaxElements, GOVERNANCE_FILTER_FP_RATE, GetRandInt(999999), BLOOM_UPDATE_ALL);
+    for (const auto& objPair : mapObjects) {
+        filter.insert(objPair.first);
+    }
+    // erased objects would be rejected by AlreadyHave anyway, no need to announce them again
+    for (const auto& erasedPair : mapErasedGovernanceObjects) {
+        filter.insert(erasedPair.first);
+    }
+
+    return filter;
+}
+
 void CGovernanceManager::MasternodeRateUpdate(const CGovernanceObject& govobj)
 {
     if (govobj.GetObjectType() != GOVERNANCE_OBJECT_TRIGGER) return;
@@ -837,17 +928,31 @@ bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote,
         return false;
     }
 
-    CGovernanceObject& govobj = it->second;
-
-    if (govobj.IsSetCachedDelete() || govobj.IsSetExpired()) {
+    if (it->second.IsSetCachedDelete() || it->second.IsSetExpired()) {
         LogPrint("gobject", "CGovernanceObject::ProcessVote -- ignoring vote for expired or deleted object, hash = %s\n", nHashGovobj.ToString());
         LEAVE_CRITICAL_SECTION(cs);
         return false;
     }
 
-    bool fOk = govobj.ProcessVote(pfrom, vote, exception, connman) && cmapVoteToObject.Insert(nHashVote, &govobj);
+    bool onlyVotingKeyAllowed = it->second.GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL && vote.GetSignal() == VOTE_SIGNAL_FUNDING;
     LEAVE_CRITICAL_SECTION(cs);
-    return fOk;
+
+    // Signature verification is the expensive part of vote processing, do it without holding cs
+    // so that vote floods from many peers don't serialize all governance work behind it.
+    // The object itself still decides what to do with the result, in its usual order of checks.
+    bool fVoteValid = vote.IsValid(onlyVotingKeyAllowed);
+
+    LOCK(cs);
+
+    // The object might have been removed while we were verifying
+    it = mapObjects.find(nHashGovobj);
+    if (it == mapObjects.end() || it->second.IsSetCachedDelete() || it->second.IsSetExpired()) {
+        LogPrint("gobject", "CGovernanceObject::ProcessVote -- ignoring vote for expired or deleted object, hash = %s\n", nHashGovobj.ToString());
+        return false;
+    }
+
+    CGovernanceObject& govobj = it->second;
+    return govobj.ProcessVote(pfrom, vote, exception, connman, &fVoteValid) && cmapVoteToObject.Insert(nHashVote, &govobj);
 }
 
 void CGovernanceManager::CheckMasternodeOrphanVotes(CConnman& connman)
@@ -986,9 +1091,9 @@ void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nH
 
         if (pObj) {
             filter = CBloomFilter(Params().GetConsensus().nGovernanceFilterElements, GOVERNANCE_FILTER_FP_RATE, GetRandInt(999999), BLOOM_UPDATE_ALL);
-            std::vector<CGovernanceVote> vecVotes = pObj->GetVoteFile().GetVotes();
-            nVoteCount = vecVotes.size();
-            for (const auto& vote : vecVotes) {
+            const auto& listVotes = pObj->GetVoteFile().GetVotes();
+            nVoteCount = listVotes.size();
+            for (const auto& vote : listVotes) {
                 filter.insert(vote.GetHash());
             }
         }
@@ -1143,9 +1248,8 @@ void CGovernanceManager::RebuildIndexes()
     cmapVoteToObject.Clear();
     for (auto& objPair : mapObjects) {
         CGovernanceObject& govobj = objPair.second;
-        std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
-        for (size_t i = 0; i < vecVotes.size(); ++i) {
-            cmapVoteToObject.Insert(vecVotes[i].GetHash(), &govobj);
+        for (const auto& vote : govobj.GetVoteFile().GetVotes()) {
+            cmapVoteToObject.Insert(vote.GetHash(), &govobj);
         }
     }
 }
@@ -1209,6 +1313,46 @@ std::string CGovernanceManager::ToString() const
         (int)cmapVoteToObject.GetSize());
 }
 
+void CGovernanceManager::GetMemoryUsage(memusage::SubsystemUsage& objectsRet, memusage::SubsystemUsage& votesRet) const
+{
+    LOCK(cs);
+
+    objectsRet = memusage::SubsystemUsage();
+    votesRet = memusage::SubsystemUsage();
+    auto addObject = [&](const CGovernanceObject& govobj) {
+        size_t nObjectBytes, nVoteBytes, nVotes;
+        govobj.GetMemoryUsage(nObjectBytes, nVoteBytes, nVotes);
+        objectsRet.nBytes += nObjectBytes;
+        objectsRet.nEntries++;
+        votesRet.nBytes += nVoteBytes;
+        votesRet.nEntries += nVotes;
+    };
+    for (const auto& p : mapObjects) {
+        addObject(p.second);
+    }
+    for (const auto& p : mapPostponedObjects) {
+        addObject(p.second);
+    }
+    for (const auto& p : mapMasternodeOrphanObjects) {
+        addObject(p.second.first);
+    }
+    objectsRet.nBytes += memusage::DynamicUsage(mapObjects) + memusage::DynamicUsage(mapPostponedObjects) +
+                         memusage::DynamicUsage(mapMasternodeOrphanObjects) + memusage::DynamicUsage(mapMasternodeOrphanCounter) +
+                         memusage::DynamicUsage(mapErasedGovernanceObjects) + memusage::DynamicUsage(setAdditionalRelayObjects) +
+                         memusage::DynamicUsage(mapLastMasternodeObject) + memusage::DynamicUsage(setRequestedObjects);
+
+    // the votes which aren't stored with an object
+    votesRet.nBytes += cmapVoteToObject.DynamicMemoryUsage() + cmapInvalidVotes.DynamicMemoryUsage() +
+                       cmmapOrphanVotes.DynamicMemoryUsage() + memusage::DynamicUsage(setRequestedVotes);
+    for (const auto& item : cmapInvalidVotes.GetItemList()) {
+        votesRet.nBytes += item.value.DynamicMemoryUsage();
+    }
+    for (const auto& item : cmmapOrphanVotes.GetItemList()) {
+        votesRet.nBytes += item.value.first.DynamicMemoryUsage();
+    }
+    votesRet.nEntries += cmapInvalidVotes.GetSize() + cmmapOrphanVotes.GetSize();
+}
+
 UniValue CGovernanceManager::ToJson() const
 {
     LOCK(cs);
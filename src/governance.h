@@ -15,6 +15,7 @@
 #include "governance-object.h"
 #include "governance-vote.h"
 #include "net.h"
+#include "ratelimit.h"
 #include "sync.h"
 #include "timedata.h"
 #include "util.h"
@@ -30,6 +31,8 @@ class CGovernanceVote;
 
 extern CGovernanceManager governance;
 
+void StopGovernanceWorkers();
+
 struct ExpirationInfo {
     ExpirationInfo(int64_t _nExpirationTime, int _idFrom) :
         nExpirationTime(_nExpirationTime), idFrom(_idFrom) {}
@@ -42,110 +45,8 @@ typedef std::pair<CGovernanceObject, ExpirationInfo> object_info_pair_t;
 
 static const int RATE_BUFFER_SIZE = 5;
 
-class CRateCheckBuffer
-{
-private:
-    std::vector<int64_t> vecTimestamps;
-
-    int nDataStart;
-
-    int nDataEnd;
-
-    bool fBufferEmpty;
-
-public:
-    CRateCheckBuffer() :
-        vecTimestamps(RATE_BUFFER_SIZE),
-        nDataStart(0),
-        nDataEnd(0),
-        fBufferEmpty(true)
-    {
-    }
-
-    void AddTimestamp(int64_t nTimestamp)
-    {
-        if ((nDataEnd == nDataStart) && !fBufferEmpty) {
-            // Buffer full, discard 1st element
-            nDataStart = (nDataStart + 1) % RATE_BUFFER_SIZE;
-        }
-        vecTimestamps[nDataEnd] = nTimestamp;
-        nDataEnd = (nDataEnd + 1) % RATE_BUFFER_SIZE;
-        fBufferEmpty = false;
-    }
-
-    int64_t GetMinTimestamp()
-    {
-        int nIndex = nDataStart;
-        int64_t nMin = std::numeric_limits<int64_t>::max();
-        if (fBufferEmpty) {
-            return nMin;
-        }
-        do {
-            if (vecTimestamps[nIndex] < nMin) {
-                nMin = vecTimestamps[nIndex];
-            }
-            nIndex = (nIndex + 1) % RATE_BUFFER_SIZE;
-        } while (nIndex != nDataEnd);
-        return nMin;
-    }
-
-    int64_t GetMaxTimestamp()
-    {
-        int nIndex = nDataStart;
-        int64_t nMax = 0;
-        if (fBufferEmpty) {
-            return nMax;
-        }
-        do {
-            if (vecTimestamps[nIndex] > nMax) {
-                nMax = vecTimestamps[nIndex];
-            }
-            nIndex = (nIndex + 1) % RATE_BUFFER_SIZE;
-        } while (nIndex != nDataEnd);
-        return nMax;
-    }
-
-    int GetCount()
-    {
-        int nCount = 0;
-        if (fBufferEmpty) {
-            return 0;
-        }
-        if (nDataEnd > nDataStart) {
-            nCount = nDataEnd - nDataStart;
-        } else {
-            nCount = RATE_BUFFER_SIZE - nDataStart + nDataEnd;
-        }
-
-        return nCount;
-    }
-
-    double GetRate()
-    {
-        int nCount = GetCount();
-        if (nCount < RATE_BUFFER_SIZE) {
-            return 0.0;
-        }
-        int64_t nMin = GetMinTimestamp();
-        int64_t nMax = GetMaxTimestamp();
-        if (nMin == nMax) {
-            // multiple objects with the same timestamp => infinite rate
-            return 1.0e10;
-        }
-        return double(nCount) / double(nMax - nMin);
-    }
-
-    ADD_SERIALIZE_METHODS;
-
-    template <typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action)
-    {
-        READWRITE(vecTimestamps);
-        READWRITE(nDataStart);
-        READWRITE(nDataEnd);
-        READWRITE(fBufferEmpty);
-    }
-};
+/** Timestamps of the last RATE_BUFFER_SIZE triggers of a masternode */
+typedef CTimestampWindow<RATE_BUFFER_SIZE> CRateCheckBuffer;
 
 //
 // Governance Manager : Contains all proposals for the budget
@@ -182,7 +83,7 @@ public: // Types
 
     typedef object_m_t::const_iterator object_m_cit;
 
-    typedef CacheMap<uint256, CGovernanceObject*> object_ref_cm_t;
+    typedef CacheMap<uint256, CGovernanceObject*, StaticSaltedHasher> object_ref_cm_t;
 
     typedef std::map<uint256, CGovernanceVote> vote_m_t;
 
@@ -190,13 +91,13 @@ public: // Types
 
     typedef vote_m_t::const_iterator vote_m_cit;
 
-    typedef CacheMap<uint256, CGovernanceVote> vote_cm_t;
+    typedef CacheMap<uint256, CGovernanceVote, StaticSaltedHasher> vote_cm_t;
 
-    typedef CacheMultiMap<uint256, vote_time_pair_t> vote_cmm_t;
+    typedef CacheMultiMap<uint256, vote_time_pair_t, StaticSaltedHasher> vote_cmm_t;
 
     typedef object_m_t::size_type size_type;
 
-    typedef std::map<COutPoint, last_object_rec> txout_m_t;
+    typedef std::unordered_map<COutPoint, last_object_rec, StaticSaltedHasher> txout_m_t;
 
     typedef txout_m_t::iterator txout_m_it;
 
@@ -302,7 +203,14 @@ public:
     bool ConfirmInventoryRequest(const CInv& inv);
 
     void SyncSingleObjVotes(CNode* pnode, const uint256& nProp, const CBloomFilter& filter, CConnman& connman);
-    void SyncObjects(CNode* pnode, CConnman& connman) const;
+    void SyncObjects(CNode* pnode, const CBloomFilter& filter, CConnman& connman) const;
+
+    /**
+     * Build the filter sent with a full MNGOVERNANCESYNC request, so that the peer only
+     * announces objects we don't know about yet. Returns an empty filter if we know too
+     * many objects to keep the false positive rate of the filter low.
+     */
+    CBloomFilter GetKnownObjectsFilter() const;
 
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
 
@@ -336,6 +244,8 @@ public:
     std::string ToString() const;
     UniValue ToJson() const;
 
+    void GetMemoryUsage(memusage::SubsystemUsage& objectsRet, memusage::SubsystemUsage& votesRet) const;
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
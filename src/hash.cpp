@@ -7,6 +7,16 @@
 #include "crypto/hmac_sha512.h"
 #include "pubkey.h"
 
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__amd64__)
+#include <cpuid.h>
+namespace echo_aesni
+{
+void Compress(sph_echo_big_context* sc);
+}
+#endif
+
 
 inline uint32_t ROTL32(uint32_t x, int8_t r)
 {
@@ -14,19 +24,24 @@ inline uint32_t ROTL32(uint32_t x, int8_t r)
 }
 
 unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash)
+{
+    return MurmurHash3(nHashSeed, vDataToHash.data(), vDataToHash.size());
+}
+
+unsigned int MurmurHash3(unsigned int nHashSeed, const unsigned char* data, size_t len)
 {
     // The following is MurmurHash3 (x86_32), see http://code.google.com/p/smhasher/source/browse/trunk/MurmurHash3.cpp
     uint32_t h1 = nHashSeed;
-    if (vDataToHash.size() > 0)
+    if (len > 0)
     {
         const uint32_t c1 = 0xcc9e2d51;
         const uint32_t c2 = 0x1b873593;
 
-        const int nblocks = vDataToHash.size() / 4;
+        const int nblocks = len / 4;
 
         //----------
         // body
-        const uint8_t* blocks = &vDataToHash[0] + nblocks * 4;
+        const uint8_t* blocks = data + nblocks * 4;
 
         for (int i = -nblocks; i; i++) {
             uint32_t k1 = ReadLE32(blocks + i*4);
@@ -42,11 +57,11 @@ unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char
 
         //----------
         // tail
-        const uint8_t* tail = (const uint8_t*)(&vDataToHash[0] + nblocks * 4);
+        const uint8_t* tail = (const uint8_t*)(data + nblocks * 4);
 
         uint32_t k1 = 0;
 
-        switch (vDataToHash.size() & 3) {
+        switch (len & 3) {
         case 3:
             k1 ^= tail[2] << 16;
         case 2:
@@ -62,7 +77,7 @@ unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char
 
     //----------
     // finalization
-    h1 ^= vDataToHash.size();
+    h1 ^= len;
     h1 ^= h1 >> 16;
     h1 *= 0x85ebca6b;
     h1 ^= h1 >> 13;
@@ -72,6 +87,54 @@ unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char
     return h1;
 }
 
+void MurmurHash3x4(const uint32_t seeds[4], const unsigned char* data, size_t len, uint32_t out[4])
+{
+    const uint32_t c1 = 0xcc9e2d51;
+    const uint32_t c2 = 0x1b873593;
+
+    uint32_t h[4] = {seeds[0], seeds[1], seeds[2], seeds[3]};
+
+    // The message words are the same for every seed, only the state differs per lane
+    const size_t nblocks = len / 4;
+    for (size_t i = 0; i < nblocks; i++) {
+        uint32_t k1 = ReadLE32(data + i*4);
+        k1 *= c1;
+        k1 = ROTL32(k1, 15);
+        k1 *= c2;
+        for (int j = 0; j < 4; j++) {
+            h[j] ^= k1;
+            h[j] = ROTL32(h[j], 13);
+            h[j] = h[j] * 5 + 0xe6546b64;
+        }
+    }
+
+    const uint8_t* tail = data + nblocks * 4;
+    uint32_t k1 = 0;
+    switch (len & 3) {
+    case 3:
+        k1 ^= tail[2] << 16;
+    case 2:
+        k1 ^= tail[1] << 8;
+    case 1:
+        k1 ^= tail[0];
+        k1 *= c1;
+        k1 = ROTL32(k1, 15);
+        k1 *= c2;
+        for (int j = 0; j < 4; j++)
+            h[j] ^= k1;
+    }
+
+    for (int j = 0; j < 4; j++) {
+        uint32_t h1 = h[j] ^ (uint32_t)len;
+        h1 ^= h1 >> 16;
+        h1 *= 0x85ebca6b;
+        h1 ^= h1 >> 13;
+        h1 *= 0xc2b2ae35;
+        h1 ^= h1 >> 16;
+        out[j] = h1;
+    }
+}
+
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64])
 {
     unsigned char num[4];
@@ -249,3 +312,60 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint3
     SIPROUND;
     return v0 ^ v1 ^ v2 ^ v3;
 }
+
+//! Number of inputs HashX11Batch runs through a stage at once, limited by the intermediates staying in L1
+static const size_t X11_BATCH_SIZE = 8;
+
+#define X11_BATCH_STAGE(algo, in, out) do { \
+        for (size_t i = 0; i < nBatch; i++) { \
+            sph_##algo##512_context ctx; \
+            sph_##algo##512_init(&ctx); \
+            sph_##algo##512(&ctx, static_cast<const void*>(&in[i]), 64); \
+            sph_##algo##512_close(&ctx, static_cast<void*>(&out[i])); \
+        } \
+    } while (0)
+
+void HashX11Batch(const unsigned char* pdata, size_t nSize, size_t nCount, uint256* pout)
+{
+    static unsigned char pblank[1];
+    uint512 a[X11_BATCH_SIZE], b[X11_BATCH_SIZE];
+
+    for (size_t nFirst = 0; nFirst < nCount; nFirst += X11_BATCH_SIZE) {
+        size_t nBatch = std::min(X11_BATCH_SIZE, nCount - nFirst);
+
+        for (size_t i = 0; i < nBatch; i++) {
+            sph_blake512_context ctx;
+            sph_blake512_init(&ctx);
+            sph_blake512(&ctx, nSize == 0 ? pblank : pdata + (nFirst + i) * nSize, nSize);
+            sph_blake512_close(&ctx, static_cast<void*>(&a[i]));
+        }
+        X11_BATCH_STAGE(bmw, a, b);
+        X11_BATCH_STAGE(groestl, b, a);
+        X11_BATCH_STAGE(skein, a, b);
+        X11_BATCH_STAGE(jh, b, a);
+        X11_BATCH_STAGE(keccak, a, b);
+        X11_BATCH_STAGE(luffa, b, a);
+        X11_BATCH_STAGE(cubehash, a, b);
+        X11_BATCH_STAGE(shavite, b, a);
+        X11_BATCH_STAGE(simd, a, b);
+        X11_BATCH_STAGE(echo, b, a);
+
+        for (size_t i = 0; i < nBatch; i++)
+            pout[nFirst + i] = a[i].trim256();
+    }
+}
+
+#undef X11_BATCH_STAGE
+
+std::string X11AutoDetect()
+{
+#if defined(__x86_64__) || defined(__amd64__)
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx >> 25) & 1) {
+        sph_echo_big_compress = echo_aesni::Compress;
+        return "aesni";
+    }
+#endif
+
+    return "standard";
+}
@@ -28,6 +28,7 @@
 #include "crypto/sph_simd.h"
 #include "crypto/sph_echo.h"
 
+#include <string>
 #include <vector>
 
 typedef uint256 ChainCode;
@@ -275,6 +276,13 @@ uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL
 }
 
 unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash);
+unsigned int MurmurHash3(unsigned int nHashSeed, const unsigned char* data, size_t len);
+
+/**
+ * MurmurHash3 of the same data under 4 seeds, e.g. for consecutive bloom filter hash functions. The
+ * seeds are processed in lanes which the compiler turns into vector instructions.
+ */
+void MurmurHash3x4(const uint32_t seeds[4], const unsigned char* data, size_t len, uint32_t out[4]);
 
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64]);
 
@@ -313,6 +321,11 @@ public:
 uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
 uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint32_t extra);
 
+/** Select the fastest bit-exact implementations of the X11 stages for this CPU.
+ * Returns a description of the selection, like SHA256AutoDetect().
+ */
+std::string X11AutoDetect();
+
 /* ----------- EPMCoin Hash ------------------------------------------------ */
 template<typename T1>
 inline uint256 HashX11(const T1 pbegin, const T1 pend)
@@ -380,4 +393,10 @@ inline uint256 HashX11(const T1 pbegin, const T1 pend)
     return hash[10].trim256();
 }
 
+/** Compute HashX11 of nCount inputs of nSize bytes each, stored back to back at pdata.
+ * Runs every stage over a group of inputs before moving on to the next one, so each
+ * stage's tables stay in cache instead of being evicted by the other ten per input.
+ */
+void HashX11Batch(const unsigned char* pdata, size_t nSize, size_t nCount, uint256* pout);
+
 #endif // BITCOIN_HASH_H
@@ -112,6 +112,9 @@ public:
     uint256 GetID() const { return id; }
 
     uint256 GetSeedHash();
+    //! The key at m/purpose'/coin_type'/account'/change, all keys of that chain derive from it without the seed
+    void DeriveAccountExtKey(uint32_t nAccountIndex, CExtKey& extKeyRet);
+    void DeriveChangeExtKey(uint32_t nAccountIndex, bool fInternal, CExtKey& extKeyRet);
     void DeriveChildExtKey(uint32_t nAccountIndex, bool fInternal, uint32_t nChildIndex, CExtKey& extKeyRet);
 
     void AddAccount();
@@ -7,6 +7,7 @@
 #include "base58.h"
 #include "chainparams.h"
 #include "httpserver.h"
+#include "rpc/jsonwriter.h"
 #include "rpc/protocol.h"
 #include "rpc/server.h"
 #include "random.h"
@@ -147,6 +148,74 @@ static bool RPCAuthorized(const std::string& strAuth, std::string& strAuthUserna
     return multiUserAuthorized(strUserPass);
 }
 
+/** How much of the body JSONRPCSelectLane looks at for the method name */
+static const size_t MAX_LANE_PEEK_SIZE = 1024;
+
+/** Batches and slow methods go to the slow lane. Only the start of the body is scanned for
+ * "method", without parsing, as this runs on the event loop thread. */
+static HTTPWorkLane JSONRPCSelectLane(HTTPRequest* req, const std::string &)
+{
+    std::string strBody = req->PeekBody(MAX_LANE_PEEK_SIZE);
+    size_t nPos = strBody.find_first_not_of(" \t\r\n");
+    if (nPos != std::string::npos && strBody[nPos] == '[')
+        return HTTP_LANE_SLOW;
+
+    nPos = strBody.find("\"method\"");
+    if (nPos == std::string::npos)
+        return HTTP_LANE_DEFAULT;
+    nPos = strBody.find_first_not_of(" \t\r\n", nPos + 8);
+    if (nPos == std::string::npos || strBody[nPos] != ':')
+        return HTTP_LANE_DEFAULT;
+    nPos = strBody.find_first_not_of(" \t\r\n", nPos + 1);
+    if (nPos == std::string::npos || strBody[nPos] != '"')
+        return HTTP_LANE_DEFAULT;
+    size_t nEnd = strBody.find('"', nPos + 1);
+    if (nEnd == std::string::npos)
+        return HTTP_LANE_DEFAULT;
+    return IsSlowRPCMethod(strBody.substr(nPos + 1, nEnd - nPos - 1)) ? HTTP_LANE_SLOW : HTTP_LANE_DEFAULT;
+}
+
+/**
+ * Write the reply of a single request as it is produced. Small replies are still sent in one
+ * piece, the chunked reply only starts once the writer fills its first chunk.
+ */
+static void JSONRPCExecStreaming(HTTPRequest* req, const JSONRPCRequest& jreq)
+{
+    bool fStarted = false;
+    CJSONWriter writer([req, &fStarted](const char* data, size_t size) {
+        if (!fStarted) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->StartChunkedReply(HTTP_OK);
+            fStarted = true;
+        }
+        req->WriteReplyChunk(data, size);
+    });
+
+    writer.BeginObject().Key("result");
+    try {
+        if (!tableRPC.executeStreaming(jreq, writer)) {
+            UniValue result = tableRPC.execute(jreq);
+            writer.Value(result);
+        }
+    } catch (...) {
+        if (!writer.HasFlushed())
+            throw;
+        // Too late for an error reply, the client is left with an incomplete body
+        LogPrintf("JSONRPCExecStreaming -- %s failed after the reply was started\n", jreq.strMethod);
+        req->EndChunkedReply();
+        return;
+    }
+    writer.Key("error").Null().Key("id").Value(jreq.id).EndObject().Raw("\n");
+
+    if (writer.HasFlushed()) {
+        writer.Flush();
+        req->EndChunkedReply();
+    } else {
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, writer.GetBuffer());
+    }
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -185,24 +254,20 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         // Set the URI
         jreq.URI = req->GetURI();
 
-        std::string strReply;
         // singleton request
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
-            UniValue result = tableRPC.execute(jreq);
-
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            JSONRPCExecStreaming(req, jreq);
 
         // array of requests
-        } else if (valRequest.isArray())
-            strReply = JSONRPCExecBatch(valRequest.get_array());
-        else
-            throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
+        } else if (valRequest.isArray()) {
+            std::string strReply = JSONRPCExecBatch(valRequest.get_array());
 
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strReply);
+            req->WriteHeader("Content-Type", "application/json");
+            req->WriteReply(HTTP_OK, strReply);
+        } else
+            throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
     } catch (const UniValue& objError) {
         JSONErrorReply(req, objError, jreq.id);
         return false;
@@ -237,7 +302,7 @@ bool StartHTTPRPC()
     if (!InitRPCAuthentication())
         return false;
 
-    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC, JSONRPCSelectLane);
 
     assert(EventBase());
     httpRPCTimerInterface = new HTTPRPCTimerInterface(EventBase());
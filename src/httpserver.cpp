@@ -38,16 +38,19 @@
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
 
+static void RecordQueueWait(HTTPWorkLane lane, int64_t nWaitMicros);
+
 /** HTTP request work item */
 class HTTPWorkItem : public HTTPClosure
 {
 public:
-    HTTPWorkItem(std::unique_ptr<HTTPRequest> _req, const std::string &_path, const HTTPRequestHandler& _func):
-        req(std::move(_req)), path(_path), func(_func)
+    HTTPWorkItem(std::unique_ptr<HTTPRequest> _req, const std::string &_path, const HTTPRequestHandler& _func, HTTPWorkLane _lane):
+        req(std::move(_req)), path(_path), func(_func), lane(_lane), nTimeQueued(GetTimeMicros())
     {
     }
     void operator()() override
     {
+        RecordQueueWait(lane, GetTimeMicros() - nTimeQueued);
         func(req.get(), path);
     }
 
@@ -56,6 +59,8 @@ public:
 private:
     std::string path;
     HTTPRequestHandler func;
+    HTTPWorkLane lane;
+    int64_t nTimeQueued;
 };
 
 /** Simple work queue for distributing work over multiple threads.
@@ -159,13 +164,14 @@ public:
 struct HTTPPathHandler
 {
     HTTPPathHandler() {}
-    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler):
-        prefix(_prefix), exactMatch(_exactMatch), handler(_handler)
+    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler, HTTPLaneSelector _selector):
+        prefix(_prefix), exactMatch(_exactMatch), handler(_handler), selector(_selector)
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    HTTPLaneSelector selector;
 };
 
 /** HTTP module state */
@@ -176,13 +182,23 @@ static struct event_base* eventBase = 0;
 struct evhttp* eventHTTP = 0;
 //! List of subnets to allow RPC connections from
 static std::vector<CSubNet> rpc_allow_subnets;
-//! Work queue for handling longer requests off the event loop thread
-static WorkQueue<HTTPClosure>* workQueue = 0;
+//! Work queues for handling longer requests off the event loop thread, one per lane
+static WorkQueue<HTTPClosure>* workQueues[HTTP_LANE_COUNT] = {};
+//! Counters of the work queues, guarded by cs_workQueueStats
+static std::mutex cs_workQueueStats;
+static HTTPWorkQueueStats workQueueStats[HTTP_LANE_COUNT] = {};
 //! Handlers for (sub)paths
 std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
 std::vector<evhttp_bound_socket *> boundSockets;
 
+static void RecordQueueWait(HTTPWorkLane lane, int64_t nWaitMicros)
+{
+    std::lock_guard<std::mutex> lock(cs_workQueueStats);
+    workQueueStats[lane].nTotalWaitMicros += nWaitMicros;
+    workQueueStats[lane].nMaxWaitMicros = std::max(workQueueStats[lane].nMaxWaitMicros, nWaitMicros);
+}
+
 /** Check if a network address is allowed to access the HTTP server */
 static bool ClientAllowed(const CNetAddr& netaddr)
 {
@@ -285,9 +301,18 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
 
     // Dispatch to worker thread
     if (i != iend) {
-        std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
-        assert(workQueue);
-        if (workQueue->Enqueue(item.get()))
+        HTTPWorkLane lane = i->selector ? i->selector(hreq.get(), path) : HTTP_LANE_DEFAULT;
+        std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler, lane));
+        assert(workQueues[lane]);
+        bool fQueued = workQueues[lane]->Enqueue(item.get());
+        {
+            std::lock_guard<std::mutex> lock(cs_workQueueStats);
+            if (fQueued)
+                workQueueStats[lane].nQueued++;
+            else
+                workQueueStats[lane].nRejected++;
+        }
+        if (fQueued)
             item.release(); /* if true, queue took ownership */
         else {
             LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
@@ -435,9 +460,12 @@ bool InitHTTPServer()
 
     LogPrint("http", "Initialized HTTP server\n");
     int workQueueDepth = std::max((long)GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
-    LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
+    LogPrintf("HTTP: creating work queues of depth %d\n", workQueueDepth);
 
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    for (int lane = 0; lane < HTTP_LANE_COUNT; lane++) {
+        workQueues[lane] = new WorkQueue<HTTPClosure>(workQueueDepth);
+        workQueueStats[lane].nMaxDepth = workQueueDepth;
+    }
     eventBase = base;
     eventHTTP = http;
     return true;
@@ -450,14 +478,22 @@ bool StartHTTPServer()
 {
     LogPrint("http", "Starting HTTP server\n");
     int rpcThreads = std::max((long)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
-    LogPrintf("HTTP: starting %d worker threads\n", rpcThreads);
+    int rpcSlowThreads = std::max((long)GetArg("-rpcslowthreads", DEFAULT_HTTP_SLOW_THREADS), 1L);
+    LogPrintf("HTTP: starting %d worker threads and %d for slow requests\n", rpcThreads, rpcSlowThreads);
     std::packaged_task<bool(event_base*, evhttp*)> task(ThreadHTTP);
     threadResult = task.get_future();
     threadHTTP = std::thread(std::move(task), eventBase, eventHTTP);
 
-    for (int i = 0; i < rpcThreads; i++) {
-        std::thread rpc_worker(HTTPWorkQueueRun, workQueue);
-        rpc_worker.detach();
+    const int nLaneThreads[HTTP_LANE_COUNT] = {rpcThreads, rpcSlowThreads};
+    for (int lane = 0; lane < HTTP_LANE_COUNT; lane++) {
+        {
+            std::lock_guard<std::mutex> lock(cs_workQueueStats);
+            workQueueStats[lane].nThreads = nLaneThreads[lane];
+        }
+        for (int i = 0; i < nLaneThreads[lane]; i++) {
+            std::thread rpc_worker(HTTPWorkQueueRun, workQueues[lane]);
+            rpc_worker.detach();
+        }
     }
     return true;
 }
@@ -473,14 +509,18 @@ void InterruptHTTPServer()
         // Reject requests on current connections
         evhttp_set_gencb(eventHTTP, http_reject_request_cb, NULL);
     }
-    if (workQueue)
-        workQueue->Interrupt();
+    for (WorkQueue<HTTPClosure>* workQueue : workQueues) {
+        if (workQueue)
+            workQueue->Interrupt();
+    }
 }
 
 void StopHTTPServer()
 {
     LogPrint("http", "Stopping HTTP server\n");
-    if (workQueue) {
+    for (WorkQueue<HTTPClosure>*& workQueue : workQueues) {
+        if (!workQueue)
+            continue;
         LogPrint("http", "Waiting for HTTP worker threads to exit\n");
 #ifndef WIN32
         // ToDo: Disabling WaitExit() for Windows platforms is an ugly workaround for the wallet not
@@ -489,6 +529,7 @@ void StopHTTPServer()
         workQueue->WaitExit();
 #endif        
         delete workQueue;
+        workQueue = 0;
     }
     if (eventBase) {
         LogPrint("http", "Waiting for HTTP event thread to exit\n");
@@ -515,6 +556,18 @@ void StopHTTPServer()
     LogPrint("http", "Stopped HTTP server\n");
 }
 
+HTTPWorkQueueStats GetHTTPWorkQueueStats(HTTPWorkLane lane)
+{
+    assert(lane < HTTP_LANE_COUNT);
+    HTTPWorkQueueStats stats;
+    {
+        std::lock_guard<std::mutex> lock(cs_workQueueStats);
+        stats = workQueueStats[lane];
+    }
+    stats.nDepth = workQueues[lane] ? workQueues[lane]->Depth() : 0;
+    return stats;
+}
+
 struct event_base* EventBase()
 {
     return eventBase;
@@ -547,12 +600,17 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* _req) : req(_req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       chunkedReply(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (chunkedReply && !replySent) {
+        // Cut short, the client sees the body is incomplete
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        EndChunkedReply();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -591,6 +649,17 @@ std::string HTTPRequest::ReadBody()
     return rv;
 }
 
+std::string HTTPRequest::PeekBody(size_t nMaxSize)
+{
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf)
+        return "";
+    std::string rv(std::min(nMaxSize, evbuffer_get_length(buf)), '\0');
+    ev_ssize_t nCopied = rv.empty() ? 0 : evbuffer_copyout(buf, &rv[0], rv.size());
+    rv.resize(nCopied > 0 ? nCopied : 0);
+    return rv;
+}
+
 void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 {
     struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
@@ -605,7 +674,7 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
  */
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
 {
-    assert(!replySent && req);
+    assert(!replySent && !chunkedReply && req);
     // Send event to main http thread to send reply message
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
@@ -617,6 +686,40 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread
 }
 
+void HTTPRequest::StartChunkedReply(int nStatus)
+{
+    assert(!replySent && !chunkedReply && req);
+    // Like WriteReply, everything is handed to the main http thread. Its events run in the
+    // order they were triggered, so the chunks go out in order.
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        std::bind(evhttp_send_reply_start, req, nStatus, (const char*)NULL));
+    ev->trigger(0);
+    chunkedReply = true;
+}
+
+void HTTPRequest::WriteReplyChunk(const char* data, size_t size)
+{
+    assert(chunkedReply && req);
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, data, size);
+    struct evhttp_request* chunkReq = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [chunkReq, evb]() {
+        evhttp_send_reply_chunk(chunkReq, evb);
+        evbuffer_free(evb);
+    });
+    ev->trigger(0);
+}
+
+void HTTPRequest::EndChunkedReply()
+{
+    assert(chunkedReply && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, std::bind(evhttp_send_reply_end, req));
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -657,10 +760,10 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPLaneSelector &selector)
 {
     LogPrint("http", "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, selector));
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
@@ -10,6 +10,7 @@
 #include <functional>
 
 static const int DEFAULT_HTTP_THREADS=4;
+static const int DEFAULT_HTTP_SLOW_THREADS=2;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
 
@@ -32,13 +33,22 @@ void InterruptHTTPServer();
 /** Stop HTTP server */
 void StopHTTPServer();
 
+/** Each lane has its own work queue and worker threads, so slow requests can't hold up the rest */
+enum HTTPWorkLane {
+    HTTP_LANE_DEFAULT,
+    HTTP_LANE_SLOW,
+    HTTP_LANE_COUNT
+};
+
 /** Handler for requests to a certain HTTP path */
 typedef std::function<bool(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
+/** Picks the lane of a request. Runs on the event loop thread, so it has to be cheap. */
+typedef std::function<HTTPWorkLane(HTTPRequest* req, const std::string &)> HTTPLaneSelector;
 /** Register handler for prefix.
  * If multiple handlers match a prefix, the first-registered one will
- * be invoked.
+ * be invoked. Without a selector all requests go to HTTP_LANE_DEFAULT.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPLaneSelector &selector = HTTPLaneSelector());
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
@@ -47,6 +57,20 @@ void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
  */
 struct event_base* EventBase();
 
+struct HTTPWorkQueueStats
+{
+    int nThreads;
+    size_t nDepth;
+    size_t nMaxDepth;
+    uint64_t nQueued;
+    uint64_t nRejected;
+    int64_t nTotalWaitMicros;
+    int64_t nMaxWaitMicros;
+};
+
+/** Queue depth and waiting times of a lane since startup */
+HTTPWorkQueueStats GetHTTPWorkQueueStats(HTTPWorkLane lane);
+
 /** In-flight HTTP request.
  * Thin C++ wrapper around evhttp_request.
  */
@@ -55,6 +79,7 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool chunkedReply;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -94,6 +119,11 @@ public:
      */
     std::string ReadBody();
 
+    /**
+     * Read up to nMaxSize bytes of the body without consuming it.
+     */
+    std::string PeekBody(size_t nMaxSize);
+
     /**
      * Write output header.
      *
@@ -110,6 +140,19 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a chunked reply instead of WriteReply, for a body that is sent while it is produced.
+     * Send the body with WriteReplyChunk and finish it with EndChunkedReply.
+     *
+     * @note call WriteHeader before this.
+     */
+    void StartChunkedReply(int nStatus);
+    void WriteReplyChunk(const char* data, size_t size);
+    /**
+     * @note As for WriteReply, do not call any other HTTPRequest methods after this.
+     */
+    void EndChunkedReply();
 };
 
 /** Event handler closure.
@@ -0,0 +1,159 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "indexbuilder.h"
+
+#include "chain.h"
+#include "txdb.h"
+#include "util.h"
+#include "validation.h"
+
+#include <atomic>
+
+#include <boost/thread.hpp>
+
+// Blocks this close to the tip are only indexed under cs_main, together with switching the indexes on
+static const int INDEX_BUILDER_TIP_DEPTH = 10;
+// Store the progress every that many blocks
+static const int INDEX_BUILDER_PROGRESS_INTERVAL = 1000;
+
+static std::atomic<bool> fBuilderRunning{false};
+static std::atomic<bool> fBuilderAddressIndex{false};
+static std::atomic<bool> fBuilderSpentIndex{false};
+static std::atomic<int> nBuilderHeight{0};
+
+bool GetIndexBuilderStatus(bool& fAddressIndexRet, bool& fSpentIndexRet, int& nHeightRet)
+{
+    if (!fBuilderRunning)
+        return false;
+    fAddressIndexRet = fBuilderAddressIndex;
+    fSpentIndexRet = fBuilderSpentIndex;
+    nHeightRet = nBuilderHeight;
+    return true;
+}
+
+static bool IndexBlock(const CBlockIndex* pindex, bool fAddress, bool fSpent)
+{
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+
+    if (!GetBlockIndexEntries(pindex, fAddress, fSpent, addressIndex, addressUnspentIndex, spentIndex))
+        return false;
+
+    // One batch per block, the address balances of a block are based on those of the previous one
+    if (!pblocktree->WriteBlockIndexes(addressIndex, false,
+                                       addressUnspentIndex, spentIndex, {}, nullptr))
+        return error("%s: failed to write indexes of block %s", __func__, pindex->GetBlockHash().ToString());
+
+    nBuilderHeight = pindex->nHeight;
+    return true;
+}
+
+// Start over from the genesis block, requires cs_main
+static const CBlockIndex* RestartBuild(bool fAddress, bool fSpent)
+{
+    AssertLockHeld(cs_main);
+
+    if (!pblocktree->WipeIndexes(fAddress, fSpent) ||
+        !pblocktree->WriteIndexBuildProgress(chainActive.Genesis()->GetBlockHash(), fAddress, fSpent))
+        return nullptr;
+    nBuilderHeight = 0;
+    return chainActive.Genesis();
+}
+
+static bool BuildIndexes(bool fAddress, bool fSpent)
+{
+    const CBlockIndex* pindexLast = nullptr;
+    {
+        LOCK(cs_main);
+
+        uint256 hashProgress;
+        bool fProgressAddress, fProgressSpent;
+        if (pblocktree->ReadIndexBuildProgress(hashProgress, fProgressAddress, fProgressSpent) &&
+            fProgressAddress == fAddress && fProgressSpent == fSpent) {
+            BlockMap::iterator mi = mapBlockIndex.find(hashProgress);
+            if (mi != mapBlockIndex.end() && chainActive.Contains(mi->second))
+                pindexLast = mi->second;
+        }
+        if (!pindexLast) {
+            // Nothing usable stored, whatever a previous build left behind can't be trusted
+            pindexLast = RestartBuild(fAddress, fSpent);
+            if (!pindexLast)
+                return error("%s: failed to reset indexes", __func__);
+        }
+        nBuilderHeight = pindexLast->nHeight;
+        LogPrintf("%s: building indexes from height %d, tip at %d\n", __func__, pindexLast->nHeight, chainActive.Height());
+    }
+
+    while (true) {
+        boost::this_thread::interruption_point();
+
+        const CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+
+            if (!chainActive.Contains(pindexLast)) {
+                // A reorg went below the blocks indexed already, their entries would have to be undone
+                LogPrintf("%s: reorganization below height %d, restarting\n", __func__, pindexLast->nHeight);
+                pindexLast = RestartBuild(fAddress, fSpent);
+                if (!pindexLast)
+                    return error("%s: failed to reset indexes", __func__);
+                continue;
+            }
+
+            if (pindexLast->nHeight + INDEX_BUILDER_TIP_DEPTH >= chainActive.Height()) {
+                // Index the last few blocks and switch the indexes on without letting go of cs_main,
+                // so ConnectBlock and DisconnectBlock take over with the very next block
+                while ((pindex = chainActive.Next(pindexLast))) {
+                    if (!IndexBlock(pindex, fAddress, fSpent))
+                        return false;
+                    pindexLast = pindex;
+                }
+
+                if (fAddress) {
+                    if (!pblocktree->WriteFlag("addressindex", true) || !pblocktree->WriteFlag("addressbalanceindex", true))
+                        return error("%s: failed to write address index flags", __func__);
+                    fAddressIndex = true;
+                }
+                if (fSpent) {
+                    if (!pblocktree->WriteFlag("spentindex", true))
+                        return error("%s: failed to write spent index flag", __func__);
+                    fSpentIndex = true;
+                }
+                pblocktree->EraseIndexBuildProgress();
+                LogPrintf("%s: indexes built up to height %d\n", __func__, pindexLast->nHeight);
+                return true;
+            }
+
+            pindex = chainActive.Next(pindexLast);
+        }
+
+        // Far enough from the tip to read the block without cs_main, a reorg that deep is caught above
+        if (!IndexBlock(pindex, fAddress, fSpent))
+            return false;
+        pindexLast = pindex;
+
+        if (pindex->nHeight % INDEX_BUILDER_PROGRESS_INTERVAL == 0) {
+            pblocktree->WriteIndexBuildProgress(pindex->GetBlockHash(), fAddress, fSpent);
+            LogPrintf("%s: indexed up to height %d\n", __func__, pindex->nHeight);
+        }
+    }
+}
+
+void ThreadBuildIndexes(bool fAddress, bool fSpent)
+{
+    fBuilderAddressIndex = fAddress;
+    fBuilderSpentIndex = fSpent;
+    fBuilderRunning = true;
+
+    try {
+        if (!BuildIndexes(fAddress, fSpent))
+            LogPrintf("%s: failed to build indexes, they stay disabled, use -reindex to build them\n", __func__);
+    } catch (const boost::thread_interrupted&) {
+        fBuilderRunning = false;
+        throw;
+    }
+    fBuilderRunning = false;
+}
@@ -0,0 +1,19 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEXBUILDER_H
+#define BITCOIN_INDEXBUILDER_H
+
+/**
+ * Build -addressindex and/or -spentindex for an existing block database from the block and undo
+ * files, while the node keeps running. The indexes are switched on once the builder caught up
+ * with the tip, until then the RPCs using them report them as not enabled. Progress is stored
+ * in the block tree database, so an interrupted build resumes where it stopped.
+ */
+void ThreadBuildIndexes(bool fAddressIndex, bool fSpentIndex);
+
+/** Whether a build is running, and if so which indexes it builds and the height it got to */
+bool GetIndexBuilderStatus(bool& fAddressIndexRet, bool& fSpentIndexRet, int& nHeightRet);
+
+#endif // BITCOIN_INDEXBUILDER_H
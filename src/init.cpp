@@ -20,10 +20,15 @@
 #include "checkpoints.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
+#include "dbwrapper.h"
+#include "hash.h"
 #include "httpserver.h"
 #include "httprpc.h"
+#include "indexbuilder.h"
 #include "key.h"
 #include "validation.h"
+#include "kernel.h"
+#include "metrics.h"
 #include "miner.h"
 #include "netbase.h"
 #include "net.h"
@@ -74,9 +79,11 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <future>
 #include <memory>
 
 #include "bls/bls.h"
+#include "bls/bls_sigcache.h"
 
 #ifndef WIN32
 #include <signal.h>
@@ -95,6 +102,7 @@
 
 #if ENABLE_ZMQ
 #include "zmq/zmqnotificationinterface.h"
+#include "zmq/zmqrpc.h"
 #endif
 
 extern void ThreadSendAlert(CConnman& connman);
@@ -109,10 +117,6 @@ static const bool DEFAULT_STOPAFTERBLOCKIMPORT = false;
 std::unique_ptr<CConnman> g_connman;
 std::unique_ptr<PeerLogicValidation> peerLogic;
 
-#if ENABLE_ZMQ
-static CZMQNotificationInterface* pzmqNotificationInterface = NULL;
-#endif
-
 static CDSNotificationInterface* pdsNotificationInterface = NULL;
 
 #ifdef WIN32
@@ -218,6 +222,30 @@ void Interrupt(boost::thread_group& threadGroup)
     threadGroup.interrupt_all();
 }
 
+/** Store the data caches into their serialized dat files, on shutdown and every -cachedumpinterval */
+static void DumpCaches()
+{
+    // the scheduled dump and the one on shutdown must not write the same files at once
+    static CCriticalSection cs_dumpCaches;
+    LOCK(cs_dumpCaches);
+
+    CFlatDB<CMasternodeMetaMan> flatdb1("mncache.dat", "magicMasternodeCache");
+    flatdb1.Dump(mmetaman);
+    CFlatDB<CGovernanceManager> flatdb3("governance.dat", "magicGovernanceCache");
+    flatdb3.Dump(governance);
+    CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
+    flatdb4.Dump(netfulfilledman);
+    CFlatDB<CMasternodeSync> flatdb7("mnsync.dat", "magicMasternodeSyncCache");
+    flatdb7.Dump(masternodeSync);
+    if(fEnableInstantSend)
+    {
+        CFlatDB<CInstantSend> flatdb5("instantsend.dat", "magicInstaEPMCache");
+        flatdb5.Dump(instantsend);
+    }
+    CFlatDB<CSporkManager> flatdb6("sporks.dat", "magicSporkCache");
+    flatdb6.Dump(sporkManager);
+}
+
 /** Preparing steps before shutting down or restarting the wallet */
 void PrepareShutdown()
 {
@@ -235,9 +263,12 @@ void PrepareShutdown()
     mempool.AddTransactionsUpdated(1);
     StopHTTPRPC();
     StopREST();
+    StopMetrics();
     StopRPC();
     StopHTTPServer();
     llmq::StopLLMQSystem();
+    // the listeners are unregistered and deleted below
+    StopBackgroundValidationCallbacks();
 
     // fRPCInWarmup should be `false` if we completed the loading sequence
     // before a shutdown request was received
@@ -250,6 +281,7 @@ void PrepareShutdown()
         privateSendClient.fEnablePrivateSend = false;
         privateSendClient.ResetPool();
     }
+    StopStakeSearchWorkers();
     if (pwalletMain)
         pwalletMain->Flush(false);
 #endif
@@ -261,22 +293,12 @@ void PrepareShutdown()
         g_connman->Stop();
     }
     g_connman.reset();
+    StopContextFreeCheckWorkers();
+    StopInputPrefetchWorkers();
+    StopGovernanceWorkers();
 
     if (!fLiteMode && !fRPCInWarmup) {
-        // STORE DATA CACHES INTO SERIALIZED DAT FILES
-        CFlatDB<CMasternodeMetaMan> flatdb1("mncache.dat", "magicMasternodeCache");
-        flatdb1.Dump(mmetaman);
-        CFlatDB<CGovernanceManager> flatdb3("governance.dat", "magicGovernanceCache");
-        flatdb3.Dump(governance);
-        CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
-        flatdb4.Dump(netfulfilledman);
-        if(fEnableInstantSend)
-        {
-            CFlatDB<CInstantSend> flatdb5("instantsend.dat", "magicInstaEPMCache");
-            flatdb5.Dump(instantsend);
-        }
-        CFlatDB<CSporkManager> flatdb6("sporks.dat", "magicSporkCache");
-        flatdb6.Dump(sporkManager);
+        DumpCaches();
     }
 
     UnregisterNodeSignals(GetNodeSignals());
@@ -298,13 +320,22 @@ void PrepareShutdown()
         LOCK(cs_main);
         if (pcoinsTip != NULL) {
             FlushStateToDisk();
+            if (GetBoolArg("-blockindexsnapshot", DEFAULT_BLOCKINDEX_SNAPSHOT))
+                DumpBlockIndexSnapshot();
         }
         delete pcoinsTip;
         pcoinsTip = NULL;
         delete pcoinscatcher;
         pcoinscatcher = NULL;
+        delete pcoinsprefetch;
+        pcoinsprefetch = NULL;
+        delete pcoinsflusher;
+        pcoinsflusher = NULL;
         delete pcoinsdbview;
         pcoinsdbview = NULL;
+        // writes out what is still queued
+        delete ptxindexdb;
+        ptxindexdb = NULL;
         delete pblocktree;
         pblocktree = NULL;
         llmq::DestroyLLMQSystem();
@@ -373,6 +404,7 @@ void Shutdown()
     globalVerifyHandle.reset();
     ECC_Stop();
     LogPrintf("%s: done\n", __func__);
+    StopAsyncDebugLog();
 }
 
 /**
@@ -432,10 +464,13 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
     strUsage += HelpMessageOpt("-alerts", strprintf(_("Receive and display P2P network alerts (default: %u)"), DEFAULT_ALERTS));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
+    strUsage += HelpMessageOpt("-blockindexsnapshot", strprintf(_("Write the block index to a snapshot file at shutdown and load it from there on the next start if it is still valid (default: %u)"), DEFAULT_BLOCKINDEX_SNAPSHOT));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     if (showDebug)
         strUsage += HelpMessageOpt("-blocksonly", strprintf(_("Whether to operate in a blocks only mode (default: %u)"), DEFAULT_BLOCKSONLY));
+    strUsage += HelpMessageOpt("-assumechainlocked", strprintf(_("Skip script verification of blocks which are covered by a ChainLock, e.g. while catching up after downtime (default: %u)"), DEFAULT_ASSUME_CHAINLOCKED));
     strUsage +=HelpMessageOpt("-assumevalid=<hex>", strprintf(_("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s)"), Params(CBaseChainParams::MAIN).GetConsensus().defaultAssumeValid.GetHex(), Params(CBaseChainParams::TESTNET).GetConsensus().defaultAssumeValid.GetHex()));
+    strUsage += HelpMessageOpt("-cachedumpinterval=<n>", strprintf(_("Write the masternode, governance, spork and other caches to disk every <n> seconds, 0 to only write them on shutdown (default: %u)"), DEFAULT_CACHE_DUMP_INTERVAL));
     strUsage += HelpMessageOpt("-conf=<file>", strprintf(_("Specify configuration file (default: %s)"), BITCOIN_CONF_FILENAME));
     if (mode == HMM_BITCOIND)
     {
@@ -445,13 +480,28 @@ std::string HelpMessage(HelpMessageMode mode)
     }
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    strUsage += HelpMessageOpt("-dbtuning=<db>:<option>=<n>", _("Override a LevelDB setting of one database (chainstate, blockindex, txindex, evodb, llmq or recsigs): "
+        "cache and writebuffer in megabytes, maxopenfiles, compression (0 or 1) or bloombits (0 for no filter). Can be specified multiple times"));
+    strUsage += HelpMessageOpt("-backgroundflush", strprintf(_("Write the coins cache to disk in the background while validation continues (default: %u)"), DEFAULT_BACKGROUND_FLUSH));
+    strUsage += HelpMessageOpt("-utxosetstats", strprintf(_("Keep a rolling hash and totals of the UTXO set up to date with every block, for gettxoutsetinfo \"muhash\" (default: %u)"), DEFAULT_UTXOSET_STATS));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
     strUsage += HelpMessageOpt("-maxorphantxsize=<n>", strprintf(_("Maximum total size of all orphan transactions in megabytes (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE));
     strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
+    strUsage += HelpMessageOpt("-persistmempool", strprintf(_("Whether to save the mempool on shutdown and load on restart (default: %u)"), DEFAULT_PERSIST_MEMPOOL));
     strUsage += HelpMessageOpt("-mempoolexpiry=<n>", strprintf(_("Do not keep transactions in the mempool longer than <n> hours (default: %u)"), DEFAULT_MEMPOOL_EXPIRY));
+#ifndef WIN32
+    strUsage += HelpMessageOpt("-mmapblocks", strprintf(_("Read blocks from memory maps of the completed block files, for nodes serving a lot of historical blocks (default: %u)"), DEFAULT_MMAP_BLOCKS));
+#endif
     strUsage += HelpMessageOpt("-blockreconstructionextratxn=<n>", strprintf(_("Extra transactions to keep in memory for compact block reconstructions (default: %u)"), DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-scriptcheckbatch=<n>", strprintf(_("Maximum number of script checks a verification thread takes at once (default: %u)"), DEFAULT_SCRIPTCHECK_BATCH_SIZE));
+    strUsage += HelpMessageOpt("-scriptcheckstealing", strprintf(_("Give every script verification thread its own work queue (default: 1 with at least %d threads)"), SCRIPTCHECK_WORK_STEALING_THREADS));
+    strUsage += HelpMessageOpt("-inputprefetchthreads=<n>", strprintf(_("Set the number of threads reading block inputs from the coins database ahead of validation (0 to %d, 0 = disable, default: %d)"),
+        MAX_INPUT_PREFETCH_THREADS, DEFAULT_INPUT_PREFETCH_THREADS));
+    strUsage += HelpMessageOpt("-threadaffinity=<group>=<cpus>", _("Run the threads of a subsystem only on the given cpus, a list like 0-7,16-23 or node<n> for all cpus of a NUMA node. "
+        "Groups are validation, msghand, net, bls, dkg, sigshares, instantsend and http. This option can be specified multiple times (Linux only)"));
+    strUsage += HelpMessageOpt("-reservecores=<cpus>", _("Keep the given cpus for the message handler and validation threads, unless -threadaffinity places those elsewhere, all other threads run on the remaining cpus (Linux only)"));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), BITCOIN_PID_FILENAME));
 #endif
@@ -465,9 +515,10 @@ std::string HelpMessage(HelpMessageMode mode)
 #endif
     strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), DEFAULT_TXINDEX));
 
-    strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)"), DEFAULT_ADDRESSINDEX));
-    strUsage += HelpMessageOpt("-timestampindex", strprintf(_("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)"), DEFAULT_TIMESTAMPINDEX));
-    strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain a full spent index, used to query the spending txid and input index for an outpoint (default: %u)"), DEFAULT_SPENTINDEX));
+    strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses, built in the background when enabled on an existing database (default: %u)"), DEFAULT_ADDRESSINDEX));
+    strUsage += HelpMessageOpt("-timestampindex", strprintf(_("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps including those of stale blocks, which getblockhashes leaves out otherwise (default: %u)"), DEFAULT_TIMESTAMPINDEX));
+    strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain a full spent index, used to query the spending txid and input index for an outpoint, built in the background when enabled on an existing database (default: %u)"), DEFAULT_SPENTINDEX));
+    strUsage += HelpMessageOpt("-rewardindex", strprintf(_("Maintain an index of the stake, masternode and superblock rewards by address, used by the getrewards rpc call, changing it requires -reindex-chainstate (default: %u)"), DEFAULT_REWARDINDEX));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open"));
@@ -487,6 +538,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXRECEIVEBUFFER));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXSENDBUFFER));
     strUsage += HelpMessageOpt("-maxtimeadjustment", strprintf(_("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)"), DEFAULT_MAX_TIME_ADJUSTMENT));
+    strUsage += HelpMessageOpt("-msgprocthreads=<n>", strprintf(_("Number of threads processing LLMQ and governance messages besides the message handler (0-%d, 0 = disable, default: %d)"), MAX_MSGPROC_THREADS, DEFAULT_MSGPROC_THREADS));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), DEFAULT_PERMIT_BAREMULTISIG));
@@ -495,9 +547,11 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-proxy=<ip:port>", _("Connect through SOCKS5 proxy"));
     strUsage += HelpMessageOpt("-proxyrandomize", strprintf(_("Randomize credentials for every proxy connection. This enables Tor stream isolation (default: %u)"), DEFAULT_PROXYRANDOMIZE));
     strUsage += HelpMessageOpt("-seednode=<ip>", _("Connect to a node to retrieve peer addresses, and disconnect"));
+    strUsage += HelpMessageOpt("-socketevents=<mode>", strprintf(_("Socket events mode, which must be one of: %s (default: %s)"), GetSupportedSocketEventsStr(), DEFAULT_SOCKETEVENTS));
     strUsage += HelpMessageOpt("-timeout=<n>", strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"), DEFAULT_CONNECT_TIMEOUT));
     strUsage += HelpMessageOpt("-torcontrol=<ip>:<port>", strprintf(_("Tor control port to use if onion listening enabled (default: %s)"), DEFAULT_TOR_CONTROL));
     strUsage += HelpMessageOpt("-torpassword=<pass>", _("Tor control port password (default: empty)"));
+    strUsage += HelpMessageOpt("-txreconciliation", strprintf(_("Announce transactions by short id to outbound peers which support it, keeping full announcements for %d of them (default: %u)"), TXRECONCILIATION_FLOOD_PEERS, DEFAULT_TXRECONCILIATION));
 #ifdef USE_UPNP
 #if USE_UPNP
     strUsage += HelpMessageOpt("-upnp", _("Use UPnP to map the listening port (default: 1 when listening and no -proxy)"));
@@ -530,6 +584,14 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtxlock=<address>", _("Enable publish raw transaction (locked via InstaEPM) in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawinstantsenddoublespend=<address>", _("Enable publish raw transactions of attempted InstaEPM double spend in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubrawmessagestats=<address>", _("Enable publish p2p message processing statistics on every new tip in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubrawblockprocessingstats=<address>", _("Enable publish block processing statistics on every new tip in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubblocktemplate=<address>", _("Enable publish block templates and their updates in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubrawmnlistdiff=<address>", _("Enable publish deterministic masternode list diffs in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubhashmempoolremoved=<address>", _("Enable publish hashes of transactions leaving the mempool, with the reason, in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubrawrecoveredsig=<address>", _("Enable publish raw LLMQ recovered signatures in <address>"));
+    strUsage += HelpMessageOpt("-zmqblocktemplateinterval=<n>", strprintf(_("Minimum time between two block template updates in milliseconds (default: %u)"), DEFAULT_ZMQ_BLOCKTEMPLATE_INTERVAL));
+    strUsage += HelpMessageOpt("-zmqsendqueuesize=<n>", strprintf(_("Maximum number of zmq messages waiting to be sent, more are dropped (default: %u)"), DEFAULT_ZMQ_SEND_QUEUE_SIZE));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -552,6 +614,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-limitdescendantsize=<n>", strprintf("Do not accept transactions if any ancestor would have more than <n> kilobytes of in-mempool descendants (default: %u).", DEFAULT_DESCENDANT_SIZE_LIMIT));
         strUsage += HelpMessageOpt("-bip9params=<deployment>:<start>:<end>(:<window>:<threshold>)", "Use given start/end times for specified BIP9 deployment (regtest-only). Specifying window and threshold is optional.");
         strUsage += HelpMessageOpt("-watchquorums=<n>", strprintf("Watch and validate quorum communication (default: %u)", llmq::DEFAULT_WATCH_QUORUMS));
+        strUsage += HelpMessageOpt("-pushdkgmessages=<n>", strprintf("Send own DKG messages directly to quorum connections instead of announcing them (default: %u)", llmq::DEFAULT_PUSH_DKG_MESSAGES));
     }
     std::string debugCategories = "addrman, alert, bench, cmpctblock, coindb, db, http, leveldb, libevent, lock, mempool, mempoolrej, net, proxy, prune, rand, reindex, rpc, selectcoins, tor, zmq, "
                                   "epmcoin (or specifically: chainlocks, gobject, instantsend, keepass, llmq, llmq-dkg, llmq-sigs, masternode, mnpayments, mnsync, privatesend, spork)"; // Don't translate these and qt below
@@ -562,7 +625,9 @@ std::string HelpMessage(HelpMessageMode mode)
     if (showDebug)
         strUsage += HelpMessageOpt("-nodebug", "Turn off debugging messages, same as -debug=0");
     strUsage += HelpMessageOpt("-help-debug", _("Show all debugging options (usage: --help -help-debug)"));
+    strUsage += HelpMessageOpt("-asynclog", strprintf(_("Write debug.log from a background thread instead of the logging threads (default: %u)"), DEFAULT_ASYNCLOG));
     strUsage += HelpMessageOpt("-logips", strprintf(_("Include IP addresses in debug output (default: %u)"), DEFAULT_LOGIPS));
+    strUsage += HelpMessageOpt("-lograte=<n>", strprintf(_("Log at most <n> debug messages per second of each -debug category, 0 for no limit (default: %u)"), DEFAULT_LOGRATELIMIT));
     strUsage += HelpMessageOpt("-logtimestamps", strprintf(_("Prepend debug output with timestamp (default: %u)"), DEFAULT_LOGTIMESTAMPS));
     if (showDebug)
     {
@@ -570,7 +635,10 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-logthreadnames", strprintf("Add thread names to debug messages (default: %u)", DEFAULT_LOGTHREADNAMES));
         strUsage += HelpMessageOpt("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)");
         strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit size of signature cache to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxblssigcachesize=<n>", strprintf("Limit size of BLS signature cache to <n> MiB (default: %u)", DEFAULT_MAX_BLS_SIG_CACHE_SIZE));
         strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE));
+        strUsage += HelpMessageOpt("-schedulerthreads=<n>", strprintf("Number of threads running background tasks (1 to %d, default: %d)", MAX_SCHEDULER_THREADS, DEFAULT_SCHEDULER_THREADS));
+        strUsage += HelpMessageOpt("-lockprofile=<n>", strprintf("Measure wait and hold times of one in <n> lock acquisitions for getlockstats, 0 to disable (default: %u)", DEFAULT_LOCK_PROFILE_RATE));
     }
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in %s/kB) smaller than this are considered zero fee for relaying, mining and transaction creation (default: %s)"),
         CURRENCY_UNIT, FormatMoney(DEFAULT_MIN_RELAY_TX_FEE)));
@@ -628,6 +696,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageGroup(_("RPC server options:"));
     strUsage += HelpMessageOpt("-server", _("Accept command line and JSON-RPC commands"));
     strUsage += HelpMessageOpt("-rest", strprintf(_("Accept public REST requests (default: %u)"), DEFAULT_REST_ENABLE));
+    strUsage += HelpMessageOpt("-metrics", strprintf(_("Serve node metrics in the Prometheus text format on /metrics of the RPC port (default: %u)"), DEFAULT_METRICS_ENABLE));
     strUsage += HelpMessageOpt("-rpcbind=<addr>[:port]", _("Bind to given address to listen for JSON-RPC connections. This option is ignored unless -rpcallowip is also passed. Port is optional and overrides -rpcport. Use [host]:port notation for IPv6. This option can be specified multiple times (default: 127.0.0.1 and ::1 i.e., localhost, or if -rpcallowip has been specified, 0.0.0.0 and :: i.e., all addresses)"));
     strUsage += HelpMessageOpt("-rpccookiefile=<loc>", _("Location of the auth cookie (default: data dir)"));
     strUsage += HelpMessageOpt("-rpcuser=<user>", _("Username for JSON-RPC connections"));
@@ -636,6 +705,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcport=<port>", strprintf(_("Listen for JSON-RPC connections on <port> (default: %u or testnet: %u)"), BaseParams(CBaseChainParams::MAIN).RPCPort(), BaseParams(CBaseChainParams::TESTNET).RPCPort()));
     strUsage += HelpMessageOpt("-rpcallowip=<ip>", _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
     strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_HTTP_THREADS));
+    strUsage += HelpMessageOpt("-rpcbatchthreads=<n>", strprintf(_("Set the number of threads one batch of read-only RPC calls is spread over (default: %d)"), DEFAULT_RPC_BATCH_THREADS));
+    strUsage += HelpMessageOpt("-rpcslowthreads=<n>", strprintf(_("Set the number of threads to service slow RPC calls and batches (default: %d)"), DEFAULT_HTTP_SLOW_THREADS));
     if (showDebug) {
         strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
         strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT));
@@ -832,8 +903,11 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
     }
 #endif
 
-    LoadMempool();
-    fDumpMempoolLater = !fRequestShutdown;
+    if (GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
+        LoadMempool();
+        fDumpMempoolLater = !fRequestShutdown;
+    }
+    fMempoolLoaded = true;
 }
 
 /** Sanity checks
@@ -875,6 +949,8 @@ bool AppInitServers(boost::thread_group& threadGroup)
         return false;
     if (GetBoolArg("-rest", DEFAULT_REST_ENABLE) && !StartREST())
         return false;
+    if (GetBoolArg("-metrics", DEFAULT_METRICS_ENABLE) && !StartMetrics())
+        return false;
     if (!StartHTTPServer())
         return false;
     return true;
@@ -954,6 +1030,12 @@ void InitParameterInteraction()
             LogPrintf("%s: parameter interaction: -whitelistforcerelay=1 -> setting -whitelistrelay=1\n", __func__);
     }
 
+    // proof-of-stake validation doesn't need the txindex, so pruning only has to turn off its default
+    if (GetArg("-prune", 0)) {
+        if (SoftSetBoolArg("-txindex", false))
+            LogPrintf("%s: parameter interaction: -prune set -> setting -txindex=0\n", __func__);
+    }
+
 #ifdef ENABLE_WALLET
     int nLiqProvTmp = GetArg("-liquidityprovider", DEFAULT_PRIVATESEND_LIQUIDITY);
     if (nLiqProvTmp > 0) {
@@ -983,7 +1065,8 @@ void InitParameterInteraction()
     bool fAdditionalIndexes =
         GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) ||
         GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) ||
-        GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+        GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX) ||
+        GetBoolArg("-rewardindex", DEFAULT_REWARDINDEX);
 
     if (fAdditionalIndexes && GetArg("-checklevel", DEFAULT_CHECKLEVEL) < 4) {
         ForceSetArg("-checklevel", "4");
@@ -1004,6 +1087,8 @@ void InitLogging()
     fLogTimeMicros = GetBoolArg("-logtimemicros", DEFAULT_LOGTIMEMICROS);
     fLogThreadNames = GetBoolArg("-logthreadnames", DEFAULT_LOGTHREADNAMES);
     fLogIPs = GetBoolArg("-logips", DEFAULT_LOGIPS);
+    nLogRateLimit = std::max<int64_t>(GetArg("-lograte", DEFAULT_LOGRATELIMIT), 0);
+    nLockProfileRate = std::max<int64_t>(GetArg("-lockprofile", DEFAULT_LOCK_PROFILE_RATE), 0);
 
     LogPrintf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     LogPrintf("EPMCoin Core version %s\n", FormatFullVersion());
@@ -1014,6 +1099,7 @@ namespace { // Variables internal to initialization process only
 ServiceFlags nRelevantServices = NODE_NETWORK;
 int nMaxConnections;
 int nUserMaxConnections;
+static SocketEventsMode socketEventsMode = SOCKETEVENTS_SELECT;
 int nFD;
 ServiceFlags nLocalServices = NODE_NETWORK;
 
@@ -1123,8 +1209,18 @@ bool AppInitParameterInteraction()
     nUserMaxConnections = GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
+    std::string strDBTuningError;
+    if (!CheckDBTuningArgs(strDBTuningError))
+        return InitError(strDBTuningError);
+
+    std::string strSocketEventsMode = GetArg("-socketevents", DEFAULT_SOCKETEVENTS);
+    if (!ParseSocketEventsMode(strSocketEventsMode, socketEventsMode))
+        return InitError(strprintf(_("Invalid -socketevents ('%s') specified. Only these modes are supported: %s"), strSocketEventsMode, GetSupportedSocketEventsStr()));
+
     // Trim requested connection counts, to fit into system limitations
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS)), 0);
+    // Only select() can't handle descriptors beyond FD_SETSIZE
+    if (socketEventsMode == SOCKETEVENTS_SELECT)
+        nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS)), 0);
     nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS + MAX_ADDNODE_CONNECTIONS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
@@ -1169,6 +1265,10 @@ bool AppInitParameterInteraction()
     }
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+#ifndef WIN32
+    fMapBlockFiles = GetBoolArg("-mmapblocks", DEFAULT_MMAP_BLOCKS);
+#endif
+    fAssumeChainLocked = GetBoolArg("-assumechainlocked", DEFAULT_ASSUME_CHAINLOCKED);
 
     hashAssumeValid = uint256S(GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
     if (!hashAssumeValid.IsNull())
@@ -1191,6 +1291,10 @@ bool AppInitParameterInteraction()
         incrementalRelayFee = CFeeRate(n);
     }
 
+    std::string strAffinityError;
+    if (!InitThreadAffinity(strAffinityError))
+        return InitError(strAffinityError);
+
     // -par=0 means autodetect, but nScriptCheckThreads==0 means no concurrency
     nScriptCheckThreads = GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
     if (nScriptCheckThreads <= 0)
@@ -1222,6 +1326,9 @@ bool AppInitParameterInteraction()
 #ifdef ENABLE_WALLET
     RegisterWalletRPCCommands(tableRPC);
 #endif
+#if ENABLE_ZMQ
+    RegisterZMQRPCCommands(tableRPC);
+#endif
 
     nConnectTimeout = GetArg("-timeout", DEFAULT_CONNECT_TIMEOUT);
     if (nConnectTimeout <= 0)
@@ -1419,6 +1526,11 @@ bool AppInitSanityChecks()
 {
     // ********************************************************* Step 4: sanity checks
 
+    std::string sha256_algo = SHA256AutoDetect();
+    LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string x11_algo = X11AutoDetect();
+    LogPrintf("Using the '%s' X11 implementation\n", x11_algo);
+
     // Initialize elliptic curve code
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1431,8 +1543,81 @@ bool AppInitSanityChecks()
     return LockDataDirectory(true);
 }
 
+/** Wall clock times of the phases of AppInitMain, logged together once the node is up */
+class CInitPhaseTimes
+{
+private:
+    CCriticalSection cs;
+    std::vector<std::pair<std::string, int64_t> > vPhases;
+
+public:
+    void Add(const std::string& strPhase, int64_t nStartMillis)
+    {
+        int64_t nTime = GetTimeMillis() - nStartMillis;
+        LOCK(cs);
+        vPhases.emplace_back(strPhase, nTime);
+    }
+
+    void Log()
+    {
+        LOCK(cs);
+        LogPrintf("Startup phases:\n");
+        for (const auto& phase : vPhases)
+            LogPrintf(" %-28s %8dms\n", phase.first, phase.second);
+    }
+};
+
+/** Reads the cache files which don't depend on the chain, returns the one which failed to load */
+static std::string LoadCacheFiles(CInitPhaseTimes& phaseTimes)
+{
+    int64_t nStart = GetTimeMillis();
+    if (!CFlatDB<CMasternodeMetaMan>("mncache.dat", "magicMasternodeCache").Load(mmetaman))
+        return "mncache.dat";
+    if (!CFlatDB<CNetFulfilledRequestManager>("netfulfilled.dat", "magicFulfilledCache").Load(netfulfilledman))
+        return "netfulfilled.dat";
+    if (!CFlatDB<CMasternodeSync>("mnsync.dat", "magicMasternodeSyncCache").Load(masternodeSync))
+        return "mnsync.dat";
+    // cleaning it up asks masternodeSync, so it comes after mnsync.dat
+    if (fEnableInstantSend && !CFlatDB<CInstantSend>("instantsend.dat", "magicInstaEPMCache").Load(instantsend))
+        return "instantsend.dat";
+    phaseTimes.Add("cache files (background)", nStart);
+    return "";
+}
+
+/**
+ * Reads governance.dat, whose objects are checked against the masternode list at the tip and
+ * the masternode cache. So it needs the chain and waits for the other cache files.
+ */
+static std::string LoadGovernanceCache(std::shared_future<std::string> futureCacheFiles, CInitPhaseTimes& phaseTimes)
+{
+    if (!futureCacheFiles.get().empty())
+        return "";
+    int64_t nStart = GetTimeMillis();
+    if (!CFlatDB<CGovernanceManager>("governance.dat", "magicGovernanceCache").Load(governance))
+        return "governance.dat";
+    governance.InitOnLoad();
+    phaseTimes.Add("governance (background)", nStart);
+    return "";
+}
+
+static std::string CacheLoadErrorMessage(const std::string& strFile)
+{
+    if (strFile == "mncache.dat")
+        return _("Failed to load masternode cache from");
+    if (strFile == "netfulfilled.dat")
+        return _("Failed to load fulfilled requests cache from");
+    if (strFile == "mnsync.dat")
+        return _("Failed to load masternode sync cache from");
+    if (strFile == "instantsend.dat")
+        return _("Failed to load InstantSend data cache from");
+    return _("Failed to load cache from");
+}
+
 bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 {
+    int64_t nInitStart = GetTimeMillis();
+    CInitPhaseTimes phaseTimes;
+
     const CChainParams& chainparams = Params();
     // ********************************************************* Step 4a: application initialization
     // After daemonization get the data directory lock again and hold on to it until exit
@@ -1452,8 +1637,11 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         ShrinkDebugFile();
     }
 
-    if (fPrintToDebugLog)
+    if (fPrintToDebugLog) {
         OpenDebugLog();
+        if (GetBoolArg("-asynclog", DEFAULT_ASYNCLOG))
+            StartAsyncDebugLog();
+    }
 
     if (!fLogTimestamps)
         LogPrintf("Startup time: %s\n", DateTimeStrFormat("%Y-%m-%d %H:%M:%S", GetTime()));
@@ -1463,9 +1651,14 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     LogPrintf("Using at most %i automatic connections (%i file descriptors available)\n", nMaxConnections, nFD);
 
     InitSignatureCache();
+    InitBLSSignatureCache();
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
+        int nBatchSize = GetArg("-scriptcheckbatch", DEFAULT_SCRIPTCHECK_BATCH_SIZE);
+        bool fWorkStealing = GetBoolArg("-scriptcheckstealing", nScriptCheckThreads >= SCRIPTCHECK_WORK_STEALING_THREADS);
+        if (InitScriptCheckQueue(std::max(1, nBatchSize), fWorkStealing))
+            LogPrintf("Using work-stealing script verification queues\n");
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
     }
@@ -1494,9 +1687,24 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         }
     }
 
-    // Start the lightweight task scheduler thread
+    // Start the lightweight task scheduler threads, the addrman and cache dumps, the governance
+    // maintenance and the background validation callbacks get threads of their own as they can take long
+    int nSchedulerThreads = std::max(1, std::min((int)GetArg("-schedulerthreads", DEFAULT_SCHEDULER_THREADS), MAX_SCHEDULER_THREADS));
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
-    threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    for (int i = 0; i < nSchedulerThreads; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    static const std::pair<const char*, const char*> dedicatedTasks[] = {{"dumpaddr", "sched-addr"}, {"governance", "sched-gov"}, {"dumpcaches", "sched-dump"}, {"validationinterface", "sched-valif"}};
+    for (const auto& task : dedicatedTasks) {
+        CScheduler::Function dedicatedLoop = boost::bind(&CScheduler::serviceDedicated, &scheduler, std::string(task.first));
+        threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, task.second, dedicatedLoop));
+    }
+    StartBackgroundValidationCallbacks(scheduler);
+    scheduler.scheduleEvery([&scheduler]() {
+        for (const auto& p : scheduler.getTaskStats()) {
+            LogPrint("bench", "scheduler: task %s: %u runs, avg %.2fms, max %.2fms, max delay %.2fms\n", p.first.empty() ? "(unnamed)" : p.first,
+                p.second.nRuns, p.second.nTotalMicros * 0.001 / p.second.nRuns, p.second.nMaxMicros * 0.001, p.second.nMaxDelayMicros * 0.001);
+        }
+    }, 10 * 60 * 1000, "schedulerstats");
 
     /* Start the RPC server already.  It will be started in "warmup" mode
      * and not really process calls already (but it will signify connections
@@ -1705,8 +1913,13 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         InitWarning(_("You are starting in lite mode, all EPMCoin-specific functionality is disabled."));
     }
 
+    fEnableInstantSend = GetBoolArg("-enableinstantsend", 1);
+
     if((!fLiteMode && fTxIndex == false)
        && chainparams.NetworkIDString() != CBaseChainParams::REGTEST) { // TODO remove this when pruning is fixed. See https://github.com/EPMCoinOfficial/EPM/pull/1817 and https://github.com/EPMCoinOfficial/EPM/pull/1743
+        // governance collaterals and InstantSend inputs are still looked up by txid
+        if (fPruneMode)
+            return InitError(_("Prune mode requires -litemode, governance and InstantSend need the transaction index in full mode."));
         return InitError(_("Transaction index can't be disabled in full mode. Either start with -litemode command line switch or enable transaction index."));
     }
 
@@ -1723,6 +1936,14 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     fReindex = GetBoolArg("-reindex", false);
     bool fReindexChainState = GetBoolArg("-reindex-chainstate", false);
 
+    // The cache files are read in the background, the ones which don't depend on the chain while
+    // it loads and governance.dat next to the wallet. They are waited for in Step 10c.
+    bool fIgnoreCacheFiles = fLiteMode || fReindex || fReindexChainState;
+    std::shared_future<std::string> futureCacheFiles;
+    std::future<std::string> futureGovernanceCache;
+    if (!fIgnoreCacheFiles)
+        futureCacheFiles = std::async(std::launch::async, LoadCacheFiles, std::ref(phaseTimes)).share();
+
     boost::filesystem::create_directories(GetDataDir() / "blocks");
 
     // cache size calculations
@@ -1732,6 +1953,9 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     int64_t nBlockTreeDBCache = nTotalCache / 8;
     nBlockTreeDBCache = std::min(nBlockTreeDBCache, (GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxBlockDBAndTxIndexCache : nMaxBlockDBCache) << 20);
     nTotalCache -= nBlockTreeDBCache;
+    // the txindex gets most of it, the rest of the block tree is small
+    int64_t nTxIndexDBCache = GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nBlockTreeDBCache * 3 / 4 : 0;
+    nBlockTreeDBCache -= nTxIndexDBCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
@@ -1740,6 +1964,8 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     int64_t nEvoDbCache = 1024 * 1024 * 16; // TODO
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    if (nTxIndexDBCache)
+        LogPrintf("* Using %.1fMiB for transaction index database\n", nTxIndexDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
@@ -1757,8 +1983,12 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
             try {
                 UnloadBlockIndex();
                 delete pcoinsTip;
-                delete pcoinsdbview;
                 delete pcoinscatcher;
+                delete pcoinsprefetch;
+                delete pcoinsflusher;
+                delete pcoinsdbview;
+                delete ptxindexdb;
+                ptxindexdb = NULL;
                 delete pblocktree;
                 llmq::DestroyLLMQSystem();
                 delete deterministicMNManager;
@@ -1767,8 +1997,12 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                 evoDb = new CEvoDB(nEvoDbCache, false, fReindex || fReindexChainState);
                 deterministicMNManager = new CDeterministicMNManager(*evoDb);
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
+                if (GetBoolArg("-txindex", DEFAULT_TXINDEX))
+                    ptxindexdb = new CTxIndexDB(*pblocktree, nTxIndexDBCache, false, fReindex || fReindexChainState);
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState);
-                pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
+                pcoinsflusher = new CCoinsViewBackgroundFlush(pcoinsdbview, GetBoolArg("-backgroundflush", DEFAULT_BACKGROUND_FLUSH));
+                pcoinsprefetch = new CCoinsViewPrefetch(pcoinsflusher, MAX_PREFETCHED_COINS);
+                pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsprefetch);
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
                 llmq::InitLLMQSystem(*evoDb, &scheduler, false, fReindex || fReindexChainState);
 
@@ -1811,6 +2045,12 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                     break;
                 }
 
+                // Check for changed -rewardindex state, the index is only written while connecting blocks
+                if (fRewardIndex != GetBoolArg("-rewardindex", DEFAULT_REWARDINDEX)) {
+                    strLoadError = _("You need to rebuild the database using -reindex-chainstate to change -rewardindex");
+                    break;
+                }
+
                 // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks
                 // in the past, but is now trying to run unpruned.
                 if (fHavePruned && !fPruneMode) {
@@ -1838,11 +2078,18 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                     }
                 }
 
+                int64_t nVerifyStart = GetTimeMillis();
                 if (!CVerifyDB().VerifyDB(chainparams, pcoinsdbview, GetArg("-checklevel", DEFAULT_CHECKLEVEL),
                               GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) {
                     strLoadError = _("Corrupted block database detected");
                     break;
                 }
+                phaseTimes.Add("verify blocks", nVerifyStart);
+
+                if (!StartTxIndex(chainparams)) {
+                    strLoadError = _("Error loading the transaction index");
+                    break;
+                }
             } catch (const std::exception& e) {
                 if (fDebug) LogPrintf("%s\n", e.what());
                 strLoadError = _("Error opening block database");
@@ -1881,6 +2128,11 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         return false;
     }
     LogPrintf(" block index %15dms\n", GetTimeMillis() - nStart);
+    phaseTimes.Add("block index", nStart);
+
+    // a reindex chosen while loading the chain drops the cache files in Step 10c
+    if (futureCacheFiles.valid() && !fReindex)
+        futureGovernanceCache = std::async(std::launch::async, LoadGovernanceCache, futureCacheFiles, std::ref(phaseTimes));
 
     boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
     CAutoFile est_filein(fopen(est_path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
@@ -1891,8 +2143,10 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     // ********************************************************* Step 8: load wallet
 #ifdef ENABLE_WALLET
+    int64_t nWalletStart = GetTimeMillis();
     if (!CWallet::InitLoadWallet())
         return false;
+    phaseTimes.Add("wallet", nWalletStart);
 #else
     LogPrintf("No wallet support compiled in!\n");
 #endif
@@ -1975,67 +2229,50 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     CPrivateSend::InitStandardDenominations();
 
-    // ********************************************************* Step 10b: setup InstaEPM
-
-    fEnableInstantSend = GetBoolArg("-enableinstantsend", 1);
-
     // ********************************************************* Step 10c: Load cache data
 
     // LOAD SERIALIZED DAT FILES INTO DATA CACHES FOR INTERNAL USE
 
-    bool fIgnoreCacheFiles = fLiteMode || fReindex || fReindexChainState;
-    if (!fIgnoreCacheFiles) {
-        boost::filesystem::path pathDB = GetDataDir();
-        std::string strDBName;
-
-        strDBName = "mncache.dat";
+    if (futureCacheFiles.valid()) {
+        int64_t nWaitStart = GetTimeMillis();
         uiInterface.InitMessage(_("Loading masternode cache..."));
-        CFlatDB<CMasternodeMetaMan> flatdb1(strDBName, "magicMasternodeCache");
-        if(!flatdb1.Load(mmetaman)) {
-            return InitError(_("Failed to load masternode cache from") + "\n" + (pathDB / strDBName).string());
-        }
-
-        strDBName = "governance.dat";
-        CFlatDB<CGovernanceManager> flatdb3(strDBName, "magicGovernanceCache");
-        if(!flatdb3.Load(governance)) {
-            return InitError(_("Failed to load cache from") + "\n" + (pathDB / strDBName).string());
+        std::string strFailedFile = futureCacheFiles.get();
+        if (strFailedFile.empty() && futureGovernanceCache.valid())
+            strFailedFile = futureGovernanceCache.get();
+        phaseTimes.Add("waiting for cache files", nWaitStart);
+        if (!strFailedFile.empty()) {
+            return InitError(CacheLoadErrorMessage(strFailedFile) + "\n" + (GetDataDir() / strFailedFile).string());
         }
-        governance.InitOnLoad();
-
-        strDBName = "netfulfilled.dat";
-        uiInterface.InitMessage(_("Loading fulfilled requests cache..."));
-        CFlatDB<CNetFulfilledRequestManager> flatdb4(strDBName, "magicFulfilledCache");
-        if(!flatdb4.Load(netfulfilledman)) {
-            return InitError(_("Failed to load fulfilled requests cache from") + "\n" + (pathDB / strDBName).string());
-        }
-
-        if(fEnableInstantSend)
-        {
-            strDBName = "instantsend.dat";
-            uiInterface.InitMessage(_("Loading InstaEPM data cache..."));
-            CFlatDB<CInstantSend> flatdb5(strDBName, "magicInstaEPMCache");
-            if(!flatdb5.Load(instantsend)) {
-                return InitError(_("Failed to load InstantSend data cache from") + "\n" + (pathDB / strDBName).string());
-            }
+        if (fReindex) {
+            // the block database is rebuilt after all, start over like -reindex does
+            mmetaman.Clear();
+            netfulfilledman.Clear();
+            masternodeSync.Clear();
+            instantsend.Clear();
         }
     }
 
     // ********************************************************* Step 10d: schedule EPMCoin-specific tasks
 
     if (!fLiteMode) {
-        scheduler.scheduleEvery(boost::bind(&CNetFulfilledRequestManager::DoMaintenance, boost::ref(netfulfilledman)), 60 * 1000);
-        scheduler.scheduleEvery(boost::bind(&CMasternodeSync::DoMaintenance, boost::ref(masternodeSync), boost::ref(*g_connman)), 1 * 1000);
-        scheduler.scheduleEvery(boost::bind(&CMasternodeUtils::DoMaintenance, boost::ref(*g_connman)), 1 * 1000);
+        scheduler.scheduleEvery(boost::bind(&CNetFulfilledRequestManager::DoMaintenance, boost::ref(netfulfilledman)), 60 * 1000, "netfulfilled");
+        scheduler.scheduleEvery(boost::bind(&CMasternodeSync::DoMaintenance, boost::ref(masternodeSync), boost::ref(*g_connman)), 1 * 1000, "mnsync");
+        scheduler.scheduleEvery(boost::bind(&CMasternodeUtils::DoMaintenance, boost::ref(*g_connman)), 1 * 1000, "mnutils");
 
-        scheduler.scheduleEvery(boost::bind(&CGovernanceManager::DoMaintenance, boost::ref(governance), boost::ref(*g_connman)), 60 * 5 * 1000);
+        scheduler.scheduleEvery(boost::bind(&CGovernanceManager::DoMaintenance, boost::ref(governance), boost::ref(*g_connman)), 60 * 5 * 1000, "governance");
 
-        scheduler.scheduleEvery(boost::bind(&CInstantSend::DoMaintenance, boost::ref(instantsend)), 60 * 1000);
+        scheduler.scheduleEvery(boost::bind(&CInstantSend::DoMaintenance, boost::ref(instantsend)), 60 * 1000, "instantsend");
+
+        // so a crash loses at most this much of the caches, they are written on shutdown anyway
+        int64_t nCacheDumpInterval = GetArg("-cachedumpinterval", DEFAULT_CACHE_DUMP_INTERVAL);
+        if (nCacheDumpInterval > 0)
+            scheduler.scheduleEvery(DumpCaches, nCacheDumpInterval * 1000, "dumpcaches");
 
         if (fMasternodeMode)
-            scheduler.scheduleEvery(boost::bind(&CPrivateSendServer::DoMaintenance, boost::ref(privateSendServer), boost::ref(*g_connman)), 1 * 1000);
+            scheduler.scheduleEvery(boost::bind(&CPrivateSendServer::DoMaintenance, boost::ref(privateSendServer), boost::ref(*g_connman)), 1 * 1000, "privatesend");
 #ifdef ENABLE_WALLET
         else
-            scheduler.scheduleEvery(boost::bind(&CPrivateSendClientManager::DoMaintenance, boost::ref(privateSendClient), boost::ref(*g_connman)), 1 * 1000);
+            scheduler.scheduleEvery(boost::bind(&CPrivateSendClientManager::DoMaintenance, boost::ref(privateSendClient), boost::ref(*g_connman)), 1 * 1000, "privatesend");
 #endif // ENABLE_WALLET
     }
 
@@ -2075,6 +2312,18 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         uiInterface.NotifyBlockTip.disconnect(BlockNotifyGenesisWait);
     }
 
+    // Build -addressindex/-spentindex in the background when they got switched on for an existing block database
+    bool fBuildAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) && !fAddressIndex;
+    bool fBuildSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) && !fSpentIndex;
+    if (fBuildAddressIndex || fBuildSpentIndex) {
+        if (fPruneMode || fHavePruned) {
+            InitWarning(_("The address and spent indexes can't be built on a pruned node, use -reindex to build them."));
+        } else {
+            threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "idxbuild",
+                                                  boost::function<void()>(boost::bind(&ThreadBuildIndexes, fBuildAddressIndex, fBuildSpentIndex))));
+        }
+    }
+
     // ********************************************************* Step 12: start node
 
     //// debug print
@@ -2103,6 +2352,8 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     connOptions.nMaxOutboundTimeframe = nMaxOutboundTimeframe;
     connOptions.nMaxOutboundLimit = nMaxOutboundLimit;
+    connOptions.socketEventsMode = socketEventsMode;
+    connOptions.nMsgProcThreads = std::max(0, std::min((int)GetArg("-msgprocthreads", DEFAULT_MSGPROC_THREADS), MAX_MSGPROC_THREADS));
 
     if (!connman.Start(scheduler, strNodeError, connOptions))
         return InitError(strNodeError);
@@ -2111,6 +2362,8 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     SetRPCWarmupFinished();
     uiInterface.InitMessage(_("Done loading"));
+    phaseTimes.Add("total", nInitStart);
+    phaseTimes.Log();
 
 #ifdef ENABLE_WALLET
     if (pwalletMain)
@@ -59,7 +59,7 @@ const std::string CInstantSend::SERIALIZATION_VERSION_STRING = "CInstaEPM-Versio
 void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
 {
     if (fLiteMode) return; // disable all EPMCoin specific functionality
-    if (!llmq::IsOldInstantSendEnabled()) return;
+    if (fRetired || !llmq::IsOldInstantSendEnabled()) return;
 
     // NOTE: NetMsgType::TXLOCKREQUEST is handled via ProcessMessage() in net_processing.cpp
 
@@ -99,6 +99,8 @@ void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, C
 
 bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CConnman& connman)
 {
+    if (fRetired) return false;
+
     LOCK(cs_main);
 #ifdef ENABLE_WALLET
     LOCK(pwalletMain ? &pwalletMain->cs_wallet : NULL);
@@ -541,7 +543,7 @@ void CInstantSend::UpdateLockedTransaction(const CTxLockCandidate& txLockCandida
     }
 #endif
 
-    GetMainSignals().NotifyTransactionLock(*txLockCandidate.txLockRequest.tx);
+    GetMainSignals().NotifyTransactionLock(txLockCandidate.txLockRequest.tx);
 
     LogPrint("instantsend", "CInstantSend::UpdateLockedTransaction -- done, txid=%s\n", txHash.ToString());
 }
@@ -565,6 +567,7 @@ void CInstantSend::LockTransactionInputs(const CTxLockCandidate& txLockCandidate
 bool CInstantSend::GetLockedOutPointTxHash(const COutPoint& outpoint, uint256& hashRet)
 {
     LOCK(cs_instantsend);
+    if (fRetired) return false;
     std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(outpoint);
     if (it == mapLockedOutpoints.end()) return false;
     hashRet = it->second;
@@ -741,7 +744,7 @@ void CInstantSend::CheckAndRemove()
 
 bool CInstantSend::AlreadyHave(const uint256& hash)
 {
-    if (!llmq::IsOldInstantSendEnabled()) {
+    if (fRetired || !llmq::IsOldInstantSendEnabled()) {
         return true;
     }
 
@@ -771,7 +774,7 @@ bool CInstantSend::HasTxLockRequest(const uint256& txHash)
 
 bool CInstantSend::GetTxLockRequest(const uint256& txHash, CTxLockRequest& txLockRequestRet)
 {
-    if (!llmq::IsOldInstantSendEnabled()) {
+    if (fRetired || !llmq::IsOldInstantSendEnabled()) {
         return false;
     }
 
@@ -786,7 +789,7 @@ bool CInstantSend::GetTxLockRequest(const uint256& txHash, CTxLockRequest& txLoc
 
 bool CInstantSend::GetTxLockVote(const uint256& hash, CTxLockVote& txLockVoteRet)
 {
-    if (!llmq::IsOldInstantSendEnabled()) {
+    if (fRetired || !llmq::IsOldInstantSendEnabled()) {
         return false;
     }
 
@@ -816,7 +819,7 @@ void CInstantSend::Clear()
 
 bool CInstantSend::IsLockedInstantSendTransaction(const uint256& txHash)
 {
-    if (!fEnableInstantSend || GetfLargeWorkForkFound() || GetfLargeWorkInvalidChainFound() ||
+    if (fRetired || !fEnableInstantSend || GetfLargeWorkForkFound() || GetfLargeWorkInvalidChainFound() ||
         !sporkManager.IsSporkActive(SPORK_3_INSTANTSEND_BLOCK_FILTERING)) return false;
 
     LOCK(cs_instantsend);
@@ -855,7 +858,7 @@ int CInstantSend::GetTransactionLockSignatures(const uint256& txHash)
 
 bool CInstantSend::IsTxLockCandidateTimedOut(const uint256& txHash)
 {
-    if (!fEnableInstantSend) return false;
+    if (fRetired || !fEnableInstantSend) return false;
 
     LOCK(cs_instantsend);
 
@@ -880,15 +883,30 @@ void CInstantSend::Relay(const uint256& txHash, CConnman& connman)
 
 void CInstantSend::UpdatedBlockTip(const CBlockIndex *pindex)
 {
+    UpdateRetiredState();
     nCachedBlockHeight = pindex->nHeight;
 }
 
+void CInstantSend::UpdateRetiredState()
+{
+    bool fRetire = !llmq::IsOldInstantSendEnabled();
+    if (fRetire && !fRetired) {
+        LogPrintf("CInstantSend::%s -- legacy InstantSend is not enabled anymore, retiring it\n", __func__);
+        int nHeight = nCachedBlockHeight;
+        Clear();
+        nCachedBlockHeight = nHeight;
+    } else if (!fRetire && fRetired) {
+        LogPrintf("CInstantSend::%s -- legacy InstantSend is enabled again\n", __func__);
+    }
+    fRetired = fRetire;
+}
+
 void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock)
 {
     // Update lock candidates and votes if corresponding tx confirmed
     // or went from confirmed to 0-confirmed or conflicted.
 
-    if (tx.IsCoinBase()) return;
+    if (tx.IsCoinBase() || fRetired) return;
 
     LOCK2(cs_main, cs_instantsend);
 
@@ -940,6 +958,10 @@ void CInstantSend::DoMaintenance()
 {
     if (ShutdownRequested()) return;
 
+    // sporks might have changed since the last block
+    UpdateRetiredState();
+    if (fRetired) return;
+
     CheckAndRemove();
 }
 
@@ -56,6 +56,10 @@ private:
     // Keep track of current block height
     int nCachedBlockHeight;
 
+    /// Set while legacy InstantSend is not enabled (e.g. because LLMQ based InstantSend took over). All legacy
+    /// processing is skipped then and the maps below are kept empty
+    std::atomic<bool> fRetired{false};
+
     // maps for AlreadyHave
     std::map<uint256, CTxLockRequest> mapLockRequestAccepted; ///< Tx hash - Tx
     std::map<uint256, CTxLockRequest> mapLockRequestRejected; ///< Tx hash - Tx
@@ -95,6 +99,9 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
+        // also dumped from the scheduler while running
+        LOCK(cs_instantsend);
+
         std::string strVersion;
         if(ser_action.ForRead()) {
             READWRITE(strVersion);
@@ -156,6 +163,10 @@ public:
 
     void DoMaintenance();
 
+    /// Retires or revives the legacy engine depending on the sporks
+    void UpdateRetiredState();
+    bool IsRetired() const { return fRetired; }
+
     /// checks if we can automatically lock "simple" transactions
     static bool CanAutoLock();
 
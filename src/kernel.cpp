@@ -17,6 +17,15 @@
 #include <init.h>
 #include <txdb.h>
 #include <utiltime.h>
+#include <saltedhasher.h>
+#include <undo.h>
+#include <unordered_lru_cache.h>
+#include <ctpl.h>
+#include <crypto/common.h>
+#include <hash.h>
+
+#include <atomic>
+#include <future>
 
 #include <numeric>
 
@@ -50,6 +59,8 @@ static bool GetLastStakeModifier(const CBlockIndex* pindex, uint64_t& nStakeModi
 {
     if (!pindex)
         return error("GetLastStakeModifier: null pindex");
+    if (pindex->pstakeModifierLast)
+        pindex = pindex->pstakeModifierLast;
     while (pindex && pindex->pprev && !pindex->GeneratedStakeModifier())
         pindex = pindex->pprev;
     if (!pindex->GeneratedStakeModifier()) {
@@ -79,50 +90,70 @@ static int64_t GetStakeModifierSelectionInterval()
     return nSelectionInterval;
 }
 
+// A block which may contribute its entropy bit to the next stake modifier. The selection hash only depends
+// on the block and the previous stake modifier, so it's computed once instead of once per selection round.
+struct CStakeModifierCandidate
+{
+    int64_t nTime;
+    uint256 hashBlock;
+    const CBlockIndex* pindex;
+    arith_uint256 hashSelection;
+    bool fSelected;
+};
+
+static void InitStakeModifierCandidate(CStakeModifierCandidate& candidate, const CBlockIndex* pindex, uint64_t nStakeModifierPrev)
+{
+    candidate.nTime = pindex->GetBlockTime();
+    candidate.hashBlock = pindex->GetBlockHash();
+    candidate.pindex = pindex;
+    candidate.fSelected = false;
+
+    // compute the selection hash by hashing its proof-hash and the
+    // previous proof-of-stake modifier
+    uint256 hashProof = pindex->IsProofOfStake()? pindex->hashProofOfStake : pindex->GetBlockHash();
+    CDataStream ss(SER_GETHASH, 0);
+    ss << hashProof << nStakeModifierPrev;
+    candidate.hashSelection = UintToArith256(Hash(ss.begin(), ss.end()));
+    // the selection hash is divided by 2**32 so that proof-of-stake block
+    // is always favored over proof-of-work block. this is to preserve
+    // the energy efficiency property
+    if (pindex->IsProofOfStake())
+        candidate.hashSelection >>= 32;
+}
+
 // select a block from the candidate blocks in vSortedByTimestamp, excluding
-// already selected blocks in vSelectedBlocks, and with timestamp up to
-// nSelectionIntervalStop.
+// already selected blocks, and with timestamp up to nSelectionIntervalStop.
 static bool SelectBlockFromCandidates(
-        vector<pair<int64_t, uint256> >& vSortedByTimestamp,
-        map<uint256, const CBlockIndex*>& mapSelectedBlocks,
-        int64_t nSelectionIntervalStop, uint64_t nStakeModifierPrev,
+        vector<CStakeModifierCandidate>& vSortedByTimestamp,
+        int64_t nSelectionIntervalStop,
         const CBlockIndex** pindexSelected)
 {
     bool fSelected = false;
     arith_uint256 hashBest = 0;
+    CStakeModifierCandidate* pcandidateBest = nullptr;
     *pindexSelected = nullptr;
-    for(const auto &item : vSortedByTimestamp)
+    for(auto &candidate : vSortedByTimestamp)
     {
-        if (!mapBlockIndex.count(item.second))
-            return error("SelectBlockFromCandidates: failed to find block index for candidate block %s", item.second.ToString().c_str());
-        const CBlockIndex* pindex = mapBlockIndex[item.second];
-        if (fSelected && pindex->GetBlockTime() > nSelectionIntervalStop)
+        if (fSelected && candidate.nTime > nSelectionIntervalStop)
             break;
-        if (mapSelectedBlocks.count(pindex->GetBlockHash()) > 0)
+        if (candidate.fSelected)
             continue;
-        // compute the selection hash by hashing its proof-hash and the
-        // previous proof-of-stake modifier
-        uint256 hashProof = pindex->IsProofOfStake()? pindex->hashProofOfStake : pindex->GetBlockHash();
-        CDataStream ss(SER_GETHASH, 0);
-        ss << hashProof << nStakeModifierPrev;
-        arith_uint256 hashSelection = UintToArith256(Hash(ss.begin(), ss.end()));
-        // the selection hash is divided by 2**32 so that proof-of-stake block
-        // is always favored over proof-of-work block. this is to preserve
-        // the energy efficiency property
-        if (pindex->IsProofOfStake())
-            hashSelection >>= 32;
-        if (fSelected && hashSelection < hashBest)
+        if (fSelected && candidate.hashSelection < hashBest)
         {
-            hashBest = hashSelection;
-            *pindexSelected = (const CBlockIndex*) pindex;
+            hashBest = candidate.hashSelection;
+            pcandidateBest = &candidate;
         }
         else if (!fSelected)
         {
             fSelected = true;
-            hashBest = hashSelection;
-            *pindexSelected = (const CBlockIndex*) pindex;
+            hashBest = candidate.hashSelection;
+            pcandidateBest = &candidate;
         }
     }
+    if (fSelected) {
+        pcandidateBest->fSelected = true;
+        *pindexSelected = pcandidateBest->pindex;
+    }
     if (GetBoolArg("-printstakemodifier", false))
         LogPrintf("%s : selection hash=%s\n", __func__, hashBest.ToString().c_str());
     return fSelected;
@@ -162,36 +193,43 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexCurrent, uint64_t &nStake
     if (nModifierTime / params.nModifierInterval >= pindexPrev->GetBlockTime() / params.nModifierInterval)
         return true;
 
-    // Sort candidate blocks by timestamp
-    vector<pair<int64_t, uint256> > vSortedByTimestamp;
+    // Sort candidate blocks by timestamp (and block hash for equal timestamps)
+    vector<CStakeModifierCandidate> vSortedByTimestamp;
     vSortedByTimestamp.reserve(64 * params.nModifierInterval / params.nPosTargetSpacing);
     int64_t nSelectionInterval = GetStakeModifierSelectionInterval();
     int64_t nSelectionIntervalStart = (pindexPrev->GetBlockTime() / params.nModifierInterval) * params.nModifierInterval - nSelectionInterval;
     const CBlockIndex* pindex = pindexPrev;
     while (pindex && pindex->GetBlockTime() >= nSelectionIntervalStart)
     {
-        vSortedByTimestamp.push_back(make_pair(pindex->GetBlockTime(), pindex->GetBlockHash()));
+        vSortedByTimestamp.emplace_back();
+        InitStakeModifierCandidate(vSortedByTimestamp.back(), pindex, nStakeModifier);
         pindex = pindex->pprev;
     }
     int nHeightFirstCandidate = pindex ? (pindex->nHeight + 1) : 0;
+    // block times are mostly ascending with height, so the reversed walk is almost sorted already
     reverse(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
-    sort(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
+    sort(vSortedByTimestamp.begin(), vSortedByTimestamp.end(), [](const CStakeModifierCandidate& a, const CStakeModifierCandidate& b) {
+        if (a.nTime != b.nTime)
+            return a.nTime < b.nTime;
+        return a.hashBlock < b.hashBlock;
+    });
 
     // Select 64 blocks from candidate blocks to generate stake modifier
     uint64_t nStakeModifierNew = 0;
     int64_t nSelectionIntervalStop = nSelectionIntervalStart;
-    map<uint256, const CBlockIndex*> mapSelectedBlocks;
+    vector<const CBlockIndex*> vSelectedBlocks;
+    vSelectedBlocks.reserve(64);
     for (int nRound=0; nRound<min(64, (int)vSortedByTimestamp.size()); nRound++)
     {
         // add an interval section to the current selection round
         nSelectionIntervalStop += GetStakeModifierSelectionIntervalSection(nRound);
         // select a block from the candidates of current round
-        if (!SelectBlockFromCandidates(vSortedByTimestamp, mapSelectedBlocks, nSelectionIntervalStop, nStakeModifier, &pindex))
+        if (!SelectBlockFromCandidates(vSortedByTimestamp, nSelectionIntervalStop, &pindex))
             return error("ComputeNextStakeModifier: unable to select block at round %d", nRound);
         // write the entropy bit of the selected block
         nStakeModifierNew |= (((uint64_t)pindex->GetStakeEntropyBit()) << nRound);
         // add the selected block from candidates to selected list
-        mapSelectedBlocks.insert(make_pair(pindex->GetBlockHash(), pindex));
+        vSelectedBlocks.push_back(pindex);
         if (GetBoolArg("-printstakemodifier", false))
             LogPrintf("%s : selected round %d stop=%s height=%d bit=%d\n", __func__, nRound, DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nSelectionIntervalStop).c_str(), pindex->nHeight, pindex->GetStakeEntropyBit());
     }
@@ -210,11 +248,11 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexCurrent, uint64_t &nStake
                 strSelectionMap.replace(pindex->nHeight - nHeightFirstCandidate, 1, "=");
             pindex = pindex->pprev;
         }
-        for (const auto& item : mapSelectedBlocks)
+        for (const CBlockIndex* pindexSelected : vSelectedBlocks)
         {
             // 'S' indicates selected proof-of-stake blocks
             // 'W' indicates selected proof-of-work blocks
-            strSelectionMap.replace(item.second->nHeight - nHeightFirstCandidate, 1, item.second->IsProofOfStake()? "S" : "W");
+            strSelectionMap.replace(pindexSelected->nHeight - nHeightFirstCandidate, 1, pindexSelected->IsProofOfStake()? "S" : "W");
         }
         LogPrintf("ComputeNextStakeModifier: selection height [%d, %d] map %s\n", nHeightFirstCandidate, pindexPrev->nHeight, strSelectionMap);
     }
@@ -224,7 +262,21 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexCurrent, uint64_t &nStake
     return true;
 }
 
-static bool GetKernelStakeModifier(CBlockIndex* pindexPrev, uint256 hashBlockFrom, unsigned int nTimeTx, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake)
+// Resolved kernel stake modifiers, keyed by the hash of the block the staked coins come from.
+// The result of GetKernelStakeModifier only depends on that block, pindexPrev and the active chain,
+// so the cache is bound to the (pindexPrev, chainActive.Tip()) pair it was filled for and is dropped
+// as soon as either of them changes. Protected by cs_main (all callers hold it).
+struct CStakeModifierCacheEntry
+{
+    uint64_t nStakeModifier;
+    int nStakeModifierHeight;
+    int64_t nStakeModifierTime;
+};
+static const CBlockIndex* pindexStakeModifierCachePrev = nullptr;
+static const CBlockIndex* pindexStakeModifierCacheTip = nullptr;
+static unordered_lru_cache<uint256, CStakeModifierCacheEntry, StaticSaltedHasher, 10000> stakeModifierCache;
+
+static bool GetKernelStakeModifierUncached(CBlockIndex* pindexPrev, const uint256& hashBlockFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake)
 {
 	const Consensus::Params& params = Params().GetConsensus();
     nStakeModifier = 0;
@@ -277,52 +329,188 @@ static bool GetKernelStakeModifier(CBlockIndex* pindexPrev, uint256 hashBlockFro
     return true;
 }
 
-bool CheckStakeKernelHash(unsigned int nBits, CBlockIndex* pindexPrev, const CBlockHeader& blockFrom, unsigned int nTxPrevOffset, const CTransactionRef& txPrev, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake, bool fMinting, bool fValidate)
+static bool GetKernelStakeModifier(CBlockIndex* pindexPrev, const uint256& hashBlockFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake)
 {
-    auto txPrevTime = blockFrom.GetBlockTime();
-    if (nTimeTx < txPrevTime)  // Transaction timestamp violation
-        return error("CheckStakeKernelHash() : nTime violation");
+    AssertLockHeld(cs_main);
 
-    auto nStakeMinAge = Params().GetConsensus().nStakeMinAge;
-    auto nStakeMaxAge = Params().GetConsensus().nStakeMaxAge;
-    unsigned int nTimeBlockFrom = blockFrom.GetBlockTime();
-    if (nTimeBlockFrom + nStakeMinAge > nTimeTx) // Min age requirement
-        return error("CheckStakeKernelHash() : min age violation");
+    if (pindexStakeModifierCachePrev != pindexPrev || pindexStakeModifierCacheTip != chainActive.Tip()) {
+        stakeModifierCache.clear();
+        pindexStakeModifierCachePrev = pindexPrev;
+        pindexStakeModifierCacheTip = chainActive.Tip();
+    }
 
-    arith_uint256 bnTargetPerCoinDay;
-    bnTargetPerCoinDay.SetCompact(nBits);
-    CAmount nValueIn = txPrev->vout[prevout.n].nValue;
+    CStakeModifierCacheEntry entry;
+    if (stakeModifierCache.get(hashBlockFrom, entry)) {
+        nStakeModifier = entry.nStakeModifier;
+        nStakeModifierHeight = entry.nStakeModifierHeight;
+        nStakeModifierTime = entry.nStakeModifierTime;
+        return true;
+    }
+
+    // only successful lookups are cached, failures may resolve once more blocks arrive
+    if (!GetKernelStakeModifierUncached(pindexPrev, hashBlockFrom, nStakeModifier, nStakeModifierHeight, nStakeModifierTime, fPrintProofOfStake))
+        return false;
+
+    stakeModifierCache.insert(hashBlockFrom, {nStakeModifier, nStakeModifierHeight, nStakeModifierTime});
+    return true;
+}
 
+bool CStakeKernel::Init(unsigned int nBits, CBlockIndex* pindexPrev, const CBlockHeader& blockFrom, unsigned int nTxPrevOffset, CAmount nValueIn, const COutPoint& prevout)
+{
     // discard stakes generated from inputs of less than 10000 EPM
     if (nValueIn < Params().GetConsensus().nMinimumStakeValue)
         return error("CheckStakeKernelHash() : min amount violation");
 
+    uint64_t nStakeModifier = 0;
+    int nStakeModifierHeight = 0;
+    int64_t nStakeModifierTime = 0;
+
+    if (!GetKernelStakeModifier(pindexPrev, blockFrom.GetHash(), nStakeModifier, nStakeModifierHeight, nStakeModifierTime, false))
+        return false;
+
+    SetKernel(nStakeModifier, nBits, blockFrom.GetBlockTime(), nTxPrevOffset, nValueIn, prevout);
+    return true;
+}
+
+void CStakeKernel::SetKernel(uint64_t nStakeModifier, unsigned int nBits, int64_t txPrevTime, unsigned int nTxPrevOffset, CAmount nValueInIn, const COutPoint& prevout)
+{
+    bnTargetPerCoinDay.SetCompact(nBits);
+    nValueIn = nValueInIn;
+    nTimeBlockFrom = txPrevTime;
+
+    // same layout as serializing the fields into a CDataStream
+    WriteLE64(preimage, nStakeModifier);
+    WriteLE32(preimage + 8, nTimeBlockFrom);
+    WriteLE32(preimage + 12, nTxPrevOffset);
+    WriteLE64(preimage + 16, (uint64_t)txPrevTime);
+    WriteLE32(preimage + 24, prevout.n);
+    WriteLE32(preimage + 28, 0);
+}
+
+bool CStakeKernel::CheckTime(unsigned int nTimeTx, uint256& hashProofOfStake) const
+{
+    auto nStakeMinAge = Params().GetConsensus().nStakeMinAge;
+    auto nStakeMaxAge = Params().GetConsensus().nStakeMaxAge;
+    if (nTimeTx < nTimeBlockFrom || nTimeBlockFrom + nStakeMinAge > nTimeTx)
+        return false;
+
     // v0.3 protocol kernel hash weight starts from 0 at the 30-day min age
     // this change increases active coins participating the hash and helps
     // to secure the network when proof-of-stake difficulty is low
-    int64_t nTimeWeight = std::min<int64_t>(nTimeTx - txPrevTime, nStakeMaxAge - nStakeMinAge);
+    int64_t nTimeWeight = std::min<int64_t>((int64_t)nTimeTx - nTimeBlockFrom, nStakeMaxAge - nStakeMinAge);
     arith_uint256 bnCoinDayWeight = nValueIn * nTimeWeight / COIN / 200;
 
-    // Calculate hash
-    CDataStream ss(SER_GETHASH, 0);
-    uint64_t nStakeModifier = 0;
-    int nStakeModifierHeight = 0;
-    int64_t nStakeModifierTime = 0;
+    unsigned char buf[PREIMAGE_SIZE];
+    memcpy(buf, preimage, PREIMAGE_SIZE);
+    WriteLE32(buf + 28, nTimeTx);
+    CHash256().Write(buf, PREIMAGE_SIZE).Finalize(hashProofOfStake.begin());
+
+    // Now check if proof-of-stake hash meets target protocol
+    return UintToArith256(hashProofOfStake) <= bnCoinDayWeight * bnTargetPerCoinDay;
+}
+
+bool CStakeKernel::FindTime(unsigned int nTimeTx, unsigned int nCount, unsigned int nTimeMin, unsigned int& nTimeTxRet, uint256& hashProofOfStake) const
+{
+    for (unsigned int i = 0; i < nCount && nTimeTx - i > nTimeMin; i++) {
+        if (CheckTime(nTimeTx - i, hashProofOfStake)) {
+            nTimeTxRet = nTimeTx - i;
+            return true;
+        }
+    }
+    return false;
+}
 
-    if (!GetKernelStakeModifier(pindexPrev, blockFrom.GetHash(), nTimeTx, nStakeModifier, nStakeModifierHeight, nStakeModifierTime, false))
+static CCriticalSection cs_stakeSearchWorkers;
+static std::unique_ptr<ctpl::thread_pool> stakeSearchWorkers;
+
+static ctpl::thread_pool& GetStakeSearchWorkers()
+{
+    LOCK(cs_stakeSearchWorkers);
+    if (!stakeSearchWorkers) {
+        int nThreads = GetArg("-stakesearchthreads", DEFAULT_STAKE_SEARCH_THREADS);
+        if (nThreads <= 0) {
+            nThreads = std::max(GetNumCores() / 2, 1);
+        }
+        stakeSearchWorkers.reset(new ctpl::thread_pool(nThreads));
+        RenameThreadPool(*stakeSearchWorkers, "epmcoin-stake");
+        LogPrintf("%s: started %d stake search threads\n", __func__, nThreads);
+    }
+    return *stakeSearchWorkers;
+}
+
+void StopStakeSearchWorkers()
+{
+    LOCK(cs_stakeSearchWorkers);
+    if (stakeSearchWorkers) {
+        stakeSearchWorkers->clear_queue();
+        stakeSearchWorkers->stop(true);
+        stakeSearchWorkers.reset();
+    }
+}
+
+bool FindStakeKernel(const std::vector<CStakeKernel>& vKernels, unsigned int nTimeTx, unsigned int nCount, unsigned int nTimeMin, size_t& nKernelRet, unsigned int& nTimeTxRet, uint256& hashProofOfStake)
+{
+    if (vKernels.size() < STAKE_SEARCH_BATCH_SIZE) {
+        for (size_t i = 0; i < vKernels.size(); i++) {
+            if (vKernels[i].FindTime(nTimeTx, nCount, nTimeMin, nTimeTxRet, hashProofOfStake)) {
+                nKernelRet = i;
+                return true;
+            }
+        }
         return false;
+    }
 
-    ss << nStakeModifier;
-    ss << nTimeBlockFrom << nTxPrevOffset << txPrevTime << prevout.n << nTimeTx;
-    hashProofOfStake = Hash(ss.begin(), ss.end());
+    // Each batch stops at the first hit, and batches which only contain kernels ordered after an
+    // already found one are skipped. The result is the same as searching the kernels one by one.
+    std::atomic<size_t> nFirstFound{vKernels.size()};
+    std::vector<std::pair<unsigned int, uint256>> vResults(vKernels.size());
+    std::vector<std::future<void>> futures;
+    futures.reserve(vKernels.size() / STAKE_SEARCH_BATCH_SIZE + 1);
+
+    auto& workers = GetStakeSearchWorkers();
+    for (size_t start = 0; start < vKernels.size(); start += STAKE_SEARCH_BATCH_SIZE) {
+        size_t end = std::min(start + STAKE_SEARCH_BATCH_SIZE, vKernels.size());
+        futures.emplace_back(workers.push([&, start, end](int threadId) {
+            for (size_t i = start; i < end && i < nFirstFound; i++) {
+                if (vKernels[i].FindTime(nTimeTx, nCount, nTimeMin, vResults[i].first, vResults[i].second)) {
+                    size_t nPrev = nFirstFound;
+                    while (i < nPrev && !nFirstFound.compare_exchange_weak(nPrev, i));
+                    return;
+                }
+            }
+        }));
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
 
-    // Now check if proof-of-stake hash meets target protocol
-    if (UintToArith256(hashProofOfStake) > bnCoinDayWeight * bnTargetPerCoinDay)
+    if (nFirstFound == vKernels.size())
         return false;
 
+    nKernelRet = nFirstFound;
+    nTimeTxRet = vResults[nKernelRet].first;
+    hashProofOfStake = vResults[nKernelRet].second;
     return true;
 }
 
+bool CheckStakeKernelHash(unsigned int nBits, CBlockIndex* pindexPrev, const CBlockHeader& blockFrom, unsigned int nTxPrevOffset, CAmount nValueIn, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake, bool fMinting, bool fValidate)
+{
+    auto txPrevTime = blockFrom.GetBlockTime();
+    if (nTimeTx < txPrevTime)  // Transaction timestamp violation
+        return error("CheckStakeKernelHash() : nTime violation");
+
+    auto nStakeMinAge = Params().GetConsensus().nStakeMinAge;
+    unsigned int nTimeBlockFrom = blockFrom.GetBlockTime();
+    if (nTimeBlockFrom + nStakeMinAge > nTimeTx) // Min age requirement
+        return error("CheckStakeKernelHash() : min age violation");
+
+    CStakeKernel kernel;
+    if (!kernel.Init(nBits, pindexPrev, blockFrom, nTxPrevOffset, nValueIn, prevout))
+        return false;
+
+    return kernel.CheckTime(nTimeTx, hashProofOfStake);
+}
+
 bool CheckKernelScript(CScript scriptVin, CScript scriptVout)
 {
     auto extractKeyID = [](CScript scriptPubKey) {
@@ -349,6 +537,99 @@ bool CheckKernelScript(CScript scriptVin, CScript scriptVout)
     return extractKeyID(scriptVin) == extractKeyID(scriptVout);
 }
 
+// Find the coin spent by prevout in the active chain above pindexFork, from the undo data of the blocks.
+// Block and undo files within MIN_BLOCKS_TO_KEEP of the tip are never pruned, and forks deeper than that
+// can't be reorganized to anyway, so this works without a txindex and on pruned nodes.
+static bool FindSpentKernelCoin(const COutPoint& prevout, const CBlockIndex* pindexFork, Coin& coinRet)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    for (const CBlockIndex* pindex = chainActive.Tip(); pindex && pindex != pindexFork; pindex = pindex->pprev) {
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA) || !(pindex->nStatus & BLOCK_HAVE_UNDO))
+            return error("GetKernelSource() : block %s is pruned", pindex->GetBlockHash().ToString());
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, params))
+            return false;
+        CBlockUndo blockundo;
+        CDiskBlockPos pos = pindex->GetUndoPos();
+        if (pos.IsNull() || !UndoReadFromDisk(blockundo, pos, pindex->pprev->GetBlockHash()))
+            return error("GetKernelSource() : no undo data for block %s", pindex->GetBlockHash().ToString());
+        if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+            return error("GetKernelSource() : undo data of block %s doesn't match", pindex->GetBlockHash().ToString());
+
+        for (size_t i = 1; i < block.vtx.size(); i++) {
+            const CTransaction& tx = *block.vtx[i];
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                if (tx.vin[j].prevout != prevout)
+                    continue;
+                if (blockundo.vtxundo[i - 1].vprevout.size() != tx.vin.size())
+                    return error("GetKernelSource() : undo data of block %s doesn't match", pindex->GetBlockHash().ToString());
+                coinRet = blockundo.vtxundo[i - 1].vprevout[j];
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Find the transaction prevout.hash in the blocks of the branch from pindexPrev down to (excluding) pindexFork
+static bool FindKernelCoinInBranch(const COutPoint& prevout, const CBlockIndex* pindexPrev, const CBlockIndex* pindexFork, Coin& coinRet)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    for (const CBlockIndex* pindex = pindexPrev; pindex && pindex != pindexFork; pindex = pindex->pprev) {
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+            return error("GetKernelSource() : block %s is pruned", pindex->GetBlockHash().ToString());
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, params))
+            return false;
+        for (const auto& tx : block.vtx) {
+            if (tx->GetHash() != prevout.hash)
+                continue;
+            if (prevout.n >= tx->vout.size())
+                return error("GetKernelSource() : invalid kernel output index %u", prevout.n);
+            coinRet = Coin(tx->vout[prevout.n], pindex->nHeight, tx->IsCoinBase(), tx->IsCoinStake());
+            return true;
+        }
+    }
+    return false;
+}
+
+// Find the header of the block which contains the kernel input and the spent output itself.
+// The output is taken from the UTXO set (or, when validating a fork, from the undo data of the blocks
+// disconnected by it) and its header from the block index, so neither the txindex nor old block files
+// are needed and this works on pruned nodes. Only a kernel created on the fork itself means reading the
+// fork's blocks.
+static bool GetKernelSource(const COutPoint& prevout, const CBlockIndex* pindexPrev, CBlockHeader& headerRet, CTxOut& txOutRet)
+{
+    AssertLockHeld(cs_main);
+
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    if (!pindexTip)
+        return error("GetKernelSource() : no active chain");
+
+    // Everything at or below the fork point is shared by both chains
+    const CBlockIndex* pindexFork = chainActive.FindFork(pindexPrev);
+    if (!pindexFork)
+        return error("GetKernelSource() : block %s is not connected to the active chain", pindexPrev->GetBlockHash().ToString());
+
+    // A coin of the active chain is only a coin of the fork too if it was created below the fork point
+    Coin coin;
+    bool fFound = pcoinsTip->GetCoin(prevout, coin) && (int)coin.nHeight <= pindexFork->nHeight;
+    if (!fFound) {
+        fFound = (FindSpentKernelCoin(prevout, pindexFork, coin) && (int)coin.nHeight <= pindexFork->nHeight) ||
+                 FindKernelCoinInBranch(prevout, pindexPrev, pindexFork, coin);
+    }
+    if (!fFound || coin.IsSpent())
+        return error("CheckProofOfStake() : kernel %s not found", prevout.ToString());
+
+    const CBlockIndex* pindexFrom = pindexPrev->GetAncestor(coin.nHeight);
+    if (!pindexFrom)
+        return error("GetKernelSource() : block at height %d not found", coin.nHeight);
+    headerRet = pindexFrom->GetBlockHeader();
+    txOutRet = coin.out;
+    return true;
+}
+
 // Check kernel hash target and coinstake signature
 bool CheckProofOfStake(const CBlock &block, uint256& hashProofOfStake, CBlockIndex* pindexPrev)
 {
@@ -359,39 +640,15 @@ bool CheckProofOfStake(const CBlock &block, uint256& hashProofOfStake, CBlockInd
     // Kernel (input 0) must match the stake hash target per coin age (nBits)
     const CTxIn& txin = tx->vin[0];
 
-	// Transaction index is required to get to block header
-	if (!fTxIndex)
-		return error("CheckProofOfStake() : transaction index not available");
-
-	// Get transaction index for the previous transaction
-	CDiskTxPos postx;
-	if (!pblocktree->ReadTxIndex(txin.prevout.hash, postx))
-		return error("CheckProofOfStake() : tx index not found");  // tx index not found
-
-	// Read txPrev and header of its block
-	CBlockHeader header;
-	CTransactionRef txPrev;
-	{
-		CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-		try {
-			file >> header;
-			fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-			file >> txPrev;
-		}
-		catch (std::exception &e) {
-			return error("%s() : deserialize or I/O error in CheckProofOfStake()", __PRETTY_FUNCTION__);
-		}
-		if (txPrev->GetHash() != txin.prevout.hash)
-			return error("%s() : txid mismatch in CheckProofOfStake()", __PRETTY_FUNCTION__);
-    }
-
-	int nIn = 0;
-	const CTxOut& prevOut = txPrev->vout[tx->vin[nIn].prevout.n];
+    CBlockHeader header;
+    CTxOut prevOut;
+    if (!GetKernelSource(txin.prevout, pindexPrev, header, prevOut))
+        return false;
 
     if(!CheckKernelScript(prevOut.scriptPubKey, tx->vout[1].scriptPubKey))
         return error("CheckProofOfStake() : INFO: check kernel script failed on coinstake %s, hashProof=%s \n", tx->GetHash().ToString().c_str(), hashProofOfStake.ToString().c_str());
 
-    if (!CheckStakeKernelHash(block.nBits, pindexPrev, header, sizeof(CBlock), txPrev, txin.prevout, block.nTime, hashProofOfStake, false, true))
+    if (!CheckStakeKernelHash(block.nBits, pindexPrev, header, sizeof(CBlock), prevOut.nValue, txin.prevout, block.nTime, hashProofOfStake, false, true))
         return error("CheckProofOfStake() : INFO: check kernel failed on coinstake %s, hashProof=%s \n", tx->GetHash().ToString().c_str(), hashProofOfStake.ToString().c_str());
 
     return true;
@@ -8,6 +8,9 @@
 #include <streams.h>
 #include <arith_uint256.h>
 #include <primitives/transaction.h>
+#include <amount.h>
+
+#include <vector>
 
 class CBlock;
 class CWallet;
@@ -24,12 +27,51 @@ extern unsigned int getIntervalVersion(bool fTestNet);
 // ratio of group interval length between the last group and the first group
 static const int MODIFIER_INTERVAL_RATIO = 3;
 
+// Number of threads used to hash kernel time slots, 0 = half the available cores
+static const int DEFAULT_STAKE_SEARCH_THREADS = 0;
+// Kernel sets smaller than this are searched on the calling thread
+static const size_t STAKE_SEARCH_BATCH_SIZE = 64;
+
 // Compute the hash modifier for proof-of-stake
 bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeModifier, bool& fGeneratedStakeModifier);
 
 // Check whether stake kernel meets hash target
 // Sets hashProofOfStake on success return
-bool CheckStakeKernelHash(unsigned int nBits, CBlockIndex* pindexPrev, const CBlockHeader& blockFrom, unsigned int nTxPrevOffset, const CTransactionRef& txPrev, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake, bool fMinting = true, bool fValidate = true);
+bool CheckStakeKernelHash(unsigned int nBits, CBlockIndex* pindexPrev, const CBlockHeader& blockFrom, unsigned int nTxPrevOffset, CAmount nValueIn, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake, bool fMinting = true, bool fValidate = true);
+
+// Slot independent part of a stake kernel. Resolving the stake modifier and the coin value only has to be
+// done once per staked output, checking a time slot then costs a single double-SHA256 over a fixed preimage.
+class CStakeKernel
+{
+public:
+    // nStakeModifier, nTimeBlockFrom, nTxPrevOffset, txPrevTime, prevout.n, nTimeTx
+    static const size_t PREIMAGE_SIZE = 8 + 4 + 4 + 8 + 4 + 4;
+
+private:
+    unsigned char preimage[PREIMAGE_SIZE];
+    unsigned int nTimeBlockFrom{0};
+    CAmount nValueIn{0};
+    arith_uint256 bnTargetPerCoinDay;
+
+public:
+    // Resolves the stake modifier (requires cs_main) and prepares the preimage
+    bool Init(unsigned int nBits, CBlockIndex* pindexPrev, const CBlockHeader& blockFrom, unsigned int nTxPrevOffset, CAmount nValueIn, const COutPoint& prevout);
+
+    // Prepare the preimage from an already resolved stake modifier
+    void SetKernel(uint64_t nStakeModifier, unsigned int nBits, int64_t txPrevTime, unsigned int nTxPrevOffset, CAmount nValueIn, const COutPoint& prevout);
+
+    // Check a single time slot, doesn't need any locks
+    bool CheckTime(unsigned int nTimeTx, uint256& hashProofOfStake) const;
+
+    // Check the time slots nTimeTx, nTimeTx - 1, ... (nCount slots in total, never going below nTimeMin),
+    // returns the first one which meets the target in nTimeTxRet
+    bool FindTime(unsigned int nTimeTx, unsigned int nCount, unsigned int nTimeMin, unsigned int& nTimeTxRet, uint256& hashProofOfStake) const;
+};
+
+// Search all kernels for a valid time slot, using the stake search worker pool for large sets.
+// On success, nKernelRet is the index of the first kernel (in the given order) which has a valid slot.
+bool FindStakeKernel(const std::vector<CStakeKernel>& vKernels, unsigned int nTimeTx, unsigned int nCount, unsigned int nTimeMin, size_t& nKernelRet, unsigned int& nTimeTxRet, uint256& hashProofOfStake);
+void StopStakeSearchWorkers();
 
 // wrapper for checkstakekernelhash (bitcoin routine) for traditional method
 bool CheckStake(unsigned int nBits, const CBlock blockFrom, const CTransaction txPrev, const COutPoint prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake);
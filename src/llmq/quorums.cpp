@@ -28,6 +28,7 @@ namespace llmq
 
 static const std::string DB_QUORUM_SK_SHARE = "q_Qsk";
 static const std::string DB_QUORUM_QUORUM_VVEC = "q_Qqvvec";
+static const std::string DB_QUORUM_PUBKEY_SHARE = "q_Qpks";
 
 CQuorumManager* quorumManager;
 
@@ -87,7 +88,28 @@ CBLSPublicKey CQuorum::GetPubKeyShare(size_t memberIdx) const
         return CBLSPublicKey();
     }
     auto& m = members[memberIdx];
-    return blsCache.BuildPubKeyShare(m->proTxHash, quorumVvec, CBLSId::FromHash(m->proTxHash));
+    // both only run when the share isn't in blsCache yet, load always first
+    std::pair<std::string, std::pair<uint256, uint16_t>> dbKey;
+
+    // Stored shares are only trusted if they were recovered from the vvec this commitment was made for, and are
+    // only checked when first needed
+    auto load = [&](CBLSPublicKey& pubKeyShareRet) {
+        dbKey = std::make_pair(DB_QUORUM_PUBKEY_SHARE, std::make_pair(MakeQuorumKey(*this), (uint16_t)memberIdx));
+        std::pair<uint256, CBLSPublicKey> stored;
+        if (!evoDb.GetRawDB().Read(dbKey, stored)) {
+            return false;
+        }
+        if (stored.first != qc.quorumVvecHash || !stored.second.IsValid()) {
+            LogPrint("llmq", "CQuorum::%s -- ignoring stored pubkey share %d of quorum %s\n", __func__, memberIdx, qc.quorumHash.ToString());
+            return false;
+        }
+        pubKeyShareRet = stored.second;
+        return true;
+    };
+    auto save = [&](const CBLSPublicKey& pubKeyShare) {
+        evoDb.GetRawDB().Write(dbKey, std::make_pair(qc.quorumVvecHash, pubKeyShare));
+    };
+    return blsCache.BuildPubKeyShare(m->proTxHash, quorumVvec, CBLSId::FromHash(m->proTxHash), load, save);
 }
 
 CBLSSecretKey CQuorum::GetSkShare() const
@@ -140,6 +162,10 @@ void CQuorum::StartCachePopulatorThread(std::shared_ptr<CQuorum> _this)
     if (_this->quorumVvec == nullptr) {
         return;
     }
+    // Only members verify sig shares of other members, everybody else gets along with the quorum public key
+    if (!_this->skShare.IsValid()) {
+        return;
+    }
 
     cxxtimer::Timer t(true);
     LogPrint("llmq", "CQuorum::StartCachePopulatorThread -- start\n");
@@ -254,7 +280,7 @@ bool CQuorumManager::BuildQuorumFromCommitment(const CFinalCommitment& qc, const
     if (hasValidVvec) {
         // pre-populate caches in the background
         // recovering public key shares is quite expensive and would result in serious lags for the first few signing
-        // sessions if the shares would be calculated on-demand
+        // sessions if the shares would be calculated on-demand. After a restart, most shares come from evoDb instead
         CQuorum::StartCachePopulatorThread(quorum);
     }
 
@@ -403,7 +429,7 @@ CQuorumCPtr CQuorumManager::GetQuorum(Consensus::LLMQType llmqType, const CBlock
 
     auto& params = Params().GetConsensus().llmqs.at(llmqType);
 
-    auto quorum = std::make_shared<CQuorum>(params, blsWorker);
+    auto quorum = std::make_shared<CQuorum>(params, blsWorker, evoDb);
 
     if (!BuildQuorumFromCommitment(qc, pindexQuorum, minedBlockHash, quorum)) {
         return nullptr;
@@ -54,8 +54,11 @@ private:
     std::atomic<bool> stopCachePopulatorThread;
     std::thread cachePopulatorThread;
 
+    // Recovered shares are also stored in evoDb, so they survive restarts
+    CEvoDB& evoDb;
+
 public:
-    CQuorum(const Consensus::LLMQParams& _params, CBLSWorker& _blsWorker) : params(_params), blsCache(_blsWorker), stopCachePopulatorThread(false) {}
+    CQuorum(const Consensus::LLMQParams& _params, CBLSWorker& _blsWorker, CEvoDB& _evoDb) : params(_params), blsCache(_blsWorker), stopCachePopulatorThread(false), evoDb(_evoDb) {}
     ~CQuorum();
 	void Init(const CFinalCommitment& _qc, const CBlockIndex* _pindexQuorum, const uint256& _minedBlockHash, const std::vector<CDeterministicMNCPtr>& _members);
 
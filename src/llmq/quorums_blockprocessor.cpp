@@ -222,9 +222,14 @@ bool CQuorumBlockProcessor::ProcessCommitment(int nHeight, const uint256& blockH
         LOCK(minableCommitmentsCs);
         hasMinedCommitmentCache.erase(std::make_pair(params.type, quorumHash));
     }
+    {
+        // replaces entries of other blocks at this height, e.g. of block templates which were only checked
+        LOCK(minedCommitmentsCs);
+        minedCommitmentsIndex[params.type][nHeight] = {quorumIndex->nHeight, blockHash};
+    }
 
     LogPrint("llmq", "CQuorumBlockProcessor::%s -- processed commitment from block. type=%d, quorumHash=%s, signers=%s, validMembers=%d, quorumPublicKey=%s\n", __func__,
-              qc.llmqType, quorumHash.ToString(), qc.CountSigners(), qc.CountValidMembers(), qc.quorumPublicKey.ToString());
+              qc.llmqType, quorumHash.ToString(), qc.CountSigners(), qc.CountValidMembers(), qc.quorumPublicKey.Get().ToString());
 
     return true;
 }
@@ -251,6 +256,8 @@ bool CQuorumBlockProcessor::UndoBlock(const CBlock& block, const CBlockIndex* pi
             LOCK(minableCommitmentsCs);
             hasMinedCommitmentCache.erase(std::make_pair((Consensus::LLMQType)qc.llmqType, qc.quorumHash));
         }
+        // minedCommitmentsIndex keeps the entry, as this might be rolled back (e.g. by verifychain). Scans from
+        // blocks which don't have this one as ancestor anymore skip it.
 
         // if a reorg happened, we should allow to mine this commitment later
         AddMinableCommitment(qc);
@@ -267,6 +274,7 @@ void CQuorumBlockProcessor::UpgradeDB()
     LOCK(cs_main);
     uint256 bestBlock;
     if (evoDb.GetRawDB().Read(DB_BEST_BLOCK_UPGRADE, bestBlock) && bestBlock == chainActive.Tip()->GetBlockHash()) {
+        LoadMinedCommitmentsIndex();
         return;
     }
 
@@ -300,6 +308,49 @@ void CQuorumBlockProcessor::UpgradeDB()
     }
 
     LogPrintf("CQuorumBlockProcessor::%s -- Upgrade done...\n", __func__);
+    LoadMinedCommitmentsIndex();
+}
+
+void CQuorumBlockProcessor::LoadMinedCommitmentsIndex()
+{
+    AssertLockHeld(cs_main);
+
+    std::map<Consensus::LLMQType, std::map<int, CMinedCommitmentIndexEntry>> index;
+    size_t nCount = 0;
+    for (const auto& p : Params().GetConsensus().llmqs) {
+        auto dbIt = evoDb.GetCurTransaction().NewIteratorUniquePtr();
+        auto firstKey = BuildInversedHeightKey(p.first, chainActive.Height());
+        auto lastKey = BuildInversedHeightKey(p.first, 0);
+        auto& typeIndex = index[p.first];
+
+        for (dbIt->Seek(firstKey); dbIt->Valid(); dbIt->Next()) {
+            decltype(firstKey) curKey;
+            int quorumHeight;
+            if (!dbIt->GetKey(curKey) || curKey >= lastKey) {
+                break;
+            }
+            if (std::get<0>(curKey) != DB_MINED_COMMITMENT_BY_INVERSED_HEIGHT || std::get<1>(curKey) != (uint8_t)p.first) {
+                break;
+            }
+            if (!dbIt->GetValue(quorumHeight)) {
+                break;
+            }
+            int nMinedHeight = std::numeric_limits<uint32_t>::max() - be32toh(std::get<2>(curKey));
+            typeIndex[nMinedHeight] = {quorumHeight, chainActive[nMinedHeight]->GetBlockHash()};
+            nCount++;
+        }
+    }
+
+    LOCK(minedCommitmentsCs);
+    // blocks processed before are kept, what the DB has for the active chain wins
+    for (auto& p : index) {
+        for (auto& e : p.second) {
+            minedCommitmentsIndex[p.first][e.first] = e.second;
+        }
+    }
+    fMinedCommitmentsIndexLoaded = true;
+
+    LogPrintf("CQuorumBlockProcessor::%s -- loaded %d mined commitments\n", __func__, nCount);
 }
 
 bool CQuorumBlockProcessor::GetCommitmentsFromBlock(const CBlock& block, const CBlockIndex* pindex, std::map<Consensus::LLMQType, CFinalCommitment>& ret, CValidationState& state)
@@ -406,6 +457,31 @@ bool CQuorumBlockProcessor::GetMinedCommitment(Consensus::LLMQType llmqType, con
 }
 
 std::vector<const CBlockIndex*> CQuorumBlockProcessor::GetMinedCommitmentsUntilBlock(Consensus::LLMQType llmqType, const CBlockIndex* pindex, size_t maxCount)
+{
+    {
+        LOCK(minedCommitmentsCs);
+        if (fMinedCommitmentsIndexLoaded) {
+            std::vector<const CBlockIndex*> ret;
+            ret.reserve(maxCount);
+
+            const auto& typeIndex = minedCommitmentsIndex[llmqType];
+            for (auto it = typeIndex.upper_bound(pindex->nHeight); it != typeIndex.begin() && ret.size() < maxCount;) {
+                --it;
+                auto minedIndex = pindex->GetAncestor(it->first);
+                if (minedIndex == nullptr || minedIndex->GetBlockHash() != it->second.minedBlockHash) {
+                    continue;
+                }
+                auto quorumIndex = minedIndex->GetAncestor(it->second.nQuorumHeight);
+                assert(quorumIndex);
+                ret.emplace_back(quorumIndex);
+            }
+            return ret;
+        }
+    }
+    return GetMinedCommitmentsUntilBlockFromDB(llmqType, pindex, maxCount);
+}
+
+std::vector<const CBlockIndex*> CQuorumBlockProcessor::GetMinedCommitmentsUntilBlockFromDB(Consensus::LLMQType llmqType, const CBlockIndex* pindex, size_t maxCount)
 {
     auto dbIt = evoDb.GetCurTransaction().NewIteratorUniquePtr();
 
@@ -36,6 +36,16 @@ private:
 
     std::unordered_map<std::pair<Consensus::LLMQType, uint256>, bool, StaticSaltedHasher> hasMinedCommitmentCache;
 
+    // The mined commitments by type and mined height, so quorum scans don't need the DB. Entries are added when
+    // blocks are processed and not removed on undo, scans skip entries of blocks which are not on their chain.
+    struct CMinedCommitmentIndexEntry {
+        int nQuorumHeight;
+        uint256 minedBlockHash;
+    };
+    CCriticalSection minedCommitmentsCs;
+    bool fMinedCommitmentsIndexLoaded{false};
+    std::map<Consensus::LLMQType, std::map<int, CMinedCommitmentIndexEntry>> minedCommitmentsIndex;
+
 public:
     CQuorumBlockProcessor(CEvoDB& _evoDb) : evoDb(_evoDb) {}
 
@@ -59,6 +69,8 @@ public:
     std::map<Consensus::LLMQType, std::vector<const CBlockIndex*>> GetMinedAndActiveCommitmentsUntilBlock(const CBlockIndex* pindex);
 
 private:
+    void LoadMinedCommitmentsIndex();
+    std::vector<const CBlockIndex*> GetMinedCommitmentsUntilBlockFromDB(Consensus::LLMQType llmqType, const CBlockIndex* pindex, size_t maxCount);
     bool GetCommitmentsFromBlock(const CBlock& block, const CBlockIndex* pindex, std::map<Consensus::LLMQType, CFinalCommitment>& ret, CValidationState& state);
     bool ProcessCommitment(int nHeight, const uint256& blockHash, const CFinalCommitment& qc, CValidationState& state);
     bool IsMiningPhase(Consensus::LLMQType llmqType, int nHeight);
@@ -12,9 +12,11 @@
 
 #include "chain.h"
 #include "masternode-sync.h"
+#include "metrics.h"
 #include "net_processing.h"
 #include "scheduler.h"
 #include "spork.h"
+#include "tracing.h"
 #include "txmempool.h"
 #include "validation.h"
 
@@ -58,7 +60,7 @@ void CChainLocksHandler::Stop()
 bool CChainLocksHandler::AlreadyHave(const CInv& inv)
 {
     LOCK(cs);
-    return seenChainLocks.count(inv.hash) != 0;
+    return seenChainLocks.Contains(inv.hash);
 }
 
 bool CChainLocksHandler::GetChainLockByHash(const uint256& hash, llmq::CChainLockSig& ret)
@@ -99,7 +101,7 @@ void CChainLocksHandler::ProcessNewChainLock(NodeId from, const llmq::CChainLock
 
     {
         LOCK(cs);
-        if (!seenChainLocks.emplace(hash, GetTimeMillis()).second) {
+        if (!seenChainLocks.Insert(hash, GetTimeMillis())) {
             return;
         }
 
@@ -111,7 +113,7 @@ void CChainLocksHandler::ProcessNewChainLock(NodeId from, const llmq::CChainLock
 
     uint256 requestId = ::SerializeHash(std::make_pair(CLSIG_REQUESTID_PREFIX, clsig.nHeight));
     uint256 msgHash = clsig.blockHash;
-    if (!quorumSigningManager->VerifyRecoveredSig(Params().GetConsensus().llmqChainLocks, clsig.nHeight, requestId, msgHash, clsig.sig)) {
+    if (!quorumSigningManager->VerifyRecoveredSig(Params().GetConsensus().llmqChainLocks, clsig.nHeight, requestId, msgHash, clsig.sig.Get())) {
         LogPrintf("CChainLocksHandler::%s -- invalid CLSIG (%s), peer=%d\n", __func__, clsig.ToString(), from);
         if (from != -1) {
             LOCK(cs_main);
@@ -133,6 +135,8 @@ void CChainLocksHandler::ProcessNewChainLock(NodeId from, const llmq::CChainLock
 
         bestChainLockHash = hash;
         bestChainLock = clsig;
+        g_metrics.nChainLockHeight = clsig.nHeight;
+        TRACE3(llmq, chainlock_processed, clsig.nHeight, clsig.blockHash.begin(), from);
 
         CInv inv(MSG_CLSIG, hash);
         g_connman->RelayInv(inv, LLMQS_PROTO_VERSION);
@@ -227,6 +231,7 @@ void CChainLocksHandler::CheckActiveState()
         // to disable spork19)
         bestChainLockHash = uint256();
         bestChainLock = bestChainLockWithKnownBlock = CChainLockSig();
+        g_metrics.nChainLockHeight = -1;
         bestChainLockBlockIndex = lastNotifyChainLockBlockIndex = nullptr;
     }
 }
@@ -561,7 +566,7 @@ void CChainLocksHandler::HandleNewRecoveredSig(const llmq::CRecoveredSig& recove
 
         clsig.nHeight = lastSignedHeight;
         clsig.blockHash = lastSignedMsgHash;
-        clsig.sig = recoveredSig.sig.Get();
+        clsig.sig = recoveredSig.sig;
     }
     ProcessNewChainLock(-1, clsig, ::SerializeHash(clsig));
 }
@@ -671,13 +676,7 @@ void CChainLocksHandler::Cleanup()
     LOCK2(cs_main, mempool.cs);
     LOCK(cs);
 
-    for (auto it = seenChainLocks.begin(); it != seenChainLocks.end(); ) {
-        if (GetTimeMillis() - it->second >= CLEANUP_SEEN_TIMEOUT) {
-            it = seenChainLocks.erase(it);
-        } else {
-            ++it;
-        }
-    }
+    seenChainLocks.Expire(GetTimeMillis());
 
     for (auto it = blockTxs.begin(); it != blockTxs.end(); ) {
         auto pindex = mapBlockIndex.at(it->first);
@@ -27,7 +27,7 @@ class CChainLockSig
 public:
     int32_t nHeight{-1};
     uint256 blockHash;
-    CBLSSignature sig;
+    CBLSLazySignature sig;
 
 public:
     ADD_SERIALIZE_METHODS
@@ -74,7 +74,7 @@ private:
     BlockTxs blockTxs;
     std::unordered_map<uint256, int64_t> txFirstSeenTime;
 
-    std::map<uint256, int64_t> seenChainLocks;
+    CAgingSeenSet<uint256> seenChainLocks{CLEANUP_SEEN_TIMEOUT};
 
     int64_t lastCleanupTime{0};
 
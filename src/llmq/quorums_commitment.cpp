@@ -10,6 +10,7 @@
 #include "chainparams.h"
 #include "validation.h"
 
+#include "bls/bls_sigcache.h"
 #include "evo/specialtx.h"
 
 #include <univalue.h>
@@ -83,7 +84,7 @@ bool CFinalCommitment::Verify(const std::vector<CDeterministicMNCPtr>& members,
 
     // sigs are only checked when the block is processed
     if (checkSigs) {
-        uint256 commitmentHash = CLLMQUtils::BuildCommitmentHash((uint8_t)params.type, quorumHash, validMembers, quorumPublicKey, quorumVvecHash);
+        uint256 commitmentHash = CLLMQUtils::BuildCommitmentHash((uint8_t)params.type, quorumHash, validMembers, quorumPublicKey.Get(), quorumVvecHash);
 
         std::vector<CBLSPublicKey> memberPubKeys;
         for (size_t i = 0; i < members.size(); i++) {
@@ -93,12 +94,12 @@ bool CFinalCommitment::Verify(const std::vector<CDeterministicMNCPtr>& members,
             memberPubKeys.emplace_back(members[i]->pdmnState->pubKeyOperator.Get());
         }
 
-        if (!membersSig.VerifySecureAggregated(memberPubKeys, commitmentHash)) {
+        if (!VerifyBLSAggregatedSignatureCached(membersSig.Get(), memberPubKeys, commitmentHash)) {
             LogPrintfFinalCommitment("invalid aggregated members signature\n");
             return false;
         }
 
-        if (!quorumSig.VerifyInsecure(quorumPublicKey, commitmentHash)) {
+        if (!VerifyBLSSignatureCached(quorumSig.Get(), quorumPublicKey.Get(), commitmentHash)) {
             LogPrintfFinalCommitment("invalid quorum signature\n");
             return false;
         }
@@ -143,7 +144,7 @@ void CFinalCommitment::ToJson(UniValue& obj) const
     obj.push_back(Pair("quorumHash", quorumHash.ToString()));
     obj.push_back(Pair("signersCount", CountSigners()));
     obj.push_back(Pair("validMembersCount", CountValidMembers()));
-    obj.push_back(Pair("quorumPublicKey", quorumPublicKey.ToString()));
+    obj.push_back(Pair("quorumPublicKey", quorumPublicKey.Get().ToString()));
 }
 
 void CFinalCommitmentTxPayload::ToJson(UniValue& obj) const
@@ -31,11 +31,12 @@ public:
     std::vector<bool> signers;
     std::vector<bool> validMembers;
 
-    CBLSPublicKey quorumPublicKey;
+    // lazy, commitments loaded from the DB or relayed in MNLISTDIFFs mostly never need their points
+    CBLSLazyPublicKey quorumPublicKey;
     uint256 quorumVvecHash;
 
-    CBLSSignature quorumSig; // recovered threshold sig of blockHash+validMembers+pubKeyHash+vvecHash
-    CBLSSignature membersSig; // aggregated member sig of blockHash+validMembers+pubKeyHash+vvecHash
+    CBLSLazySignature quorumSig; // recovered threshold sig of blockHash+validMembers+pubKeyHash+vvecHash
+    CBLSLazySignature membersSig; // aggregated member sig of blockHash+validMembers+pubKeyHash+vvecHash
 
 public:
     CFinalCommitment() {}
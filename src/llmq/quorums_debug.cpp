@@ -50,6 +50,17 @@ UniValue CDKGDebugSessionStatus::ToJson(int detailLevel) const
     ret.push_back(Pair("sentPrematureCommitment", sentPrematureCommitment));
     ret.push_back(Pair("aborted", aborted));
 
+    static const char* phaseNames[] = {"contribute", "complain", "justify", "commit", "finalize"};
+    UniValue phaseTimesJson(UniValue::VOBJ);
+    for (size_t i = 0; i < phaseTimes.size(); i++) {
+        UniValue t(UniValue::VOBJ);
+        t.push_back(Pair("start", phaseTimes[i].startTime / 1000.0));
+        t.push_back(Pair("messages", phaseTimes[i].messageTime / 1000.0));
+        t.push_back(Pair("batches", (int)phaseTimes[i].messageBatches));
+        phaseTimesJson.push_back(Pair(phaseNames[i], t));
+    }
+    ret.push_back(Pair("phaseTimes", phaseTimesJson));
+
     struct ArrOrCount {
         int count{0};
         UniValue arr{UniValue::VARR};
@@ -176,6 +187,7 @@ void CDKGDebugManager::InitLocalSessionStatus(Consensus::LLMQType llmqType, cons
     session.statusBitset = 0;
     session.members.clear();
     session.members.resize((size_t)params.size);
+    session.phaseTimes = {};
 }
 
 void CDKGDebugManager::UpdateLocalStatus(std::function<bool(CDKGDebugStatus& status)>&& func)
@@ -11,6 +11,7 @@
 #include "sync.h"
 #include "univalue.h"
 
+#include <array>
 #include <set>
 
 class CDataStream;
@@ -70,6 +71,16 @@ public:
 
     std::vector<CDKGDebugMemberStatus> members;
 
+    // Time spent in each of the phases Contribute to Finalize (index 0 to 4), in microseconds. startTime is the time
+    // spent in the phase's start function (e.g. creating and sending our own messages), messageTime is the time spent
+    // processing incoming messages in messageBatches batches
+    struct PhaseTime {
+        int64_t startTime{0};
+        int64_t messageTime{0};
+        uint32_t messageBatches{0};
+    };
+    std::array<PhaseTime, 5> phaseTimes;
+
 public:
     CDKGDebugSessionStatus() : statusBitset(0) {}
 
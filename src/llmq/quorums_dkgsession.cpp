@@ -9,6 +9,7 @@
 #include "quorums_commitment.h"
 #include "quorums_debug.h"
 #include "quorums_dkgsessionmgr.h"
+#include "quorums_init.h"
 #include "quorums_utils.h"
 
 #include "evo/specialtx.h"
@@ -24,6 +25,8 @@
 
 #include "cxxtimer.hpp"
 
+#include <future>
+
 namespace llmq
 {
 
@@ -257,6 +260,42 @@ bool CDKGSession::PreVerifyMessage(const uint256& hash, const CDKGContribution&
     return true;
 }
 
+CDKGSession::~CDKGSession()
+{
+    // running verifications reference the vectors in pendingVerifications
+    for (auto& v : pendingVerifications) {
+        v.future.wait();
+    }
+}
+
+// Starts decrypting our share of a contribution on the BLS workers. The job only holds copies, so the session doesn't
+// have to outlive it
+std::future<CDKGSession::DecryptionResult> CDKGSession::AsyncDecryptContribution(const std::shared_ptr<CDKGContribution>& qc) const
+{
+    auto promise = std::make_shared<std::promise<DecryptionResult>>();
+    auto future = promise->get_future();
+    CBLSSecretKey sk = *activeMasternodeInfo.blsKeyOperator;
+    size_t myIdx = this->myIdx;
+    blsWorker.AsyncRun([promise, qc, sk, myIdx]() {
+        DecryptionResult result;
+        result.first = qc->contributions->Decrypt(myIdx, sk, result.second, PROTOCOL_VERSION);
+        promise->set_value(std::move(result));
+    });
+    return future;
+}
+
+// Starts decrypting our shares of a batch of contributions, ReceiveMessage picks up the futures
+void CDKGSession::PrepareMessages(const std::vector<uint256>& hashes, const std::vector<std::pair<NodeId, std::shared_ptr<CDKGContribution>>>& msgs)
+{
+    if (!AreWeMember()) {
+        return;
+    }
+
+    for (size_t i = 0; i < msgs.size(); i++) {
+        decryptedContributions[hashes[i]] = AsyncDecryptContribution(msgs[i].second);
+    }
+}
+
 void CDKGSession::ReceiveMessage(const uint256& hash, const CDKGContribution& qc, bool& retBan)
 {
     CDKGLogger logger(*this, __func__);
@@ -283,7 +322,7 @@ void CDKGSession::ReceiveMessage(const uint256& hash, const CDKGContribution& qc
 
         CInv inv(MSG_QUORUM_CONTRIB, hash);
         invSet.emplace(inv);
-        RelayInvToParticipants(inv);
+        RelayInvToParticipants(inv, member->idx == myIdx);
 
         quorumDKGDebugManager->UpdateLocalMemberStatus(params.type, member->idx, [&](CDKGDebugMemberStatus& status) {
             status.receivedContribution = true;
@@ -319,91 +358,129 @@ void CDKGSession::ReceiveMessage(const uint256& hash, const CDKGContribution& qc
 
 	dkgManager.WriteVerifiedVvecContribution(params.type, pindexQuorum, qc.proTxHash, qc.vvec);
 
-    bool complain = false;
-    CBLSSecretKey skContribution;
-    if (!qc.contributions->Decrypt(myIdx, *activeMasternodeInfo.blsKeyOperator, skContribution, PROTOCOL_VERSION)) {
-        logger.Batch("contribution from %s could not be decrypted", member->dmn->proTxHash.ToString());
-        complain = true;
-    } else if (member->idx != myIdx && ShouldSimulateError("complain-lie")) {
-        logger.Batch("lying/complaining for %s", member->dmn->proTxHash.ToString());
-        complain = true;
+    std::future<DecryptionResult> decryption;
+    auto itDecrypted = decryptedContributions.find(hash);
+    if (itDecrypted != decryptedContributions.end()) {
+        decryption = std::move(itDecrypted->second);
+        decryptedContributions.erase(itDecrypted);
+    } else {
+        decryption = AsyncDecryptContribution(std::make_shared<CDKGContribution>(qc));
     }
+    pendingDecryptions.emplace_back(member->idx, std::move(decryption));
 
-    if (complain) {
-        member->weComplain = true;
-        quorumDKGDebugManager->UpdateLocalMemberStatus(params.type, member->idx, [&](CDKGDebugMemberStatus& status) {
-            status.weComplain = true;
-            return true;
-        });
-        return;
+    logger.Batch("queued decryption of our contribution share. time=%d", t2.count());
+
+    ProcessContributionFutures(false);
+}
+
+// Moves contributions on to the next stage once their decryption or verification is done. With fWait, it waits
+// for everything and verifies the remaining shares even if they don't fill a batch. Returns true if anything was done
+bool CDKGSession::ProcessContributionFutures(bool fWait)
+{
+    if (pendingDecryptions.empty() && pendingContributionVerifications.empty() && pendingVerifications.empty()) {
+        return false;
     }
 
-    logger.Batch("decrypted our contribution share. time=%d", t2.count());
+    CDKGLogger logger(*this, __func__);
+
+    bool fProgress = false;
 
-    bool verifyPending = false;
-    receivedSkContributions[member->idx] = skContribution;
-    pendingContributionVerifications.emplace_back(member->idx);
-    if (pendingContributionVerifications.size() >= 32) {
-        verifyPending = true;
+    for (auto it = pendingDecryptions.begin(); it != pendingDecryptions.end(); ) {
+        if (!fWait && it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++it;
+            continue;
+        }
+        auto& member = members[it->first];
+        auto result = it->second.get();
+        it = pendingDecryptions.erase(it);
+        fProgress = true;
+
+        bool complain = false;
+        if (!result.first) {
+            logger.Batch("contribution from %s could not be decrypted", member->dmn->proTxHash.ToString());
+            complain = true;
+        } else if (member->idx != myIdx && ShouldSimulateError("complain-lie")) {
+            logger.Batch("lying/complaining for %s", member->dmn->proTxHash.ToString());
+            complain = true;
+        }
+
+        if (complain) {
+            member->weComplain = true;
+            quorumDKGDebugManager->UpdateLocalMemberStatus(params.type, member->idx, [&](CDKGDebugMemberStatus& status) {
+                status.weComplain = true;
+                return true;
+            });
+            continue;
+        }
+
+        receivedSkContributions[member->idx] = result.second;
+        pendingContributionVerifications.emplace_back(member->idx);
     }
 
-    if (verifyPending) {
+    if (pendingContributionVerifications.size() >= 32 || (fWait && !pendingContributionVerifications.empty())) {
         VerifyPendingContributions();
     }
+
+    for (auto it = pendingVerifications.begin(); it != pendingVerifications.end(); ) {
+        if (!fWait && it->future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++it;
+            continue;
+        }
+        auto result = it->future.get();
+        fProgress = true;
+
+        if (result.size() != it->memberIndexes.size()) {
+            logger.Batch("VerifyContributionShares returned result of size %d but size %d was expected, something is wrong", result.size(), it->memberIndexes.size());
+            it = pendingVerifications.erase(it);
+            continue;
+        }
+
+        for (size_t i = 0; i < it->memberIndexes.size(); i++) {
+            auto& m = members[it->memberIndexes[i]];
+            if (!result[i]) {
+                logger.Batch("invalid contribution from %s. will complain later", m->dmn->proTxHash.ToString());
+                m->weComplain = true;
+                quorumDKGDebugManager->UpdateLocalMemberStatus(params.type, m->idx, [&](CDKGDebugMemberStatus& status) {
+                    status.weComplain = true;
+                    return true;
+                });
+            } else {
+                dkgManager.WriteVerifiedSkContribution(params.type, pindexQuorum, m->dmn->proTxHash, it->skContributions[i]);
+            }
+        }
+        logger.Batch("verified %d pending contributions", it->memberIndexes.size());
+        it = pendingVerifications.erase(it);
+    }
+
+    return fProgress;
 }
 
-// Verifies all pending secret key contributions in one batch
+// Starts verifying all pending secret key contributions in one batch, ProcessContributionFutures picks up the result
 // This is done by aggregating the verification vectors belonging to the secret key contributions
 // The resulting aggregated vvec is then used to recover a public key share
 // The public key share must match the public key belonging to the aggregated secret key contributions
 // See CBLSWorker::VerifyContributionShares for more details.
 void CDKGSession::VerifyPendingContributions()
 {
-    CDKGLogger logger(*this, __func__);
-
-    cxxtimer::Timer t1(true);
-
     std::vector<size_t> pend = std::move(pendingContributionVerifications);
+    pendingContributionVerifications.clear();
     if (pend.empty()) {
         return;
     }
 
-    std::vector<size_t> memberIndexes;
-    std::vector<BLSVerificationVectorPtr> vvecs;
-    BLSSecretKeyVector skContributions;
-
+    pendingVerifications.emplace_back();
+    auto& v = pendingVerifications.back();
     for (const auto& idx : pend) {
         auto& m = members[idx];
         if (m->bad || m->weComplain) {
             continue;
         }
-        memberIndexes.emplace_back(idx);
-        vvecs.emplace_back(receivedVvecs[idx]);
-        skContributions.emplace_back(receivedSkContributions[idx]);
-    }
-
-    auto result = blsWorker.VerifyContributionShares(myId, vvecs, skContributions);
-    if (result.size() != memberIndexes.size()) {
-        logger.Batch("VerifyContributionShares returned result of size %d but size %d was expected, something is wrong", result.size(), memberIndexes.size());
-        return;
-    }
-
-    for (size_t i = 0; i < memberIndexes.size(); i++) {
-        if (!result[i]) {
-            auto& m = members[memberIndexes[i]];
-            logger.Batch("invalid contribution from %s. will complain later", m->dmn->proTxHash.ToString());
-            m->weComplain = true;
-            quorumDKGDebugManager->UpdateLocalMemberStatus(params.type, m->idx, [&](CDKGDebugMemberStatus& status) {
-                status.weComplain = true;
-                return true;
-            });
-        } else {
-            size_t memberIdx = memberIndexes[i];
-			dkgManager.WriteVerifiedSkContribution(params.type, pindexQuorum, members[memberIdx]->dmn->proTxHash, skContributions[i]);
-        }
+        v.memberIndexes.emplace_back(idx);
+        v.vvecs.emplace_back(receivedVvecs[idx]);
+        v.skContributions.emplace_back(receivedSkContributions[idx]);
     }
 
-    logger.Batch("verified %d pending contributions. time=%d", pend.size(), t1.count());
+    v.future = blsWorker.AsyncVerifyContributionShares(myId, v.vvecs, v.skContributions, true, true);
 }
 
 void CDKGSession::VerifyAndComplain(CDKGPendingMessages& pendingMessages)
@@ -412,7 +489,7 @@ void CDKGSession::VerifyAndComplain(CDKGPendingMessages& pendingMessages)
         return;
     }
 
-    VerifyPendingContributions();
+    ProcessContributionFutures(true);
 
     CDKGLogger logger(*this, __func__);
 
@@ -550,7 +627,7 @@ void CDKGSession::ReceiveMessage(const uint256& hash, const CDKGComplaint& qc, b
 
         CInv inv(MSG_QUORUM_COMPLAINT, hash);
         invSet.emplace(inv);
-        RelayInvToParticipants(inv);
+        RelayInvToParticipants(inv, member->idx == myIdx);
 
         quorumDKGDebugManager->UpdateLocalMemberStatus(params.type, member->idx, [&](CDKGDebugMemberStatus& status) {
             status.receivedComplaint = true;
@@ -765,7 +842,7 @@ void CDKGSession::ReceiveMessage(const uint256& hash, const CDKGJustification& q
         // we always relay, even if further verification fails
         CInv inv(MSG_QUORUM_JUSTIFICATION, hash);
         invSet.emplace(inv);
-        RelayInvToParticipants(inv);
+        RelayInvToParticipants(inv, member->idx == myIdx);
 
         quorumDKGDebugManager->UpdateLocalMemberStatus(params.type, member->idx, [&](CDKGDebugMemberStatus& status) {
             status.receivedJustification = true;
@@ -1088,44 +1165,30 @@ void CDKGSession::ReceiveMessage(const uint256& hash, const CDKGPrematureCommitm
         member->prematureCommitments.emplace(hash);
     }
 
-    std::vector<uint16_t> memberIndexes;
-    std::vector<BLSVerificationVectorPtr> vvecs;
-    BLSSecretKeyVector skContributions;
-    BLSVerificationVectorPtr quorumVvec;
-  	if (dkgManager.GetVerifiedContributions(params.type, pindexQuorum, qc.validMembers, memberIndexes, vvecs, skContributions)) {
-        quorumVvec = cache.BuildQuorumVerificationVector(::SerializeHash(memberIndexes), vvecs);
+    PrematureCommitmentResult result;
+    std::string error;
+    auto itVerified = verifiedPrematureCommitments.find(hash);
+    if (itVerified != verifiedPrematureCommitments.end()) {
+        result = (PrematureCommitmentResult)itVerified->second.first;
+        error = std::move(itVerified->second.second);
+        verifiedPrematureCommitments.erase(itVerified);
+    } else {
+        std::vector<uint16_t> memberIndexes;
+        auto quorumVvec = BuildQuorumVvecForCommitment(qc, memberIndexes);
+        result = VerifyPrematureCommitment(qc, quorumVvec, memberIndexes, error);
     }
 
-    if (quorumVvec == nullptr) {
+    if (result == PrematureCommitment_NoVvec) {
         logger.Batch("failed to build quorum verification vector. skipping full verification");
         // we might be the unlucky one who didn't receive all contributions, but we still have to relay
         // the premature commitment as others might be luckier
-    } else {
+    } else if (result == PrematureCommitment_Invalid) {
         // we got all information that is needed to verify everything (even though we might not be a member of the quorum)
         // if any of this verification fails, we won't relay this message. This ensures that invalid messages are lost
         // in the network. Nodes relaying such invalid messages to us are not punished as they might have not known
         // all contributions. We only handle up to 2 commitments per member, so a DoS shouldn't be possible
-
-        if ((*quorumVvec)[0] != qc.quorumPublicKey) {
-            logger.Batch("calculated quorum public key does not match");
-            return;
-        }
-        uint256 vvecHash = ::SerializeHash(*quorumVvec);
-        if (qc.quorumVvecHash != vvecHash) {
-            logger.Batch("calculated quorum vvec hash does not match");
-            return;
-        }
-
-        CBLSPublicKey pubKeyShare = cache.BuildPubKeyShare(::SerializeHash(std::make_pair(memberIndexes, member->id)), quorumVvec, member->id);
-        if (!pubKeyShare.IsValid()) {
-            logger.Batch("failed to calculate public key share");
-            return;
-        }
-
-        if (!qc.quorumSig.VerifyInsecure(pubKeyShare, qc.GetSignHash())) {
-            logger.Batch("failed to verify quorumSig");
-            return;
-        }
+        logger.Batch("%s", error);
+        return;
     }
 
     LOCK(invCs);
@@ -1133,7 +1196,7 @@ void CDKGSession::ReceiveMessage(const uint256& hash, const CDKGPrematureCommitm
 
     CInv inv(MSG_QUORUM_PREMATURE_COMMITMENT, hash);
     invSet.emplace(inv);
-    RelayInvToParticipants(inv);
+    RelayInvToParticipants(inv, member->idx == myIdx);
 
     quorumDKGDebugManager->UpdateLocalMemberStatus(params.type, member->idx, [&](CDKGDebugMemberStatus& status) {
         status.receivedPrematureCommitment = true;
@@ -1152,6 +1215,76 @@ void CDKGSession::ReceiveMessage(const uint256& hash, const CDKGPrematureCommitm
     logger.Batch("verified premature commitment. received=%d/%d, time=%d", receivedCount, members.size(), t1.count());
 }
 
+BLSVerificationVectorPtr CDKGSession::BuildQuorumVvecForCommitment(const CDKGPrematureCommitment& qc, std::vector<uint16_t>& memberIndexesRet)
+{
+    std::vector<BLSVerificationVectorPtr> vvecs;
+    BLSSecretKeyVector skContributions;
+  	if (!dkgManager.GetVerifiedContributions(params.type, pindexQuorum, qc.validMembers, memberIndexesRet, vvecs, skContributions)) {
+        return nullptr;
+    }
+    return cache.BuildQuorumVerificationVector(::SerializeHash(memberIndexesRet), vvecs);
+}
+
+// Safe to be called on the BLS workers
+CDKGSession::PrematureCommitmentResult CDKGSession::VerifyPrematureCommitment(const CDKGPrematureCommitment& qc, const BLSVerificationVectorPtr& quorumVvec,
+                                                                              const std::vector<uint16_t>& memberIndexes, std::string& errorRet)
+{
+    if (quorumVvec == nullptr) {
+        return PrematureCommitment_NoVvec;
+    }
+
+    if ((*quorumVvec)[0] != qc.quorumPublicKey) {
+        errorRet = "calculated quorum public key does not match";
+        return PrematureCommitment_Invalid;
+    }
+    uint256 vvecHash = ::SerializeHash(*quorumVvec);
+    if (qc.quorumVvecHash != vvecHash) {
+        errorRet = "calculated quorum vvec hash does not match";
+        return PrematureCommitment_Invalid;
+    }
+
+    auto member = GetMember(qc.proTxHash);
+    CBLSPublicKey pubKeyShare = cache.BuildPubKeyShare(::SerializeHash(std::make_pair(memberIndexes, member->id)), quorumVvec, member->id);
+    if (!pubKeyShare.IsValid()) {
+        errorRet = "failed to calculate public key share";
+        return PrematureCommitment_Invalid;
+    }
+
+    if (!qc.quorumSig.VerifyInsecure(pubKeyShare, qc.GetSignHash())) {
+        errorRet = "failed to verify quorumSig";
+        return PrematureCommitment_Invalid;
+    }
+    return PrematureCommitment_Valid;
+}
+
+// Builds the quorum vvecs of a batch of premature commitments (internally parallelized and mostly cached, as all members
+// should commit to the same set of valid members) and then verifies the commitments in parallel
+void CDKGSession::PrepareMessages(const std::vector<uint256>& hashes, const std::vector<std::pair<NodeId, std::shared_ptr<CDKGPrematureCommitment>>>& msgs)
+{
+    std::vector<std::vector<uint16_t>> memberIndexes(msgs.size());
+    std::vector<BLSVerificationVectorPtr> quorumVvecs(msgs.size());
+    for (size_t i = 0; i < msgs.size(); i++) {
+        quorumVvecs[i] = BuildQuorumVvecForCommitment(*msgs[i].second, memberIndexes[i]);
+    }
+
+    std::vector<std::pair<int, std::string>> results(msgs.size());
+    std::vector<std::future<void>> futures;
+    futures.reserve(msgs.size());
+    for (size_t i = 0; i < msgs.size(); i++) {
+        const auto& qc = *msgs[i].second;
+        const auto& quorumVvec = quorumVvecs[i];
+        const auto& indexes = memberIndexes[i];
+        auto& result = results[i];
+        futures.emplace_back(blsWorker.AsyncRun([this, &qc, &quorumVvec, &indexes, &result]() {
+            result.first = VerifyPrematureCommitment(qc, quorumVvec, indexes, result.second);
+        }));
+    }
+    for (size_t i = 0; i < futures.size(); i++) {
+        futures[i].get();
+        verifiedPrematureCommitments[hashes[i]] = std::move(results[i]);
+    }
+}
+
 std::vector<CFinalCommitment> CDKGSession::FinalizeCommitments()
 {
     if (!AreWeMember()) {
@@ -1197,10 +1330,10 @@ std::vector<CFinalCommitment> CDKGSession::FinalizeCommitments()
 
         CFinalCommitment fqc(params, first.quorumHash);
         fqc.validMembers = first.validMembers;
-        fqc.quorumPublicKey = first.quorumPublicKey;
+        fqc.quorumPublicKey.Set(first.quorumPublicKey);
         fqc.quorumVvecHash = first.quorumVvecHash;
 
-        uint256 commitmentHash = CLLMQUtils::BuildCommitmentHash(fqc.llmqType, fqc.quorumHash, fqc.validMembers, fqc.quorumPublicKey, fqc.quorumVvecHash);
+        uint256 commitmentHash = CLLMQUtils::BuildCommitmentHash(fqc.llmqType, fqc.quorumHash, fqc.validMembers, first.quorumPublicKey, fqc.quorumVvecHash);
 
         std::vector<CBLSSignature> aggSigs;
         std::vector<CBLSPublicKey> aggPks;
@@ -1227,20 +1360,22 @@ std::vector<CFinalCommitment> CDKGSession::FinalizeCommitments()
         }
 
         cxxtimer::Timer t1(true);
-        fqc.membersSig = CBLSSignature::AggregateSecure(aggSigs, aggPks, commitmentHash);
+        fqc.membersSig.Set(CBLSSignature::AggregateSecure(aggSigs, aggPks, commitmentHash));
         t1.stop();
 
         cxxtimer::Timer t2(true);
-        if (!fqc.quorumSig.Recover(thresholdSigs, signerIds)) {
+        CBLSSignature quorumSig;
+        if (!quorumSig.Recover(thresholdSigs, signerIds)) {
             logger.Batch("failed to recover quorum sig");
             continue;
         }
+        fqc.quorumSig.Set(quorumSig);
         t2.stop();
 
         finalCommitments.emplace_back(fqc);
 
         logger.Batch("final commitment: validMembers=%d, signers=%d, quorumPublicKey=%s, time1=%d, time2=%d",
-                        fqc.CountValidMembers(), fqc.CountSigners(), fqc.quorumPublicKey.ToString(),
+                        fqc.CountValidMembers(), fqc.CountSigners(), first.quorumPublicKey.ToString(),
                         t1.count(), t2.count());
     }
 
@@ -1271,20 +1406,68 @@ void CDKGSession::MarkBadMember(size_t idx)
     member->bad = true;
 }
 
-void CDKGSession::RelayInvToParticipants(const CInv& inv) const
+void CDKGSession::RelayInvToParticipants(const CInv& inv, bool fOwnMessage)
 {
     LOCK(invCs);
+    pendingRelayInvs.emplace_back(inv, fOwnMessage);
+}
+
+template<typename Message>
+static bool PushDKGMessage(CConnman& connman, CNode* pnode, const char* strCommand, const std::map<uint256, Message>& messages, const uint256& hash)
+{
+    auto it = messages.find(hash);
+    if (it == messages.end()) {
+        return false;
+    }
+    connman.PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(strCommand, it->second));
+    return true;
+}
+
+// Announces all messages received since the last call in one pass over the peers. Our own messages are sent in full to
+// the members we are connected to, these are the first hop for them and would request them anyway. Everything else
+// is announced as before, so that members which got a message from several peers only download it once.
+void CDKGSession::FlushRelayInvs()
+{
+    LOCK(invCs);
+    if (pendingRelayInvs.empty()) {
+        return;
+    }
+
+    bool fPush = GetBoolArg("-pushdkgmessages", DEFAULT_PUSH_DKG_MESSAGES);
+
     g_connman->ForEachNode([&](CNode* pnode) {
-        bool relay = false;
-        if (pnode->qwatch) {
-            relay = true;
-        } else if (!pnode->verifiedProRegTxHash.IsNull() && membersMap.count(pnode->verifiedProRegTxHash)) {
-            relay = true;
+        bool fMember = !pnode->verifiedProRegTxHash.IsNull() && membersMap.count(pnode->verifiedProRegTxHash);
+        if (!fMember && !pnode->qwatch) {
+            return;
         }
-        if (relay) {
+        for (const auto& p : pendingRelayInvs) {
+            const CInv& inv = p.first;
+            if (fPush && fMember && p.second) {
+                bool fPushed = false;
+                switch (inv.type) {
+                case MSG_QUORUM_CONTRIB:
+                    fPushed = PushDKGMessage(*g_connman, pnode, NetMsgType::QCONTRIB, contributions, inv.hash);
+                    break;
+                case MSG_QUORUM_COMPLAINT:
+                    fPushed = PushDKGMessage(*g_connman, pnode, NetMsgType::QCOMPLAINT, complaints, inv.hash);
+                    break;
+                case MSG_QUORUM_JUSTIFICATION:
+                    fPushed = PushDKGMessage(*g_connman, pnode, NetMsgType::QJUSTIFICATION, justifications, inv.hash);
+                    break;
+                case MSG_QUORUM_PREMATURE_COMMITMENT:
+                    fPushed = PushDKGMessage(*g_connman, pnode, NetMsgType::QPCOMMITMENT, prematureCommitments, inv.hash);
+                    break;
+                }
+                if (fPushed) {
+                    // don't announce it later on
+                    pnode->AddInventoryKnown(inv);
+                    continue;
+                }
+            }
             pnode->PushInventory(inv);
         }
     });
+    pendingRelayInvs.clear();
 }
 
 }
@@ -18,6 +18,9 @@
 
 #include "llmq/quorums_utils.h"
 
+#include <future>
+#include <list>
+
 class UniValue;
 
 namespace llmq
@@ -278,15 +281,37 @@ private:
     std::map<uint256, CDKGJustification> justifications;
     std::map<uint256, CDKGPrematureCommitment> prematureCommitments;
     std::set<CInv> invSet;
-
+    // announcements queued by ReceiveMessage, sent out by FlushRelayInvs once per message batch. The flag marks our
+    // own messages
+    std::vector<std::pair<CInv, bool>> pendingRelayInvs;
+
+    // contributions pass through two asynchronous stages on the BLS workers, the decryption of our share and the
+    // batched verification of the decrypted shares. Both are only touched by the phase handler thread and
+    // ProcessContributionFutures moves contributions on as soon as their stage is done, not in arrival order
+    typedef std::pair<bool, CBLSSecretKey> DecryptionResult;
+    struct PendingVerification {
+        std::vector<size_t> memberIndexes;
+        // referenced by the running verification
+        std::vector<BLSVerificationVectorPtr> vvecs;
+        BLSSecretKeyVector skContributions;
+        std::future<std::vector<bool>> future;
+    };
+    std::list<std::pair<size_t, std::future<DecryptionResult>>> pendingDecryptions;
     std::vector<size_t> pendingContributionVerifications;
+    std::list<PendingVerification> pendingVerifications;
 
     // filled by ReceivePrematureCommitment and used by FinalizeCommitments
     std::set<uint256> validCommitments;
 
+    // results of the expensive parts of ReceiveMessage, computed in parallel by PrepareMessages. Indexed by msg hash
+    // and only used by the phase handler thread
+    std::map<uint256, std::future<DecryptionResult>> decryptedContributions;
+    std::map<uint256, std::pair<int, std::string>> verifiedPrematureCommitments;
+
 public:
     CDKGSession(const Consensus::LLMQParams& _params, CBLSWorker& _blsWorker, CDKGSessionManager& _dkgManager) :
         params(_params), blsWorker(_blsWorker), cache(_blsWorker), dkgManager(_dkgManager) {}
+    ~CDKGSession();
 
 	bool Init(const CBlockIndex* pindexQuorum, const std::vector<CDeterministicMNCPtr>& mns, const uint256& _myProTxHash);
 
@@ -301,16 +326,24 @@ public:
      *    operations.
      * 3. CDKGSessionHandler will collect pre verified messages in batches and perform batched BLS signature verification
      *    on these.
-     * 4. ReceiveMessage is called for each pre verified message with a valid signature. ReceiveMessage is also
+     * 4. PrepareMessages is called with all pre verified messages with a valid signature of a batch. For the phases
+     *    where it matters, it does the CPU intensive parts of step 5 in parallel on the BLS workers.
+     * 5. ReceiveMessage is called for each pre verified message with a valid signature. ReceiveMessage is also
      *    responsible for further verification of validity (e.g. validate vvecs and SK contributions).
      */
 
+    template<typename Message>
+    void PrepareMessages(const std::vector<uint256>& hashes, const std::vector<std::pair<NodeId, std::shared_ptr<Message>>>& msgs) {}
+
     // Phase 1: contribution
     void Contribute(CDKGPendingMessages& pendingMessages);
     void SendContributions(CDKGPendingMessages& pendingMessages);
     bool PreVerifyMessage(const uint256& hash, const CDKGContribution& qc, bool& retBan) const;
+    void PrepareMessages(const std::vector<uint256>& hashes, const std::vector<std::pair<NodeId, std::shared_ptr<CDKGContribution>>>& msgs);
     void ReceiveMessage(const uint256& hash, const CDKGContribution& qc, bool& retBan);
+    std::future<DecryptionResult> AsyncDecryptContribution(const std::shared_ptr<CDKGContribution>& qc) const;
     void VerifyPendingContributions();
+    bool ProcessContributionFutures(bool fWait);
 
     // Phase 2: complaint
     void VerifyAndComplain(CDKGPendingMessages& pendingMessages);
@@ -328,6 +361,7 @@ public:
     void VerifyAndCommit(CDKGPendingMessages& pendingMessages);
     void SendCommitment(CDKGPendingMessages& pendingMessages);
     bool PreVerifyMessage(const uint256& hash, const CDKGPrematureCommitment& qc, bool& retBan) const;
+    void PrepareMessages(const std::vector<uint256>& hashes, const std::vector<std::pair<NodeId, std::shared_ptr<CDKGPrematureCommitment>>>& msgs);
     void ReceiveMessage(const uint256& hash, const CDKGPrematureCommitment& qc, bool& retBan);
 
     // Phase 5: aggregate/finalize
@@ -336,10 +370,22 @@ public:
     bool AreWeMember() const { return !myProTxHash.IsNull(); }
     void MarkBadMember(size_t idx);
 
-    void RelayInvToParticipants(const CInv& inv) const;
+    void RelayInvToParticipants(const CInv& inv, bool fOwnMessage);
+    void FlushRelayInvs();
 
 public:
     CDKGMember* GetMember(const uint256& proTxHash) const;
+
+private:
+    enum PrematureCommitmentResult {
+        PrematureCommitment_Valid,
+        PrematureCommitment_Invalid,
+        // we miss contributions needed to build the quorum vvec
+        PrematureCommitment_NoVvec,
+    };
+    BLSVerificationVectorPtr BuildQuorumVvecForCommitment(const CDKGPrematureCommitment& qc, std::vector<uint16_t>& memberIndexesRet);
+    PrematureCommitmentResult VerifyPrematureCommitment(const CDKGPrematureCommitment& qc, const BLSVerificationVectorPtr& quorumVvec,
+                                                        const std::vector<uint16_t>& memberIndexes, std::string& errorRet);
 };
 
 void SetSimulatedDKGErrorRate(const std::string& type, double rate);
@@ -24,7 +24,7 @@ CDKGPendingMessages::CDKGPendingMessages(size_t _maxMessagesPerNode) :
 {
 }
 
-void CDKGPendingMessages::PushPendingMessage(NodeId from, CDataStream& vRecv)
+uint256 CDKGPendingMessages::PushPendingMessage(NodeId from, CDataStream& vRecv)
 {
     // this will also consume the data, even if we bail out early
     auto pm = std::make_shared<CDataStream>(std::move(vRecv));
@@ -35,7 +35,7 @@ void CDKGPendingMessages::PushPendingMessage(NodeId from, CDataStream& vRecv)
         if (messagesPerNode[from] >= maxMessagesPerNode) {
             // TODO ban?
             LogPrintf("CDKGPendingMessages::%s -- too many messages, peer=%d\n", __func__, from);
-            return;
+            return uint256();
         }
         messagesPerNode[from]++;
     }
@@ -47,13 +47,14 @@ void CDKGPendingMessages::PushPendingMessage(NodeId from, CDataStream& vRecv)
     LOCK2(cs_main, cs);
 
     if (!seenMessages.emplace(hash).second) {
-        LogPrint("llmq-dkg", "CDKGPendingMessages::%s -- already seen %s, peer=%d", __func__, from);
-        return;
+        LogPrint("llmq-dkg", "CDKGPendingMessages::%s -- already seen %s, peer=%d\n", __func__, hash.ToString(), from);
+        return hash;
     }
 
     g_connman->RemoveAskFor(hash);
 
     pendingMessages.emplace_back(std::make_pair(from, std::move(pm)));
+    return hash;
 }
 
 std::list<CDKGPendingMessages::BinaryMessage> CDKGPendingMessages::PopPendingMessages(size_t maxCount)
@@ -130,14 +131,19 @@ void CDKGSessionHandler::UpdatedBlockTip(const CBlockIndex* pindexNew)
 void CDKGSessionHandler::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
 {
     // We don't handle messages in the calling thread as deserialization/processing of these would block everything
+    CInv inv;
     if (strCommand == NetMsgType::QCONTRIB) {
-        pendingContributions.PushPendingMessage(pfrom->id, vRecv);
+        inv = CInv(MSG_QUORUM_CONTRIB, pendingContributions.PushPendingMessage(pfrom->id, vRecv));
     } else if (strCommand == NetMsgType::QCOMPLAINT) {
-        pendingComplaints.PushPendingMessage(pfrom->id, vRecv);
+        inv = CInv(MSG_QUORUM_COMPLAINT, pendingComplaints.PushPendingMessage(pfrom->id, vRecv));
     } else if (strCommand == NetMsgType::QJUSTIFICATION) {
-        pendingJustifications.PushPendingMessage(pfrom->id, vRecv);
+        inv = CInv(MSG_QUORUM_JUSTIFICATION, pendingJustifications.PushPendingMessage(pfrom->id, vRecv));
     } else if (strCommand == NetMsgType::QPCOMMITMENT) {
-        pendingPrematureCommitments.PushPendingMessage(pfrom->id, vRecv);
+        inv = CInv(MSG_QUORUM_PREMATURE_COMMITMENT, pendingPrematureCommitments.PushPendingMessage(pfrom->id, vRecv));
+    }
+    if (!inv.hash.IsNull()) {
+        // messages pushed to us without an INV would otherwise be announced back to the sender
+        pfrom->AddInventoryKnown(inv);
     }
 }
 
@@ -164,7 +170,7 @@ bool CDKGSessionHandler::InitNewQuorum(const CBlockIndex* pindexQuorum)
 std::pair<QuorumPhase, uint256> CDKGSessionHandler::GetPhaseAndQuorumHash() const
 {
     LOCK(cs);
-    return std::make_pair(phase, quorumHash);
+    return std::make_pair(phase.load(), quorumHash);
 }
 
 class AbortPhaseException : public std::exception {
@@ -261,9 +267,31 @@ void CDKGSessionHandler::HandlePhase(QuorumPhase curPhase,
                                      const StartPhaseFunc& startPhaseFunc,
                                      const WhileWaitFunc& runWhileWaiting)
 {
-    SleepBeforePhase(curPhase, expectedQuorumHash, randomSleepFactor, runWhileWaiting);
+    int64_t nMessageTime = 0;
+    uint32_t nMessageBatches = 0;
+    auto timedRunWhileWaiting = [&]() {
+        int64_t nStart = GetTimeMicros();
+        bool processed = runWhileWaiting();
+        if (processed) {
+            nMessageTime += GetTimeMicros() - nStart;
+            nMessageBatches++;
+        }
+        return processed;
+    };
+
+    SleepBeforePhase(curPhase, expectedQuorumHash, randomSleepFactor, timedRunWhileWaiting);
+    int64_t nStart = GetTimeMicros();
     startPhaseFunc();
-    WaitForNextPhase(curPhase, nextPhase, expectedQuorumHash, runWhileWaiting);
+    int64_t nStartTime = GetTimeMicros() - nStart;
+    WaitForNextPhase(curPhase, nextPhase, expectedQuorumHash, timedRunWhileWaiting);
+
+    quorumDKGDebugManager->UpdateLocalSessionStatus(params.type, [&](CDKGDebugSessionStatus& status) {
+        auto& phaseTime = status.phaseTimes[curPhase - QuorumPhase_Contribute];
+        phaseTime.startTime = nStartTime;
+        phaseTime.messageTime = nMessageTime;
+        phaseTime.messageBatches = nMessageBatches;
+        return true;
+    });
 }
 
 // returns a set of NodeIds which sent invalid messages
@@ -362,9 +390,9 @@ std::set<NodeId> BatchVerifyMessageSigs(CDKGSession& session, const std::vector<
 }
 
 template<typename Message>
-bool ProcessPendingMessageBatch(CDKGSession& session, CDKGPendingMessages& pendingMessages, size_t maxCount)
+bool ProcessPendingMessageBatchInternal(CDKGSession& session, CDKGPendingMessages& pendingMessages, CBLSWorker& blsWorker, size_t maxCount)
 {
-    auto msgs = pendingMessages.PopAndDeserializeMessages<Message>(maxCount);
+    auto msgs = pendingMessages.PopAndDeserializeMessages<Message>(maxCount, blsWorker);
     if (msgs.empty()) {
         return false;
     }
@@ -417,8 +445,21 @@ bool ProcessPendingMessageBatch(CDKGSession& session, CDKGPendingMessages& pendi
             LogPrintf("%s -- failed to verify signature, peer=%d\n", __func__, nodeId);
             Misbehaving(nodeId, 100);
         }
+
+        std::vector<uint256> goodHashes;
+        std::vector<std::pair<NodeId, std::shared_ptr<Message>>> goodMessages;
+        for (size_t i = 0; i < preverifiedMessages.size(); i++) {
+            if (!badNodes.count(preverifiedMessages[i].first)) {
+                goodHashes.emplace_back(hashes[i]);
+                goodMessages.emplace_back(preverifiedMessages[i]);
+            }
+        }
+        hashes = std::move(goodHashes);
+        preverifiedMessages = std::move(goodMessages);
     }
 
+    session.PrepareMessages(hashes, preverifiedMessages);
+
     for (size_t i = 0; i < preverifiedMessages.size(); i++) {
         NodeId nodeId = preverifiedMessages[i].first;
         if (badNodes.count(nodeId)) {
@@ -438,6 +479,15 @@ bool ProcessPendingMessageBatch(CDKGSession& session, CDKGPendingMessages& pendi
     return true;
 }
 
+template<typename Message>
+bool ProcessPendingMessageBatch(CDKGSession& session, CDKGPendingMessages& pendingMessages, CBLSWorker& blsWorker, size_t maxCount)
+{
+    bool processed = ProcessPendingMessageBatchInternal<Message>(session, pendingMessages, blsWorker, maxCount);
+    // relay everything the batch accepted at once
+    session.FlushRelayInvs();
+    return processed;
+}
+
 void CDKGSessionHandler::HandleDKGRound()
 {
     uint256 curQuorumHash;
@@ -497,7 +547,7 @@ void CDKGSessionHandler::HandleDKGRound()
                 }
                 LogPrint("llmq-dkg", debugMsg);
             }
-            g_connman->AddMasternodeQuorumNodes(params.type, curQuorumHash, connections);
+            g_connman->AddMasternodeQuorumNodes(params.type, curQuorumHash, connections, true);
         }
     }
 
@@ -508,7 +558,10 @@ void CDKGSessionHandler::HandleDKGRound()
         curSession->Contribute(pendingContributions);
     };
     auto fContributeWait = [this] {
-        return ProcessPendingMessageBatch<CDKGContribution>(*curSession, pendingContributions, 8);
+        bool processed = ProcessPendingMessageBatch<CDKGContribution>(*curSession, pendingContributions, blsWorker, 8);
+        // pick up decryptions and verifications which finished in the meantime
+        processed |= curSession->ProcessContributionFutures(false);
+        return processed;
     };
     HandlePhase(QuorumPhase_Contribute, QuorumPhase_Complain, curQuorumHash, 0.05, fContributeStart, fContributeWait);
 
@@ -517,7 +570,7 @@ void CDKGSessionHandler::HandleDKGRound()
         curSession->VerifyAndComplain(pendingComplaints);
     };
     auto fComplainWait = [this] {
-        return ProcessPendingMessageBatch<CDKGComplaint>(*curSession, pendingComplaints, 8);
+        return ProcessPendingMessageBatch<CDKGComplaint>(*curSession, pendingComplaints, blsWorker, 8);
     };
     HandlePhase(QuorumPhase_Complain, QuorumPhase_Justify, curQuorumHash, 0.05, fComplainStart, fComplainWait);
 
@@ -526,7 +579,7 @@ void CDKGSessionHandler::HandleDKGRound()
         curSession->VerifyAndJustify(pendingJustifications);
     };
     auto fJustifyWait = [this] {
-        return ProcessPendingMessageBatch<CDKGJustification>(*curSession, pendingJustifications, 8);
+        return ProcessPendingMessageBatch<CDKGJustification>(*curSession, pendingJustifications, blsWorker, 8);
     };
     HandlePhase(QuorumPhase_Justify, QuorumPhase_Commit, curQuorumHash, 0.05, fJustifyStart, fJustifyWait);
 
@@ -535,11 +588,16 @@ void CDKGSessionHandler::HandleDKGRound()
         curSession->VerifyAndCommit(pendingPrematureCommitments);
     };
     auto fCommitWait = [this] {
-        return ProcessPendingMessageBatch<CDKGPrematureCommitment>(*curSession, pendingPrematureCommitments, 8);
+        return ProcessPendingMessageBatch<CDKGPrematureCommitment>(*curSession, pendingPrematureCommitments, blsWorker, 8);
     };
     HandlePhase(QuorumPhase_Commit, QuorumPhase_Finalize, curQuorumHash, 0.1, fCommitStart, fCommitWait);
 
+    int64_t nFinalizeStart = GetTimeMicros();
     auto finalCommitments = curSession->FinalizeCommitments();
+    quorumDKGDebugManager->UpdateLocalSessionStatus(params.type, [&](CDKGDebugSessionStatus& status) {
+        status.phaseTimes[QuorumPhase_Finalize - QuorumPhase_Contribute].startTime = GetTimeMicros() - nFinalizeStart;
+        return true;
+    });
     for (const auto& fqc : finalCommitments) {
         quorumBlockProcessor->AddMinableCommitment(fqc);
     }
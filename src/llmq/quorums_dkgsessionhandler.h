@@ -50,7 +50,8 @@ private:
 public:
     CDKGPendingMessages(size_t _maxMessagesPerNode);
 
-    void PushPendingMessage(NodeId from, CDataStream& vRecv);
+    // returns the hash of the message, or a null hash if it was dropped because the peer sent too many
+    uint256 PushPendingMessage(NodeId from, CDataStream& vRecv);
     std::list<BinaryMessage> PopPendingMessages(size_t maxCount);
     bool HasSeen(const uint256& hash) const;
     void Clear();
@@ -86,6 +87,39 @@ public:
 
         return std::move(ret);
     }
+
+    // Same as above, but deserializes the messages in parallel on the BLS workers. Deserialization of DKG messages is
+    // dominated by decompression of BLS keys and signatures, which is expensive
+    template<typename Message>
+    std::vector<std::pair<NodeId, std::shared_ptr<Message>>> PopAndDeserializeMessages(size_t maxCount, CBLSWorker& blsWorker)
+    {
+        auto binaryMessages = PopPendingMessages(maxCount);
+        if (binaryMessages.empty()) {
+            return {};
+        }
+
+        std::vector<std::pair<NodeId, std::shared_ptr<Message>>> ret;
+        std::vector<std::future<void>> futures;
+        ret.reserve(binaryMessages.size());
+        futures.reserve(binaryMessages.size());
+        for (const auto& bm : binaryMessages) {
+            ret.emplace_back(std::make_pair(bm.first, std::make_shared<Message>()));
+            auto& msg = ret.back().second;
+            auto& ds = bm.second;
+            futures.emplace_back(blsWorker.AsyncRun([&msg, &ds]() {
+                try {
+                    *ds >> *msg;
+                } catch (...) {
+                    msg = nullptr;
+                }
+            }));
+        }
+        for (auto& f : futures) {
+            f.get();
+        }
+
+        return std::move(ret);
+    }
 };
 
 /**
@@ -108,7 +142,7 @@ private:
     CBLSWorker& blsWorker;
     CDKGSessionManager& dkgManager;
 
-    QuorumPhase phase{QuorumPhase_Idle};
+    std::atomic<QuorumPhase> phase{QuorumPhase_Idle};
     int quorumHeight{-1};
     uint256 quorumHash;
     std::shared_ptr<CDKGSession> curSession;
@@ -126,6 +160,9 @@ public:
     void UpdatedBlockTip(const CBlockIndex *pindexNew);
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
 
+    /** Lock free, for monitoring */
+    QuorumPhase GetPhase() const { return phase; }
+
 private:
 	bool InitNewQuorum(const CBlockIndex* pindexQuorum);
 
@@ -121,6 +121,15 @@ bool CDKGSessionManager::AlreadyHave(const CInv& inv) const
     return false;
 }
 
+std::map<Consensus::LLMQType, QuorumPhase> CDKGSessionManager::GetPhases() const
+{
+    std::map<Consensus::LLMQType, QuorumPhase> ret;
+    for (const auto& p : dkgSessionHandlers) {
+        ret.emplace(p.first, p.second.GetPhase());
+    }
+    return ret;
+}
+
 bool CDKGSessionManager::GetContribution(const uint256& hash, CDKGContribution& ret) const
 {
     if (!sporkManager.IsSporkActive(SPORK_17_QUORUM_DKG_ENABLED))
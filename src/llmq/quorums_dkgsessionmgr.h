@@ -64,6 +64,9 @@ public:
     bool GetJustification(const uint256& hash, CDKGJustification& ret) const;
     bool GetPrematureCommitment(const uint256& hash, CDKGPrematureCommitment& ret) const;
 
+    /** The current DKG phase of every LLMQ type, without taking any lock */
+    std::map<Consensus::LLMQType, QuorumPhase> GetPhases() const;
+
     // Verified contributions are written while in the DKG
 	void WriteVerifiedVvecContribution(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum, const uint256& proTxHash, const BLSVerificationVectorPtr& vvec);
 	void WriteVerifiedSkContribution(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum, const uint256& proTxHash, const CBLSSecretKey& skContribution);
@@ -7,6 +7,7 @@
 #ifndef EPMCOIN_QUORUMS_INIT_H
 #define EPMCOIN_QUORUMS_INIT_H
 
+class CBLSWorker;
 class CDBWrapper;
 class CEvoDB;
 class CScheduler;
@@ -14,8 +15,12 @@ class CScheduler;
 namespace llmq
 {
 
+extern CBLSWorker* blsWorker;
+
 // If true, we will connect to all new quorums and watch their communication
 static const bool DEFAULT_WATCH_QUORUMS = false;
+// If true, our own DKG messages are sent directly to our quorum connections instead of announcing them first
+static const bool DEFAULT_PUSH_DKG_MESSAGES = true;
 
 // Init/destroy LLMQ globals
 void InitLLMQSystem(CEvoDB& evoDb, CScheduler* scheduler, bool unitTests, bool fWipe = false);
@@ -5,16 +5,20 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "quorums_chainlocks.h"
+#include "quorums_init.h"
 #include "quorums_instantsend.h"
 #include "quorums_utils.h"
 
 #include "bls/bls_batchverifier.h"
+#include "bls/bls_sigcache.h"
 #include "chainparams.h"
 #include "coins.h"
 #include "txmempool.h"
 #include "masternode-sync.h"
+#include "metrics.h"
 #include "net_processing.h"
 #include "spork.h"
+#include "tracing.h"
 #include "validation.h"
 
 #ifdef ENABLE_WALLET
@@ -45,6 +49,33 @@ uint256 CInstantSendLock::GetRequestId() const
 
 ////////////////
 
+CInstantSendDb::CInstantSendDb(CDBWrapper& _db) :
+    db(_db)
+{
+    CDBPrefixIterator it(db, std::string("is_i"));
+
+    while (it.Valid()) {
+        std::tuple<std::string, uint256> curKey;
+        if (!it.GetKey(curKey)) {
+            break;
+        }
+
+        auto islock = std::make_shared<CInstantSendLock>();
+        if (it.GetValue(*islock)) {
+            auto& hash = std::get<1>(curKey);
+            activeLocks.emplace(hash, islock);
+            activeLocksByTxid.emplace(islock->txid, hash);
+            for (auto& in : islock->inputs) {
+                activeLocksByInput.emplace(in, hash);
+            }
+        }
+
+        it.Next();
+    }
+
+    LogPrint("instantsend", "CInstantSendDb::%s -- loaded %d active ISLOCKs\n", __func__, activeLocks.size());
+}
+
 void CInstantSendDb::WriteNewInstantSendLock(const uint256& hash, const CInstantSendLock& islock)
 {
     CDBBatch batch(db);
@@ -56,10 +87,10 @@ void CInstantSendDb::WriteNewInstantSendLock(const uint256& hash, const CInstant
     db.WriteBatch(batch);
 
     auto p = std::make_shared<CInstantSendLock>(islock);
-    islockCache.insert(hash, p);
-    txidCache.insert(islock.txid, hash);
+    activeLocks[hash] = p;
+    activeLocksByTxid[islock.txid] = hash;
     for (auto& in : islock.inputs) {
-        outpointCache.insert(in, hash);
+        activeLocksByInput[in] = hash;
     }
 }
 
@@ -78,10 +109,16 @@ void CInstantSendDb::RemoveInstantSendLock(CDBBatch& batch, const uint256& hash,
         batch.Erase(std::make_tuple(std::string("is_in"), in));
     }
 
-    islockCache.erase(hash);
-    txidCache.erase(islock->txid);
+    activeLocks.erase(hash);
+    auto itTxid = activeLocksByTxid.find(islock->txid);
+    if (itTxid != activeLocksByTxid.end() && itTxid->second == hash) {
+        activeLocksByTxid.erase(itTxid);
+    }
     for (auto& in : islock->inputs) {
-        outpointCache.erase(in);
+        auto itInput = activeLocksByInput.find(in);
+        if (itInput != activeLocksByInput.end() && itInput->second == hash) {
+            activeLocksByInput.erase(itInput);
+        }
     }
 }
 
@@ -182,60 +219,34 @@ bool CInstantSendDb::HasArchivedInstantSendLock(const uint256& islockHash)
 
 size_t CInstantSendDb::GetInstantSendLockCount()
 {
-    auto it = std::unique_ptr<CDBIterator>(db.NewIterator());
-    auto firstKey = std::make_tuple(std::string("is_i"), uint256());
-
-    it->Seek(firstKey);
-
-    size_t cnt = 0;
-    while (it->Valid()) {
-        decltype(firstKey) curKey;
-        if (!it->GetKey(curKey) || std::get<0>(curKey) != "is_i") {
-            break;
-        }
-
-        cnt++;
+    return activeLocks.size();
+}
 
-        it->Next();
+size_t CInstantSendDb::DynamicMemoryUsage() const
+{
+    size_t nUsage = memusage::DynamicUsage(activeLocks) + memusage::DynamicUsage(activeLocksByTxid) + memusage::DynamicUsage(activeLocksByInput);
+    for (const auto& p : activeLocks) {
+        nUsage += memusage::DynamicUsage(p.second) + memusage::DynamicUsage(p.second->inputs);
     }
-
-    return cnt;
+    return nUsage;
 }
 
 CInstantSendLockPtr CInstantSendDb::GetInstantSendLockByHash(const uint256& hash)
 {
-    CInstantSendLockPtr ret;
-    if (islockCache.get(hash, ret)) {
-        return ret;
-    }
-
-    ret = std::make_shared<CInstantSendLock>();
-    bool exists = db.Read(std::make_tuple(std::string("is_i"), hash), *ret);
-    if (!exists) {
-        ret = nullptr;
+    auto it = activeLocks.find(hash);
+    if (it == activeLocks.end()) {
+        return nullptr;
     }
-    islockCache.insert(hash, ret);
-    return ret;
+    return it->second;
 }
 
 uint256 CInstantSendDb::GetInstantSendLockHashByTxid(const uint256& txid)
 {
-    uint256 islockHash;
-
-    bool found = txidCache.get(txid, islockHash);
-    if (found && islockHash.IsNull()) {
-        return uint256();
-    }
-
-    if (!found) {
-        found = db.Read(std::make_tuple(std::string("is_tx"), txid), islockHash);
-        txidCache.insert(txid, islockHash);
-    }
-
-    if (!found) {
+    auto it = activeLocksByTxid.find(txid);
+    if (it == activeLocksByTxid.end()) {
         return uint256();
     }
-    return islockHash;
+    return it->second;
 }
 
 CInstantSendLockPtr CInstantSendDb::GetInstantSendLockByTxid(const uint256& txid)
@@ -249,47 +260,27 @@ CInstantSendLockPtr CInstantSendDb::GetInstantSendLockByTxid(const uint256& txid
 
 CInstantSendLockPtr CInstantSendDb::GetInstantSendLockByInput(const COutPoint& outpoint)
 {
-    uint256 islockHash;
-    bool found = outpointCache.get(outpoint, islockHash);
-    if (found && islockHash.IsNull()) {
+    auto it = activeLocksByInput.find(outpoint);
+    if (it == activeLocksByInput.end()) {
         return nullptr;
     }
-
-    if (!found) {
-        found = db.Read(std::make_tuple(std::string("is_in"), outpoint), islockHash);
-        outpointCache.insert(outpoint, islockHash);
-    }
-
-    if (!found) {
-        return nullptr;
-    }
-    return GetInstantSendLockByHash(islockHash);
+    return GetInstantSendLockByHash(it->second);
 }
 
 std::vector<uint256> CInstantSendDb::GetInstantSendLocksByParent(const uint256& parent)
 {
-    auto it = std::unique_ptr<CDBIterator>(db.NewIterator());
-    auto firstKey = std::make_tuple(std::string("is_in"), COutPoint(parent, 0));
-    it->Seek(firstKey);
+    // ("is_in", outpoint) keys of all outputs of parent start with ("is_in", parent)
+    CDBPrefixIterator it(db, std::make_tuple(std::string("is_in"), parent));
 
     std::vector<uint256> result;
 
-    while (it->Valid()) {
-        decltype(firstKey) curKey;
-        if (!it->GetKey(curKey) || std::get<0>(curKey) != "is_in") {
-            break;
-        }
-        auto& outpoint = std::get<1>(curKey);
-        if (outpoint.hash != parent) {
-            break;
-        }
-
+    while (it.Valid()) {
         uint256 islockHash;
-        if (!it->GetValue(islockHash)) {
+        if (!it.GetValue(islockHash)) {
             break;
         }
         result.emplace_back(islockHash);
-        it->Next();
+        it.Next();
     }
 
     return result;
@@ -376,25 +367,98 @@ void CInstantSendManager::InterruptWorkerThread()
     workInterrupt();
 }
 
-bool CInstantSendManager::ProcessTx(const CTransaction& tx, bool allowReSigning, const Consensus::Params& params)
+void CInstantSendManager::ProcessTxs(const std::vector<std::pair<CTransactionRef, bool>>& txs, const Consensus::Params& params)
 {
     if (!IsNewInstantSendEnabled()) {
-        return true;
+        return;
     }
 
     auto llmqType = params.llmqForInstaEPM;
     if (llmqType == Consensus::LLMQ_NONE) {
-        return true;
+        return;
     }
     if (!fMasternodeMode) {
-        return true;
+        return;
     }
 
     // Ignore any InstaEPM messages until blockchain is synced
     if (!masternodeSync.IsBlockchainSynced()) {
-        return true;
+        return;
+    }
+
+    // input locks to vote on, split by allowReSigning
+    std::vector<std::pair<uint256, uint256>> inputLocks[2];
+    std::vector<CTransactionRef> votedTxs;
+    votedTxs.reserve(txs.size());
+    for (const auto& p : txs) {
+        auto& tx = p.first;
+        std::vector<uint256> ids;
+        if (!ProcessTx(*tx, p.second, params, ids) || ids.empty()) {
+            continue;
+        }
+        for (auto& id : ids) {
+            inputLocks[p.second].emplace_back(id, tx->GetHash());
+        }
+        votedTxs.emplace_back(tx);
+    }
+    if (votedTxs.empty()) {
+        return;
+    }
+
+    {
+        LOCK(cs);
+        for (auto& v : inputLocks) {
+            for (auto& p : v) {
+                inputRequestIds.emplace(p.first);
+            }
+        }
     }
 
+    size_t signCount = 0;
+    for (bool allowReSigning : {false, true}) {
+        if (!inputLocks[allowReSigning].empty()) {
+            signCount += quorumSigningManager->AsyncSignIfMember(llmqType, inputLocks[allowReSigning], allowReSigning);
+        }
+    }
+    LogPrint("instantsend", "CInstantSendManager::%s -- voted on %d of %d inputs of %d TXs\n", __func__,
+             signCount, inputLocks[0].size() + inputLocks[1].size(), votedTxs.size());
+
+    // We might have received all input locks before we got the corresponding TX. In this case, we have to sign the
+    // islock now instead of waiting for the input locks.
+    for (auto& tx : votedTxs) {
+        TrySignInstantSendLock(*tx);
+    }
+}
+
+bool CInstantSendManager::ProcessPendingSignTxs()
+{
+    decltype(pendingSignTxs) signTxs;
+    {
+        LOCK(cs);
+        signTxs = std::move(pendingSignTxs);
+        pendingSignTxs.clear();
+    }
+
+    if (signTxs.empty()) {
+        return false;
+    }
+
+    std::vector<std::pair<CTransactionRef, bool>> txs;
+    txs.reserve(signTxs.size());
+    for (auto& p : signTxs) {
+        txs.emplace_back(std::move(p.second));
+    }
+    ProcessTxs(txs, Params().GetConsensus());
+
+    return true;
+}
+
+// Checks if we should vote on the inputs of this TX. Returns false if the TX can't be locked. inputIdsRet is left
+// empty if there is nothing to vote on
+bool CInstantSendManager::ProcessTx(const CTransaction& tx, bool allowReSigning, const Consensus::Params& params, std::vector<uint256>& inputIdsRet)
+{
+    auto llmqType = params.llmqForInstaEPM;
+
     // In case the islock was received before the TX, filtered announcement might have missed this islock because
     // we were unable to check for filter matches deep inside the TX. Now we have the TX, so we should retry.
     uint256 islockHash;
@@ -452,25 +516,10 @@ bool CInstantSendManager::ProcessTx(const CTransaction& tx, bool allowReSigning,
         return true;
     }
 
-	LogPrint("instantsend", "CInstantSendManager::%s -- txid=%s: trying to vote on %d inputs\n", __func__,
-		tx.GetHash().ToString(), tx.vin.size());
-
-    for (size_t i = 0; i < tx.vin.size(); i++) {
-        auto& in = tx.vin[i];
-        auto& id = ids[i];
-        inputRequestIds.emplace(id);
-		LogPrint("instantsend", "CInstantSendManager::%s -- txid=%s: trying to vote on input %s with id %s. allowReSigning=%d\n", __func__,
-			tx.GetHash().ToString(), in.prevout.ToStringShort(), id.ToString(), allowReSigning);
-        if (quorumSigningManager->AsyncSignIfMember(llmqType, id, tx.GetHash(), allowReSigning)) {
-			LogPrint("instantsend", "CInstantSendManager::%s -- txid=%s: voted on input %s with id %s\n", __func__,
-                      tx.GetHash().ToString(), in.prevout.ToStringShort(), id.ToString());
-        }
-    }
-
-    // We might have received all input locks before we got the corresponding TX. In this case, we have to sign the
-    // islock now instead of waiting for the input locks.
-    TrySignInstantSendLock(tx);
+	LogPrint("instantsend", "CInstantSendManager::%s -- txid=%s: trying to vote on %d inputs. allowReSigning=%d\n", __func__,
+		tx.GetHash().ToString(), tx.vin.size(), allowReSigning);
 
+    inputIdsRet = std::move(ids);
     return true;
 }
 
@@ -773,7 +822,7 @@ bool CInstantSendManager::ProcessPendingInstantSendLocks()
 
     if (quorumsRotated) {
         // first check against the current active set and don't ban
-        auto badISLocks = ProcessPendingInstantSendLocks(tipHeight, pend, false);
+        auto badISLocks = ProcessPendingInstantSendLocks(quorums1, pend, false);
         if (!badISLocks.empty()) {
             LogPrintf("CInstantSendManager::%s -- detected LLMQ active set rotation, redoing verification on old active set\n", __func__);
 
@@ -786,21 +835,30 @@ bool CInstantSendManager::ProcessPendingInstantSendLocks()
                 }
             }
             // now check against the previous active set and perform banning if this fails
-            ProcessPendingInstantSendLocks(tipHeight - 1, pend, true);
+            ProcessPendingInstantSendLocks(quorums2, pend, true);
         }
     } else {
-        ProcessPendingInstantSendLocks(tipHeight, pend, true);
+        ProcessPendingInstantSendLocks(quorums1, pend, true);
     }
 
     return true;
 }
 
-std::unordered_set<uint256> CInstantSendManager::ProcessPendingInstantSendLocks(int signHeight, const std::unordered_map<uint256, std::pair<NodeId, CInstantSendLock>>& pend, bool ban)
+// The active quorum set is resolved once by the caller for the sign height. Signatures are verified in parallel
+// chunks on the BLS workers, while the results are processed in order on this thread
+std::unordered_set<uint256> CInstantSendManager::ProcessPendingInstantSendLocks(const std::vector<CQuorumCPtr>& quorums, const std::unordered_map<uint256, std::pair<NodeId, CInstantSendLock>>& pend, bool ban)
 {
     auto llmqType = Params().GetConsensus().llmqForInstaEPM;
 
+    if (quorums.empty()) {
+        // if no quorum can be selected, none of the ISLOCKs can be verified
+        return {};
+    }
+
     CBLSBatchVerifier<NodeId, uint256> batchVerifier(false, true, 8);
     std::unordered_map<uint256, std::pair<CQuorumCPtr, CRecoveredSig>> recSigs;
+    std::vector<std::pair<uint256, uint256>> cacheEntries;
+    size_t verifyCount = 0;
 
     for (const auto& p : pend) {
         auto& hash = p.first;
@@ -823,13 +881,13 @@ std::unordered_set<uint256> CInstantSendManager::ProcessPendingInstantSendLocks(
             continue;
         }
 
-        auto quorum = quorumSigningManager->SelectQuorumForSigning(llmqType, signHeight, id);
-        if (!quorum) {
-            // should not happen, but if one fails to select, all others will also fail to select
-            return {};
-        }
+        auto quorum = CSigningManager::SelectQuorumForSigning(llmqType, quorums, id);
         uint256 signHash = CLLMQUtils::BuildSignHash(llmqType, quorum->qc.quorumHash, id, islock.txid);
-        batchVerifier.PushMessage(nodeId, hash, signHash, islock.sig.Get(), quorum->qc.quorumPublicKey);
+        uint256 entry = ComputeBLSSignatureCacheEntry(quorum->qc.quorumPublicKey.GetHash(), signHash, islock.sig.Get());
+        if (!BLSSignatureCacheContains(entry)) {
+            batchVerifier.PushMessage(nodeId, hash, signHash, islock.sig.Get(), quorum->qc.quorumPublicKey.Get());
+            cacheEntries.emplace_back(hash, entry);
+        }
 
         // We can reconstruct the CRecoveredSig objects from the islock and pass it to the signing manager, which
         // avoids unnecessary double-verification of the signature. We however only do this when verification here
@@ -845,9 +903,18 @@ std::unordered_set<uint256> CInstantSendManager::ProcessPendingInstantSendLocks(
                     std::forward_as_tuple(hash),
                     std::forward_as_tuple(std::move(quorum), std::move(recSig)));
         }
+        verifyCount++;
     }
 
-    batchVerifier.Verify();
+    size_t nChunks = std::max<size_t>(1, verifyCount / ISLOCKS_PER_VERIFY_CHUNK);
+    batchVerifier.VerifyBisect(nChunks, [](std::function<void()> job) {
+        return blsWorker->AsyncRun(std::move(job));
+    });
+    for (const auto& p : cacheEntries) {
+        if (!batchVerifier.badMessages.count(p.first)) {
+            BLSSignatureCacheAdd(p.second);
+        }
+    }
 
     std::unordered_set<uint256> badISLocks;
 
@@ -946,6 +1013,8 @@ void CInstantSendManager::ProcessInstantSendLock(NodeId from, const uint256& has
         }
 
         db.WriteNewInstantSendLock(hash, islock);
+        g_metrics.nInstantSendLocks++;
+        TRACE4(llmq, islock_processed, islock.txid.begin(), hash.begin(), islock.inputs.size(), from);
         if (pindexMined) {
             db.WriteInstantSendLockMined(hash, pindexMined->nHeight);
         }
@@ -986,7 +1055,7 @@ void CInstantSendManager::UpdateWalletTransaction(const uint256& txid, const CTr
 #endif
 
     if (tx) {
-        GetMainSignals().NotifyTransactionLock(*tx);
+        GetMainSignals().NotifyTransactionLock(tx);
         // bump mempool counter to make sure newly mined txes are picked up by getblocktemplate
         mempool.AddTransactionsUpdated(1);
     }
@@ -1042,14 +1111,19 @@ void CInstantSendManager::SyncTransaction(const CTransaction& tx, const CBlockIn
     }
 
     bool chainlocked = pindex && chainLocksHandler->HasChainLock(pindex->nHeight, pindex->GetBlockHash());
-    if (islockHash.IsNull() && !chainlocked) {
-        ProcessTx(tx, allowReSigning, Params().GetConsensus());
-    }
 
     LOCK(cs);
     if (!chainlocked && islockHash.IsNull()) {
+        auto txRef = MakeTransactionRef(tx);
+        if (fMasternodeMode) {
+            // voting on the inputs is done in batches by the worker thread
+            auto& p = pendingSignTxs[tx.GetHash()];
+            p.first = txRef;
+            p.second |= allowReSigning;
+        }
+
         // TX is not locked, so make sure it is tracked
-        AddNonLockedTx(MakeTransactionRef(tx));
+        AddNonLockedTx(txRef);
         nonLockedTxs.at(tx.GetHash()).pindexMined = !isDisconnect ? pindex : nullptr;
     } else {
         // TX is locked, so make sure we don't track it anymore
@@ -1390,7 +1464,7 @@ bool CInstantSendManager::ProcessPendingRetryLockTxs()
         return false;
     }
 
-    int retryCount = 0;
+    std::vector<std::pair<CTransactionRef, bool>> txs;
     for (const auto& txid : retryTxs) {
         CTransactionRef tx;
         {
@@ -1428,9 +1502,10 @@ bool CInstantSendManager::ProcessPendingRetryLockTxs()
                      tx->GetHash().ToString());
         }
 
-        ProcessTx(*tx, false, Params().GetConsensus());
-        retryCount++;
+        txs.emplace_back(tx, false);
     }
+    int retryCount = (int)txs.size();
+    ProcessTxs(txs, Params().GetConsensus());
 
     if (retryCount != 0) {
         LOCK(cs);
@@ -1503,15 +1578,40 @@ CInstantSendLockPtr CInstantSendManager::GetConflictingLock(const CTransaction&
 
 size_t CInstantSendManager::GetInstantSendLockCount()
 {
+    LOCK(cs);
     return db.GetInstantSendLockCount();
 }
 
+memusage::SubsystemUsage CInstantSendManager::GetMemoryUsage()
+{
+    LOCK(cs);
+    memusage::SubsystemUsage usage;
+    usage.nEntries = db.GetInstantSendLockCount() + creatingInstantSendLocks.size() + pendingInstantSendLocks.size() + nonLockedTxs.size();
+    // the transactions are shared with the mempool and the blocks, only the references are counted
+    usage.nBytes = db.DynamicMemoryUsage() + memusage::DynamicUsage(inputRequestIds) +
+                   memusage::DynamicUsage(creatingInstantSendLocks) + memusage::DynamicUsage(txToCreatingInstantSendLocks) +
+                   memusage::DynamicUsage(pendingInstantSendLocks) + memusage::DynamicUsage(nonLockedTxs) +
+                   memusage::DynamicUsage(nonLockedTxsByInputs) + memusage::DynamicUsage(pendingRetryTxs) +
+                   memusage::DynamicUsage(pendingSignTxs);
+    for (const auto& p : creatingInstantSendLocks) {
+        usage.nBytes += memusage::DynamicUsage(p.second.inputs);
+    }
+    for (const auto& p : pendingInstantSendLocks) {
+        usage.nBytes += memusage::DynamicUsage(p.second.second.inputs);
+    }
+    for (const auto& p : nonLockedTxs) {
+        usage.nBytes += memusage::DynamicUsage(p.second.children);
+    }
+    return usage;
+}
+
 void CInstantSendManager::WorkThreadMain()
 {
     while (!workInterrupt) {
         bool didWork = false;
 
         didWork |= ProcessPendingInstantSendLocks();
+        didWork |= ProcessPendingSignTxs();
         didWork |= ProcessPendingRetryLockTxs();
 
         if (!didWork) {
@@ -10,7 +10,6 @@
 #include "quorums_signing.h"
 
 #include "coins.h"
-#include "unordered_lru_cache.h"
 #include "primitives/transaction.h"
 
 #include <unordered_map>
@@ -47,12 +46,15 @@ class CInstantSendDb
 private:
     CDBWrapper& db;
 
-    unordered_lru_cache<uint256, CInstantSendLockPtr, StaticSaltedHasher, 10000> islockCache;
-    unordered_lru_cache<uint256, uint256, StaticSaltedHasher, 10000> txidCache;
-    unordered_lru_cache<COutPoint, uint256, SaltedOutpointHasher, 10000> outpointCache;
+    // In-memory index of all ISLOCKs which are not confirmed yet (or only recently mined), which is exactly the set of
+    // ISLOCKs which are still in the DB. It is loaded once on startup and lets all lookups from the hot paths (mempool,
+    // mining and wallet) avoid any DB access. The DB only acts as the persistence layer
+    std::unordered_map<uint256, CInstantSendLockPtr, StaticSaltedHasher> activeLocks;
+    std::unordered_map<uint256, uint256, StaticSaltedHasher> activeLocksByTxid;
+    std::unordered_map<COutPoint, uint256, SaltedOutpointHasher> activeLocksByInput;
 
 public:
-    CInstantSendDb(CDBWrapper& _db) : db(_db) {}
+    CInstantSendDb(CDBWrapper& _db);
 
     void WriteNewInstantSendLock(const uint256& hash, const CInstantSendLock& islock);
     void RemoveInstantSendLock(CDBBatch& batch, const uint256& hash, CInstantSendLockPtr islock);
@@ -64,6 +66,7 @@ public:
     void RemoveArchivedInstantSendLocks(int nUntilHeight);
     bool HasArchivedInstantSendLock(const uint256& islockHash);
     size_t GetInstantSendLockCount();
+    size_t DynamicMemoryUsage() const;
 
     CInstantSendLockPtr GetInstantSendLockByHash(const uint256& hash);
     uint256 GetInstantSendLockHashByTxid(const uint256& txid);
@@ -77,6 +80,9 @@ public:
 class CInstantSendManager : public CRecoveredSigsListener
 {
 private:
+    // Pending ISLOCKs are verified in chunks of at least this size on the BLS workers
+    static const size_t ISLOCKS_PER_VERIFY_CHUNK = 32;
+
     CCriticalSection cs;
     CInstantSendDb db;
 
@@ -113,6 +119,13 @@ private:
 
     std::unordered_set<uint256, StaticSaltedHasher> pendingRetryTxs;
 
+    /**
+     * TXs we want to vote on, queued by SyncTransaction. The worker thread votes on all inputs of all queued TXs in one
+     * batch, so that bursts of TXs result in few signing batches instead of one signing request per input.
+     * The bool is allowReSigning
+     */
+    std::unordered_map<uint256, std::pair<CTransactionRef, bool>, StaticSaltedHasher> pendingSignTxs;
+
 public:
     CInstantSendManager(CDBWrapper& _llmqDb);
     ~CInstantSendManager();
@@ -122,7 +135,9 @@ public:
     void InterruptWorkerThread();
 
 public:
-    bool ProcessTx(const CTransaction& tx, bool allowReSigning, const Consensus::Params& params);
+    bool ProcessTx(const CTransaction& tx, bool allowReSigning, const Consensus::Params& params, std::vector<uint256>& inputIdsRet);
+    void ProcessTxs(const std::vector<std::pair<CTransactionRef, bool>>& txs, const Consensus::Params& params);
+    bool ProcessPendingSignTxs();
     bool CheckCanLock(const CTransaction& tx, bool printDebug, const Consensus::Params& params);
     bool CheckCanLock(const COutPoint& outpoint, bool printDebug, const uint256& txHash, CAmount* retValue, const Consensus::Params& params);
     bool IsLocked(const uint256& txHash);
@@ -139,7 +154,7 @@ public:
     void ProcessMessageInstantSendLock(CNode* pfrom, const CInstantSendLock& islock, CConnman& connman);
     bool PreVerifyInstantSendLock(NodeId nodeId, const CInstantSendLock& islock, bool& retBan);
     bool ProcessPendingInstantSendLocks();
-    std::unordered_set<uint256> ProcessPendingInstantSendLocks(int signHeight, const std::unordered_map<uint256, std::pair<NodeId, CInstantSendLock>>& pend, bool ban);
+    std::unordered_set<uint256> ProcessPendingInstantSendLocks(const std::vector<CQuorumCPtr>& quorums, const std::unordered_map<uint256, std::pair<NodeId, CInstantSendLock>>& pend, bool ban);
     void ProcessInstantSendLock(NodeId from, const uint256& hash, const CInstantSendLock& islock);
     void UpdateWalletTransaction(const uint256& txid, const CTransactionRef& tx);
 
@@ -163,6 +178,7 @@ public:
     bool GetInstantSendLockByHash(const uint256& hash, CInstantSendLock& ret);
 
     size_t GetInstantSendLockCount();
+    memusage::SubsystemUsage GetMemoryUsage();
 
     void WorkThreadMain();
 };
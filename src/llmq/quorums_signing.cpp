@@ -10,17 +10,22 @@
 
 #include "activemasternode.h"
 #include "bls/bls_batchverifier.h"
+#include "bls/bls_sigcache.h"
 #include "cxxtimer.hpp"
 #include "init.h"
 #include "net_processing.h"
 #include "netmessagemaker.h"
 #include "scheduler.h"
+#include "utilstrencodings.h"
 #include "validation.h"
+#include "validationinterface.h"
 
 #include <algorithm>
 #include <limits>
 #include <unordered_set>
 
+#include <boost/filesystem.hpp>
+
 namespace llmq
 {
 
@@ -38,99 +43,184 @@ UniValue CRecoveredSig::ToJson() const
     return ret;
 }
 
-CRecoveredSigsDb::CRecoveredSigsDb(CDBWrapper& _db) :
-    db(_db)
+CRecoveredSigsDb::CRecoveredSigsDb(CDBWrapper& legacyDb, int64_t maxAge, bool _fMemory, bool fWipe) :
+    bucketsDir(_fMemory ? boost::filesystem::path() : GetDataDir() / "llmq_recsigs"),
+    fMemory(_fMemory),
+    bucketSpan(std::max<int64_t>(1, maxAge / (BUCKET_COUNT - 1)))
 {
-    if (Params().NetworkIDString() == CBaseChainParams::TESTNET) {
-        // TODO this can be completely removed after some time (when we're pretty sure the conversion has been run on most testnet MNs)
-        if (db.Exists(std::string("rs_upgraded"))) {
-            return;
-        }
-
-        ConvertInvalidTimeKeys();
-        AddVoteTimeKeys();
+    if (fMemory) {
+        return;
+    }
 
-        db.Write(std::string("rs_upgraded"), (uint8_t)1);
+    if (fWipe && boost::filesystem::exists(bucketsDir)) {
+        LogPrintf("CRecoveredSigsDb::%s -- wiping %s\n", __func__, bucketsDir.string());
+        boost::filesystem::remove_all(bucketsDir);
+    }
+    TryCreateDirectory(bucketsDir);
+
+    // each bucket is named after the time its span starts at
+    std::vector<int64_t> startTimes;
+    for (boost::filesystem::directory_iterator it(bucketsDir); it != boost::filesystem::directory_iterator(); ++it) {
+        int64_t nStartTime;
+        if (boost::filesystem::is_directory(it->status()) && ParseInt64(it->path().filename().string(), &nStartTime)) {
+            startTimes.emplace_back(nStartTime);
+        }
+    }
+    std::sort(startTimes.begin(), startTimes.end());
+    for (int64_t nStartTime : startTimes) {
+        buckets.emplace_back(Bucket{nStartTime, OpenBucket(nStartTime)});
     }
+
+    MigrateLegacyDb(legacyDb);
 }
 
-// This converts time values in "rs_t" from host endiannes to big endiannes, which is required to have proper ordering of the keys
-void CRecoveredSigsDb::ConvertInvalidTimeKeys()
+// Moves recovered sigs and votes from the "rs_" keys of the llmq DB into the buckets
+void CRecoveredSigsDb::MigrateLegacyDb(CDBWrapper& legacyDb)
 {
-    LogPrintf("CRecoveredSigsDb::%s -- converting invalid rs_t keys\n", __func__);
+    std::unique_ptr<CDBIterator> pcursor(legacyDb.NewIterator());
 
-    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    auto startSigs = std::make_tuple(std::string("rs_h"), uint256());
+    pcursor->Seek(startSigs);
+    decltype(startSigs) firstSigKey;
+    bool hasSigs = pcursor->Valid() && pcursor->GetKey(firstSigKey) && std::get<0>(firstSigKey) == "rs_h";
 
-    auto start = std::make_tuple(std::string("rs_t"), (uint32_t)0, (uint8_t)0, uint256());
-    pcursor->Seek(start);
+    auto startVotes = std::make_tuple(std::string("rs_v"), (uint8_t)0, uint256());
+    pcursor->Seek(startVotes);
+    decltype(startVotes) firstVoteKey;
+    bool hasVotes = pcursor->Valid() && pcursor->GetKey(firstVoteKey) && std::get<0>(firstVoteKey) == "rs_v";
 
-    CDBBatch batch(db);
-    size_t cnt = 0;
-    while (pcursor->Valid()) {
-        decltype(start) k;
+    if (!hasSigs && !hasVotes) {
+        return;
+    }
 
-        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_t") {
+    LogPrintf("CRecoveredSigsDb::%s -- moving recovered sigs and votes out of the llmq DB\n", __func__);
+
+    auto db = GetBucketForWrite();
+    CDBBatch legacyBatch(legacyDb);
+    size_t sigCnt = 0;
+    size_t voteCnt = 0;
+
+    pcursor->Seek(startSigs);
+    while (pcursor->Valid()) {
+        decltype(startSigs) k;
+        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_h") {
             break;
         }
 
-        batch.Erase(k);
-        std::get<1>(k) = htobe32(std::get<1>(k));
-        batch.Write(k, (uint8_t)1);
+        std::pair<uint8_t, uint256> v;
+        CRecoveredSig recSig;
+        if (pcursor->GetValue(v) && ReadRecoveredSig(legacyDb, (Consensus::LLMQType)v.first, v.second, recSig)) {
+            WriteRecoveredSig(*db, recSig);
+            legacyBatch.Erase(std::make_tuple(std::string("rs_r"), recSig.llmqType, recSig.id));
+            legacyBatch.Erase(std::make_tuple(std::string("rs_r"), recSig.llmqType, recSig.id, recSig.msgHash));
+            legacyBatch.Erase(std::make_tuple(std::string("rs_s"), CLLMQUtils::BuildSignHash(recSig)));
+            sigCnt++;
+        }
+        legacyBatch.Erase(k);
+
+        pcursor->Next();
+    }
 
-        cnt++;
+    pcursor->Seek(startVotes);
+    while (pcursor->Valid()) {
+        decltype(startVotes) k;
+        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_v") {
+            break;
+        }
+
+        uint256 msgHash;
+        if (pcursor->GetValue(msgHash)) {
+            WriteVoteForId(*db, (Consensus::LLMQType)std::get<1>(k), std::get<2>(k), msgHash);
+            voteCnt++;
+        }
+        legacyBatch.Erase(k);
 
         pcursor->Next();
     }
+
+    // time keys are not needed anymore
+    for (const auto& prefix : {std::string("rs_t"), std::string("rs_vt")}) {
+        auto startTime = std::make_tuple(prefix, (uint32_t)0, (uint8_t)0, uint256());
+        pcursor->Seek(startTime);
+        while (pcursor->Valid()) {
+            decltype(startTime) k;
+            if (!pcursor->GetKey(k) || std::get<0>(k) != prefix) {
+                break;
+            }
+            legacyBatch.Erase(k);
+            pcursor->Next();
+        }
+    }
     pcursor.reset();
 
-    db.WriteBatch(batch);
+    legacyBatch.Erase(std::string("rs_upgraded"));
+    legacyDb.WriteBatch(legacyBatch);
 
-    LogPrintf("CRecoveredSigsDb::%s -- converted %d invalid rs_t keys\n", __func__, cnt);
+    LogPrintf("CRecoveredSigsDb::%s -- moved %d recovered sigs and %d votes\n", __func__, sigCnt, voteCnt);
 }
 
-// This adds rs_vt keys for every rs_v entry to the DB. The time in the key is set to the current time.
-// This causes cleanup of all these votes a week later.
-void CRecoveredSigsDb::AddVoteTimeKeys()
+std::shared_ptr<CDBWrapper> CRecoveredSigsDb::OpenBucket(int64_t nStartTime)
 {
-    LogPrintf("CRecoveredSigsDb::%s -- adding rs_vt keys with current time\n", __func__);
+    if (fMemory) {
+        return std::make_shared<CDBWrapper>("", 1 << 20, true, false, false, "recsigs");
+    }
 
-    auto curTime = GetAdjustedTime();
+    auto path = bucketsDir / strprintf("%d", nStartTime);
+    // the files of a dropped bucket are deleted when the last user of it is gone
+    return std::shared_ptr<CDBWrapper>(new CDBWrapper(path, 1 << 20, false, false, false, "recsigs"), [path](CDBWrapper* db) {
+        delete db;
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(path, ec);
+    });
+}
 
-    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+std::vector<std::shared_ptr<CDBWrapper>> CRecoveredSigsDb::GetBuckets()
+{
+    LOCK(cs);
+    std::vector<std::shared_ptr<CDBWrapper>> ret;
+    ret.reserve(buckets.size());
+    for (auto it = buckets.rbegin(); it != buckets.rend(); ++it) {
+        ret.emplace_back(it->db);
+    }
+    return ret;
+}
 
-    auto start = std::make_tuple(std::string("rs_v"), (uint8_t)0, uint256());
-    pcursor->Seek(start);
+std::shared_ptr<CDBWrapper> CRecoveredSigsDb::GetBucketForWrite()
+{
+    int64_t curTime = GetAdjustedTime();
 
-    CDBBatch batch(db);
-    size_t cnt = 0;
-    while (pcursor->Valid()) {
-        decltype(start) k;
+    LOCK(cs);
+    if (buckets.empty() || curTime >= buckets.back().nStartTime + bucketSpan) {
+        // keep start times increasing, even if the adjusted time went back
+        int64_t nStartTime = buckets.empty() ? curTime : std::max(curTime, buckets.back().nStartTime + 1);
+        buckets.emplace_back(Bucket{nStartTime, OpenBucket(nStartTime)});
+    }
+    return buckets.back().db;
+}
 
-        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_v") {
-            break;
+// Serializes the key only once for all buckets
+template<typename K>
+static bool ExistsInBuckets(const std::vector<std::shared_ptr<CDBWrapper>>& buckets, const K& key)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+    ssKey << key;
+    for (auto& db : buckets) {
+        if (db->Exists(ssKey)) {
+            return true;
         }
-
-        uint8_t llmqType = std::get<1>(k);
-        const uint256& id = std::get<2>(k);
-
-        auto k2 = std::make_tuple(std::string("rs_vt"), (uint32_t)htobe32(curTime), llmqType, id);
-        batch.Write(k2, (uint8_t)1);
-
-        cnt++;
-
-        pcursor->Next();
     }
-    pcursor.reset();
-
-    db.WriteBatch(batch);
-
-    LogPrintf("CRecoveredSigsDb::%s -- added %d rs_vt entries\n", __func__, cnt);
+    return false;
 }
 
 bool CRecoveredSigsDb::HasRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash)
 {
-    auto k = std::make_tuple(std::string("rs_r"), (uint8_t)llmqType, id, msgHash);
-    return db.Exists(k);
+    // the cached negative answer for the id is enough for the msgHash too
+    if (!HasRecoveredSigForId(llmqType, id)) {
+        return false;
+    }
+
+    return ExistsInBuckets(GetBuckets(), std::make_tuple(std::string("rs_r"), (uint8_t)llmqType, id, msgHash));
 }
 
 bool CRecoveredSigsDb::HasRecoveredSigForId(Consensus::LLMQType llmqType, const uint256& id)
@@ -146,7 +236,7 @@ bool CRecoveredSigsDb::HasRecoveredSigForId(Consensus::LLMQType llmqType, const
 
 
     auto k = std::make_tuple(std::string("rs_r"), (uint8_t)llmqType, id);
-    ret = db.Exists(k);
+    ret = ExistsInBuckets(GetBuckets(), k);
 
     LOCK(cs);
     hasSigForIdCache.insert(cacheKey, ret);
@@ -164,7 +254,7 @@ bool CRecoveredSigsDb::HasRecoveredSigForSession(const uint256& signHash)
     }
 
     auto k = std::make_tuple(std::string("rs_s"), signHash);
-    ret = db.Exists(k);
+    ret = ExistsInBuckets(GetBuckets(), k);
 
     LOCK(cs);
     hasSigForSessionCache.insert(signHash, ret);
@@ -182,14 +272,14 @@ bool CRecoveredSigsDb::HasRecoveredSigForHash(const uint256& hash)
     }
 
     auto k = std::make_tuple(std::string("rs_h"), hash);
-    ret = db.Exists(k);
+    ret = ExistsInBuckets(GetBuckets(), k);
 
     LOCK(cs);
     hasSigForHashCache.insert(hash, ret);
     return ret;
 }
 
-bool CRecoveredSigsDb::ReadRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, CRecoveredSig& ret)
+bool CRecoveredSigsDb::ReadRecoveredSig(CDBWrapper& db, Consensus::LLMQType llmqType, const uint256& id, CRecoveredSig& ret)
 {
     auto k = std::make_tuple(std::string("rs_r"), (uint8_t)llmqType, id);
 
@@ -209,225 +299,145 @@ bool CRecoveredSigsDb::ReadRecoveredSig(Consensus::LLMQType llmqType, const uint
 bool CRecoveredSigsDb::GetRecoveredSigByHash(const uint256& hash, CRecoveredSig& ret)
 {
     auto k1 = std::make_tuple(std::string("rs_h"), hash);
-    std::pair<uint8_t, uint256> k2;
-    if (!db.Read(k1, k2)) {
-        return false;
+    for (auto& db : GetBuckets()) {
+        std::pair<uint8_t, uint256> k2;
+        if (db->Read(k1, k2)) {
+            return ReadRecoveredSig(*db, (Consensus::LLMQType)k2.first, k2.second, ret);
+        }
     }
-
-    return ReadRecoveredSig((Consensus::LLMQType)k2.first, k2.second, ret);
+    return false;
 }
 
 bool CRecoveredSigsDb::GetRecoveredSigById(Consensus::LLMQType llmqType, const uint256& id, CRecoveredSig& ret)
 {
-    return ReadRecoveredSig(llmqType, id, ret);
+    for (auto& db : GetBuckets()) {
+        if (ReadRecoveredSig(*db, llmqType, id, ret)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void CRecoveredSigsDb::WriteRecoveredSig(const llmq::CRecoveredSig& recSig)
 {
-    CDBBatch batch(db);
+    WriteRecoveredSig(*GetBucketForWrite(), recSig);
 
-    uint32_t curTime = GetAdjustedTime();
+    LOCK(cs);
+    hasSigForIdCache.insert(std::make_pair((Consensus::LLMQType)recSig.llmqType, recSig.id), true);
+    hasSigForSessionCache.insert(CLLMQUtils::BuildSignHash(recSig), true);
+    hasSigForHashCache.insert(recSig.GetHash(), true);
+}
+
+void CRecoveredSigsDb::WriteRecoveredSig(CDBWrapper& db, const llmq::CRecoveredSig& recSig)
+{
+    CDBBatch batch(db);
 
     // we put these close to each other to leverage leveldb's key compaction
     // this way, the second key can be used for fast HasRecoveredSig checks while the first key stores the recSig
     auto k1 = std::make_tuple(std::string("rs_r"), recSig.llmqType, recSig.id);
     auto k2 = std::make_tuple(std::string("rs_r"), recSig.llmqType, recSig.id, recSig.msgHash);
     batch.Write(k1, recSig);
-    // this key is also used to store the current time, so that we can easily get to the "rs_t" key when we have the id
-    batch.Write(k2, curTime);
+    batch.Write(k2, (uint32_t)GetAdjustedTime());
 
     // store by object hash
     auto k3 = std::make_tuple(std::string("rs_h"), recSig.GetHash());
     batch.Write(k3, std::make_pair(recSig.llmqType, recSig.id));
 
     // store by signHash
-    auto signHash = CLLMQUtils::BuildSignHash(recSig);
-    auto k4 = std::make_tuple(std::string("rs_s"), signHash);
+    auto k4 = std::make_tuple(std::string("rs_s"), CLLMQUtils::BuildSignHash(recSig));
     batch.Write(k4, (uint8_t)1);
 
-    // store by current time. Allows fast cleanup of old recSigs
-    auto k5 = std::make_tuple(std::string("rs_t"), (uint32_t)htobe32(curTime), recSig.llmqType, recSig.id);
-    batch.Write(k5, (uint8_t)1);
-
     db.WriteBatch(batch);
-
-    {
-        int64_t t = GetTimeMillis();
-
-        LOCK(cs);
-        hasSigForIdCache.insert(std::make_pair((Consensus::LLMQType)recSig.llmqType, recSig.id), true);
-        hasSigForSessionCache.insert(signHash, true);
-        hasSigForHashCache.insert(recSig.GetHash(), true);
-    }
 }
 
-void CRecoveredSigsDb::RemoveRecoveredSig(CDBBatch& batch, Consensus::LLMQType llmqType, const uint256& id, bool deleteTimeKey)
+void CRecoveredSigsDb::RemoveRecoveredSig(Consensus::LLMQType llmqType, const uint256& id)
 {
-    AssertLockHeld(cs);
-
-    CRecoveredSig recSig;
-    if (!ReadRecoveredSig(llmqType, id, recSig)) {
-        return;
-    }
+    for (auto& db : GetBuckets()) {
+        CRecoveredSig recSig;
+        if (!ReadRecoveredSig(*db, llmqType, id, recSig)) {
+            continue;
+        }
 
-    auto signHash = CLLMQUtils::BuildSignHash(recSig);
+        auto signHash = CLLMQUtils::BuildSignHash(recSig);
 
-    auto k1 = std::make_tuple(std::string("rs_r"), recSig.llmqType, recSig.id);
-    auto k2 = std::make_tuple(std::string("rs_r"), recSig.llmqType, recSig.id, recSig.msgHash);
-    auto k3 = std::make_tuple(std::string("rs_h"), recSig.GetHash());
-    auto k4 = std::make_tuple(std::string("rs_s"), signHash);
-    batch.Erase(k1);
-    batch.Erase(k2);
-    batch.Erase(k3);
-    batch.Erase(k4);
+        CDBBatch batch(*db);
+        batch.Erase(std::make_tuple(std::string("rs_r"), recSig.llmqType, recSig.id));
+        batch.Erase(std::make_tuple(std::string("rs_r"), recSig.llmqType, recSig.id, recSig.msgHash));
+        batch.Erase(std::make_tuple(std::string("rs_h"), recSig.GetHash()));
+        batch.Erase(std::make_tuple(std::string("rs_s"), signHash));
+        db->WriteBatch(batch);
 
-    if (deleteTimeKey) {
-        CDataStream writeTimeDs(SER_DISK, CLIENT_VERSION);
-        // TODO remove the size() == sizeof(uint32_t) in a future version (when we stop supporting upgrades from < 0.14.1)
-        if (db.ReadDataStream(k2, writeTimeDs) && writeTimeDs.size() == sizeof(uint32_t)) {
-            uint32_t writeTime;
-            writeTimeDs >> writeTime;
-            auto k5 = std::make_tuple(std::string("rs_t"), (uint32_t) htobe32(writeTime), recSig.llmqType, recSig.id);
-            batch.Erase(k5);
-        }
+        LOCK(cs);
+        hasSigForIdCache.erase(std::make_pair((Consensus::LLMQType)recSig.llmqType, recSig.id));
+        hasSigForSessionCache.erase(signHash);
+        hasSigForHashCache.erase(recSig.GetHash());
     }
-
-    hasSigForIdCache.erase(std::make_pair((Consensus::LLMQType)recSig.llmqType, recSig.id));
-    hasSigForSessionCache.erase(signHash);
-    hasSigForHashCache.erase(recSig.GetHash());
 }
 
-void CRecoveredSigsDb::RemoveRecoveredSig(Consensus::LLMQType llmqType, const uint256& id)
+void CRecoveredSigsDb::Cleanup(int64_t maxAge)
 {
-    LOCK(cs);
-    CDBBatch batch(db);
-    RemoveRecoveredSig(batch, llmqType, id, true);
-    db.WriteBatch(batch);
-}
+    int64_t endTime = GetAdjustedTime() - maxAge;
 
-void CRecoveredSigsDb::CleanupOldRecoveredSigs(int64_t maxAge)
-{
-    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
-
-    auto start = std::make_tuple(std::string("rs_t"), (uint32_t)0, (uint8_t)0, uint256());
-    uint32_t endTime = (uint32_t)(GetAdjustedTime() - maxAge);
-    pcursor->Seek(start);
-
-    std::vector<std::pair<Consensus::LLMQType, uint256>> toDelete;
-    std::vector<decltype(start)> toDelete2;
-
-    while (pcursor->Valid()) {
-        decltype(start) k;
-
-        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_t") {
-            break;
-        }
-        if (be32toh(std::get<1>(k)) >= endTime) {
-            break;
-        }
-
-        toDelete.emplace_back((Consensus::LLMQType)std::get<2>(k), std::get<3>(k));
-        toDelete2.emplace_back(k);
-
-        pcursor->Next();
-    }
-    pcursor.reset();
-
-    if (toDelete.empty()) {
-        return;
-    }
-
-    CDBBatch batch(db);
+    std::vector<Bucket> toDrop;
     {
         LOCK(cs);
-        for (auto& e : toDelete) {
-            RemoveRecoveredSig(batch, e.first, e.second, false);
-
-            if (batch.SizeEstimate() >= (1 << 24)) {
-                db.WriteBatch(batch);
-                batch.Clear();
-            }
+        // everything in a bucket was written before the next bucket started
+        while (buckets.size() > 1 && buckets[1].nStartTime <= endTime) {
+            toDrop.emplace_back(std::move(buckets.front()));
+            buckets.erase(buckets.begin());
+        }
+        if (toDrop.empty()) {
+            return;
         }
-    }
 
-    for (auto& e : toDelete2) {
-        batch.Erase(e);
+        // the caches might still know about sigs from the dropped buckets
+        hasSigForIdCache.clear();
+        hasSigForSessionCache.clear();
+        hasSigForHashCache.clear();
     }
 
-    db.WriteBatch(batch);
-
-    LogPrint("llmq", "CRecoveredSigsDb::%d -- deleted %d entries\n", __func__, toDelete.size());
+    for (auto& b : toDrop) {
+        LogPrint("llmq", "CRecoveredSigsDb::%s -- dropping bucket %d\n", __func__, b.nStartTime);
+    }
 }
 
 bool CRecoveredSigsDb::HasVotedOnId(Consensus::LLMQType llmqType, const uint256& id)
 {
     auto k = std::make_tuple(std::string("rs_v"), (uint8_t)llmqType, id);
-    return db.Exists(k);
+    for (auto& db : GetBuckets()) {
+        if (db->Exists(k)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 bool CRecoveredSigsDb::GetVoteForId(Consensus::LLMQType llmqType, const uint256& id, uint256& msgHashRet)
 {
     auto k = std::make_tuple(std::string("rs_v"), (uint8_t)llmqType, id);
-    return db.Read(k, msgHashRet);
+    for (auto& db : GetBuckets()) {
+        if (db->Read(k, msgHashRet)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void CRecoveredSigsDb::WriteVoteForId(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash)
 {
-    auto k1 = std::make_tuple(std::string("rs_v"), (uint8_t)llmqType, id);
-    auto k2 = std::make_tuple(std::string("rs_vt"), (uint32_t)htobe32(GetAdjustedTime()), (uint8_t)llmqType, id);
-
-    CDBBatch batch(db);
-    batch.Write(k1, msgHash);
-    batch.Write(k2, (uint8_t)1);
-
-    db.WriteBatch(batch);
+    WriteVoteForId(*GetBucketForWrite(), llmqType, id, msgHash);
 }
 
-void CRecoveredSigsDb::CleanupOldVotes(int64_t maxAge)
+void CRecoveredSigsDb::WriteVoteForId(CDBWrapper& db, Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash)
 {
-    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
-
-    auto start = std::make_tuple(std::string("rs_vt"), (uint32_t)0, (uint8_t)0, uint256());
-    uint32_t endTime = (uint32_t)(GetAdjustedTime() - maxAge);
-    pcursor->Seek(start);
-
-    CDBBatch batch(db);
-    size_t cnt = 0;
-    while (pcursor->Valid()) {
-        decltype(start) k;
-
-        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_vt") {
-            break;
-        }
-        if (be32toh(std::get<1>(k)) >= endTime) {
-            break;
-        }
-
-        uint8_t llmqType = std::get<2>(k);
-        const uint256& id = std::get<3>(k);
-
-        batch.Erase(k);
-        batch.Erase(std::make_tuple(std::string("rs_v"), llmqType, id));
-
-        cnt++;
-
-        pcursor->Next();
-    }
-    pcursor.reset();
-
-    if (cnt == 0) {
-        return;
-    }
-
-    db.WriteBatch(batch);
-
-    LogPrint("llmq", "CRecoveredSigsDb::%d -- deleted %d entries\n", __func__, cnt);
+    auto k = std::make_tuple(std::string("rs_v"), (uint8_t)llmqType, id);
+    db.Write(k, msgHash);
 }
 
 //////////////////
 
-CSigningManager::CSigningManager(CDBWrapper& llmqDb, bool fMemory) :
-    db(llmqDb)
+CSigningManager::CSigningManager(CDBWrapper& llmqDb, bool fMemory, bool fWipe) :
+    db(llmqDb, GetArg("-recsigsmaxage", DEFAULT_MAX_RECOVERED_SIGS_AGE), fMemory, fWipe)
 {
 }
 
@@ -601,6 +611,7 @@ bool CSigningManager::ProcessPendingRecoveredSigs(CConnman& connman)
     CBLSBatchVerifier<NodeId, uint256> batchVerifier(false, false);
 
     size_t verifyCount = 0;
+    std::vector<std::pair<NodeId, uint256>> cacheEntries;
     for (auto& p : recSigsByNode) {
         NodeId nodeId = p.first;
         auto& v = p.second;
@@ -613,7 +624,13 @@ bool CSigningManager::ProcessPendingRecoveredSigs(CConnman& connman)
             }
 
             const auto& quorum = quorums.at(std::make_pair((Consensus::LLMQType)recSig.llmqType, recSig.quorumHash));
-            batchVerifier.PushMessage(nodeId, recSig.GetHash(), CLLMQUtils::BuildSignHash(recSig), recSig.sig.Get(), quorum->qc.quorumPublicKey);
+            uint256 signHash = CLLMQUtils::BuildSignHash(recSig);
+            uint256 entry = ComputeBLSSignatureCacheEntry(quorum->qc.quorumPublicKey.GetHash(), signHash, recSig.sig.Get());
+            if (BLSSignatureCacheContains(entry)) {
+                continue;
+            }
+            batchVerifier.PushMessage(nodeId, recSig.GetHash(), signHash, recSig.sig.Get(), quorum->qc.quorumPublicKey.Get());
+            cacheEntries.emplace_back(nodeId, entry);
             verifyCount++;
         }
     }
@@ -622,6 +639,13 @@ bool CSigningManager::ProcessPendingRecoveredSigs(CConnman& connman)
     batchVerifier.Verify();
     verifyTimer.stop();
 
+    // without per message fallback a bad source leaves all of its messages unverified
+    for (const auto& p : cacheEntries) {
+        if (!batchVerifier.badSources.count(p.first)) {
+            BLSSignatureCacheAdd(p.second);
+        }
+    }
+
     LogPrint("llmq", "CSigningManager::%s -- verified recovered sig(s). count=%d, vt=%d, nodes=%d\n", __func__, verifyCount, verifyTimer.count(), recSigsByNode.size());
 
     std::unordered_set<uint256, StaticSaltedHasher> processed;
@@ -704,6 +728,8 @@ void CSigningManager::ProcessRecoveredSig(NodeId nodeId, const CRecoveredSig& re
     for (auto& l : listeners) {
         l->HandleNewRecoveredSig(recoveredSig);
     }
+
+    GetMainSignals().NotifyRecoveredSig(std::make_shared<const CRecoveredSig>(recoveredSig));
 }
 
 void CSigningManager::PushReconstructedRecoveredSig(const llmq::CRecoveredSig& recoveredSig, const llmq::CQuorumCPtr& quorum)
@@ -726,8 +752,7 @@ void CSigningManager::Cleanup()
 
     int64_t maxAge = GetArg("-recsigsmaxage", DEFAULT_MAX_RECOVERED_SIGS_AGE);
 
-    db.CleanupOldRecoveredSigs(maxAge);
-    db.CleanupOldVotes(maxAge);
+    db.Cleanup(maxAge);
 
     lastCleanupTime = GetTimeMillis();
 }
@@ -815,6 +840,89 @@ bool CSigningManager::AsyncSignIfMember(Consensus::LLMQType llmqType, const uint
     return true;
 }
 
+// Batched version of the above, for many (id, msgHash) pairs at once (e.g. all inputs of a burst of InstantSend TXs).
+// Votes are checked and written under a single lock, the tip is only read once and all sig shares are handed over to
+// the sig shares manager in one go, which then creates them in parallel. Returns the number of ids we're signing
+size_t CSigningManager::AsyncSignIfMember(Consensus::LLMQType llmqType, const std::vector<std::pair<uint256, uint256>>& idsAndMsgHashes, bool allowReSign)
+{
+    if (!fMasternodeMode || activeMasternodeInfo.proTxHash.IsNull()) {
+        return 0;
+    }
+
+    std::vector<std::pair<uint256, uint256>> toSign;
+    toSign.reserve(idsAndMsgHashes.size());
+    {
+        LOCK(cs);
+
+        for (const auto& p : idsAndMsgHashes) {
+            auto& id = p.first;
+            auto& msgHash = p.second;
+
+            uint256 prevMsgHash;
+            bool hasVoted = db.GetVoteForId(llmqType, id, prevMsgHash);
+            if (hasVoted) {
+                if (msgHash != prevMsgHash) {
+                    LogPrintf("CSigningManager::%s -- already voted for id=%s and msgHash=%s. Not voting on conflicting msgHash=%s\n", __func__,
+                              id.ToString(), prevMsgHash.ToString(), msgHash.ToString());
+                    continue;
+                }
+                if (!allowReSign) {
+                    continue;
+                }
+            }
+
+            if (db.HasRecoveredSigForId(llmqType, id)) {
+                // no need to sign it if we already have a recovered sig
+                continue;
+            }
+            if (!hasVoted) {
+                db.WriteVoteForId(llmqType, id, msgHash);
+            }
+            toSign.emplace_back(p);
+        }
+    }
+
+    if (toSign.empty()) {
+        return 0;
+    }
+
+    int tipHeight;
+    {
+        LOCK(cs_main);
+        tipHeight = chainActive.Height();
+    }
+
+    auto quorums = GetActiveQuorumSet(llmqType, tipHeight);
+
+    std::vector<std::tuple<const CQuorumCPtr, uint256, uint256>> signs;
+    signs.reserve(toSign.size());
+    for (const auto& p : toSign) {
+        // see the single version above about the risks of selecting the quorum this way
+        CQuorumCPtr quorum = SelectQuorumForSigning(llmqType, quorums, p.first);
+        if (!quorum) {
+            LogPrint("llmq", "CSigningManager::%s -- failed to select quorum. id=%s, msgHash=%s\n", __func__, p.first.ToString(), p.second.ToString());
+            continue;
+        }
+        if (!quorum->IsValidMember(activeMasternodeInfo.proTxHash)) {
+            continue;
+        }
+        if (allowReSign) {
+            // make us re-announce all known shares (other nodes might have run into a timeout)
+            quorumSigSharesManager->ForceReAnnouncement(quorum, llmqType, p.first, p.second);
+        }
+        signs.emplace_back(quorum, p.first, p.second);
+    }
+
+    size_t count = signs.size();
+    if (count != 0) {
+        quorumSigSharesManager->AsyncSign(std::move(signs));
+    }
+
+    LogPrint("llmq", "CSigningManager::%s -- signing %d of %d ids. allowReSign=%d\n", __func__, count, idsAndMsgHashes.size(), allowReSign);
+
+    return count;
+}
+
 bool CSigningManager::HasRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash)
 {
     return db.HasRecoveredSig(llmqType, id, msgHash);
@@ -884,7 +992,11 @@ std::vector<CQuorumCPtr> CSigningManager::GetActiveQuorumSet(Consensus::LLMQType
 
 CQuorumCPtr CSigningManager::SelectQuorumForSigning(Consensus::LLMQType llmqType, int signHeight, const uint256& selectionHash)
 {
-    auto quorums = GetActiveQuorumSet(llmqType, signHeight);
+    return SelectQuorumForSigning(llmqType, GetActiveQuorumSet(llmqType, signHeight), selectionHash);
+}
+
+CQuorumCPtr CSigningManager::SelectQuorumForSigning(Consensus::LLMQType llmqType, const std::vector<CQuorumCPtr>& quorums, const uint256& selectionHash)
+{
     if (quorums.empty()) {
         return nullptr;
     }
@@ -912,7 +1024,7 @@ bool CSigningManager::VerifyRecoveredSig(Consensus::LLMQType llmqType, int signe
     }
 
     uint256 signHash = CLLMQUtils::BuildSignHash(llmqParams.type, quorum->qc.quorumHash, id, msgHash);
-    return sig.VerifyInsecure(quorum->qc.quorumPublicKey, signHash);
+    return VerifyBLSSignatureCached(sig, quorum->qc.quorumPublicKey.Get(), signHash);
 }
 
 }
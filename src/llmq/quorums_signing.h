@@ -11,10 +11,12 @@
 
 #include "net.h"
 #include "chainparams.h"
+#include "dbwrapper.h"
 #include "saltedhasher.h"
 #include "univalue.h"
 #include "unordered_lru_cache.h"
 
+#include <memory>
 #include <unordered_map>
 
 namespace llmq
@@ -63,21 +65,34 @@ public:
     UniValue ToJson() const;
 };
 
+// Recovered sigs and votes are stored in a few dedicated LevelDB instances ("buckets"), each holding what was written
+// during one time span. Lookups go through all buckets, newest first. Cleanup drops the oldest bucket as a whole once
+// everything in it is older than the max age, so there is no need to delete entries one by one, which previously
+// caused long compactions of the llmq DB
 class CRecoveredSigsDb
 {
 private:
-    CDBWrapper& db;
+    // only the newest BUCKET_COUNT - 1 spans are needed to cover maxAge, the oldest one is the one that is dropped next
+    static const int BUCKET_COUNT = 3;
+
+    struct Bucket {
+        int64_t nStartTime;
+        std::shared_ptr<CDBWrapper> db;
+    };
+
+    boost::filesystem::path bucketsDir;
+    bool fMemory;
+    int64_t bucketSpan;
 
     CCriticalSection cs;
+    // oldest first
+    std::vector<Bucket> buckets;
     unordered_lru_cache<std::pair<Consensus::LLMQType, uint256>, bool, StaticSaltedHasher, 30000> hasSigForIdCache;
     unordered_lru_cache<uint256, bool, StaticSaltedHasher, 30000> hasSigForSessionCache;
     unordered_lru_cache<uint256, bool, StaticSaltedHasher, 30000> hasSigForHashCache;
 
 public:
-    CRecoveredSigsDb(CDBWrapper& _db);
-
-    void ConvertInvalidTimeKeys();
-    void AddVoteTimeKeys();
+    CRecoveredSigsDb(CDBWrapper& legacyDb, int64_t maxAge, bool _fMemory, bool fWipe);
 
     bool HasRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash);
     bool HasRecoveredSigForId(Consensus::LLMQType llmqType, const uint256& id);
@@ -88,18 +103,24 @@ public:
     void WriteRecoveredSig(const CRecoveredSig& recSig);
     void RemoveRecoveredSig(Consensus::LLMQType llmqType, const uint256& id);
 
-    void CleanupOldRecoveredSigs(int64_t maxAge);
-
-    // votes are removed when the recovered sig is written to the db
+    // votes are kept for at least as long as recovered sigs
     bool HasVotedOnId(Consensus::LLMQType llmqType, const uint256& id);
     bool GetVoteForId(Consensus::LLMQType llmqType, const uint256& id, uint256& msgHashRet);
     void WriteVoteForId(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash);
 
-    void CleanupOldVotes(int64_t maxAge);
+    // drops buckets that only contain recovered sigs and votes older than maxAge
+    void Cleanup(int64_t maxAge);
 
 private:
-    bool ReadRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, CRecoveredSig& ret);
-    void RemoveRecoveredSig(CDBBatch& batch, Consensus::LLMQType llmqType, const uint256& id, bool deleteTimeKey);
+    void MigrateLegacyDb(CDBWrapper& legacyDb);
+
+    std::shared_ptr<CDBWrapper> OpenBucket(int64_t nStartTime);
+    std::vector<std::shared_ptr<CDBWrapper>> GetBuckets();
+    std::shared_ptr<CDBWrapper> GetBucketForWrite();
+
+    bool ReadRecoveredSig(CDBWrapper& db, Consensus::LLMQType llmqType, const uint256& id, CRecoveredSig& ret);
+    void WriteRecoveredSig(CDBWrapper& db, const CRecoveredSig& recSig);
+    void WriteVoteForId(CDBWrapper& db, Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash);
 };
 
 class CRecoveredSigsListener
@@ -137,7 +158,7 @@ private:
     std::vector<CRecoveredSigsListener*> recoveredSigsListeners;
 
 public:
-    CSigningManager(CDBWrapper& llmqDb, bool fMemory);
+    CSigningManager(CDBWrapper& llmqDb, bool fMemory, bool fWipe);
 
     bool AlreadyHave(const CInv& inv);
     bool GetRecoveredSigForGetData(const uint256& hash, CRecoveredSig& ret);
@@ -170,6 +191,7 @@ public:
     void UnregisterRecoveredSigsListener(CRecoveredSigsListener* l);
 
     bool AsyncSignIfMember(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash, bool allowReSign = false);
+    size_t AsyncSignIfMember(Consensus::LLMQType llmqType, const std::vector<std::pair<uint256, uint256>>& idsAndMsgHashes, bool allowReSign = false);
     bool HasRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash);
     bool HasRecoveredSigForId(Consensus::LLMQType llmqType, const uint256& id);
     bool HasRecoveredSigForSession(const uint256& signHash);
@@ -181,6 +203,8 @@ public:
 
     std::vector<CQuorumCPtr> GetActiveQuorumSet(Consensus::LLMQType llmqType, int signHeight);
     CQuorumCPtr SelectQuorumForSigning(Consensus::LLMQType llmqType, int signHeight, const uint256& selectionHash);
+    // Same as above, but with an already resolved active quorum set. Use this when selecting for many ids at once
+    static CQuorumCPtr SelectQuorumForSigning(Consensus::LLMQType llmqType, const std::vector<CQuorumCPtr>& quorums, const uint256& selectionHash);
 
     // Verifies a recovered sig that was signed while the chain tip was at signedAtTip
     bool VerifyRecoveredSig(Consensus::LLMQType llmqType, int signedAtHeight, const uint256& id, const uint256& msgHash, const CBLSSignature& sig);
@@ -6,13 +6,16 @@
 
 #include "quorums_signing.h"
 #include "quorums_signing_shares.h"
+#include "quorums_init.h"
 #include "quorums_utils.h"
 
 #include "activemasternode.h"
 #include "bls/bls_batchverifier.h"
 #include "init.h"
+#include "metrics.h"
 #include "net_processing.h"
 #include "netmessagemaker.h"
+#include "tracing.h"
 #include "validation.h"
 
 #include "cxxtimer.hpp"
@@ -178,6 +181,8 @@ void CSigSharesNodeState::RemoveSession(const uint256& signHash)
         sessionByRecvId.erase(it->second.recvSessionId);
         sessions.erase(it);
     }
+    sessionsWithAnnounced.erase(signHash);
+    sessionsWithRequested.erase(signHash);
     requestedSigShares.EraseAllForSignHash(signHash);
     pendingIncomingSigShares.EraseAllForSignHash(signHash);
 }
@@ -380,6 +385,7 @@ bool CSigSharesManager::ProcessMessageSigSharesInv(CNode* pfrom, const CSigShare
     }
     session->announced.Merge(inv);
     session->knows.Merge(inv);
+    nodeState.sessionsWithAnnounced.emplace(session->signHash);
     return true;
 }
 
@@ -410,6 +416,7 @@ bool CSigSharesManager::ProcessMessageGetSigShares(CNode* pfrom, const CSigShare
     }
     session->requested.Merge(inv);
     session->knows.Merge(inv);
+    nodeState.sessionsWithRequested.emplace(session->signHash);
     return true;
 }
 
@@ -511,13 +518,14 @@ bool CSigSharesManager::PreVerifyBatchedSigShares(NodeId nodeId, const CSigShare
 }
 
 void CSigSharesManager::CollectPendingSigSharesToVerify(
-        size_t maxUniqueSessions,
+        size_t maxSigShares,
         std::unordered_map<NodeId, std::vector<CSigShare>>& retSigShares,
         std::unordered_map<std::pair<Consensus::LLMQType, uint256>, CQuorumCPtr, StaticSaltedHasher>& retQuorums)
 {
     {
         LOCK(cs);
         if (nodeStates.empty()) {
+            g_metrics.nSigSharesPending = 0;
             return;
         }
 
@@ -527,9 +535,10 @@ void CSigSharesManager::CollectPendingSigSharesToVerify(
         // invalid, making batch verification fail and revert to per-share verification, which in turn would slow down
         // the whole verification process
 
-        std::unordered_set<std::pair<NodeId, uint256>, StaticSaltedHasher> uniqueSignHashes;
+        // Shares of all sessions go into the same batch, so many sessions with few shares each still verify in bulk
+        size_t collected = 0;
         CLLMQUtils::IterateNodesRandom(nodeStates, [&]() {
-            return uniqueSignHashes.size() < maxUniqueSessions;
+            return collected < maxSigShares;
         }, [&](NodeId nodeId, CSigSharesNodeState& ns) {
             if (ns.pendingIncomingSigShares.Empty()) {
                 return false;
@@ -538,13 +547,19 @@ void CSigSharesManager::CollectPendingSigSharesToVerify(
 
             bool alreadyHave = this->sigShares.Has(sigShare.GetKey());
             if (!alreadyHave) {
-                uniqueSignHashes.emplace(nodeId, sigShare.GetSignHash());
+                collected++;
                 retSigShares[nodeId].emplace_back(sigShare);
             }
             ns.pendingIncomingSigShares.Erase(sigShare.GetKey());
             return !ns.pendingIncomingSigShares.Empty();
         }, rnd);
 
+        size_t nPending = 0;
+        for (const auto& p : nodeStates) {
+            nPending += p.second.pendingIncomingSigShares.Size();
+        }
+        g_metrics.nSigSharesPending = nPending;
+
         if (retSigShares.empty()) {
             return;
         }
@@ -577,7 +592,7 @@ bool CSigSharesManager::ProcessPendingSigShares(CConnman& connman)
     std::unordered_map<NodeId, std::vector<CSigShare>> sigSharesByNodes;
     std::unordered_map<std::pair<Consensus::LLMQType, uint256>, CQuorumCPtr, StaticSaltedHasher> quorums;
 
-    CollectPendingSigSharesToVerify(32, sigSharesByNodes, quorums);
+    CollectPendingSigSharesToVerify(nSigSharesPerBatch, sigSharesByNodes, quorums);
     if (sigSharesByNodes.empty()) {
         return false;
     }
@@ -619,11 +634,39 @@ bool CSigSharesManager::ProcessPendingSigShares(CConnman& connman)
         }
     }
 
-    cxxtimer::Timer verifyTimer(true);
-    batchVerifier.Verify();
-    verifyTimer.stop();
+    int64_t nVerifyStart = GetTimeMicros();
+    size_t nChunks = std::max<size_t>(1, verifyCount / SIG_SHARES_PER_VERIFY_CHUNK);
+    TRACE3(llmq, sigshares_verify_start, verifyCount, nChunks, sigSharesByNodes.size());
+    batchVerifier.VerifyBisect(nChunks, [](std::function<void()> job) {
+        return blsWorker->AsyncRun(std::move(job));
+    });
+    int64_t nVerifyTime = GetTimeMicros() - nVerifyStart;
+    TRACE3(llmq, sigshares_verify_end, verifyCount, batchVerifier.badMessages.size(), nVerifyTime);
+
+    LogPrint("llmq-sigs", "CSigSharesManager::%s -- verified sig shares. count=%d, chunks=%d, vt=%dus, bad=%d, nodes=%d\n", __func__,
+             verifyCount, nChunks, nVerifyTime, batchVerifier.badMessages.size(), sigSharesByNodes.size());
+
+    // Grow the next batch while we're well below the budget and shrink it when above, but only when this one was full,
+    // as smaller batches don't tell how long a full one would take
+    if (verifyCount != 0) {
+        int64_t nPerShare = std::max<int64_t>(1, nVerifyTime / (int64_t)verifyCount);
+        size_t nTarget = (size_t)(SIG_SHARES_VERIFY_BUDGET / nPerShare);
+        if (verifyCount >= nSigSharesPerBatch || nTarget < nSigSharesPerBatch) {
+            nSigSharesPerBatch = std::max(MIN_SIG_SHARES_PER_BATCH, std::min(MAX_SIG_SHARES_PER_BATCH, (nSigSharesPerBatch + nTarget) / 2));
+        }
+    }
 
-    LogPrint("llmq-sigs", "CSigSharesManager::%s -- verified sig shares. count=%d, vt=%d, nodes=%d\n", __func__, verifyCount, verifyTimer.count(), sigSharesByNodes.size());
+    {
+        LOCK(cs);
+        verifyStats.nBatches++;
+        verifyStats.nSigShares += verifyCount;
+        verifyStats.nBadSigShares += batchVerifier.badMessages.size();
+        verifyStats.nVerifyTimeTotal += nVerifyTime;
+        verifyStats.nLastBatchSize = verifyCount;
+        verifyStats.nLastVerifyTime = nVerifyTime;
+        verifyStats.nMaxBatchSize = std::max(verifyStats.nMaxBatchSize, verifyCount);
+        verifyStats.nBatchLimit = nSigSharesPerBatch;
+    }
 
     for (auto& p : sigSharesByNodes) {
         auto nodeId = p.first;
@@ -699,6 +742,7 @@ void CSigSharesManager::ProcessSigShare(NodeId nodeId, const CSigShare& sigShare
                 session.quorum = quorum;
                 session.requested.Set(sigShare.quorumMember, true);
                 session.knows.Set(sigShare.quorumMember, true);
+                nodeState.sessionsWithRequested.emplace(sigShare.GetSignHash());
             }
         }
 
@@ -709,24 +753,27 @@ void CSigSharesManager::ProcessSigShare(NodeId nodeId, const CSigShare& sigShare
     }
 
     if (canTryRecovery) {
-        TryRecoverSig(quorum, sigShare.id, sigShare.msgHash, connman);
+        TryRecoverSig(quorum, sigShare.id, sigShare.msgHash);
     }
 }
 
-void CSigSharesManager::TryRecoverSig(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash, CConnman& connman)
+void CSigSharesManager::TryRecoverSig(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash)
 {
     if (quorumSigningManager->HasRecoveredSigForId(quorum->params.type, id)) {
         return;
     }
 
+    auto signHash = CLLMQUtils::BuildSignHash(quorum->params.type, quorum->qc.quorumHash, id, msgHash);
+    if (pendingRecoveries.count(signHash)) {
+        // already recovering, more shares won't change the result
+        return;
+    }
+
     std::vector<CBLSSignature> sigSharesForRecovery;
     std::vector<CBLSId> idsForRecovery;
     {
         LOCK(cs);
 
-        auto k = std::make_pair(quorum->params.type, id);
-
-        auto signHash = CLLMQUtils::BuildSignHash(quorum->params.type, quorum->qc.quorumHash, id, msgHash);
         auto sigShares = this->sigShares.GetAllForSignHash(signHash);
         if (!sigShares) {
             return;
@@ -746,41 +793,58 @@ void CSigSharesManager::TryRecoverSig(const CQuorumCPtr& quorum, const uint256&
         }
     }
 
-    // now recover it
-    cxxtimer::Timer t(true);
-    CBLSSignature recoveredSig;
-    if (!recoveredSig.Recover(sigSharesForRecovery, idsForRecovery)) {
-        LogPrintf("CSigSharesManager::%s -- failed to recover signature. id=%s, msgHash=%s, time=%d\n", __func__,
-                  id.ToString(), msgHash.ToString(), t.count());
-        return;
-    }
-
-    LogPrint("llmq-sigs", "CSigSharesManager::%s -- recovered signature. id=%s, msgHash=%s, time=%d\n", __func__,
-              id.ToString(), msgHash.ToString(), t.count());
-
-    CRecoveredSig rs;
-    rs.llmqType = quorum->params.type;
-    rs.quorumHash = quorum->qc.quorumHash;
-    rs.id = id;
-    rs.msgHash = msgHash;
-    rs.sig.Set(recoveredSig);
-    rs.UpdateHash();
-
     // There should actually be no need to verify the self-recovered signatures as it should always succeed. Let's
     // however still verify it from time to time, so that we have a chance to catch bugs. We do only this sporadic
     // verification because this is unbatched and thus slow verification that happens here.
+    CBLSPublicKey verifyPubKey;
     if (((recoveredSigsCounter++) % 100) == 0) {
-        auto signHash = CLLMQUtils::BuildSignHash(rs);
-        bool valid = recoveredSig.VerifyInsecure(quorum->qc.quorumPublicKey, signHash);
-        if (!valid) {
-            // this should really not happen as we have verified all signature shares before
-            LogPrintf("CSigSharesManager::%s -- own recovered signature is invalid. id=%s, msgHash=%s\n", __func__,
-                      id.ToString(), msgHash.ToString());
-            return;
-        }
+        verifyPubKey = quorum->qc.quorumPublicKey.Get();
     }
 
-    quorumSigningManager->ProcessRecoveredSig(-1, rs, quorum, connman);
+    // Recovery is done by the BLS workers, so that this thread can go on with receiving and verifying shares
+    PendingRecovery& recovery = pendingRecoveries[signHash];
+    recovery.quorum = quorum;
+    recovery.id = id;
+    recovery.msgHash = msgHash;
+    recovery.nStartTime = GetTimeMillis();
+    recovery.future = blsWorker->AsyncRecoverSig(std::move(sigSharesForRecovery), std::move(idsForRecovery), verifyPubKey, signHash);
+}
+
+bool CSigSharesManager::ProcessFinishedRecoveries(CConnman& connman)
+{
+    bool didWork = false;
+    for (auto it = pendingRecoveries.begin(); it != pendingRecoveries.end(); ) {
+        auto& recovery = it->second;
+        if (recovery.future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++it;
+            continue;
+        }
+
+        CBLSSignature recoveredSig = recovery.future.get();
+        int64_t nTime = GetTimeMillis() - recovery.nStartTime;
+        if (!recoveredSig.IsValid()) {
+            // when verified, this should really not happen as we have verified all signature shares before
+            LogPrintf("CSigSharesManager::%s -- failed to recover signature. id=%s, msgHash=%s, time=%d\n", __func__,
+                      recovery.id.ToString(), recovery.msgHash.ToString(), nTime);
+        } else {
+            LogPrint("llmq-sigs", "CSigSharesManager::%s -- recovered signature. id=%s, msgHash=%s, time=%d\n", __func__,
+                     recovery.id.ToString(), recovery.msgHash.ToString(), nTime);
+
+            CRecoveredSig rs;
+            rs.llmqType = recovery.quorum->params.type;
+            rs.quorumHash = recovery.quorum->qc.quorumHash;
+            rs.id = recovery.id;
+            rs.msgHash = recovery.msgHash;
+            rs.sig.Set(recoveredSig);
+            rs.UpdateHash();
+
+            quorumSigningManager->ProcessRecoveredSig(-1, rs, recovery.quorum, connman);
+        }
+
+        it = pendingRecoveries.erase(it);
+        didWork = true;
+    }
+    return didWork;
 }
 
 void CSigSharesManager::CollectSigSharesToRequest(std::unordered_map<NodeId, std::unordered_map<uint256, CSigSharesInv, StaticSaltedHasher>>& sigSharesToRequest)
@@ -820,26 +884,29 @@ void CSigSharesManager::CollectSigSharesToRequest(std::unordered_map<NodeId, std
 
         decltype(sigSharesToRequest.begin()->second)* invMap = nullptr;
 
-        for (auto& p2 : nodeState.sessions) {
-            auto& signHash = p2.first;
-            auto& session = p2.second;
+        for (auto itSession = nodeState.sessionsWithAnnounced.begin(); itSession != nodeState.sessionsWithAnnounced.end(); ) {
+            auto& signHash = *itSession;
+            auto session = nodeState.GetSessionBySignHash(signHash);
 
-            if (quorumSigningManager->HasRecoveredSigForSession(signHash)) {
+            if (!session || quorumSigningManager->HasRecoveredSigForSession(signHash)) {
+                itSession = nodeState.sessionsWithAnnounced.erase(itSession);
                 continue;
             }
 
-            for (size_t i = 0; i < session.announced.inv.size(); i++) {
-                if (!session.announced.inv[i]) {
+            bool hasPending = false;
+            for (size_t i = 0; i < session->announced.inv.size(); i++) {
+                if (!session->announced.inv[i]) {
                     continue;
                 }
                 auto k = std::make_pair(signHash, (uint16_t) i);
                 if (sigShares.Has(k)) {
                     // we already have it
-                    session.announced.inv[i] = false;
+                    session->announced.inv[i] = false;
                     continue;
                 }
                 if (nodeState.requestedSigShares.Size() >= maxRequestsForNode) {
                     // too many pending requests for this node
+                    hasPending = true;
                     break;
                 }
                 auto p = sigSharesRequested.Get(k);
@@ -849,6 +916,8 @@ void CSigSharesManager::CollectSigSharesToRequest(std::unordered_map<NodeId, std
                         LogPrint("llmq-sigs", "CSigSharesManager::%s -- other node timeout while waiting for %s-%d, re-request from=%d, node=%d\n", __func__,
                                  k.first.ToString(), k.second, nodeId, p->first);
                     } else {
+                        // might need to be re-requested from this node later
+                        hasPending = true;
                         continue;
                     }
                 }
@@ -867,13 +936,19 @@ void CSigSharesManager::CollectSigSharesToRequest(std::unordered_map<NodeId, std
                 }
                 auto& inv = (*invMap)[signHash];
                 if (inv.inv.empty()) {
-                    const auto& params = Params().GetConsensus().llmqs.at((Consensus::LLMQType)session.llmqType);
+                    const auto& params = Params().GetConsensus().llmqs.at((Consensus::LLMQType)session->llmqType);
                     inv.Init((size_t)params.size);
                 }
                 inv.inv[k.second] = true;
 
                 // dont't request it again from this node
-                session.announced.inv[i] = false;
+                session->announced.inv[i] = false;
+            }
+
+            if (hasPending) {
+                ++itSession;
+            } else {
+                itSession = nodeState.sessionsWithAnnounced.erase(itSession);
             }
         }
     }
@@ -893,9 +968,15 @@ void CSigSharesManager::CollectSigSharesToSend(std::unordered_map<NodeId, std::u
 
         decltype(sigSharesToSend.begin()->second)* sigSharesToSend2 = nullptr;
 
-        for (auto& p2 : nodeState.sessions) {
-            auto& signHash = p2.first;
-            auto& session = p2.second;
+        // all requested bits of these get handled below
+        auto sessionsWithRequested = std::move(nodeState.sessionsWithRequested);
+        nodeState.sessionsWithRequested.clear();
+
+        for (auto& signHash : sessionsWithRequested) {
+            auto session = nodeState.GetSessionBySignHash(signHash);
+            if (!session) {
+                continue;
+            }
 
             if (quorumSigningManager->HasRecoveredSigForSession(signHash)) {
                 continue;
@@ -903,17 +984,16 @@ void CSigSharesManager::CollectSigSharesToSend(std::unordered_map<NodeId, std::u
 
             CBatchedSigShares batchedSigShares;
 
-            for (size_t i = 0; i < session.requested.inv.size(); i++) {
-                if (!session.requested.inv[i]) {
+            for (size_t i = 0; i < session->requested.inv.size(); i++) {
+                if (!session->requested.inv[i]) {
                     continue;
                 }
-                session.requested.inv[i] = false;
+                session->requested.inv[i] = false;
 
                 auto k = std::make_pair(signHash, (uint16_t)i);
                 const CSigShare* sigShare = sigShares.Get(k);
                 if (!sigShare) {
                     // he requested something we don'have
-                    session.requested.inv[i] = false;
                     continue;
                 }
 
@@ -1355,6 +1435,7 @@ void CSigSharesManager::WorkThreadMain()
         didWork |= quorumSigningManager->ProcessPendingRecoveredSigs(*g_connman);
         didWork |= ProcessPendingSigShares(*g_connman);
         didWork |= SignPendingSigShares();
+        didWork |= ProcessFinishedRecoveries(*g_connman);
 
         if (GetTimeMillis() - lastSendTime > 100) {
             SendMessages();
@@ -1366,7 +1447,8 @@ void CSigSharesManager::WorkThreadMain()
 
         // TODO Wakeup when pending signing is needed?
         if (!didWork) {
-            if (!workInterrupt.sleep_for(std::chrono::milliseconds(100))) {
+            // don't let finished recoveries wait for too long
+            if (!workInterrupt.sleep_for(std::chrono::milliseconds(pendingRecoveries.empty() ? 100 : 5))) {
                 return;
             }
         }
@@ -1379,6 +1461,19 @@ void CSigSharesManager::AsyncSign(const CQuorumCPtr& quorum, const uint256& id,
     pendingSigns.emplace_back(quorum, id, msgHash);
 }
 
+void CSigSharesManager::AsyncSign(std::vector<std::tuple<const CQuorumCPtr, uint256, uint256>>&& signs)
+{
+    LOCK(cs);
+    if (pendingSigns.empty()) {
+        pendingSigns = std::move(signs);
+        return;
+    }
+    pendingSigns.reserve(pendingSigns.size() + signs.size());
+    for (auto& t : signs) {
+        pendingSigns.emplace_back(std::move(t));
+    }
+}
+
 bool CSigSharesManager::SignPendingSigShares()
 {
     std::vector<std::tuple<const CQuorumCPtr, uint256, uint256>> v;
@@ -1387,34 +1482,61 @@ bool CSigSharesManager::SignPendingSigShares()
         v = std::move(pendingSigns);
     }
 
-    for (auto& t : v) {
-        Sign(std::get<0>(t), std::get<1>(t), std::get<2>(t));
+    if (v.size() == 1) {
+        Sign(std::get<0>(v[0]), std::get<1>(v[0]), std::get<2>(v[0]));
+        return true;
+    }
+
+    // Bursts of InstantSend input locks result in many pending signs at once. Create the sig shares in parallel on
+    // the BLS workers, but process them in order on this thread
+    std::vector<CSigShare> sigShares(v.size());
+    std::vector<char> created(v.size(), 0);
+    std::vector<std::future<void>> futures;
+    futures.reserve(v.size());
+    for (size_t i = 0; i < v.size(); i++) {
+        futures.emplace_back(blsWorker->AsyncRun([this, &v, &sigShares, &created, i]() {
+            created[i] = CreateSigShare(std::get<0>(v[i]), std::get<1>(v[i]), std::get<2>(v[i]), sigShares[i]);
+        }));
+    }
+    for (size_t i = 0; i < v.size(); i++) {
+        futures[i].get();
+        if (created[i]) {
+            ProcessSigShare(-1, sigShares[i], *g_connman, std::get<0>(v[i]));
+        }
     }
 
     return !v.empty();
 }
 
 void CSigSharesManager::Sign(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash)
+{
+    CSigShare sigShare;
+    if (CreateSigShare(quorum, id, msgHash, sigShare)) {
+        ProcessSigShare(-1, sigShare, *g_connman, quorum);
+    }
+}
+
+// Safe to be called on the BLS workers
+bool CSigSharesManager::CreateSigShare(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash, CSigShare& sigShare)
 {
     cxxtimer::Timer t(true);
 
     if (!quorum->IsValidMember(activeMasternodeInfo.proTxHash)) {
-        return;
+        return false;
     }
 
     CBLSSecretKey skShare = quorum->GetSkShare();
     if (!skShare.IsValid()) {
         LogPrint("llmq-sigs", "CSigSharesManager::%s -- we don't have our skShare for quorum %s\n", __func__, quorum->qc.quorumHash.ToString());
-        return;
+        return false;
     }
 
     int memberIdx = quorum->GetMemberIndex(activeMasternodeInfo.proTxHash);
     if (memberIdx == -1) {
         // this should really not happen (IsValidMember gave true)
-        return;
+        return false;
     }
 
-    CSigShare sigShare;
     sigShare.llmqType = quorum->params.type;
     sigShare.quorumHash = quorum->qc.quorumHash;
     sigShare.id = id;
@@ -1426,14 +1548,14 @@ void CSigSharesManager::Sign(const CQuorumCPtr& quorum, const uint256& id, const
     if (!sigShare.sigShare.Get().IsValid()) {
         LogPrintf("CSigSharesManager::%s -- failed to sign sigShare. signHash=%s, id=%s, msgHash=%s, time=%s\n", __func__,
                   signHash.ToString(), sigShare.id.ToString(), sigShare.msgHash.ToString(), t.count());
-        return;
+        return false;
     }
 
     sigShare.UpdateKey();
 
     LogPrint("llmq-sigs", "CSigSharesManager::%s -- signed sigShare. signHash=%s, id=%s, msgHash=%s, llmqType=%d, quorum=%s, time=%s\n", __func__,
               signHash.ToString(), sigShare.id.ToString(), sigShare.msgHash.ToString(), quorum->params.type, quorum->qc.quorumHash.ToString(), t.count());
-    ProcessSigShare(-1, sigShare, *g_connman, quorum);
+    return true;
 }
 
 // causes all known sigShares to be re-announced
@@ -1461,6 +1583,36 @@ void CSigSharesManager::ForceReAnnouncement(const CQuorumCPtr& quorum, Consensus
 	}
 }
 
+CSigSharesVerifyStats CSigSharesManager::GetVerifyStats()
+{
+    LOCK(cs);
+    return verifyStats;
+}
+
+memusage::SubsystemUsage CSigSharesManager::GetMemoryUsage()
+{
+    LOCK(cs);
+    memusage::SubsystemUsage usage;
+    usage.nEntries = sigShares.Size();
+    usage.nBytes = sigShares.DynamicMemoryUsage() + memusage::DynamicUsage(timeSeenForSessions) +
+                   memusage::DynamicUsage(nodeStates) + sigSharesRequested.DynamicMemoryUsage() +
+                   sigSharesToAnnounce.DynamicMemoryUsage() + memusage::DynamicUsage(pendingSigns);
+    auto invUsage = [](const CSigSharesInv& inv) {
+        return memusage::MallocUsage((inv.inv.capacity() + 7) / 8);
+    };
+    for (const auto& p : nodeStates) {
+        const CSigSharesNodeState& nodeState = p.second;
+        usage.nBytes += memusage::DynamicUsage(nodeState.sessions) + memusage::DynamicUsage(nodeState.sessionByRecvId) +
+                        memusage::DynamicUsage(nodeState.sessionsWithAnnounced) + memusage::DynamicUsage(nodeState.sessionsWithRequested) +
+                        nodeState.pendingIncomingSigShares.DynamicMemoryUsage() + nodeState.requestedSigShares.DynamicMemoryUsage();
+        for (const auto& q : nodeState.sessions) {
+            usage.nBytes += invUsage(q.second.announced) + invUsage(q.second.requested) + invUsage(q.second.knows);
+        }
+        usage.nEntries += nodeState.pendingIncomingSigShares.Size();
+    }
+    return usage;
+}
+
 void CSigSharesManager::HandleNewRecoveredSig(const llmq::CRecoveredSig& recoveredSig)
 {
     LOCK(cs);
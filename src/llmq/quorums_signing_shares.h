@@ -9,6 +9,7 @@
 
 #include "bls/bls.h"
 #include "chainparams.h"
+#include "memusage.h"
 #include "net.h"
 #include "random.h"
 #include "saltedhasher.h"
@@ -19,6 +20,7 @@
 
 #include "llmq/quorums.h"
 
+#include <future>
 #include <thread>
 #include <mutex>
 #include <unordered_map>
@@ -100,7 +102,11 @@ public:
 
         READWRITE(VARINT(sessionId));
         READWRITE(COMPACTSIZE(invSize));
-        READWRITE(AUTOBITSET(inv, (size_t)invSize));
+        if (s.GetVersion() >= SIGSHARESINV_RUNLENGTH_PROTO_VERSION) {
+            READWRITE(AUTOBITSET_RUNLENGTH(inv, (size_t)invSize));
+        } else {
+            READWRITE(AUTOBITSET(inv, (size_t)invSize));
+        }
     }
 
     void Init(size_t size);
@@ -214,6 +220,16 @@ public:
         return s;
     }
 
+    //! Not counting what the values allocate themselves
+    size_t DynamicMemoryUsage() const
+    {
+        size_t s = memusage::DynamicUsage(internalMap);
+        for (auto& p : internalMap) {
+            s += memusage::DynamicUsage(p.second);
+        }
+        return s;
+    }
+
     size_t CountForSignHash(const uint256& signHash) const
     {
         auto it = internalMap.find(signHash);
@@ -316,6 +332,11 @@ public:
     std::unordered_map<uint32_t, Session*> sessionByRecvId;
     uint32_t nextSendSessionId{1};
 
+    // Sessions of which "announced" or "requested" got bits set since the last time they were collected, so that
+    // CollectSigSharesToRequest and CollectSigSharesToSend don't have to scan every session on each run
+    std::unordered_set<uint256, StaticSaltedHasher> sessionsWithAnnounced;
+    std::unordered_set<uint256, StaticSaltedHasher> sessionsWithRequested;
+
     SigShareMap<CSigShare> pendingIncomingSigShares;
     SigShareMap<int64_t> requestedSigShares;
 
@@ -330,11 +351,30 @@ public:
     void RemoveSession(const uint256& signHash);
 };
 
+struct CSigSharesVerifyStats
+{
+    uint64_t nBatches{0};
+    uint64_t nSigShares{0};
+    uint64_t nBadSigShares{0};
+    int64_t nVerifyTimeTotal{0}; // microseconds
+    size_t nLastBatchSize{0};
+    int64_t nLastVerifyTime{0};
+    size_t nMaxBatchSize{0};
+    size_t nBatchLimit{0};
+};
+
 class CSigSharesManager : public CRecoveredSigsListener
 {
     static const int64_t SESSION_NEW_SHARES_TIMEOUT = 60;
     static const int64_t SIG_SHARE_REQUEST_TIMEOUT = 5;
 
+    // Pending shares of all sessions are verified together, in batches sized so that one batch takes about
+    // SIG_SHARES_VERIFY_BUDGET microseconds. Each BLS worker gets at least SIG_SHARES_PER_VERIFY_CHUNK of them.
+    static const int64_t SIG_SHARES_VERIFY_BUDGET = 50 * 1000;
+    static const size_t MIN_SIG_SHARES_PER_BATCH = 32;
+    static const size_t MAX_SIG_SHARES_PER_BATCH = 2048;
+    static const size_t SIG_SHARES_PER_VERIFY_CHUNK = 64;
+
     // we try to keep total message size below 10k
     const size_t MAX_MSGS_CNT_QSIGSESANN = 100;
     const size_t MAX_MSGS_CNT_QGETSIGSHARES = 200;
@@ -365,6 +405,21 @@ private:
     int64_t lastCleanupTime{0};
     std::atomic<uint32_t> recoveredSigsCounter{0};
 
+    // Recoveries running on the BLS workers, by sign hash. Their results are picked up by ProcessFinishedRecoveries
+    struct PendingRecovery {
+        CQuorumCPtr quorum;
+        uint256 id;
+        uint256 msgHash;
+        int64_t nStartTime;
+        std::future<CBLSSignature> future;
+    };
+
+    // only used by the worker thread
+    size_t nSigSharesPerBatch{MIN_SIG_SHARES_PER_BATCH};
+    std::unordered_map<uint256, PendingRecovery, StaticSaltedHasher> pendingRecoveries;
+    // protected by cs
+    CSigSharesVerifyStats verifyStats;
+
 public:
     CSigSharesManager();
     ~CSigSharesManager();
@@ -379,11 +434,15 @@ public:
     void ProcessMessage(CNode* pnode, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
 
     void AsyncSign(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash);
+    void AsyncSign(std::vector<std::tuple<const CQuorumCPtr, uint256, uint256>>&& signs);
     void Sign(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash);
 	void ForceReAnnouncement(const CQuorumCPtr& quorum, Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash);
 
     void HandleNewRecoveredSig(const CRecoveredSig& recoveredSig);
 
+    CSigSharesVerifyStats GetVerifyStats();
+    memusage::SubsystemUsage GetMemoryUsage();
+
 private:
     // all of these return false when the currently processed message should be aborted (as each message actually contains multiple messages)
     bool ProcessMessageSigSesAnn(CNode* pfrom, const CSigSesAnn& ann, CConnman& connman);
@@ -394,7 +453,7 @@ private:
     bool VerifySigSharesInv(NodeId from, Consensus::LLMQType llmqType, const CSigSharesInv& inv);
     bool PreVerifyBatchedSigShares(NodeId nodeId, const CSigSharesNodeState::SessionInfo& session, const CBatchedSigShares& batchedSigShares, bool& retBan);
 
-    void CollectPendingSigSharesToVerify(size_t maxUniqueSessions,
+    void CollectPendingSigSharesToVerify(size_t maxSigShares,
             std::unordered_map<NodeId, std::vector<CSigShare>>& retSigShares,
             std::unordered_map<std::pair<Consensus::LLMQType, uint256>, CQuorumCPtr, StaticSaltedHasher>& retQuorums);
     bool ProcessPendingSigShares(CConnman& connman);
@@ -405,7 +464,8 @@ private:
             CConnman& connman);
 
     void ProcessSigShare(NodeId nodeId, const CSigShare& sigShare, CConnman& connman, const CQuorumCPtr& quorum);
-    void TryRecoverSig(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash, CConnman& connman);
+    void TryRecoverSig(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash);
+    bool ProcessFinishedRecoveries(CConnman& connman);
 
 private:
     bool GetSessionInfoByRecvId(NodeId nodeId, uint32_t sessionId, CSigSharesNodeState::SessionInfo& retInfo);
@@ -422,6 +482,7 @@ private:
     void CollectSigSharesToSend(std::unordered_map<NodeId, std::unordered_map<uint256, CBatchedSigShares, StaticSaltedHasher>>& sigSharesToSend);
     void CollectSigSharesToAnnounce(std::unordered_map<NodeId, std::unordered_map<uint256, CSigSharesInv, StaticSaltedHasher>>& sigSharesToAnnounce);
     bool SignPendingSigShares();
+    bool CreateSigShare(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash, CSigShare& sigShareRet);
     void WorkThreadMain();
 };
 
@@ -9,17 +9,53 @@
 
 #include "chainparams.h"
 #include "random.h"
+#include "saltedhasher.h"
+#include "unordered_lru_cache.h"
 #include "validation.h"
 
 namespace llmq
 {
 
-	std::vector<CDeterministicMNCPtr> CLLMQUtils::GetAllQuorumMembers(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum)
+// Members and connections only depend on the quorum block, so cached entries stay valid across reorgs.
+// One entry per active quorum plus one for the DKG in progress is enough to compute each quorum once.
+static CCriticalSection cs_quorumMembersCache;
+static std::map<Consensus::LLMQType, unordered_lru_cache<uint256, std::vector<CDeterministicMNCPtr>, StaticSaltedHasher>> mapQuorumMembers;
+// keyed by hash of (quorumHash, forMember)
+static std::map<Consensus::LLMQType, unordered_lru_cache<uint256, std::set<uint256>, StaticSaltedHasher>> mapQuorumConnections;
+
+template<typename Value>
+static unordered_lru_cache<uint256, Value, StaticSaltedHasher>& GetQuorumCache(std::map<Consensus::LLMQType, unordered_lru_cache<uint256, Value, StaticSaltedHasher>>& caches, Consensus::LLMQType llmqType)
+{
+    AssertLockHeld(cs_quorumMembersCache);
+    auto it = caches.find(llmqType);
+    if (it == caches.end()) {
+        size_t nSize = Params().GetConsensus().llmqs.at(llmqType).signingActiveQuorumCount + 2;
+        it = caches.emplace(std::piecewise_construct, std::forward_as_tuple(llmqType), std::forward_as_tuple(nSize)).first;
+    }
+    return it->second;
+}
+
+std::vector<CDeterministicMNCPtr> CLLMQUtils::GetAllQuorumMembers(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum)
 {
+    std::vector<CDeterministicMNCPtr> quorumMembers;
+    {
+        LOCK(cs_quorumMembersCache);
+        if (GetQuorumCache(mapQuorumMembers, llmqType).get(pindexQuorum->GetBlockHash(), quorumMembers)) {
+            return quorumMembers;
+        }
+    }
+
     auto& params = Params().GetConsensus().llmqs.at(llmqType);
 	auto allMns = deterministicMNManager->GetListForBlock(pindexQuorum);
 	auto modifier = ::SerializeHash(std::make_pair((uint8_t)llmqType, pindexQuorum->GetBlockHash()));
-    return allMns.CalculateQuorum(params.size, modifier);
+    quorumMembers = allMns.CalculateQuorum(params.size, modifier);
+
+    // no list means the block wasn't processed yet (or is from before DIP3), don't remember that
+    if (allMns.GetHeight() != -1) {
+        LOCK(cs_quorumMembersCache);
+        GetQuorumCache(mapQuorumMembers, llmqType).insert(pindexQuorum->GetBlockHash(), quorumMembers);
+    }
+    return quorumMembers;
 }
 
 uint256 CLLMQUtils::BuildCommitmentHash(uint8_t llmqType, const uint256& blockHash, const std::vector<bool>& validMembers, const CBLSPublicKey& pubKey, const uint256& vvecHash)
@@ -45,10 +81,16 @@ uint256 CLLMQUtils::BuildSignHash(Consensus::LLMQType llmqType, const uint256& q
 
 std::set<uint256> CLLMQUtils::GetQuorumConnections(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum, const uint256& forMember)
 {
-    auto& params = Params().GetConsensus().llmqs.at(llmqType);
+    uint256 cacheKey = ::SerializeHash(std::make_pair(pindexQuorum->GetBlockHash(), forMember));
+    std::set<uint256> result;
+    {
+        LOCK(cs_quorumMembersCache);
+        if (GetQuorumCache(mapQuorumConnections, llmqType).get(cacheKey, result)) {
+            return result;
+        }
+    }
 
 	auto mns = GetAllQuorumMembers(llmqType, pindexQuorum);
-    std::set<uint256> result;
     for (size_t i = 0; i < mns.size(); i++) {
         auto& dmn = mns[i];
         if (dmn->proTxHash == forMember) {
@@ -72,6 +114,11 @@ std::set<uint256> CLLMQUtils::GetQuorumConnections(Consensus::LLMQType llmqType,
             break;
         }
     }
+
+    if (!mns.empty()) {
+        LOCK(cs_quorumMembersCache);
+        GetQuorumCache(mapQuorumConnections, llmqType).insert(cacheKey, result);
+    }
     return result;
 }
 
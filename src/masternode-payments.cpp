@@ -248,7 +248,7 @@ std::map<int, std::string> GetRequiredPaymentsStrings(int nStartHeight, int nEnd
     bool doProjection = false;
     for(int h = nStartHeight; h < nEndHeight; h++) {
         if (h <= nChainTipHeight) {
-			auto payee = deterministicMNManager->GetListForBlock(chainActive[h - 1]).GetMNPayee();
+			auto payee = mnpayments.GetBlockPayee(chainActive[h - 1]);
             mapPayments.emplace(h, GetRequiredPaymentsString(h, payee));
         } else {
             doProjection = true;
@@ -306,8 +306,7 @@ bool CMasternodePayments::GetBlockTxOuts(int nBlockHeight, CAmount blockReward,
         LOCK(cs_main);
 		pindex = chainActive[nBlockHeight - 1];
     }
-    uint256 proTxHash;
-	auto dmnPayee = deterministicMNManager->GetListForBlock(pindex).GetMNPayee();
+	auto dmnPayee = GetBlockPayee(pindex);
     if (!dmnPayee) {
         return false;
     }
@@ -330,6 +329,30 @@ bool CMasternodePayments::GetBlockTxOuts(int nBlockHeight, CAmount blockReward,
     return true;
 }
 
+CDeterministicMNCPtr CMasternodePayments::GetBlockPayee(const CBlockIndex* pindexPrev) const
+{
+    if (!pindexPrev) {
+        return deterministicMNManager->GetListForBlock(pindexPrev).GetMNPayee();
+    }
+
+    CDeterministicMNCPtr payee;
+    {
+        LOCK(cs_payeeCache);
+        if (payeeCache.get(pindexPrev->GetBlockHash(), payee)) {
+            return payee;
+        }
+    }
+
+    payee = deterministicMNManager->GetListForBlock(pindexPrev).GetMNPayee();
+
+    // don't cache empty results, the list might just not be known yet (e.g. while the parent is being connected)
+    if (payee) {
+        LOCK(cs_payeeCache);
+        payeeCache.insert(pindexPrev->GetBlockHash(), payee);
+    }
+    return payee;
+}
+
 // Is this masternode scheduled to get paid soon?
 // -- Only look ahead up to 8 blocks to allow for propagation of the latest 2 blocks of votes
 bool CMasternodePayments::IsScheduled(const CDeterministicMNCPtr& dmnIn, int nNotBlockHeight) const
@@ -35,7 +35,14 @@ std::map<int, std::string> GetRequiredPaymentsStrings(int nStartHeight, int nEnd
 
 class CMasternodePayments
 {
+private:
+    // The payee of a block only depends on the MN list at its parent, so it's cached per parent block hash. Block
+    // validation and getblocktemplate keep asking for the payee of the same few blocks
+    mutable CCriticalSection cs_payeeCache;
+    mutable unordered_lru_cache<uint256, CDeterministicMNCPtr, StaticSaltedHasher, 32> payeeCache;
+
 public:
+    CDeterministicMNCPtr GetBlockPayee(const CBlockIndex* pindexPrev) const;
     bool GetBlockTxOuts(int nBlockHeight, CAmount blockReward, std::vector<CTxOut>& voutMasternodePaymentsRet) const;
     bool IsTransactionValid(const CTransaction& txNew, int nBlockHeight, CAmount blockReward) const;
     bool IsScheduled(const CDeterministicMNCPtr& dmn, int nNotBlockHeight) const;
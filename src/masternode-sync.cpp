@@ -18,19 +18,36 @@
 class CMasternodeSync;
 CMasternodeSync masternodeSync;
 
+const std::string CMasternodeSync::SERIALIZATION_VERSION_STRING = "CMasternodeSync-Version-1";
+
 void CMasternodeSync::Fail()
 {
     nTimeLastFailure = GetTime();
     nCurrentAsset = MASTERNODE_SYNC_FAILED;
 }
 
-void CMasternodeSync::Reset()
+void CMasternodeSync::ResetProgress()
 {
     nCurrentAsset = MASTERNODE_SYNC_INITIAL;
     nTriedPeerCount = 0;
     nTimeAssetSyncStarted = GetTime();
     nTimeLastBumped = GetTime();
     nTimeLastFailure = 0;
+    nTimeSporksRequested = 0;
+}
+
+void CMasternodeSync::Reset()
+{
+    ResetProgress();
+
+    LOCK(cs);
+    setGovernanceSyncPeers.clear();
+    setGovernanceSyncDonePeers.clear();
+}
+
+std::string CMasternodeSync::ToString() const
+{
+    return strprintf("Last synced: %lld", nTimeLastSynced);
 }
 
 void CMasternodeSync::BumpAssetLastTime(const std::string& strFuncName)
@@ -72,6 +89,7 @@ void CMasternodeSync::SwitchToNextAsset(CConnman& connman)
         case(MASTERNODE_SYNC_GOVERNANCE):
             LogPrintf("CMasternodeSync::SwitchToNextAsset -- Completed %s in %llds\n", GetAssetName(), GetTime() - nTimeAssetSyncStarted);
             nCurrentAsset = MASTERNODE_SYNC_FINISHED;
+            nTimeLastSynced = GetTime();
             uiInterface.NotifyAdditionalDataSyncProgressChanged(1);
 
             connman.ForEachNode(CConnman::AllNodes, [](CNode* pnode) {
@@ -110,6 +128,16 @@ void CMasternodeSync::ProcessMessage(CNode* pfrom, const std::string& strCommand
         vRecv >> nItemID >> nCount;
 
         LogPrintf("SYNCSTATUSCOUNT -- got inventory count: nItemID=%d  nCount=%d  peer=%d\n", nItemID, nCount, pfrom->id);
+
+        if (nItemID == MASTERNODE_SYNC_GOVOBJ) {
+            // the peer announced all objects we don't have yet
+            LOCK(cs);
+            if (setGovernanceSyncPeers.count(pfrom->id)) {
+                setGovernanceSyncDonePeers.insert(pfrom->id);
+            }
+        }
+        // the announced objects and votes are on their way
+        BumpAssetLastTime("SYNCSTATUSCOUNT");
     }
 }
 
@@ -159,6 +187,8 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
     uiInterface.NotifyAdditionalDataSyncProgressChanged(nSyncProgress);
 
     std::vector<CNode*> vNodesCopy = connman.CopyNodeVector(CConnman::FullyConnectedOnly);
+    // the peers we can sync from
+    std::vector<CNode*> vSyncPeers;
 
     for (auto& pnode : vNodesCopy)
     {
@@ -185,107 +215,148 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
         }
 
         // NORMAL NETWORK MODE - TESTNET/MAINNET
+        if(netfulfilledman.HasFulfilledRequest(pnode->addr, "full-sync") &&
+           Params().NetworkIDString() == CBaseChainParams::MAIN)
         {
-            if(netfulfilledman.HasFulfilledRequest(pnode->addr, "full-sync") &&
-               Params().NetworkIDString() == CBaseChainParams::MAIN)
-            {
-                // We already fully synced from this node recently,
-                // disconnect to free this connection slot for another peer.
-                pnode->fDisconnect = true;
-                LogPrintf("CMasternodeSync::ProcessTick -- disconnecting from recently synced peer=%d\n", pnode->id);
-                continue;
-            }
+            // We already fully synced from this node recently,
+            // disconnect to free this connection slot for another peer.
+            pnode->fDisconnect = true;
+            LogPrintf("CMasternodeSync::ProcessTick -- disconnecting from recently synced peer=%d\n", pnode->id);
+            continue;
+        }
 
-            // SPORK : ALWAYS ASK FOR SPORKS AS WE SYNC
+        // SPORK : ALWAYS ASK FOR SPORKS AS WE SYNC
 
-            if(!netfulfilledman.HasFulfilledRequest(pnode->addr, "spork-sync")) {
-                // always get sporks first, only request once from each peer
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "spork-sync");
-                // get current network sporks
-                connman.PushMessage(pnode, msgMaker.Make(NetMsgType::GETSPORKS));
-                LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nCurrentAsset %d -- requesting sporks from peer=%d\n", nTick, nCurrentAsset, pnode->id);
+        if(!netfulfilledman.HasFulfilledRequest(pnode->addr, "spork-sync")) {
+            // always get sporks first, only request once from each peer
+            netfulfilledman.AddFulfilledRequest(pnode->addr, "spork-sync");
+            // get current network sporks
+            connman.PushMessage(pnode, msgMaker.Make(NetMsgType::GETSPORKS));
+            LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nCurrentAsset %d -- requesting sporks from peer=%d\n", nTick, nCurrentAsset, pnode->id);
+            if (nTimeSporksRequested == 0) {
+                nTimeSporksRequested = GetTime();
             }
+        }
 
-            // INITIAL TIMEOUT
-
-            if(nCurrentAsset == MASTERNODE_SYNC_WAITING) {
-                if(GetTime() - nTimeLastBumped > MASTERNODE_SYNC_TIMEOUT_SECONDS) {
-                    // At this point we know that:
-                    // a) there are peers (because we are looping on at least one of them);
-                    // b) we waited for at least MASTERNODE_SYNC_TIMEOUT_SECONDS since we reached
-                    //    the headers tip the last time (i.e. since we switched from
-                    //     MASTERNODE_SYNC_INITIAL to MASTERNODE_SYNC_WAITING and bumped time);
-                    // c) there were no blocks (UpdatedBlockTip, NotifyHeaderTip) or headers (AcceptedBlockHeader)
-                    //    for at least MASTERNODE_SYNC_TIMEOUT_SECONDS.
-                    // We must be at the tip already, let's move to the next asset.
-                    SwitchToNextAsset(connman);
-                }
-            }
+        vSyncPeers.push_back(pnode);
+    }
 
-            // GOVOBJ : SYNC GOVERNANCE ITEMS FROM OUR PEERS
-
-            if(nCurrentAsset == MASTERNODE_SYNC_GOVERNANCE) {
-                LogPrint("gobject", "CMasternodeSync::ProcessTick -- nTick %d nCurrentAsset %d nTimeLastBumped %lld GetTime() %lld diff %lld\n", nTick, nCurrentAsset, nTimeLastBumped, GetTime(), GetTime() - nTimeLastBumped);
-
-                // check for timeout first
-                if(GetTime() - nTimeLastBumped > MASTERNODE_SYNC_TIMEOUT_SECONDS) {
-                    LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nCurrentAsset %d -- timeout\n", nTick, nCurrentAsset);
-                    if(nTriedPeerCount == 0) {
-                        LogPrintf("CMasternodeSync::ProcessTick -- WARNING: failed to sync %s\n", GetAssetName());
-                        // it's kind of ok to skip this for now, hopefully we'll catch up later?
-                    }
-                    SwitchToNextAsset(connman);
-                    connman.ReleaseNodeVector(vNodesCopy);
-                    return;
-                }
-
-                // only request obj sync once from each peer, then request votes on per-obj basis
-                if(netfulfilledman.HasFulfilledRequest(pnode->addr, "governance-sync")) {
-                    int nObjsLeftToAsk = governance.RequestGovernanceObjectVotes(pnode, connman);
-                    static int64_t nTimeNoObjectsLeft = 0;
-                    // check for data
-                    if(nObjsLeftToAsk == 0) {
-                        static int nLastTick = 0;
-                        static int nLastVotes = 0;
-                        if(nTimeNoObjectsLeft == 0) {
-                            // asked all objects for votes for the first time
-                            nTimeNoObjectsLeft = GetTime();
-                        }
-                        // make sure the condition below is checked only once per tick
-                        if(nLastTick == nTick) continue;
-                        if(GetTime() - nTimeNoObjectsLeft > MASTERNODE_SYNC_TIMEOUT_SECONDS &&
-                            governance.GetVoteCount() - nLastVotes < std::max(int(0.0001 * nLastVotes), MASTERNODE_SYNC_TICK_SECONDS)
-                        ) {
-                            // We already asked for all objects, waited for MASTERNODE_SYNC_TIMEOUT_SECONDS
-                            // after that and less then 0.01% or MASTERNODE_SYNC_TICK_SECONDS
-                            // (i.e. 1 per second) votes were recieved during the last tick.
-                            // We can be pretty sure that we are done syncing.
-                            LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nCurrentAsset %d -- asked for all objects, nothing to do\n", nTick, nCurrentAsset);
-                            // reset nTimeNoObjectsLeft to be able to use the same condition on resync
-                            nTimeNoObjectsLeft = 0;
-                            SwitchToNextAsset(connman);
-                            connman.ReleaseNodeVector(vNodesCopy);
-                            return;
-                        }
-                        nLastTick = nTick;
-                        nLastVotes = governance.GetVoteCount();
-                    }
-                    continue;
-                }
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "governance-sync");
-
-                if (pnode->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) continue;
-                nTriedPeerCount++;
+    if (nCurrentAsset == MASTERNODE_SYNC_WAITING) {
+        ProcessWaiting(vSyncPeers, connman);
+    } else if (nCurrentAsset == MASTERNODE_SYNC_GOVERNANCE) {
+        ProcessGovernance(vSyncPeers, nTick, connman);
+    }
 
-                SendGovernanceSyncRequest(pnode, connman);
+    connman.ReleaseNodeVector(vNodesCopy);
+}
 
-                connman.ReleaseNodeVector(vNodesCopy);
-                return; //this will cause each peer to get one request each six seconds for the various assets we need
-            }
+void CMasternodeSync::ProcessWaiting(const std::vector<CNode*>& vSyncPeers, CConnman& connman)
+{
+    if (vSyncPeers.empty()) return;
+
+    // INITIAL TIMEOUT
+
+    if(GetTime() - nTimeLastBumped > MASTERNODE_SYNC_TIMEOUT_SECONDS) {
+        // At this point we know that:
+        // a) there are peers;
+        // b) we waited for at least MASTERNODE_SYNC_TIMEOUT_SECONDS since we reached
+        //    the headers tip the last time (i.e. since we switched from
+        //     MASTERNODE_SYNC_INITIAL to MASTERNODE_SYNC_WAITING and bumped time);
+        // c) there were no blocks (UpdatedBlockTip, NotifyHeaderTip) or headers (AcceptedBlockHeader)
+        //    for at least MASTERNODE_SYNC_TIMEOUT_SECONDS.
+        // We must be at the tip already, let's move to the next asset.
+        SwitchToNextAsset(connman);
+        return;
+    }
+
+    // Don't wait for the timeout if the sporks had a tick to arrive and none
+    // of the peers started with a longer chain than the one we have now.
+    if (nTimeSporksRequested == 0 || GetTime() - nTimeSporksRequested < MASTERNODE_SYNC_TICK_SECONDS) return;
+
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height();
+    }
+    for (const auto& pnode : vSyncPeers) {
+        if (pnode->nStartingHeight > nHeight) return;
+    }
+
+    LogPrintf("CMasternodeSync::ProcessTick -- no peer is ahead of us at height %d\n", nHeight);
+    SwitchToNextAsset(connman);
+}
+
+void CMasternodeSync::ProcessGovernance(const std::vector<CNode*>& vSyncPeers, int nTick, CConnman& connman)
+{
+    // GOVOBJ : SYNC GOVERNANCE ITEMS FROM OUR PEERS
+
+    LogPrint("gobject", "CMasternodeSync::ProcessTick -- nTick %d nCurrentAsset %d nTimeLastBumped %lld GetTime() %lld diff %lld\n", nTick, nCurrentAsset, nTimeLastBumped, GetTime(), GetTime() - nTimeLastBumped);
+
+    // check for timeout first
+    if(GetTime() - nTimeLastBumped > MASTERNODE_SYNC_TIMEOUT_SECONDS) {
+        LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nCurrentAsset %d -- timeout\n", nTick, nCurrentAsset);
+        if(nTriedPeerCount == 0) {
+            LogPrintf("CMasternodeSync::ProcessTick -- WARNING: failed to sync %s\n", GetAssetName());
+            // it's kind of ok to skip this for now, hopefully we'll catch up later?
         }
+        SwitchToNextAsset(connman);
+        return;
+    }
+
+    std::set<NodeId> setPeers, setDonePeers;
+    {
+        LOCK(cs);
+        setPeers = setGovernanceSyncPeers;
+        setDonePeers = setGovernanceSyncDonePeers;
+    }
+
+    // peers which still send us their object inventory
+    int nPending = 0;
+    int nDone = 0;
+    int nEligible = 0;
+    for (const auto& pnode : vSyncPeers) {
+        if (pnode->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) continue;
+        nEligible++;
+        if (setDonePeers.count(pnode->id)) {
+            nDone++;
+        } else if (setPeers.count(pnode->id)) {
+            nPending++;
+        }
+    }
+
+    // ask several peers for the objects at once instead of one per tick,
+    // votes are requested per object from every peer which was asked already
+    int nObjsLeftToAsk = 0;
+    for (const auto& pnode : vSyncPeers) {
+        // only request obj sync once from each peer, then request votes on per-obj basis
+        if(netfulfilledman.HasFulfilledRequest(pnode->addr, "governance-sync")) {
+            nObjsLeftToAsk = std::max(nObjsLeftToAsk, governance.RequestGovernanceObjectVotes(pnode, connman));
+            continue;
+        }
+        if (nPending + nDone >= MASTERNODE_SYNC_GOVERNANCE_PEERS) continue;
+        netfulfilledman.AddFulfilledRequest(pnode->addr, "governance-sync");
+
+        if (pnode->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) continue;
+        nTriedPeerCount++;
+        nPending++;
+        {
+            LOCK(cs);
+            setGovernanceSyncPeers.insert(pnode->id);
+        }
+
+        LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nCurrentAsset %d -- requesting governance objects from peer=%d\n", nTick, nCurrentAsset, pnode->id);
+        SendGovernanceSyncRequest(pnode, connman);
+    }
+
+    // We are done when enough peers have sent their whole object inventory, every object
+    // was asked for votes and nothing arrived during the last tick. After a recent sync
+    // governance.dat is mostly complete already and the inventory of one peer is enough.
+    int nRequired = std::max(1, std::min(IsResumed() ? 1 : MASTERNODE_SYNC_GOVERNANCE_PEERS, nEligible));
+    if (nDone >= nRequired && nObjsLeftToAsk == 0 &&
+        GetTime() - nTimeLastBumped >= MASTERNODE_SYNC_TICK_SECONDS) {
+        LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nCurrentAsset %d -- got all objects from %d peers, nothing to do\n", nTick, nCurrentAsset, nDone);
+        SwitchToNextAsset(connman);
     }
-    // looped through all nodes, release them
-    connman.ReleaseNodeVector(vNodesCopy);
 }
 
 void CMasternodeSync::SendGovernanceSyncRequest(CNode* pnode, CConnman& connman)
@@ -293,8 +364,9 @@ void CMasternodeSync::SendGovernanceSyncRequest(CNode* pnode, CConnman& connman)
     CNetMsgMaker msgMaker(pnode->GetSendVersion());
 
     if(pnode->nVersion >= GOVERNANCE_FILTER_PROTO_VERSION) {
-        CBloomFilter filter;
-        filter.clear();
+        // Only let the peer announce the objects we are missing, that makes a resync after
+        // a restart cheap. Older peers ignore the filter and still send everything.
+        CBloomFilter filter = governance.GetKnownObjectsFilter();
 
         connman.PushMessage(pnode, msgMaker.Make(NetMsgType::MNGOVERNANCESYNC, uint256(), filter));
     }
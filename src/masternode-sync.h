@@ -8,6 +8,10 @@
 
 #include "chain.h"
 #include "net.h"
+#include "serialize.h"
+#include "sync.h"
+
+#include <set>
 
 class CMasternodeSync;
 
@@ -21,6 +25,8 @@ static const int MASTERNODE_SYNC_FINISHED        = 999;
 
 static const int MASTERNODE_SYNC_TICK_SECONDS    = 6;
 static const int MASTERNODE_SYNC_TIMEOUT_SECONDS = 30; // our blocks are 2.5 minutes so 30 seconds should be fine
+static const int MASTERNODE_SYNC_GOVERNANCE_PEERS = 3; // sync governance from that many peers at once
+static const int MASTERNODE_SYNC_RESUME_SECONDS  = 3 * 60 * 60; // trust governance.dat if we were synced that recently
 
 extern CMasternodeSync masternodeSync;
 
@@ -42,11 +48,55 @@ private:
     int64_t nTimeLastBumped;
     // ... or failed
     int64_t nTimeLastFailure;
+    // Time when sporks were first requested after reaching the headers tip
+    int64_t nTimeSporksRequested;
+    // Time when we were fully synced the last time, kept across restarts
+    int64_t nTimeLastSynced;
+
+    // Protects the peer sets below, SYNCSTATUSCOUNT is handled on the network thread
+    mutable CCriticalSection cs;
+    // Peers asked for governance objects during this sync ...
+    std::set<NodeId> setGovernanceSyncPeers;
+    // ... and the ones of them which finished sending their object inventory
+    std::set<NodeId> setGovernanceSyncDonePeers;
+
+    static const std::string SERIALIZATION_VERSION_STRING;
 
     void Fail();
+    void ResetProgress();
+
+    void ProcessWaiting(const std::vector<CNode*>& vSyncPeers, CConnman& connman);
+    void ProcessGovernance(const std::vector<CNode*>& vSyncPeers, int nTick, CConnman& connman);
 
 public:
-    CMasternodeSync() { Reset(); }
+    CMasternodeSync() : nTimeLastSynced(0) { ResetProgress(); }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        std::string strVersion;
+        if(ser_action.ForRead()) {
+            READWRITE(strVersion);
+            if (strVersion != SERIALIZATION_VERSION_STRING) {
+                return;
+            }
+            READWRITE(nTimeLastSynced);
+        } else {
+            strVersion = SERIALIZATION_VERSION_STRING;
+            READWRITE(strVersion);
+            int64_t nTimeSynced = IsSynced() ? GetTime() : nTimeLastSynced;
+            READWRITE(nTimeSynced);
+        }
+    }
+
+    // Required by CFlatDB, only the time of the last full sync is stored
+    void Clear() { nTimeLastSynced = 0; }
+    void CheckAndRemove() {}
+    std::string ToString() const;
+
+    // Whether a previous run was synced recently enough to take its governance data as a base
+    bool IsResumed() const { return nTimeLastSynced != 0 && GetTime() - nTimeLastSynced < MASTERNODE_SYNC_RESUME_SECONDS; }
 
 
     void SendGovernanceSyncRequest(CNode* pnode, CConnman& connman);
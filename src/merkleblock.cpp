@@ -70,24 +70,29 @@ CMerkleBlock::CMerkleBlock(const CBlock& block, const std::set<uint256>& txids)
     txn = CPartialMerkleTree(vHashes, vMatch);
 }
 
-uint256 CPartialMerkleTree::CalcHash(int height, unsigned int pos, const std::vector<uint256> &vTxid) {
-    if (height == 0) {
-        // hash at height 0 is the txids themself
-        return vTxid[pos];
-    } else {
-        // calculate left hash
-        uint256 left = CalcHash(height-1, pos*2, vTxid), right;
-        // calculate right hash if not beyond the end of the array - copy left hash otherwise
-        if (pos*2+1 < CalcTreeWidth(height-1))
-            right = CalcHash(height-1, pos*2+1, vTxid);
-        else
-            right = left;
-        // combine subhashes
-        return Hash(BEGIN(left), END(left), BEGIN(right), END(right));
+CMerkleBlock::CMerkleBlock(const CBlockHeader& headerIn, const MerkleLevels& vLevels, const std::vector<bool>& vMatch) : header(headerIn), txn(vLevels, vMatch)
+{
+}
+
+MerkleLevels ComputeMerkleLevels(const std::vector<uint256>& vTxid)
+{
+    MerkleLevels vLevels(1, vTxid);
+    while (vLevels.back().size() > 1) {
+        const std::vector<uint256>& vBelow = vLevels.back();
+        std::vector<uint256> vLevel;
+        vLevel.reserve((vBelow.size() + 1) / 2);
+        for (size_t i = 0; i < vBelow.size(); i += 2) {
+            // copy left hash if there is no right one
+            const uint256& left = vBelow[i];
+            const uint256& right = i + 1 < vBelow.size() ? vBelow[i + 1] : left;
+            vLevel.push_back(Hash(BEGIN(left), END(left), BEGIN(right), END(right)));
+        }
+        vLevels.push_back(std::move(vLevel));
     }
+    return vLevels;
 }
 
-void CPartialMerkleTree::TraverseAndBuild(int height, unsigned int pos, const std::vector<uint256> &vTxid, const std::vector<bool> &vMatch) {
+void CPartialMerkleTree::TraverseAndBuild(int height, unsigned int pos, const MerkleLevels &vLevels, const std::vector<bool> &vMatch) {
     // determine whether this node is the parent of at least one matched txid
     bool fParentOfMatch = false;
     for (unsigned int p = pos << height; p < (pos+1) << height && p < nTransactions; p++)
@@ -96,12 +101,12 @@ void CPartialMerkleTree::TraverseAndBuild(int height, unsigned int pos, const st
     vBits.push_back(fParentOfMatch);
     if (height==0 || !fParentOfMatch) {
         // if at height 0, or nothing interesting below, store hash and stop
-        vHash.push_back(CalcHash(height, pos, vTxid));
+        vHash.push_back(vLevels[height][pos]);
     } else {
         // otherwise, don't store any hash, but descend into the subtrees
-        TraverseAndBuild(height-1, pos*2, vTxid, vMatch);
+        TraverseAndBuild(height-1, pos*2, vLevels, vMatch);
         if (pos*2+1 < CalcTreeWidth(height-1))
-            TraverseAndBuild(height-1, pos*2+1, vTxid, vMatch);
+            TraverseAndBuild(height-1, pos*2+1, vLevels, vMatch);
     }
 }
 
@@ -143,7 +148,7 @@ uint256 CPartialMerkleTree::TraverseAndExtract(int height, unsigned int pos, uns
     }
 }
 
-CPartialMerkleTree::CPartialMerkleTree(const std::vector<uint256> &vTxid, const std::vector<bool> &vMatch) : nTransactions(vTxid.size()), fBad(false) {
+void CPartialMerkleTree::Build(const MerkleLevels &vLevels, const std::vector<bool> &vMatch) {
     // reset state
     vBits.clear();
     vHash.clear();
@@ -154,7 +159,15 @@ CPartialMerkleTree::CPartialMerkleTree(const std::vector<uint256> &vTxid, const
         nHeight++;
 
     // traverse the partial tree
-    TraverseAndBuild(nHeight, 0, vTxid, vMatch);
+    TraverseAndBuild(nHeight, 0, vLevels, vMatch);
+}
+
+CPartialMerkleTree::CPartialMerkleTree(const std::vector<uint256> &vTxid, const std::vector<bool> &vMatch) : nTransactions(vTxid.size()), fBad(false) {
+    Build(ComputeMerkleLevels(vTxid), vMatch);
+}
+
+CPartialMerkleTree::CPartialMerkleTree(const MerkleLevels &vLevels, const std::vector<bool> &vMatch) : nTransactions(vLevels.empty() ? 0 : vLevels[0].size()), fBad(false) {
+    Build(vLevels, vMatch);
 }
 
 CPartialMerkleTree::CPartialMerkleTree() : nTransactions(0), fBad(true) {}
@@ -13,6 +13,14 @@
 
 #include <vector>
 
+/**
+ * All levels of the merkle tree of a list of txids, from the txids themselves up to the root. A node
+ * without a right sibling is combined with itself, like in the block merkle root.
+ */
+typedef std::vector<std::vector<uint256> > MerkleLevels;
+
+MerkleLevels ComputeMerkleLevels(const std::vector<uint256>& vTxid);
+
 /** Data structure that represents a partial merkle tree.
  *
  * It represents a subset of the txid's of a known block, in a way that
@@ -67,11 +75,10 @@ protected:
         return (nTransactions+(1 << height)-1) >> height;
     }
 
-    /** calculate the hash of a node in the merkle tree (at leaf level: the txid's themselves) */
-    uint256 CalcHash(int height, unsigned int pos, const std::vector<uint256> &vTxid);
-
     /** recursive function that traverses tree nodes, storing the data as bits and hashes */
-    void TraverseAndBuild(int height, unsigned int pos, const std::vector<uint256> &vTxid, const std::vector<bool> &vMatch);
+    void TraverseAndBuild(int height, unsigned int pos, const MerkleLevels &vLevels, const std::vector<bool> &vMatch);
+
+    void Build(const MerkleLevels &vLevels, const std::vector<bool> &vMatch);
 
     /**
      * recursive function that traverses tree nodes, consuming the bits and hashes produced by TraverseAndBuild.
@@ -107,6 +114,9 @@ public:
     /** Construct a partial merkle tree from a list of transaction ids, and a mask that selects a subset of them */
     CPartialMerkleTree(const std::vector<uint256> &vTxid, const std::vector<bool> &vMatch);
 
+    /** Construct a partial merkle tree from the levels of a full one, which can be reused for any number of masks */
+    CPartialMerkleTree(const MerkleLevels &vLevels, const std::vector<bool> &vMatch);
+
     CPartialMerkleTree();
 
     /**
@@ -143,6 +153,9 @@ public:
     // Create from a CBlock, matching the txids in the set
     CMerkleBlock(const CBlock& block, const std::set<uint256>& txids);
 
+    // Create from the header and the merkle levels of a block, matching the txids selected by vMatch
+    CMerkleBlock(const CBlockHeader& headerIn, const MerkleLevels& vLevels, const std::vector<bool>& vMatch);
+
     CMerkleBlock() {}
 
     ADD_SERIALIZE_METHODS;
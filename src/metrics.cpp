@@ -0,0 +1,103 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "metrics.h"
+
+#include "chainparams.h"
+#include "httpserver.h"
+#include "net.h"
+#include "net_processing.h"
+#include "rpc/protocol.h"
+#include "tinyformat.h"
+#include "txmempool.h"
+#include "validation.h"
+
+#include "llmq/quorums_dkgsessionmgr.h"
+
+#include <sstream>
+
+CNodeMetrics g_metrics;
+
+static const char* const METRICS_PATH = "/metrics";
+
+static void WriteMetricHeader(std::ostringstream& os, const std::string& strName, const char* strType, const std::string& strHelp)
+{
+    os << "# HELP " << strName << " " << strHelp << "\n";
+    os << "# TYPE " << strName << " " << strType << "\n";
+}
+
+template <typename T>
+static void WriteMetric(std::ostringstream& os, const std::string& strName, const char* strType, const std::string& strHelp, T value)
+{
+    WriteMetricHeader(os, strName, strType, strHelp);
+    os << strName << " " << value << "\n";
+}
+
+/** Everything read here is an atomic or behind a lock only held for short, never cs_main */
+static std::string RenderMetrics()
+{
+    std::ostringstream os;
+
+    WriteMetric(os, "epmcoin_chain_height", "gauge", "Height of the active chain tip", g_metrics.nChainHeight.load());
+    WriteMetric(os, "epmcoin_coins_cache_bytes", "gauge", "Memory usage of the coins cache at the last tip change", g_metrics.nCoinsCacheUsage.load());
+
+    WriteMetric(os, "epmcoin_mempool_transactions", "gauge", "Transactions in the mempool", mempool.SizeNoLock());
+    WriteMetric(os, "epmcoin_mempool_bytes", "gauge", "Sum of the sizes of the mempool transactions", mempool.GetTotalTxSizeNoLock());
+
+    if (g_connman) {
+        WriteMetricHeader(os, "epmcoin_peers", "gauge", "Connected peers by direction");
+        os << "epmcoin_peers{direction=\"inbound\"} " << g_connman->GetNodeCount(CConnman::CONNECTIONS_IN) << "\n";
+        os << "epmcoin_peers{direction=\"outbound\"} " << g_connman->GetNodeCount(CConnman::CONNECTIONS_OUT) << "\n";
+    }
+
+    std::vector<CMessageProcessingStats> vMessageStats = GetMessageProcessingStats();
+    WriteMetricHeader(os, "epmcoin_p2p_messages_total", "counter", "Processed p2p messages by command");
+    for (const auto& stats : vMessageStats) {
+        os << "epmcoin_p2p_messages_total{command=\"" << stats.strCommand << "\"} " << stats.nCount << "\n";
+    }
+    WriteMetricHeader(os, "epmcoin_p2p_message_processing_seconds_total", "counter", "Time spent processing p2p messages by command");
+    for (const auto& stats : vMessageStats) {
+        os << "epmcoin_p2p_message_processing_seconds_total{command=\"" << stats.strCommand << "\"} " << strprintf("%.6f", stats.nTimeTotal * 0.000001) << "\n";
+    }
+
+    WriteMetric(os, "epmcoin_sigshares_pending", "gauge", "Received signature shares waiting for verification", g_metrics.nSigSharesPending.load());
+    WriteMetric(os, "epmcoin_instantsend_locks_total", "counter", "InstantSend locks accepted", g_metrics.nInstantSendLocks.load());
+    WriteMetric(os, "epmcoin_chainlock_height", "gauge", "Height of the best ChainLock, -1 if none", g_metrics.nChainLockHeight.load());
+    WriteMetric(os, "epmcoin_stake_searches_total", "counter", "Kernel search rounds of the stake minter", g_metrics.nStakeSearches.load());
+    WriteMetric(os, "epmcoin_stake_kernels_found_total", "counter", "Kernels found by the stake minter", g_metrics.nStakeKernelsFound.load());
+
+    if (llmq::quorumDKGSessionManager) {
+        const auto& llmqs = Params().GetConsensus().llmqs;
+        WriteMetricHeader(os, "epmcoin_llmq_dkg_phase", "gauge", "Current DKG phase by LLMQ type (1 initialized to 6 finalize, 7 idle)");
+        for (const auto& p : llmq::quorumDKGSessionManager->GetPhases()) {
+            auto it = llmqs.find(p.first);
+            if (it == llmqs.end()) continue;
+            os << "epmcoin_llmq_dkg_phase{llmq=\"" << it->second.name << "\"} " << (int)p.second << "\n";
+        }
+    }
+
+    return os.str();
+}
+
+static bool HTTPReq_Metrics(HTTPRequest* req, const std::string&)
+{
+    if (req->GetRequestMethod() != HTTPRequest::GET) {
+        req->WriteReply(HTTP_BAD_METHOD, "Only GET requests allowed");
+        return false;
+    }
+    req->WriteHeader("Content-Type", "text/plain; version=0.0.4");
+    req->WriteReply(HTTP_OK, RenderMetrics());
+    return true;
+}
+
+bool StartMetrics()
+{
+    RegisterHTTPHandler(METRICS_PATH, true, HTTPReq_Metrics);
+    return true;
+}
+
+void StopMetrics()
+{
+    UnregisterHTTPHandler(METRICS_PATH, true);
+}
@@ -0,0 +1,38 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPMCOIN_METRICS_H
+#define EPMCOIN_METRICS_H
+
+#include <atomic>
+#include <stdint.h>
+
+static const bool DEFAULT_METRICS_ENABLE = false;
+
+/**
+ * Counters and gauges for the /metrics endpoint which would otherwise need cs_main or a lock
+ * held during block processing to read. They are updated where the values change.
+ */
+struct CNodeMetrics {
+    std::atomic<int> nChainHeight{-1};
+    std::atomic<uint64_t> nCoinsCacheUsage{0};
+    std::atomic<int> nChainLockHeight{-1};
+    std::atomic<uint64_t> nInstantSendLocks{0};
+    std::atomic<uint64_t> nSigSharesPending{0};
+    std::atomic<uint64_t> nStakeSearches{0};
+    std::atomic<uint64_t> nStakeKernelsFound{0};
+};
+
+extern CNodeMetrics g_metrics;
+
+/** Start serving /metrics in the Prometheus text format.
+ * Precondition; HTTP and RPC has been started.
+ */
+bool StartMetrics();
+/** Stop serving /metrics.
+ * Precondition; HTTP and RPC has been stopped.
+ */
+void StopMetrics();
+
+#endif // EPMCOIN_METRICS_H
@@ -41,6 +41,7 @@
 #include "llmq/quorums_chainlocks.h"
 
 #include <algorithm>
+#include <limits>
 #include <boost/thread.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <queue>
@@ -131,8 +132,32 @@ void BlockAssembler::resetBlock()
     // These counters do not include coinbase tx
     nBlockTx = 0;
     nFees = 0;
+
+    fCapacityHit = false;
+    fUnsafeSkipped = false;
 }
 
+/**
+ * The mempool transactions picked by the last CreateNewBlock, in block order.
+ *
+ * As long as the tip doesn't change these stay a valid start for the next template: every one
+ * that is still in the mempool still has its in-mempool parents before it. The next call only
+ * has to check they are all still there and run the package selection over what the mempool
+ * got since. That is only done while the last selection had room to spare, a full block has to
+ * be rebuilt from scratch to let better paying new transactions push out worse ones.
+ */
+struct CTxSelectionCache
+{
+    uint256 hashPrevBlock;
+    unsigned int nTransactionsUpdated = 0;
+    unsigned int nBlockMaxSize = 0;
+    CFeeRate blockMinFeeRate;
+    bool fUnsafeSkipped = false;
+    //! with their modified fees, a prioritisetransaction since needs a new selection
+    std::vector<std::pair<uint256, CAmount> > vTxs;
+};
+static CTxSelectionCache txSelectionCache; // protected by mempool.cs
+
 std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, bool fProofOfStake)
 {
     int64_t nTimeStart = GetTimeMicros();
@@ -221,7 +246,7 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    SelectTransactions(pindexPrev, nPackagesSelected, nDescendantsUpdated);
 
     int64_t nTime1 = GetTimeMicros();
 
@@ -283,6 +308,71 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     return std::move(pblocktemplate);
 }
 
+void BlockAssembler::SelectTransactions(const CBlockIndex* pindexPrev, int &nPackagesSelected, int &nDescendantsUpdated)
+{
+    AssertLockHeld(mempool.cs);
+
+    // The block before any mempool transaction, to start over from
+    const size_t nFirstTx = pblock->vtx.size();
+    const uint64_t nBaseSize = nBlockSize;
+    const uint64_t nBaseTx = nBlockTx;
+    const unsigned int nBaseSigOps = nBlockSigOps;
+    const CAmount nBaseFees = nFees;
+    const unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+
+    CTxSelectionCache& cache = txSelectionCache;
+    bool fReused = cache.hashPrevBlock == pindexPrev->GetBlockHash() &&
+                   cache.nBlockMaxSize == nBlockMaxSize && cache.blockMinFeeRate == blockMinFeeRate;
+    if (fReused) {
+        for (const auto& tx : cache.vTxs) {
+            CTxMemPool::txiter it = mempool.mapTx.find(tx.first);
+            // gone (conflicted or evicted), reprioritised, or the space taken by quorum commitments grew
+            if (it == mempool.mapTx.end() || it->GetModifiedFee() != tx.second ||
+                !TestPackage(it->GetTxSize(), it->GetSigOpCount())) {
+                fReused = false;
+                break;
+            }
+            AddToBlock(it);
+        }
+        if (fReused && (cache.nTransactionsUpdated != nTransactionsUpdated || cache.fUnsafeSkipped)) {
+            addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+            fReused = !fCapacityHit;
+        }
+        if (!fReused) {
+            pblock->vtx.resize(nFirstTx);
+            pblocktemplate->vTxFees.resize(nFirstTx);
+            pblocktemplate->vTxSigOps.resize(nFirstTx);
+            nBlockSize = nBaseSize;
+            nBlockTx = nBaseTx;
+            nBlockSigOps = nBaseSigOps;
+            nFees = nBaseFees;
+            inBlock.clear();
+            fCapacityHit = false;
+            fUnsafeSkipped = false;
+            nPackagesSelected = 0;
+            nDescendantsUpdated = 0;
+        }
+    }
+    if (!fReused)
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+
+    LogPrint("bench", "%s: %s selection, %u transactions\n", __func__, fReused ? "incremental" : "full", pblock->vtx.size() - nFirstTx);
+
+    // Only a selection with room to spare is a valid start for the next call
+    cache.vTxs.clear();
+    cache.hashPrevBlock = fCapacityHit ? uint256() : pindexPrev->GetBlockHash();
+    cache.nTransactionsUpdated = nTransactionsUpdated;
+    cache.nBlockMaxSize = nBlockMaxSize;
+    cache.blockMinFeeRate = blockMinFeeRate;
+    cache.fUnsafeSkipped = fUnsafeSkipped;
+    if (!fCapacityHit) {
+        for (size_t i = nFirstTx; i < pblock->vtx.size(); i++) {
+            const uint256& hash = pblock->vtx[i]->GetHash();
+            cache.vTxs.emplace_back(hash, mempool.mapTx.find(hash)->GetModifiedFee());
+        }
+    }
+}
+
 void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
 {
     for (CTxMemPool::setEntries::iterator iit = testSet.begin(); iit != testSet.end(); ) {
@@ -479,6 +569,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
         }
 
         if (!TestPackage(packageSize, packageSigOps)) {
+            fCapacityHit = true;
             if (fUsingModified) {
                 // Since we always look at the best entry in mapModifiedTx,
                 // we must erase failed entries so that we can consider the
@@ -506,6 +597,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
 
         // Test if all tx's are Final and safe
         if (!TestPackageTransactions(ancestors)) {
+            fUnsafeSkipped = true;
             if (fUsingModified) {
                 mapModifiedTx.get<ancestor_score>().erase(modit);
                 failedTx.insert(iter);
@@ -568,6 +660,22 @@ static bool ProcessBlockFound(const std::shared_ptr<const CBlock> &pblock, const
     return true;
 }
 
+// Block until the active tip moves away from pindexLast or a new stake time slot (one second of adjusted
+// time after nLastSlotTime) becomes eligible, or nMaxWaitMs elapsed. Tip changes are signaled through
+// cvBlockChange, so a new block wakes the minter right away instead of after a fixed sleep.
+static void WaitForTipChangeOrNextSlot(const CBlockIndex* pindexLast, int64_t nLastSlotTime, int64_t nMaxWaitMs)
+{
+    boost::system_time timeout = boost::get_system_time() + boost::posix_time::milliseconds(nMaxWaitMs);
+    boost::unique_lock<boost::mutex> lock(csBestBlock);
+    while (chainActive.Tip() == pindexLast && GetAdjustedTime() <= nLastSlotTime) {
+        // wake up at the next full second, that's when the next kernel time slot opens
+        boost::system_time nextSlot = boost::get_system_time() + boost::posix_time::milliseconds(1000 - GetTimeMillis() % 1000);
+        if (!cvBlockChange.timed_wait(lock, std::min(nextSlot, timeout)) && boost::get_system_time() >= timeout) {
+            break;
+        }
+    }
+}
+
 void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWallet* pwallet, bool fProofOfStake)
 {
     LogPrintf("EPMminer -- started\n");
@@ -578,10 +686,14 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWa
     std::shared_ptr<CReserveScript> coinbaseScript;
     pwallet->GetScriptForMining(coinbaseScript);
 
+    const CBlockIndex* pindexLastSearch = nullptr;
+    int64_t nLastSearchTime = 0;
+
     while (true) {
         try {
 
-            MilliSleep(1000);
+            // Nothing changed since the last attempt if neither the tip nor the kernel time slots moved
+            WaitForTipChangeOrNextSlot(pindexLastSearch, nLastSearchTime, 1000);
 
             // Throw an error if no script was provided.  This can happen
             // due to some internal error but also if the keypool is empty.
@@ -595,13 +707,13 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWa
                 bool fvNodesEmpty = connman.GetNodeCount(CConnman::CONNECTIONS_ALL) == 0;
                 if (!fvNodesEmpty && !IsInitialBlockDownload() && masternodeSync.IsSynced())
                     break;
-                MilliSleep(5000);
+                WaitForTipChangeOrNextSlot(chainActive.Tip(), std::numeric_limits<int64_t>::max(), 5000);
             } while (true);
 
             if(fProofOfStake) {
-                if (chainActive.Tip()->nHeight < chainparams.GetConsensus().nLastPoWBlock || pwallet->IsLocked() || !masternodeSync.IsSynced()) {
+                if (chainActive.Tip()->nHeight < chainparams.GetConsensus().nLastPoWBlock || !pwallet->CanStake() || !masternodeSync.IsSynced()) {
                     nLastCoinStakeSearchInterval = 0;
-                    MilliSleep(5000);
+                    WaitForTipChangeOrNextSlot(chainActive.Tip(), std::numeric_limits<int64_t>::max(), 5000);
                     continue;
                 }
             }
@@ -616,10 +728,16 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWa
             CBlockIndex* pindexPrev = chainActive.Tip();
             if(!pindexPrev) break;
 
+            pindexLastSearch = pindexPrev;
+            nLastSearchTime = GetAdjustedTime();
+
+            // For PoS, CreateNewBlock searches for a kernel before selecting any transactions and returns
+            // nothing if none was found. Retry on the next time slot instead of sleeping for a fixed time.
             BlockAssembler assembler(chainparams);
             auto pblocktemplate = assembler.CreateNewBlock(coinbaseScript->reserveScript, fProofOfStake);
             if (!pblocktemplate.get()) {
-                MilliSleep(5000);
+                if (!fProofOfStake)
+                    MilliSleep(5000);
                 continue;
             }
 
@@ -632,7 +750,9 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWa
             //Sign block
             if (fProofOfStake) {
                 LogPrintf("CPUMiner : proof-of-stake block found %s \n", pblock->GetHash().ToString().c_str());
-                if (!SignBlock(*pblock, *pwallet)) {
+                CKeyID keyID;
+                CKey key;
+                if (!GetBlockSigningKeyID(*pblock, keyID) || !pwallet->GetStakingKey(keyID, key) || !SignBlockWithKey(*pblock, key)) {
                     LogPrintf("BitcoinMiner(): Signing new block failed \n");
                     throw std::runtime_error(strprintf("%s: SignBlock failed", __func__));
                 }
@@ -650,7 +770,8 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWa
                 SetThreadPriority(THREAD_PRIORITY_NORMAL);
                 ProcessBlockFound(pblock, chainparams);
                 SetThreadPriority(THREAD_PRIORITY_LOWEST);
-                MilliSleep(10000);
+                // don't try to stake on top of our own block right away, give it some time to propagate
+                WaitForTipChangeOrNextSlot(chainActive.Tip(), std::numeric_limits<int64_t>::max(), 10000);
                 continue;
             }
 
@@ -154,6 +154,10 @@ private:
     unsigned int nBlockSigOps;
     CAmount nFees;
     CTxMemPool::setEntries inBlock;
+    // Whether addPackageTxs had to leave out a package for lack of space
+    bool fCapacityHit;
+    // Whether addPackageTxs left out a package that may become minable later
+    bool fUnsafeSkipped;
 
     // Chain context for the block
     int nHeight;
@@ -182,6 +186,9 @@ private:
     void resetBlock();
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
+    /** Fill the block with mempool transactions, starting from the selection of the previous
+      * call for the same tip where possible. Falls back to addPackageTxs from scratch. */
+    void SelectTransactions(const CBlockIndex* pindexPrev, int &nPackagesSelected, int &nDescendantsUpdated);
 
     // Methods for how to add transactions to a block.
     /** Add transactions based on feerate including unconfirmed ancestors
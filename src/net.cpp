@@ -17,12 +17,14 @@
 #include "chainparams.h"
 #include "clientversion.h"
 #include "consensus/consensus.h"
+#include "ctpl.h"
 #include "crypto/common.h"
 #include "crypto/sha256.h"
 #include "hash.h"
 #include "primitives/transaction.h"
 #include "netbase.h"
 #include "scheduler.h"
+#include "tracing.h"
 #include "ui_interface.h"
 #include "utilstrencodings.h"
 #include "validation.h"
@@ -33,9 +35,20 @@
 #include "llmq/quorums_instantsend.h"
 
 #ifdef WIN32
+#include <limits>
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <sys/uio.h>
+#endif
+
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+#ifdef HAVE_KQUEUE
+#include <sys/event.h>
+#include <sys/time.h>
 #endif
 
 #ifdef USE_UPNP
@@ -47,6 +60,7 @@
 
 
 #include <math.h>
+#include <unordered_map>
 
 // Dump addresses to peers.dat and banlist.dat every 15 minutes (900s)
 #define DUMP_ADDRESSES_INTERVAL 900
@@ -76,6 +90,9 @@ constexpr const CConnman::CAllNodes CConnman::AllNodes;
 
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
 static const uint64_t RANDOMIZER_ID_LOCALHOSTNONCE = 0xd93e69e2bbfa5735ULL; // SHA256("localhostnonce")[0:8]
+
+/** How long the socket handler waits for events, also the frequency to poll pnode->vSend */
+static const int SELECT_TIMEOUT_MILLISECONDS = 50;
 //
 // Global state variables
 //
@@ -376,7 +393,7 @@ CNode* CConnman::ConnectNode(CAddress addrConnect, const char *pszDest, bool fCo
     if (pszDest ? ConnectSocketByName(addrConnect, hSocket, pszDest, Params().GetDefaultPort(), nConnectTimeout, &proxyConnectionFailed) :
                   ConnectSocket(addrConnect, hSocket, nConnectTimeout, &proxyConnectionFailed))
     {
-        if (!IsSelectableSocket(hSocket)) {
+        if (!IsSocketUsable(hSocket)) {
             LogPrintf("Cannot create connection: non-selectable socket created (fd >= FD_SETSIZE ?)\n");
             CloseSocket(hSocket);
             return NULL;
@@ -400,6 +417,11 @@ CNode* CConnman::ConnectNode(CAddress addrConnect, const char *pszDest, bool fCo
 
         addrman.Attempt(addrConnect, fCountFailure);
 
+        if (!RegisterSocketEvents(hSocket, true)) {
+            CloseSocket(hSocket);
+            return NULL;
+        }
+
         // Add node
         NodeId id = GetNewNodeId();
         uint64_t nonce = GetDeterministicRandomizer(RANDOMIZER_ID_LOCALHOSTNONCE).Write(id).Finalize();
@@ -661,6 +683,10 @@ void CNode::copyStats(CNodeStats &stats)
     }
     X(fInbound);
     X(fAddnode);
+    {
+        LOCK(cs_inventory);
+        stats.fTxReconciliation = fTxRecon;
+    }
     X(nStartingHeight);
     {
         LOCK(cs_vSend);
@@ -710,10 +736,16 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
     nRecvBytes += nBytes;
     while (nBytes > 0) {
 
-        // get current incomplete message, or create a new one
+        // get current incomplete message, or reuse or create a new one
         if (vRecvMsg.empty() ||
-            vRecvMsg.back().complete())
-            vRecvMsg.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION));
+            vRecvMsg.back().complete()) {
+            if (!vRecvMsgPool.empty()) {
+                vRecvMsg.splice(vRecvMsg.end(), vRecvMsgPool, vRecvMsgPool.begin());
+                vRecvMsg.back().Reset(Params().MessageStart(), INIT_PROTO_VERSION);
+            } else {
+                vRecvMsg.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION));
+            }
+        }
 
         CNetMessage& msg = vRecvMsg.back();
 
@@ -755,16 +787,7 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
         nBytes -= handled;
 
         if (msg.complete()) {
-
-            //store received bytes per message command
-            //to prevent a memory DOS, only allow valid commands
-            mapMsgCmdSize::iterator i = mapRecvBytesPerMsgCmd.find(msg.hdr.pchCommand);
-            if (i == mapRecvBytesPerMsgCmd.end())
-                i = mapRecvBytesPerMsgCmd.find(NET_MESSAGE_COMMAND_OTHER);
-            assert(i != mapRecvBytesPerMsgCmd.end());
-            i->second += msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
-
-            msg.nTime = nTimeMicros;
+            CompleteMessage(msg, nTimeMicros);
             complete = true;
         }
     }
@@ -772,6 +795,64 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
     return true;
 }
 
+// requires LOCK(cs_vRecv)
+void CNode::CompleteMessage(CNetMessage& msg, int64_t nTimeMicros)
+{
+    //store received bytes per message command
+    //to prevent a memory DOS, only allow valid commands
+    mapMsgCmdSize::iterator i = mapRecvBytesPerMsgCmd.find(msg.hdr.pchCommand);
+    if (i == mapRecvBytesPerMsgCmd.end())
+        i = mapRecvBytesPerMsgCmd.find(NET_MESSAGE_COMMAND_OTHER);
+    assert(i != mapRecvBytesPerMsgCmd.end());
+    i->second += msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
+
+    msg.nTime = nTimeMicros;
+}
+
+char* CNode::GetRecvSpace(unsigned int nMinSpace, unsigned int& nSpace)
+{
+    LOCK(cs_vRecv);
+    if (vRecvMsg.empty() || !vRecvMsg.back().in_data || vRecvMsg.back().complete())
+        return nullptr;
+    CNetMessage& msg = vRecvMsg.back();
+    if (msg.hdr.nMessageSize - msg.nDataPos < nMinSpace)
+        return nullptr;
+    return msg.GetDataSpace(nSpace);
+}
+
+bool CNode::ReceivedInPlace(unsigned int nBytes, bool& complete)
+{
+    complete = false;
+    int64_t nTimeMicros = GetTimeMicros();
+    LOCK(cs_vRecv);
+    nLastRecv = nTimeMicros / 1000000;
+    nRecvBytes += nBytes;
+
+    CNetMessage& msg = vRecvMsg.back();
+    msg.DataReceived(nBytes);
+    if (msg.complete()) {
+        CompleteMessage(msg, nTimeMicros);
+        complete = true;
+    }
+    return true;
+}
+
+void CNode::RecycleMessages(std::list<CNetMessage>& msgs)
+{
+    // Only keep small buffers around, big ones would pin memory of every peer that ever sent a block
+    auto it = msgs.begin();
+    while (it != msgs.end()) {
+        if (it->hdr.nMessageSize > MAX_RECYCLED_MESSAGE_SIZE)
+            it = msgs.erase(it);
+        else
+            ++it;
+    }
+
+    LOCK(cs_vRecv);
+    while (!msgs.empty() && vRecvMsgPool.size() < MAX_RECYCLED_MESSAGES)
+        vRecvMsgPool.splice(vRecvMsgPool.end(), msgs, msgs.begin());
+}
+
 void CNode::SetSendVersion(int nVersionIn)
 {
     // Send version may only be changed in the version message, and
@@ -847,6 +928,38 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
     return nCopy;
 }
 
+char* CNetMessage::GetDataSpace(unsigned int& nSpace)
+{
+    if (vRecv.size() == nDataPos) {
+        // Allocate up to 256 KiB ahead, but never more than the total message size.
+        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + 256 * 1024));
+    }
+    nSpace = vRecv.size() - nDataPos;
+    return &vRecv[nDataPos];
+}
+
+void CNetMessage::DataReceived(unsigned int nBytes)
+{
+    assert(nDataPos + nBytes <= vRecv.size());
+    hasher.Write((const unsigned char*)&vRecv[nDataPos], nBytes);
+    nDataPos += nBytes;
+}
+
+void CNetMessage::Reset(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nVersionIn)
+{
+    hasher.Reset();
+    data_hash.SetNull();
+    in_data = false;
+    hdrbuf.clear();
+    hdrbuf.resize(24);
+    hdr = CMessageHeader(pchMessageStartIn);
+    nHdrPos = 0;
+    vRecv.clear();
+    nDataPos = 0;
+    nTime = 0;
+    SetVersion(nVersionIn);
+}
+
 const uint256& CNetMessage::GetMessageHash() const
 {
     assert(complete());
@@ -870,27 +983,62 @@ size_t CConnman::SocketSendData(CNode *pnode) const
     size_t nSentSize = 0;
 
     while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
-        assert(data.size() > pnode->nSendOffset);
+        assert((*it)->size() > pnode->nSendOffset);
+        size_t nToSend = 0;
         int nBytes = 0;
+#ifndef WIN32
+        // Hand as many of the queued buffers as possible to the kernel at once
+        struct iovec iov[MAX_SEND_IOVECS];
+        int nIov = 0;
+        size_t nOffset = pnode->nSendOffset;
+        for (auto itIov = it; itIov != pnode->vSendMsg.end() && nIov < MAX_SEND_IOVECS; ++itIov, ++nIov) {
+            const auto &data = **itIov;
+            iov[nIov].iov_base = const_cast<unsigned char*>(data.data()) + nOffset;
+            iov[nIov].iov_len = data.size() - nOffset;
+            nToSend += iov[nIov].iov_len;
+            nOffset = 0;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = nIov;
+        {
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                break;
+            nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        }
+#else
+        const auto &data = **it;
+        nToSend = data.size() - pnode->nSendOffset;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 break;
-            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, nToSend, MSG_NOSIGNAL | MSG_DONTWAIT);
         }
+#endif
         if (nBytes > 0) {
             pnode->nLastSend = GetSystemTimeInSeconds();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             nSentSize += nBytes;
-            if (pnode->nSendOffset == data.size()) {
+            // Skip the buffers which went out completely
+            size_t nLeft = nBytes;
+            while (nLeft > 0) {
+                const auto &data = **it;
+                size_t nRemaining = data.size() - pnode->nSendOffset;
+                if (nLeft < nRemaining) {
+                    pnode->nSendOffset += nLeft;
+                    break;
+                }
+                nLeft -= nRemaining;
                 pnode->nSendOffset = 0;
                 pnode->nSendSize -= data.size();
                 pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
                 it++;
-            } else {
-                // could not send full message; stop sending more
+            }
+            if ((size_t)nBytes < nToSend) {
+                // could not send everything; stop sending more
                 break;
             }
         } else {
@@ -911,6 +1059,9 @@ size_t CConnman::SocketSendData(CNode *pnode) const
     if (it == pnode->vSendMsg.end()) {
         assert(pnode->nSendOffset == 0);
         assert(pnode->nSendSize == 0);
+    } else {
+        // The socket is full, edge-triggered modes report when it drains
+        pnode->fCanSendData = false;
     }
     pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
     return nSentSize;
@@ -1122,7 +1273,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket))
+    if (!IsSocketUsable(hSocket))
     {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
@@ -1168,6 +1319,11 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
+    if (!RegisterSocketEvents(hSocket, true)) {
+        CloseSocket(hSocket);
+        return;
+    }
+
     NodeId id = GetNewNodeId();
     uint64_t nonce = GetDeterministicRandomizer(RANDOMIZER_ID_LOCALHOSTNONCE).Write(id).Finalize();
 
@@ -1184,9 +1340,354 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
     }
 }
 
+bool ParseSocketEventsMode(const std::string& strMode, SocketEventsMode& modeRet)
+{
+    if (strMode == "select") {
+        modeRet = SOCKETEVENTS_SELECT;
+        return true;
+    }
+#ifdef USE_POLL
+    if (strMode == "poll") {
+        modeRet = SOCKETEVENTS_POLL;
+        return true;
+    }
+#endif
+#ifdef HAVE_EPOLL
+    if (strMode == "epoll") {
+        modeRet = SOCKETEVENTS_EPOLL;
+        return true;
+    }
+#endif
+#ifdef HAVE_KQUEUE
+    if (strMode == "kqueue") {
+        modeRet = SOCKETEVENTS_KQUEUE;
+        return true;
+    }
+#endif
+    return false;
+}
+
+std::string GetSupportedSocketEventsStr()
+{
+    std::string strModes = "'select'";
+#ifdef USE_POLL
+    strModes += ", 'poll'";
+#endif
+#ifdef HAVE_EPOLL
+    strModes += ", 'epoll'";
+#endif
+#ifdef HAVE_KQUEUE
+    strModes += ", 'kqueue'";
+#endif
+    return strModes;
+}
+
+bool CConnman::IsSocketUsable(SOCKET hSocket) const
+{
+#ifndef WIN32
+    // Only select() is limited by the size of an fd_set
+    if (socketEventsMode == SOCKETEVENTS_SELECT)
+        return hSocket < FD_SETSIZE;
+#endif
+    return IsSelectableSocket(hSocket);
+}
+
+bool CConnman::RegisterSocketEvents(SOCKET hSocket, bool fEdgeTriggered)
+{
+#ifdef HAVE_EPOLL
+    if (socketEventsMode == SOCKETEVENTS_EPOLL) {
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.data.fd = hSocket;
+        event.events = EPOLLIN;
+        if (fEdgeTriggered)
+            event.events |= EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        if (epoll_ctl(socketEventsFd, EPOLL_CTL_ADD, hSocket, &event) != 0) {
+            LogPrintf("epoll_ctl failed for socket %d: %s\n", hSocket, NetworkErrorString(WSAGetLastError()));
+            return false;
+        }
+    }
+#endif
+#ifdef HAVE_KQUEUE
+    if (socketEventsMode == SOCKETEVENTS_KQUEUE) {
+        struct kevent events[2];
+        int nEvents = 0;
+        EV_SET(&events[nEvents++], hSocket, EVFILT_READ, EV_ADD | (fEdgeTriggered ? EV_CLEAR : 0), 0, 0, nullptr);
+        if (fEdgeTriggered)
+            EV_SET(&events[nEvents++], hSocket, EVFILT_WRITE, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+        if (kevent(socketEventsFd, events, nEvents, nullptr, 0, nullptr) != 0) {
+            LogPrintf("kevent failed for socket %d: %s\n", hSocket, NetworkErrorString(WSAGetLastError()));
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
+bool CConnman::GenerateSelectSet(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        recv_set.insert(hListenSocket.socket);
+    }
+
+#ifndef WIN32
+    // We add a pipe to the read set so that the select() call can be woken up from the outside
+    // This is done when data is available for sending and at the same time optimistic sending was disabled
+    // when pushing the data.
+    // This is currently only implemented for POSIX compliant systems. This means that Windows will fall back to
+    // timing out after 50ms and then trying to send. This is ok as we assume that heavy-load daemons are usually
+    // run on Linux and friends.
+    if (wakeupPipe[0] != -1)
+        recv_set.insert(wakeupPipe[0]);
+#endif
+
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes)
+        {
+            // Implement the following logic:
+            // * If there is data to send, select() for sending data. As this only
+            //   happens when optimistic write failed, we choose to first drain the
+            //   write buffer in this case before receiving more. This avoids
+            //   needlessly queueing received data, if the remote peer is not themselves
+            //   receiving data. This means properly utilizing TCP flow control signalling.
+            // * Otherwise, if there is space left in the receive buffer, select() for
+            //   receiving data.
+            // * Hand off all complete messages to the processor, to be handled without
+            //   blocking here.
+
+            bool select_recv = !pnode->fPauseRecv;
+            bool select_send;
+            {
+                LOCK(pnode->cs_vSend);
+                select_send = !pnode->vSendMsg.empty();
+            }
+
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+
+            error_set.insert(pnode->hSocket);
+            if (select_send) {
+                send_set.insert(pnode->hSocket);
+                continue;
+            }
+            if (select_recv) {
+                recv_set.insert(pnode->hSocket);
+            }
+        }
+    }
+
+    return !recv_set.empty() || !send_set.empty() || !error_set.empty();
+}
+
+#ifdef HAVE_EPOLL
+void CConnman::SocketEventsEpoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, bool fOnlyPoll)
+{
+    const size_t maxEvents = 256;
+    epoll_event events[maxEvents];
+
+    wakeupSelectNeeded = true;
+    int n = epoll_wait(socketEventsFd, events, maxEvents, fOnlyPoll ? 0 : SELECT_TIMEOUT_MILLISECONDS);
+    wakeupSelectNeeded = false;
+    for (int i = 0; i < n; i++) {
+        epoll_event& e = events[i];
+        if ((e.events & (EPOLLERR | EPOLLHUP)) != 0) {
+            error_set.insert(e.data.fd);
+            continue;
+        }
+        if ((e.events & (EPOLLIN | EPOLLRDHUP)) != 0) {
+            recv_set.insert(e.data.fd);
+        }
+        if ((e.events & EPOLLOUT) != 0) {
+            send_set.insert(e.data.fd);
+        }
+    }
+}
+#endif
+
+#ifdef HAVE_KQUEUE
+void CConnman::SocketEventsKqueue(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, bool fOnlyPoll)
+{
+    const size_t maxEvents = 256;
+    struct kevent events[maxEvents];
+
+    struct timespec timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = fOnlyPoll ? 0 : SELECT_TIMEOUT_MILLISECONDS * 1000 * 1000;
+
+    wakeupSelectNeeded = true;
+    int n = kevent(socketEventsFd, nullptr, 0, events, maxEvents, &timeout);
+    wakeupSelectNeeded = false;
+    for (int i = 0; i < n; i++) {
+        struct kevent& e = events[i];
+        if ((e.flags & (EV_EOF | EV_ERROR)) != 0) {
+            error_set.insert((SOCKET)e.ident);
+            continue;
+        }
+        if (e.filter == EVFILT_READ) {
+            recv_set.insert((SOCKET)e.ident);
+        }
+        if (e.filter == EVFILT_WRITE) {
+            send_set.insert((SOCKET)e.ident);
+        }
+    }
+}
+#endif
+
+#ifdef USE_POLL
+void CConnman::SocketEventsPoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, bool fOnlyPoll)
+{
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    if (!GenerateSelectSet(recv_select_set, send_select_set, error_select_set)) {
+        if (!fOnlyPoll) interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        return;
+    }
+
+    std::unordered_map<SOCKET, struct pollfd> pollfds;
+    for (SOCKET socket_id : recv_select_set) {
+        pollfds[socket_id].fd = socket_id;
+        pollfds[socket_id].events |= POLLIN;
+    }
+
+    for (SOCKET socket_id : send_select_set) {
+        pollfds[socket_id].fd = socket_id;
+        pollfds[socket_id].events |= POLLOUT;
+    }
+
+    for (SOCKET socket_id : error_select_set) {
+        pollfds[socket_id].fd = socket_id;
+        // These flags are ignored, but we set them for clarity
+        pollfds[socket_id].events |= POLLERR|POLLHUP;
+    }
+
+    std::vector<struct pollfd> vpollfds;
+    vpollfds.reserve(pollfds.size());
+    for (auto it : pollfds) {
+        vpollfds.push_back(std::move(it.second));
+    }
+
+    wakeupSelectNeeded = true;
+    int r = poll(vpollfds.data(), vpollfds.size(), fOnlyPoll ? 0 : SELECT_TIMEOUT_MILLISECONDS);
+    wakeupSelectNeeded = false;
+    if (r < 0) {
+        return;
+    }
+
+    if (interruptNet) return;
+
+    for (struct pollfd pollfd_entry : vpollfds) {
+        if (pollfd_entry.revents & POLLIN)            recv_set.insert(pollfd_entry.fd);
+        if (pollfd_entry.revents & POLLOUT)           send_set.insert(pollfd_entry.fd);
+        if (pollfd_entry.revents & (POLLERR|POLLHUP)) error_set.insert(pollfd_entry.fd);
+    }
+}
+#endif
+
+void CConnman::SocketEventsSelect(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, bool fOnlyPoll)
+{
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    if (!GenerateSelectSet(recv_select_set, send_select_set, error_select_set)) {
+        if (!fOnlyPoll) interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        return;
+    }
+
+    //
+    // Find which sockets have data to receive
+    //
+    struct timeval timeout;
+    timeout.tv_sec  = 0;
+    timeout.tv_usec = fOnlyPoll ? 0 : SELECT_TIMEOUT_MILLISECONDS * 1000; // frequency to poll pnode->vSend
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+
+    for (SOCKET hSocket : recv_select_set) {
+        FD_SET(hSocket, &fdsetRecv);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+
+    for (SOCKET hSocket : send_select_set) {
+        FD_SET(hSocket, &fdsetSend);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+
+    for (SOCKET hSocket : error_select_set) {
+        FD_SET(hSocket, &fdsetError);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+
+    wakeupSelectNeeded = true;
+    int nSelect = select(hSocketMax + 1, &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    wakeupSelectNeeded = false;
+    if (interruptNet)
+        return;
+
+    if (nSelect == SOCKET_ERROR)
+    {
+        int nErr = WSAGetLastError();
+        LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+        for (unsigned int i = 0; i <= hSocketMax; i++)
+            FD_SET(i, &fdsetRecv);
+        FD_ZERO(&fdsetSend);
+        FD_ZERO(&fdsetError);
+        if (!interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS)))
+            return;
+    }
+
+    for (SOCKET hSocket : recv_select_set) {
+        if (FD_ISSET(hSocket, &fdsetRecv)) {
+            recv_set.insert(hSocket);
+        }
+    }
+
+    for (SOCKET hSocket : send_select_set) {
+        if (FD_ISSET(hSocket, &fdsetSend)) {
+            send_set.insert(hSocket);
+        }
+    }
+
+    for (SOCKET hSocket : error_select_set) {
+        if (FD_ISSET(hSocket, &fdsetError)) {
+            error_set.insert(hSocket);
+        }
+    }
+}
+
+void CConnman::SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, bool fOnlyPoll)
+{
+    switch (socketEventsMode) {
+#ifdef HAVE_EPOLL
+    case SOCKETEVENTS_EPOLL:
+        SocketEventsEpoll(recv_set, send_set, error_set, fOnlyPoll);
+        break;
+#endif
+#ifdef HAVE_KQUEUE
+    case SOCKETEVENTS_KQUEUE:
+        SocketEventsKqueue(recv_set, send_set, error_set, fOnlyPoll);
+        break;
+#endif
+#ifdef USE_POLL
+    case SOCKETEVENTS_POLL:
+        SocketEventsPoll(recv_set, send_set, error_set, fOnlyPoll);
+        break;
+#endif
+    default:
+        SocketEventsSelect(recv_set, send_set, error_set, fOnlyPoll);
+        break;
+    }
+}
+
 void CConnman::ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
+    const bool fEdgeTriggered = socketEventsMode == SOCKETEVENTS_EPOLL || socketEventsMode == SOCKETEVENTS_KQUEUE;
+    bool fOnlyPoll = false;
     while (!interruptNet)
     {
         //
@@ -1205,6 +1706,13 @@ void CConnman::ThreadSocketHandler()
 
                     // remove from vNodes
                     vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
+                    {
+                        LOCK(pnode->cs_mnauth);
+                        auto it = mapVerifiedMasternodes.find(pnode->verifiedProRegTxHash);
+                        if (it != mapVerifiedMasternodes.end() && it->second == pnode) {
+                            mapVerifiedMasternodes.erase(it);
+                        }
+                    }
 
                     // release outbound grant (if any)
                     pnode->grantOutbound.Release();
@@ -1257,102 +1765,14 @@ void CConnman::ThreadSocketHandler()
         //
         // Find which sockets have data to receive
         //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-#ifndef WIN32
-        // We add a pipe to the read set so that the select() call can be woken up from the outside
-        // This is done when data is available for sending and at the same time optimistic sending was disabled
-        // when pushing the data.
-        // This is currently only implemented for POSIX compliant systems. This means that Windows will fall back to
-        // timing out after 50ms and then trying to send. This is ok as we assume that heavy-load daemons are usually
-        // run on Linux and friends.
-        FD_SET(wakeupPipe[0], &fdsetRecv);
-        hSocketMax = std::max(hSocketMax, (SOCKET)wakeupPipe[0]);
-        have_fds = true;
-#endif
-
-        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
-        {
-            LOCK(cs_vNodes);
-            BOOST_FOREACH(CNode* pnode, vNodes)
-            {
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is space left in the receive buffer, select() for
-                //   receiving data.
-                // * Hand off all complete messages to the processor, to be handled without
-                //   blocking here.
-
-                bool select_recv = !pnode->fPauseRecv;
-                bool select_send;
-                {
-                    LOCK(pnode->cs_vSend);
-                    select_send = !pnode->vSendMsg.empty();
-                }
-
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                if (select_send) {
-                    FD_SET(pnode->hSocket, &fdsetSend);
-                    continue;
-                }
-                if (select_recv) {
-                    FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
-        }
-
-        wakeupSelectNeeded = true;
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
-        wakeupSelectNeeded = false;
+        std::set<SOCKET> recv_set, send_set, error_set;
+        SocketEvents(recv_set, send_set, error_set, fOnlyPoll);
         if (interruptNet)
             return;
 
-        if (nSelect == SOCKET_ERROR)
-        {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            if (!interruptNet.sleep_for(std::chrono::milliseconds(timeout.tv_usec/1000)))
-                return;
-        }
-
 #ifndef WIN32
         // drain the wakeup pipe
-        if (FD_ISSET(wakeupPipe[0], &fdsetRecv)) {
+        if (recv_set.count(wakeupPipe[0])) {
             LogPrint("net", "woke up select()\n");
             char buf[128];
             while (true) {
@@ -1369,7 +1789,7 @@ void CConnman::ThreadSocketHandler()
         //
         BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            if (hListenSocket.socket != INVALID_SOCKET && recv_set.count(hListenSocket.socket))
             {
                 AcceptConnection(hListenSocket);
             }
@@ -1383,43 +1803,76 @@ void CConnman::ThreadSocketHandler()
                 pnode->AddRef();
         }
 
+        // With edge-triggered events readiness is only reported once, so keep polling
+        // without a timeout while some socket has not been drained yet
+        fOnlyPoll = false;
         BOOST_FOREACH(CNode* pnode, vNodesCopy)
         {
             if (interruptNet)
                 return;
 
-            //
-            // Receive
-            //
             bool recvSet = false;
             bool sendSet = false;
-            bool errorSet = false;
             {
                 LOCK(pnode->cs_hSocket);
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-                sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-                errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
+                recvSet = recv_set.count(pnode->hSocket) || error_set.count(pnode->hSocket);
+                sendSet = send_set.count(pnode->hSocket);
+            }
+            if (fEdgeTriggered) {
+                if (recvSet)
+                    pnode->fHasRecvData = true;
+                if (sendSet) {
+                    // Under cs_vSend, so a SocketSendData that hits a full socket can't clear it afterwards
+                    LOCK(pnode->cs_vSend);
+                    pnode->fCanSendData = true;
+                }
+            } else {
+                pnode->fHasRecvData = recvSet;
+                pnode->fCanSendData = sendSet;
+            }
+
+            // Drain the send buffer before receiving more, see GenerateSelectSet
+            bool fSendPending;
+            {
+                LOCK(pnode->cs_vSend);
+                fSendPending = !pnode->vSendMsg.empty();
             }
-            if (recvSet || errorSet)
+
+            //
+            // Receive
+            //
+            if (pnode->fHasRecvData && (!fEdgeTriggered || (!pnode->fPauseRecv && !fSendPending)))
             {
                 {
                     {
                         // typical socket buffer is 8K-64K
                         char pchBuf[0x10000];
+                        // large payloads go straight into their message
+                        unsigned int nRecvSize = sizeof(pchBuf);
+                        char* pchRecv = pnode->GetRecvSpace(MIN_DIRECT_RECV_SIZE, nRecvSize);
+                        if (pchRecv == nullptr) {
+                            pchRecv = pchBuf;
+                            nRecvSize = sizeof(pchBuf);
+                        }
                         int nBytes = 0;
                         {
                             LOCK(pnode->cs_hSocket);
                             if (pnode->hSocket == INVALID_SOCKET)
                                 continue;
-                            nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+                            nBytes = recv(pnode->hSocket, pchRecv, nRecvSize, MSG_DONTWAIT);
                         }
+                        if (nBytes < (int)nRecvSize)
+                            pnode->fHasRecvData = false;
                         if (nBytes > 0)
                         {
                             bool notify = false;
-                            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
+                            if (pchRecv != pchBuf) {
+                                pnode->ReceivedInPlace(nBytes, notify);
+                            } else if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify)) {
                                 pnode->CloseSocketDisconnect();
+                            }
                             RecordBytesRecv(nBytes);
                             if (notify) {
                                 size_t nSizeAdded = 0;
@@ -1463,7 +1916,7 @@ void CConnman::ThreadSocketHandler()
             //
             // Send
             //
-            if (sendSet)
+            if (pnode->fCanSendData)
             {
                 LOCK(pnode->cs_vSend);
                 size_t nBytes = SocketSendData(pnode);
@@ -1472,6 +1925,12 @@ void CConnman::ThreadSocketHandler()
                 }
             }
 
+            if (fEdgeTriggered && pnode->fHasRecvData && !pnode->fPauseRecv) {
+                LOCK(pnode->cs_vSend);
+                if (pnode->vSendMsg.empty())
+                    fOnlyPoll = true;
+            }
+
             //
             // Inactivity checking
             //
@@ -1756,10 +2215,16 @@ void CConnman::ThreadDNSAddressSeed()
 
 void CConnman::DumpAddresses()
 {
+    // Rewriting the whole file is wasted I/O if nothing changed since the last time
+    uint64_t nModifications = addrman.GetModificationCount();
+    if (nModifications == nAddrmanModificationsFlushed)
+        return;
+
     int64_t nStart = GetTimeMillis();
 
     CAddrDB adb;
-    adb.Write(addrman);
+    if (adb.Write(addrman))
+        nAddrmanModificationsFlushed = nModifications;
 
     LogPrint("net", "Flushed %d addresses to peers.dat  %dms\n",
            addrman.size(), GetTimeMillis() - nStart);
@@ -2065,10 +2530,13 @@ void CConnman::ThreadOpenMasternodeConnections()
     if (IsArgSet("-connect") && mapMultiArgs.at("-connect").size() > 0)
         return;
 
+    bool fMoreWork = false;
     while (!interruptNet)
     {
-        if (!interruptNet.sleep_for(std::chrono::milliseconds(1000)))
+        // Come back quickly while there are still masternodes left to connect to
+        if (!interruptNet.sleep_for(std::chrono::milliseconds(fMoreWork ? 100 : 1000)))
             return;
+        fMoreWork = false;
 
         std::set<CService> connectedNodes;
         std::set<uint256> connectedProRegTxHashes;
@@ -2080,64 +2548,141 @@ void CConnman::ThreadOpenMasternodeConnections()
         });
 
         auto mnList = deterministicMNManager->GetListAtChainTip();
-
-        CSemaphoreGrant grant(*semMasternodeOutbound);
-        if (interruptNet)
-            return;
+        const auto& llmqs = Params().GetConsensus().llmqs;
 
         int64_t nANow = GetAdjustedTime();
 
-        // NOTE: Process only one pending masternode at a time
-
-        CService addr;
+        std::vector<std::shared_ptr<CSemaphoreGrant>> grants;
+        typedef std::pair<Consensus::LLMQType, uint256> QuorumKey;
+        std::vector<std::pair<CService, QuorumKey>> toConnect;
         { // don't hold lock while calling OpenMasternodeConnection as cs_main is locked deep inside
             LOCK2(cs_vNodes, cs_vPendingMasternodes);
 
-            std::vector<CService> pending;
+            // Connect to members of quorums in DKG first, then to explicitly requested masternodes, then
+            // to members of established quorums. Within a tier, LLMQ types with a shorter DKG interval
+            // go first as they have the tighter deadlines.
+            struct Candidate {
+                int nTier;
+                int nInterval;
+                CService addr;
+                QuorumKey quorum;
+            };
+            std::vector<Candidate> candidates;
+
             for (const auto& group : masternodeQuorumNodes) {
+                auto& stats = masternodeQuorumConnStats[group.first];
+                auto itParams = llmqs.find(group.first.first);
+                int nInterval = itParams != llmqs.end() ? itParams->second.dkgInterval : std::numeric_limits<int>::max();
+                int nMembers = 0;
+                int nConnected = 0;
                 for (const auto& proRegTxHash : group.second) {
                     auto dmn = mnList.GetMN(proRegTxHash);
                     if (!dmn) {
                         continue;
                     }
+                    nMembers++;
                     const auto& addr2 = dmn->pdmnState->addr;
-                    if (!connectedNodes.count(addr2) && !IsMasternodeOrDisconnectRequested(addr2) && !connectedProRegTxHashes.count(proRegTxHash)) {
-                        auto addrInfo = addrman.GetAddressInfo(addr2);
-                        // back off trying connecting to an address if we already tried recently
-                        if (addrInfo.IsValid() && nANow - addrInfo.nLastTry < 60) {
-                            continue;
-                        }
-                        pending.emplace_back(addr2);
+                    if (connectedNodes.count(addr2) || connectedProRegTxHashes.count(proRegTxHash)) {
+                        nConnected++;
+                        continue;
+                    }
+                    if (IsMasternodeOrDisconnectRequested(addr2) || setMasternodesConnecting.count(addr2)) {
+                        continue;
+                    }
+                    auto addrInfo = addrman.GetAddressInfo(addr2);
+                    // back off trying connecting to an address if we already tried recently
+                    if (addrInfo.IsValid() && nANow - addrInfo.nLastTry < 60) {
+                        continue;
                     }
+                    candidates.push_back({stats.fDKG ? 0 : 2, nInterval, addr2, group.first});
+                }
+                stats.nMembers = nMembers;
+                stats.nConnected = nConnected;
+                if (nMembers > 0 && nConnected == nMembers && stats.nTimeAllConnected == 0) {
+                    stats.nTimeAllConnected = std::max<int64_t>(GetTimeMicros() - stats.nTimeAdded, 1);
                 }
             }
 
-            if (!vPendingMasternodes.empty()) {
-                auto addr2 = vPendingMasternodes.front();
-                vPendingMasternodes.erase(vPendingMasternodes.begin());
-                if (!connectedNodes.count(addr2) && !IsMasternodeOrDisconnectRequested(addr2)) {
-                    pending.emplace_back(addr2);
+            for (auto it = vPendingMasternodes.begin(); it != vPendingMasternodes.end(); ) {
+                if (connectedNodes.count(*it) || IsMasternodeOrDisconnectRequested(*it)) {
+                    it = vPendingMasternodes.erase(it);
+                    continue;
+                }
+                if (!setMasternodesConnecting.count(*it)) {
+                    candidates.push_back({1, 0, *it, QuorumKey()});
                 }
+                ++it;
             }
 
-            if (pending.empty()) {
+            if (candidates.empty()) {
                 // nothing to do, keep waiting
                 continue;
             }
 
-            std::random_shuffle(pending.begin(), pending.end());
-            addr = pending.front();
-        }
+            std::random_shuffle(candidates.begin(), candidates.end());
+            std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+                return std::make_pair(a.nTier, a.nInterval) < std::make_pair(b.nTier, b.nInterval);
+            });
 
-        OpenMasternodeConnection(CAddress(addr, NODE_NETWORK));
-        // should be in the list now if connection was opened
-        ForNode(addr, CConnman::AllNodes, [&](CNode* pnode) {
-            if (pnode->fDisconnect) {
-                return false;
+            std::set<CService> setSelected;
+            for (const auto& c : candidates) {
+                if ((int)setMasternodesConnecting.size() >= MAX_MASTERNODE_CONNECT_PARALLEL) {
+                    break;
+                }
+                if (setSelected.count(c.addr)) {
+                    continue;
+                }
+                auto grant = std::make_shared<CSemaphoreGrant>(*semMasternodeOutbound, true);
+                if (!*grant) {
+                    break;
+                }
+                grants.emplace_back(std::move(grant));
+                setSelected.emplace(c.addr);
+                setMasternodesConnecting.emplace(c.addr);
+                toConnect.emplace_back(c.addr, c.quorum);
+                auto itStats = masternodeQuorumConnStats.find(c.quorum);
+                if (itStats != masternodeQuorumConnStats.end()) {
+                    itStats->second.nAttempts++;
+                }
+                auto itPending = std::find(vPendingMasternodes.begin(), vPendingMasternodes.end(), c.addr);
+                if (itPending != vPendingMasternodes.end()) {
+                    vPendingMasternodes.erase(itPending);
+                }
             }
-            grant.MoveTo(pnode->grantMasternodeOutbound);
-            return true;
-        });
+            fMoreWork = setSelected.size() < candidates.size();
+        }
+
+        for (size_t i = 0; i < toConnect.size(); i++) {
+            auto grant = grants[i];
+            CService addr = toConnect[i].first;
+            QuorumKey quorum = toConnect[i].second;
+            mnConnWorkers->push([this, grant, addr, quorum](int) {
+                int64_t nTimeStart = GetTimeMicros();
+                OpenMasternodeConnection(CAddress(addr, NODE_NETWORK));
+                int64_t nDuration = GetTimeMicros() - nTimeStart;
+                // should be in the list now if connection was opened
+                bool fConnected = ForNode(addr, CConnman::AllNodes, [&](CNode* pnode) {
+                    if (pnode->fDisconnect) {
+                        return false;
+                    }
+                    grant->MoveTo(pnode->grantMasternodeOutbound);
+                    return true;
+                });
+
+                LOCK(cs_vPendingMasternodes);
+                setMasternodesConnecting.erase(addr);
+                auto it = masternodeQuorumConnStats.find(quorum);
+                if (it != masternodeQuorumConnStats.end()) {
+                    if (fConnected) {
+                        it->second.nSucceeded++;
+                        it->second.nConnectTimeTotal += nDuration;
+                        it->second.nConnectTimeMax = std::max(it->second.nConnectTimeMax, nDuration);
+                    } else {
+                        it->second.nFailures++;
+                    }
+                }
+            });
+        }
     }
 }
 
@@ -2196,6 +2741,52 @@ bool CConnman::OpenMasternodeConnection(const CAddress &addrConnect) {
     return OpenNetworkConnection(addrConnect, false, NULL, NULL, false, false, false, true);
 }
 
+bool IsChainstateFreeMessage(const std::string& strCommand)
+{
+    // LLMQ and governance traffic, the handlers do their own locking and only take cs_main briefly
+    static const std::set<std::string> setChainstateFree = {
+        NetMsgType::QCONTRIB,
+        NetMsgType::QCOMPLAINT,
+        NetMsgType::QJUSTIFICATION,
+        NetMsgType::QPCOMMITMENT,
+        NetMsgType::QWATCH,
+        NetMsgType::QSIGSESANN,
+        NetMsgType::QSIGSHARESINV,
+        NetMsgType::QGETSIGSHARES,
+        NetMsgType::QBSIGSHARES,
+        NetMsgType::QSIGREC,
+        NetMsgType::CLSIG,
+        NetMsgType::ISLOCK,
+        NetMsgType::MNGOVERNANCESYNC,
+        NetMsgType::MNGOVERNANCEOBJECT,
+        NetMsgType::MNGOVERNANCEOBJECTVOTE,
+    };
+    return setChainstateFree.count(strCommand) != 0;
+}
+
+bool CConnman::IsNextMessageChainstateFree(CNode* pnode) const
+{
+    // getdata responses have to stay ordered with everything else
+    if (!pnode->vRecvGetData.empty() || pnode->fPauseSend)
+        return false;
+    LOCK(pnode->cs_vProcessMsg);
+    return !pnode->vProcessMsg.empty() && IsChainstateFreeMessage(pnode->vProcessMsg.front().hdr.GetCommand());
+}
+
+void CConnman::ProcessMessagesWorker(CNode* pnode)
+{
+    for (int i = 0; i < MAX_MSGPROC_WORKER_BATCH; i++) {
+        if (flagInterruptMsgProc || pnode->fDisconnect || !IsNextMessageChainstateFree(pnode))
+            break;
+        GetNodeSignals().ProcessMessages(pnode, *this, flagInterruptMsgProc);
+    }
+
+    // Hand the node back to the message handler, which also does its SendMessages
+    pnode->fProcessingAsync = false;
+    pnode->Release();
+    WakeMessageHandler();
+}
+
 void CConnman::ThreadMessageHandler()
 {
     while (!flagInterruptMsgProc)
@@ -2206,8 +2797,16 @@ void CConnman::ThreadMessageHandler()
 
         BOOST_FOREACH(CNode* pnode, vNodesCopy)
         {
-            if (pnode->fDisconnect)
+            if (pnode->fDisconnect || pnode->fProcessingAsync)
+                continue;
+
+            // Messages which don't touch the chainstate don't have to wait behind block validation of other peers
+            if (msgProcWorkers && IsNextMessageChainstateFree(pnode)) {
+                pnode->fProcessingAsync = true;
+                pnode->AddRef();
+                msgProcWorkers->push([this, pnode](int) { ProcessMessagesWorker(pnode); });
                 continue;
+            }
 
             // Receive messages
             bool fMoreNodeWork = GetNodeSignals().ProcessMessages(pnode, *this, flagInterruptMsgProc);
@@ -2452,6 +3051,26 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
     nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
     nReceiveFloodSize = connOptions.nReceiveFloodSize;
 
+    socketEventsMode = connOptions.socketEventsMode;
+#ifdef HAVE_EPOLL
+    if (socketEventsMode == SOCKETEVENTS_EPOLL) {
+        socketEventsFd = epoll_create1(EPOLL_CLOEXEC);
+        if (socketEventsFd == -1) {
+            strNodeError = strprintf("epoll_create1 failed: %s", NetworkErrorString(WSAGetLastError()));
+            return false;
+        }
+    }
+#endif
+#ifdef HAVE_KQUEUE
+    if (socketEventsMode == SOCKETEVENTS_KQUEUE) {
+        socketEventsFd = kqueue();
+        if (socketEventsFd == -1) {
+            strNodeError = strprintf("kqueue failed: %s", NetworkErrorString(WSAGetLastError()));
+            return false;
+        }
+    }
+#endif
+
     nMaxOutboundLimit = connOptions.nMaxOutboundLimit;
     nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
 
@@ -2465,9 +3084,10 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
     int64_t nStart = GetTimeMillis();
     {
         CAddrDB adb;
-        if (adb.Read(addrman))
+        if (adb.Read(addrman)) {
+            nAddrmanModificationsFlushed = addrman.GetModificationCount();
             LogPrintf("Loaded %i addresses from peers.dat  %dms\n", addrman.size(), GetTimeMillis() - nStart);
-        else {
+        } else {
             addrman.Clear(); // Addrman can be in an inconsistent state after failure, reset it
             LogPrintf("Invalid or missing peers.dat; recreating\n");
             DumpAddresses();
@@ -2538,6 +3158,20 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
     }
 #endif
 
+    // The wakeup pipe and listening sockets stay registered for the lifetime of the event fd
+#ifndef WIN32
+    if (wakeupPipe[0] != -1 && !RegisterSocketEvents(wakeupPipe[0], false)) {
+        strNodeError = "Failed to register the wakeup pipe for socket events";
+        return false;
+    }
+#endif
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        if (!RegisterSocketEvents(hListenSocket.socket, false)) {
+            strNodeError = "Failed to register a listening socket for socket events";
+            return false;
+        }
+    }
+
     // Send and receive from sockets, accept connections
     threadSocketHandler = std::thread(&TraceThread<std::function<void()> >, "net", std::function<void()>(std::bind(&CConnman::ThreadSocketHandler, this)));
 
@@ -2554,13 +3188,19 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
         threadOpenConnections = std::thread(&TraceThread<std::function<void()> >, "opencon", std::function<void()>(std::bind(&CConnman::ThreadOpenConnections, this)));
 
     // Initiate masternode connections
+    mnConnWorkers.reset(new ctpl::thread_pool(MAX_MASTERNODE_CONNECT_PARALLEL));
+    RenameThreadPool(*mnConnWorkers, "epmcoin-mncon");
     threadOpenMasternodeConnections = std::thread(&TraceThread<std::function<void()> >, "mncon", std::function<void()>(std::bind(&CConnman::ThreadOpenMasternodeConnections, this)));
 
     // Process messages
+    if (connOptions.nMsgProcThreads > 0) {
+        msgProcWorkers.reset(new ctpl::thread_pool(connOptions.nMsgProcThreads));
+        RenameThreadPool(*msgProcWorkers, "epmcoin-msgproc");
+    }
     threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
 
     // Dump network addresses
-    scheduler.scheduleEvery(std::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL * 1000);
+    scheduler.scheduleEvery(std::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL * 1000, "dumpaddr");
 
     return true;
 }
@@ -2623,8 +3263,17 @@ void CConnman::Stop()
 {
     if (threadMessageHandler.joinable())
         threadMessageHandler.join();
+    if (msgProcWorkers) {
+        // Workers give up quickly once flagInterruptMsgProc is set, and release their nodes
+        msgProcWorkers->stop(true);
+        msgProcWorkers.reset();
+    }
     if (threadOpenMasternodeConnections.joinable())
         threadOpenMasternodeConnections.join();
+    if (mnConnWorkers) {
+        mnConnWorkers->stop(true);
+        mnConnWorkers.reset();
+    }
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
     if (threadOpenAddedConnections.joinable())
@@ -2657,6 +3306,7 @@ void CConnman::Stop()
     }
     vNodes.clear();
     vNodesDisconnected.clear();
+    mapVerifiedMasternodes.clear();
     vhListenSocket.clear();
     delete semOutbound;
     semOutbound = NULL;
@@ -2670,6 +3320,13 @@ void CConnman::Stop()
     if (wakeupPipe[1] != -1) close(wakeupPipe[1]);
     wakeupPipe[0] = wakeupPipe[1] = -1;
 #endif
+
+#if defined(HAVE_EPOLL) || defined(HAVE_KQUEUE)
+    if (socketEventsFd != -1) {
+        close(socketEventsFd);
+        socketEventsFd = -1;
+    }
+#endif
 }
 
 void CConnman::DeleteNode(CNode* pnode)
@@ -2754,14 +3411,25 @@ bool CConnman::AddPendingMasternode(const CService& service)
     return true;
 }
 
-bool CConnman::AddMasternodeQuorumNodes(Consensus::LLMQType llmqType, const uint256& quorumHash, const std::set<uint256>& proTxHashes)
+bool CConnman::AddMasternodeQuorumNodes(Consensus::LLMQType llmqType, const uint256& quorumHash, const std::set<uint256>& proTxHashes, bool fDKG)
 {
     LOCK(cs_vPendingMasternodes);
-    auto it = masternodeQuorumNodes.find(std::make_pair(llmqType, quorumHash));
+    auto key = std::make_pair(llmqType, quorumHash);
+    auto it = masternodeQuorumNodes.find(key);
     if (it != masternodeQuorumNodes.end()) {
+        if (!fDKG) {
+            // the DKG is over and the quorum got established
+            masternodeQuorumConnStats[key].fDKG = false;
+        }
         return false;
     }
-    masternodeQuorumNodes.emplace(std::make_pair(llmqType, quorumHash), proTxHashes);
+    masternodeQuorumNodes.emplace(key, proTxHashes);
+
+    auto& stats = masternodeQuorumConnStats[key];
+    stats.llmqType = llmqType;
+    stats.quorumHash = quorumHash;
+    stats.fDKG = fDKG;
+    stats.nTimeAdded = GetTimeMicros();
     return true;
 }
 
@@ -2810,6 +3478,18 @@ void CConnman::RemoveMasternodeQuorumNodes(Consensus::LLMQType llmqType, const u
 {
     LOCK(cs_vPendingMasternodes);
     masternodeQuorumNodes.erase(std::make_pair(llmqType, quorumHash));
+    masternodeQuorumConnStats.erase(std::make_pair(llmqType, quorumHash));
+}
+
+std::vector<MasternodeQuorumConnStats> CConnman::GetMasternodeQuorumConnStats() const
+{
+    LOCK(cs_vPendingMasternodes);
+    std::vector<MasternodeQuorumConnStats> result;
+    result.reserve(masternodeQuorumConnStats.size());
+    for (const auto& p : masternodeQuorumConnStats) {
+        result.emplace_back(p.second);
+    }
+    return result;
 }
 
 bool CConnman::IsMasternodeQuorumNode(const CNode* pnode)
@@ -2899,6 +3579,8 @@ void CConnman::RelayTransaction(const CTransaction& tx)
         nInv = MSG_TXLOCK_REQUEST;
     }
     CInv inv(nInv, hash);
+    // parsed for the first filtered peer, then shared by all
+    std::unique_ptr<CBloomTxElements> txElements;
     LOCK(cs_vNodes);
     BOOST_FOREACH(CNode* pnode, vNodes)
     {
@@ -2908,7 +3590,11 @@ void CConnman::RelayTransaction(const CTransaction& tx)
             // differs from simple tx processing in PushInventory
             // and tx info will not be available there.
             LOCK(pnode->cs_filter);
-            if(pnode->pfilter && !pnode->pfilter->IsRelevantAndUpdate(tx)) continue;
+            if (pnode->pfilter) {
+                if (!txElements)
+                    txElements.reset(new CBloomTxElements(tx));
+                if (!pnode->pfilter->IsRelevantAndUpdate(*txElements)) continue;
+            }
         }
         pnode->PushInventory(inv);
     }
@@ -2923,14 +3609,19 @@ void CConnman::RelayInv(CInv &inv, const int minProtoVersion) {
 
 void CConnman::RelayInvFiltered(CInv &inv, const CTransaction& relatedTx, const int minProtoVersion)
 {
+    std::unique_ptr<CBloomTxElements> txElements;
     LOCK(cs_vNodes);
     for (const auto& pnode : vNodes) {
         if(pnode->nVersion < minProtoVersion)
             continue;
         {
             LOCK(pnode->cs_filter);
-            if(pnode->pfilter && !pnode->pfilter->IsRelevantAndUpdate(relatedTx))
-                continue;
+            if (pnode->pfilter) {
+                if (!txElements)
+                    txElements.reset(new CBloomTxElements(relatedTx));
+                if (!pnode->pfilter->IsRelevantAndUpdate(*txElements))
+                    continue;
+            }
         }
         pnode->PushInventory(inv);
     }
@@ -3095,6 +3786,7 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     nKeyedNetGroup(nKeyedNetGroupIn),
     addrKnown(5000, 0.001),
     filterInventoryKnown(50000, 0.000001),
+    txInventoryToSend(MAX_INVENTORY_TX_TO_SEND),
     nLocalHostNonce(nLocalHostNonceIn),
     nLocalServices(nLocalServicesIn),
     nMyStartingHeight(nMyStartingHeightIn),
@@ -3226,12 +3918,9 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
     return pnode && pnode->fSuccessfullyConnected && !pnode->fDisconnect;
 }
 
-void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg, bool allowOptimisticSend)
+CSharedNetMsg CConnman::ShareMessage(CSerializedNetMsg&& msg)
 {
     size_t nMessageSize = msg.data.size();
-    size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
-    LogPrint("net", "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->id);
-
     std::vector<unsigned char> serializedHeader;
     serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
     uint256 hash = Hash(msg.data.data(), msg.data.data() + nMessageSize);
@@ -3240,6 +3929,25 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg, bool allowOpti
 
     CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, serializedHeader, 0, hdr};
 
+    CSharedNetMsg sharedMsg;
+    sharedMsg.header = std::make_shared<const std::vector<unsigned char>>(std::move(serializedHeader));
+    sharedMsg.data = std::make_shared<const std::vector<unsigned char>>(std::move(msg.data));
+    sharedMsg.command = std::move(msg.command);
+    return sharedMsg;
+}
+
+void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg, bool allowOptimisticSend)
+{
+    PushMessage(pnode, ShareMessage(std::move(msg)), allowOptimisticSend);
+}
+
+void CConnman::PushMessage(CNode* pnode, const CSharedNetMsg& msg, bool allowOptimisticSend)
+{
+    size_t nMessageSize = msg.data->size();
+    size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
+    LogPrint("net", "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->id);
+    TRACE3(net, outbound_message, pnode->id, msg.command.c_str(), nMessageSize);
+
     size_t nBytesSent = 0;
     {
         LOCK(pnode->cs_vSend);
@@ -3252,9 +3960,9 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg, bool allowOpti
 
         if (pnode->nSendSize > nSendBufferMaxSize)
             pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
+        pnode->vSendMsg.push_back(msg.header);
         if (nMessageSize)
-            pnode->vSendMsg.push_back(std::move(msg.data));
+            pnode->vSendMsg.push_back(msg.data);
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend == true)
@@ -3293,6 +4001,34 @@ bool CConnman::ForNode(NodeId id, std::function<bool(const CNode* pnode)> cond,
     return found != nullptr && cond(found) && func(found);
 }
 
+bool CConnman::SetVerifiedMasternode(NodeId nodeId, const uint256& proTxHash, const uint256& pubKeyHash)
+{
+    LOCK(cs_vNodes);
+    auto itNode = std::find_if(vNodes.begin(), vNodes.end(), [&](const CNode* pnode) { return pnode->id == nodeId; });
+    if (itNode == vNodes.end() || (*itNode)->fDisconnect) {
+        return false;
+    }
+    CNode* pnode = *itNode;
+
+    {
+        LOCK(pnode->cs_mnauth);
+        if (!pnode->verifiedProRegTxHash.IsNull()) {
+            return false;
+        }
+        pnode->verifiedProRegTxHash = proTxHash;
+        pnode->verifiedPubKeyHash = pubKeyHash;
+    }
+
+    auto& pnodeOld = mapVerifiedMasternodes[proTxHash];
+    if (pnodeOld != nullptr) {
+        LogPrint("net", "CConnman::%s -- Masternode %s has already verified as peer %d, dropping old connection. peer=%d\n",
+                 __func__, proTxHash.ToString(), pnodeOld->id, nodeId);
+        pnodeOld->fDisconnect = true;
+    }
+    pnodeOld = pnode;
+    return true;
+}
+
 bool CConnman::IsMasternodeOrDisconnectRequested(const CService& addr) {
     return ForNode(addr, AllNodes, [](CNode* pnode){
         return pnode->fMasternode || pnode->fDisconnect;
@@ -21,14 +21,17 @@
 #include "uint256.h"
 #include "util.h"
 #include "threadinterrupt.h"
+#include "txannouncequeue.h"
 #include "consensus/params.h"
 
 #include <atomic>
 #include <deque>
+#include <set>
 #include <stdint.h>
 #include <thread>
 #include <memory>
 #include <condition_variable>
+#include <unordered_map>
 #include <unordered_set>
 
 #ifndef WIN32
@@ -85,6 +88,8 @@ static const int MAX_ADDNODE_CONNECTIONS = 8;
 /** Maximum number if outgoing masternodes */
 static const int MAX_OUTBOUND_MASTERNODE_CONNECTIONS = 30;
 static const int MAX_OUTBOUND_MASTERNODE_CONNECTIONS_ON_MN = 250;
+/** Maximum number of masternode connections being opened at the same time */
+static const int MAX_MASTERNODE_CONNECT_PARALLEL = 8;
 /** Eviction protection time for incoming connections  */
 static const int INBOUND_EVICTION_PROTECTION_TIME = 1;
 /** -listen default */
@@ -99,6 +104,8 @@ static const bool DEFAULT_UPNP = false;
 static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
 /** The maximum number of entries in setAskFor (larger due to getdata latency)*/
 static const size_t SETASKFOR_MAX_SZ = 2 * MAX_INV_SZ;
+/** The maximum number of transactions waiting to be announced to a peer */
+static const size_t MAX_INVENTORY_TX_TO_SEND = 2 * MAX_INV_SZ;
 /** The maximum number of peer connections to maintain. */
 static const unsigned int DEFAULT_MAX_PEER_CONNECTIONS = 125;
 /** The default for -maxuploadtarget. 0 = Unlimited */
@@ -111,9 +118,51 @@ static const bool DEFAULT_BLOCKSONLY = false;
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
+/** Most buffers handed to the kernel in one vectored send */
+static const int MAX_SEND_IOVECS = 64;
+/** Payloads with at least this much left are received straight into the message instead of the socket buffer */
+static const unsigned int MIN_DIRECT_RECV_SIZE = 64 * 1024;
+/** Largest message whose storage is kept for reuse after it's processed */
+static const unsigned int MAX_RECYCLED_MESSAGE_SIZE = 8 * 1024;
+/** How many processed messages a node keeps for reuse */
+static const size_t MAX_RECYCLED_MESSAGES = 16;
+/** Default number of threads processing chainstate-free messages, 0 to do everything on the message handler thread */
+static const int DEFAULT_MSGPROC_THREADS = 2;
+/** Maximum number of threads processing chainstate-free messages */
+static const int MAX_MSGPROC_THREADS = 16;
+/** How many messages a worker processes from one peer before giving it back to the message handler */
+static const int MAX_MSGPROC_WORKER_BATCH = 100;
 
 static const ServiceFlags REQUIRED_SERVICES = NODE_NETWORK;
 
+/** How ThreadSocketHandler waits for socket readiness (-socketevents) */
+enum SocketEventsMode {
+    SOCKETEVENTS_SELECT = 0,
+    SOCKETEVENTS_POLL = 1,
+    SOCKETEVENTS_EPOLL = 2,
+    SOCKETEVENTS_KQUEUE = 3,
+};
+
+/** The best -socketevents mode this platform supports */
+#if defined(HAVE_EPOLL)
+static const char* const DEFAULT_SOCKETEVENTS = "epoll";
+#elif defined(HAVE_KQUEUE)
+static const char* const DEFAULT_SOCKETEVENTS = "kqueue";
+#elif defined(USE_POLL)
+static const char* const DEFAULT_SOCKETEVENTS = "poll";
+#else
+static const char* const DEFAULT_SOCKETEVENTS = "select";
+#endif
+
+/**
+ * Whether a message can be handled off the message handler thread: it doesn't need
+ * cs_main for long and nothing depends on it being ordered with other peers' messages.
+ */
+bool IsChainstateFreeMessage(const std::string& strCommand);
+
+bool ParseSocketEventsMode(const std::string& strMode, SocketEventsMode& modeOut);
+std::string GetSupportedSocketEventsStr();
+
 // NOTE: When adjusting this, update rpcnet:setban's help ("24h")
 static const unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24;  // Default 24-hour ban
 
@@ -127,6 +176,25 @@ struct AddedNodeInfo
     bool fInbound;
 };
 
+/** Connection progress towards the members of one quorum, see ThreadOpenMasternodeConnections */
+struct MasternodeQuorumConnStats
+{
+    Consensus::LLMQType llmqType;
+    uint256 quorumHash;
+    bool fDKG{false};
+    int64_t nTimeAdded{0};
+    int nMembers{0};
+    int nConnected{0};
+    int nAttempts{0};
+    int nSucceeded{0};
+    int nFailures{0};
+    //! Time spent in successful connection attempts, in microseconds
+    int64_t nConnectTimeTotal{0};
+    int64_t nConnectTimeMax{0};
+    //! Microseconds from nTimeAdded until all members were connected, 0 if not there yet
+    int64_t nTimeAllConnected{0};
+};
+
 class CTransaction;
 class CNodeStats;
 class CClientUIInterface;
@@ -144,6 +212,14 @@ struct CSerializedNetMsg
     std::string command;
 };
 
+/** A message whose header and payload are serialized once and can be queued to any number of peers */
+struct CSharedNetMsg
+{
+    std::shared_ptr<const std::vector<unsigned char>> header;
+    std::shared_ptr<const std::vector<unsigned char>> data;
+    std::string command;
+};
+
 
 class CConnman
 {
@@ -170,6 +246,8 @@ public:
         unsigned int nReceiveFloodSize = 0;
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
+        SocketEventsMode socketEventsMode = SOCKETEVENTS_SELECT;
+        int nMsgProcThreads = 0;
     };
     CConnman(uint64_t seed0, uint64_t seed1);
     ~CConnman();
@@ -222,6 +300,9 @@ public:
     bool IsMasternodeOrDisconnectRequested(const CService& addr);
 
     void PushMessage(CNode* pnode, CSerializedNetMsg&& msg, bool allowOptimisticSend = DEFAULT_ALLOW_OPTIMISTIC_SEND);
+    void PushMessage(CNode* pnode, const CSharedNetMsg& msg, bool allowOptimisticSend = DEFAULT_ALLOW_OPTIMISTIC_SEND);
+    /** Add the header to a serialized message, for relaying it to many peers without serializing and hashing it again */
+    static CSharedNetMsg ShareMessage(CSerializedNetMsg&& msg);
 
     template<typename Condition, typename Callable>
     bool ForEachNodeContinueIf(const Condition& cond, Callable&& func)
@@ -327,6 +408,26 @@ public:
     std::vector<CNode*> CopyNodeVector();
     void ReleaseNodeVector(const std::vector<CNode*>& vecNodes);
 
+    /**
+     * Marks the connection nodeId as authenticated by the masternode proTxHash (see CMNAuth) and
+     * drops the connection which authenticated for the same masternode before, if any. Returns
+     * false if the node is gone or already verified.
+     */
+    bool SetVerifiedMasternode(NodeId nodeId, const uint256& proTxHash, const uint256& pubKeyHash);
+
+    /** Calls func with the connection verified for the masternode proTxHash, returns false if there is none */
+    template<typename Callable>
+    bool ForVerifiedMasternode(const uint256& proTxHash, Callable&& func)
+    {
+        LOCK(cs_vNodes);
+        auto it = mapVerifiedMasternodes.find(proTxHash);
+        if (it == mapVerifiedMasternodes.end()) {
+            return false;
+        }
+        func(it->second);
+        return true;
+    }
+
     void RelayTransaction(const CTransaction& tx);
     void RelayInv(CInv &inv, const int minProtoVersion = PROTOCOL_VERSION);
     void RelayInvFiltered(CInv &inv, const CTransaction &relatedTx, const int minProtoVersion = PROTOCOL_VERSION);
@@ -373,13 +474,15 @@ public:
     std::vector<AddedNodeInfo> GetAddedNodeInfo();
 
     bool AddPendingMasternode(const CService& addr);
-    bool AddMasternodeQuorumNodes(Consensus::LLMQType llmqType, const uint256& quorumHash, const std::set<uint256>& proTxHashes);
+    /** fDKG marks quorums with a DKG session in progress, their members are connected first */
+    bool AddMasternodeQuorumNodes(Consensus::LLMQType llmqType, const uint256& quorumHash, const std::set<uint256>& proTxHashes, bool fDKG = false);
     bool HasMasternodeQuorumNodes(Consensus::LLMQType llmqType, const uint256& quorumHash);
     std::set<uint256> GetMasternodeQuorums(Consensus::LLMQType llmqType);
     // also returns QWATCH nodes
     std::set<NodeId> GetMasternodeQuorumNodes(Consensus::LLMQType llmqType, const uint256& quorumHash) const;
     void RemoveMasternodeQuorumNodes(Consensus::LLMQType llmqType, const uint256& quorumHash);
     bool IsMasternodeQuorumNode(const CNode* pnode);
+    std::vector<MasternodeQuorumConnStats> GetMasternodeQuorumConnStats() const;
 
     size_t GetNodeCount(NumConnections num);
     void GetNodeStats(std::vector<CNodeStats>& vstats);
@@ -439,7 +542,29 @@ private:
     void ProcessOneShot();
     void ThreadOpenConnections();
     void ThreadMessageHandler();
+    /** Whether the next queued message of a peer may be handed to msgProcWorkers */
+    bool IsNextMessageChainstateFree(CNode* pnode) const;
+    /** Process chainstate-free messages of one peer on a worker, keeping their order */
+    void ProcessMessagesWorker(CNode* pnode);
     void AcceptConnection(const ListenSocket& hListenSocket);
+    /** Whether a socket can be handled with the current socket events mode */
+    bool IsSocketUsable(SOCKET hSocket) const;
+    /** Start watching a socket, for the modes with persistent registrations (epoll/kqueue) */
+    bool RegisterSocketEvents(SOCKET hSocket, bool fEdgeTriggered);
+    /** Collect the sockets select() and poll() wait on, returns false if there are none */
+    bool GenerateSelectSet(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+#ifdef USE_POLL
+    void SocketEventsPoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, bool fOnlyPoll);
+#endif
+#ifdef HAVE_EPOLL
+    void SocketEventsEpoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, bool fOnlyPoll);
+#endif
+#ifdef HAVE_KQUEUE
+    void SocketEventsKqueue(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, bool fOnlyPoll);
+#endif
+    void SocketEventsSelect(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, bool fOnlyPoll);
+    /** Wait for socket readiness, without blocking if fOnlyPoll is set */
+    void SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, bool fOnlyPoll);
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
     void ThreadOpenMasternodeConnections();
@@ -504,15 +629,20 @@ private:
     bool setBannedIsDirty;
     bool fAddressesInitialized;
     CAddrMan addrman;
+    //! addrman.GetModificationCount() when peers.dat was last read or written, used to skip unneeded dumps
+    std::atomic<uint64_t> nAddrmanModificationsFlushed{0};
     std::deque<std::string> vOneShots;
     CCriticalSection cs_vOneShots;
     std::vector<std::string> vAddedNodes;
     CCriticalSection cs_vAddedNodes;
     std::vector<CService> vPendingMasternodes;
     std::map<std::pair<Consensus::LLMQType, uint256>, std::set<uint256>> masternodeQuorumNodes; // protected by cs_vPendingMasternodes
+    std::map<std::pair<Consensus::LLMQType, uint256>, MasternodeQuorumConnStats> masternodeQuorumConnStats; // protected by cs_vPendingMasternodes
+    std::set<CService> setMasternodesConnecting; // protected by cs_vPendingMasternodes
     mutable CCriticalSection cs_vPendingMasternodes;
     std::vector<CNode*> vNodes;
     std::list<CNode*> vNodesDisconnected;
+    std::unordered_map<uint256, CNode*, StaticSaltedHasher> mapVerifiedMasternodes; // protected by cs_vNodes
     mutable CCriticalSection cs_vNodes;
     std::atomic<NodeId> nLastNodeId;
 
@@ -548,6 +678,9 @@ private:
     /** a pipe which is added to select() calls to wakeup before the timeout */
     int wakeupPipe[2]{-1,-1};
 #endif
+    SocketEventsMode socketEventsMode{SOCKETEVENTS_SELECT};
+    /** The epoll or kqueue descriptor, when using one of those modes */
+    int socketEventsFd{-1};
     std::atomic<bool> wakeupSelectNeeded{false};
 
     std::thread threadDNSAddressSeed;
@@ -556,6 +689,11 @@ private:
     std::thread threadOpenConnections;
     std::thread threadOpenMasternodeConnections;
     std::thread threadMessageHandler;
+
+    /** Workers for chainstate-free messages, a peer is owned by at most one thread at a time */
+    std::unique_ptr<ctpl::thread_pool> msgProcWorkers;
+    /** Workers for ThreadOpenMasternodeConnections, so a slow connect does not hold up the others */
+    std::unique_ptr<ctpl::thread_pool> mnConnWorkers;
 };
 extern std::unique_ptr<CConnman> g_connman;
 void Discover(boost::thread_group& threadGroup);
@@ -651,6 +789,7 @@ public:
     std::string cleanSubVer;
     bool fInbound;
     bool fAddnode;
+    bool fTxReconciliation;
     int nStartingHeight;
     uint64_t nSendBytes;
     mapMsgCmdSize mapSendBytesPerMsgCmd;
@@ -710,6 +849,14 @@ public:
 
     int readHeader(const char *pch, unsigned int nBytes);
     int readData(const char *pch, unsigned int nBytes);
+
+    /** Space for the next part of the payload, so it can be received into place */
+    char* GetDataSpace(unsigned int& nSpace);
+    /** Account for nBytes written to GetDataSpace() */
+    void DataReceived(unsigned int nBytes);
+
+    /** Get ready for receiving a new message, keeping the allocated buffers */
+    void Reset(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nVersionIn);
 };
 
 
@@ -725,10 +872,11 @@ public:
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<std::vector<unsigned char>> vSendMsg;
+    std::deque<std::shared_ptr<const std::vector<unsigned char>>> vSendMsg;
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
     CCriticalSection cs_vRecv;
+    std::list<CNetMessage> vRecvMsgPool; // processed messages kept for reuse, guarded by cs_vRecv
 
     CCriticalSection cs_vProcessMsg;
     std::list<CNetMessage> vProcessMsg;
@@ -783,6 +931,12 @@ public:
 
     std::atomic_bool fPauseRecv;
     std::atomic_bool fPauseSend;
+    //! Set while a msgProcWorkers thread owns the processing of this node
+    std::atomic_bool fProcessingAsync{false};
+    //! Readiness of hSocket. Reset every round for select/poll, kept until recv/send would block for epoll/kqueue.
+    //! Starts out set, as edge-triggered modes don't report readiness from before the socket was registered.
+    std::atomic_bool fHasRecvData{true};
+    std::atomic_bool fCanSendData{true};
 protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
@@ -802,9 +956,9 @@ public:
 
     // inventory based relay
     CRollingBloomFilter filterInventoryKnown;
-    // Set of transaction ids we still have to announce.
-    // They are sorted by the mempool before relay, so the order is not important.
-    std::set<uint256> setInventoryTxToSend;
+    // Transaction ids we still have to announce, sorted by their mempool priority
+    // when the trickle comes around.
+    CTxAnnounceQueue txInventoryToSend;
     // List of block ids we still have announce.
     // There is no final sorting before sending, as they are always sent immediately
     // and in the order requested.
@@ -821,6 +975,16 @@ public:
     // Used for BIP35 mempool sending, also protected by cs_inventory
     bool fSendMempool;
 
+    // Short-id transaction announcements (SENDTXRCNCL), also protected by cs_inventory
+    bool fTxReconSent{false}; // we sent SENDTXRCNCL
+    bool fTxRecon{false};     // both sides did, so transactions are announced with TXRCNCLINV
+    uint64_t nTxReconSalt{0};
+    uint64_t nTxReconK0{0};
+    uint64_t nTxReconK1{0};
+    // What we announced by short id, so TXRCNCLREQ can be answered, and when the entries expire
+    std::map<uint32_t, uint256> mapTxReconAnnounced;
+    std::deque<std::pair<int64_t, uint32_t>> vTxReconAnnouncedExpiry;
+
     // Block and TXN accept times
     std::atomic<int64_t> nLastBlockTime;
     std::atomic<int64_t> nLastTXTime;
@@ -848,6 +1012,8 @@ public:
     uint256 receivedMNAuthChallenge;
     uint256 verifiedProRegTxHash;
     uint256 verifiedPubKeyHash;
+    // Set once MNAUTH was received, its signature may still be in verification
+    bool fReceivedMNAuth{false};
 
     // If true, we will announce/send him plain recovered sigs (usually true for full nodes)
     std::atomic<bool> fSendRecSigs{false};
@@ -874,6 +1040,8 @@ private:
 
     CService addrLocal;
     mutable CCriticalSection cs_addrLocal;
+
+    void CompleteMessage(CNetMessage& msg, int64_t nTimeMicros);
 public:
 
     NodeId GetId() const {
@@ -895,6 +1063,14 @@ public:
     }
 
     bool ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete);
+    /**
+     * The rest of the payload being received, if at least nMinSpace of it is left.
+     * Follow up with ReceivedInPlace() once recv() wrote into it. SocketHandler thread only.
+     */
+    char* GetRecvSpace(unsigned int nMinSpace, unsigned int& nSpace);
+    bool ReceivedInPlace(unsigned int nBytes, bool& complete);
+    /** Hand the storage of processed messages back for receiving new ones */
+    void RecycleMessages(std::list<CNetMessage>& msgs);
 
     void SetRecvVersion(int nVersionIn)
     {
@@ -963,7 +1139,7 @@ public:
         if (inv.type == MSG_TX) {
             if (!filterInventoryKnown.contains(inv.hash)) {
                 LogPrint("net", "PushInventory --  inv: %s peer=%d\n", inv.ToString(), id);
-                setInventoryTxToSend.insert(inv.hash);
+                txInventoryToSend.Push(inv.hash);
             } else {
                 LogPrint("net", "PushInventory --  filtered inv: %s peer=%d\n", inv.ToString(), id);
             }
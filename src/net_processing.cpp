@@ -23,10 +23,14 @@
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "random.h"
+#include "saltedhasher.h"
+#include "timehistogram.h"
 #include "tinyformat.h"
+#include "tracing.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include "ui_interface.h"
+#include "unordered_lru_cache.h"
 #include "util.h"
 #include "utilmoneystr.h"
 #include "utilstrencodings.h"
@@ -55,6 +59,10 @@
 #include "llmq/quorums_signing.h"
 #include "llmq/quorums_signing_shares.h"
 
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+
 #include <boost/thread.hpp>
 
 #if defined(NDEBUG)
@@ -63,31 +71,42 @@
 
 std::atomic<int64_t> nTimeBestReceived(0); // Used only to inform the wallet of when we last received a block
 
-struct IteratorComparator
-{
-    template<typename I>
-    bool operator()(const I& a, const I& b)
-    {
-        return &(*a) < &(*b);
-    }
-};
-
 struct COrphanTx {
     // When modifying, adapt the copy of this definition in tests/DoS_tests.
     CTransactionRef tx;
     NodeId fromPeer;
     int64_t nTimeExpire;
     size_t nTxSize;
+    // Positions in vOrphanList and in the list of the peer
+    size_t nListPos;
+    size_t nPeerPos;
+};
+/** The orphans of one peer and their total size */
+struct COrphanPeer {
+    std::vector<COrphanTx*> vecOrphans;
+    size_t nSize = 0;
 };
 static CCriticalSection g_cs_orphans;
-std::map<uint256, COrphanTx> mapOrphanTransactions GUARDED_BY(g_cs_orphans);
-std::map<COutPoint, std::set<std::map<uint256, COrphanTx>::iterator, IteratorComparator>> mapOrphanTransactionsByPrev GUARDED_BY(g_cs_orphans);
+typedef std::unordered_map<uint256, COrphanTx, StaticSaltedHasher> OrphanMap;
+OrphanMap mapOrphanTransactions GUARDED_BY(g_cs_orphans);
+// The pointers below point into mapOrphanTransactions, which keeps its elements in place until they are erased.
+/** The orphans spending outputs of a txid, each orphan is listed once per parent */
+std::unordered_map<uint256, std::vector<COrphanTx*>, StaticSaltedHasher> mapOrphanTransactionsByParent GUARDED_BY(g_cs_orphans);
+/** All orphans in no particular order, to pick a random one for eviction */
+static std::vector<COrphanTx*> vOrphanList GUARDED_BY(g_cs_orphans);
+static std::map<NodeId, COrphanPeer> mapOrphanPeers GUARDED_BY(g_cs_orphans);
 size_t nMapOrphanTransactionsSize = 0;
 void EraseOrphansFor(NodeId peer);
 
 static size_t vExtraTxnForCompactIt GUARDED_BY(g_cs_orphans) = 0;
 static std::vector<std::pair<uint256, CTransactionRef>> vExtraTxnForCompact GUARDED_BY(g_cs_orphans);
 
+/** InstantSend-locked txn we couldn't keep in our mempool. They are bound to be mined, so we keep them
+ *  apart from vExtraTxnForCompact, where orphans could push them out before the block shows up. */
+static CCriticalSection cs_lockedTxnForCompact;
+static size_t vLockedTxnForCompactIt GUARDED_BY(cs_lockedTxnForCompact) = 0;
+static std::vector<std::pair<uint256, CTransactionRef>> vLockedTxnForCompact GUARDED_BY(cs_lockedTxnForCompact);
+
 static const uint64_t RANDOMIZER_ID_ADDRESS_RELAY = 0x3cac0035b5866b90ULL; // SHA256("main address relay")[0:8]
 
 /// Age after which a stale block will no longer be served if requested as
@@ -141,6 +160,7 @@ namespace {
         const CBlockIndex* pindex;                               //!< Optional.
         bool fValidatedHeaders;                                  //!< Whether this block has validated headers at the time of request.
         std::unique_ptr<PartiallyDownloadedBlock> partialBlock;  //!< Optional, used for CMPCTBLOCK downloads
+        int64_t nTimeRequested;                                  //!< When we asked for the block (in microseconds).
     };
     std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> > mapBlocksInFlight;
 
@@ -220,6 +240,12 @@ struct CNodeState {
     int64_t nDownloadingSince;
     int nBlocksInFlight;
     int nBlocksInFlightValidHeaders;
+    //! How many blocks we ask this peer for at once, see GetBlocksInFlightLimit.
+    int nBlocksInFlightLimit;
+    //! Moving average of the time it takes this peer to send us one block we asked for (in microseconds), or 0.
+    int64_t nAvgBlockTime;
+    //! When we last received a block we asked this peer for (in microseconds).
+    int64_t nLastBlockReceived;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
     //! Whether this peer wants invs or headers (when possible) for block announcements.
@@ -237,6 +263,16 @@ struct CNodeState {
     //! Time of last new block announcement
     int64_t m_last_block_announcement;
 
+    //! Compact blocks from this peer we reconstructed without a round trip
+    uint64_t nCmpctBlocksReconstructed;
+    //! Compact blocks from this peer which needed a GETBLOCKTXN round trip
+    uint64_t nCmpctBlocksRoundTrip;
+    //! Compact blocks from this peer we gave up on and downloaded in full
+    uint64_t nCmpctBlocksFailed;
+    //! Transactions of this peer's compact blocks found in our mempool, and requested from it
+    uint64_t nCmpctTxnHit;
+    uint64_t nCmpctTxnMiss;
+
     CNodeState(CAddress addrIn, std::string addrNameIn) : address(addrIn), name(addrNameIn) {
         fCurrentlyConnected = false;
         nMisbehavior = 0;
@@ -252,12 +288,20 @@ struct CNodeState {
         nDownloadingSince = 0;
         nBlocksInFlight = 0;
         nBlocksInFlightValidHeaders = 0;
+        nBlocksInFlightLimit = MIN_BLOCKS_IN_TRANSIT_PER_PEER;
+        nAvgBlockTime = 0;
+        nLastBlockReceived = 0;
         fPreferredDownload = false;
         fPreferHeaders = false;
         fPreferHeaderAndIDs = false;
         fProvidesHeaderAndIDs = false;
         fSupportsDesiredCmpctVersion = false;
         m_last_block_announcement = 0;
+        nCmpctBlocksReconstructed = 0;
+        nCmpctBlocksRoundTrip = 0;
+        nCmpctBlocksFailed = 0;
+        nCmpctTxnHit = 0;
+        nCmpctTxnMiss = 0;
     }
 };
 
@@ -396,7 +440,7 @@ bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const Consensus::Pa
     MarkBlockAsReceived(hash);
 
     std::list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(),
-            {hash, pindex, pindex != NULL, std::unique_ptr<PartiallyDownloadedBlock>(pit ? new PartiallyDownloadedBlock(&mempool) : NULL)});
+            {hash, pindex, pindex != NULL, std::unique_ptr<PartiallyDownloadedBlock>(pit ? new PartiallyDownloadedBlock(&mempool) : NULL), GetTimeMicros()});
     state->nBlocksInFlight++;
     state->nBlocksInFlightValidHeaders += it->fValidatedHeaders;
     if (state->nBlocksInFlight == 1) {
@@ -412,6 +456,43 @@ bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const Consensus::Pa
     return true;
 }
 
+// Requires cs_main.
+// Updates the download speed of a peer which sent us a block we asked it for.
+void UpdateBlockDownloadTime(NodeId nodeid, const uint256& hash) {
+    std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != nodeid)
+        return;
+    CNodeState *state = State(nodeid);
+    assert(state != NULL);
+
+    int64_t nNow = GetTimeMicros();
+    // With more blocks queued, the peer only starts sending this one when it's done with the previous one
+    int64_t nTime = std::max<int64_t>(1, nNow - std::max(itInFlight->second.second->nTimeRequested, state->nLastBlockReceived));
+    state->nLastBlockReceived = nNow;
+    state->nAvgBlockTime = state->nAvgBlockTime == 0 ? nTime : (7 * state->nAvgBlockTime + nTime) / 8;
+}
+
+// Requires cs_main.
+// How many blocks we ask a peer for at once: enough to keep it busy for a round trip plus
+// BLOCK_DOWNLOAD_QUEUE_TIME at the speed it sent us blocks so far. Peers we didn't get a block
+// from yet start with the minimum.
+int GetBlocksInFlightLimit(const CNode* pnode, const CNodeState& state) {
+    if (state.nAvgBlockTime == 0)
+        return MIN_BLOCKS_IN_TRANSIT_PER_PEER;
+    int64_t nPing = pnode->nMinPingUsecTime;
+    if (nPing == std::numeric_limits<int64_t>::max())
+        nPing = 0;
+    int64_t nLimit = (BLOCK_DOWNLOAD_QUEUE_TIME + nPing) / state.nAvgBlockTime;
+    return std::max<int64_t>(MIN_BLOCKS_IN_TRANSIT_PER_PEER, std::min<int64_t>(MAX_BLOCKS_IN_TRANSIT_PER_PEER, nLimit));
+}
+
+// Whether blocks reach us from peer a at least twice as fast as from peer b.
+bool IsFasterBlockSource(const CNodeState& a, const CNodeState& b) {
+    if (a.nAvgBlockTime == 0)
+        return false;
+    return b.nAvgBlockTime == 0 || 2 * a.nAvgBlockTime < b.nAvgBlockTime;
+}
+
 /** Check whether the last unknown block a peer advertised is not yet known. */
 void ProcessBlockAvailability(NodeId nodeid) {
     CNodeState *state = State(nodeid);
@@ -517,8 +598,9 @@ const CBlockIndex* LastCommonAncestor(const CBlockIndex* pa, const CBlockIndex*
 }
 
 /** Update pindexLastCommonBlock and add not-in-flight missing successors to vBlocks, until it has
- *  at most count entries. */
-void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller, const Consensus::Params& consensusParams) {
+ *  at most count entries. If the window is full, nodeStaller is set to the peer we're waiting for
+ *  and pindexStalling to the block it holds up. */
+void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller, const CBlockIndex*& pindexStalling, const Consensus::Params& consensusParams) {
     if (count == 0)
         return;
 
@@ -554,6 +636,7 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
     int nWindowEnd = state->pindexLastCommonBlock->nHeight + BLOCK_DOWNLOAD_WINDOW;
     int nMaxHeight = std::min<int>(state->pindexBestKnownBlock->nHeight, nWindowEnd + 1);
     NodeId waitingfor = -1;
+    const CBlockIndex* pindexWaitingFor = NULL;
     while (pindexWalk->nHeight < nMaxHeight) {
         // Read up to 128 (or more, if more blocks than that are needed) successors of pindexWalk (towards
         // pindexBestKnownBlock) into vToFetch. We fetch 128, because CBlockIndex::GetAncestor may be as expensive
@@ -585,6 +668,7 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
                     if (vBlocks.size() == 0 && waitingfor != nodeid) {
                         // We aren't able to fetch anything, but we would be if the download window was one larger.
                         nodeStaller = waitingfor;
+                        pindexStalling = pindexWaitingFor;
                     }
                     return;
                 }
@@ -595,6 +679,7 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
             } else if (waitingfor == -1) {
                 // This is the first already-in-flight block.
                 waitingfor = mapBlocksInFlight[pindex->GetBlockHash()].first;
+                pindexWaitingFor = pindex;
             }
         }
     }
@@ -614,6 +699,13 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
     }
+    stats.nBlocksInFlightLimit = state->nBlocksInFlightLimit;
+    stats.nAvgBlockTime = state->nAvgBlockTime;
+    stats.nCmpctBlocksReconstructed = state->nCmpctBlocksReconstructed;
+    stats.nCmpctBlocksRoundTrip = state->nCmpctBlocksRoundTrip;
+    stats.nCmpctBlocksFailed = state->nCmpctBlocksFailed;
+    stats.nCmpctTxnHit = state->nCmpctTxnHit;
+    stats.nCmpctTxnMiss = state->nCmpctTxnMiss;
     return true;
 }
 
@@ -649,6 +741,49 @@ void AddToCompactExtraTransactions(const CTransactionRef& tx) EXCLUSIVE_LOCKS_RE
     vExtraTxnForCompactIt = (vExtraTxnForCompactIt + 1) % max_extra_txn;
 }
 
+static bool IsInstantSendLocked(const uint256& txid)
+{
+    return instantsend.IsLockedInstantSendTransaction(txid) ||
+           (llmq::quorumInstantSendManager && llmq::quorumInstantSendManager->IsLocked(txid));
+}
+
+static void AddToCompactLockedTransactions(const CTransactionRef& tx)
+{
+    LOCK(cs_lockedTxnForCompact);
+    size_t max_extra_txn = GetArg("-blockreconstructionextratxn", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN);
+    if (max_extra_txn <= 0)
+        return;
+    if (!vLockedTxnForCompact.size())
+        vLockedTxnForCompact.resize(max_extra_txn);
+    vLockedTxnForCompact[vLockedTxnForCompactIt] = std::make_pair(tx->GetHash(), tx);
+    vLockedTxnForCompactIt = (vLockedTxnForCompactIt + 1) % max_extra_txn;
+}
+
+// Called with mempool.cs held
+static void MempoolEntryRemoved(CTransactionRef tx, MemPoolRemovalReason reason)
+{
+    // Expiry already spares locked txn, but TrimToSize doesn't know about locks
+    if (reason == MemPoolRemovalReason::SIZELIMIT && IsInstantSendLocked(tx->GetHash()))
+        AddToCompactLockedTransactions(tx);
+}
+
+/** Everything but the mempool which InitData may fill a compact block from */
+static std::vector<std::pair<uint256, CTransactionRef>> GetCompactExtraTransactions() EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans)
+{
+    std::vector<std::pair<uint256, CTransactionRef>> vExtraTxn;
+    LOCK(cs_lockedTxnForCompact);
+    vExtraTxn.reserve(vLockedTxnForCompact.size() + vExtraTxnForCompact.size());
+    for (const auto& p : vLockedTxnForCompact) {
+        if (p.second)
+            vExtraTxn.push_back(p);
+    }
+    for (const auto& p : vExtraTxnForCompact) {
+        if (p.second)
+            vExtraTxn.push_back(p);
+    }
+    return vExtraTxn;
+}
+
 bool AddOrphanTx(const CTransactionRef& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans)
 {
     const uint256& hash = tx->GetHash();
@@ -669,37 +804,68 @@ bool AddOrphanTx(const CTransactionRef& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRE
         return false;
     }
 
-    auto ret = mapOrphanTransactions.emplace(hash, COrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME, sz});
+    COrphanPeer& orphanPeer = mapOrphanPeers[peer];
+    auto ret = mapOrphanTransactions.emplace(hash, COrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME, sz, vOrphanList.size(), orphanPeer.vecOrphans.size()});
     assert(ret.second);
+    COrphanTx* porphan = &ret.first->second;
     BOOST_FOREACH(const CTxIn& txin, tx->vin) {
-        mapOrphanTransactionsByPrev[txin.prevout].insert(ret.first);
+        std::vector<COrphanTx*>& vecChildren = mapOrphanTransactionsByParent[txin.prevout.hash];
+        if (vecChildren.empty() || vecChildren.back() != porphan)
+            vecChildren.push_back(porphan);
     }
+    vOrphanList.push_back(porphan);
+    orphanPeer.vecOrphans.push_back(porphan);
+    orphanPeer.nSize += sz;
 
     AddToCompactExtraTransactions(tx);
 
     nMapOrphanTransactionsSize += sz;
 
-    LogPrint("mempool", "stored orphan tx %s (mapsz %u outsz %u)\n", hash.ToString(),
-             mapOrphanTransactions.size(), mapOrphanTransactionsByPrev.size());
+    LogPrint("mempool", "stored orphan tx %s (mapsz %u parents %u)\n", hash.ToString(),
+             mapOrphanTransactions.size(), mapOrphanTransactionsByParent.size());
     return true;
 }
 
 int static EraseOrphanTx(uint256 hash) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans)
 {
-    std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.find(hash);
+    OrphanMap::iterator it = mapOrphanTransactions.find(hash);
     if (it == mapOrphanTransactions.end())
         return 0;
-    BOOST_FOREACH(const CTxIn& txin, it->second.tx->vin)
+    COrphanTx* porphan = &it->second;
+    BOOST_FOREACH(const CTxIn& txin, porphan->tx->vin)
     {
-        auto itPrev = mapOrphanTransactionsByPrev.find(txin.prevout);
-        if (itPrev == mapOrphanTransactionsByPrev.end())
+        auto itParent = mapOrphanTransactionsByParent.find(txin.prevout.hash);
+        if (itParent == mapOrphanTransactionsByParent.end())
+            continue;
+        std::vector<COrphanTx*>& vecChildren = itParent->second;
+        auto itChild = std::find(vecChildren.begin(), vecChildren.end(), porphan);
+        // already gone if we spend more than one output of the parent
+        if (itChild == vecChildren.end())
             continue;
-        itPrev->second.erase(it);
-        if (itPrev->second.empty())
-            mapOrphanTransactionsByPrev.erase(itPrev);
+        *itChild = vecChildren.back();
+        vecChildren.pop_back();
+        if (vecChildren.empty())
+            mapOrphanTransactionsByParent.erase(itParent);
     }
-    assert(nMapOrphanTransactionsSize >= it->second.nTxSize);
-    nMapOrphanTransactionsSize -= it->second.nTxSize;
+
+    // Move the last entries of the lists into the place of this one
+    vOrphanList[porphan->nListPos] = vOrphanList.back();
+    vOrphanList[porphan->nListPos]->nListPos = porphan->nListPos;
+    vOrphanList.pop_back();
+
+    auto itPeer = mapOrphanPeers.find(porphan->fromPeer);
+    assert(itPeer != mapOrphanPeers.end());
+    COrphanPeer& orphanPeer = itPeer->second;
+    orphanPeer.vecOrphans[porphan->nPeerPos] = orphanPeer.vecOrphans.back();
+    orphanPeer.vecOrphans[porphan->nPeerPos]->nPeerPos = porphan->nPeerPos;
+    orphanPeer.vecOrphans.pop_back();
+    assert(orphanPeer.nSize >= porphan->nTxSize);
+    orphanPeer.nSize -= porphan->nTxSize;
+    if (orphanPeer.vecOrphans.empty())
+        mapOrphanPeers.erase(itPeer);
+
+    assert(nMapOrphanTransactionsSize >= porphan->nTxSize);
+    nMapOrphanTransactionsSize -= porphan->nTxSize;
     mapOrphanTransactions.erase(it);
     return 1;
 }
@@ -708,18 +874,28 @@ void EraseOrphansFor(NodeId peer)
 {
     LOCK(g_cs_orphans);
     int nErased = 0;
-    std::map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
-    while (iter != mapOrphanTransactions.end())
-    {
-        std::map<uint256, COrphanTx>::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
-        if (maybeErase->second.fromPeer == peer)
-        {
-            nErased += EraseOrphanTx(maybeErase->second.tx->GetHash());
-        }
+    // the entry of the peer is gone with its last orphan
+    for (auto it = mapOrphanPeers.find(peer); it != mapOrphanPeers.end(); it = mapOrphanPeers.find(peer)) {
+        nErased += EraseOrphanTx(it->second.vecOrphans.back()->tx->GetHash());
     }
     if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx from peer=%d\n", nErased, peer);
 }
 
+/** Evicts random orphans of one peer until they take up at most nMaxPeerOrphansSize,
+ *  so a peer sending us lots of orphans pushes out its own ones instead of everyone's */
+unsigned int LimitOrphanTxSizeForPeer(NodeId peer, unsigned int nMaxPeerOrphansSize)
+{
+    LOCK(g_cs_orphans);
+
+    unsigned int nEvicted = 0;
+    for (auto it = mapOrphanPeers.find(peer); it != mapOrphanPeers.end() && it->second.nSize > nMaxPeerOrphansSize; it = mapOrphanPeers.find(peer)) {
+        const std::vector<COrphanTx*>& vecOrphans = it->second.vecOrphans;
+        EraseOrphanTx(vecOrphans[GetRand(vecOrphans.size())]->tx->GetHash());
+        ++nEvicted;
+    }
+    return nEvicted;
+}
+
 
 unsigned int LimitOrphanTxSize(unsigned int nMaxOrphansSize)
 {
@@ -732,28 +908,24 @@ unsigned int LimitOrphanTxSize(unsigned int nMaxOrphansSize)
         // Sweep out expired orphan pool entries:
         int nErased = 0;
         int64_t nMinExpTime = nNow + ORPHAN_TX_EXPIRE_TIME - ORPHAN_TX_EXPIRE_INTERVAL;
-        std::map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
-        while (iter != mapOrphanTransactions.end())
+        // Backwards, erasing moves the last entry, which we have seen already, into the current place
+        for (size_t i = vOrphanList.size(); i-- > 0;)
         {
-            std::map<uint256, COrphanTx>::iterator maybeErase = iter++;
-            if (maybeErase->second.nTimeExpire <= nNow) {
-                nErased += EraseOrphanTx(maybeErase->second.tx->GetHash());
+            const COrphanTx* porphan = vOrphanList[i];
+            if (porphan->nTimeExpire <= nNow) {
+                nErased += EraseOrphanTx(porphan->tx->GetHash());
             } else {
-                nMinExpTime = std::min(maybeErase->second.nTimeExpire, nMinExpTime);
+                nMinExpTime = std::min(porphan->nTimeExpire, nMinExpTime);
             }
         }
         // Sweep again 5 minutes after the next entry that expires in order to batch the linear scan.
         nNextSweep = nMinExpTime + ORPHAN_TX_EXPIRE_INTERVAL;
         if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx due to expiration\n", nErased);
     }
-    while (!mapOrphanTransactions.empty() && nMapOrphanTransactionsSize > nMaxOrphansSize)
+    while (!vOrphanList.empty() && nMapOrphanTransactionsSize > nMaxOrphansSize)
     {
         // Evict a random orphan:
-        uint256 randomhash = GetRandHash();
-        std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.lower_bound(randomhash);
-        if (it == mapOrphanTransactions.end())
-            it = mapOrphanTransactions.begin();
-        EraseOrphanTx(it->first);
+        EraseOrphanTx(vOrphanList[GetRand(vOrphanList.size())]->tx->GetHash());
         ++nEvicted;
     }
     return nEvicted;
@@ -817,6 +989,11 @@ static bool BlockRequestAllowed(const CBlockIndex* pindex, const Consensus::Para
 PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn) : connman(connmanIn) {
     // Initialize global variables that cannot be constructed at startup.
     recentRejects.reset(new CRollingBloomFilter(120000, 0.000001));
+    mempool.NotifyEntryRemoved.connect(&MempoolEntryRemoved);
+}
+
+PeerLogicValidation::~PeerLogicValidation() {
+    mempool.NotifyEntryRemoved.disconnect(&MempoolEntryRemoved);
 }
 
 void PeerLogicValidation::SyncTransaction(const CTransaction& tx, const CBlockIndex* pindex, int nPosInBlock) {
@@ -828,12 +1005,17 @@ void PeerLogicValidation::SyncTransaction(const CTransaction& tx, const CBlockIn
     std::vector<uint256> vOrphanErase;
     // Which orphan pool entries must we evict?
     for (size_t j = 0; j < tx.vin.size(); j++) {
-        auto itByPrev = mapOrphanTransactionsByPrev.find(tx.vin[j].prevout);
-        if (itByPrev == mapOrphanTransactionsByPrev.end()) continue;
-        for (auto mi = itByPrev->second.begin(); mi != itByPrev->second.end(); ++mi) {
-            const CTransaction& orphanTx = *(*mi)->second.tx;
-            const uint256& orphanHash = orphanTx.GetHash();
-            vOrphanErase.push_back(orphanHash);
+        const COutPoint& prevout = tx.vin[j].prevout;
+        auto itByParent = mapOrphanTransactionsByParent.find(prevout.hash);
+        if (itByParent == mapOrphanTransactionsByParent.end()) continue;
+        for (const COrphanTx* porphan : itByParent->second) {
+            const CTransaction& orphanTx = *porphan->tx;
+            for (const CTxIn& orphanIn : orphanTx.vin) {
+                if (orphanIn.prevout == prevout) {
+                    vOrphanErase.push_back(orphanTx.GetHash());
+                    break;
+                }
+            }
         }
     }
 
@@ -847,6 +1029,127 @@ void PeerLogicValidation::SyncTransaction(const CTransaction& tx, const CBlockIn
     }
 }
 
+// Serialized ISLOCKs, CLSIGs and governance objects which were just announced, as most peers
+// ask for them within milliseconds. Entries are only used for peers with the same send version.
+struct CRecentRelayMessage
+{
+    int nSendVersion;
+    CSharedNetMsg msg;
+};
+static const size_t MAX_RECENT_RELAY_MESSAGES = 256;
+static CCriticalSection cs_recentRelayMessages;
+static unordered_lru_cache<uint256, CRecentRelayMessage, StaticSaltedHasher, MAX_RECENT_RELAY_MESSAGES> recentRelayMessages;
+static std::atomic<uint64_t> nRecentRelayHits{0};
+static std::atomic<uint64_t> nRecentRelayMisses{0};
+
+/**
+ * Push the relayed object behind inv to pfrom, serializing it with makeMsg only if no peer
+ * with the same send version asked for it recently. makeMsg returns false if we don't have it.
+ */
+template<typename MakeMsg>
+static bool PushRecentRelayMessage(CNode* pfrom, CConnman& connman, const CInv& inv, MakeMsg&& makeMsg)
+{
+    const int nSendVersion = pfrom->GetSendVersion();
+    CRecentRelayMessage entry;
+    {
+        LOCK(cs_recentRelayMessages);
+        if (recentRelayMessages.get(inv.hash, entry) && entry.nSendVersion == nSendVersion) {
+            nRecentRelayHits++;
+            connman.PushMessage(pfrom, entry.msg);
+            return true;
+        }
+    }
+
+    CSerializedNetMsg msg;
+    if (!makeMsg(CNetMsgMaker(nSendVersion), msg))
+        return false;
+    nRecentRelayMisses++;
+    entry.nSendVersion = nSendVersion;
+    entry.msg = CConnman::ShareMessage(std::move(msg));
+    {
+        LOCK(cs_recentRelayMessages);
+        recentRelayMessages.insert(inv.hash, entry);
+    }
+    connman.PushMessage(pfrom, entry.msg);
+    return true;
+}
+
+void GetRelayCacheStats(uint64_t& nHitsRet, uint64_t& nMissesRet, size_t& nEntriesRet)
+{
+    nHitsRet = nRecentRelayHits;
+    nMissesRet = nRecentRelayMisses;
+    LOCK(cs_recentRelayMessages);
+    nEntriesRet = recentRelayMessages.size();
+}
+
+memusage::SubsystemUsage GetOrphanMemoryUsage()
+{
+    LOCK(g_cs_orphans);
+    memusage::SubsystemUsage usage;
+    usage.nEntries = mapOrphanTransactions.size();
+    usage.nBytes = memusage::DynamicUsage(mapOrphanTransactions) + memusage::DynamicUsage(mapOrphanTransactionsByParent) +
+                   memusage::DynamicUsage(vOrphanList) + memusage::DynamicUsage(mapOrphanPeers);
+    for (const auto& p : mapOrphanTransactions) {
+        usage.nBytes += memusage::DynamicUsage(p.second.tx) + RecursiveDynamicUsage(*p.second.tx);
+    }
+    for (const auto& p : mapOrphanTransactionsByParent) {
+        usage.nBytes += memusage::DynamicUsage(p.second);
+    }
+    for (const auto& p : mapOrphanPeers) {
+        usage.nBytes += memusage::DynamicUsage(p.second.vecOrphans);
+    }
+    return usage;
+}
+
+struct CMessageTimes {
+    CTimeHistogram processing;
+    CTimeHistogram wait;
+    int64_t nCPUTimeTotal = 0;
+};
+
+static CCriticalSection cs_messageTimes;
+static std::map<std::string, CMessageTimes> mapMessageTimes; // protected by cs_messageTimes
+
+static void RecordMessageTimes(const std::string& strCommand, int64_t nWait, int64_t nTime, int64_t nCPUTime)
+{
+    // Peers can send any command, only known ones get their own entry
+    static const std::set<std::string> setKnownCommands(getAllNetMessageTypes().begin(), getAllNetMessageTypes().end());
+    static const std::string strOther = "*other*";
+
+    LOCK(cs_messageTimes);
+    CMessageTimes& times = mapMessageTimes[setKnownCommands.count(strCommand) ? strCommand : strOther];
+    times.processing.Add(nTime);
+    times.wait.Add(nWait);
+    times.nCPUTimeTotal += nCPUTime;
+}
+
+std::vector<CMessageProcessingStats> GetMessageProcessingStats()
+{
+    LOCK(cs_messageTimes);
+    std::vector<CMessageProcessingStats> vStats;
+    vStats.reserve(mapMessageTimes.size());
+    for (const auto& p : mapMessageTimes) {
+        CMessageProcessingStats stats;
+        stats.strCommand = p.first;
+        stats.nCount = p.second.processing.nCount;
+        stats.nTimeTotal = p.second.processing.nTotal;
+        stats.nTimeMax = p.second.processing.nMax;
+        stats.nTimeP50 = p.second.processing.Percentile(0.5);
+        stats.nTimeP99 = p.second.processing.Percentile(0.99);
+        stats.nCPUTimeTotal = p.second.nCPUTimeTotal;
+        stats.nWaitTotal = p.second.wait.nTotal;
+        stats.nWaitP99 = p.second.wait.Percentile(0.99);
+        vStats.push_back(stats);
+    }
+    return vStats;
+}
+
+void ResetMessageProcessingStats()
+{
+    LOCK(cs_messageTimes);
+    mapMessageTimes.clear();
+}
+
 // All of the following cache a recent block, and are protected by cs_most_recent_block
 static CCriticalSection cs_most_recent_block;
 static std::shared_ptr<const CBlock> most_recent_block;
@@ -873,8 +1176,10 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
         most_recent_compact_block = pcmpctblock;
     }
 
-    connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker, &hashBlock](CNode* pnode) {
-        // TODO: Avoid the repeated-serialization here
+    // Serialized on first use and shared by all peers we announce to
+    CSharedNetMsg cmpctblockMsg;
+
+    connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker, &hashBlock, &cmpctblockMsg](CNode* pnode) {
         if (pnode->fDisconnect)
             return;
         ProcessBlockAvailability(pnode->GetId());
@@ -886,7 +1191,9 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
 
             LogPrint("net", "%s sending header-and-ids %s to peer=%d\n", "PeerLogicValidation::NewPoWValidBlock",
                     hashBlock.ToString(), pnode->id);
-            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+            if (!cmpctblockMsg.header)
+                cmpctblockMsg = CConnman::ShareMessage(msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+            connman->PushMessage(pnode, cmpctblockMsg);
             state.pindexBestHeaderSent = pindex;
         }
     });
@@ -993,7 +1300,7 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
                    mempool.exists(inv.hash) ||
                    pcoinsTip->HaveCoinInCache(COutPoint(inv.hash, 0)) || // Best effort: only try output 0 and 1
                    pcoinsTip->HaveCoinInCache(COutPoint(inv.hash, 1)) ||
-                   (fTxIndex && pblocktree->HasTxIndex(inv.hash));
+                   (fTxIndex && ptxindexdb->HasTxIndex(inv.hash));
         }
     case MSG_BLOCK:
         return mapBlockIndex.count(inv.hash);
@@ -1138,8 +1445,13 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
     if (send && (mi->second->nStatus & BLOCK_HAVE_DATA))
     {
         std::shared_ptr<const CBlock> pblock;
+        std::vector<unsigned char> vchRawBlock;
         if (a_recent_block && a_recent_block->GetHash() == (*mi).second->GetBlockHash()) {
             pblock = a_recent_block;
+        } else if (inv.type == MSG_BLOCK) {
+            // Plain blocks are sent just like they are stored, without decoding them first
+            if (!ReadRawBlockFromDisk(vchRawBlock, (*mi).second, Params().MessageStart()))
+                assert(!"cannot load block from disk");
         } else {
             // Send block from disk
             std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
@@ -1147,8 +1459,16 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
                 assert(!"cannot load block from disk");
             pblock = pblockRead;
         }
-        if (inv.type == MSG_BLOCK)
-            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
+        if (inv.type == MSG_BLOCK) {
+            if (pblock) {
+                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
+            } else {
+                CSerializedNetMsg msg;
+                msg.command = NetMsgType::BLOCK;
+                msg.data.swap(vchRawBlock);
+                connman.PushMessage(pfrom, std::move(msg));
+            }
+        }
         else if (inv.type == MSG_FILTERED_BLOCK)
         {
             bool sendMerkleBlock = false;
@@ -1284,21 +1604,20 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
 
             if (!push && inv.type == MSG_GOVERNANCE_OBJECT) {
                 LogPrint("net", "ProcessGetData -- MSG_GOVERNANCE_OBJECT: inv = %s\n", inv.ToString());
-                CDataStream ss(SER_NETWORK, pfrom->GetSendVersion());
                 bool topush = false;
-                {
-                    if(governance.HaveObjectForHash(inv.hash)) {
+                // Objects can be deleted, so only serve them from the cache while we still have them
+                if(governance.HaveObjectForHash(inv.hash)) {
+                    topush = PushRecentRelayMessage(pfrom, connman, inv, [&](const CNetMsgMaker& maker, CSerializedNetMsg& msg) {
+                        CDataStream ss(SER_NETWORK, pfrom->GetSendVersion());
                         ss.reserve(1000);
-                        if(governance.SerializeObjectForHash(inv.hash, ss)) {
-                            topush = true;
-                        }
-                    }
+                        if(!governance.SerializeObjectForHash(inv.hash, ss))
+                            return false;
+                        msg = maker.Make(NetMsgType::MNGOVERNANCEOBJECT, ss);
+                        return true;
+                    });
                 }
                 LogPrint("net", "ProcessGetData -- MSG_GOVERNANCE_OBJECT: topush = %d, inv = %s\n", topush, inv.ToString());
-                if(topush) {
-                    connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNGOVERNANCEOBJECT, ss));
-                    push = true;
-                }
+                push = topush;
             }
 
             if (!push && inv.type == MSG_GOVERNANCE_OBJECT_VOTE) {
@@ -1364,19 +1683,23 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
             }
 
             if (!push && (inv.type == MSG_CLSIG)) {
-                llmq::CChainLockSig o;
-                if (llmq::chainLocksHandler->GetChainLockByHash(inv.hash, o)) {
-                    connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CLSIG, o));
-                    push = true;
-                }
+                push = PushRecentRelayMessage(pfrom, connman, inv, [&](const CNetMsgMaker& maker, CSerializedNetMsg& msg) {
+                    llmq::CChainLockSig o;
+                    if (!llmq::chainLocksHandler->GetChainLockByHash(inv.hash, o))
+                        return false;
+                    msg = maker.Make(NetMsgType::CLSIG, o);
+                    return true;
+                });
             }
 
             if (!push && (inv.type == MSG_ISLOCK)) {
-                llmq::CInstantSendLock o;
-                if (llmq::quorumInstantSendManager->GetInstantSendLockByHash(inv.hash, o)) {
-                    connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::ISLOCK, o));
-                    push = true;
-                }
+                push = PushRecentRelayMessage(pfrom, connman, inv, [&](const CNetMsgMaker& maker, CSerializedNetMsg& msg) {
+                    llmq::CInstantSendLock o;
+                    if (!llmq::quorumInstantSendManager->GetInstantSendLockByHash(inv.hash, o))
+                        return false;
+                    msg = maker.Make(NetMsgType::ISLOCK, o);
+                    return true;
+                });
             }
 
             if (!push)
@@ -1425,6 +1748,22 @@ inline void static SendBlockTransactions(const CBlock& block, const BlockTransac
     connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCKTXN, resp));
 }
 
+// requires LOCK(pnode->cs_inventory)
+static void SetTxReconciliationKeys(CNode* pnode, uint64_t nRemoteSalt)
+{
+    // Both sides end up with the same keys, whoever's salt is which
+    uint64_t nSalt1 = std::min(pnode->nTxReconSalt, nRemoteSalt);
+    uint64_t nSalt2 = std::max(pnode->nTxReconSalt, nRemoteSalt);
+    uint256 hash = (CHashWriter(SER_GETHASH, 0) << std::string("EPMCoin tx reconciliation") << nSalt1 << nSalt2).GetHash();
+    pnode->nTxReconK0 = hash.GetUint64(0);
+    pnode->nTxReconK1 = hash.GetUint64(1);
+}
+
+static uint32_t GetTxReconciliationShortId(uint64_t k0, uint64_t k1, const uint256& txid)
+{
+    return (uint32_t)SipHashUint256(k0, k1, txid);
+}
+
 bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman& connman, const std::atomic<bool>& interruptMsgProc)
 {
     LogPrint("net", "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->id);
@@ -1726,6 +2065,24 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::QWATCH));
         }
 
+        if (!pfrom->fInbound && !pfrom->fMasternode && !pfrom->fFeeler && !pfrom->fOneShot && fRelayTxes &&
+                GetBoolArg("-txreconciliation", DEFAULT_TXRECONCILIATION)) {
+            // Keep announcing everything with INVs to a few outbound peers, so transactions
+            // still spread quickly, and offer short-id announcements to the others
+            int nFloodPeers = 0;
+            connman.ForEachNode([&nFloodPeers](CNode* pnode) {
+                LOCK(pnode->cs_inventory);
+                if (!pnode->fInbound && !pnode->fMasternode && pnode->fSuccessfullyConnected && !pnode->fTxReconSent)
+                    nFloodPeers++;
+            });
+            if (nFloodPeers >= TXRECONCILIATION_FLOOD_PEERS) {
+                LOCK(pfrom->cs_inventory);
+                pfrom->nTxReconSalt = GetRand(std::numeric_limits<uint64_t>::max());
+                pfrom->fTxReconSent = true;
+                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDTXRCNCL, TXRECONCILIATION_VERSION, pfrom->nTxReconSalt));
+            }
+        }
+
         pfrom->fSuccessfullyConnected = true;
     }
 
@@ -1804,6 +2161,110 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     }
 
 
+    else if (strCommand == NetMsgType::SENDTXRCNCL)
+    {
+        uint32_t nReconVersion;
+        uint64_t nRemoteSalt;
+        vRecv >> nReconVersion >> nRemoteSalt;
+        // Versions are backwards compatible, a higher one means the peer also speaks ours
+        if (nReconVersion < TXRECONCILIATION_VERSION)
+            return true;
+
+        LOCK(pfrom->cs_inventory);
+        if (pfrom->fTxRecon)
+            return true;
+        if (!pfrom->fTxReconSent) {
+            // Only the side which opened the connection offers it, we just agree if we want it too
+            if (!pfrom->fInbound || !fRelayTxes || !GetBoolArg("-txreconciliation", DEFAULT_TXRECONCILIATION))
+                return true;
+            pfrom->nTxReconSalt = GetRand(std::numeric_limits<uint64_t>::max());
+            pfrom->fTxReconSent = true;
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDTXRCNCL, TXRECONCILIATION_VERSION, pfrom->nTxReconSalt));
+        }
+        SetTxReconciliationKeys(pfrom, nRemoteSalt);
+        pfrom->fTxRecon = true;
+        LogPrint("net", "using short-id transaction announcements with peer=%d\n", pfrom->id);
+    }
+
+
+    else if (strCommand == NetMsgType::TXRCNCLINV)
+    {
+        std::vector<uint32_t> vShortIds;
+        vRecv >> vShortIds;
+        if (vShortIds.size() > MAX_INV_SZ)
+        {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 20);
+            return error("message txrcnclinv size() = %u", vShortIds.size());
+        }
+
+        uint64_t k0, k1;
+        {
+            LOCK(pfrom->cs_inventory);
+            if (!pfrom->fTxRecon) {
+                LogPrint("net", "txrcnclinv without negotiation from peer=%d\n", pfrom->id);
+                return true;
+            }
+            k0 = pfrom->nTxReconK0;
+            k1 = pfrom->nTxReconK1;
+        }
+
+        // Same rules as for transaction INVs
+        bool fBlocksOnly = !fRelayTxes && !pfrom->fWhitelisted;
+        if (fBlocksOnly || fImporting || fReindex || IsInitialBlockDownload())
+            return true;
+
+        // Match the short ids against what we have. Those we know don't have to be announced
+        // to us in full, and we won't announce them back either.
+        std::vector<uint256> vHave;
+        mempool.queryHashes(vHave);
+        std::unordered_map<uint32_t, uint256> mapHave;
+        mapHave.reserve(vHave.size());
+        for (const uint256& hash : vHave)
+            mapHave.emplace(GetTxReconciliationShortId(k0, k1, hash), hash);
+
+        std::vector<uint32_t> vRequest;
+        {
+            LOCK(pfrom->cs_inventory);
+            for (uint32_t nShortId : vShortIds) {
+                auto it = mapHave.find(nShortId);
+                if (it != mapHave.end())
+                    pfrom->filterInventoryKnown.insert(it->second);
+                else
+                    vRequest.push_back(nShortId);
+            }
+        }
+        if (!vRequest.empty())
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::TXRCNCLREQ, vRequest));
+    }
+
+
+    else if (strCommand == NetMsgType::TXRCNCLREQ)
+    {
+        std::vector<uint32_t> vShortIds;
+        vRecv >> vShortIds;
+        if (vShortIds.size() > MAX_INV_SZ)
+        {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 20);
+            return error("message txrcnclreq size() = %u", vShortIds.size());
+        }
+
+        // Answer with the full txids, the peer then asks for what it still misses with GETDATA
+        std::vector<CInv> vInv;
+        {
+            LOCK(pfrom->cs_inventory);
+            for (uint32_t nShortId : vShortIds) {
+                auto it = pfrom->mapTxReconAnnounced.find(nShortId);
+                if (it != pfrom->mapTxReconAnnounced.end())
+                    vInv.push_back(CInv(MSG_TX, it->second));
+            }
+        }
+        if (!vInv.empty())
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::INV, vInv));
+    }
+
+
     else if (strCommand == NetMsgType::SENDDSQUEUE)
     {
         bool b;
@@ -2130,8 +2591,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return true;
         }
 
-        std::deque<COutPoint> vWorkQueue;
-        std::vector<uint256> vEraseQueue;
+        std::deque<uint256> vWorkQueue;
+        std::unordered_set<uint256, StaticSaltedHasher> setEraseQueue;
         CTransactionRef ptx;
         CTxLockRequest txLockRequest;
         CPrivateSendBroadcastTx dstx;
@@ -2147,8 +2608,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             vRecv >> txLockRequest;
             ptx = txLockRequest.tx;
             nInvType = MSG_TXLOCK_REQUEST;
-            if (llmq::IsNewInstantSendEnabled()) {
-                // the new system does not require explicit lock requests
+            if (llmq::IsNewInstantSendEnabled() || instantsend.IsRetired()) {
+                // the new system does not require explicit lock requests and the legacy one is retired
                 // changing the inv type to MSG_TX also results in re-broadcasting the TX as normal TX
                 nInvType = MSG_TX;
             }
@@ -2228,9 +2689,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
             mempool.check(pcoinsTip);
             connman.RelayTransaction(tx);
-            for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                vWorkQueue.emplace_back(inv.hash, i);
-            }
+            vWorkQueue.push_back(inv.hash);
 
             pfrom->nLastTXTime = GetTime();
 
@@ -2239,21 +2698,21 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 tx.GetHash().ToString(),
                 mempool.size(), mempool.DynamicMemoryUsage() / 1000);
 
-            // Recursively process any orphan transactions that depended on this one
+            // Recursively process any orphan transactions that depended on this one. The children of
+            // every accepted parent are looked up at once, and each of them is tried once per parent
+            // until it is accepted or dropped.
             std::set<NodeId> setMisbehaving;
             while (!vWorkQueue.empty()) {
-                auto itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue.front());
+                auto itByParent = mapOrphanTransactionsByParent.find(vWorkQueue.front());
                 vWorkQueue.pop_front();
-                if (itByPrev == mapOrphanTransactionsByPrev.end())
+                if (itByParent == mapOrphanTransactionsByParent.end())
                     continue;
-                for (auto mi = itByPrev->second.begin();
-                     mi != itByPrev->second.end();
-                     ++mi)
+                for (const COrphanTx* porphan : itByParent->second)
                 {
-                    const CTransactionRef& porphanTx = (*mi)->second.tx;
+                    const CTransactionRef& porphanTx = porphan->tx;
                     const CTransaction& orphanTx = *porphanTx;
                     const uint256& orphanHash = orphanTx.GetHash();
-                    NodeId fromPeer = (*mi)->second.fromPeer;
+                    NodeId fromPeer = porphan->fromPeer;
                     bool fMissingInputs2 = false;
                     // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
                     // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
@@ -2261,15 +2720,13 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                     CValidationState stateDummy;
 
 
-                    if (setMisbehaving.count(fromPeer))
+                    if (setMisbehaving.count(fromPeer) || setEraseQueue.count(orphanHash))
                         continue;
                     if (AcceptToMemoryPool(mempool, stateDummy, porphanTx, true, &fMissingInputs2)) {
                         LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
                         connman.RelayTransaction(orphanTx);
-                        for (unsigned int i = 0; i < orphanTx.vout.size(); i++) {
-                            vWorkQueue.emplace_back(orphanHash, i);
-                        }
-                        vEraseQueue.push_back(orphanHash);
+                        vWorkQueue.push_back(orphanHash);
+                        setEraseQueue.insert(orphanHash);
                     }
                     else if (!fMissingInputs2)
                     {
@@ -2284,7 +2741,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                         // Has inputs but not accepted to mempool
                         // Probably non-standard or insufficient fee
                         LogPrint("mempool", "   removed orphan tx %s\n", orphanHash.ToString());
-                        vEraseQueue.push_back(orphanHash);
+                        setEraseQueue.insert(orphanHash);
                         if (!stateDummy.CorruptionPossible()) {
                             assert(recentRejects);
                             recentRejects->insert(orphanHash);
@@ -2294,7 +2751,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 }
             }
 
-            BOOST_FOREACH(uint256 hash, vEraseQueue)
+            BOOST_FOREACH(const uint256& hash, setEraseQueue)
                 EraseOrphanTx(hash);
         }
         else if (fMissingInputs)
@@ -2314,9 +2771,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 }
                 AddOrphanTx(ptx, pfrom->GetId());
 
-                // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
+                // DoS prevention: do not allow mapOrphanTransactions to grow unbounded, nor one peer to fill it
                 unsigned int nMaxOrphanTxSize = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantxsize", DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE)) * 1000000;
-                unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTxSize);
+                unsigned int nEvicted = LimitOrphanTxSizeForPeer(pfrom->GetId(), nMaxOrphanTxSize / ORPHAN_TX_PEER_SHARE);
+                nEvicted += LimitOrphanTxSize(nMaxOrphanTxSize);
                 if (nEvicted > 0)
                     LogPrint("mempool", "mapOrphan overflow, removed %u tx\n", nEvicted);
             } else {
@@ -2329,7 +2787,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             if (!state.CorruptionPossible()) {
                 assert(recentRejects);
                 recentRejects->insert(tx.GetHash());
-                if (RecursiveDynamicUsage(*ptx) < 100000) {
+                if (IsInstantSendLocked(ptx->GetHash())) {
+                    AddToCompactLockedTransactions(ptx);
+                } else if (RecursiveDynamicUsage(*ptx) < 100000) {
                     AddToCompactExtraTransactions(ptx);
                 }
             }
@@ -2488,7 +2948,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 }
 
                 PartiallyDownloadedBlock& partialBlock = *(*queuedBlockIt)->partialBlock;
-                ReadStatus status = partialBlock.InitData(cmpctblock, vExtraTxnForCompact);
+                ReadStatus status = partialBlock.InitData(cmpctblock, GetCompactExtraTransactions());
                 if (status == READ_STATUS_INVALID) {
                     MarkBlockAsReceived(pindex->GetBlockHash()); // Reset in-flight state in case of whitelist
                     Misbehaving(pfrom->GetId(), 100);
@@ -2496,6 +2956,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                     return true;
                 } else if (status == READ_STATUS_FAILED) {
                     // Duplicate txindexes, the block is now in-flight, so just request it
+                    nodestate->nCmpctBlocksFailed++;
                     std::vector<CInv> vInv(1);
                     vInv[0] = CInv(MSG_BLOCK, cmpctblock.header.GetHash());
                     connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETDATA, vInv));
@@ -2507,13 +2968,17 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                     if (!partialBlock.IsTxAvailable(i))
                         req.indexes.push_back(i);
                 }
+                nodestate->nCmpctTxnHit += partialBlock.GetMempoolCount();
+                nodestate->nCmpctTxnMiss += req.indexes.size();
                 if (req.indexes.empty()) {
+                    nodestate->nCmpctBlocksReconstructed++;
                     // Dirty hack to jump to BLOCKTXN code (TODO: move message handling into their own functions)
                     BlockTransactions txn;
                     txn.blockhash = cmpctblock.header.GetHash();
                     blockTxnMsg << txn;
                     fProcessBLOCKTXN = true;
                 } else {
+                    nodestate->nCmpctBlocksRoundTrip++;
                     req.blockhash = pindex->GetBlockHash();
                     connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETBLOCKTXN, req));
                 }
@@ -2524,7 +2989,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 // Optimistically try to reconstruct anyway since we might be
                 // able to without any round trips.
                 PartiallyDownloadedBlock tempBlock(&mempool);
-                ReadStatus status = tempBlock.InitData(cmpctblock, vExtraTxnForCompact);
+                ReadStatus status = tempBlock.InitData(cmpctblock, GetCompactExtraTransactions());
                 if (status != READ_STATUS_OK) {
                     // TODO: don't ignore failures
                     return true;
@@ -2532,6 +2997,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 std::vector<CTransactionRef> dummy;
                 status = tempBlock.FillBlock(*pblock, dummy);
                 if (status == READ_STATUS_OK) {
+                    nodestate->nCmpctBlocksReconstructed++;
                     fBlockReconstructed = true;
                 }
             }
@@ -2606,6 +3072,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 return true;
             } else if (status == READ_STATUS_FAILED) {
                 // Might have collided, fall back to getdata now :(
+                State(pfrom->GetId())->nCmpctBlocksFailed++;
                 std::vector<CInv> invs;
                 invs.push_back(CInv(MSG_BLOCK, resp.blockhash));
                 connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETDATA, invs));
@@ -2668,6 +3135,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             vRecv >> headers[n];
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
+        // Hash them all up front and before taking cs_main, validation reuses the cached hashes
+        CheckBlockHeadersContextFree(headers);
 
         if (nCount == 0) {
             // Nothing interesting. Stop asking this peers for more headers.
@@ -2774,7 +3243,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 std::vector<CInv> vGetData;
                 // Download as much as possible, from earliest to latest.
                 BOOST_REVERSE_FOREACH(const CBlockIndex *pindex, vToFetch) {
-                    if (nodestate->nBlocksInFlight >= MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+                    if (nodestate->nBlocksInFlight >= nodestate->nBlocksInFlightLimit) {
                         // Can't download any more from this peer
                         break;
                     }
@@ -2816,6 +3285,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             LOCK(cs_main);
             // Also always process if we requested the block explicitly, as we may
             // need it even though it is not a candidate for a new best tip.
+            UpdateBlockDownloadTime(pfrom->GetId(), hash);
             forceProcessing |= MarkBlockAsReceived(hash);
             // mapBlockSource is only used for sending reject messages and DoS scores,
             // so the race between here and cs_main in ProcessNewBlock is fine.
@@ -3055,10 +3525,15 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         LOCK(cs_main);
 
-        CSimplifiedMNListDiff mnListDiff;
+        CCachedSimplifiedMNListDiffCPtr mnListDiff;
         std::string strError;
-        if (BuildSimplifiedMNListDiff(cmd.baseBlockHash, cmd.blockHash, mnListDiff, strError)) {
-            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNLISTDIFF, mnListDiff));
+        if (GetSimplifiedMNListDiff(cmd.baseBlockHash, cmd.blockHash, mnListDiff, strError)) {
+            if (pfrom->GetSendVersion() >= LLMQS_PROTO_VERSION) {
+                // same bytes as serializing the diff for this peer, only done once for all of them
+                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNLISTDIFF, MakeSpan(mnListDiff->vchData)));
+            } else {
+                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNLISTDIFF, mnListDiff->diff));
+            }
         } else {
             LogPrint("net", "getmnlistdiff failed for baseBlockHash=%s, blockHash=%s. error=%s\n", cmd.baseBlockHash.ToString(), cmd.blockHash.ToString(), strError);
             Misbehaving(pfrom->id, 1);
@@ -3079,6 +3554,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         // message would be undesirable as we transmit it ourselves.
     }
 
+    else if (strCommand == NetMsgType::TXLOCKVOTE && instantsend.IsRetired()) {
+        // Legacy InstantSend is retired, so don't even deserialize and dispatch its votes
+    }
+
     else {
         bool found = false;
         const std::vector<std::string> &allMessages = getAllNetMessageTypes();
@@ -3175,6 +3654,12 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, const std::atomic<bool>& i
             return false;
 
         std::list<CNetMessage> msgs;
+        // Hand the message's storage back to pfrom on every way out, so receiving the next one doesn't allocate
+        struct RecycleOnExit {
+            CNode* pnode;
+            std::list<CNetMessage>& msgs;
+            ~RecycleOnExit() { pnode->RecycleMessages(msgs); }
+        } recycleOnExit{pfrom, msgs};
         {
             LOCK(pfrom->cs_vProcessMsg);
             if (pfrom->vProcessMsg.empty())
@@ -3221,6 +3706,8 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, const std::atomic<bool>& i
 
         // Process message
         bool fRet = false;
+        int64_t nTimeStart = GetTimeMicros();
+        int64_t nCPUTimeStart = GetThreadCPUTimeMicros();
         try
         {
             fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, chainparams, connman, interruptMsgProc);
@@ -3254,6 +3741,9 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, const std::atomic<bool>& i
         } catch (...) {
             PrintExceptionContinue(std::current_exception(), "ProcessMessages()");
         }
+        int64_t nProcessTime = GetTimeMicros() - nTimeStart;
+        RecordMessageTimes(strCommand, nTimeStart - msg.nTime, nProcessTime, GetThreadCPUTimeMicros() - nCPUTimeStart);
+        TRACE5(net, inbound_message, pfrom->id, strCommand.c_str(), nMessageSize, nTimeStart - msg.nTime, nProcessTime);
 
         if (!fRet) {
             LogPrintf("%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize, pfrom->id);
@@ -3265,23 +3755,6 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, const std::atomic<bool>& i
     return fMoreWork;
 }
 
-class CompareInvMempoolOrder
-{
-    CTxMemPool *mp;
-public:
-    CompareInvMempoolOrder(CTxMemPool *_mempool)
-    {
-        mp = _mempool;
-    }
-
-    bool operator()(std::set<uint256>::iterator a, std::set<uint256>::iterator b)
-    {
-        /* As std::make_heap produces a max-heap, we want the entries with the
-         * fewest ancestors/highest fee to sort later. */
-        return mp->CompareDepthAndScore(*b, *a);
-    }
-};
-
 bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interruptMsgProc)
 {
     const Consensus::Params& consensusParams = Params().GetConsensus();
@@ -3574,7 +4047,7 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
             // Time to send but the peer has requested we not relay transactions.
             if (fSendTrickle) {
                 LOCK(pto->cs_filter);
-                if (!pto->fRelayTxes) pto->setInventoryTxToSend.clear();
+                if (!pto->fRelayTxes) pto->txInventoryToSend.Clear();
             }
 
             // Respond to BIP35 mempool requests
@@ -3587,7 +4060,7 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
                 for (const auto& txinfo : vtxinfo) {
                     const uint256& hash = txinfo.tx->GetHash();
                     CInv inv(MSG_TX, hash);
-                    pto->setInventoryTxToSend.erase(hash);
+                    pto->txInventoryToSend.Erase(hash);
                     if (pto->pfilter) {
                         if (!pto->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
                     }
@@ -3605,29 +4078,34 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
             }
 
             // Determine transactions to relay
+            std::vector<uint32_t> vReconInv;
             if (fSendTrickle) {
-                // Produce a vector with all candidates for sending
-                std::vector<std::set<uint256>::iterator> vInvTx;
-                vInvTx.reserve(pto->setInventoryTxToSend.size());
-                for (std::set<uint256>::iterator it = pto->setInventoryTxToSend.begin(); it != pto->setInventoryTxToSend.end(); it++) {
-                    vInvTx.push_back(it);
+                // Forget short ids the peer had its chance to ask for
+                while (!pto->vTxReconAnnouncedExpiry.empty() && pto->vTxReconAnnouncedExpiry.front().first < nNow) {
+                    pto->mapTxReconAnnounced.erase(pto->vTxReconAnnouncedExpiry.front().second);
+                    pto->vTxReconAnnouncedExpiry.pop_front();
                 }
+
                 // Topologically and fee-rate sort the inventory we send for privacy and priority reasons.
-                // A heap is used so that not all items need sorting if only a few are being sent.
-                CompareInvMempoolOrder compareInvMempoolOrder(&mempool);
-                std::make_heap(vInvTx.begin(), vInvTx.end(), compareInvMempoolOrder);
+                // Only what was queued since the last trickle needs a lookup, the rest stays sorted.
+                {
+                    LOCK(mempool.cs);
+                    pto->txInventoryToSend.Prioritize([](const uint256& hash, CTxAnnounceQueue::Priority& priority) {
+                        auto it = mempool.mapTx.find(hash);
+                        if (it == mempool.mapTx.end()) {
+                            return false;
+                        }
+                        priority.nAncestors = it->GetCountWithAncestors();
+                        priority.nFeePerK = it->GetModifiedFee() * 1000 / std::max<int64_t>(1, it->GetTxSize());
+                        return true;
+                    });
+                }
                 // No reason to drain out at many times the network's capacity,
                 // especially since we have many peers and some will draw much shorter delays.
                 unsigned int nRelayedTransactions = 0;
+                uint256 hash;
                 LOCK(pto->cs_filter);
-                while (!vInvTx.empty() && nRelayedTransactions < INVENTORY_BROADCAST_MAX_PER_1MB_BLOCK * MaxBlockSize(true) / 1000000) {
-                    // Fetch the top element from the heap
-                    std::pop_heap(vInvTx.begin(), vInvTx.end(), compareInvMempoolOrder);
-                    std::set<uint256>::iterator it = vInvTx.back();
-                    vInvTx.pop_back();
-                    uint256 hash = *it;
-                    // Remove it from the to-be-sent set
-                    pto->setInventoryTxToSend.erase(it);
+                while (nRelayedTransactions < INVENTORY_BROADCAST_MAX_PER_1MB_BLOCK * MaxBlockSize(true) / 1000000 && pto->txInventoryToSend.Pop(hash)) {
                     // Check if not in the filter already
                     if (pto->filterInventoryKnown.contains(hash)) {
                         continue;
@@ -3639,7 +4117,14 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
                     }
                     if (pto->pfilter && !pto->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
                     // Send
-                    vInv.push_back(CInv(MSG_TX, hash));
+                    if (pto->fTxRecon) {
+                        uint32_t nShortId = GetTxReconciliationShortId(pto->nTxReconK0, pto->nTxReconK1, hash);
+                        pto->mapTxReconAnnounced[nShortId] = hash;
+                        pto->vTxReconAnnouncedExpiry.emplace_back(nNow + TXRECONCILIATION_REQUEST_TIMEOUT * 1000000, nShortId);
+                        vReconInv.push_back(nShortId);
+                    } else {
+                        vInv.push_back(CInv(MSG_TX, hash));
+                    }
                     nRelayedTransactions++;
                     {
                         // Expire old relay messages
@@ -3661,6 +4146,8 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
                     pto->filterInventoryKnown.insert(hash);
                 }
             }
+            if (!vReconInv.empty())
+                connman.PushMessage(pto, msgMaker.Make(NetMsgType::TXRCNCLINV, vReconInv));
 
             // Send non-tx/non-block inventory items
             for (const auto& inv : pto->vInventoryOtherToSend) {
@@ -3741,17 +4228,26 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (!pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        state.nBlocksInFlightLimit = GetBlocksInFlightLimit(pto, state);
+        if (!pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < state.nBlocksInFlightLimit) {
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            const CBlockIndex* pindexStalling = NULL;
+            FindNextBlocksToDownload(pto->GetId(), state.nBlocksInFlightLimit - state.nBlocksInFlight, vToDownload, staller, pindexStalling, consensusParams);
             BOOST_FOREACH(const CBlockIndex *pindex, vToDownload) {
                 vGetData.push_back(CInv(MSG_BLOCK, pindex->GetBlockHash()));
                 MarkBlockAsInFlight(pto->GetId(), pindex->GetBlockHash(), consensusParams, pindex);
                 LogPrint("net", "Requesting block %s (%d) peer=%d\n", pindex->GetBlockHash().ToString(),
                     pindex->nHeight, pto->id);
             }
-            if (state.nBlocksInFlight == 0 && staller != -1) {
+            if (staller != -1 && pindexStalling != NULL && IsFasterBlockSource(state, *State(staller))) {
+                // Rather than waiting for the stall timeout, take the block which holds up the window
+                // over. This also ends the stall of the slow peer, which keeps its other blocks.
+                LogPrint("net", "Requesting stalling block %s (%d) peer=%d instead of peer=%d\n", pindexStalling->GetBlockHash().ToString(),
+                    pindexStalling->nHeight, pto->id, staller);
+                vGetData.push_back(CInv(MSG_BLOCK, pindexStalling->GetBlockHash()));
+                MarkBlockAsInFlight(pto->GetId(), pindexStalling->GetBlockHash(), consensusParams, pindexStalling);
+            } else if (state.nBlocksInFlight == 0 && staller != -1) {
                 if (State(staller)->nStallingSince == 0) {
                     State(staller)->nStallingSince = nNow;
                     LogPrint("net", "Stall started peer=%d\n", staller);
@@ -3801,7 +4297,9 @@ public:
     ~CNetProcessingCleanup() {
         // orphan transactions
         mapOrphanTransactions.clear();
-        mapOrphanTransactionsByPrev.clear();
+        mapOrphanTransactionsByParent.clear();
+        vOrphanList.clear();
+        mapOrphanPeers.clear();
         nMapOrphanTransactionsSize = 0;
     }
 } instance_of_cnetprocessingcleanup;
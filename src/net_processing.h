@@ -6,6 +6,7 @@
 #ifndef BITCOIN_NET_PROCESSING_H
 #define BITCOIN_NET_PROCESSING_H
 
+#include "memusage.h"
 #include "net.h"
 #include "validationinterface.h"
 
@@ -15,6 +16,8 @@ static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE = 10; // this all
 static const int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
 /** Minimum time between orphan transactions expire time checks in seconds */
 static const int64_t ORPHAN_TX_EXPIRE_INTERVAL = 5 * 60;
+/** The orphans of one peer may take up 1/ORPHAN_TX_PEER_SHARE of -maxorphantxsize before its own are evicted */
+static const unsigned int ORPHAN_TX_PEER_SHARE = 4;
 
 /** Headers download timeout expressed in microseconds
  *  Timeout = base + per_header * (expected number of headers) */
@@ -23,6 +26,14 @@ static constexpr int64_t HEADERS_DOWNLOAD_TIMEOUT_PER_HEADER = 1000; // 1ms/head
 
 /** Default number of orphan+recently-replaced txn to keep around for block reconstruction */
 static const unsigned int DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN = 100;
+/** Default for -txreconciliation, announcing transactions to outbound peers by short id */
+static const bool DEFAULT_TXRECONCILIATION = false;
+/** Version of the short-id announcement protocol we speak in SENDTXRCNCL */
+static const uint32_t TXRECONCILIATION_VERSION = 1;
+/** Outbound peers which keep getting every transaction announced with INVs */
+static const int TXRECONCILIATION_FLOOD_PEERS = 2;
+/** How long (in seconds) short ids we announced can be asked for */
+static const int64_t TXRECONCILIATION_REQUEST_TIMEOUT = 2 * 60;
 
 /** Register with a network node to receive its signals */
 void RegisterNodeSignals(CNodeSignals& nodeSignals);
@@ -35,6 +46,7 @@ private:
 
 public:
     PeerLogicValidation(CConnman* connmanIn);
+    ~PeerLogicValidation();
 
     virtual void SyncTransaction(const CTransaction& tx, const CBlockIndex* pindex, int nPosInBlock) override;
     virtual void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
@@ -47,10 +59,54 @@ struct CNodeStateStats {
     int nSyncHeight;
     int nCommonHeight;
     std::vector<int> vHeightInFlight;
+    int nBlocksInFlightLimit;
+    int64_t nAvgBlockTime;
+    uint64_t nCmpctBlocksReconstructed;
+    uint64_t nCmpctBlocksRoundTrip;
+    uint64_t nCmpctBlocksFailed;
+    uint64_t nCmpctTxnHit;
+    uint64_t nCmpctTxnMiss;
 };
 
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
+/** Hits and misses of the serialize-once cache for relayed ISLOCKs, CLSIGs and governance objects */
+void GetRelayCacheStats(uint64_t& nHitsRet, uint64_t& nMissesRet, size_t& nEntriesRet);
+/** Estimated heap usage of the orphan transactions and their indexes */
+memusage::SubsystemUsage GetOrphanMemoryUsage();
+/** Time spent processing one message type, all times in microseconds */
+struct CMessageProcessingStats {
+    std::string strCommand;
+    uint64_t nCount;
+    int64_t nTimeTotal;
+    int64_t nTimeMax;
+    //! Percentiles are the upper bounds of power of two buckets
+    int64_t nTimeP50;
+    int64_t nTimeP99;
+    int64_t nCPUTimeTotal;
+    //! From receipt of the message until its processing started
+    int64_t nWaitTotal;
+    int64_t nWaitP99;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(strCommand);
+        READWRITE(nCount);
+        READWRITE(nTimeTotal);
+        READWRITE(nTimeMax);
+        READWRITE(nTimeP50);
+        READWRITE(nTimeP99);
+        READWRITE(nCPUTimeTotal);
+        READWRITE(nWaitTotal);
+        READWRITE(nWaitP99);
+    }
+};
+
+/** Processing statistics for every message type seen since startup or the last reset */
+std::vector<CMessageProcessingStats> GetMessageProcessingStats();
+void ResetMessageProcessingStats();
 /** Increase a node's misbehavior score. */
 void Misbehaving(NodeId nodeid, int howmuch);
 bool IsBanned(NodeId nodeid);
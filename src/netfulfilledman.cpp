@@ -11,69 +11,53 @@
 
 CNetFulfilledRequestManager netfulfilledman;
 
-void CNetFulfilledRequestManager::AddFulfilledRequest(const CService& addr, const std::string& strRequest)
+const std::string CNetFulfilledRequestManager::SERIALIZATION_VERSION_STRING = "CNetFulfilledRequestManager-Version-1";
+
+uint64_t CNetFulfilledRequestManager::GetRequestKey(const CService& addr, const std::string& strRequest) const
 {
-    LOCK(cs_mapFulfilledRequests);
-    CService addrSquashed = Params().AllowMultiplePorts() ? addr : CService(addr, 0);
-    mapFulfilledRequests[addrSquashed][strRequest] = GetTime() + Params().FulfilledRequestExpireTime();
+    CSipHasher hasher = fulfilledRequests.GetHasher();
+    unsigned char ip[16];
+    for (int i = 0; i < 16; i++) {
+        ip[i] = addr.GetByte(15 - i);
+    }
+    hasher.Write(ip, sizeof(ip));
+    // the port is only part of the node's identity if several nodes may share an IP
+    uint16_t nPort = Params().AllowMultiplePorts() ? addr.GetPort() : 0;
+    hasher.Write((const unsigned char*)&nPort, sizeof(nPort));
+    hasher.Write((const unsigned char*)strRequest.data(), strRequest.size());
+    return hasher.Finalize();
 }
 
-bool CNetFulfilledRequestManager::HasFulfilledRequest(const CService& addr, const std::string& strRequest)
+void CNetFulfilledRequestManager::AddFulfilledRequest(const CService& addr, const std::string& strRequest)
 {
-    LOCK(cs_mapFulfilledRequests);
-    CService addrSquashed = Params().AllowMultiplePorts() ? addr : CService(addr, 0);
-    fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(addrSquashed);
-
-    return  it != mapFulfilledRequests.end() &&
-            it->second.find(strRequest) != it->second.end() &&
-            it->second[strRequest] > GetTime();
+    LOCK(cs_fulfilledRequests);
+    fulfilledRequests.Add(GetRequestKey(addr, strRequest), GetTime(), Params().FulfilledRequestExpireTime());
 }
 
-void CNetFulfilledRequestManager::RemoveFulfilledRequest(const CService& addr, const std::string& strRequest)
+bool CNetFulfilledRequestManager::HasFulfilledRequest(const CService& addr, const std::string& strRequest)
 {
-    LOCK(cs_mapFulfilledRequests);
-    CService addrSquashed = Params().AllowMultiplePorts() ? addr : CService(addr, 0);
-    fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(addrSquashed);
-
-    if (it != mapFulfilledRequests.end()) {
-        it->second.erase(strRequest);
-    }
+    LOCK(cs_fulfilledRequests);
+    return fulfilledRequests.Count(GetRequestKey(addr, strRequest), GetTime()) != 0;
 }
 
 void CNetFulfilledRequestManager::CheckAndRemove()
 {
-    LOCK(cs_mapFulfilledRequests);
-
-    int64_t now = GetTime();
-    fulfilledreqmap_t::iterator it = mapFulfilledRequests.begin();
-
-    while(it != mapFulfilledRequests.end()) {
-        fulfilledreqmapentry_t::iterator it_entry = it->second.begin();
-        while(it_entry != it->second.end()) {
-            if(now > it_entry->second) {
-                it->second.erase(it_entry++);
-            } else {
-                ++it_entry;
-            }
-        }
-        if(it->second.size() == 0) {
-            mapFulfilledRequests.erase(it++);
-        } else {
-            ++it;
-        }
-    }
+    LOCK(cs_fulfilledRequests);
+    // expired requests are reused on the fly, this only gives back memory after a burst
+    fulfilledRequests.Compact(GetTime());
 }
 
 void CNetFulfilledRequestManager::Clear()
 {
-    LOCK(cs_mapFulfilledRequests);
-    mapFulfilledRequests.clear();
+    LOCK(cs_fulfilledRequests);
+    fulfilledRequests.Clear();
 }
 
 std::string CNetFulfilledRequestManager::ToString() const
 {
+    LOCK(cs_fulfilledRequests);
     std::ostringstream info;
-    info << "Nodes with fulfilled requests: " << (int)mapFulfilledRequests.size();
+    info << "Fulfilled requests: " << (int)fulfilledRequests.Size(GetTime());
     return info.str();
 }
 
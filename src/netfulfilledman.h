@@ -8,6 +8,7 @@
 #define NETFULFILLEDMAN_H
 
 #include "netaddress.h"
+#include "ratelimit.h"
 #include "serialize.h"
 #include "sync.h"
 
@@ -19,14 +20,13 @@ extern CNetFulfilledRequestManager netfulfilledman;
 class CNetFulfilledRequestManager
 {
 private:
-    typedef std::map<std::string, int64_t> fulfilledreqmapentry_t;
-    typedef std::map<CService, fulfilledreqmapentry_t> fulfilledreqmap_t;
+    static const std::string SERIALIZATION_VERSION_STRING;
 
-    //keep track of what node has/was asked for and when
-    fulfilledreqmap_t mapFulfilledRequests;
-    CCriticalSection cs_mapFulfilledRequests;
+    //keep track of what node has/was asked for and when, keyed by the hash of both
+    CWindowRateLimiter fulfilledRequests;
+    mutable CCriticalSection cs_fulfilledRequests;
 
-    void RemoveFulfilledRequest(const CService& addr, const std::string& strRequest);
+    uint64_t GetRequestKey(const CService& addr, const std::string& strRequest) const;
 
 public:
     CNetFulfilledRequestManager() {}
@@ -35,8 +35,18 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
-        LOCK(cs_mapFulfilledRequests);
-        READWRITE(mapFulfilledRequests);
+        LOCK(cs_fulfilledRequests);
+        std::string strVersion;
+        if(ser_action.ForRead()) {
+            READWRITE(strVersion);
+            if (strVersion != SERIALIZATION_VERSION_STRING) {
+                return;
+            }
+        } else {
+            strVersion = SERIALIZATION_VERSION_STRING;
+            READWRITE(strVersion);
+        }
+        READWRITE(fulfilledRequests);
     }
 
     void AddFulfilledRequest(const CService& addr, const std::string& strRequest);
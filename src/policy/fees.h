@@ -8,9 +8,10 @@
 #include "amount.h"
 #include "uint256.h"
 #include "random.h"
+#include "saltedhasher.h"
 
-#include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class CAutoFile;
@@ -71,8 +72,7 @@ class TxConfirmStats
 {
 private:
     //Define the buckets we will group transactions into
-    std::vector<double> buckets;              // The upper-bound of the range for the bucket (inclusive)
-    std::map<double, unsigned int> bucketMap; // Map of bucket upper-bound to index into all vectors by bucket
+    std::vector<double> buckets;              // The upper-bound of the range for the bucket (inclusive), sorted
 
     // For each bucket X:
     // Count the total # of txs in each bucket
@@ -84,7 +84,8 @@ private:
     // Count the total # of txs confirmed within Y blocks in each bucket
     // Track the historical moving average of theses totals over blocks
     std::vector<std::vector<double> > confAvg; // confAvg[Y][X]
-    // and calculate the totals for the current block to update the moving averages
+    // and count the txs confirmed in exactly Y blocks for the current block, which
+    // UpdateMovingAverages sums up into the "within Y blocks" totals
     std::vector<std::vector<int> > curBlockConf; // curBlockConf[Y][X]
 
     // Sum the total feerate of all tx's in each bucket
@@ -98,6 +99,15 @@ private:
 
     double decay;
 
+    // The moving averages above are stored divided by scale, the product of the decay of
+    // all blocks since the last Rescale. Decaying them all is a single multiplication of
+    // scale, and a block only has to touch the buckets it confirmed txs in. Anything reading
+    // the averages has to multiply them by scale.
+    double scale;
+
+    // Buckets with txs in the current block, the only ones with non-zero curBlock variables
+    std::vector<unsigned int> curBlockBuckets;
+
     // Mempool counts of outstanding transactions
     // For each bucket X, track the number of transactions in the mempool
     // that are unconfirmed for each possible confirmation value Y
@@ -105,6 +115,12 @@ private:
     // transactions still unconfirmed after MAX_CONFIRMS for each bucket
     std::vector<int> oldUnconfTxs;
 
+    /** Index of the bucket a feerate falls in */
+    unsigned int FindBucketIndex(double val) const;
+
+    /** Fold scale back into the stored moving averages */
+    void Rescale();
+
 public:
     /**
      * Initialize the data structures.  This is called by BlockPolicyEstimator's
@@ -172,6 +188,9 @@ static const unsigned int MAX_BLOCK_CONFIRMS = 25;
 /** Decay of .998 is a half-life of 346 blocks or about 14.4 hours */
 static const double DEFAULT_DECAY = .998;
 
+/** Rescale the lazily decayed moving averages once the accumulated decay drops below this */
+static const double MIN_DECAY_SCALE = 1e-100;
+
 /** Require greater than 95% of X feerate transactions to be confirmed within Y blocks for X to be big enough */
 static const double MIN_SUCCESS_PCT = .95;
 
@@ -244,7 +263,7 @@ private:
     };
 
     // map of txids to information about that transaction
-    std::map<uint256, TxStatsInfo> mapMemPoolTxs;
+    std::unordered_map<uint256, TxStatsInfo, StaticSaltedHasher> mapMemPoolTxs;
 
     /** Classes to track historical data on transaction confirmations */
     TxConfirmStats feeStats;
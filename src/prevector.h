@@ -160,6 +160,10 @@ private:
     const T* indirect_ptr(difference_type pos) const { return reinterpret_cast<const T*>(_union.indirect) + pos; }
     bool is_direct() const { return _size <= N; }
 
+    //! Set in _union.capacity while the indirect storage is borrowed, see borrow()
+    static const size_type BORROWED_FLAG = size_type(1) << (sizeof(size_type) * 8 - 1);
+    bool is_borrowed() const { return !is_direct() && (_union.capacity & BORROWED_FLAG); }
+
     void change_capacity(size_type new_capacity) {
         if (new_capacity <= N) {
             if (!is_direct()) {
@@ -167,11 +171,20 @@ private:
                 T* src = indirect;
                 T* dst = direct_ptr(0);
                 memcpy(dst, src, size() * sizeof(T));
-                free(indirect);
+                if (!is_borrowed()) {
+                    free(indirect);
+                }
                 _size -= N + 1;
             }
         } else {
-            if (!is_direct()) {
+            if (is_borrowed()) {
+                // never resized in place, the storage belongs to someone else
+                char* new_indirect = static_cast<char*>(malloc(((size_t)sizeof(T)) * new_capacity));
+                assert(new_indirect);
+                memcpy(new_indirect, _union.indirect, size() * sizeof(T));
+                _union.indirect = new_indirect;
+                _union.capacity = new_capacity;
+            } else if (!is_direct()) {
                 /* FIXME: Because malloc/realloc here won't call new_handler if allocation fails, assert
                     success. These should instead use an allocator or new/delete so that handlers
                     are called as necessary, but performance would be slightly degraded by doing so. */
@@ -220,6 +233,8 @@ public:
         }
     }
 
+    static const unsigned int STATIC_SIZE = N;
+
     prevector() : _size(0) {}
 
     explicit prevector(size_type n) : _size(0) {
@@ -301,7 +316,7 @@ public:
         if (is_direct()) {
             return N;
         } else {
-            return _union.capacity;
+            return _union.capacity & ~BORROWED_FLAG;
         }
     }
 
@@ -432,15 +447,40 @@ public:
     }
 
     void swap(prevector<N, T, Size, Diff>& other) {
+        if (is_borrowed() || other.is_borrowed()) {
+            // borrowed storage stays where it was borrowed, so the contents are copied
+            prevector<N, T, Size, Diff> tmp(*this);
+            *this = other;
+            other = tmp;
+            return;
+        }
         std::swap(_union, other._union);
         std::swap(_size, other._size);
     }
 
+    /**
+     * Replace the contents with n elements already constructed at storage, which has to stay
+     * valid for as long as this prevector uses it. The storage is never freed or resized here,
+     * anything that needs more room, a copy, a move or a swap leaves it behind and goes back
+     * to memory of its own. Only for more than N elements of a trivially destructible T.
+     */
+    void borrow(T* storage, size_type n) {
+        static_assert(std::is_trivially_destructible<T>::value, "borrowed elements are never destroyed");
+        assert(n > N && !(n & BORROWED_FLAG));
+        clear();
+        if (!is_direct() && !is_borrowed()) {
+            free(_union.indirect);
+        }
+        _union.indirect = reinterpret_cast<char*>(storage);
+        _union.capacity = n | BORROWED_FLAG;
+        _size = n + N + 1;
+    }
+
     ~prevector() {
         if (!std::is_trivially_destructible<T>::value) {
             clear();
         }
-        if (!is_direct()) {
+        if (!is_direct() && !is_borrowed()) {
             free(_union.indirect);
             _union.indirect = NULL;
         }
@@ -491,7 +531,7 @@ public:
     }
 
     size_t allocated_memory() const {
-        if (is_direct()) {
+        if (is_direct() || is_borrowed()) {
             return 0;
         } else {
             return ((size_t)(sizeof(T))) * _union.capacity;
@@ -11,14 +11,48 @@
 #include "utilstrencodings.h"
 #include "crypto/common.h"
 
+#include <assert.h>
+
 uint256 CBlockHeader::GetHash() const
 {
+    if (IsHashCacheValid())
+        return cachedHash.hash;
+
     std::vector<unsigned char> vch(80);
     CVectorWriter ss(SER_NETWORK, PROTOCOL_VERSION, vch, 0);
     ss << *this;
     return HashX11((const char *)vch.data(), (const char *)vch.data() + vch.size());
 }
 
+bool CBlockHeader::IsHashCacheValid() const
+{
+    return cachedHash.fSet &&
+           cachedHash.nNonce == nNonce &&
+           cachedHash.nTime == nTime &&
+           cachedHash.hashMerkleRoot == hashMerkleRoot &&
+           cachedHash.nBits == nBits &&
+           cachedHash.nVersion == nVersion &&
+           cachedHash.hashPrevBlock == hashPrevBlock;
+}
+
+void CBlockHeader::SetHashCache(const uint256& hash)
+{
+    cachedHash.nVersion = nVersion;
+    cachedHash.hashPrevBlock = hashPrevBlock;
+    cachedHash.hashMerkleRoot = hashMerkleRoot;
+    cachedHash.nTime = nTime;
+    cachedHash.nBits = nBits;
+    cachedHash.nNonce = nNonce;
+    cachedHash.hash = hash;
+    cachedHash.fSet = true;
+}
+
+void CBlockHeader::UpdateHashCache()
+{
+    if (!IsHashCacheValid())
+        SetHashCache(GetHash());
+}
+
 bool CBlock::IsProofOfStake() const
 {
     return (vtx.size() > 1 && vtx[1]->IsCoinStake());
@@ -29,6 +63,39 @@ bool CBlock::IsProofOfWork() const
     return !IsProofOfStake();
 }
 
+static const size_t HEADER_SIZE = 80;
+
+void HashX11Batch(Span<const CBlockHeader> headers, uint256* out)
+{
+    std::vector<unsigned char> vch;
+    vch.reserve(HEADER_SIZE * headers.size());
+    CVectorWriter ss(SER_NETWORK, PROTOCOL_VERSION, vch, 0);
+    for (std::ptrdiff_t i = 0; i < headers.size(); i++)
+        ss << headers.data()[i];
+    assert(vch.size() == HEADER_SIZE * headers.size());
+    HashX11Batch(vch.data(), HEADER_SIZE, headers.size(), out);
+}
+
+void CacheBlockHeaderHashes(Span<CBlockHeader> headers)
+{
+    std::vector<CBlockHeader*> vUncached;
+    std::vector<unsigned char> vch;
+    CVectorWriter ss(SER_NETWORK, PROTOCOL_VERSION, vch, 0);
+    for (std::ptrdiff_t i = 0; i < headers.size(); i++) {
+        CBlockHeader& header = headers.data()[i];
+        if (!header.IsHashCacheValid()) {
+            vUncached.push_back(&header);
+            ss << header;
+        }
+    }
+    assert(vch.size() == HEADER_SIZE * vUncached.size());
+
+    std::vector<uint256> vHashes(vUncached.size());
+    HashX11Batch(vch.data(), HEADER_SIZE, vUncached.size(), vHashes.data());
+    for (size_t i = 0; i < vUncached.size(); i++)
+        vUncached[i]->SetHashCache(vHashes[i]);
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
@@ -53,6 +53,7 @@ public:
         nTime = 0;
         nBits = 0;
         nNonce = 0;
+        cachedHash.SetNull();
     }
 
     bool IsNull() const
@@ -62,10 +63,40 @@ public:
 
     uint256 GetHash() const;
 
+    //! Remember the hash of the current header fields, GetHash() returns it as long as they stay unchanged
+    void UpdateHashCache();
+    //! Same as above for a hash that is already known, e.g. from the block index
+    void SetHashCache(const uint256& hash);
+    //! Whether GetHash() can return the cached hash without rehashing
+    bool IsHashCacheValid() const;
+
     int64_t GetBlockTime() const
     {
         return (int64_t)nTime;
     }
+
+private:
+    /** Memory only hash cache. It is only ever written by non-const methods, so
+     * const blocks shared between threads can be hashed concurrently, and it
+     * keeps a copy of the fields it was computed for, so a header that gets
+     * modified afterwards (nonce/time updates, new merkle root) is simply
+     * rehashed instead of needing every mutating path to invalidate it.
+     */
+    struct CHashCache
+    {
+        bool fSet;
+        int32_t nVersion;
+        uint256 hashPrevBlock;
+        uint256 hashMerkleRoot;
+        uint32_t nTime;
+        uint32_t nBits;
+        uint32_t nNonce;
+        uint256 hash;
+
+        CHashCache() { SetNull(); }
+        void SetNull() { fSet = false; }
+    };
+    CHashCache cachedHash;
 };
 
 
@@ -100,6 +131,9 @@ public:
         {
             READWRITE(vchBlockSig);
         }
+        // Bare headers arrive in bulk and are hashed with CacheBlockHeaderHashes() instead
+        if (ser_action.ForRead())
+            UpdateHashCache();
     }
 
     void SetNull()
@@ -112,14 +146,8 @@ public:
 
     CBlockHeader GetBlockHeader() const
     {
-        CBlockHeader block;
-        block.nVersion       = nVersion;
-        block.hashPrevBlock  = hashPrevBlock;
-        block.hashMerkleRoot = hashMerkleRoot;
-        block.nTime          = nTime;
-        block.nBits          = nBits;
-        block.nNonce         = nNonce;
-        return block;
+        // Keeps the hash cache along with the header fields
+        return *static_cast<const CBlockHeader*>(this);
     }
 
     bool IsProofOfStake() const;
@@ -128,6 +156,11 @@ public:
     std::string ToString() const;
 };
 
+/** Compute the hashes of many headers at once, see HashX11Batch() */
+void HashX11Batch(Span<const CBlockHeader> headers, uint256* out);
+/** Fill the hash cache of every header in headers that doesn't have a valid one yet with HashX11Batch() */
+void CacheBlockHeaderHashes(Span<CBlockHeader> headers);
+
 /** Describes a place in the block chain to another node such that if the
  * other node doesn't have the same branch, it can find a recent common trunk.
  * The further back it is, the further before the fork it may be.
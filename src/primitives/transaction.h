@@ -9,8 +9,12 @@
 #include "amount.h"
 #include "script/script.h"
 #include "serialize.h"
+#include "support/allocators/arena.h"
 #include "uint256.h"
 
+#include <memory>
+#include <typeindex>
+
 /** Transaction types */
 enum {
     TRANSACTION_NORMAL = 0,
@@ -63,6 +67,90 @@ public:
     std::string ToStringShort() const;
 };
 
+/** Set while the inputs and outputs of a transaction are deserialized on this thread */
+extern thread_local MonotonicArena* g_tx_script_arena;
+
+/**
+ * Memory for the scripts of one transaction. While a CMutableTransaction is deserialized,
+ * its scripts that are too large for the prevector of CScript are read into the arena of
+ * the transaction instead of getting a heap allocation each. The arena moves along into
+ * the CTransaction built from it and is freed with that, so the scripts live exactly as
+ * long as the transaction they belong to. Copies of a transaction copy its scripts into
+ * memory of their own and start with an empty arena.
+ */
+class CTxScriptArena
+{
+    MonotonicArena arena;
+
+public:
+    CTxScriptArena() {}
+    CTxScriptArena(const CTxScriptArena&) {}
+    CTxScriptArena(CTxScriptArena&&) = default;
+    CTxScriptArena& operator=(const CTxScriptArena&) { return *this; }
+    CTxScriptArena& operator=(CTxScriptArena&&) = default;
+
+    const MonotonicArena& Get() const { return arena; }
+
+    /** Points g_tx_script_arena to the arena while alive, does nothing for nullptr */
+    class Scope
+    {
+        MonotonicArena* prev;
+
+    public:
+        explicit Scope(CTxScriptArena* txArena) : prev(g_tx_script_arena)
+        {
+            if (txArena) g_tx_script_arena = &txArena->arena;
+        }
+        ~Scope() { g_tx_script_arena = prev; }
+    };
+};
+
+/**
+ * Serializes a script like CScriptBase. Deserializes scripts that don't fit into the
+ * prevector into g_tx_script_arena when that is set.
+ */
+class CTxScriptSerializer
+{
+    CScript& script;
+
+public:
+    explicit CTxScriptSerializer(CScript& scriptIn) : script(scriptIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s << *(const CScriptBase*)(&script);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        MonotonicArena* arena = g_tx_script_arena;
+        if (!arena) {
+            s >> *(CScriptBase*)(&script);
+            return;
+        }
+
+        unsigned int nSize = ReadCompactSize(s);
+        if (nSize > CScriptBase::STATIC_SIZE && nSize <= (unsigned int)MAX_SCRIPT_SIZE) {
+            unsigned char* storage = static_cast<unsigned char*>(arena->Allocate(nSize, 1));
+            s.read((char*)storage, nSize);
+            script.borrow(storage, nSize);
+            return;
+        }
+
+        // as the prevector deserialization, limiting the size per read for bogus sizes
+        script.clear();
+        unsigned int i = 0;
+        while (i < nSize) {
+            unsigned int blk = std::min(nSize - i, (unsigned int)(1 + 4999999));
+            script.resize(i + blk);
+            s.read((char*)&script[i], blk);
+            i += blk;
+        }
+    }
+};
+
 /** An input of a transaction.  It contains the location of the previous
  * transaction's output that it claims and a signature that matches the
  * output's public key.
@@ -114,7 +202,7 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
         READWRITE(prevout);
-        READWRITE(*(CScriptBase*)(&scriptSig));
+        READWRITE(REF(CTxScriptSerializer(scriptSig)));
         READWRITE(nSequence);
     }
 
@@ -160,7 +248,7 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
         READWRITE(nValue);
-        READWRITE(*(CScriptBase*)(&scriptPubKey));
+        READWRITE(REF(CTxScriptSerializer(scriptPubKey)));
     }
 
     void SetNull()
@@ -224,6 +312,33 @@ public:
 
 struct CMutableTransaction;
 
+/** Extra payload of a special transaction as decoded by GetTxPayload, see evo/specialtx.h */
+struct CTxPayloadCacheEntry
+{
+    std::type_index type;
+    //! nullptr when the payload didn't decode as type
+    std::shared_ptr<const void> obj;
+    uint256 inputsHash;
+
+    CTxPayloadCacheEntry(std::type_index typeIn, std::shared_ptr<const void> objIn, const uint256& inputsHashIn) :
+        type(typeIn), obj(std::move(objIn)), inputsHash(inputsHashIn) {}
+};
+
+/** Holds a CTxPayloadCacheEntry once set, from whichever thread comes first. Only accessed atomically. */
+class CTxPayloadCache
+{
+    std::shared_ptr<const CTxPayloadCacheEntry> entry;
+
+public:
+    CTxPayloadCache() {}
+    CTxPayloadCache(const CTxPayloadCache& other) : entry(other.Get()) {}
+    CTxPayloadCache& operator=(const CTxPayloadCache& other) { Set(other.Get()); return *this; }
+
+    std::shared_ptr<const CTxPayloadCacheEntry> Get() const { return std::atomic_load(&entry); }
+    //! Racing callers decode the same payload, so it doesn't matter whose entry is kept
+    void Set(std::shared_ptr<const CTxPayloadCacheEntry> entryIn) { std::atomic_store(&entry, std::move(entryIn)); }
+};
+
 /** The basic transaction that is broadcasted on the network and contained in
  * blocks.  A transaction can contain multiple inputs and outputs.
  */
@@ -253,7 +368,10 @@ public:
 
 private:
     /** Memory only. */
+    const CTxScriptArena scriptArena;
     const uint256 hash;
+    /** Memory only, see GetTxPayloadShared */
+    mutable CTxPayloadCache payloadCache;
 
     uint256 ComputeHash() const;
 
@@ -289,6 +407,18 @@ public:
         return hash;
     }
 
+    const CTxScriptArena& GetScriptArena() const {
+        return scriptArena;
+    }
+
+    std::shared_ptr<const CTxPayloadCacheEntry> GetPayloadCache() const {
+        return payloadCache.Get();
+    }
+
+    void SetPayloadCache(std::shared_ptr<const CTxPayloadCacheEntry> entry) const {
+        payloadCache.Set(std::move(entry));
+    }
+
     // Return sum of txouts.
     CAmount GetValueOut() const;
     // GetValueIn() is a method on CCoinsViewCache, because
@@ -334,6 +464,8 @@ struct CMutableTransaction
     std::vector<CTxOut> vout;
     uint32_t nLockTime;
     std::vector<uint8_t> vExtraPayload; // only available for special transaction types
+    /** Memory only, holds the scripts read by Unserialize */
+    CTxScriptArena scriptArena;
 
     CMutableTransaction();
     CMutableTransaction(const CTransaction& tx);
@@ -348,8 +480,11 @@ struct CMutableTransaction
             this->nVersion = (int16_t) (n32bitVersion & 0xffff);
             this->nType = (int16_t) ((n32bitVersion >> 16) & 0xffff);
         }
-        READWRITE(vin);
-        READWRITE(vout);
+        {
+            CTxScriptArena::Scope scope(ser_action.ForRead() ? &scriptArena : nullptr);
+            READWRITE(vin);
+            READWRITE(vout);
+        }
         READWRITE(nLockTime);
         if (this->nVersion == 3 && this->nType != TRANSACTION_NORMAL) {
             READWRITE(vExtraPayload);
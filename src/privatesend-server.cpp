@@ -275,9 +275,13 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
         int nTxInIndex = 0;
         int nTxInsCount = (int)vecTxIn.size();
 
+        // Check the whole batch on the script check threads first, if any of them fails
+        // AddScriptSig checks them one by one again to find out which
+        bool fSigsChecked = AreInputScriptSigsValid(vecTxIn);
+
         for (const auto& txin : vecTxIn) {
             nTxInIndex++;
-            if (!AddScriptSig(txin)) {
+            if (!AddScriptSig(txin, fSigsChecked)) {
                 LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSig() failed at %d/%d, session: %d\n", nTxInIndex, nTxInsCount, nSessionID);
                 RelayStatus(STATUS_REJECTED, connman);
                 return;
@@ -609,6 +613,52 @@ bool CPrivateSendServer::IsInputScriptSigValid(const CTxIn& txin)
     return true;
 }
 
+// Verify the scriptSigs in the final transaction the way the mempool will see it. The checks
+// store valid signatures in the signature cache, so CommitFinalTransaction doesn't verify them again.
+bool CPrivateSendServer::AreInputScriptSigsValid(const std::vector<CTxIn>& vecTxIn)
+{
+    if (vecTxIn.empty()) return false;
+
+    std::map<COutPoint, CScript> mapPrevPubKeys;
+    for (const auto& entry : vecEntries) {
+        for (const auto& txdsin : entry.vecTxDSIn) {
+            mapPrevPubKeys.emplace(txdsin.prevout, txdsin.prevPubKey);
+        }
+    }
+
+    CMutableTransaction txNew(finalMutableTransaction);
+    std::vector<std::pair<unsigned int, CScript> > vecInputs;
+    vecInputs.reserve(vecTxIn.size());
+    for (const auto& txin : vecTxIn) {
+        auto it = mapPrevPubKeys.find(txin.prevout);
+        if (it == mapPrevPubKeys.end()) return false;
+
+        bool fFound = false;
+        for (unsigned int i = 0; i < txNew.vin.size(); i++) {
+            if (txNew.vin[i].prevout == txin.prevout && txNew.vin[i].nSequence == txin.nSequence) {
+                txNew.vin[i].scriptSig = txin.scriptSig;
+                vecInputs.emplace_back(i, it->second);
+                fFound = true;
+                break;
+            }
+        }
+        if (!fFound) return false;
+    }
+
+    const CTransaction tx(txNew);
+    std::vector<CScriptCheck> vChecks;
+    vChecks.reserve(vecInputs.size());
+    for (const auto& input : vecInputs) {
+        vChecks.emplace_back(input.second, 0, tx, input.first, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, true);
+    }
+
+    if (!RunScriptChecks(vChecks)) {
+        LogPrint("privatesend", "CPrivateSendServer::AreInputScriptSigsValid -- batch of %d scriptSigs failed\n", vecTxIn.size());
+        return false;
+    }
+    return true;
+}
+
 //
 // Add a clients transaction to the pool
 //
@@ -657,7 +707,7 @@ bool CPrivateSendServer::AddEntry(const CPrivateSendEntry& entryNew, PoolMessage
     return true;
 }
 
-bool CPrivateSendServer::AddScriptSig(const CTxIn& txinNew)
+bool CPrivateSendServer::AddScriptSig(const CTxIn& txinNew, bool fSigChecked)
 {
     LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
 
@@ -670,7 +720,7 @@ bool CPrivateSendServer::AddScriptSig(const CTxIn& txinNew)
         }
     }
 
-    if (!IsInputScriptSigValid(txinNew)) {
+    if (!fSigChecked && !IsInputScriptSigValid(txinNew)) {
         LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- Invalid scriptSig\n");
         return false;
     }
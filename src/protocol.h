@@ -242,6 +242,23 @@ extern const char *GETBLOCKTXN;
  * @since protocol version 70209 as described by BIP 152
  */
 extern const char *BLOCKTXN;
+/**
+ * Contains a 4-byte LE reconciliation version and an 8-byte LE salt.
+ * Offers to announce transactions to each other with TXRCNCLINV instead of INV.
+ * Sent after VERACK by the side which opened the connection, and answered
+ * with its own SENDTXRCNCL by the other side if it agrees.
+ */
+extern const char *SENDTXRCNCL;
+/**
+ * Contains a vector of 4-byte short transaction ids, salted with both sides' SENDTXRCNCL salts.
+ * Announces transactions to a peer which negotiated reconciliation.
+ */
+extern const char *TXRCNCLINV;
+/**
+ * Contains a vector of 4-byte short transaction ids from a TXRCNCLINV the sender didn't
+ * recognize. The peer answers with a regular INV for them.
+ */
+extern const char *TXRCNCLREQ;
 
 // EPMCoin message types
 // NOTE: do NOT declare non-implmented here, we don't want them to be exposed to the outside
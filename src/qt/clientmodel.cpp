@@ -47,6 +47,8 @@ ClientModel::ClientModel(OptionsModel *_optionsModel, QObject *parent) :
 {
     cachedBestHeaderHeight = -1;
     cachedBestHeaderTime = -1;
+    cachedNumBlocks = -1;
+    cachedLastBlockTime = -1;
     peerTableModel = new PeerTableModel(this);
     banTableModel = new BanTableModel(this);
     pollTimer = new QTimer(this);
@@ -101,8 +103,13 @@ void ClientModel::refreshMasternodeList()
 
 int ClientModel::getNumBlocks() const
 {
-    LOCK(cs_main);
-    return chainActive.Height();
+    if (cachedNumBlocks == -1) {
+        // make sure we initially populate the cache via a cs_main lock
+        // otherwise we need to wait for a tip update
+        LOCK(cs_main);
+        cachedNumBlocks = chainActive.Height();
+    }
+    return cachedNumBlocks;
 }
 
 int ClientModel::getHeaderTipHeight() const
@@ -147,12 +154,14 @@ quint64 ClientModel::getTotalBytesSent() const
 
 QDateTime ClientModel::getLastBlockDate() const
 {
-    LOCK(cs_main);
-
-    if (chainActive.Tip())
-        return QDateTime::fromTime_t(chainActive.Tip()->GetBlockTime());
-
-    return QDateTime::fromTime_t(Params().GenesisBlock().GetBlockTime()); // Genesis block's time of current network
+    if (cachedLastBlockTime == -1) {
+        LOCK(cs_main);
+        if (chainActive.Tip())
+            cachedLastBlockTime = chainActive.Tip()->GetBlockTime();
+        else
+            return QDateTime::fromTime_t(Params().GenesisBlock().GetBlockTime()); // Genesis block's time of current network
+    }
+    return QDateTime::fromTime_t(cachedLastBlockTime);
 }
 
 long ClientModel::getMempoolSize() const
@@ -353,6 +362,10 @@ static void BlockTipChanged(ClientModel *clientmodel, bool initialSync, const CB
         // cache best headers time and height to reduce future cs_main locks
         clientmodel->cachedBestHeaderHeight = pIndex->nHeight;
         clientmodel->cachedBestHeaderTime = pIndex->GetBlockTime();
+    } else {
+        // same for the active chain, which the GUI polls e.g. for the PrivateSend status
+        clientmodel->cachedNumBlocks = pIndex->nHeight;
+        clientmodel->cachedLastBlockTime = pIndex->GetBlockTime();
     }
     // if we are in-sync, update the UI regardless of last update time
     if (!initialSync || now - nLastUpdateNotification > MODEL_UPDATE_DELAY) {
@@ -98,6 +98,9 @@ public:
     // caches for the best header
     mutable std::atomic<int> cachedBestHeaderHeight;
     mutable std::atomic<int64_t> cachedBestHeaderTime;
+    // caches for the active chain tip
+    mutable std::atomic<int> cachedNumBlocks;
+    mutable std::atomic<int64_t> cachedLastBlockTime;
 
 private:
     OptionsModel *optionsModel;
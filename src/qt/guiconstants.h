@@ -10,6 +10,8 @@
 
 /* Milliseconds between model updates */
 static const int MODEL_UPDATE_DELAY = 250;
+/* Milliseconds between wallet balance refreshes for new blocks during initial sync */
+static const int MODEL_UPDATE_DELAY_SYNC = 2000;
 
 /* AskPassphraseDialog -- Maximum passphrase length */
 static const int MAX_PASSPHRASE_SIZE = 1024;
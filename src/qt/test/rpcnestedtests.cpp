@@ -52,12 +52,14 @@ void RPCNestedTests::rpcNestedTests()
     //mempool.setSanityCheck(1.0);
     evoDb = new CEvoDB(1 << 20, true, true);
     pblocktree = new CBlockTreeDB(1 << 20, true);
+    ptxindexdb = new CTxIndexDB(*pblocktree, 1 << 20, true);
     pcoinsdbview = new CCoinsViewDB(1 << 23, true);
     deterministicMNManager = new CDeterministicMNManager(*evoDb);
     llmq::InitLLMQSystem(*evoDb, nullptr, true);
 
     pcoinsTip = new CCoinsViewCache(pcoinsdbview);
     InitBlockIndex(chainparams);
+    StartTxIndex(chainparams);
     {
         CValidationState state;
         bool ok = ActivateBestChain(state, chainparams);
@@ -159,6 +161,8 @@ void RPCNestedTests::rpcNestedTests()
     llmq::DestroyLLMQSystem();
     delete deterministicMNManager;
     delete pcoinsdbview;
+    delete ptxindexdb;
+    ptxindexdb = NULL;
     delete pblocktree;
     delete evoDb;
 
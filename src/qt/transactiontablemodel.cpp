@@ -14,6 +14,7 @@
 #include "walletmodel.h"
 
 #include "core_io.h"
+#include "saltedhasher.h"
 #include "validation.h"
 #include "sync.h"
 #include "uint256.h"
@@ -26,6 +27,10 @@
 #include <QIcon>
 #include <QList>
 
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
 #include <boost/foreach.hpp>
 
 // Amount column is right-aligned it contains numbers
@@ -39,22 +44,8 @@ static int column_alignments[] = {
         Qt::AlignRight|Qt::AlignVCenter /* amount */
     };
 
-// Comparison operator for sort/binary search of model tx list
-struct TxLessThan
-{
-    bool operator()(const TransactionRecord &a, const TransactionRecord &b) const
-    {
-        return a.hash < b.hash;
-    }
-    bool operator()(const TransactionRecord &a, const uint256 &b) const
-    {
-        return a.hash < b;
-    }
-    bool operator()(const uint256 &a, const TransactionRecord &b) const
-    {
-        return a < b.hash;
-    }
-};
+// Number of wallet transactions decomposed per fetchMore()
+static const size_t TX_FETCH_PAGE_SIZE = 1000;
 
 // Private implementation
 class TransactionTablePriv
@@ -69,11 +60,20 @@ public:
     CWallet *wallet;
     TransactionTableModel *parent;
 
-    /* Local cache of wallet.
-     * As it is in the same order as the CWallet, by definition
-     * this is sorted by sha256.
+    /* Local cache of wallet, in the order transactions were loaded.
+     * The records of a transaction are always next to each other.
      */
     QList<TransactionRecord> cachedWallet;
+    /* Index of the first record of every transaction in cachedWallet */
+    std::unordered_map<uint256, int, StaticSaltedHasher> mapRecordIndex;
+
+    /* Transactions of the wallet that were not decomposed yet, newest first. Decomposing
+     * a large wallet takes long, so it is done in pages as the view scrolls down (see
+     * fetchMore). Only hashes which are still in setPending get loaded.
+     */
+    std::vector<uint256> vPending;
+    size_t nPendingPos = 0;
+    std::unordered_set<uint256, StaticSaltedHasher> setPending;
 
     /* Query entire wallet anew from core.
      */
@@ -81,33 +81,120 @@ public:
     {
         qDebug() << "TransactionTablePriv::refreshWallet";
         cachedWallet.clear();
+        mapRecordIndex.clear();
+        setPending.clear();
+        nPendingPos = 0;
         {
             LOCK2(cs_main, wallet->cs_wallet);
+            std::vector<std::pair<int64_t, uint256>> vTxs;
+            vTxs.reserve(wallet->mapWallet.size());
             for(std::map<uint256, CWalletTx>::iterator it = wallet->mapWallet.begin(); it != wallet->mapWallet.end(); ++it)
             {
                 if(TransactionRecord::showTransaction(it->second))
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wallet, it->second));
+                    vTxs.emplace_back(it->second.GetTxTime(), it->first);
+            }
+            std::sort(vTxs.begin(), vTxs.end(), [](const std::pair<int64_t, uint256>& a, const std::pair<int64_t, uint256>& b) {
+                return a.first > b.first;
+            });
+            vPending.clear();
+            vPending.reserve(vTxs.size());
+            for (const auto& p : vTxs) {
+                vPending.emplace_back(p.second);
+                setPending.emplace(p.second);
             }
         }
+        fetchMore(TX_FETCH_PAGE_SIZE);
+    }
+
+    bool canFetchMore() const
+    {
+        return !setPending.empty();
+    }
+
+    /* Decompose the next nMax pending transactions and append them to the model */
+    void fetchMore(size_t nMax)
+    {
+        QList<TransactionRecord> toInsert;
+        {
+            LOCK2(cs_main, wallet->cs_wallet);
+            for (size_t n = 0; n < nMax && nPendingPos < vPending.size(); nPendingPos++) {
+                if (!setPending.erase(vPending[nPendingPos])) {
+                    continue;
+                }
+                n++;
+                // the wallet might have changed since refreshWallet
+                std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(vPending[nPendingPos]);
+                if (mi != wallet->mapWallet.end() && TransactionRecord::showTransaction(mi->second)) {
+                    toInsert.append(TransactionRecord::decomposeTransaction(wallet, mi->second));
+                }
+            }
+        }
+        if (setPending.empty()) {
+            std::vector<uint256>().swap(vPending);
+            nPendingPos = 0;
+        }
+        appendRecords(toInsert);
+    }
+
+    /* Append records with a single row insertion */
+    void appendRecords(const QList<TransactionRecord>& toInsert)
+    {
+        if (toInsert.isEmpty())
+            return;
+        int first = cachedWallet.size();
+        parent->beginInsertRows(QModelIndex(), first, first + toInsert.size() - 1);
+        cachedWallet.append(toInsert);
+        for (int i = first; i < cachedWallet.size(); i++) {
+            mapRecordIndex.emplace(cachedWallet[i].hash, i);
+        }
+        parent->endInsertRows();
+    }
+
+    /* Decompose the given wallet transactions and append them to the model at once */
+    void insertTransactions(const std::vector<uint256>& vHashes)
+    {
+        QList<TransactionRecord> toInsert;
+        {
+            LOCK2(cs_main, wallet->cs_wallet);
+            for (const uint256& hash : vHashes) {
+                // Find transaction in wallet
+                std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(hash);
+                if(mi == wallet->mapWallet.end())
+                {
+                    qWarning() << "TransactionTablePriv::updateWallet: Warning: Got CT_NEW, but transaction is not in wallet";
+                    continue;
+                }
+                toInsert.append(TransactionRecord::decomposeTransaction(wallet, mi->second));
+            }
+        }
+        appendRecords(toInsert);
     }
 
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
        with that of the core.
 
-       Call with transaction that was added, removed or changed.
+       Call with transaction that was added, removed or changed. If pvNew is given, new
+       transactions are only added to it, to be inserted together with insertTransactions.
      */
-    void updateWallet(const uint256 &hash, int status, bool showTransaction)
+    void updateWallet(const uint256 &hash, int status, bool showTransaction, std::vector<uint256>* pvNew = nullptr)
     {
         qDebug() << "TransactionTablePriv::updateWallet: " + QString::fromStdString(hash.ToString()) + " " + QString::number(status);
 
+        if (setPending.count(hash)) {
+            // Not loaded yet, fetchMore will pick up its current state
+            return;
+        }
+
         // Find bounds of this transaction in model
-        QList<TransactionRecord>::iterator lower = qLowerBound(
-            cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
-        QList<TransactionRecord>::iterator upper = qUpperBound(
-            cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
-        int lowerIndex = (lower - cachedWallet.begin());
-        int upperIndex = (upper - cachedWallet.begin());
-        bool inModel = (lower != upper);
+        int lowerIndex = cachedWallet.size();
+        int upperIndex = lowerIndex;
+        auto it = mapRecordIndex.find(hash);
+        if (it != mapRecordIndex.end()) {
+            lowerIndex = upperIndex = it->second;
+            while (upperIndex < cachedWallet.size() && cachedWallet[upperIndex].hash == hash)
+                upperIndex++;
+        }
+        bool inModel = (lowerIndex != upperIndex);
 
         if(status == CT_UPDATED)
         {
@@ -131,27 +218,11 @@ public:
             }
             if(showTransaction)
             {
-                LOCK2(cs_main, wallet->cs_wallet);
-                // Find transaction in wallet
-                std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(hash);
-                if(mi == wallet->mapWallet.end())
-                {
-                    qWarning() << "TransactionTablePriv::updateWallet: Warning: Got CT_NEW, but transaction is not in wallet";
-                    break;
-                }
-                // Added -- insert at the right position
-                QList<TransactionRecord> toInsert =
-                        TransactionRecord::decomposeTransaction(wallet, mi->second);
-                if(!toInsert.isEmpty()) /* only if something to insert */
-                {
-                    parent->beginInsertRows(QModelIndex(), lowerIndex, lowerIndex+toInsert.size()-1);
-                    int insert_idx = lowerIndex;
-                    Q_FOREACH(const TransactionRecord &rec, toInsert)
-                    {
-                        cachedWallet.insert(insert_idx, rec);
-                        insert_idx += 1;
-                    }
-                    parent->endInsertRows();
+                // Added -- append to the model
+                if (pvNew) {
+                    pvNew->push_back(hash);
+                } else {
+                    insertTransactions({hash});
                 }
             }
             break;
@@ -163,7 +234,13 @@ public:
             }
             // Removed -- remove entire transaction from table
             parent->beginRemoveRows(QModelIndex(), lowerIndex, upperIndex-1);
-            cachedWallet.erase(lower, upper);
+            cachedWallet.erase(cachedWallet.begin() + lowerIndex, cachedWallet.begin() + upperIndex);
+            mapRecordIndex.erase(it);
+            // records behind it moved, deletions are rare enough to just reindex them
+            for (int i = lowerIndex; i < cachedWallet.size(); i++) {
+                if (i == 0 || cachedWallet[i - 1].hash != cachedWallet[i].hash)
+                    mapRecordIndex[cachedWallet[i].hash] = i;
+            }
             parent->endRemoveRows();
             break;
         case CT_UPDATED:
@@ -769,6 +846,23 @@ QVariant TransactionTableModel::headerData(int section, Qt::Orientation orientat
     return QVariant();
 }
 
+bool TransactionTableModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && priv->canFetchMore();
+}
+
+void TransactionTableModel::fetchMore(const QModelIndex &parent)
+{
+    if (!parent.isValid())
+        priv->fetchMore(TX_FETCH_PAGE_SIZE);
+}
+
+void TransactionTableModel::fetchAll()
+{
+    while (priv->canFetchMore())
+        priv->fetchMore(TX_FETCH_PAGE_SIZE);
+}
+
 QModelIndex TransactionTableModel::index(int row, int column, const QModelIndex &parent) const
 {
     Q_UNUSED(parent);
@@ -804,13 +898,15 @@ public:
                                   Q_ARG(int, status),
                                   Q_ARG(bool, showTransaction));
     }
-private:
+
     uint256 hash;
     ChangeType status;
     bool showTransaction;
 };
 
 static bool fQueueNotifications = false;
+// filled by the core thread, emptied by updateQueuedTransactions in the GUI thread
+static CCriticalSection cs_vQueueNotifications;
 static std::vector< TransactionNotification > vQueueNotifications;
 
 static void NotifyTransactionChanged(TransactionTableModel *ttm, CWallet *wallet, const uint256 &hash, ChangeType status)
@@ -825,6 +921,7 @@ static void NotifyTransactionChanged(TransactionTableModel *ttm, CWallet *wallet
 
     if (fQueueNotifications)
     {
+        LOCK(cs_vQueueNotifications);
         vQueueNotifications.push_back(notification);
         return;
     }
@@ -839,17 +936,38 @@ static void ShowProgress(TransactionTableModel *ttm, const std::string &title, i
     if (nProgress == 100)
     {
         fQueueNotifications = false;
-        if (vQueueNotifications.size() > 10) // prevent balloon spam, show maximum 10 balloons
-            QMetaObject::invokeMethod(ttm, "setProcessingQueuedTransactions", Qt::QueuedConnection, Q_ARG(bool, true));
-        for (unsigned int i = 0; i < vQueueNotifications.size(); ++i)
-        {
-            if (vQueueNotifications.size() - i <= 10)
-                QMetaObject::invokeMethod(ttm, "setProcessingQueuedTransactions", Qt::QueuedConnection, Q_ARG(bool, false));
+        QMetaObject::invokeMethod(ttm, "updateQueuedTransactions", Qt::QueuedConnection);
+    }
+}
 
-            vQueueNotifications[i].invoke(ttm);
-        }
-        std::vector<TransactionNotification >().swap(vQueueNotifications); // clear
+void TransactionTableModel::updateQueuedTransactions()
+{
+    std::vector<TransactionNotification> vNotifications;
+    {
+        LOCK(cs_vQueueNotifications);
+        vNotifications.swap(vQueueNotifications);
+    }
+
+    // Only the last notification for a transaction matters, it was sent with its latest state
+    std::unordered_set<uint256, StaticSaltedHasher> setSeen;
+    std::vector<TransactionNotification> vLatest;
+    for (auto it = vNotifications.rbegin(); it != vNotifications.rend(); ++it) {
+        if (setSeen.insert(it->hash).second)
+            vLatest.push_back(*it);
     }
+    std::reverse(vLatest.begin(), vLatest.end());
+
+    // prevent balloon spam, show maximum 10 balloons. The others are inserted in a single batch.
+    size_t nSilent = vLatest.size() > 10 ? vLatest.size() - 10 : 0;
+    std::vector<uint256> vNew;
+    fProcessingQueuedTransactions = nSilent > 0;
+    for (size_t i = 0; i < nSilent; i++)
+        priv->updateWallet(vLatest[i].hash, vLatest[i].status, vLatest[i].showTransaction, &vNew);
+    priv->insertTransactions(vNew);
+    fProcessingQueuedTransactions = false;
+
+    for (size_t i = nSilent; i < vLatest.size(); i++)
+        priv->updateWallet(vLatest[i].hash, vLatest[i].status, vLatest[i].showTransaction);
 }
 
 void TransactionTableModel::subscribeToCoreSignals()
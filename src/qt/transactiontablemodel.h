@@ -84,6 +84,11 @@ public:
     QVariant data(const QModelIndex &index, int role) const;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
     QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const;
+    /** Transactions are loaded in pages, newest first, as views scroll to the end */
+    bool canFetchMore(const QModelIndex &parent) const;
+    void fetchMore(const QModelIndex &parent);
+    /** Load all remaining transactions, e.g. before exporting them */
+    void fetchAll();
     bool processingQueuedTransactions() { return fProcessingQueuedTransactions; }
     void updateNumISLocks(int numISLocks);
     void updateChainLockHeight(int chainLockHeight);
@@ -123,8 +128,8 @@ public Q_SLOTS:
     void updateDisplayUnit();
     /** Updates the column title to "Amount (DisplayUnit)" and emits headerDataChanged() signal for table headers to react. */
     void updateAmountColumnTitle();
-    /* Needed to update fProcessingQueuedTransactions through a QueuedConnection */
-    void setProcessingQueuedTransactions(bool value) { fProcessingQueuedTransactions = value; }
+    /* Apply the notifications queued while the wallet was busy (e.g. rescan), inserting new transactions in one go */
+    void updateQueuedTransactions();
 
     friend class TransactionTablePriv;
 };
@@ -402,6 +402,8 @@ void TransactionView::exportClicked()
     CSVModelWriter writer(filename);
 
     // name, column, role
+    if (model)
+        model->getTransactionTableModel()->fetchAll();
     writer.setModel(transactionProxyModel);
     writer.addColumn(tr("Confirmed"), 0, TransactionTableModel::ConfirmedRole);
     if (model && model->haveWatchOnly())
@@ -56,6 +56,9 @@ WalletModel::WalletModel(const PlatformStyle *platformStyle, CWallet *_wallet, O
 {
     fHaveWatchOnly = wallet->HaveWatchOnly();
     fForceCheckBalanceChanged = false;
+    fBlockTipChanged = true;
+    fBlockTipInitialSync = false;
+    nLastBalanceRefresh = 0;
 
     addressTableModel = new AddressTableModel(wallet, this);
     transactionTableModel = new TransactionTableModel(platformStyle, wallet, this);
@@ -137,6 +140,17 @@ void WalletModel::updateStatus()
 
 void WalletModel::pollBalanceChanged()
 {
+    // New blocks, transactions and locks are all signalled, so there is nothing to do
+    // without touching cs_main or cs_wallet unless one of them came in. Everything that
+    // came in since the last poll is handled by a single refresh.
+    if(!fForceCheckBalanceChanged && !fBlockTipChanged && privateSendClient.nPrivateSendRounds == cachedPrivateSendRounds)
+        return;
+
+    // While syncing there is a new tip all the time, don't refresh for every poll then
+    int64_t nNow = GetTimeMillis();
+    if(!fForceCheckBalanceChanged && fBlockTipInitialSync && nNow - nLastBalanceRefresh < MODEL_UPDATE_DELAY_SYNC)
+        return;
+
     // Get required locks upfront. This avoids the GUI from getting stuck on
     // periodical polls if the core is holding the locks for a longer time -
     // for example, during a wallet rescan.
@@ -147,9 +161,11 @@ void WalletModel::pollBalanceChanged()
     if(!lockWallet)
         return;
 
+    fBlockTipChanged = false;
     if(fForceCheckBalanceChanged || chainActive.Height() != cachedNumBlocks || privateSendClient.nPrivateSendRounds != cachedPrivateSendRounds)
     {
         fForceCheckBalanceChanged = false;
+        nLastBalanceRefresh = nNow;
 
         // Balance and number of transactions might have changed
         cachedNumBlocks = chainActive.Height();
@@ -520,6 +536,7 @@ bool WalletModel::setWalletLocked(bool locked, const SecureString &passPhrase, b
     if(locked)
     {
         // Lock
+        wallet->ClearStakingKeys();
         return wallet->Lock(fMixing);
     }
     else
@@ -602,6 +619,12 @@ static void NotifyWatchonlyChanged(WalletModel *walletmodel, bool fHaveWatchonly
                               Q_ARG(bool, fHaveWatchonly));
 }
 
+static void NotifyBlockTip(WalletModel *walletmodel, bool initialSync, const CBlockIndex *pIndex)
+{
+    walletmodel->fBlockTipInitialSync = initialSync;
+    walletmodel->fBlockTipChanged = true;
+}
+
 void WalletModel::subscribeToCoreSignals()
 {
     // Connect signals to wallet
@@ -612,6 +635,7 @@ void WalletModel::subscribeToCoreSignals()
     wallet->NotifyChainLockReceived.connect(boost::bind(NotifyChainLockReceived, this, _1));
     wallet->ShowProgress.connect(boost::bind(ShowProgress, this, _1, _2));
     wallet->NotifyWatchonlyChanged.connect(boost::bind(NotifyWatchonlyChanged, this, _1));
+    uiInterface.NotifyBlockTip.connect(boost::bind(NotifyBlockTip, this, _1, _2));
 }
 
 void WalletModel::unsubscribeFromCoreSignals()
@@ -624,6 +648,7 @@ void WalletModel::unsubscribeFromCoreSignals()
     wallet->NotifyChainLockReceived.disconnect(boost::bind(NotifyChainLockReceived, this, _1));
     wallet->ShowProgress.disconnect(boost::bind(ShowProgress, this, _1, _2));
     wallet->NotifyWatchonlyChanged.disconnect(boost::bind(NotifyWatchonlyChanged, this, _1));
+    uiInterface.NotifyBlockTip.disconnect(boost::bind(NotifyBlockTip, this, _1, _2));
 }
 
 // WalletModel::UnlockContext implementation
@@ -13,6 +13,7 @@
 #endif // ENABLE_WALLET
 #include "support/allocators/secure.h"
 
+#include <atomic>
 #include <map>
 #include <vector>
 
@@ -235,10 +236,15 @@ public:
 
     bool IsOldInstantSendEnabled() const;
 
+    // set by the core thread when a block was connected, picked up by the next poll
+    std::atomic<bool> fBlockTipChanged;
+    std::atomic<bool> fBlockTipInitialSync;
+
 private:
     CWallet *wallet;
     bool fHaveWatchOnly;
     bool fForceCheckBalanceChanged;
+    int64_t nLastBalanceRefresh;
 
     // Wallet has an options model for wallet-specific options
     // (transaction fee, for example)
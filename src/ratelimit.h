@@ -0,0 +1,306 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include "hash.h"
+#include "random.h"
+#include "serialize.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+/**
+ * The last N timestamps of some kind of event and the rate they imply, e.g. the
+ * governance triggers of one masternode. Timestamps don't have to be in order.
+ */
+template <int N>
+class CTimestampWindow
+{
+private:
+    int64_t arrTimestamps[N];
+
+    int nDataStart;
+
+    int nDataEnd;
+
+    bool fBufferEmpty;
+
+public:
+    CTimestampWindow() :
+        arrTimestamps(),
+        nDataStart(0),
+        nDataEnd(0),
+        fBufferEmpty(true)
+    {
+    }
+
+    void AddTimestamp(int64_t nTimestamp)
+    {
+        if ((nDataEnd == nDataStart) && !fBufferEmpty) {
+            // Buffer full, discard 1st element
+            nDataStart = (nDataStart + 1) % N;
+        }
+        arrTimestamps[nDataEnd] = nTimestamp;
+        nDataEnd = (nDataEnd + 1) % N;
+        fBufferEmpty = false;
+    }
+
+    int64_t GetMinTimestamp() const
+    {
+        int64_t nMin = std::numeric_limits<int64_t>::max();
+        for (int i = 0, nCount = GetCount(); i < nCount; i++) {
+            nMin = std::min(nMin, arrTimestamps[(nDataStart + i) % N]);
+        }
+        return nMin;
+    }
+
+    int64_t GetMaxTimestamp() const
+    {
+        int64_t nMax = 0;
+        for (int i = 0, nCount = GetCount(); i < nCount; i++) {
+            nMax = std::max(nMax, arrTimestamps[(nDataStart + i) % N]);
+        }
+        return nMax;
+    }
+
+    int GetCount() const
+    {
+        if (fBufferEmpty) {
+            return 0;
+        }
+        return nDataEnd > nDataStart ? nDataEnd - nDataStart : N - nDataStart + nDataEnd;
+    }
+
+    double GetRate() const
+    {
+        int nCount = GetCount();
+        if (nCount < N) {
+            return 0.0;
+        }
+        int64_t nMin = GetMinTimestamp();
+        int64_t nMax = GetMaxTimestamp();
+        if (nMin == nMax) {
+            // multiple objects with the same timestamp => infinite rate
+            return 1.0e10;
+        }
+        return double(nCount) / double(nMax - nMin);
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        // same format as the std::vector this used to be
+        uint64_t nSize = N;
+        READWRITE(COMPACTSIZE(nSize));
+        if (nSize != N) {
+            throw std::ios_base::failure("CTimestampWindow: unexpected number of timestamps");
+        }
+        for (int i = 0; i < N; i++) {
+            READWRITE(arrTimestamps[i]);
+        }
+        READWRITE(nDataStart);
+        READWRITE(nDataEnd);
+        READWRITE(fBufferEmpty);
+    }
+};
+
+/**
+ * Counts events per key within a time window, like the requests we made to a peer or
+ * the ones it made to us. Keys are 64 bit SipHashes under the limiter's own salt (see
+ * GetHasher), so nothing but the hash is stored for them.
+ *
+ * The table is open addressed with linear probing. An entry whose window has ended is
+ * free for reuse by the next insert which probes over it, and all of them are dropped
+ * whenever the table is rebuilt, so expiry needs no periodic scan. Memory is only
+ * allocated when the table grows. Not thread safe.
+ */
+class CWindowRateLimiter
+{
+private:
+    struct Entry {
+        uint64_t nKey;
+        // 0 for a slot which was never used
+        int64_t nWindowEnd;
+        uint32_t nCount;
+    };
+
+    static const size_t MIN_CAPACITY = 64;
+    static const uint64_t MAX_SERIALIZED_ENTRIES = 1 << 24;
+
+    uint64_t k0, k1;
+    // a power of two in size, at most half of it used
+    std::vector<Entry> vecEntries;
+    size_t nUsed;
+
+    size_t FindSlot(uint64_t nKey) const
+    {
+        size_t nMask = vecEntries.size() - 1;
+        size_t i = nKey & nMask;
+        while (vecEntries[i].nWindowEnd != 0 && vecEntries[i].nKey != nKey) {
+            i = (i + 1) & nMask;
+        }
+        return i;
+    }
+
+    void Rebuild(size_t nCapacity, int64_t nNow)
+    {
+        std::vector<Entry> vecOld;
+        vecOld.swap(vecEntries);
+        vecEntries.assign(nCapacity, Entry());
+        nUsed = 0;
+        for (const auto& entry : vecOld) {
+            if (entry.nWindowEnd > nNow) {
+                vecEntries[FindSlot(entry.nKey)] = entry;
+                nUsed++;
+            }
+        }
+    }
+
+public:
+    CWindowRateLimiter() :
+        k0(GetRand(std::numeric_limits<uint64_t>::max())),
+        k1(GetRand(std::numeric_limits<uint64_t>::max())),
+        vecEntries(MIN_CAPACITY),
+        nUsed(0)
+    {
+    }
+
+    /** A hasher for building the keys of this limiter */
+    CSipHasher GetHasher() const { return CSipHasher(k0, k1); }
+
+    /** Number of events for nKey in its current window */
+    uint32_t Count(uint64_t nKey, int64_t nNow) const
+    {
+        const Entry& entry = vecEntries[FindSlot(nKey)];
+        return entry.nWindowEnd > nNow ? entry.nCount : 0;
+    }
+
+    /**
+     * Counts an event for nKey and returns the number of events in its window, which
+     * starts with the first event after the previous window ended and lasts nWindow.
+     */
+    uint32_t Add(uint64_t nKey, int64_t nNow, int64_t nWindow)
+    {
+        size_t nMask = vecEntries.size() - 1;
+        size_t nFree = vecEntries.size();
+        size_t i = nKey & nMask;
+        for (; vecEntries[i].nWindowEnd != 0; i = (i + 1) & nMask) {
+            if (vecEntries[i].nKey == nKey) {
+                break;
+            }
+            if (nFree == vecEntries.size() && vecEntries[i].nWindowEnd <= nNow) {
+                nFree = i;
+            }
+        }
+
+        Entry* pentry = &vecEntries[i];
+        if (pentry->nWindowEnd == 0) {
+            if (nFree != vecEntries.size()) {
+                // take over an expired entry on the way instead
+                pentry = &vecEntries[nFree];
+            } else {
+                if (2 * (nUsed + 1) > vecEntries.size()) {
+                    Rebuild(vecEntries.size() * 2, nNow);
+                    return Add(nKey, nNow, nWindow);
+                }
+                nUsed++;
+            }
+            pentry->nKey = nKey;
+            pentry->nWindowEnd = 0;
+        }
+
+        if (pentry->nWindowEnd <= nNow) {
+            pentry->nWindowEnd = nNow + std::max<int64_t>(1, nWindow);
+            pentry->nCount = 0;
+        }
+        return ++pentry->nCount;
+    }
+
+    /** Ends the window of nKey, it counts no events afterwards */
+    void Reset(uint64_t nKey)
+    {
+        Entry& entry = vecEntries[FindSlot(nKey)];
+        if (entry.nWindowEnd != 0) {
+            // keep the slot as part of the probe sequences, 1 is in the past for everyone
+            entry.nWindowEnd = 1;
+        }
+    }
+
+    /** Drops the expired entries if they make up most of the table, and shrinks it then */
+    void Compact(int64_t nNow)
+    {
+        size_t nLive = Size(nNow);
+        if (2 * nLive >= nUsed) return;
+        size_t nCapacity = MIN_CAPACITY;
+        while (nCapacity < 4 * nLive) {
+            nCapacity *= 2;
+        }
+        Rebuild(nCapacity, nNow);
+    }
+
+    /** Number of keys with a window in progress */
+    size_t Size(int64_t nNow) const
+    {
+        size_t nLive = 0;
+        for (const auto& entry : vecEntries) {
+            nLive += entry.nWindowEnd > nNow;
+        }
+        return nLive;
+    }
+
+    void Clear()
+    {
+        vecEntries.assign(MIN_CAPACITY, Entry());
+        nUsed = 0;
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        // the keys are only meaningful together with the salt
+        READWRITE(k0);
+        READWRITE(k1);
+        uint64_t nSize = nUsed;
+        READWRITE(COMPACTSIZE(nSize));
+        if (ser_action.ForRead()) {
+            if (nSize > MAX_SERIALIZED_ENTRIES) {
+                throw std::ios_base::failure("CWindowRateLimiter: too many entries");
+            }
+            size_t nCapacity = MIN_CAPACITY;
+            while (nCapacity < 2 * nSize) {
+                nCapacity *= 2;
+            }
+            vecEntries.assign(nCapacity, Entry());
+            nUsed = 0;
+            for (uint64_t i = 0; i < nSize; i++) {
+                Entry entry;
+                READWRITE(entry.nKey);
+                READWRITE(entry.nWindowEnd);
+                READWRITE(entry.nCount);
+                if (entry.nWindowEnd == 0) continue;
+                Entry& slot = vecEntries[FindSlot(entry.nKey)];
+                if (slot.nWindowEnd == 0) {
+                    nUsed++;
+                }
+                slot = entry;
+            }
+        } else {
+            for (auto& entry : vecEntries) {
+                if (entry.nWindowEnd == 0) continue;
+                READWRITE(entry.nKey);
+                READWRITE(entry.nWindowEnd);
+                READWRITE(entry.nCount);
+            }
+        }
+    }
+};
+
+#endif // RATELIMIT_H
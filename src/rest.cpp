@@ -3,8 +3,10 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "base58.h"
 #include "chain.h"
 #include "chainparams.h"
+#include "clientversion.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "validation.h"
@@ -21,6 +23,8 @@
 #include <univalue.h>
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const unsigned int MAX_REST_ADDRESS_ENTRIES = 10000; //address index entries returned per request
+static const size_t MAX_REST_TXOUTPROOF_TXIDS = 100; //transactions proven per request
 
 enum RetFormat {
     RF_UNDEF,
@@ -214,6 +218,7 @@ static bool rest_block(HTTPRequest* req,
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
     CBlock block;
+    std::vector<unsigned char> vchBlock;
     CBlockIndex* pblockindex = NULL;
     {
         LOCK(cs_main);
@@ -224,23 +229,24 @@ static bool rest_block(HTTPRequest* req,
         if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+        // the binary formats are the block as stored on disk, only JSON needs it decoded
+        if (rf == RF_BINARY || rf == RF_HEX) {
+            if (!ReadRawBlockFromDisk(vchBlock, pblockindex, Params().MessageStart()))
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        } else if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << block;
-
     switch (rf) {
     case RF_BINARY: {
-        std::string binaryBlock = ssBlock.str();
+        std::string binaryBlock(vchBlock.begin(), vchBlock.end());
         req->WriteHeader("Content-Type", "application/octet-stream");
         req->WriteReply(HTTP_OK, binaryBlock);
         return true;
     }
 
     case RF_HEX: {
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
+        std::string strHex = HexStr(vchBlock.begin(), vchBlock.end()) + "\n";
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
         return true;
@@ -591,6 +597,419 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+/**
+ * Split "?key=value&..." off the end of a request, the address endpoints take their range
+ * parameters this way
+ */
+static std::map<std::string, std::string> ParseQueryString(std::string& strReq)
+{
+    std::map<std::string, std::string> mapQuery;
+    const std::string::size_type pos = strReq.find('?');
+    if (pos == std::string::npos)
+        return mapQuery;
+
+    std::vector<std::string> vParams;
+    std::string strQuery = strReq.substr(pos + 1);
+    boost::split(vParams, strQuery, boost::is_any_of("&"));
+    strReq.erase(pos);
+    BOOST_FOREACH(const std::string& strParam, vParams) {
+        const std::string::size_type eq = strParam.find('=');
+        if (eq == std::string::npos)
+            mapQuery[strParam] = "";
+        else
+            mapQuery[strParam.substr(0, eq)] = strParam.substr(eq + 1);
+    }
+    return mapQuery;
+}
+
+struct CRestAddressUtxo {
+    uint256 txid;
+    uint32_t nOutput;
+    CAmount nSatoshis;
+    CScript script;
+    int32_t nHeight;
+
+    ADD_SERIALIZE_METHODS;
+
+    CRestAddressUtxo() : nOutput(0), nSatoshis(0), nHeight(0) {}
+    CRestAddressUtxo(const CAddressUnspentKey& key, const CAddressUnspentValue& value) :
+        txid(key.txhash), nOutput(key.index), nSatoshis(value.satoshis), script(value.script), nHeight(value.blockHeight) {}
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(txid);
+        READWRITE(nOutput);
+        READWRITE(nSatoshis);
+        READWRITE(*(CScriptBase*)(&script));
+        READWRITE(nHeight);
+    }
+};
+
+struct CRestAddressTxid {
+    int32_t nHeight;
+    uint256 txid;
+
+    ADD_SERIALIZE_METHODS;
+
+    CRestAddressTxid() : nHeight(0) {}
+    CRestAddressTxid(const CAddressIndexKey& key) : nHeight(key.blockHeight), txid(key.txhash) {}
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nHeight);
+        READWRITE(txid);
+    }
+};
+
+struct CRestAddressDelta {
+    uint256 txid;
+    uint32_t nIndex;
+    int32_t nHeight;
+    uint32_t nBlockIndex;
+    CAmount nSatoshis;
+
+    ADD_SERIALIZE_METHODS;
+
+    CRestAddressDelta() : nIndex(0), nHeight(0), nBlockIndex(0), nSatoshis(0) {}
+    CRestAddressDelta(const CAddressIndexKey& key, CAmount nAmount) :
+        txid(key.txhash), nIndex(key.index), nHeight(key.blockHeight), nBlockIndex(key.txindex), nSatoshis(nAmount) {}
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(txid);
+        READWRITE(nIndex);
+        READWRITE(nHeight);
+        READWRITE(nBlockIndex);
+        READWRITE(nSatoshis);
+    }
+};
+
+/** Write entries encoded by toJSON, followed by the cursor for the next page if there are more */
+template <typename Entry, typename ToJSON>
+static bool WriteAddressReply(HTTPRequest* req, RetFormat rf, const std::string& strName,
+                              const std::vector<Entry>& entries, const std::string& strCursor, ToJSON toJSON)
+{
+    switch (rf) {
+    case RF_BINARY:
+    case RF_HEX: {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << entries << ParseHex(strCursor);
+        if (rf == RF_BINARY) {
+            req->WriteHeader("Content-Type", "application/octet-stream");
+            req->WriteReply(HTTP_OK, ss.str());
+        } else {
+            req->WriteHeader("Content-Type", "text/plain");
+            req->WriteReply(HTTP_OK, HexStr(ss.begin(), ss.end()) + "\n");
+        }
+        return true;
+    }
+    case RF_JSON: {
+        UniValue result(UniValue::VOBJ);
+        UniValue jsonEntries(UniValue::VARR);
+        BOOST_FOREACH(const Entry& entry, entries) {
+            jsonEntries.push_back(toJSON(entry));
+        }
+        result.push_back(Pair(strName, jsonEntries));
+        if (!strCursor.empty())
+            result.push_back(Pair("cursor", strCursor));
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, result.write() + "\n");
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+}
+
+/**
+ * Read one page of at most nLimit entries starting at keyCursor, and leave the cursor of the
+ * next page, hex encoded like the one of the address RPCs, in strCursor
+ */
+template <typename Key, typename Value, typename Read>
+static bool ReadAddressPage(size_t nLimit, Key& keyCursor, std::vector<std::pair<Key, Value> >& entries,
+                            std::string& strCursor, Read read)
+{
+    if (!read(keyCursor.hashBytes.IsNull() ? nullptr : &keyCursor, nLimit + 1))
+        return false;
+
+    strCursor.clear();
+    if (entries.size() > nLimit) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << entries[nLimit].first;
+        strCursor = HexStr(ss.begin(), ss.end());
+        entries.resize(nLimit);
+    }
+    return true;
+}
+
+static bool rest_address(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    if (!fAddressIndex)
+        return RESTERR(req, HTTP_NOT_FOUND, "Address index not enabled, start with -addressindex");
+
+    std::string strReq = strURIPart;
+    const std::map<std::string, std::string> mapQuery = ParseQueryString(strReq);
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strReq);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Use /rest/address/<address>/<utxos|txids|deltas>.<ext>.");
+
+    uint160 hashBytes;
+    int type = 0;
+    if (!CBitcoinAddress(path[0]).GetIndexKey(hashBytes, type))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + path[0]);
+
+    int32_t nStart = 0, nEnd = 0, nLimit = MAX_REST_ADDRESS_ENTRIES;
+    std::vector<unsigned char> vchCursor;
+    for (const auto& query : mapQuery) {
+        if (query.first == "start") {
+            if (!ParseInt32(query.second, &nStart) || nStart <= 0)
+                return RESTERR(req, HTTP_BAD_REQUEST, "Invalid start height: " + query.second);
+        } else if (query.first == "end") {
+            if (!ParseInt32(query.second, &nEnd) || nEnd <= 0)
+                return RESTERR(req, HTTP_BAD_REQUEST, "Invalid end height: " + query.second);
+        } else if (query.first == "limit") {
+            if (!ParseInt32(query.second, &nLimit) || nLimit <= 0 || nLimit > (int32_t)MAX_REST_ADDRESS_ENTRIES)
+                return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Limit out of range (1-%u): %s", MAX_REST_ADDRESS_ENTRIES, query.second));
+        } else if (query.first == "cursor") {
+            if (!IsHex(query.second))
+                return RESTERR(req, HTTP_BAD_REQUEST, "Invalid cursor");
+            vchCursor = ParseHex(query.second);
+        } else {
+            return RESTERR(req, HTTP_BAD_REQUEST, "Unknown parameter: " + query.first);
+        }
+    }
+    if ((nStart > 0) != (nEnd > 0) || nEnd < nStart)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Height range needs both a start and an end, with end >= start");
+
+    // the cursor is the serialized key of the next entry and has to point into this address
+    auto parseCursor = [&](auto& keyCursor) {
+        keyCursor.SetNull();
+        if (vchCursor.empty())
+            return true;
+        CDataStream ss(vchCursor, SER_DISK, CLIENT_VERSION);
+        try {
+            ss >> keyCursor;
+        } catch (const std::exception&) {
+            return false;
+        }
+        return keyCursor.hashBytes == hashBytes && (int)keyCursor.type == type;
+    };
+
+    std::string strCursor;
+    if (path[1] == "utxos") {
+        if (nStart > 0)
+            return RESTERR(req, HTTP_BAD_REQUEST, "Height range is not supported for utxos");
+        CAddressUnspentKey keyCursor;
+        if (!parseCursor(keyCursor))
+            return RESTERR(req, HTTP_BAD_REQUEST, "Invalid cursor");
+
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+        if (!ReadAddressPage(nLimit, keyCursor, unspentOutputs, strCursor, [&](const CAddressUnspentKey* pkeyFrom, size_t nMaxEntries) {
+                return GetAddressUnspent(hashBytes, type, unspentOutputs, pkeyFrom, nMaxEntries);
+            }))
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Unable to read the address index");
+
+        std::vector<CRestAddressUtxo> utxos;
+        utxos.reserve(unspentOutputs.size());
+        for (const auto& entry : unspentOutputs)
+            utxos.emplace_back(entry.first, entry.second);
+        return WriteAddressReply(req, rf, "utxos", utxos, strCursor, [](const CRestAddressUtxo& utxo) {
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("txid", utxo.txid.GetHex()));
+            obj.push_back(Pair("outputIndex", (int64_t)utxo.nOutput));
+            obj.push_back(Pair("script", HexStr(utxo.script.begin(), utxo.script.end())));
+            obj.push_back(Pair("satoshis", utxo.nSatoshis));
+            obj.push_back(Pair("height", utxo.nHeight));
+            return obj;
+        });
+    }
+
+    if (path[1] != "txids" && path[1] != "deltas")
+        return RESTERR(req, HTTP_BAD_REQUEST, "Unknown address data: " + path[1] + ". Use utxos, txids or deltas.");
+
+    CAddressIndexKey keyCursor;
+    if (!parseCursor(keyCursor) || (!keyCursor.hashBytes.IsNull() && nEnd > 0 && (keyCursor.blockHeight < nStart || keyCursor.blockHeight > nEnd)))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid cursor");
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    if (!ReadAddressPage(nLimit, keyCursor, addressIndex, strCursor, [&](const CAddressIndexKey* pkeyFrom, size_t nMaxEntries) {
+            return GetAddressIndex(hashBytes, type, addressIndex, nStart, nEnd, pkeyFrom, nMaxEntries);
+        }))
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Unable to read the address index");
+
+    if (path[1] == "deltas") {
+        std::vector<CRestAddressDelta> deltas;
+        deltas.reserve(addressIndex.size());
+        for (const auto& entry : addressIndex)
+            deltas.emplace_back(entry.first, entry.second);
+        return WriteAddressReply(req, rf, "deltas", deltas, strCursor, [](const CRestAddressDelta& delta) {
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("satoshis", delta.nSatoshis));
+            obj.push_back(Pair("txid", delta.txid.GetHex()));
+            obj.push_back(Pair("index", (int64_t)delta.nIndex));
+            obj.push_back(Pair("blockindex", (int64_t)delta.nBlockIndex));
+            obj.push_back(Pair("height", delta.nHeight));
+            return obj;
+        });
+    }
+
+    // the entries of one transaction are next to each other in the index, a transaction split
+    // by the end of a page shows up again at the start of the next one
+    std::vector<CRestAddressTxid> txids;
+    for (const auto& entry : addressIndex) {
+        if (txids.empty() || txids.back().txid != entry.first.txhash)
+            txids.emplace_back(entry.first);
+    }
+    return WriteAddressReply(req, rf, "txids", txids, strCursor, [](const CRestAddressTxid& txid) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("txid", txid.txid.GetHex()));
+        obj.push_back(Pair("height", txid.nHeight));
+        return obj;
+    });
+}
+
+static bool rest_spent(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    if (!fSpentIndex)
+        return RESTERR(req, HTTP_NOT_FOUND, "Spent index not enabled, start with -spentindex");
+
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Use /rest/spent/<txid>/<n>.<ext>.");
+
+    uint256 txid;
+    if (!ParseHashStr(path[0], txid))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[0]);
+    int32_t nOutput;
+    if (!ParseInt32(path[1], &nOutput) || nOutput < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid output index: " + path[1]);
+
+    CSpentIndexKey key(txid, nOutput);
+    CSpentIndexValue value;
+    if (!GetSpentIndex(key, value))
+        return RESTERR(req, HTTP_NOT_FOUND, "Unable to get spent info for " + path[0] + "-" + path[1]);
+
+    switch (rf) {
+    case RF_BINARY: {
+        CDataStream ssSpent(SER_NETWORK, PROTOCOL_VERSION);
+        ssSpent << value;
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, ssSpent.str());
+        return true;
+    }
+
+    case RF_HEX: {
+        CDataStream ssSpent(SER_NETWORK, PROTOCOL_VERSION);
+        ssSpent << value;
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, HexStr(ssSpent.begin(), ssSpent.end()) + "\n");
+        return true;
+    }
+
+    case RF_JSON: {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("txid", value.txid.GetHex()));
+        obj.push_back(Pair("index", (int)value.inputIndex));
+        obj.push_back(Pair("height", value.blockHeight));
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, obj.write() + "\n");
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_txoutproofs(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (param.empty() || path.size() > MAX_REST_TXOUTPROOF_TXIDS)
+        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Invalid URI format. Use /rest/txoutproofs/<txid>/.../<txid>.<ext> with at most %u txids.", MAX_REST_TXOUTPROOF_TXIDS));
+
+    std::vector<uint256> vTxids;
+    std::set<uint256> setTxids;
+    for (const std::string& strTxid : path) {
+        uint256 txid;
+        if (!ParseHashStr(strTxid, txid))
+            return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + strTxid);
+        if (!setTxids.insert(txid).second)
+            return RESTERR(req, HTTP_BAD_REQUEST, "Duplicated txid: " + strTxid);
+        vTxids.push_back(txid);
+    }
+
+    std::vector<std::pair<CMerkleBlock, std::vector<uint256> > > vProofs;
+    std::string strError;
+    if (!GetTxOutProofs(vTxids, vProofs, strError))
+        return RESTERR(req, HTTP_NOT_FOUND, strError);
+
+    switch (rf) {
+    case RF_BINARY:
+    case RF_HEX: {
+        CDataStream ssProofs(SER_NETWORK, PROTOCOL_VERSION);
+        ssProofs << vProofs;
+        if (rf == RF_BINARY) {
+            req->WriteHeader("Content-Type", "application/octet-stream");
+            req->WriteReply(HTTP_OK, ssProofs.str());
+        } else {
+            req->WriteHeader("Content-Type", "text/plain");
+            req->WriteReply(HTTP_OK, HexStr(ssProofs.begin(), ssProofs.end()) + "\n");
+        }
+        return true;
+    }
+
+    case RF_JSON: {
+        UniValue result(UniValue::VARR);
+        for (const auto& p : vProofs) {
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("blockhash", p.first.header.GetHash().GetHex()));
+            UniValue txids(UniValue::VARR);
+            for (const uint256& txid : p.second)
+                txids.push_back(txid.GetHex());
+            obj.push_back(Pair("txids", txids));
+            CDataStream ssMB(SER_NETWORK, PROTOCOL_VERSION);
+            ssMB << p.first;
+            obj.push_back(Pair("proof", HexStr(ssMB.begin(), ssMB.end())));
+            result.push_back(obj);
+        }
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, result.write() + "\n");
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -603,6 +1022,9 @@ static const struct {
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/address/", rest_address},
+      {"/rest/spent/", rest_spent},
+      {"/rest/txoutproofs/", rest_txoutproofs},
 };
 
 bool StartREST()
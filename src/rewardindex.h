@@ -0,0 +1,97 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_REWARDINDEX_H
+#define BITCOIN_REWARDINDEX_H
+
+#include "amount.h"
+#include "script/script.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <string>
+
+enum RewardType {
+    //! What the miner or staker got on top of its inputs, fees included
+    REWARD_STAKE = 1,
+    REWARD_MASTERNODE = 2,
+    REWARD_SUPERBLOCK = 3,
+    //! Anything else the reward transaction paid, like the generation output
+    REWARD_OTHER = 4,
+};
+
+inline std::string RewardTypeName(int nType)
+{
+    switch (nType) {
+    case REWARD_STAKE: return "stake";
+    case REWARD_MASTERNODE: return "masternode";
+    case REWARD_SUPERBLOCK: return "superblock";
+    case REWARD_OTHER: return "other";
+    default: return "unknown";
+    }
+}
+
+/** One payout of the reward transaction of a block, see GetBlockRewards */
+struct CBlockReward {
+    int nType;
+    CScript scriptPubKey;
+    //! Output of the reward transaction, the first one of the staker for REWARD_STAKE
+    unsigned int nIndex;
+    CAmount nAmount;
+
+    CBlockReward(int nTypeIn, const CScript& scriptPubKeyIn, unsigned int nIndexIn, CAmount nAmountIn) :
+        nType(nTypeIn), scriptPubKey(scriptPubKeyIn), nIndex(nIndexIn), nAmount(nAmountIn) {}
+};
+
+/** Rewards of an address by height, the value is the amount */
+struct CRewardIndexKey {
+    unsigned int type;
+    uint160 hashBytes;
+    int blockHeight;
+    unsigned int rewardType;
+    unsigned int index;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 30;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        ser_writedata8(s, type);
+        hashBytes.Serialize(s);
+        // Heights are stored big-endian for key sorting in LevelDB
+        ser_writedata32be(s, blockHeight);
+        ser_writedata8(s, rewardType);
+        ser_writedata32be(s, index);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        type = ser_readdata8(s);
+        hashBytes.Unserialize(s);
+        blockHeight = ser_readdata32be(s);
+        rewardType = ser_readdata8(s);
+        index = ser_readdata32be(s);
+    }
+
+    CRewardIndexKey(unsigned int addressType, uint160 addressHash, int height, unsigned int rewardTypeIn, unsigned int indexValue) {
+        type = addressType;
+        hashBytes = addressHash;
+        blockHeight = height;
+        rewardType = rewardTypeIn;
+        index = indexValue;
+    }
+
+    CRewardIndexKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        type = 0;
+        hashBytes.SetNull();
+        blockHeight = 0;
+        rewardType = 0;
+        index = 0;
+    }
+};
+
+#endif // BITCOIN_REWARDINDEX_H
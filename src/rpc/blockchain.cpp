@@ -12,24 +12,30 @@
 #include "checkpoints.h"
 #include "coins.h"
 #include "core_io.h"
+#include "indexbuilder.h"
 #include "consensus/validation.h"
 #include "instantx.h"
 #include "validation.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
+#include "rpc/jsonwriter.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
 #include "txdb.h"
 #include "txmempool.h"
+#include "undo.h"
 #include "util.h"
 #include "utilstrencodings.h"
 #include "hash.h"
 
 #include "evo/specialtx.h"
 #include "evo/cbtx.h"
+#include "evo/deterministicmns.h"
 
+#include "llmq/quorums_blockprocessor.h"
 #include "llmq/quorums_chainlocks.h"
+#include "llmq/quorums_commitment.h"
 #include "llmq/quorums_instantsend.h"
 
 #include <stdint.h>
@@ -38,8 +44,10 @@
 
 #include <boost/thread/thread.hpp> // boost::thread::interrupt
 
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
 
 struct CUpdatedBlock
 {
@@ -151,7 +159,7 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     result.push_back(Pair("tx", txs));
     if (!block.vtx[0]->vExtraPayload.empty()) {
         CCbTx cbTx;
-        if (GetTxPayload(block.vtx[0]->vExtraPayload, cbTx)) {
+        if (GetTxPayload(*block.vtx[0], cbTx)) {
             UniValue cbTxObj;
             cbTx.ToJson(cbTxObj);
             result.push_back(Pair("cbTx", cbTxObj));
@@ -472,6 +480,24 @@ UniValue getrawmempool(const JSONRPCRequest& request)
     return mempoolToJSON(fVerbose);
 }
 
+/** getrawmempool true without the whole object in memory, one entry at a time */
+static bool getrawmempool_stream(const JSONRPCRequest& request, CJSONWriter& writer)
+{
+    if (request.fHelp || request.params.size() != 1 || !request.params[0].get_bool())
+        return false;
+
+    LOCK(mempool.cs);
+    writer.BeginObject();
+    BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx)
+    {
+        UniValue info(UniValue::VOBJ);
+        entryToJSON(info, e);
+        writer.Key(e.GetTx().GetHash().ToString()).Value(info);
+    }
+    writer.EndObject();
+    return true;
+}
+
 UniValue getmempoolancestors(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
@@ -639,6 +665,7 @@ UniValue getblockhashes(const JSONRPCRequest& request)
         throw std::runtime_error(
             "getblockhashes timestamp\n"
             "\nReturns array of hashes of blocks within the timestamp range provided.\n"
+            "Without -timestampindex only the blocks of the active chain are returned.\n"
             "\nArguments:\n"
             "1. high         (numeric, required) The newer block timestamp\n"
             "2. low          (numeric, required) The older block timestamp\n"
@@ -915,6 +942,15 @@ UniValue getblock(const JSONRPCRequest& request)
     if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
         throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
 
+    if (verbosity <= 0)
+    {
+        // the serialized block is just what's on disk, no need to decode it
+        std::vector<unsigned char> vchBlock;
+        if (!ReadRawBlockFromDisk(vchBlock, pblockindex, Params().MessageStart()))
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+        return HexStr(vchBlock.begin(), vchBlock.end());
+    }
+
     if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
         // Block not found on disk. This could be because we have the block
         // header in our index but don't have the block (for example if a
@@ -923,14 +959,6 @@ UniValue getblock(const JSONRPCRequest& request)
         // block).
         throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
 
-    if (verbosity <= 0)
-    {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
-    }
-
     return blockToJSON(block, pblockindex, verbosity >= 2);
 }
 
@@ -1001,6 +1029,71 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
     return true;
 }
 
+/**
+ * Full scan of the coins database into CUTXOSetStats, split by the first byte of the txid over
+ * several threads. All cursors are created under cs_main right after a flush, so they read the
+ * same snapshot of the database even though the scan itself runs without the lock.
+ */
+static bool ScanUTXOSetStats(CUTXOSetStats &stats, uint64_t &nTransactions, int &nHeight)
+{
+    int nThreads = std::max(1, std::min(GetNumCores(), 16));
+    std::vector<std::unique_ptr<CCoinsViewCursor> > vCursors;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        stats = CUTXOSetStats();
+        stats.hashBlock = pcoinsdbview->GetBestBlock();
+        BlockMap::const_iterator it = mapBlockIndex.find(stats.hashBlock);
+        nHeight = it == mapBlockIndex.end() ? 0 : it->second->nHeight;
+        for (int i = 0; i < nThreads; i++) {
+            uint256 hashStart;
+            *hashStart.begin() = (unsigned char)(i * 256 / nThreads);
+            vCursors.emplace_back(pcoinsdbview->Cursor(hashStart));
+        }
+    }
+
+    std::vector<CUTXOSetStats> vStats(nThreads);
+    std::vector<uint64_t> vTransactions(nThreads, 0);
+    std::vector<char> vOk(nThreads, 1);
+    std::vector<std::thread> vThreads;
+    for (int i = 0; i < nThreads; i++) {
+        vThreads.emplace_back([&, i]() {
+            const unsigned int nEnd = (i + 1) * 256 / nThreads;
+            CCoinsViewCursor* pcursor = vCursors[i].get();
+            uint256 prevkey;
+            while (pcursor->Valid()) {
+                COutPoint key;
+                Coin coin;
+                if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+                    vOk[i] = 0;
+                    return;
+                }
+                if (*key.hash.begin() >= nEnd)
+                    break;
+                if (vTransactions[i] == 0 || key.hash != prevkey) {
+                    vTransactions[i]++;
+                    prevkey = key.hash;
+                }
+                vStats[i].AddCoin(key, coin);
+                pcursor->Next();
+            }
+        });
+    }
+    for (std::thread& t : vThreads)
+        t.join();
+
+    nTransactions = 0;
+    for (int i = 0; i < nThreads; i++) {
+        if (!vOk[i])
+            return error("%s: unable to read value", __func__);
+        stats.nTransactionOutputs += vStats[i].nTransactionOutputs;
+        stats.nTotalAmount += vStats[i].nTotalAmount;
+        stats.muhash *= vStats[i].muhash;
+        nTransactions += vTransactions[i];
+    }
+    return true;
+}
+
 UniValue pruneblockchain(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -1052,28 +1145,90 @@ UniValue pruneblockchain(const JSONRPCRequest& request)
 
 UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 2)
         throw std::runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" verify )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Note this call may take some time, unless the rolling stats of -utxosetstats are used.\n"
+            "\nArguments:\n"
+            "1. \"hash_type\"  (string, optional, default=\"hash_serialized_2\") Which UTXO set hash to calculate, \"hash_serialized_2\" or \"muhash\".\n"
+            "                 \"muhash\" answers from the rolling stats kept with -utxosetstats, or scans the chainstate on all cores\n"
+            "2. verify        (boolean, optional, default=false) With \"muhash\", always scan and compare the result with the rolling stats\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
-            "  \"transactions\": n,      (numeric) The number of transactions\n"
+            "  \"transactions\": n,      (numeric) The number of transactions, only when the UTXO set was scanned\n"
             "  \"txouts\": n,            (numeric) The number of unspent transaction outputs\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash (only with \"hash_serialized_2\")\n"
+            "  \"muhash\": \"hash\",      (string) The rolling multiset hash (only with \"muhash\")\n"
             "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
-            "  \"total_amount\": x.xxx          (numeric) The total amount\n"
+            "  \"total_amount\": x.xxx,  (numeric) The total amount\n"
+            "  \"verified\": true|false  (boolean) Whether the scan matched the rolling stats (only with verify, when they are kept)\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "\"muhash\" true")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
+    std::string strHashType = "hash_serialized_2";
+    if (request.params.size() > 0 && !request.params[0].isNull())
+        strHashType = request.params[0].get_str();
+    bool fVerify = request.params.size() > 1 && !request.params[1].isNull() && request.params[1].get_bool();
+
     UniValue ret(UniValue::VOBJ);
 
+    if (strHashType == "muhash") {
+        CUTXOSetStats rolling;
+        bool fRolling;
+        int nHeight;
+        {
+            LOCK(cs_main);
+            fRolling = GetUTXOSetStats(rolling);
+            nHeight = chainActive.Height();
+        }
+
+        CUTXOSetStats stats;
+        if (fRolling && !fVerify) {
+            stats = rolling;
+        } else {
+            uint64_t nTransactions;
+            if (!ScanUTXOSetStats(stats, nTransactions, nHeight))
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+            {
+                LOCK(cs_main);
+                // the tip may have moved on during the scan, SetUTXOSetStats ignores those
+                CUTXOSetStats current;
+                if (!GetUTXOSetStats(current))
+                    SetUTXOSetStats(stats);
+            }
+            if (fRolling && rolling.hashBlock == stats.hashBlock) {
+                CUTXOSetStats copy = rolling;
+                uint256 hashRolling, hashScan;
+                copy.muhash.Finalize(hashRolling.begin());
+                CUTXOSetStats scan = stats;
+                scan.muhash.Finalize(hashScan.begin());
+                ret.push_back(Pair("verified", hashRolling == hashScan &&
+                                               rolling.nTransactionOutputs == stats.nTransactionOutputs &&
+                                               rolling.nTotalAmount == stats.nTotalAmount));
+            }
+            ret.push_back(Pair("transactions", (int64_t)nTransactions));
+        }
+
+        uint256 hashMuHash;
+        stats.muhash.Finalize(hashMuHash.begin());
+        ret.push_back(Pair("height", (int64_t)nHeight));
+        ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
+        ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
+        ret.push_back(Pair("muhash", hashMuHash.GetHex()));
+        ret.push_back(Pair("disk_size", pcoinsdbview->EstimateSize()));
+        ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+        return ret;
+    }
+    if (strHashType != "hash_serialized_2")
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown hash_type " + strHashType);
+
     CCoinsStats stats;
     FlushStateToDisk();
     if (GetUTXOStats(pcoinsdbview, stats)) {
@@ -1286,6 +1441,11 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
             "  \"chainwork\": \"xxxx\"     (string) total amount of work in active chain, in hexadecimal\n"
             "  \"pruned\": xx,             (boolean) if the blocks are subject to pruning\n"
             "  \"pruneheight\": xxxxxx,    (numeric) lowest-height complete block stored\n"
+            "  \"indexbuilder\": {         (object) only while -addressindex/-spentindex are built in the background\n"
+            "     \"addressindex\": xx,      (boolean) if the address index is being built\n"
+            "     \"spentindex\": xx,        (boolean) if the spent index is being built\n"
+            "     \"height\": xxxxxx         (numeric) the height the indexes are built up to\n"
+            "  },\n"
             "  \"softforks\": [            (array) status of softforks in progress\n"
             "     {\n"
             "        \"id\": \"xxxx\",        (string) name of softfork\n"
@@ -1351,6 +1511,16 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
 
         obj.push_back(Pair("pruneheight",        block->nHeight));
     }
+
+    bool fBuildingAddressIndex, fBuildingSpentIndex;
+    int nBuilderHeight;
+    if (GetIndexBuilderStatus(fBuildingAddressIndex, fBuildingSpentIndex, nBuilderHeight)) {
+        UniValue builder(UniValue::VOBJ);
+        builder.push_back(Pair("addressindex", fBuildingAddressIndex));
+        builder.push_back(Pair("spentindex", fBuildingSpentIndex));
+        builder.push_back(Pair("height", nBuilderHeight));
+        obj.push_back(Pair("indexbuilder", builder));
+    }
     return obj;
 }
 
@@ -1414,30 +1584,10 @@ UniValue getchaintips(const JSONRPCRequest& request)
     LOCK(cs_main);
 
     /*
-     * Idea:  the set of chain tips is chainActive.tip, plus orphan blocks which do not have another orphan building off of them.
-     * Algorithm:
-     *  - Make one pass through mapBlockIndex, picking out the orphan blocks, and also storing a set of the orphan block's pprev pointers.
-     *  - Iterate through the orphan blocks. If the block isn't pointed to by another orphan, it is a chain tip.
-     *  - add chainActive.Tip()
+     * The chain tips are the blocks nothing builds on, which validation keeps track of in setChainTips,
+     * plus chainActive.Tip() when there are headers on top of it already.
      */
-    std::set<const CBlockIndex*, CompareBlocksByHeight> setTips;
-    std::set<const CBlockIndex*> setOrphans;
-    std::set<const CBlockIndex*> setPrevs;
-
-    BOOST_FOREACH(const PAIRTYPE(const uint256, CBlockIndex*)& item, mapBlockIndex)
-    {
-        if (!chainActive.Contains(item.second)) {
-            setOrphans.insert(item.second);
-            setPrevs.insert(item.second->pprev);
-        }
-    }
-
-    for (std::set<const CBlockIndex*>::iterator it = setOrphans.begin(); it != setOrphans.end(); ++it)
-    {
-        if (setPrevs.erase(*it) == 0) {
-            setTips.insert(*it);
-        }
-    }
+    std::set<const CBlockIndex*, CompareBlocksByHeight> setTips(setChainTips.begin(), setChainTips.end());
 
     // Always report the currently active tip.
     setTips.insert(chainActive.Tip());
@@ -1534,6 +1684,299 @@ UniValue getmempoolinfo(const JSONRPCRequest& request)
     return mempoolInfoToJSON();
 }
 
+UniValue getblockprocessingstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1) {
+        throw std::runtime_error(
+            "getblockprocessingstats ( reset )\n"
+            "\nReturns the time spent in each stage of block processing since startup or the last reset.\n"
+            "All times are in microseconds. The percentiles since startup are rounded up to the next power\n"
+            "of two, the ones of the window of the last " + std::to_string(BLOCK_STATS_WINDOW) + " times are exact.\n"
+            "\nArguments:\n"
+            "1. reset        (boolean, optional, default=false) Clear the statistics after returning them\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"stage\": {           (string) Stage name, in processing order\n"
+            "    \"count\": n,        (numeric) Number of times the stage was run\n"
+            "    \"total\": n,        (numeric) Total time\n"
+            "    \"max\": n,          (numeric) Longest time\n"
+            "    \"p50\": n,          (numeric) Median time\n"
+            "    \"p99\": n,          (numeric) 99th percentile of the time\n"
+            "    \"last\": n,         (numeric) Time of the latest block\n"
+            "    \"window\": {        (json object) The last times only\n"
+            "      \"count\": n,      (numeric) Number of times in the window\n"
+            "      \"total\": n,      (numeric) Total time\n"
+            "      \"max\": n,        (numeric) Longest time\n"
+            "      \"p50\": n,        (numeric) Median time\n"
+            "      \"p99\": n         (numeric) 99th percentile of the time\n"
+            "    }\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockprocessingstats", "")
+            + HelpExampleRpc("getblockprocessingstats", "true")
+        );
+    }
+
+    bool fReset = request.params.size() > 0 && request.params[0].get_bool();
+
+    UniValue ret(UniValue::VOBJ);
+    for (const CBlockProcessingStageStats& stats : GetBlockProcessingStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("count", stats.nCount));
+        obj.push_back(Pair("total", stats.nTimeTotal));
+        obj.push_back(Pair("max", stats.nTimeMax));
+        obj.push_back(Pair("p50", stats.nTimeP50));
+        obj.push_back(Pair("p99", stats.nTimeP99));
+        obj.push_back(Pair("last", stats.nTimeLast));
+        UniValue window(UniValue::VOBJ);
+        window.push_back(Pair("count", (uint64_t)stats.nWindowCount));
+        window.push_back(Pair("total", stats.nWindowTotal));
+        window.push_back(Pair("max", stats.nWindowMax));
+        window.push_back(Pair("p50", stats.nWindowP50));
+        window.push_back(Pair("p99", stats.nWindowP99));
+        obj.push_back(Pair("window", window));
+        ret.push_back(Pair(stats.strStage, obj));
+    }
+    if (fReset) {
+        ResetBlockProcessingStats();
+    }
+
+    return ret;
+}
+
+UniValue replayblocks(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1) {
+        throw std::runtime_error(
+            "replayblocks ( nblocks )\n"
+            "\nDisconnects the last blocks of the active chain in memory and connects them again, like verifychain\n"
+            "at level 4 does, to benchmark block validation on the real chain. The proof-of-stake checks, the\n"
+            "masternode list and quorum commitment processing run like for new blocks, nothing is written.\n"
+            "All times are in microseconds. The chain is locked while replaying.\n"
+            "\nArguments:\n"
+            "1. nblocks      (numeric, optional, default=100) The number of blocks to replay\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"blocks\": n,          (numeric) Number of blocks replayed\n"
+            "  \"time\": n,            (numeric) Time spent connecting them\n"
+            "  \"blockspersec\": x.x,  (numeric) Blocks connected per second\n"
+            "  \"stages\": {\n"
+            "    \"stage\": {         (string) Stage name, see getblockprocessingstats\n"
+            "      \"count\": n,      (numeric) Number of times the stage was run\n"
+            "      \"total\": n,      (numeric) Total time\n"
+            "      \"perblock\": x.x  (numeric) Average time per replayed block\n"
+            "    },\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("replayblocks", "1000")
+            + HelpExampleRpc("replayblocks", "1000")
+        );
+    }
+
+    int nBlocks = request.params.size() > 0 ? request.params[0].get_int() : 100;
+    if (nBlocks <= 0 || nBlocks > MAX_REPLAY_BLOCKS) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("nblocks must be between 1 and %d", MAX_REPLAY_BLOCKS));
+    }
+
+    CBlockReplayResult result;
+    std::string strError;
+    if (!ReplayTipBlocks(Params(), nBlocks, result, strError)) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, strError);
+    }
+
+    UniValue stages(UniValue::VOBJ);
+    for (const CBlockProcessingStageStats& stats : result.vStages) {
+        if (stats.nCount == 0) continue;
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("count", stats.nCount));
+        obj.push_back(Pair("total", stats.nTimeTotal));
+        obj.push_back(Pair("perblock", (double)stats.nTimeTotal / result.nBlocks));
+        stages.push_back(Pair(stats.strStage, obj));
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("blocks", result.nBlocks));
+    ret.push_back(Pair("time", result.nTimeMicros));
+    ret.push_back(Pair("blockspersec", result.nTimeMicros > 0 ? result.nBlocks * 1000000.0 / result.nTimeMicros : 0.0));
+    ret.push_back(Pair("stages", stages));
+    return ret;
+}
+
+UniValue savemempool(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "savemempool\n"
+            "\nDumps the mempool to disk. It will fail until the previous dump is fully loaded.\n"
+            "\nExamples:\n"
+            + HelpExampleCli("savemempool", "")
+            + HelpExampleRpc("savemempool", "")
+        );
+
+    if (!fMempoolLoaded)
+        throw JSONRPCError(RPC_MISC_ERROR, "The mempool was not loaded yet");
+
+    if (!DumpMempool())
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to dump mempool to disk");
+
+    return NullUniValue;
+}
+
+static const uint32_t UTXO_SNAPSHOT_VERSION = 1;
+//! Coins are written in chunks of about this size, each prefixed with its number of coins
+static const size_t UTXO_SNAPSHOT_CHUNK_SIZE = 1 << 20;
+
+/**
+ * Snapshot file layout, everything in disk serialization:
+ * "utxo", version, network magic, block hash, height, the deterministic masternode list
+ * after that block, the number of active LLMQ commitments followed by (type, quorum hash,
+ * commitment, hash of the block it was mined in) for each, the chunks of (outpoint, coin)
+ * ended by an empty one, and the SHA256d of everything before.
+ */
+UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites the UTXO set, the deterministic masternode list and the active LLMQ commitments\n"
+            "at the current tip to a file, for bootstrapping other nodes.\n"
+            "\nArguments:\n"
+            "1. \"path\"          (string, required) The file to write, relative to the data directory\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"path\": \"xxxx\",         (string) The absolute path of the file\n"
+            "  \"height\": n,            (numeric) The height of the block the snapshot was taken at\n"
+            "  \"bestblock\": \"hex\",     (string) The hash of that block\n"
+            "  \"txouts\": n,            (numeric) The number of unspent outputs\n"
+            "  \"masternodes\": n,       (numeric) The number of deterministic masternodes\n"
+            "  \"commitments\": n,       (numeric) The number of LLMQ commitments\n"
+            "  \"muhash\": \"hex\",        (string) The hash of the UTXO set, as by gettxoutsetinfo \"muhash\"\n"
+            "  \"checksum\": \"hex\",      (string) The hash of the file contents stored at its end\n"
+            "  \"assumeutxo\": true|false (boolean) If the UTXO set matches the one hardcoded for that height\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    boost::filesystem::path path = boost::filesystem::absolute(request.params[0].get_str(), GetDataDir());
+    boost::filesystem::path pathTemp = path.string() + ".incomplete";
+    if (boost::filesystem::exists(path))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    const CBlockIndex* pindex;
+    CDeterministicMNList mnList;
+    std::vector<std::tuple<Consensus::LLMQType, llmq::CFinalCommitment, uint256>> vCommitments;
+    {
+        // the cursor reads the database as of now, so the rest can be done without the lock
+        LOCK(cs_main);
+        FlushStateToDisk();
+        pcursor.reset(pcoinsdbview->Cursor());
+        BlockMap::const_iterator it = mapBlockIndex.find(pcursor->GetBestBlock());
+        if (it == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Best block of the UTXO set not found");
+        pindex = it->second;
+        mnList = deterministicMNManager->GetListForBlock(pindex);
+        for (const auto& p : llmq::quorumBlockProcessor->GetMinedAndActiveCommitmentsUntilBlock(pindex)) {
+            for (const CBlockIndex* pindexQuorum : p.second) {
+                llmq::CFinalCommitment qc;
+                uint256 hashMinedBlock;
+                if (!llmq::quorumBlockProcessor->GetMinedCommitment(p.first, pindexQuorum->GetBlockHash(), qc, hashMinedBlock))
+                    throw JSONRPCError(RPC_INTERNAL_ERROR, "Mined commitment for quorum " + pindexQuorum->GetBlockHash().ToString() + " not found");
+                vCommitments.emplace_back(p.first, qc, hashMinedBlock);
+            }
+        }
+    }
+
+    FILE* filestr = fopen(pathTemp.string().c_str(), "wb");
+    if (!filestr)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unable to open " + pathTemp.string() + " for writing");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    auto flush = [&]() {
+        file.write(ss.data(), ss.size());
+        hasher.write(ss.data(), ss.size());
+        ss.clear();
+    };
+
+    CUTXOSetStats stats;
+    try {
+        ss.write("utxo", 4);
+        ss << UTXO_SNAPSHOT_VERSION;
+        ss.write((const char*)Params().MessageStart(), CMessageHeader::MESSAGE_START_SIZE);
+        ss << pindex->GetBlockHash() << pindex->nHeight;
+        ss << mnList;
+        ss << COMPACTSIZE((uint64_t)vCommitments.size());
+        for (const auto& c : vCommitments) {
+            ss << (uint8_t)std::get<0>(c) << std::get<1>(c).quorumHash << std::get<1>(c) << std::get<2>(c);
+        }
+        flush();
+
+        CDataStream chunk(SER_DISK, CLIENT_VERSION);
+        uint64_t nChunkCoins = 0;
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            COutPoint key;
+            Coin coin;
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(coin))
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+            stats.AddCoin(key, coin);
+            chunk << key << coin;
+            nChunkCoins++;
+            pcursor->Next();
+            if (chunk.size() >= UTXO_SNAPSHOT_CHUNK_SIZE || !pcursor->Valid()) {
+                ss << COMPACTSIZE(nChunkCoins);
+                ss.write(chunk.data(), chunk.size());
+                flush();
+                chunk.clear();
+                nChunkCoins = 0;
+            }
+        }
+        ss << COMPACTSIZE((uint64_t)0);
+        flush();
+
+        uint256 hashChecksum = hasher.GetHash();
+        file << hashChecksum;
+        FileCommit(file.Get());
+        file.fclose();
+        RenameOver(pathTemp, path);
+
+        uint256 hashMuHash;
+        stats.muhash.Finalize(hashMuHash.begin());
+        const MapAssumeutxo& mapAssumeutxo = Params().Assumeutxo();
+        MapAssumeutxo::const_iterator itAssume = mapAssumeutxo.find(pindex->nHeight);
+        bool fAssumeutxo = itAssume != mapAssumeutxo.end() && itAssume->second.hashBlock == pindex->GetBlockHash() &&
+                           itAssume->second.hashMuHash == hashMuHash;
+        LogPrintf("Dumped UTXO set at height %d with %u coins to %s\n", pindex->nHeight, stats.nTransactionOutputs, path.string());
+
+        UniValue ret(UniValue::VOBJ);
+        ret.push_back(Pair("path", path.string()));
+        ret.push_back(Pair("height", pindex->nHeight));
+        ret.push_back(Pair("bestblock", pindex->GetBlockHash().GetHex()));
+        ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
+        ret.push_back(Pair("masternodes", (int64_t)mnList.GetAllMNsCount()));
+        ret.push_back(Pair("commitments", (int64_t)vCommitments.size()));
+        ret.push_back(Pair("muhash", hashMuHash.GetHex()));
+        ret.push_back(Pair("checksum", hashChecksum.GetHex()));
+        ret.push_back(Pair("assumeutxo", fAssumeutxo));
+        return ret;
+    } catch (const std::ios_base::failure& e) {
+        file.fclose();
+        boost::filesystem::remove(pathTemp);
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("Unable to write %s: %s", pathTemp.string(), e.what()));
+    } catch (...) {
+        file.fclose();
+        boost::filesystem::remove(pathTemp);
+        throw;
+    }
+}
+
 UniValue preciousblock(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -1833,18 +2276,346 @@ UniValue getspecialtxes(const JSONRPCRequest& request)
     return result;
 }
 
+struct CBlockStats
+{
+    int nHeight{0};
+    uint256 hashBlock;
+    int64_t nTime{0};
+    bool fProofOfStake{false};
+    uint64_t nTxs{0};
+    uint64_t nSize{0};
+    uint64_t nInputs{0};
+    uint64_t nOutputs{0};
+    //! Of the transactions which paid fees, the reward transaction isn't counted
+    CAmount nTotalOut{0};
+    CAmount nTotalFee{0};
+    CAmount nMinFee{0};
+    CAmount nMaxFee{0};
+    CAmount nMinFeeRate{0};
+    CAmount nMaxFeeRate{0};
+    CAmount nFeeRatePercentiles[5]{};
+    //! What the miner or staker got on top of its inputs, fees included
+    CAmount nStakeReward{0};
+    CAmount nMasternodePayout{0};
+    CAmount nSuperblockPayout{0};
+    //! Anything else the reward transaction paid, like the generation output
+    CAmount nOtherPayout{0};
+    std::map<int, uint64_t> mapSpecialTxs;
+};
+
+/** What a block index entry is needed for, taken under cs_main so the stats can be computed without it */
+struct CBlockStatsJob
+{
+    const CBlockIndex* pindex;
+    CDiskBlockPos blockPos;
+    CDiskBlockPos undoPos;
+    uint256 hashPrevBlock;
+};
+
+static CBlockStatsJob GetBlockStatsJob(const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    if (fHavePruned && (!(pindex->nStatus & BLOCK_HAVE_DATA) || !(pindex->nStatus & BLOCK_HAVE_UNDO)))
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("Block %d not available (pruned data)", pindex->nHeight));
+    if (!pindex->pprev)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "The genesis block has no undo data");
+    if (!(pindex->nStatus & BLOCK_HAVE_UNDO))
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("Block %d was not connected yet", pindex->nHeight));
+    CBlockStatsJob job;
+    job.pindex = pindex;
+    job.blockPos = pindex->GetBlockPos();
+    job.undoPos = pindex->GetUndoPos();
+    job.hashPrevBlock = pindex->pprev->GetBlockHash();
+    return job;
+}
+
+/**
+ * Computes the stats of a block from the block and its undo data alone, the spent outputs come from
+ * the undo data so there is no need for a transaction index. Doesn't need cs_main, a block which was
+ * pruned in the meantime just fails to load.
+ */
+static bool ComputeBlockStats(const CBlockStatsJob& job, CBlockStats& stats)
+{
+    const CBlockIndex* pindex = job.pindex;
+    CBlock block;
+    CBlockUndo blockUndo;
+    if (!ReadBlockFromDisk(block, job.blockPos, Params().GetConsensus()))
+        return error("%s: can't read block %d from disk", __func__, pindex->nHeight);
+    if (!UndoReadFromDisk(blockUndo, job.undoPos, job.hashPrevBlock))
+        return error("%s: can't read undo data of block %d from disk", __func__, pindex->nHeight);
+    if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s: undo data of block %d doesn't match the block", __func__, pindex->nHeight);
+
+    stats.nHeight = pindex->nHeight;
+    stats.hashBlock = pindex->GetBlockHash();
+    stats.nTime = block.GetBlockTime();
+    stats.fProofOfStake = block.IsProofOfStake();
+    stats.nTxs = block.vtx.size();
+    stats.nSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+
+    // (feerate, size) of every transaction which paid from inputs
+    std::vector<std::pair<CAmount, uint64_t> > vFeeRates;
+    size_t nRewardTx = stats.fProofOfStake ? 1 : 0;
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        stats.nInputs += tx.IsCoinBase() ? 0 : tx.vin.size();
+        stats.nOutputs += tx.vout.size();
+        if (tx.nVersion == 3 && tx.nType != TRANSACTION_NORMAL)
+            stats.mapSpecialTxs[tx.nType]++;
+        if (i == 0 || i == nRewardTx)
+            continue;
+
+        const CTxUndo& txundo = blockUndo.vtxundo[i - 1];
+        if (txundo.vprevout.empty())
+            continue;
+        CAmount nValueIn = 0;
+        for (const Coin& coin : txundo.vprevout)
+            nValueIn += coin.out.nValue;
+        CAmount nValueOut = tx.GetValueOut();
+        CAmount nFee = nValueIn - nValueOut;
+        uint64_t nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+        CAmount nFeeRate = nTxSize > 0 ? nFee * 1000 / (CAmount)nTxSize : 0;
+
+        stats.nTotalOut += nValueOut;
+        stats.nTotalFee += nFee;
+        stats.nMinFee = vFeeRates.empty() ? nFee : std::min(stats.nMinFee, nFee);
+        stats.nMaxFee = vFeeRates.empty() ? nFee : std::max(stats.nMaxFee, nFee);
+        stats.nMinFeeRate = vFeeRates.empty() ? nFeeRate : std::min(stats.nMinFeeRate, nFeeRate);
+        stats.nMaxFeeRate = vFeeRates.empty() ? nFeeRate : std::max(stats.nMaxFeeRate, nFeeRate);
+        vFeeRates.emplace_back(nFeeRate, nTxSize);
+    }
+
+    // percentiles weighted by size, a large transaction counts for as much block space as it takes
+    if (!vFeeRates.empty()) {
+        static const int percentiles[5] = {10, 25, 50, 75, 90};
+        std::sort(vFeeRates.begin(), vFeeRates.end());
+        uint64_t nTotalWeight = 0;
+        for (const auto& p : vFeeRates)
+            nTotalWeight += p.second;
+        uint64_t nWeight = 0;
+        size_t nPercentile = 0;
+        for (const auto& p : vFeeRates) {
+            nWeight += p.second;
+            while (nPercentile < 5 && nWeight * 100 >= nTotalWeight * percentiles[nPercentile])
+                stats.nFeeRatePercentiles[nPercentile++] = p.first;
+        }
+        while (nPercentile < 5)
+            stats.nFeeRatePercentiles[nPercentile++] = vFeeRates.back().first;
+    }
+
+    std::vector<CBlockReward> vRewards;
+    GetBlockRewards(block, pindex, blockUndo, vRewards);
+    for (const CBlockReward& reward : vRewards) {
+        switch (reward.nType) {
+        case REWARD_STAKE: stats.nStakeReward += reward.nAmount; break;
+        case REWARD_MASTERNODE: stats.nMasternodePayout += reward.nAmount; break;
+        case REWARD_SUPERBLOCK: stats.nSuperblockPayout += reward.nAmount; break;
+        default: stats.nOtherPayout += reward.nAmount; break;
+        }
+    }
+    return true;
+}
+
+/**
+ * Computes the stats of all jobs on up to 16 threads, each takes the next block which is left
+ * until none are. Returns false if any of the blocks couldn't be read.
+ */
+static bool ComputeBlockStats(const std::vector<CBlockStatsJob>& vJobs, std::vector<CBlockStats>& vStats)
+{
+    vStats.assign(vJobs.size(), CBlockStats());
+    int nThreads = std::max(1, std::min({GetNumCores(), 16, (int)vJobs.size()}));
+    std::atomic<size_t> nNext{0};
+    std::atomic<bool> fOk{true};
+    std::vector<std::thread> vThreads;
+    for (int i = 0; i < nThreads; i++) {
+        vThreads.emplace_back([&]() {
+            for (size_t j = nNext++; j < vJobs.size() && fOk; j = nNext++) {
+                if (!ComputeBlockStats(vJobs[j], vStats[j]))
+                    fOk = false;
+            }
+        });
+    }
+    for (std::thread& t : vThreads)
+        t.join();
+    return fOk;
+}
+
+static std::string SpecialTxTypeName(int nType)
+{
+    switch (nType) {
+        case TRANSACTION_PROVIDER_REGISTER: return "proregtx";
+        case TRANSACTION_PROVIDER_UPDATE_SERVICE: return "proupservtx";
+        case TRANSACTION_PROVIDER_UPDATE_REGISTRAR: return "proupregtx";
+        case TRANSACTION_PROVIDER_UPDATE_REVOKE: return "prouprevtx";
+        case TRANSACTION_COINBASE: return "cbtx";
+        case TRANSACTION_QUORUM_COMMITMENT: return "qctx";
+        default: return strprintf("type%d", nType);
+    }
+}
+
+static UniValue BlockStatsToJSON(const CBlockStats& stats)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("height", stats.nHeight));
+    ret.push_back(Pair("blockhash", stats.hashBlock.GetHex()));
+    ret.push_back(Pair("time", stats.nTime));
+    ret.push_back(Pair("proofofstake", stats.fProofOfStake));
+    ret.push_back(Pair("txs", (uint64_t)stats.nTxs));
+    ret.push_back(Pair("size", (uint64_t)stats.nSize));
+    ret.push_back(Pair("ins", (uint64_t)stats.nInputs));
+    ret.push_back(Pair("outs", (uint64_t)stats.nOutputs));
+    ret.push_back(Pair("total_out", ValueFromAmount(stats.nTotalOut)));
+    ret.push_back(Pair("totalfee", ValueFromAmount(stats.nTotalFee)));
+    ret.push_back(Pair("minfee", ValueFromAmount(stats.nMinFee)));
+    ret.push_back(Pair("maxfee", ValueFromAmount(stats.nMaxFee)));
+    ret.push_back(Pair("minfeerate", ValueFromAmount(stats.nMinFeeRate)));
+    ret.push_back(Pair("maxfeerate", ValueFromAmount(stats.nMaxFeeRate)));
+    UniValue percentiles(UniValue::VARR);
+    for (CAmount nFeeRate : stats.nFeeRatePercentiles)
+        percentiles.push_back(ValueFromAmount(nFeeRate));
+    ret.push_back(Pair("feerate_percentiles", percentiles));
+    ret.push_back(Pair("stake_reward", ValueFromAmount(stats.nStakeReward)));
+    ret.push_back(Pair("masternode_payout", ValueFromAmount(stats.nMasternodePayout)));
+    ret.push_back(Pair("superblock_payout", ValueFromAmount(stats.nSuperblockPayout)));
+    ret.push_back(Pair("other_payout", ValueFromAmount(stats.nOtherPayout)));
+    UniValue specialTxs(UniValue::VOBJ);
+    for (const auto& p : stats.mapSpecialTxs)
+        specialTxs.push_back(Pair(SpecialTxTypeName(p.first), (uint64_t)p.second));
+    ret.push_back(Pair("special_txs", specialTxs));
+    return ret;
+}
+
+static const std::string strBlockStatsResultHelp =
+    "{\n"
+    "  \"height\": n,              (numeric) The height of the block\n"
+    "  \"blockhash\": \"hash\",      (string) The hash of the block\n"
+    "  \"time\": ttt,              (numeric) The block time in seconds since epoch (Jan 1 1970 GMT)\n"
+    "  \"proofofstake\": true|false, (boolean) Whether the block is proof of stake\n"
+    "  \"txs\": n,                 (numeric) The number of transactions, coinbase and coinstake included\n"
+    "  \"size\": n,                (numeric) The block size in bytes\n"
+    "  \"ins\": n,                 (numeric) The number of inputs, the coinbase's excluded\n"
+    "  \"outs\": n,                (numeric) The number of outputs\n"
+    "  \"total_out\": x.xxx,       (numeric) The value of the outputs of the transactions which paid fees\n"
+    "  \"totalfee\": x.xxx,        (numeric) The fees of all transactions\n"
+    "  \"minfee\": x.xxx,          (numeric) The lowest fee a transaction paid\n"
+    "  \"maxfee\": x.xxx,          (numeric) The highest fee a transaction paid\n"
+    "  \"minfeerate\": x.xxx,      (numeric) The lowest feerate in " + CURRENCY_UNIT + " per kB\n"
+    "  \"maxfeerate\": x.xxx,      (numeric) The highest feerate in " + CURRENCY_UNIT + " per kB\n"
+    "  \"feerate_percentiles\": [  (array of numeric) The feerates at the 10th, 25th, 50th, 75th and 90th percentile of the block space\n"
+    "     x.xxx, ...\n"
+    "  ],\n"
+    "  \"stake_reward\": x.xxx,    (numeric) What the miner or staker received on top of its inputs, fees included\n"
+    "  \"masternode_payout\": x.xxx, (numeric) The payout to the masternode and its operator\n"
+    "  \"superblock_payout\": x.xxx, (numeric) The payouts of a superblock\n"
+    "  \"other_payout\": x.xxx,    (numeric) Any other output of the reward transaction\n"
+    "  \"special_txs\": {          (json object) The number of special transactions by type\n"
+    "     \"type\": n, ...\n"
+    "  }\n"
+    "}\n";
+
+UniValue getblockstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "getblockstats hash_or_height\n"
+            "\nComputes the fee, payout and transaction statistics of a block from the block and its undo data.\n"
+            "\nArguments:\n"
+            "1. \"hash_or_height\"     (string or numeric, required) The block hash or height\n"
+            "\nResult:\n"
+            + strBlockStatsResultHelp +
+            "\nExamples:\n"
+            + HelpExampleCli("getblockstats", "1000")
+            + HelpExampleRpc("getblockstats", "1000")
+        );
+
+    std::vector<CBlockStatsJob> vJobs;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindex;
+        // the command line passes heights as strings, which are never as long as a hash
+        const UniValue& param = request.params[0];
+        int32_t nHeight = 0;
+        if (param.isNum() || (param.get_str().size() < 64 && ParseInt32(param.get_str(), &nHeight))) {
+            if (param.isNum())
+                nHeight = param.get_int();
+            if (nHeight < 0 || nHeight > chainActive.Height())
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+            pindex = chainActive[nHeight];
+        } else {
+            uint256 hash(ParseHashV(param, "hash_or_height"));
+            BlockMap::const_iterator it = mapBlockIndex.find(hash);
+            if (it == mapBlockIndex.end())
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+            pindex = it->second;
+        }
+        vJobs.push_back(GetBlockStatsJob(pindex));
+    }
+
+    std::vector<CBlockStats> vStats;
+    if (!ComputeBlockStats(vJobs, vStats))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    return BlockStatsToJSON(vStats[0]);
+}
+
+UniValue getblockstatsrange(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 2)
+        throw std::runtime_error(
+            "getblockstatsrange start end\n"
+            "\nComputes the statistics of getblockstats for the blocks of the active chain from height start to end,\n"
+            "both included. The blocks are processed in parallel.\n"
+            "\nArguments:\n"
+            "1. start      (numeric, required) The height of the first block\n"
+            "2. end        (numeric, required) The height of the last block\n"
+            "\nResult:\n"
+            "[\n"
+            "  {...},      (json object) The statistics of each block as returned by getblockstats, in order of height\n"
+            "  ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockstatsrange", "1000 2000")
+            + HelpExampleRpc("getblockstatsrange", "1000, 2000")
+        );
+
+    int nStart = request.params[0].get_int();
+    int nEnd = request.params[1].get_int();
+
+    std::vector<CBlockStatsJob> vJobs;
+    {
+        LOCK(cs_main);
+        if (nStart < 1 || nEnd > chainActive.Height() || nStart > nEnd)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+        vJobs.reserve(nEnd - nStart + 1);
+        for (int nHeight = nStart; nHeight <= nEnd; nHeight++)
+            vJobs.push_back(GetBlockStatsJob(chainActive[nHeight]));
+    }
+
+    std::vector<CBlockStats> vStats;
+    if (!ComputeBlockStats(vJobs, vStats))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+
+    UniValue ret(UniValue::VARR);
+    for (const CBlockStats& stats : vStats)
+        ret.push_back(BlockStatsToJSON(stats));
+    return ret;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         okSafe argNames
   //  --------------------- ------------------------  -----------------------  ------ ----------
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           true,  {"path"} },
     { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true,  {} },
     { "blockchain",         "getchaintxstats",        &getchaintxstats,        true,  {"nblocks", "blockhash"} },
     { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,  {} },
     { "blockchain",         "getblockcount",          &getblockcount,          true,  {} },
     { "blockchain",         "getblock",               &getblock,               true,  {"blockhash","verbosity|verbose"} },
     { "blockchain",         "getblockhashes",         &getblockhashes,         true,  {"high","low"} },
+    { "blockchain",         "getblockprocessingstats", &getblockprocessingstats, true, {"reset"} },
     { "blockchain",         "getblockhash",           &getblockhash,           true,  {"height"} },
     { "blockchain",         "getblockheader",         &getblockheader,         true,  {"blockhash","verbose"} },
     { "blockchain",         "getblockheaders",        &getblockheaders,        true,  {"blockhash","count","verbose"} },
+    { "blockchain",         "getblockstats",          &getblockstats,          true,  {"hash_or_height"} },
+    { "blockchain",         "getblockstatsrange",     &getblockstatsrange,     true,  {"start","end"} },
     { "blockchain",         "getchaintips",           &getchaintips,           true,  {"count","branchlen"} },
     { "blockchain",         "getdifficulty",          &getdifficulty,          true,  {} },
     { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    true,  {"txid","verbose"} },
@@ -1854,8 +2625,9 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getrawmempool",          &getrawmempool,          true,  {"verbose"} },
     { "blockchain",         "getspecialtxes",         &getspecialtxes,         true,  {"blockhash", "type", "count", "skip", "verbosity"} },
     { "blockchain",         "gettxout",               &gettxout,               true,  {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {"hash_type","verify"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        true,  {"height"} },
+    { "blockchain",         "savemempool",            &savemempool,            true,  {} },
     { "blockchain",         "verifychain",            &verifychain,            true,  {"checklevel","nblocks"} },
 
     { "blockchain",         "preciousblock",          &preciousblock,          true,  {"blockhash"} },
@@ -1863,6 +2635,7 @@ static const CRPCCommand commands[] =
     /* Not shown in help */
     { "hidden",             "invalidateblock",        &invalidateblock,        true,  {"blockhash"} },
     { "hidden",             "reconsiderblock",        &reconsiderblock,        true,  {"blockhash"} },
+    { "hidden",             "replayblocks",           &replayblocks,           true,  {"nblocks"} },
     { "hidden",             "waitfornewblock",        &waitfornewblock,        true,  {"timeout"} },
     { "hidden",             "waitforblock",           &waitforblock,           true,  {"blockhash","timeout"} },
     { "hidden",             "waitforblockheight",     &waitforblockheight,     true,  {"height","timeout"} },
@@ -1872,4 +2645,5 @@ void RegisterBlockchainRPCCommands(CRPCTable &t)
 {
     for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
         t.appendCommand(commands[vcidx].name, &commands[vcidx]);
+    t.appendStreamer("getrawmempool", &getrawmempool_stream);
 }
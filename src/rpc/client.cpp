@@ -32,6 +32,8 @@ public:
 static const CRPCConvertParam vRPCConvertParams[] =
 {
     { "setmocktime", 0, "timestamp" },
+    { "getlockstats", 0, "samplerate" },
+    { "getlockstats", 1, "reset" },
 #if ENABLE_MINER
     { "generate", 0, "nblocks" },
     { "generate", 1, "maxtries" },
@@ -85,6 +87,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "listaccounts", 2, "include_watchonly" },
     { "walletpassphrase", 1, "timeout" },
     { "walletpassphrase", 2, "mixingonly" },
+    { "walletpassphrase", 3, "stakingonly" },
     { "getblocktemplate", 0, "template_request" },
     { "listsinceblock", 1, "target_confirmations" },
     { "listsinceblock", 2, "include_watchonly" },
@@ -97,6 +100,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "addmultisigaddress", 0, "nrequired" },
     { "addmultisigaddress", 1, "keys" },
     { "createmultisig", 0, "nrequired" },
+    { "generatehdwallets", 0, "count" },
+    { "generatehdwallets", 2, "accounts" },
+    { "generatehdwallets", 3, "keys" },
     { "createmultisig", 1, "keys" },
     { "listunspent", 0, "minconf" },
     { "listunspent", 1, "maxconf" },
@@ -106,6 +112,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getblockheader", 1, "verbose" },
     { "getblockheaders", 1, "count" },
     { "getblockheaders", 2, "verbose" },
+    { "getblockstatsrange", 0, "start" },
+    { "getblockstatsrange", 1, "end" },
     { "gettransaction", 1, "include_watchonly" },
     { "getrawtransaction", 1, "verbose" },
     { "createrawtransaction", 0, "inputs" },
@@ -116,10 +124,17 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "sendrawtransaction", 1, "allowhighfees" },
     { "sendrawtransaction", 2, "instantsend" },
     { "sendrawtransaction", 3, "bypasslimits" },
+    { "sendrawtransactions", 0, "hexstrings" },
+    { "sendrawtransactions", 1, "allowhighfees" },
+    { "sendrawtransactions", 2, "bypasslimits" },
     { "fundrawtransaction", 1, "options" },
     { "gettxout", 1, "n" },
     { "gettxout", 2, "include_mempool" },
+    { "gettxoutsetinfo", 1, "verify" },
+    { "getblockprocessingstats", 0, "reset" },
+    { "replayblocks", 0, "nblocks" },
     { "gettxoutproof", 0, "txids" },
+    { "gettxoutproofs", 0, "txids" },
     { "lockunspent", 0, "unlock" },
     { "lockunspent", 1, "transactions" },
     { "importprivkey", 2, "rescan" },
@@ -140,6 +155,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "setban", 2, "bantime" },
     { "setban", 3, "absolute" },
     { "setnetworkactive", 0, "state" },
+    { "getmessagestats", 0, "reset" },
     { "setprivatesendrounds", 0, "rounds" },
     { "setprivatesendamount", 0, "amount" },
     { "getmempoolancestors", 1, "verbose" },
@@ -153,6 +169,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getaddresstxids", 0, "addresses" },
     { "getaddressbalance", 0, "addresses" },
     { "getaddressdeltas", 0, "addresses" },
+    { "getrewards", 0, "addresses" },
     { "getaddressutxos", 0, "addresses" },
     { "getaddressmempool", 0, "addresses" },
     { "getspecialtxes", 1, "type" },
@@ -0,0 +1,206 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonwriter.h"
+
+#include <univalue.h>
+
+#include <assert.h>
+#include <iomanip>
+#include <sstream>
+#include <stdio.h>
+
+CJSONWriter::CJSONWriter(const Sink& sinkIn, size_t nChunkSizeIn) :
+    sink(sinkIn), nChunkSize(nChunkSizeIn), fFlushed(false), fAfterKey(false)
+{
+    strBuffer.reserve(nChunkSize + 1024);
+}
+
+void CJSONWriter::BeginValue()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vFirst.empty()) {
+        if (!vFirst.back())
+            strBuffer += ',';
+        vFirst.back() = false;
+    }
+}
+
+void CJSONWriter::Written()
+{
+    if (strBuffer.size() >= nChunkSize)
+        Flush();
+}
+
+void CJSONWriter::WriteString(const std::string& str)
+{
+    // Same escapes as univalue_escapes.h
+    strBuffer += '"';
+    for (unsigned char ch : str) {
+        switch (ch) {
+        case '"': strBuffer += "\\\""; break;
+        case '\\': strBuffer += "\\\\"; break;
+        case '\b': strBuffer += "\\b"; break;
+        case '\t': strBuffer += "\\t"; break;
+        case '\n': strBuffer += "\\n"; break;
+        case '\f': strBuffer += "\\f"; break;
+        case '\r': strBuffer += "\\r"; break;
+        default:
+            if (ch < 0x20 || ch == 0x7f) {
+                char buf[7];
+                snprintf(buf, sizeof(buf), "\\u%04x", ch);
+                strBuffer += buf;
+            } else {
+                strBuffer += (char)ch;
+            }
+        }
+    }
+    strBuffer += '"';
+}
+
+CJSONWriter& CJSONWriter::BeginObject()
+{
+    BeginValue();
+    strBuffer += '{';
+    vFirst.push_back(true);
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::EndObject()
+{
+    assert(!vFirst.empty() && !fAfterKey);
+    vFirst.pop_back();
+    strBuffer += '}';
+    Written();
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::BeginArray()
+{
+    BeginValue();
+    strBuffer += '[';
+    vFirst.push_back(true);
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::EndArray()
+{
+    assert(!vFirst.empty() && !fAfterKey);
+    vFirst.pop_back();
+    strBuffer += ']';
+    Written();
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Key(const std::string& key)
+{
+    assert(!vFirst.empty() && !fAfterKey);
+    BeginValue();
+    WriteString(key);
+    strBuffer += ':';
+    fAfterKey = true;
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Null()
+{
+    BeginValue();
+    strBuffer += "null";
+    Written();
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Value(bool val)
+{
+    BeginValue();
+    strBuffer += val ? "true" : "false";
+    Written();
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Value(int64_t val)
+{
+    BeginValue();
+    strBuffer += std::to_string(val);
+    Written();
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Value(uint64_t val)
+{
+    BeginValue();
+    strBuffer += std::to_string(val);
+    Written();
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Value(double val)
+{
+    // Like UniValue::setFloat
+    std::ostringstream oss;
+    oss << std::setprecision(16) << val;
+    BeginValue();
+    strBuffer += oss.str();
+    Written();
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Value(const std::string& val)
+{
+    BeginValue();
+    WriteString(val);
+    Written();
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Value(const UniValue& val)
+{
+    switch (val.getType()) {
+    case UniValue::VNULL:
+        return Null();
+    case UniValue::VBOOL:
+        return Value(val.get_bool());
+    case UniValue::VSTR:
+        return Value(val.get_str());
+    case UniValue::VNUM:
+        BeginValue();
+        strBuffer += val.getValStr();
+        Written();
+        return *this;
+    case UniValue::VOBJ: {
+        BeginObject();
+        const std::vector<std::string>& keys = val.getKeys();
+        const std::vector<UniValue>& values = val.getValues();
+        for (size_t i = 0; i < keys.size(); i++)
+            Key(keys[i]).Value(values[i]);
+        return EndObject();
+    }
+    case UniValue::VARR:
+        BeginArray();
+        for (const UniValue& v : val.getValues())
+            Value(v);
+        return EndArray();
+    }
+    assert(false);
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Raw(const std::string& str)
+{
+    strBuffer += str;
+    Written();
+    return *this;
+}
+
+void CJSONWriter::Flush()
+{
+    if (strBuffer.empty())
+        return;
+    sink(strBuffer.data(), strBuffer.size());
+    strBuffer.clear();
+    fFlushed = true;
+}
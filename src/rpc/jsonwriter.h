@@ -0,0 +1,77 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_JSONWRITER_H
+#define BITCOIN_RPC_JSONWRITER_H
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class UniValue;
+
+/**
+ * Writes JSON to a sink in chunks as it is produced, instead of building a UniValue tree and
+ * one string of the whole document first.
+ *
+ * The output is byte for byte what UniValue::write() without indentation gives for the same
+ * values, including the escaping of strings and the formatting of numbers, so a method can
+ * switch to it without clients noticing. Parts that are still built as UniValue can be written
+ * with Value(const UniValue&).
+ *
+ * Nothing reaches the sink until nChunkSize bytes are buffered or Flush() is called, so the
+ * caller can still throw the output away as long as HasFlushed() returns false.
+ */
+class CJSONWriter
+{
+public:
+    typedef std::function<void(const char* data, size_t size)> Sink;
+
+    static const size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    explicit CJSONWriter(const Sink& sinkIn, size_t nChunkSizeIn = DEFAULT_CHUNK_SIZE);
+
+    CJSONWriter& BeginObject();
+    CJSONWriter& EndObject();
+    CJSONWriter& BeginArray();
+    CJSONWriter& EndArray();
+    //! The key of the next value, only inside an object
+    CJSONWriter& Key(const std::string& key);
+
+    CJSONWriter& Null();
+    CJSONWriter& Value(bool val);
+    CJSONWriter& Value(int val) { return Value((int64_t)val); }
+    CJSONWriter& Value(unsigned int val) { return Value((uint64_t)val); }
+    CJSONWriter& Value(int64_t val);
+    CJSONWriter& Value(uint64_t val);
+    CJSONWriter& Value(double val);
+    CJSONWriter& Value(const char* val) { return Value(std::string(val)); }
+    CJSONWriter& Value(const std::string& val);
+    CJSONWriter& Value(const UniValue& val);
+
+    //! Append text as it is, like the newline after a JSON-RPC reply
+    CJSONWriter& Raw(const std::string& str);
+
+    //! Pass everything buffered to the sink
+    void Flush();
+    bool HasFlushed() const { return fFlushed; }
+    //! What was not passed to the sink yet
+    const std::string& GetBuffer() const { return strBuffer; }
+
+private:
+    Sink sink;
+    size_t nChunkSize;
+    std::string strBuffer;
+    bool fFlushed;
+    //! For each open object or array, whether it has no elements yet
+    std::vector<bool> vFirst;
+    bool fAfterKey;
+
+    void BeginValue();
+    void WriteString(const std::string& str);
+    void Written();
+};
+
+#endif // BITCOIN_RPC_JSONWRITER_H
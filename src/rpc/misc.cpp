@@ -7,9 +7,13 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "base58.h"
+#include "bip39.h"
 #include "clientversion.h"
+#include "dbwrapper.h"
+#include "hdchain.h"
 #include "init.h"
 #include "feerates.h"
+#include "httpserver.h"
 #include "net.h"
 #include "netbase.h"
 #include "rpc/server.h"
@@ -24,9 +28,15 @@
 #include "wallet/walletdb.h"
 #endif
 
+#include "governance.h"
 #include "masternode-sync.h"
+#include "net_processing.h"
 #include "spork.h"
 
+#include "evo/deterministicmns.h"
+#include "llmq/quorums_instantsend.h"
+#include "llmq/quorums_signing_shares.h"
+
 #include <stdint.h>
 
 #include <boost/assign/list_of.hpp>
@@ -612,6 +622,127 @@ UniValue signmessagewithprivkey(const JSONRPCRequest& request)
     return EncodeBase64(&vchSig[0], vchSig.size());
 }
 
+UniValue generatehdwallets(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 4)
+        throw std::runtime_error(
+            "generatehdwallets count ( \"mnemonicpassphrase\" accounts keys )\n"
+            "\nGenerates new HD wallets for provisioning, without storing them anywhere. Seeds and keys are derived\n"
+            "in parallel. A wallet can later be created from its mnemonic with -mnemonic and -mnemonicpassphrase.\n"
+            "\nArguments:\n"
+            "1. count                  (numeric, required) Number of wallets to generate, at most 1000\n"
+            "2. \"mnemonicpassphrase\"   (string, optional, default=\"\") The mnemonic passphrase for all of them (bip39)\n"
+            "3. accounts               (numeric, optional, default=1) Number of accounts to derive per wallet, at most 100\n"
+            "4. keys                   (numeric, optional, default=1) Number of external addresses to derive per account, at most 1000\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"hdchainid\": \"hash\",       (string) The ID of the HD chain\n"
+            "    \"mnemonic\": \"words\",       (string) The mnemonic (bip39, english words)\n"
+            "    \"accounts\": [\n"
+            "      {\n"
+            "        \"account\": n,            (numeric) The account index\n"
+            "        \"xpub\": \"key\",         (string) The extended public key of the account (bip44)\n"
+            "        \"addresses\": [ ... ]     (array of string) The first external addresses of the account\n"
+            "      }, ...\n"
+            "    ]\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("generatehdwallets", "100")
+            + HelpExampleCli("generatehdwallets", "10 \"\" 2 5")
+            + HelpExampleRpc("generatehdwallets", "100")
+        );
+
+    int nCount = request.params[0].get_int();
+    if (nCount < 1 || nCount > 1000)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "count must be between 1 and 1000");
+
+    SecureString ssMnemonicPassphrase;
+    if (request.params.size() > 1)
+        ssMnemonicPassphrase = SecureString(request.params[1].get_str().begin(), request.params[1].get_str().end());
+
+    int nAccounts = request.params.size() > 2 ? request.params[2].get_int() : 1;
+    if (nAccounts < 1 || nAccounts > 100)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "accounts must be between 1 and 100");
+
+    int nKeys = request.params.size() > 3 ? request.params[3].get_int() : 1;
+    if (nKeys < 0 || nKeys > 1000)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "keys must be between 0 and 1000");
+
+    struct Account {
+        std::string strXpub;
+        std::vector<std::string> vecAddresses;
+    };
+    struct Wallet {
+        SecureString ssMnemonic;
+        uint256 id;
+        std::vector<Account> vecAccounts;
+    };
+
+    // the randomness comes from this thread, only the derivation is spread over the others
+    std::vector<Wallet> vecWallets(nCount);
+    for (auto& wallet : vecWallets) {
+        wallet.ssMnemonic = CMnemonic::Generate(256);
+    }
+
+    std::atomic<int> nNext{0};
+    auto derive = [&]() {
+        for (int i = nNext++; i < nCount; i = nNext++) {
+            Wallet& wallet = vecWallets[i];
+            CHDChain hdChain;
+            hdChain.SetMnemonic(wallet.ssMnemonic, ssMnemonicPassphrase, true);
+            wallet.id = hdChain.GetID();
+            wallet.vecAccounts.resize(nAccounts);
+            for (int j = 0; j < nAccounts; j++) {
+                CExtKey accountKey;
+                CExtKey externalKey;
+                hdChain.DeriveAccountExtKey(j, accountKey);
+                accountKey.Derive(externalKey, 0);
+                wallet.vecAccounts[j].strXpub = CBitcoinExtPubKey(accountKey.Neuter()).ToString();
+                for (int k = 0; k < nKeys; k++) {
+                    CExtKey childKey;
+                    externalKey.Derive(childKey, k);
+                    wallet.vecAccounts[j].vecAddresses.emplace_back(CBitcoinAddress(childKey.key.GetPubKey().GetID()).ToString());
+                }
+            }
+        }
+    };
+
+    int nThreads = std::max(1, std::min(GetNumCores(), nCount));
+    std::vector<std::thread> vecThreads;
+    for (int i = 1; i < nThreads; i++) {
+        vecThreads.emplace_back(derive);
+    }
+    derive();
+    for (auto& t : vecThreads) {
+        t.join();
+    }
+
+    UniValue result(UniValue::VARR);
+    for (const auto& wallet : vecWallets) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("hdchainid", wallet.id.GetHex()));
+        obj.push_back(Pair("mnemonic", wallet.ssMnemonic.c_str()));
+        UniValue accounts(UniValue::VARR);
+        for (size_t j = 0; j < wallet.vecAccounts.size(); j++) {
+            UniValue account(UniValue::VOBJ);
+            account.push_back(Pair("account", (int)j));
+            account.push_back(Pair("xpub", wallet.vecAccounts[j].strXpub));
+            UniValue addresses(UniValue::VARR);
+            for (const auto& strAddress : wallet.vecAccounts[j].vecAddresses) {
+                addresses.push_back(strAddress);
+            }
+            account.push_back(Pair("addresses", addresses));
+            accounts.push_back(account);
+        }
+        obj.push_back(Pair("accounts", accounts));
+        result.push_back(obj);
+    }
+
+    return result;
+}
+
 UniValue setmocktime(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -697,6 +828,91 @@ bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
     return a.second.time < b.second.time;
 }
 
+/**
+ * Paging for the address index RPCs: with a "limit" in the request at most that many entries
+ * are returned, plus a "cursor" to pass with the next request as long as there are more.
+ * Returns false if the request doesn't ask for paging.
+ */
+template <typename Key>
+bool getPagingFromParams(const UniValue& params, const std::vector<std::pair<uint160, int> > &addresses,
+                         size_t &nLimit, Key &keyCursor, size_t &nFirstAddress)
+{
+    nLimit = 0;
+    nFirstAddress = 0;
+    keyCursor.SetNull();
+
+    if (!params[0].isObject()) {
+        return false;
+    }
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    if (limitValue.isNull()) {
+        return false;
+    }
+    if (!limitValue.isNum() || limitValue.get_int() <= 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Limit is expected to be a positive number");
+    }
+    nLimit = limitValue.get_int();
+
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (cursorValue.isNull()) {
+        return true;
+    }
+    if (!cursorValue.isStr() || !IsHex(cursorValue.get_str())) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    CDataStream ss(ParseHex(cursorValue.get_str()), SER_DISK, CLIENT_VERSION);
+    try {
+        ss >> keyCursor;
+    } catch (const std::exception&) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+
+    // addresses are read one after the other, so resume with the address the cursor points into
+    for (; nFirstAddress < addresses.size(); nFirstAddress++) {
+        if (addresses[nFirstAddress].first == keyCursor.hashBytes && addresses[nFirstAddress].second == (int)keyCursor.type) {
+            return true;
+        }
+    }
+    throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor doesn't belong to any of the addresses");
+}
+
+/**
+ * Read the entries of all addresses through readAddress(address, pkeyFrom, nMaxEntries), and
+ * when paging, stop after nLimit entries and return the key of the next entry in keyCursor
+ */
+template <typename Key, typename Value, typename ReadAddress>
+bool readAddressPage(const std::vector<std::pair<uint160, int> > &addresses, size_t nLimit, size_t nFirstAddress,
+                     Key &keyCursor, std::vector<std::pair<Key, Value> > &entries, ReadAddress readAddress)
+{
+    for (size_t i = nFirstAddress; i < addresses.size() && (nLimit == 0 || entries.size() <= nLimit); i++) {
+        const Key* pkeyFrom = (i == nFirstAddress && !keyCursor.hashBytes.IsNull()) ? &keyCursor : nullptr;
+        size_t nMaxEntries = nLimit == 0 ? 0 : nLimit + 1 - entries.size();
+        if (!readAddress(addresses[i], pkeyFrom, nMaxEntries)) {
+            return false;
+        }
+    }
+
+    keyCursor.SetNull();
+    if (nLimit != 0 && entries.size() > nLimit) {
+        keyCursor = entries[nLimit].first;
+        entries.erase(entries.begin() + nLimit, entries.end());
+    }
+    return true;
+}
+
+template <typename Key>
+UniValue pagedResult(const std::string& strName, const UniValue& entries, const Key& keyCursor)
+{
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair(strName, entries));
+    if (!keyCursor.hashBytes.IsNull()) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << keyCursor;
+        result.push_back(Pair("cursor", HexStr(ss.begin(), ss.end())));
+    }
+    return result;
+}
+
 UniValue getaddressmempool(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -781,6 +997,8 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
             "      \"address\"  (string) The base58check encoded address\n"
             "      ,...\n"
             "    ]\n"
+            "  \"limit\" (number, optional) Return at most this many entries and a cursor for the rest\n"
+            "  \"cursor\" (string, optional) The cursor returned by the previous request with the same addresses\n"
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -793,8 +1011,14 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
             "    \"height\"  (number) The block height\n"
             "  }\n"
             "]\n"
+            "\nResult with limit (entries in index order instead of sorted by height):\n"
+            "{\n"
+            "  \"utxos\"  (array) The unspent outputs as above\n"
+            "  \"cursor\"  (string) Only if there are more, the cursor for the next request\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 1000}'")
             + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -804,15 +1028,23 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    size_t nLimit, nFirstAddress;
+    CAddressUnspentKey keyCursor;
+    bool fPaging = getPagingFromParams(request.params, addresses, nLimit, keyCursor, nFirstAddress);
+
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
+    auto readAddress = [&](const std::pair<uint160, int>& address, const CAddressUnspentKey* pkeyFrom, size_t nMaxEntries) {
+        return GetAddressUnspent(address.first, address.second, unspentOutputs, pkeyFrom, nMaxEntries);
+    };
+    if (!readAddressPage(addresses, nLimit, nFirstAddress, keyCursor, unspentOutputs, readAddress)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
     }
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    // pages have to be in index order to be resumable
+    if (!fPaging) {
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    }
 
     UniValue result(UniValue::VARR);
 
@@ -832,6 +1064,9 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
         result.push_back(output);
     }
 
+    if (fPaging) {
+        return pagedResult("utxos", result, keyCursor);
+    }
     return result;
 }
 
@@ -850,6 +1085,8 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return at most this many entries and a cursor for the rest\n"
+            "  \"cursor\" (string, optional) The cursor returned by the previous request with the same addresses\n"
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -862,8 +1099,14 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
             "    \"address\"  (string) The base58check encoded address\n"
             "  }\n"
             "]\n"
+            "\nResult with limit:\n"
+            "{\n"
+            "  \"deltas\"  (array) The deltas as above\n"
+            "  \"cursor\"  (string) Only if there are more, the cursor for the next request\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 1000}'")
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -888,18 +1131,20 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    size_t nLimit, nFirstAddress;
+    CAddressIndexKey keyCursor;
+    bool fPaging = getPagingFromParams(request.params, addresses, nLimit, keyCursor, nFirstAddress);
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+    auto readAddress = [&](const std::pair<uint160, int>& address, const CAddressIndexKey* pkeyFrom, size_t nMaxEntries) {
         if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
+            return GetAddressIndex(address.first, address.second, addressIndex, start, end, pkeyFrom, nMaxEntries);
         }
+        return GetAddressIndex(address.first, address.second, addressIndex, 0, 0, pkeyFrom, nMaxEntries);
+    };
+    if (!readAddressPage(addresses, nLimit, nFirstAddress, keyCursor, addressIndex, readAddress)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
     }
 
     UniValue result(UniValue::VARR);
@@ -920,6 +1165,106 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         result.push_back(delta);
     }
 
+    if (fPaging) {
+        return pagedResult("deltas", result, keyCursor);
+    }
+    return result;
+}
+
+UniValue getrewards(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1 || !request.params[0].isObject())
+        throw std::runtime_error(
+            "getrewards\n"
+            "\nReturns the block rewards paid to an address (requires rewardindex to be enabled).\n"
+            "\nArguments:\n"
+            "{\n"
+            "  \"addresses\"\n"
+            "    [\n"
+            "      \"address\"  (string) The base58check encoded address\n"
+            "      ,...\n"
+            "    ]\n"
+            "  \"start\" (number, optional) The start block height\n"
+            "  \"end\" (number, optional) The end block height\n"
+            "  \"limit\" (number, optional) Return at most this many entries and a cursor for the rest\n"
+            "  \"cursor\" (string, optional) The cursor returned by the previous request with the same addresses\n"
+            "}\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"address\"  (string) The base58check encoded address\n"
+            "    \"height\"  (number) The block height\n"
+            "    \"type\"  (string) \"stake\", \"masternode\", \"superblock\" or \"other\"\n"
+            "    \"index\"  (number) The output index in the reward transaction\n"
+            "    \"satoshis\"  (number) The reward in duffs, for stake rewards on top of the stake\n"
+            "  }\n"
+            "]\n"
+            "\nResult with limit:\n"
+            "{\n"
+            "  \"rewards\"  (array) The rewards as above\n"
+            "  \"cursor\"  (string) Only if there are more, the cursor for the next request\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getrewards", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getrewards", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"start\": 1000, \"end\": 2000, \"limit\": 100}'")
+            + HelpExampleRpc("getrewards", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
+        );
+
+    if (!fRewardIndex) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Reward index not enabled, restart with -rewardindex -reindex-chainstate");
+    }
+
+    UniValue startValue = find_value(request.params[0].get_obj(), "start");
+    UniValue endValue = find_value(request.params[0].get_obj(), "end");
+
+    int start = startValue.isNum() ? startValue.get_int() : 0;
+    int end = endValue.isNum() ? endValue.get_int() : 0;
+    if (start < 0 || end < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Start and end are expected to be positive");
+    }
+    if (end > 0 && end < start) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "End value is expected to be greater than start");
+    }
+
+    std::vector<std::pair<uint160, int> > addresses;
+
+    if (!getAddressesFromParams(request.params, addresses)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    }
+
+    size_t nLimit, nFirstAddress;
+    CRewardIndexKey keyCursor;
+    bool fPaging = getPagingFromParams(request.params, addresses, nLimit, keyCursor, nFirstAddress);
+
+    std::vector<std::pair<CRewardIndexKey, CAmount> > rewardIndex;
+
+    auto readAddress = [&](const std::pair<uint160, int>& address, const CRewardIndexKey* pkeyFrom, size_t nMaxEntries) {
+        return GetRewardIndex(address.first, address.second, rewardIndex, start, end, pkeyFrom, nMaxEntries);
+    };
+    if (!readAddressPage(addresses, nLimit, nFirstAddress, keyCursor, rewardIndex, readAddress)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    }
+
+    UniValue result(UniValue::VARR);
+
+    for (const auto& p : rewardIndex) {
+        std::string address;
+        if (!getAddressFromIndex(p.first.type, p.first.hashBytes, address)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+        }
+
+        UniValue reward(UniValue::VOBJ);
+        reward.push_back(Pair("address", address));
+        reward.push_back(Pair("height", p.first.blockHeight));
+        reward.push_back(Pair("type", RewardTypeName(p.first.rewardType)));
+        reward.push_back(Pair("index", (int)p.first.index));
+        reward.push_back(Pair("satoshis", p.second));
+        result.push_back(reward);
+    }
+
+    if (fPaging) {
+        return pagedResult("rewards", result, keyCursor);
+    }
     return result;
 }
 
@@ -953,22 +1298,16 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
     CAmount balance = 0;
     CAmount received = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAmount addressBalance, addressReceived;
+        if (!GetAddressBalance((*it).first, (*it).second, addressBalance, addressReceived)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        balance += it->second;
+        balance += addressBalance;
+        received += addressReceived;
     }
 
     UniValue result(UniValue::VOBJ);
@@ -994,14 +1333,22 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return at most this many index entries and a cursor for the rest\n"
+            "  \"cursor\" (string, optional) The cursor returned by the previous request with the same addresses\n"
             "}\n"
             "\nResult:\n"
             "[\n"
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "\nResult with limit (txids in index order, address by address):\n"
+            "{\n"
+            "  \"txids\"  (array) The txids as above\n"
+            "  \"cursor\"  (string) Only if there are more, the cursor for the next request\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 1000}'")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -1022,16 +1369,34 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
         }
     }
 
+    size_t nLimit, nFirstAddress;
+    CAddressIndexKey keyCursor;
+    bool fPaging = getPagingFromParams(request.params, addresses, nLimit, keyCursor, nFirstAddress);
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+    auto readAddress = [&](const std::pair<uint160, int>& address, const CAddressIndexKey* pkeyFrom, size_t nMaxEntries) {
         if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            return GetAddressIndex(address.first, address.second, addressIndex, start, end, pkeyFrom, nMaxEntries);
+        }
+        return GetAddressIndex(address.first, address.second, addressIndex, 0, 0, pkeyFrom, nMaxEntries);
+    };
+    if (!readAddressPage(addresses, nLimit, nFirstAddress, keyCursor, addressIndex, readAddress)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    }
+
+    // Move the rest of a transaction that got cut off to the next page, so that a txid is only
+    // returned once. The entries of a transaction are adjacent in the index.
+    if (!keyCursor.hashBytes.IsNull()) {
+        size_t nEnd = addressIndex.size();
+        while (nEnd > 1 && addressIndex[nEnd - 1].first.txhash == keyCursor.txhash && addressIndex[nEnd - 1].first.hashBytes == keyCursor.hashBytes) {
+            nEnd--;
+        }
+        // unless the whole page belongs to that transaction
+        if (nEnd > 1 || addressIndex[0].first.txhash != keyCursor.txhash) {
+            if (nEnd < addressIndex.size()) {
+                keyCursor = addressIndex[nEnd].first;
+                addressIndex.erase(addressIndex.begin() + nEnd, addressIndex.end());
             }
         }
     }
@@ -1043,7 +1408,7 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
         int height = it->first.blockHeight;
         std::string txid = it->first.txhash.GetHex();
 
-        if (addresses.size() > 1) {
+        if (addresses.size() > 1 && !fPaging) {
             txids.insert(std::make_pair(height, txid));
         } else {
             if (txids.insert(std::make_pair(height, txid)).second) {
@@ -1052,12 +1417,15 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
         }
     }
 
-    if (addresses.size() > 1) {
+    if (addresses.size() > 1 && !fPaging) {
         for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
             result.push_back(it->second);
         }
     }
 
+    if (fPaging) {
+        return pagedResult("txids", result, keyCursor);
+    }
     return result;
 
 }
@@ -1124,6 +1492,20 @@ UniValue getstakingstatus(const JSONRPCRequest& request)
             "  \"enoughcoins\": true|false,        (boolean) if available coins are greater than reserve balance\n"
             "  \"mnsync\": true|false,             (boolean) if masternode data is synced\n"
             "  \"staking status\": true|false,     (boolean) if the wallet is staking or not\n"
+            "  \"searches\": n,                    (numeric) number of kernel search rounds since startup\n"
+            "  \"kernelsfound\": n,                (numeric) number of kernels found since startup\n"
+            "  \"lastsearchms\": n,                (numeric) duration of the last kernel search round in milliseconds\n"
+            "  \"avgsearchms\": n,                 (numeric) average duration of a kernel search round in milliseconds\n"
+            "  \"keys\": [                         (array) per stake address counters\n"
+            "    {\n"
+            "      \"address\": \"addr\",            (string) the stake address\n"
+            "      \"coins\": n,                   (numeric) stake inputs of this address in the last round\n"
+            "      \"searches\": n,                (numeric) search rounds this address took part in\n"
+            "      \"kernelsfound\": n,            (numeric) kernels found for this address\n"
+            "      \"hitrate\": x.xxx,             (numeric) kernels found per search round\n"
+            "      \"lastkerneltime\": ttt         (numeric) time of the last kernel found for this address\n"
+            "    },...\n"
+            "  ]\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("getstakingstatus", "") + HelpExampleRpc("getstakingstatus", ""));
@@ -1147,6 +1529,26 @@ UniValue getstakingstatus(const JSONRPCRequest& request)
 
     obj.push_back(Pair("staking status", nStaking));
 
+    if (pwalletMain) {
+        CStakingStats stats = pwalletMain->GetStakingStats();
+        obj.push_back(Pair("searches", stats.nSearches));
+        obj.push_back(Pair("kernelsfound", stats.nKernelsFound));
+        obj.push_back(Pair("lastsearchms", stats.nLastSearchMicros / 1000.0));
+        obj.push_back(Pair("avgsearchms", stats.nSearches > 0 ? (double)stats.nTotalSearchMicros / stats.nSearches / 1000.0 : 0.0));
+        UniValue keys(UniValue::VARR);
+        for (const auto& p : stats.mapKeys) {
+            UniValue key(UniValue::VOBJ);
+            key.push_back(Pair("address", CBitcoinAddress(p.first).ToString()));
+            key.push_back(Pair("coins", p.second.nCoins));
+            key.push_back(Pair("searches", p.second.nSearches));
+            key.push_back(Pair("kernelsfound", p.second.nKernelsFound));
+            key.push_back(Pair("hitrate", p.second.nSearches > 0 ? (double)p.second.nKernelsFound / p.second.nSearches : 0.0));
+            key.push_back(Pair("lastkerneltime", p.second.nLastKernelTime));
+            keys.push_back(key);
+        }
+        obj.push_back(Pair("keys", keys));
+    }
+
     return obj;
 }
 
@@ -1160,6 +1562,97 @@ static UniValue RPCLockedMemoryInfo()
     obj.push_back(Pair("locked", uint64_t(stats.locked)));
     obj.push_back(Pair("chunks_used", uint64_t(stats.chunks_used)));
     obj.push_back(Pair("chunks_free", uint64_t(stats.chunks_free)));
+    obj.push_back(Pair("cached", uint64_t(stats.cached)));
+    obj.push_back(Pair("cache_threads", uint64_t(stats.cache_threads)));
+    obj.push_back(Pair("cache_hits", stats.cache_hits));
+    obj.push_back(Pair("cache_misses", stats.cache_misses));
+    return obj;
+}
+
+static UniValue RPCBlockIndexMemoryInfo()
+{
+    LOCK(cs_main);
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("entries", uint64_t(blockIndexArena.Size())));
+    obj.push_back(Pair("chunks", uint64_t(blockIndexArena.Chunks())));
+    obj.push_back(Pair("entry_size", uint64_t(sizeof(CBlockIndex))));
+    obj.push_back(Pair("total", uint64_t(blockIndexArena.DynamicUsage())));
+    return obj;
+}
+
+static UniValue RPCMasternodeListCacheInfo()
+{
+    UniValue obj(UniValue::VOBJ);
+    if (!deterministicMNManager) {
+        return obj;
+    }
+    CDeterministicMNListCacheStats stats = deterministicMNManager->GetListCacheStats();
+    uint64_t nLookups = stats.nHotHits + stats.nColdHits + stats.nMisses;
+    obj.push_back(Pair("hot_entries", uint64_t(stats.nHotEntries)));
+    obj.push_back(Pair("cold_entries", uint64_t(stats.nColdEntries)));
+    obj.push_back(Pair("hot_hits", stats.nHotHits));
+    obj.push_back(Pair("cold_hits", stats.nColdHits));
+    obj.push_back(Pair("misses", stats.nMisses));
+    obj.push_back(Pair("hit_rate", nLookups ? double(stats.nHotHits + stats.nColdHits) / nLookups : 0.0));
+    obj.push_back(Pair("diffs_applied", stats.nDiffsApplied));
+    return obj;
+}
+
+static UniValue RPCMemoryUsage(const memusage::SubsystemUsage& usage)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("bytes", uint64_t(usage.nBytes)));
+    obj.push_back(Pair("entries", uint64_t(usage.nEntries)));
+    return obj;
+}
+
+static UniValue RPCSubsystemsMemoryInfo()
+{
+    std::vector<std::pair<std::string, memusage::SubsystemUsage> > vUsage;
+    {
+        LOCK(cs_main);
+        memusage::SubsystemUsage usage;
+        usage.nEntries = mapBlockIndex.size();
+        usage.nBytes = blockIndexArena.DynamicUsage() + memusage::DynamicUsage(mapBlockIndex) +
+                       memusage::DynamicUsage(mapPrevBlockIndex) + memusage::DynamicUsage(setChainTips);
+        vUsage.emplace_back("blockindex", usage);
+        if (pcoinsTip) {
+            usage.nEntries = pcoinsTip->GetCacheSize();
+            usage.nBytes = pcoinsTip->DynamicMemoryUsage();
+            vUsage.emplace_back("coinscache", usage);
+        }
+    }
+    vUsage.emplace_back("stakeseen", GetStakeSeenMemoryUsage());
+    {
+        memusage::SubsystemUsage usage;
+        usage.nEntries = mempool.size();
+        usage.nBytes = mempool.DynamicMemoryUsage();
+        vUsage.emplace_back("mempool", usage);
+    }
+    vUsage.emplace_back("orphans", GetOrphanMemoryUsage());
+    if (deterministicMNManager) {
+        vUsage.emplace_back("mnlistcache", deterministicMNManager->GetListCacheMemoryUsage());
+    }
+    {
+        memusage::SubsystemUsage objects, votes;
+        governance.GetMemoryUsage(objects, votes);
+        vUsage.emplace_back("governance_objects", objects);
+        vUsage.emplace_back("governance_votes", votes);
+    }
+    if (llmq::quorumSigSharesManager) {
+        vUsage.emplace_back("sigshares", llmq::quorumSigSharesManager->GetMemoryUsage());
+    }
+    if (llmq::quorumInstantSendManager) {
+        vUsage.emplace_back("instantsend", llmq::quorumInstantSendManager->GetMemoryUsage());
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    uint64_t nTotal = 0;
+    for (const auto& p : vUsage) {
+        obj.push_back(Pair(p.first, RPCMemoryUsage(p.second)));
+        nTotal += p.second.nBytes;
+    }
+    obj.push_back(Pair("total", nTotal));
     return obj;
 }
 
@@ -1168,11 +1661,15 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
     /* Please, avoid using the word "pool" here in the RPC interface or help,
      * as users will undoubtedly confuse it with the other "memory pool"
      */
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 1)
         throw std::runtime_error(
-            "getmemoryinfo\n"
+            "getmemoryinfo ( \"mode\" )\n"
             "Returns an object containing information about memory usage.\n"
-            "\nResult:\n"
+            "\nArguments:\n"
+            "1. \"mode\"                 (string, optional, default=\"stats\") determines what kind of information is returned.\n"
+            "  - \"stats\" returns general statistics about memory usage in the daemon.\n"
+            "  - \"subsystems\" returns the estimated heap usage of the larger in-memory structures, see below.\n"
+            "\nResult (mode \"stats\"):\n"
             "{\n"
             "  \"locked\": {               (json object) Information about locked memory manager\n"
             "    \"used\": xxxxx,          (numeric) Number of bytes used\n"
@@ -1181,17 +1678,299 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "    \"cached\": xxxxx,        (numeric) Bytes of used which threads keep for their next small allocations\n"
+            "    \"cache_threads\": xxxxx, (numeric) Number of threads with such a cache\n"
+            "    \"cache_hits\": xxxxx,    (numeric) Small allocations served from the cache of their thread\n"
+            "    \"cache_misses\": xxxxx,  (numeric) Small allocations which had to refill the cache first\n"
+            "  },\n"
+            "  \"blockindex\": {           (json object) Information about the block index entries\n"
+            "    \"entries\": xxxxx,       (numeric) Number of block index entries\n"
+            "    \"chunks\": xxxxx,        (numeric) Number of allocated chunks of entries\n"
+            "    \"entry_size\": xxxxx,    (numeric) Size of one entry in bytes\n"
+            "    \"total\": xxxxxxx,       (numeric) Total number of bytes allocated for entries\n"
+            "  },\n"
+            "  \"mnlistcache\": {          (json object) Information about the cache of deterministic masternode lists\n"
+            "    \"hot_entries\": xxxxx,   (numeric) Number of cached lists near the chain tip\n"
+            "    \"cold_entries\": xxxxx,  (numeric) Number of cached older lists\n"
+            "    \"hot_hits\": xxxxx,      (numeric) Lookups answered from the lists near the tip\n"
+            "    \"cold_hits\": xxxxx,     (numeric) Lookups answered from the older lists\n"
+            "    \"misses\": xxxxx,        (numeric) Lookups which had to replay diffs from disk\n"
+            "    \"hit_rate\": x.xxx,      (numeric) Share of lookups answered from the cache\n"
+            "    \"diffs_applied\": xxxxx, (numeric) Total number of diffs replayed\n"
             "  }\n"
             "}\n"
+            "\nResult (mode \"subsystems\"):\n"
+            "{\n"
+            "  \"name\": {                 (json object) One of blockindex, coinscache, stakeseen, mempool, orphans, mnlistcache,\n"
+            "                                governance_objects, governance_votes, sigshares and instantsend\n"
+            "    \"bytes\": xxxxx,         (numeric) Estimated number of bytes allocated\n"
+            "    \"entries\": xxxxx,       (numeric) Number of entries, like blocks, coins, transactions, lists, objects, votes or sig shares\n"
+            "  },\n"
+            "  ...\n"
+            "  \"total\": xxxxx            (numeric) Sum of the bytes of all of them\n"
+            "}\n"
+            "The estimates count the containers and what the entries allocate, the way -dbcache is accounted, not what the\n"
+            "allocator keeps back. Data shared between subsystems, like transactions, is counted by the one owning it.\n"
             "\nExamples:\n"
             + HelpExampleCli("getmemoryinfo", "")
-            + HelpExampleRpc("getmemoryinfo", "")
+            + HelpExampleCli("getmemoryinfo", "\"subsystems\"")
+            + HelpExampleRpc("getmemoryinfo", "\"subsystems\"")
         );
+
+    std::string strMode = request.params.size() > 0 ? request.params[0].get_str() : "stats";
+    if (strMode == "subsystems") {
+        return RPCSubsystemsMemoryInfo();
+    }
+    if (strMode != "stats") {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "unknown mode " + strMode);
+    }
+
     UniValue obj(UniValue::VOBJ);
     obj.push_back(Pair("locked", RPCLockedMemoryInfo()));
+    obj.push_back(Pair("blockindex", RPCBlockIndexMemoryInfo()));
+    obj.push_back(Pair("mnlistcache", RPCMasternodeListCacheInfo()));
     return obj;
 }
 
+UniValue getdbstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getdbstats\n"
+            "Returns the settings and statistics of each open LevelDB database.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"name\": \"xxxx\",             (string) Name of the database, as used by -dbtuning\n"
+            "    \"path\": \"xxxx\",             (string) Location of the database, empty if held in memory\n"
+            "    \"tuning\": {                   (json object) Settings the database was opened with\n"
+            "      \"cache\": xxxxx,             (numeric) Block cache size in bytes\n"
+            "      \"writebuffer\": xxxxx,       (numeric) Write buffer size in bytes\n"
+            "      \"maxopenfiles\": xxxxx,      (numeric) Maximum number of open table files\n"
+            "      \"compression\": true|false,  (boolean) If blocks are snappy compressed\n"
+            "      \"bloombits\": xxxxx          (numeric) Bloom filter bits per key, 0 for none\n"
+            "    },\n"
+            "    \"cache_usage\": xxxxx,         (numeric) Bytes currently held in the block cache\n"
+            "    \"memory_usage\": xxxxx,        (numeric) Approximate memory used by LevelDB\n"
+            "    \"files_per_level\": [ n, ... ], (array) Number of table files at each level\n"
+            "    \"batches_written\": xxxxx,     (numeric) Number of write batches since startup\n"
+            "    \"bytes_written\": xxxxx,       (numeric) Bytes written in those batches\n"
+            "    \"manual_compactions\": xxxxx,  (numeric) Number of compactions requested by the node\n"
+            "    \"leveldb_stats\": \"xxxx\"      (string) LevelDB's own compaction statistics\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getdbstats", "")
+            + HelpExampleRpc("getdbstats", "")
+        );
+
+    UniValue result(UniValue::VARR);
+    for (const CDBStats& stats : CDBWrapper::GetAllStats()) {
+        UniValue tuning(UniValue::VOBJ);
+        tuning.push_back(Pair("cache", (uint64_t)stats.tuning.nBlockCacheSize));
+        tuning.push_back(Pair("writebuffer", (uint64_t)stats.tuning.nWriteBufferSize));
+        tuning.push_back(Pair("maxopenfiles", stats.tuning.nMaxOpenFiles));
+        tuning.push_back(Pair("compression", stats.tuning.fCompression));
+        tuning.push_back(Pair("bloombits", stats.tuning.nBloomBits));
+
+        UniValue files(UniValue::VARR);
+        for (int nFiles : stats.vFilesPerLevel)
+            files.push_back(nFiles);
+
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("name", stats.strName));
+        obj.push_back(Pair("path", stats.strPath));
+        obj.push_back(Pair("tuning", tuning));
+        obj.push_back(Pair("cache_usage", (uint64_t)stats.nBlockCacheUsage));
+        obj.push_back(Pair("memory_usage", stats.nApproximateMemoryUsage));
+        obj.push_back(Pair("files_per_level", files));
+        obj.push_back(Pair("batches_written", stats.nBatchesWritten));
+        obj.push_back(Pair("bytes_written", stats.nBytesWritten));
+        obj.push_back(Pair("manual_compactions", stats.nManualCompactions));
+        obj.push_back(Pair("leveldb_stats", stats.strLevelDBStats));
+        result.push_back(obj);
+    }
+    return result;
+}
+
+UniValue getrpcstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getrpcstats\n"
+            "Returns the HTTP work queues and the execution times of each RPC method since startup.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"queues\": {\n"
+            "    \"default\"|\"slow\": {       (json object) The lane of the HTTP server\n"
+            "      \"threads\": xxxxx,         (numeric) Number of worker threads\n"
+            "      \"depth\": xxxxx,           (numeric) Requests waiting now\n"
+            "      \"maxdepth\": xxxxx,        (numeric) Requests that can wait before new ones are rejected\n"
+            "      \"queued\": xxxxx,          (numeric) Requests queued since startup\n"
+            "      \"rejected\": xxxxx,        (numeric) Requests rejected because the queue was full\n"
+            "      \"avg_wait_ms\": x.xxx,     (numeric) Average time a request waited for a worker\n"
+            "      \"max_wait_ms\": x.xxx      (numeric) Longest time a request waited for a worker\n"
+            "    }, ...\n"
+            "  },\n"
+            "  \"methods\": {\n"
+            "    \"name\": {                 (json object) An RPC method that was called\n"
+            "      \"calls\": xxxxx,           (numeric) Number of calls\n"
+            "      \"errors\": xxxxx,          (numeric) Number of calls that failed\n"
+            "      \"avg_ms\": x.xxx,          (numeric) Average execution time\n"
+            "      \"max_ms\": x.xxx,          (numeric) Longest execution time\n"
+            "      \"slow\": true|false        (boolean) If the method is run by the slow lane\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getrpcstats", "")
+            + HelpExampleRpc("getrpcstats", "")
+        );
+
+    static const char* const laneNames[HTTP_LANE_COUNT] = {"default", "slow"};
+    UniValue queues(UniValue::VOBJ);
+    for (int lane = 0; lane < HTTP_LANE_COUNT; lane++) {
+        HTTPWorkQueueStats stats = GetHTTPWorkQueueStats((HTTPWorkLane)lane);
+        uint64_t nStarted = stats.nQueued - stats.nDepth;
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("threads", stats.nThreads));
+        obj.push_back(Pair("depth", (uint64_t)stats.nDepth));
+        obj.push_back(Pair("maxdepth", (uint64_t)stats.nMaxDepth));
+        obj.push_back(Pair("queued", stats.nQueued));
+        obj.push_back(Pair("rejected", stats.nRejected));
+        obj.push_back(Pair("avg_wait_ms", nStarted ? stats.nTotalWaitMicros / 1000.0 / nStarted : 0.0));
+        obj.push_back(Pair("max_wait_ms", stats.nMaxWaitMicros / 1000.0));
+        queues.push_back(Pair(laneNames[lane], obj));
+    }
+
+    UniValue methods(UniValue::VOBJ);
+    for (const auto& p : GetRPCMethodStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("calls", p.second.nCalls));
+        obj.push_back(Pair("errors", p.second.nErrors));
+        obj.push_back(Pair("avg_ms", p.second.nTotalMicros / 1000.0 / p.second.nCalls));
+        obj.push_back(Pair("max_ms", p.second.nMaxMicros / 1000.0));
+        obj.push_back(Pair("slow", IsSlowRPCMethod(p.first)));
+        methods.push_back(Pair(p.first, obj));
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("queues", queues));
+    result.push_back(Pair("methods", methods));
+    return result;
+}
+
+static UniValue LockHistogramToJSON(const uint64_t (&histogram)[CLockProfileStats::HISTOGRAM_BUCKETS])
+{
+    // Trailing empty buckets are left out
+    int nLast = CLockProfileStats::HISTOGRAM_BUCKETS;
+    while (nLast > 0 && histogram[nLast - 1] == 0)
+        nLast--;
+    UniValue result(UniValue::VARR);
+    for (int i = 0; i < nLast; i++)
+        result.push_back(histogram[i]);
+    return result;
+}
+
+UniValue getlockstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2)
+        throw std::runtime_error(
+            "getlockstats ( samplerate reset )\n"
+            "Returns the wait and hold times of the sampled lock acquisitions, per lock and source location.\n"
+            "\nArguments:\n"
+            "1. samplerate  (numeric, optional) Sample one in this many acquisitions from now on, 0 to stop profiling\n"
+            "2. reset       (boolean, optional, default=false) Clear the collected statistics after returning them\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"samplerate\": n,            (numeric) One in how many acquisitions is sampled, 0 if profiling is off\n"
+            "  \"locks\": {\n"
+            "    \"name\": {                 (json object) Totals of a lock over all its locations\n"
+            "      \"samples\": n,           (numeric) Sampled acquisitions\n"
+            "      \"contended\": n,         (numeric) Sampled acquisitions that had to wait\n"
+            "      \"wait_us\": n,           (numeric) Total time waited\n"
+            "      \"hold_us\": n            (numeric) Total time held\n"
+            "    }, ...\n"
+            "  },\n"
+            "  \"sites\": [                 (array) Locations, by total time waited\n"
+            "    {\n"
+            "      \"name\": \"name\",         (string) The lock\n"
+            "      \"site\": \"file:line\",    (string) Where it was taken\n"
+            "      \"samples\": n,           (numeric) Sampled acquisitions\n"
+            "      \"contended\": n,         (numeric) Sampled acquisitions that had to wait\n"
+            "      \"wait_us\": n,           (numeric) Total time waited\n"
+            "      \"max_wait_us\": n,       (numeric) Longest wait\n"
+            "      \"hold_us\": n,           (numeric) Total time held\n"
+            "      \"max_hold_us\": n,       (numeric) Longest hold\n"
+            "      \"wait_histogram\": [...], (array) Entry i counts the waits below 2^i microseconds\n"
+            "      \"hold_histogram\": [...]  (array) Entry i counts the holds below 2^i microseconds\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getlockstats", "")
+            + HelpExampleCli("getlockstats", "100 true")
+            + HelpExampleRpc("getlockstats", "100, true")
+        );
+
+    if (request.params.size() > 0) {
+        int nRate = request.params[0].get_int();
+        if (nRate < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "samplerate must not be negative");
+        nLockProfileRate = nRate;
+    }
+    bool fReset = request.params.size() > 1 && request.params[1].get_bool();
+
+    std::vector<CLockProfileStats> vStats = GetLockProfileStats();
+    if (fReset)
+        ResetLockProfileStats();
+    std::sort(vStats.begin(), vStats.end(), [](const CLockProfileStats& a, const CLockProfileStats& b) {
+        return a.nTotalWaitMicros > b.nTotalWaitMicros;
+    });
+
+    std::map<std::string, CLockProfileStats> mapLocks;
+    UniValue sites(UniValue::VARR);
+    for (const CLockProfileStats& s : vStats) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("name", s.strName));
+        obj.push_back(Pair("site", strprintf("%s:%d", s.strFile, s.nLine)));
+        obj.push_back(Pair("samples", s.nSamples));
+        obj.push_back(Pair("contended", s.nContended));
+        obj.push_back(Pair("wait_us", s.nTotalWaitMicros));
+        obj.push_back(Pair("max_wait_us", s.nMaxWaitMicros));
+        obj.push_back(Pair("hold_us", s.nTotalHoldMicros));
+        obj.push_back(Pair("max_hold_us", s.nMaxHoldMicros));
+        obj.push_back(Pair("wait_histogram", LockHistogramToJSON(s.waitHistogram)));
+        obj.push_back(Pair("hold_histogram", LockHistogramToJSON(s.holdHistogram)));
+        sites.push_back(obj);
+
+        auto it = mapLocks.find(s.strName);
+        if (it == mapLocks.end()) {
+            mapLocks.emplace(s.strName, s);
+        } else {
+            it->second.nSamples += s.nSamples;
+            it->second.nContended += s.nContended;
+            it->second.nTotalWaitMicros += s.nTotalWaitMicros;
+            it->second.nTotalHoldMicros += s.nTotalHoldMicros;
+        }
+    }
+    UniValue locks(UniValue::VOBJ);
+    for (const auto& p : mapLocks) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("samples", p.second.nSamples));
+        obj.push_back(Pair("contended", p.second.nContended));
+        obj.push_back(Pair("wait_us", p.second.nTotalWaitMicros));
+        obj.push_back(Pair("hold_us", p.second.nTotalHoldMicros));
+        locks.push_back(Pair(p.first, obj));
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("samplerate", (int)nLockProfileRate.load()));
+    result.push_back(Pair("locks", locks));
+    result.push_back(Pair("sites", sites));
+    return result;
+}
+
 UniValue echo(const JSONRPCRequest& request)
 {
     if (request.fHelp)
@@ -1210,11 +1989,15 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "debug",                  &debug,                  true,  {} },
     { "control",            "getinfo",                &getinfo,                true,  {} }, /* uses wallet if enabled */
-    { "control",            "getmemoryinfo",          &getmemoryinfo,          true,  {} },
+    { "control",            "getmemoryinfo",          &getmemoryinfo,          true,  {"mode"} },
+    { "control",            "getdbstats",             &getdbstats,             true,  {} },
+    { "control",            "getrpcstats",            &getrpcstats,            true,  {} },
+    { "control",            "getlockstats",           &getlockstats,           true,  {"samplerate","reset"} },
     { "util",               "validateaddress",        &validateaddress,        true,  {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         true,  {"nrequired","keys"} },
     { "util",               "verifymessage",          &verifymessage,          true,  {"address","signature","message"} },
     { "util",               "signmessagewithprivkey", &signmessagewithprivkey, true,  {"privkey","message"} },
+    { "util",               "generatehdwallets",      &generatehdwallets,      true,  {"count","mnemonicpassphrase","accounts","keys"} },
     { "blockchain",         "getspentinfo",           &getspentinfo,           false, {"json"} },
     { "util",               "getstakingstatus",       &getstakingstatus,       true,  {} },
 
@@ -1224,6 +2007,7 @@ static const CRPCCommand commands[] =
     { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       false, {"addresses"} },
     { "addressindex",       "getaddresstxids",        &getaddresstxids,        false, {"addresses"} },
     { "addressindex",       "getaddressbalance",      &getaddressbalance,      false, {"addresses"} },
+    { "addressindex",       "getrewards",             &getrewards,             false, {"addresses"} },
 
     /* EPMCoin features */
     { "epmcoin",               "mnsync",                 &mnsync,                 true,  {} },
@@ -99,6 +99,7 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             "    \"subver\": \"/EPMCoin Core:x.x.x/\",  (string) The string version\n"
             "    \"inbound\": true|false,     (boolean) Inbound (true) or Outbound (false)\n"
             "    \"addnode\": true|false,     (boolean) Whether connection was due to addnode and is using an addnode slot\n"
+            "    \"txreconciliation\": true|false, (boolean) Whether transactions are announced by short id (see -txreconciliation)\n"
             "    \"startingheight\": n,       (numeric) The starting height (block) of the peer\n"
             "    \"banscore\": n,             (numeric) The ban score\n"
             "    \"synced_headers\": n,       (numeric) The last header we have in common with this peer\n"
@@ -107,6 +108,15 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
             "    ],\n"
+            "    \"inflight_limit\": n,       (numeric) How many blocks we ask this peer for at once\n"
+            "    \"blocktime\": n,            (numeric) Average time in microseconds this peer took to send us a block, 0 if unknown\n"
+            "    \"cmpctblocks\": {          (json object) Reconstruction of the compact blocks this peer sent us\n"
+            "       \"reconstructed\": n,     (numeric) Blocks rebuilt without asking for missing transactions\n"
+            "       \"roundtrips\": n,        (numeric) Blocks which needed a getblocktxn round trip\n"
+            "       \"failed\": n,            (numeric) Blocks we had to download in full instead\n"
+            "       \"txn_hit\": n,           (numeric) Transactions found in our mempool or extra pool\n"
+            "       \"txn_miss\": n           (numeric) Transactions we had to request\n"
+            "    },\n"
             "    \"whitelisted\": true|false, (boolean) Whether the peer is whitelisted\n"
             "    \"bytessent_per_msg\": {\n"
             "       \"addr\": n,              (numeric) The total bytes sent aggregated by message type\n"
@@ -164,6 +174,7 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
         obj.push_back(Pair("subver", stats.cleanSubVer));
         obj.push_back(Pair("inbound", stats.fInbound));
         obj.push_back(Pair("addnode", stats.fAddnode));
+        obj.push_back(Pair("txreconciliation", stats.fTxReconciliation));
         obj.push_back(Pair("startingheight", stats.nStartingHeight));
         if (fStateStats) {
             obj.push_back(Pair("banscore", statestats.nMisbehavior));
@@ -174,6 +185,15 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
                 heights.push_back(height);
             }
             obj.push_back(Pair("inflight", heights));
+            obj.push_back(Pair("inflight_limit", statestats.nBlocksInFlightLimit));
+            obj.push_back(Pair("blocktime", statestats.nAvgBlockTime));
+            UniValue cmpctblocks(UniValue::VOBJ);
+            cmpctblocks.push_back(Pair("reconstructed", statestats.nCmpctBlocksReconstructed));
+            cmpctblocks.push_back(Pair("roundtrips", statestats.nCmpctBlocksRoundTrip));
+            cmpctblocks.push_back(Pair("failed", statestats.nCmpctBlocksFailed));
+            cmpctblocks.push_back(Pair("txn_hit", statestats.nCmpctTxnHit));
+            cmpctblocks.push_back(Pair("txn_miss", statestats.nCmpctTxnMiss));
+            obj.push_back(Pair("cmpctblocks", cmpctblocks));
         }
         obj.push_back(Pair("whitelisted", stats.fWhitelisted));
 
@@ -353,6 +373,12 @@ UniValue getnettotals(const JSONRPCRequest& request)
             "    \"serve_historical_blocks\": true|false,  (boolean) True if serving historical blocks\n"
             "    \"bytes_left_in_cycle\": t,               (numeric) Bytes left in current time cycle\n"
             "    \"time_left_in_cycle\": t                 (numeric) Seconds left in current time cycle\n"
+            "  },\n"
+            "  \"relaycache\":\n"
+            "  {\n"
+            "    \"hits\": n,                              (numeric) ISLOCK, CLSIG and governance object requests served pre-serialized\n"
+            "    \"misses\": n,                            (numeric) Requests which had to serialize the object\n"
+            "    \"entries\": n                            (numeric) Number of cached messages\n"
             "  }\n"
             "}\n"
             "\nExamples:\n"
@@ -375,6 +401,15 @@ UniValue getnettotals(const JSONRPCRequest& request)
     outboundLimit.push_back(Pair("bytes_left_in_cycle", g_connman->GetOutboundTargetBytesLeft()));
     outboundLimit.push_back(Pair("time_left_in_cycle", g_connman->GetMaxOutboundTimeLeftInCycle()));
     obj.push_back(Pair("uploadtarget", outboundLimit));
+
+    uint64_t nRelayCacheHits, nRelayCacheMisses;
+    size_t nRelayCacheEntries;
+    GetRelayCacheStats(nRelayCacheHits, nRelayCacheMisses, nRelayCacheEntries);
+    UniValue relayCache(UniValue::VOBJ);
+    relayCache.push_back(Pair("hits", nRelayCacheHits));
+    relayCache.push_back(Pair("misses", nRelayCacheMisses));
+    relayCache.push_back(Pair("entries", (uint64_t)nRelayCacheEntries));
+    obj.push_back(Pair("relaycache", relayCache));
     return obj;
 }
 
@@ -610,6 +645,57 @@ UniValue setnetworkactive(const JSONRPCRequest& request)
     return g_connman->GetNetworkActive();
 }
 
+UniValue getmessagestats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1) {
+        throw std::runtime_error(
+            "getmessagestats ( reset )\n"
+            "\nReturns the time spent processing each type of p2p message since startup or the last reset.\n"
+            "All times are in microseconds, percentiles are rounded up to the next power of two.\n"
+            "\nArguments:\n"
+            "1. reset        (boolean, optional, default=false) Clear the statistics after returning them\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"msg\": {         (string) Message type, unknown types are counted as *other*\n"
+            "    \"count\": n,    (numeric) Number of processed messages\n"
+            "    \"total\": n,    (numeric) Total processing time\n"
+            "    \"max\": n,      (numeric) Longest processing time\n"
+            "    \"p50\": n,      (numeric) Median processing time\n"
+            "    \"p99\": n,      (numeric) 99th percentile of the processing time\n"
+            "    \"cpu\": n,      (numeric) Total CPU time of the processing thread, 0 if unsupported\n"
+            "    \"wait\": n,     (numeric) Total time between receipt and start of processing\n"
+            "    \"wait_p99\": n  (numeric) 99th percentile of the time between receipt and start of processing\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getmessagestats", "")
+            + HelpExampleRpc("getmessagestats", "true")
+        );
+    }
+
+    bool fReset = request.params.size() > 0 && request.params[0].get_bool();
+
+    UniValue ret(UniValue::VOBJ);
+    for (const CMessageProcessingStats& stats : GetMessageProcessingStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("count", stats.nCount));
+        obj.push_back(Pair("total", stats.nTimeTotal));
+        obj.push_back(Pair("max", stats.nTimeMax));
+        obj.push_back(Pair("p50", stats.nTimeP50));
+        obj.push_back(Pair("p99", stats.nTimeP99));
+        obj.push_back(Pair("cpu", stats.nCPUTimeTotal));
+        obj.push_back(Pair("wait", stats.nWaitTotal));
+        obj.push_back(Pair("wait_p99", stats.nWaitP99));
+        ret.push_back(Pair(stats.strCommand, obj));
+    }
+    if (fReset) {
+        ResetMessageProcessingStats();
+    }
+
+    return ret;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         okSafeMode
   //  --------------------- ------------------------  -----------------------  ----------
@@ -625,6 +711,7 @@ static const CRPCCommand commands[] =
     { "network",            "listbanned",             &listbanned,             true,  {} },
     { "network",            "clearbanned",            &clearbanned,            true,  {} },
     { "network",            "setnetworkactive",       &setnetworkactive,       true,  {"state"} },
+    { "network",            "getmessagestats",        &getmessagestats,        true,  {"reset"} },
 };
 
 void RegisterNetRPCCommands(CRPCTable &t)
@@ -390,24 +390,86 @@ UniValue gettxoutproof(const JSONRPCRequest& request)
         pblockindex = mapBlockIndex[hashBlock];
     }
 
-    CBlock block;
-    if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+    CBlockMerkleLevelsCPtr levels = GetBlockMerkleLevels(pblockindex, Params().GetConsensus());
+    if (!levels)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
 
+    const std::vector<uint256>& vTxid = levels->vLevels[0];
+    std::vector<bool> vMatch(vTxid.size(), false);
     unsigned int ntxFound = 0;
-    for (const auto& tx : block.vtx)
-        if (setTxids.count(tx->GetHash()))
+    for (size_t i = 0; i < vTxid.size(); i++) {
+        if (setTxids.count(vTxid[i])) {
+            vMatch[i] = true;
             ntxFound++;
+        }
+    }
     if (ntxFound != setTxids.size())
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "(Not all) transactions not found in specified block");
 
     CDataStream ssMB(SER_NETWORK, PROTOCOL_VERSION);
-    CMerkleBlock mb(block, setTxids);
+    CMerkleBlock mb(levels->header, levels->vLevels, vMatch);
     ssMB << mb;
     std::string strHex = HexStr(ssMB.begin(), ssMB.end());
     return strHex;
 }
 
+UniValue gettxoutproofs(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "gettxoutproofs [\"txid\",...]\n"
+            "\nReturns hex-encoded proofs that the transactions were included in blocks, one for each block\n"
+            "they are in. Works for all transactions with -txindex, otherwise only for those with an unspent output.\n"
+            "\nArguments:\n"
+            "1. \"txids\"       (string) A json array of txids\n"
+            "    [\n"
+            "      \"txid\"     (string) A transaction hash\n"
+            "      ,...\n"
+            "    ]\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"blockhash\" : \"hash\",  (string) The hash of the block\n"
+            "    \"txids\" : [ \"txid\", ... ], (array of string) The requested txids which are in the block\n"
+            "    \"proof\" : \"data\"       (string) The hex-encoded proof for these txids like gettxoutproof returns it\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("gettxoutproofs", "'[\"mytxid\",...]'")
+            + HelpExampleRpc("gettxoutproofs", "[\"mytxid\",...]")
+        );
+
+    std::vector<uint256> vTxids;
+    std::set<uint256> setTxids;
+    UniValue txids = request.params[0].get_array();
+    for (unsigned int idx = 0; idx < txids.size(); idx++) {
+        uint256 hash = ParseHashV(txids[idx], "txid");
+        if (!setTxids.insert(hash).second)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, std::string("Invalid parameter, duplicated txid: ")+txids[idx].get_str());
+        vTxids.push_back(hash);
+    }
+
+    std::vector<std::pair<CMerkleBlock, std::vector<uint256> > > vProofs;
+    std::string strError;
+    if (!GetTxOutProofs(vTxids, vProofs, strError))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, strError);
+
+    UniValue result(UniValue::VARR);
+    for (const auto& p : vProofs) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("blockhash", p.first.header.GetHash().GetHex()));
+        UniValue blockTxids(UniValue::VARR);
+        for (const uint256& txid : p.second)
+            blockTxids.push_back(txid.GetHex());
+        obj.push_back(Pair("txids", blockTxids));
+        CDataStream ssMB(SER_NETWORK, PROTOCOL_VERSION);
+        ssMB << p.first;
+        obj.push_back(Pair("proof", HexStr(ssMB.begin(), ssMB.end())));
+        result.push_back(obj);
+    }
+    return result;
+}
+
 UniValue verifytxoutproof(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -915,6 +977,8 @@ UniValue signrawtransaction(const JSONRPCRequest& request)
     // Use CTransaction for the constant parts of the
     // transaction to avoid rehashing.
     const CTransaction txConst(mergedTx);
+    // The scriptSigs are not part of it, so it stays valid while they are filled in
+    PrecomputedTransactionData txdata(txConst);
     // Sign what we can:
     for (unsigned int i = 0; i < mergedTx.vin.size(); i++) {
         CTxIn& txin = mergedTx.vin[i];
@@ -937,7 +1001,7 @@ UniValue signrawtransaction(const JSONRPCRequest& request)
             }
         }
         ScriptError serror = SCRIPT_ERR_OK;
-        if (!VerifyScript(txin.scriptSig, prevPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&txConst, i), &serror)) {
+        if (!VerifyScript(txin.scriptSig, prevPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&txConst, i, &txdata), &serror)) {
             TxInErrorToJSON(txin, vErrors, ScriptErrorString(serror));
         }
     }
@@ -1036,6 +1100,111 @@ UniValue sendrawtransaction(const JSONRPCRequest& request)
     return hashTx.GetHex();
 }
 
+UniValue sendrawtransactions(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 3)
+        throw std::runtime_error(
+            "sendrawtransactions [\"hexstring\",...] ( allowhighfees bypasslimits )\n"
+            "\nSubmits a batch of raw transactions (serialized, hex-encoded) to local node and network.\n"
+            "The whole batch is validated under one lock and the memory pool is trimmed once at the end,\n"
+            "which is much faster than calling sendrawtransaction for every transaction.\n"
+            "Transactions spending each other have to be ordered parents first.\n"
+            "\nArguments:\n"
+            "1. \"hexstrings\"   (array, required) The hex strings of the raw transactions\n"
+            "2. allowhighfees  (boolean, optional, default=false) Allow high fees\n"
+            "3. bypasslimits   (boolean, optional, default=false) Bypass transaction policy limits\n"
+            "\nResult:\n"
+            "[                   (json array of objects, in the order of the batch)\n"
+            "  {\n"
+            "    \"txid\" : \"hex\",      (string) The transaction hash in hex\n"
+            "    \"accepted\" : true|false, (boolean) Whether the transaction is in the memory pool and was relayed\n"
+            "    \"reject-reason\" : \"reason\" (string) Why the transaction was not accepted, if it wasn't\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("sendrawtransactions", "\"[\\\"signedhex\\\",\\\"signedhex\\\"]\"")
+            + HelpExampleRpc("sendrawtransactions", "[\"signedhex\",\"signedhex\"]")
+        );
+
+    RPCTypeCheck(request.params, boost::assign::list_of(UniValue::VARR)(UniValue::VBOOL)(UniValue::VBOOL));
+
+    const UniValue& hexstrings = request.params[0].get_array();
+    std::vector<CTransactionRef> vtx;
+    vtx.reserve(hexstrings.size());
+    for (size_t i = 0; i < hexstrings.size(); i++) {
+        CMutableTransaction mtx;
+        if (!DecodeHexTx(mtx, hexstrings[i].get_str()))
+            throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("TX decode failed for transaction %u", i));
+        vtx.push_back(MakeTransactionRef(std::move(mtx)));
+    }
+
+    CAmount nMaxRawTxFee = maxTxFee;
+    if (request.params.size() > 1 && request.params[1].get_bool())
+        nMaxRawTxFee = 0;
+
+    bool fBypassLimits = false;
+    if (request.params.size() > 2)
+        fBypassLimits = request.params[2].get_bool();
+
+    if (!g_connman)
+        throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+
+    LOCK(cs_main);
+
+    // Like sendrawtransaction, what is in the mempool already is relayed again and what is in
+    // the chain is an error, everything else goes through AcceptPackageToMemoryPool
+    std::vector<std::string> vReject(vtx.size());
+    std::vector<bool> vRelay(vtx.size(), false);
+    std::vector<CTransactionRef> vtxNew;
+    std::vector<size_t> vNewIndex;
+    CCoinsViewCache &view = *pcoinsTip;
+    for (size_t i = 0; i < vtx.size(); i++) {
+        const uint256& hashTx = vtx[i]->GetHash();
+        bool fHaveChain = false;
+        for (size_t o = 0; !fHaveChain && o < vtx[i]->vout.size(); o++) {
+            fHaveChain = !view.AccessCoin(COutPoint(hashTx, o)).IsSpent();
+        }
+        if (fHaveChain) {
+            vReject[i] = "transaction already in block chain";
+        } else if (mempool.exists(hashTx)) {
+            vRelay[i] = true;
+        } else {
+            vtxNew.push_back(vtx[i]);
+            vNewIndex.push_back(i);
+        }
+    }
+
+    std::vector<CValidationState> vStates;
+    std::vector<bool> vAccepted, vMissingInputs;
+    AcceptPackageToMemoryPool(mempool, vtxNew, vStates, vAccepted, vMissingInputs, !fBypassLimits, nMaxRawTxFee);
+    for (size_t j = 0; j < vtxNew.size(); j++) {
+        size_t i = vNewIndex[j];
+        if (vAccepted[j]) {
+            vRelay[i] = true;
+        } else if (vStates[j].IsInvalid()) {
+            vReject[i] = strprintf("%i: %s", vStates[j].GetRejectCode(), vStates[j].GetRejectReason());
+        } else if (vMissingInputs[j]) {
+            vReject[i] = "Missing inputs";
+        } else {
+            vReject[i] = vStates[j].GetRejectReason();
+        }
+    }
+
+    UniValue result(UniValue::VARR);
+    for (size_t i = 0; i < vtx.size(); i++) {
+        if (vRelay[i])
+            g_connman->RelayTransaction(*vtx[i]);
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("txid", vtx[i]->GetHash().GetHex()));
+        entry.push_back(Pair("accepted", (bool)vRelay[i]));
+        if (!vRelay[i])
+            entry.push_back(Pair("reject-reason", vReject[i]));
+        result.push_back(entry);
+    }
+    return result;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         okSafeMode
   //  --------------------- ------------------------  -----------------------  ----------
@@ -1044,9 +1213,11 @@ static const CRPCCommand commands[] =
     { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true,  {"hexstring"} },
     { "rawtransactions",    "decodescript",           &decodescript,           true,  {"hexstring"} },
     { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false, {"hexstring","allowhighfees","instantsend","bypasslimits"} },
+    { "rawtransactions",    "sendrawtransactions",    &sendrawtransactions,    false, {"hexstrings","allowhighfees","bypasslimits"} },
     { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false, {"hexstring","prevtxs","privkeys","sighashtype"} }, /* uses wallet if enabled */
 
     { "blockchain",         "gettxoutproof",          &gettxoutproof,          true,  {"txids", "blockhash"} },
+    { "blockchain",         "gettxoutproofs",         &gettxoutproofs,         true,  {"txids"} },
     { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true,  {"proof"} },
 };
 
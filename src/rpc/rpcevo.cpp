@@ -1082,14 +1082,14 @@ UniValue protx_diff(const JSONRPCRequest& request)
     uint256 baseBlockHash = ParseBlock(request.params[1], "baseBlock");
     uint256 blockHash = ParseBlock(request.params[2], "block");
 
-    CSimplifiedMNListDiff mnListDiff;
+    CCachedSimplifiedMNListDiffCPtr mnListDiff;
     std::string strError;
-    if (!BuildSimplifiedMNListDiff(baseBlockHash, blockHash, mnListDiff, strError)) {
+    if (!GetSimplifiedMNListDiff(baseBlockHash, blockHash, mnListDiff, strError)) {
         throw std::runtime_error(strError);
     }
 
     UniValue ret;
-    mnListDiff.ToJson(ret);
+    mnListDiff->diff.ToJson(ret);
     return ret;
 }
 
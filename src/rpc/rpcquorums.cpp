@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chainparams.h"
+#include "net.h"
 #include "server.h"
 #include "validation.h"
 
@@ -11,6 +12,7 @@
 #include "llmq/quorums_debug.h"
 #include "llmq/quorums_dkgsession.h"
 #include "llmq/quorums_signing.h"
+#include "llmq/quorums_signing_shares.h"
 
 void quorum_list_help()
 {
@@ -103,7 +105,7 @@ UniValue BuildQuorumInfo(const llmq::CQuorumCPtr& quorum, bool includeMembers, b
 
         ret.push_back(Pair("members", membersArr));
     }
-    ret.push_back(Pair("quorumPublicKey", quorum->qc.quorumPublicKey.ToString()));
+    ret.push_back(Pair("quorumPublicKey", quorum->qc.quorumPublicKey.Get().ToString()));
     CBLSSecretKey skShare = quorum->GetSkShare();
     if (includeSkShare && skShare.IsValid()) {
         ret.push_back(Pair("secretKeyShare", skShare.ToString()));
@@ -148,6 +150,10 @@ void quorum_dkgstatus_help()
             "\nArguments:\n"
             "1. detail_level         (number, optional, default=0) Detail level of output.\n"
             "                        0=Only show counts. 1=Show member indexes. 2=Show member's ProTxHashes.\n"
+            "\nThe result includes \"quorumConnections\", the progress of connecting to the members of each\n"
+            "quorum this node participates in or watches. Connect times are in milliseconds.\n"
+            "Each session also includes \"phaseTimes\", the time in milliseconds spent in each phase on our own\n"
+            "messages (\"start\") and on processing incoming messages (\"messages\", in \"batches\" batches).\n"
     );
 }
 
@@ -186,6 +192,28 @@ UniValue quorum_dkgstatus(const JSONRPCRequest& request)
 
     ret.push_back(Pair("minableCommitments", minableCommitments));
 
+    UniValue quorumConnections(UniValue::VARR);
+    if (g_connman) {
+        for (const auto& stats : g_connman->GetMasternodeQuorumConnStats()) {
+            auto itParams = Params().GetConsensus().llmqs.find(stats.llmqType);
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("llmqType", itParams != Params().GetConsensus().llmqs.end() ? itParams->second.name : std::to_string((int)stats.llmqType)));
+            obj.push_back(Pair("quorumHash", stats.quorumHash.ToString()));
+            obj.push_back(Pair("dkg", stats.fDKG));
+            obj.push_back(Pair("members", stats.nMembers));
+            obj.push_back(Pair("connected", stats.nConnected));
+            obj.push_back(Pair("attempts", stats.nAttempts));
+            obj.push_back(Pair("failures", stats.nFailures));
+            obj.push_back(Pair("avgConnectMs", stats.nSucceeded > 0 ? stats.nConnectTimeTotal / stats.nSucceeded / 1000 : 0));
+            obj.push_back(Pair("maxConnectMs", stats.nConnectTimeMax / 1000));
+            if (stats.nTimeAllConnected != 0) {
+                obj.push_back(Pair("allConnectedMs", stats.nTimeAllConnected / 1000));
+            }
+            quorumConnections.push_back(obj);
+        }
+    }
+    ret.push_back(Pair("quorumConnections", quorumConnections));
+
     return ret;
 }
 
@@ -372,6 +400,35 @@ UniValue quorum_dkgsimerror(const JSONRPCRequest& request)
 }
 
 
+void quorum_sigsharestats_help()
+{
+    throw std::runtime_error(
+            "quorum sigsharestats\n"
+            "Return statistics about the batched verification of incoming signature shares.\n"
+            "Verify times are in microseconds.\n"
+    );
+}
+
+UniValue quorum_sigsharestats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        quorum_sigsharestats_help();
+    }
+
+    auto stats = llmq::quorumSigSharesManager->GetVerifyStats();
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("batches", stats.nBatches));
+    ret.push_back(Pair("sigShares", stats.nSigShares));
+    ret.push_back(Pair("badSigShares", stats.nBadSigShares));
+    ret.push_back(Pair("verifyTime", stats.nVerifyTimeTotal));
+    ret.push_back(Pair("lastBatchSize", (uint64_t)stats.nLastBatchSize));
+    ret.push_back(Pair("lastVerifyTime", stats.nLastVerifyTime));
+    ret.push_back(Pair("maxBatchSize", (uint64_t)stats.nMaxBatchSize));
+    ret.push_back(Pair("batchLimit", (uint64_t)stats.nBatchLimit));
+    return ret;
+}
+
 [[ noreturn ]] void quorum_help()
 {
     throw std::runtime_error(
@@ -385,6 +442,7 @@ UniValue quorum_dkgsimerror(const JSONRPCRequest& request)
             "  info              - Return information about a quorum\n"
             "  dkgsimerror       - Simulates DKG errors and malicious behavior.\n"
             "  dkgstatus         - Return the status of the current DKG process\n"
+            "  sigsharestats     - Return statistics about signature share verification\n"
             "  memberof          - Checks which quorums the given masternode is a member of\n"
             "  sign              - Threshold-sign a message\n"
             "  hasrecsig         - Test if a valid recovered signature is present\n"
@@ -410,6 +468,8 @@ UniValue quorum(const JSONRPCRequest& request)
         return quorum_info(request);
     } else if (command == "dkgstatus") {
         return quorum_dkgstatus(request);
+    } else if (command == "sigsharestats") {
+        return quorum_sigsharestats(request);
     } else if (command == "memberof") {
         return quorum_memberof(request);
     } else if (command == "sign" || command == "hasrecsig" || command == "getrecsig" || command == "isconflicting") {
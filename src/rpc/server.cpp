@@ -29,8 +29,11 @@
 #include <boost/algorithm/string/split.hpp>
 
 #include <algorithm>
+#include <atomic>
 #include <memory> // for unique_ptr
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 
 static bool fRPCRunning = false;
 static bool fRPCInWarmup = true;
@@ -380,6 +383,18 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
     return true;
 }
 
+bool CRPCTable::appendStreamer(const std::string& name, rpcstreamfn_type streamer)
+{
+    if (IsRPCRunning())
+        return false;
+
+    if (!mapCommands.count(name) || mapStreamers.count(name))
+        return false;
+
+    mapStreamers[name] = streamer;
+    return true;
+}
+
 bool StartRPC()
 {
     LogPrint("rpc", "Starting RPC\n");
@@ -483,11 +498,89 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
+static const std::unordered_set<std::string> setSlowMethods = {
+    "gettxoutsetinfo", "dumptxoutset", "verifychain", "getchaintips",
+    "getaddressbalance", "getaddressdeltas", "getaddresstxids", "getaddressutxos",
+    "masternodelist", "gobject", "protx",
+    "dumpwallet", "importwallet", "importprivkey", "importaddress", "importpubkey", "importmulti",
+};
+
+bool IsSlowRPCMethod(const std::string& method)
+{
+    return setSlowMethods.count(method);
+}
+
+static CCriticalSection cs_rpcMethodStats;
+static std::map<std::string, CRPCMethodStats> mapRPCMethodStats;
+
+std::map<std::string, CRPCMethodStats> GetRPCMethodStats()
+{
+    LOCK(cs_rpcMethodStats);
+    return mapRPCMethodStats;
+}
+
+static void RecordRPCMethodCall(const std::string& method, int64_t nMicros, bool fError)
+{
+    LOCK(cs_rpcMethodStats);
+    CRPCMethodStats& stats = mapRPCMethodStats[method];
+    stats.nCalls++;
+    if (fError)
+        stats.nErrors++;
+    stats.nTotalMicros += nMicros;
+    stats.nMaxMicros = std::max(stats.nMaxMicros, nMicros);
+}
+
+/** Calls that neither change state nor depend on an earlier call of the same batch */
+static const std::unordered_set<std::string> setReadOnlyBatchMethods = {
+    "getbestblockhash", "getblock", "getblockcount", "getblockhash", "getblockheader", "getblockheaders",
+    "getrawtransaction", "decoderawtransaction", "decodescript", "gettxout", "getspentinfo",
+    "getaddressbalance", "getaddressdeltas", "getaddresstxids", "getaddressutxos", "getaddressmempool",
+    "getmempoolentry", "validateaddress",
+};
+
+static bool IsReadOnlyBatchRequest(const UniValue& req)
+{
+    if (!req.isObject())
+        return false;
+    const UniValue& method = find_value(req.get_obj(), "method");
+    return method.isStr() && setReadOnlyBatchMethods.count(method.get_str());
+}
+
 std::string JSONRPCExecBatch(const UniValue& vReq)
 {
+    const size_t nReqs = vReq.size();
+    std::vector<UniValue> vReplies(nReqs);
+    const int nMaxThreads = std::max((int)GetArg("-rpcbatchthreads", DEFAULT_RPC_BATCH_THREADS), 1);
+
+    size_t reqIdx = 0;
+    while (reqIdx < nReqs) {
+        // Anything else runs on its own, in order, as its effects may be seen by the next calls
+        size_t nEnd = reqIdx;
+        while (nEnd < nReqs && IsReadOnlyBatchRequest(vReq[nEnd]))
+            nEnd++;
+        if (nEnd == reqIdx) {
+            vReplies[reqIdx] = JSONRPCExecOne(vReq[reqIdx]);
+            reqIdx++;
+            continue;
+        }
+
+        std::atomic<size_t> nNext(reqIdx);
+        auto execRun = [&]() {
+            for (size_t i = nNext++; i < nEnd; i = nNext++)
+                vReplies[i] = JSONRPCExecOne(vReq[i]);
+        };
+        std::vector<std::thread> vThreads;
+        for (size_t i = 1; i < std::min((size_t)nMaxThreads, nEnd - reqIdx); i++)
+            vThreads.emplace_back(execRun);
+        execRun();
+        for (std::thread& thread : vThreads)
+            thread.join();
+        reqIdx = nEnd;
+    }
+
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    for (UniValue& reply : vReplies)
+        ret.push_back(reply);
 
     return ret.write() + "\n";
 }
@@ -558,19 +651,66 @@ UniValue CRPCTable::execute(const JSONRPCRequest &request) const
 
     g_rpcSignals.PreCommand(*pcmd);
 
+    int64_t nTimeStart = GetTimeMicros();
+    CAddressMemo addressMemo;
     try
     {
         // Execute, convert arguments to array if necessary
+        UniValue result;
         if (request.params.isObject()) {
-            return pcmd->actor(transformNamedArguments(request, pcmd->argNames));
+            result = pcmd->actor(transformNamedArguments(request, pcmd->argNames));
         } else {
-            return pcmd->actor(request);
+            result = pcmd->actor(request);
         }
+        RecordRPCMethodCall(pcmd->name, GetTimeMicros() - nTimeStart, false);
+        return result;
     }
     catch (const std::exception& e)
     {
+        RecordRPCMethodCall(pcmd->name, GetTimeMicros() - nTimeStart, true);
         throw JSONRPCError(RPC_MISC_ERROR, e.what());
     }
+    catch (...)
+    {
+        RecordRPCMethodCall(pcmd->name, GetTimeMicros() - nTimeStart, true);
+        throw;
+    }
+}
+
+bool CRPCTable::executeStreaming(const JSONRPCRequest &request, CJSONWriter& writer) const
+{
+    auto it = mapStreamers.find(request.strMethod);
+    if (it == mapStreamers.end() || !request.params.isArray())
+        return false;
+
+    {
+        LOCK(cs_rpcWarmup);
+        if (fRPCInWarmup)
+            throw JSONRPCError(RPC_IN_WARMUP, rpcWarmupStatus);
+    }
+
+    const CRPCCommand *pcmd = tableRPC[request.strMethod];
+    g_rpcSignals.PreCommand(*pcmd);
+
+    int64_t nTimeStart = GetTimeMicros();
+    CAddressMemo addressMemo;
+    try
+    {
+        if (!it->second(request, writer))
+            return false;
+        RecordRPCMethodCall(pcmd->name, GetTimeMicros() - nTimeStart, false);
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        RecordRPCMethodCall(pcmd->name, GetTimeMicros() - nTimeStart, true);
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+    catch (...)
+    {
+        RecordRPCMethodCall(pcmd->name, GetTimeMicros() - nTimeStart, true);
+        throw;
+    }
 }
 
 std::vector<std::string> CRPCTable::listCommands() const
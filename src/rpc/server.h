@@ -19,6 +19,9 @@
 
 #include <univalue.h>
 
+static const int DEFAULT_RPC_BATCH_THREADS = 4;
+
+class CJSONWriter;
 class CRPCCommand;
 
 namespace RPCServer
@@ -131,6 +134,12 @@ void RPCUnsetTimerInterface(RPCTimerInterface *iface);
 void RPCRunLater(const std::string& name, boost::function<void(void)> func, int64_t nSeconds);
 
 typedef UniValue(*rpcfn_type)(const JSONRPCRequest& jsonRequest);
+/**
+ * Writes the result of a call with a large result straight into a CJSONWriter, instead of
+ * returning it as one UniValue. Returns false, before writing anything, to leave the call to the
+ * normal actor. It should only throw before anything was written.
+ */
+typedef bool(*rpcstreamfn_type)(const JSONRPCRequest& jsonRequest, CJSONWriter& writer);
 
 class CRPCCommand
 {
@@ -149,6 +158,7 @@ class CRPCTable
 {
 private:
     std::map<std::string, const CRPCCommand*> mapCommands;
+    std::map<std::string, rpcstreamfn_type> mapStreamers;
 public:
     CRPCTable();
     const CRPCCommand* operator[](const std::string& name) const;
@@ -162,6 +172,13 @@ public:
      */
     UniValue execute(const JSONRPCRequest &request) const;
 
+    /**
+     * Execute a method by writing its result into writer, if it has a streamer for this request.
+     * @returns false if the method has to be run by execute() instead, nothing was written then.
+     * @throws an exception (UniValue) when an error happens, like execute().
+     */
+    bool executeStreaming(const JSONRPCRequest &request, CJSONWriter& writer) const;
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
@@ -174,6 +191,11 @@ public:
      * Commands cannot be overwritten (returns false).
      */
     bool appendCommand(const std::string& name, const CRPCCommand* pcmd);
+
+    /**
+     * Adds a streamer to a command that is already in the table, with the same rules.
+     */
+    bool appendStreamer(const std::string& name, rpcstreamfn_type streamer);
 };
 
 extern CRPCTable tableRPC;
@@ -201,6 +223,19 @@ extern std::string HelpExampleRpc(const std::string& methodname, const std::stri
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
+struct CRPCMethodStats
+{
+    uint64_t nCalls = 0;
+    uint64_t nErrors = 0;
+    int64_t nTotalMicros = 0;
+    int64_t nMaxMicros = 0;
+};
+
+/** Calls, errors and execution times of each method that was called since startup */
+std::map<std::string, CRPCMethodStats> GetRPCMethodStats();
+/** Methods that can run for a long time, run by the slow lane of the HTTP server */
+bool IsSlowRPCMethod(const std::string& method);
+/** Execute a batch of requests, runs of read-only calls on up to -rpcbatchthreads threads. Replies keep the order of the requests. */
 std::string JSONRPCExecBatch(const UniValue& vReq);
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 
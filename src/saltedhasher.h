@@ -8,8 +8,14 @@
 #define SALTEDHASHER_H
 
 #include "hash.h"
+#include "netaddress.h"
+#include "primitives/transaction.h"
 #include "uint256.h"
 
+#include <algorithm>
+#include <deque>
+#include <unordered_set>
+
 /** Helper classes for std::unordered_map and std::unordered_set hashing */
 
 template<typename T> struct SaltedHasherImpl;
@@ -32,6 +38,15 @@ struct SaltedHasherImpl<std::pair<N, uint256>>
     }
 };
 
+template<>
+struct SaltedHasherImpl<std::pair<uint256, uint256>>
+{
+    static std::size_t CalcHash(const std::pair<uint256, uint256>& v, uint64_t k0, uint64_t k1)
+    {
+        return CSipHasher(k0, k1).Write(v.first.begin(), v.first.size()).Write(v.second.begin(), v.second.size()).Finalize();
+    }
+};
+
 template<>
 struct SaltedHasherImpl<uint256>
 {
@@ -41,6 +56,37 @@ struct SaltedHasherImpl<uint256>
     }
 };
 
+template<>
+struct SaltedHasherImpl<COutPoint>
+{
+    static std::size_t CalcHash(const COutPoint& v, uint64_t k0, uint64_t k1)
+    {
+        return SipHashUint256Extra(k0, k1, v.hash, v.n);
+    }
+};
+
+template<>
+struct SaltedHasherImpl<uint160>
+{
+    static std::size_t CalcHash(const uint160& v, uint64_t k0, uint64_t k1)
+    {
+        return CSipHasher(k0, k1).Write(v.begin(), v.size()).Finalize();
+    }
+};
+
+template<>
+struct SaltedHasherImpl<CService>
+{
+    static std::size_t CalcHash(const CService& v, uint64_t k0, uint64_t k1)
+    {
+        unsigned char ip[16];
+        for (int i = 0; i < 16; i++) {
+            ip[i] = v.GetByte(15 - i);
+        }
+        return CSipHasher(k0, k1).Write(ip, sizeof(ip)).Write(v.GetPort()).Finalize();
+    }
+};
+
 struct SaltedHasherBase
 {
     /** Salt */
@@ -74,4 +120,71 @@ struct StaticSaltedHasher
     }
 };
 
+/**
+ * Set of recently seen items (e.g. message hashes), kept in a ring of generations which each cover a fixed time span.
+ * Insert and Contains are O(1) per generation. Expire drops whole generations, so there is no need for a timestamp per
+ * entry or for periodic full scans. Items are kept for at least maxAge and at most maxAge plus one generation span.
+ */
+template<typename T, typename Hasher = StaticSaltedHasher>
+class CAgingSeenSet
+{
+private:
+    int64_t maxAge;
+    int64_t generationSpan;
+
+    // oldest first, each with the time at which it started
+    std::deque<std::pair<int64_t, std::unordered_set<T, Hasher>>> generations;
+
+public:
+    explicit CAgingSeenSet(int64_t _maxAge, size_t generationCount = 4) :
+        maxAge(_maxAge),
+        generationSpan(std::max<int64_t>(1, _maxAge / (int64_t)std::max<size_t>(1, generationCount))) {}
+
+    // Returns false if the item was already in the set
+    bool Insert(const T& v, int64_t nTime)
+    {
+        if (Contains(v)) {
+            return false;
+        }
+        if (generations.empty() || nTime >= generations.back().first + generationSpan) {
+            Expire(nTime);
+            generations.emplace_back(nTime, std::unordered_set<T, Hasher>());
+        }
+        generations.back().second.emplace(v);
+        return true;
+    }
+
+    bool Contains(const T& v) const
+    {
+        for (auto it = generations.rbegin(); it != generations.rend(); ++it) {
+            if (it->second.count(v)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Drops all generations which only contain items older than maxAge
+    void Expire(int64_t nTime)
+    {
+        while (!generations.empty() && generations.front().first + generationSpan <= nTime - maxAge) {
+            generations.pop_front();
+        }
+    }
+
+    size_t size() const
+    {
+        size_t ret = 0;
+        for (const auto& g : generations) {
+            ret += g.second.size();
+        }
+        return ret;
+    }
+
+    void clear()
+    {
+        generations.clear();
+    }
+};
+
 #endif//SALTEDHASHER_H
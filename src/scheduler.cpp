@@ -8,10 +8,12 @@
 
 #include <assert.h>
 #include <boost/bind.hpp>
+#include <algorithm>
 #include <utility>
 
-CScheduler::CScheduler() : nThreadsServicingQueue(0), stopRequested(false), stopWhenEmpty(false)
+CScheduler::CScheduler() : nWheelTasks(0), nThreadsServicingQueue(0), nTasksRunning(0), stopRequested(false), stopWhenEmpty(false)
 {
+    nCurrentTick = boost::chrono::duration_cast<boost::chrono::milliseconds>(boost::chrono::system_clock::now().time_since_epoch()).count();
 }
 
 CScheduler::~CScheduler()
@@ -27,60 +29,182 @@ static boost::system_time toPosixTime(const boost::chrono::system_clock::time_po
 }
 #endif
 
-void CScheduler::serviceQueue()
+int64_t CScheduler::ToTick(const boost::chrono::system_clock::time_point& t)
+{
+    // Rounded up, a task is only due once the whole tick it is in has begun
+    int64_t nMicros = boost::chrono::duration_cast<boost::chrono::microseconds>(t.time_since_epoch()).count();
+    return nMicros / 1000 + (nMicros % 1000 > 0);
+}
+
+boost::chrono::system_clock::time_point CScheduler::FromTick(int64_t nTick)
+{
+    return boost::chrono::system_clock::time_point(boost::chrono::milliseconds(nTick));
+}
+
+void CScheduler::insertTask(Task&& task)
+{
+    if (task.nTick <= nCurrentTick) {
+        auto it = std::upper_bound(readyQueue.begin(), readyQueue.end(), task, [](const Task& a, const Task& b) {
+            return a.time < b.time;
+        });
+        readyQueue.insert(it, std::move(task));
+        return;
+    }
+
+    // Level n holds the tasks due in 2^(8n) to 2^(8n+8) ticks, by the n-th byte of their
+    // tick. They move down a level when the lower levels wrap around to that slot.
+    int64_t nDelta = task.nTick - nCurrentTick;
+    int nLevel = 0;
+    while (nLevel < WHEEL_LEVELS - 1 && nDelta >= ((int64_t)1 << (WHEEL_BITS * (nLevel + 1))))
+        nLevel++;
+    int64_t nSlotTick = task.nTick;
+    if (nDelta >= ((int64_t)1 << (WHEEL_BITS * WHEEL_LEVELS)))
+        nSlotTick = nCurrentTick + ((int64_t)1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+    wheel[nLevel][(nSlotTick >> (WHEEL_BITS * nLevel)) & WHEEL_MASK].push_back(std::move(task));
+    nWheelTasks++;
+}
+
+int64_t CScheduler::nextTick() const
+{
+    // The next tick with tasks on the lowest level, or the next one that cascades
+    for (int64_t nTick = nCurrentTick + 1; ; nTick++) {
+        if ((nTick & WHEEL_MASK) == 0 || !wheel[0][nTick & WHEEL_MASK].empty())
+            return nTick;
+    }
+}
+
+void CScheduler::advance(int64_t nTick)
+{
+    while (nCurrentTick < nTick) {
+        int64_t nNext = nWheelTasks ? nextTick() : nTick + 1;
+        if (nNext > nTick) {
+            nCurrentTick = nTick;
+            return;
+        }
+        nCurrentTick = nNext;
+
+        for (int nLevel = 1; nLevel < WHEEL_LEVELS; nLevel++) {
+            if (nCurrentTick & (((int64_t)1 << (WHEEL_BITS * nLevel)) - 1))
+                break;
+            Slot tasks;
+            tasks.swap(wheel[nLevel][(nCurrentTick >> (WHEEL_BITS * nLevel)) & WHEEL_MASK]);
+            nWheelTasks -= tasks.size();
+            for (Task& task : tasks)
+                insertTask(std::move(task));
+        }
+
+        Slot tasks;
+        tasks.swap(wheel[0][nCurrentTick & WHEEL_MASK]);
+        nWheelTasks -= tasks.size();
+        std::stable_sort(tasks.begin(), tasks.end(), [](const Task& a, const Task& b) {
+            return a.time < b.time;
+        });
+        for (Task& task : tasks)
+            readyQueue.push_back(std::move(task));
+    }
+}
+
+bool CScheduler::popReady(const std::string* pstrDedicated, Task& taskRet)
+{
+    for (auto it = readyQueue.begin(); it != readyQueue.end(); ++it) {
+        if (setRunning.count(it->strName))
+            continue;
+        if (pstrDedicated ? it->strName != *pstrDedicated : mapDedicated.count(it->strName) != 0)
+            continue;
+        taskRet = std::move(*it);
+        readyQueue.erase(it);
+        return true;
+    }
+    return false;
+}
+
+void CScheduler::service(const std::string* pstrDedicated)
 {
     boost::unique_lock<boost::mutex> lock(newTaskMutex);
     ++nThreadsServicingQueue;
+    if (pstrDedicated)
+        ++mapDedicated[*pstrDedicated];
+
+    auto leave = [&]() {
+        --nThreadsServicingQueue;
+        if (pstrDedicated && --mapDedicated[*pstrDedicated] == 0)
+            mapDedicated.erase(*pstrDedicated);
+    };
 
     // newTaskMutex is locked throughout this loop EXCEPT
     // when the thread is waiting or when the user's function
     // is called.
     while (!shouldStop()) {
         try {
-            while (!shouldStop() && taskQueue.empty()) {
-                // Wait until there is something to do.
-                newTaskScheduled.wait(lock);
-            }
-
-            // Wait until either there is a new task, or until
-            // the time of the first item on the queue:
+            boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+            // Rounded down, everything up to the tick that has begun is due
+            advance(boost::chrono::duration_cast<boost::chrono::milliseconds>(now.time_since_epoch()).count());
 
+            Task task;
+            if (!popReady(pstrDedicated, task)) {
+                // Wait for a new task, one that was running to finish, or the next
+                // tick that needs to be looked at
+                if (nWheelTasks == 0) {
+                    newTaskScheduled.wait(lock);
+                    continue;
+                }
+                boost::chrono::system_clock::time_point timeToWaitFor = FromTick(nextTick());
 // wait_until needs boost 1.50 or later; older versions have timed_wait:
 #if BOOST_VERSION < 105000
-            while (!shouldStop() && !taskQueue.empty() &&
-                   newTaskScheduled.timed_wait(lock, toPosixTime(taskQueue.begin()->first))) {
-                // Keep waiting until timeout
-            }
+                newTaskScheduled.timed_wait(lock, toPosixTime(timeToWaitFor));
 #else
-            // Some boost versions have a conflicting overload of wait_until that returns void.
-            // Explicitly use a template here to avoid hitting that overload.
-            while (!shouldStop() && !taskQueue.empty()) {
-                boost::chrono::system_clock::time_point timeToWaitFor = taskQueue.begin()->first;
-                if (newTaskScheduled.wait_until<>(lock, timeToWaitFor) == boost::cv_status::timeout)
-                    break; // Exit loop after timeout, it means we reached the time of the event
-            }
+                // Some boost versions have a conflicting overload of wait_until that returns void.
+                // Explicitly use a template here to avoid hitting that overload.
+                newTaskScheduled.wait_until<>(lock, timeToWaitFor);
 #endif
-            // If there are multiple threads, the queue can empty while we're waiting (another
-            // thread may service the task we were waiting on).
-            if (shouldStop() || taskQueue.empty())
                 continue;
+            }
 
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
-
-            {
+            setRunning.insert(task.strName);
+            ++nTasksRunning;
+            int64_t nDelay = boost::chrono::duration_cast<boost::chrono::microseconds>(now - task.time).count();
+            boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+            try {
                 // Unlock before calling f, so it can reschedule itself or another task
                 // without deadlocking:
                 reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
-                f();
+                task.f();
+            } catch (...) {
+                setRunning.erase(task.strName);
+                --nTasksRunning;
+                newTaskScheduled.notify_all();
+                throw;
             }
+            int64_t nMicros = boost::chrono::duration_cast<boost::chrono::microseconds>(boost::chrono::steady_clock::now() - start).count();
+
+            TaskStats& stats = mapTaskStats[task.strName];
+            stats.nRuns++;
+            stats.nTotalMicros += nMicros;
+            stats.nMaxMicros = std::max(stats.nMaxMicros, nMicros);
+            stats.nTotalDelayMicros += std::max<int64_t>(nDelay, 0);
+            stats.nMaxDelayMicros = std::max(stats.nMaxDelayMicros, nDelay);
+
+            setRunning.erase(task.strName);
+            --nTasksRunning;
+            // Other threads may be waiting for this name to be free, or for the queue to drain
+            newTaskScheduled.notify_all();
         } catch (...) {
-            --nThreadsServicingQueue;
+            leave();
             throw;
         }
     }
-    --nThreadsServicingQueue;
-    newTaskScheduled.notify_one();
+    leave();
+    newTaskScheduled.notify_all();
+}
+
+void CScheduler::serviceQueue()
+{
+    service(nullptr);
+}
+
+void CScheduler::serviceDedicated(const std::string& strName)
+{
+    service(&strName);
 }
 
 void CScheduler::stop(bool drain)
@@ -95,39 +219,65 @@ void CScheduler::stop(bool drain)
     newTaskScheduled.notify_all();
 }
 
-void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t)
+void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t, const std::string& strName)
 {
     {
         boost::unique_lock<boost::mutex> lock(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
+        Task task;
+        task.time = t;
+        task.nTick = ToTick(t);
+        task.f = std::move(f);
+        task.strName = strName;
+        insertTask(std::move(task));
     }
-    newTaskScheduled.notify_one();
+    // Wake all threads, the one getting a notify_one might not be allowed to run the task
+    newTaskScheduled.notify_all();
 }
 
-void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds, const std::string& strName)
 {
-    schedule(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds));
+    schedule(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds), strName);
 }
 
-static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds)
+static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds, const std::string& strName)
 {
     f();
-    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaMilliSeconds), deltaMilliSeconds);
+    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaMilliSeconds, strName), deltaMilliSeconds, strName);
 }
 
-void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds, const std::string& strName)
 {
-    scheduleFromNow(boost::bind(&Repeat, this, f, deltaMilliSeconds), deltaMilliSeconds);
+    scheduleFromNow(boost::bind(&Repeat, this, f, deltaMilliSeconds, strName), deltaMilliSeconds, strName);
 }
 
 size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
                              boost::chrono::system_clock::time_point &last) const
 {
     boost::unique_lock<boost::mutex> lock(newTaskMutex);
-    size_t result = taskQueue.size();
-    if (!taskQueue.empty()) {
-        first = taskQueue.begin()->first;
-        last = taskQueue.rbegin()->first;
+    size_t result = nWheelTasks + readyQueue.size();
+    bool fFound = false;
+    auto visit = [&](const Task& task) {
+        if (!fFound || task.time < first)
+            first = task.time;
+        if (!fFound || task.time > last)
+            last = task.time;
+        fFound = true;
+    };
+    for (const Task& task : readyQueue)
+        visit(task);
+    if (nWheelTasks) {
+        for (int nLevel = 0; nLevel < WHEEL_LEVELS; nLevel++) {
+            for (const Slot& slot : wheel[nLevel]) {
+                for (const Task& task : slot)
+                    visit(task);
+            }
+        }
     }
     return result;
 }
+
+std::map<std::string, CScheduler::TaskStats> CScheduler::getTaskStats() const
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    return mapTaskStats;
+}
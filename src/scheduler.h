@@ -12,7 +12,14 @@
 //
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
+#include <deque>
 #include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+static const int DEFAULT_SCHEDULER_THREADS = 2;
+static const int MAX_SCHEDULER_THREADS = 8;
 
 //
 // Simple class for background tasks that should be run
@@ -31,6 +38,15 @@
 // delete t;
 // delete s; // Must be done after thread is interrupted/joined.
 //
+// Tasks are kept in a hierarchical timer wheel of millisecond ticks, so scheduling
+// and expiring them does not depend on how many are waiting. Any number of threads
+// may run serviceQueue as a worker pool. Tasks can be given a name: tasks of the
+// same name never run at the same time, in the order they became due, and their
+// execution times are tracked per name. Unnamed tasks all share one name, so they
+// keep running one after another like with a single service thread. The tasks of a
+// name can also be pinned to their own thread with serviceDedicated, so a heavy job
+// can not hold up a worker of the pool.
+//
 
 class CScheduler
 {
@@ -40,18 +56,27 @@ public:
 
     typedef std::function<void(void)> Function;
 
+    struct TaskStats {
+        uint64_t nRuns = 0;
+        int64_t nTotalMicros = 0;
+        int64_t nMaxMicros = 0;
+        //! How long tasks were due before a thread started them
+        int64_t nTotalDelayMicros = 0;
+        int64_t nMaxDelayMicros = 0;
+    };
+
     // Call func at/after time t
-    void schedule(Function f, boost::chrono::system_clock::time_point t);
+    void schedule(Function f, boost::chrono::system_clock::time_point t, const std::string& strName = "");
 
     // Convenience method: call f once deltaSeconds from now
-    void scheduleFromNow(Function f, int64_t deltaMilliSeconds);
+    void scheduleFromNow(Function f, int64_t deltaMilliSeconds, const std::string& strName = "");
 
     // Another convenience method: call f approximately
     // every deltaSeconds forever, starting deltaSeconds from now.
     // To be more precise: every time f is finished, it
     // is rescheduled to run deltaSeconds later. If you
     // need more accurate scheduling, don't use this method.
-    void scheduleEvery(Function f, int64_t deltaMilliSeconds);
+    void scheduleEvery(Function f, int64_t deltaMilliSeconds, const std::string& strName = "");
 
     // To keep things as simple as possible, there is no unschedule.
 
@@ -59,6 +84,10 @@ public:
     // and interrupted using boost::interrupt_thread
     void serviceQueue();
 
+    // Like serviceQueue, but only runs the tasks named strName. While such a
+    // thread exists, serviceQueue leaves those tasks to it.
+    void serviceDedicated(const std::string& strName);
+
     // Tell any threads running serviceQueue to stop as soon as they're
     // done servicing whatever task they're currently servicing (drain=false)
     // or when there is no work left to be done (drain=true)
@@ -69,14 +98,49 @@ public:
     size_t getQueueInfo(boost::chrono::system_clock::time_point &first,
                         boost::chrono::system_clock::time_point &last) const;
 
+    // Execution times by task name since startup
+    std::map<std::string, TaskStats> getTaskStats() const;
+
 private:
-    std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
+    struct Task {
+        boost::chrono::system_clock::time_point time;
+        int64_t nTick;
+        Function f;
+        std::string strName;
+    };
+    typedef std::vector<Task> Slot;
+
+    //! 4 levels of 256 slots cover 2^32 ms, about 49 days, the rest waits in the last slot
+    static const int WHEEL_LEVELS = 4;
+    static const int WHEEL_BITS = 8;
+    static const int WHEEL_SLOTS = 1 << WHEEL_BITS;
+    static const int64_t WHEEL_MASK = WHEEL_SLOTS - 1;
+
+    Slot wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+    //! Ticks up to and including nCurrentTick have been expired into readyQueue
+    int64_t nCurrentTick;
+    size_t nWheelTasks;
+    //! Due tasks, oldest first
+    std::deque<Task> readyQueue;
+    std::set<std::string> setRunning;
+    std::map<std::string, int> mapDedicated;
+    std::map<std::string, TaskStats> mapTaskStats;
+
     boost::condition_variable newTaskScheduled;
     mutable boost::mutex newTaskMutex;
     int nThreadsServicingQueue;
+    int nTasksRunning;
     bool stopRequested;
     bool stopWhenEmpty;
-    bool shouldStop() { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
+    bool shouldStop() const { return stopRequested || (stopWhenEmpty && nWheelTasks == 0 && readyQueue.empty() && nTasksRunning == 0); }
+
+    static int64_t ToTick(const boost::chrono::system_clock::time_point& t);
+    static boost::chrono::system_clock::time_point FromTick(int64_t nTick);
+    void insertTask(Task&& task);
+    void advance(int64_t nTick);
+    int64_t nextTick() const;
+    bool popReady(const std::string* pstrDedicated, Task& taskRet);
+    void service(const std::string* pstrDedicated);
 };
 
 #endif
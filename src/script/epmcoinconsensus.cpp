@@ -5,11 +5,17 @@
 
 #include "epmcoinconsensus.h"
 
+#include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "pubkey.h"
 #include "script/interpreter.h"
 #include "version.h"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
 namespace {
 
 /** A class that deserializes a single CTransaction one time. */
@@ -68,6 +74,57 @@ struct ECCryptoClosure
 };
 
 ECCryptoClosure instance_of_eccryptoclosure;
+
+/** One input to verify, the transaction and its precomputed data are shared by all of its inputs */
+struct InputCheck
+{
+    const CTransaction* tx;
+    const PrecomputedTransactionData* txdata;
+    unsigned int nIn;
+    CScript scriptPubKey;
+};
+
+/** Verifies all checks on up to nThreads threads and returns 1 if all of them are valid */
+int VerifyInputs(const std::vector<InputCheck>& checks, unsigned int flags, unsigned int nThreads, int* results)
+{
+    std::atomic<size_t> nNext{0};
+    std::atomic<bool> fAllValid{true};
+    auto worker = [&]() {
+        for (size_t i = nNext++; i < checks.size(); i = nNext++) {
+            const InputCheck& check = checks[i];
+            bool fValid;
+            try {
+                fValid = VerifyScript(check.tx->vin[check.nIn].scriptSig, check.scriptPubKey, flags, TransactionSignatureChecker(check.tx, check.nIn, check.txdata), NULL);
+            } catch (const std::exception&) {
+                fValid = false;
+            }
+            if (results)
+                results[i] = fValid ? 1 : 0;
+            if (!fValid)
+                fAllValid = false;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    size_t nExtraThreads = std::min<size_t>(std::max(nThreads, 1U), checks.size());
+    for (size_t i = 1; i < nExtraThreads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : threads) {
+        t.join();
+    }
+    return fAllValid ? 1 : 0;
+}
+
+void AddInputChecks(std::vector<InputCheck>& checks, const CTransaction& tx, const PrecomputedTransactionData& txdata,
+                    const unsigned char* const* spentOutputs, const unsigned int* spentOutputLens)
+{
+    for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++) {
+        size_t i = checks.size();
+        checks.push_back(InputCheck{&tx, &txdata, nIn, CScript(spentOutputs[i], spentOutputs[i] + spentOutputLens[i])});
+    }
+}
 }
 
 /** Check that all specified flags are part of the libconsensus interface. */
@@ -76,12 +133,12 @@ static bool verify_flags(unsigned int flags)
     return (flags & ~(epmcoinconsensus_SCRIPT_FLAGS_VERIFY_ALL)) == 0;
 }
 
-int epmcoinconsensus_verify_script(const unsigned char *scriptPubKey, unsigned int scriptPubKeyLen, CAmount amount,
+int epmcoinconsensus_verify_script(const unsigned char *scriptPubKey, unsigned int scriptPubKeyLen,
                                     const unsigned char *txTo        , unsigned int txToLen,
                                     unsigned int nIn, unsigned int flags, epmcoinconsensus_error* err)
 {
     if (!verify_flags(flags)) {
-        return epmcoinconsensus_ERR_INVALID_FLAGS;
+        return set_error(err, epmcoinconsensus_ERR_INVALID_FLAGS);
     }
     try {
         TxInputStream stream(SER_NETWORK, PROTOCOL_VERSION, txTo, txToLen);
@@ -100,6 +157,82 @@ int epmcoinconsensus_verify_script(const unsigned char *scriptPubKey, unsigned i
     }
 }
 
+int epmcoinconsensus_verify_transaction(const unsigned char* const* spentOutputs, const unsigned int* spentOutputLens,
+                                    unsigned int nSpentOutputs,
+                                    const unsigned char *txTo        , unsigned int txToLen,
+                                    unsigned int flags, unsigned int nThreads, int* results, epmcoinconsensus_error* err)
+{
+    if (!verify_flags(flags)) {
+        return set_error(err, epmcoinconsensus_ERR_INVALID_FLAGS);
+    }
+    try {
+        TxInputStream stream(SER_NETWORK, PROTOCOL_VERSION, txTo, txToLen);
+        CTransaction tx(deserialize, stream);
+        if (nSpentOutputs != tx.vin.size())
+            return set_error(err, epmcoinconsensus_ERR_SPENT_OUTPUTS_MISMATCH);
+        if (GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION) != txToLen)
+            return set_error(err, epmcoinconsensus_ERR_TX_SIZE_MISMATCH);
+
+        PrecomputedTransactionData txdata(tx);
+        std::vector<InputCheck> checks;
+        checks.reserve(nSpentOutputs);
+        AddInputChecks(checks, tx, txdata, spentOutputs, spentOutputLens);
+
+        // Regardless of the verification result, the tx did not error.
+        set_error(err, epmcoinconsensus_ERR_OK);
+
+        return VerifyInputs(checks, flags, nThreads, results);
+    } catch (const std::exception&) {
+        return set_error(err, epmcoinconsensus_ERR_TX_DESERIALIZE); // Error deserializing
+    }
+}
+
+int epmcoinconsensus_verify_block(const unsigned char* const* spentOutputs, const unsigned int* spentOutputLens,
+                                    unsigned int nSpentOutputs,
+                                    const unsigned char *block       , unsigned int blockLen,
+                                    unsigned int flags, unsigned int nThreads, int* results, epmcoinconsensus_error* err)
+{
+    if (!verify_flags(flags)) {
+        return set_error(err, epmcoinconsensus_ERR_INVALID_FLAGS);
+    }
+    try {
+        TxInputStream stream(SER_NETWORK, PROTOCOL_VERSION, block, blockLen);
+        CBlock blk;
+        stream >> blk;
+        if (GetSerializeSize(blk, SER_NETWORK, PROTOCOL_VERSION) != blockLen)
+            return set_error(err, epmcoinconsensus_ERR_TX_SIZE_MISMATCH);
+
+        size_t nInputs = 0;
+        for (const auto& tx : blk.vtx) {
+            if (!tx->IsCoinBase())
+                nInputs += tx->vin.size();
+        }
+        if (nSpentOutputs != nInputs)
+            return set_error(err, epmcoinconsensus_ERR_SPENT_OUTPUTS_MISMATCH);
+
+        // built up front, the checks point into it
+        std::vector<PrecomputedTransactionData> vTxData;
+        vTxData.reserve(blk.vtx.size());
+        for (const auto& tx : blk.vtx) {
+            vTxData.emplace_back(*tx);
+        }
+
+        std::vector<InputCheck> checks;
+        checks.reserve(nInputs);
+        for (size_t i = 0; i < blk.vtx.size(); i++) {
+            if (!blk.vtx[i]->IsCoinBase())
+                AddInputChecks(checks, *blk.vtx[i], vTxData[i], spentOutputs, spentOutputLens);
+        }
+
+        // Regardless of the verification result, the block did not error.
+        set_error(err, epmcoinconsensus_ERR_OK);
+
+        return VerifyInputs(checks, flags, nThreads, results);
+    } catch (const std::exception&) {
+        return set_error(err, epmcoinconsensus_ERR_TX_DESERIALIZE); // Error deserializing
+    }
+}
+
 unsigned int epmcoinconsensus_version()
 {
     // Just use the API version for now
@@ -31,7 +31,7 @@
 extern "C" {
 #endif
 
-#define BITCOINCONSENSUS_API_VER 0
+#define BITCOINCONSENSUS_API_VER 1
 
 typedef enum epmcoinconsensus_error_t
 {
@@ -40,6 +40,7 @@ typedef enum epmcoinconsensus_error_t
     epmcoinconsensus_ERR_TX_SIZE_MISMATCH,
     epmcoinconsensus_ERR_TX_DESERIALIZE,
     epmcoinconsensus_ERR_INVALID_FLAGS,
+    epmcoinconsensus_ERR_SPENT_OUTPUTS_MISMATCH,
 } epmcoinconsensus_error;
 
 /** Script verification flags */
@@ -64,6 +65,29 @@ EXPORT_SYMBOL int epmcoinconsensus_verify_script(const unsigned char *scriptPubK
                                     const unsigned char *txTo        , unsigned int txToLen,
                                     unsigned int nIn, unsigned int flags, epmcoinconsensus_error* err);
 
+/// Returns 1 if all inputs of the serialized transaction pointed to by txTo
+/// correctly spend their previous outputs under the constraints specified by
+/// flags. spentOutputs and spentOutputLens hold the scriptPubKeys of the
+/// previous outputs in input order, nSpentOutputs must match the number of
+/// inputs. The transaction is deserialized once and its inputs are verified
+/// on up to nThreads threads, 0 or 1 verify on the calling thread only.
+/// If not NULL, results receives 1 or 0 for each input and must have room for
+/// nSpentOutputs entries.
+/// If not NULL, err will contain an error/success code for the operation
+EXPORT_SYMBOL int epmcoinconsensus_verify_transaction(const unsigned char* const* spentOutputs, const unsigned int* spentOutputLens,
+                                    unsigned int nSpentOutputs,
+                                    const unsigned char *txTo        , unsigned int txToLen,
+                                    unsigned int flags, unsigned int nThreads, int* results, epmcoinconsensus_error* err);
+
+/// Same as epmcoinconsensus_verify_transaction for all inputs of all
+/// transactions of the serialized block pointed to by block, except for the
+/// coinbase. The previous outputs and results are in block order, i.e. the
+/// inputs of the first transaction after the coinbase come first.
+EXPORT_SYMBOL int epmcoinconsensus_verify_block(const unsigned char* const* spentOutputs, const unsigned int* spentOutputLens,
+                                    unsigned int nSpentOutputs,
+                                    const unsigned char *block       , unsigned int blockLen,
+                                    unsigned int flags, unsigned int nThreads, int* results, epmcoinconsensus_error* err);
+
 EXPORT_SYMBOL unsigned int epmcoinconsensus_version();
 
 #ifdef __cplusplus
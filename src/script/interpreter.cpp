@@ -11,6 +11,7 @@
 #include "crypto/sha256.h"
 #include "pubkey.h"
 #include "script/script.h"
+#include "streams.h"
 #include "uint256.h"
 
 typedef std::vector<unsigned char> valtype;
@@ -1115,43 +1116,60 @@ public:
     }
 };
 
-uint256 GetPrevoutHash(const CTransaction& txTo) {
-    CHashWriter ss(SER_GETHASH, 0);
-    for (const auto& txin : txTo.vin) {
-        ss << txin.prevout;
-    }
-    return ss.GetHash();
-}
+/** Stream feeding a single SHA256, to continue from a PrecomputedTransactionData state */
+class CSHA256Stream {
+private:
+    CSHA256& sha;
 
-uint256 GetSequenceHash(const CTransaction& txTo) {
-    CHashWriter ss(SER_GETHASH, 0);
-    for (const auto& txin : txTo.vin) {
-        ss << txin.nSequence;
+public:
+    explicit CSHA256Stream(CSHA256& shaIn) : sha(shaIn) {}
+    int GetType() const { return SER_GETHASH; }
+    int GetVersion() const { return 0; }
+    void write(const char* pch, size_t size) { sha.Write((const unsigned char*)pch, size); }
+
+    template<typename T>
+    CSHA256Stream& operator<<(const T& obj) {
+        ::Serialize(*this, obj);
+        return *this;
     }
-    return ss.GetHash();
-}
+};
 
-uint256 GetOutputsHash(const CTransaction& txTo) {
-    CHashWriter ss(SER_GETHASH, 0);
-    for (const auto& txout : txTo.vout) {
-        ss << txout;
-    }
-    return ss.GetHash();
-}
+//! With fewer inputs, building the states costs about as much as it saves
+const size_t MIN_PRECOMPUTE_INPUTS = 3;
 
 } // anon namespace
 
 PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
 {
-
-    hashPrevouts = GetPrevoutHash(txTo);
-    hashSequence = GetSequenceHash(txTo);
-    hashOutputs = GetOutputsHash(txTo);
+    if (txTo.vin.size() < MIN_PRECOMPUTE_INPUTS)
+        return;
+
+    // The same bytes CTransactionSignatureSerializer writes for SIGHASH_ALL, minus the
+    // scriptCode and the hash type
+    CVectorWriter writer(SER_GETHASH, 0, vBlanked, 0);
+    int32_t n32bitVersion = txTo.nVersion | (txTo.nType << 16);
+    writer << n32bitVersion;
+    WriteCompactSize(writer, txTo.vin.size());
+    vScriptPos.reserve(txTo.vin.size());
+    for (const CTxIn& txin : txTo.vin) {
+        writer << txin.prevout;
+        vScriptPos.push_back(vBlanked.size());
+        writer << CScriptBase() << txin.nSequence;
+    }
+    writer << txTo.vout << txTo.nLockTime;
+
+    vPrefixState.reserve(vScriptPos.size());
+    CSHA256 sha;
+    size_t nPos = 0;
+    for (uint32_t nScriptPos : vScriptPos) {
+        sha.Write(vBlanked.data() + nPos, nScriptPos - nPos);
+        nPos = nScriptPos;
+        vPrefixState.push_back(sha);
+    }
     ready = true;
-
 }
 
-uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType)
+uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const PrecomputedTransactionData* cache)
 {
     static const uint256 one(uint256S("0000000000000000000000000000000000000000000000000000000000000001"));
     if (nIn >= txTo.vin.size()) {
@@ -1170,6 +1188,25 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
+    // Anything that is neither SIGHASH_SINGLE nor SIGHASH_NONE is serialized like SIGHASH_ALL
+    int nBaseType = nHashType & 0x1f;
+    if (cache && cache->ready && !(nHashType & SIGHASH_ANYONECANPAY) && nBaseType != SIGHASH_SINGLE && nBaseType != SIGHASH_NONE) {
+        assert(cache->vScriptPos.size() == txTo.vin.size());
+        CSHA256 sha = cache->vPrefixState[nIn];
+        CSHA256Stream stream(sha);
+        txTmp.SerializeScriptCode(stream);
+        // the empty script of this input is a single zero byte in the blanked transaction
+        size_t nSuffixPos = cache->vScriptPos[nIn] + 1;
+        sha.Write(cache->vBlanked.data() + nSuffixPos, cache->vBlanked.size() - nSuffixPos);
+        stream << nHashType;
+
+        unsigned char buf[CSHA256::OUTPUT_SIZE];
+        uint256 result;
+        sha.Finalize(buf);
+        CSHA256().Write(buf, sizeof(buf)).Finalize(result.begin());
+        return result;
+    }
+
     // Serialize and hash
     CHashWriter ss(SER_GETHASH, 0);
     ss << txTmp << nHashType;
@@ -1194,7 +1231,7 @@ bool TransactionSignatureChecker::CheckSig(const std::vector<unsigned char>& vch
     int nHashType = vchSig.back();
     vchSig.pop_back();
 
-    uint256 sighash = SignatureHash(scriptCode, *txTo, nIn, nHashType);
+    uint256 sighash = SignatureHash(scriptCode, *txTo, nIn, nHashType, txdata);
 
     if (!VerifySignature(vchSig, pubkey, sighash))
         return false;
@@ -7,6 +7,7 @@
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
 #include "script_error.h"
+#include "crypto/sha256.h"
 #include "primitives/transaction.h"
 
 #include <vector>
@@ -94,15 +95,29 @@ enum
 
 bool CheckSignatureEncoding(const std::vector<unsigned char> &vchSig, unsigned int flags, ScriptError* serror);
 
+/**
+ * What the SIGHASH_ALL signature hashes of all inputs of a transaction have in common, so
+ * signing or verifying every input does not serialize and hash the whole transaction over
+ * and over. The preimage of input i is the transaction with all scripts left empty except
+ * for the scriptCode of input i, so everything before that script is kept as a hasher
+ * state and everything after it as bytes to feed into it. Does not depend on the scriptSigs
+ * of the transaction, it can be built before they are filled in.
+ */
 struct PrecomputedTransactionData
 {
-    uint256 hashPrevouts, hashSequence, hashOutputs;
+    //! The serialized transaction with every scriptSig empty
+    std::vector<unsigned char> vBlanked;
+    //! Offset of the empty script of each input in vBlanked
+    std::vector<uint32_t> vScriptPos;
+    //! Hasher state after vBlanked up to the script of each input
+    std::vector<CSHA256> vPrefixState;
+    //! Only built for transactions with enough inputs to be worth it
     bool ready = false;
 
     explicit PrecomputedTransactionData(const CTransaction& tx);
 };
 
-uint256 SignatureHash(const CScript &scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType);
+uint256 SignatureHash(const CScript &scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const PrecomputedTransactionData* cache = nullptr);
 
 class BaseSignatureChecker
 {
@@ -130,12 +145,13 @@ class TransactionSignatureChecker : public BaseSignatureChecker
 private:
     const CTransaction* txTo;
     unsigned int nIn;
+    const PrecomputedTransactionData* txdata;
 
 protected:
     virtual bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 
 public:
-    TransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn) : txTo(txToIn), nIn(nInIn) {}
+    TransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const PrecomputedTransactionData* txdataIn = nullptr) : txTo(txToIn), nIn(nInIn), txdata(txdataIn) {}
     bool CheckSig(const std::vector<unsigned char>& scriptSig, const std::vector<unsigned char>& vchPubKey, const CScript& scriptCode) const override;
     bool CheckLockTime(const CScriptNum& nLockTime) const override;
     bool CheckSequence(const CScriptNum& nSequence) const override;
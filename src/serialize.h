@@ -19,6 +19,7 @@
 #include <stdint.h>
 #include <string>
 #include <string.h>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -383,7 +384,9 @@ I ReadVarInt(Stream& is)
 #define FIXEDBITSET(obj, size) REF(CFixedBitSet(REF(obj), (size)))
 #define DYNBITSET(obj) REF(CDynamicBitSet(REF(obj)))
 #define FIXEDVARINTSBITSET(obj, size) REF(CFixedVarIntsBitSet(REF(obj), (size)))
+#define FIXEDRUNLENGTHBITSET(obj, size) REF(CFixedRunLengthBitSet(REF(obj), (size)))
 #define AUTOBITSET(obj, size) REF(CAutoBitSet(REF(obj), (size)))
+#define AUTOBITSET_RUNLENGTH(obj, size) REF(CAutoBitSet(REF(obj), (size), true))
 #define VARINT(obj) REF(WrapVarInt(REF(obj)))
 #define COMPACTSIZE(obj) REF(CCompactSize(REF(obj)))
 #define LIMITED_STRING(obj,n) REF(LimitedString< n >(REF(obj)))
@@ -539,17 +542,74 @@ public:
     }
 };
 
+/**
+ * Stores a fixed size bitset as a series of VarInts. Each VarInt is the length of a run of equal bits, alternating
+ * between unset and set bits and starting with unset ones. Only the first run may be empty and all runs must add up to
+ * the size of the bitset, so no stopper is needed.
+ */
+class CFixedRunLengthBitSet
+{
+protected:
+    std::vector<bool>& vec;
+    size_t size;
+
+public:
+    CFixedRunLengthBitSet(std::vector<bool>& vecIn, size_t sizeIn) : vec(vecIn), size(sizeIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        bool cur = false;
+        size_t pos = 0;
+        while (pos < size) {
+            size_t end = pos;
+            while (end < size && vec[end] == cur) {
+                end++;
+            }
+            WriteVarInt<Stream, uint32_t>(s, (uint32_t)(end - pos));
+            pos = end;
+            cur = !cur;
+        }
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        vec.assign(size, false);
+
+        bool cur = false;
+        size_t pos = 0;
+        while (pos < size) {
+            uint32_t run = ReadVarInt<Stream, uint32_t>(s);
+            if (run == 0 && pos != 0) {
+                throw std::ios_base::failure("empty run");
+            }
+            if (run > size - pos) {
+                throw std::ios_base::failure("out of bounds run");
+            }
+            if (cur) {
+                std::fill(vec.begin() + pos, vec.begin() + pos + run, true);
+            }
+            pos += run;
+            cur = !cur;
+        }
+    }
+};
+
 /**
  * Serializes either as a CFixedBitSet or CFixedVarIntsBitSet, depending on which would give a smaller size
+ * If allowRunLength is set, CFixedRunLengthBitSet is considered as well. Readers must then support it too, so this is
+ * only set where the format was negotiated (e.g. by protocol version)
  */
 class CAutoBitSet
 {
 protected:
     std::vector<bool>& vec;
     size_t size;
+    bool allowRunLength;
 
 public:
-    explicit CAutoBitSet(std::vector<bool>& vecIn, size_t sizeIn) : vec(vecIn), size(sizeIn) {}
+    explicit CAutoBitSet(std::vector<bool>& vecIn, size_t sizeIn, bool allowRunLengthIn = false) : vec(vecIn), size(sizeIn), allowRunLength(allowRunLengthIn) {}
 
     template<typename Stream>
     void Serialize(Stream& s) const
@@ -558,8 +618,12 @@ public:
 
         size_t size1 = ::GetSerializeSize(s, CFixedBitSet(vec, size));
         size_t size2 = ::GetSerializeSize(s, CFixedVarIntsBitSet(vec, size));
+        size_t size3 = allowRunLength ? ::GetSerializeSize(s, CFixedRunLengthBitSet(vec, size)) : std::numeric_limits<size_t>::max();
 
-        if (size1 < size2) {
+        if (size3 < size1 && size3 < size2) {
+            ser_writedata8(s, 2);
+            s << FIXEDRUNLENGTHBITSET(vec, vec.size());
+        } else if (size1 < size2) {
             ser_writedata8(s, 0);
             s << FIXEDBITSET(vec, vec.size());
         } else {
@@ -572,14 +636,16 @@ public:
     void Unserialize(Stream& s)
     {
         uint8_t isVarInts = ser_readdata8(s);
-        if (isVarInts != 0 && isVarInts != 1) {
+        if (isVarInts != 0 && isVarInts != 1 && !(allowRunLength && isVarInts == 2)) {
             throw std::ios_base::failure("invalid value for isVarInts byte");
         }
 
-        if (!isVarInts) {
+        if (isVarInts == 0) {
             s >> FIXEDBITSET(vec, size);
-        } else {
+        } else if (isVarInts == 1) {
             s >> FIXEDVARINTSBITSET(vec, size);
+        } else {
+            s >> FIXEDRUNLENGTHBITSET(vec, size);
         }
     }
 };
@@ -667,6 +733,17 @@ CVarInt<I> WrapVarInt(I& n) { return CVarInt<I>(n); }
 template<typename Stream, typename C> void Serialize(Stream& os, const std::basic_string<C>& str);
 template<typename Stream, typename C> void Unserialize(Stream& is, std::basic_string<C>& str);
 
+/**
+ * Types whose serialization is exactly their bytes in memory, like uint256, declare
+ * `typedef std::true_type SerializedAsBytes;`. Vectors and prevectors of them are written and
+ * read like those of unsigned char, with a single call for all elements instead of one each.
+ */
+template<typename T, typename = void> struct is_serialized_as_bytes : std::false_type {};
+template<typename T> struct is_serialized_as_bytes<T, typename std::enable_if<T::SerializedAsBytes::value>::type> : std::true_type {};
+
+//! Tag to pick the implementation for containers of T, unsigned char selects the single copy
+template<typename T> using container_serialize_tag = typename std::conditional<is_serialized_as_bytes<T>::value, unsigned char, T>::type;
+
 /**
  * prevector
  * prevectors of unsigned char are a special case and are intended to be serialized as a single opaque blob.
@@ -794,7 +871,7 @@ void Serialize_impl(Stream& os, const prevector<N, T>& v, const V&)
 template<typename Stream, unsigned int N, typename T>
 inline void Serialize(Stream& os, const prevector<N, T>& v)
 {
-    Serialize_impl(os, v, T());
+    Serialize_impl(os, v, container_serialize_tag<T>());
 }
 
 
@@ -835,7 +912,7 @@ void Unserialize_impl(Stream& is, prevector<N, T>& v, const V&)
 template<typename Stream, unsigned int N, typename T>
 inline void Unserialize(Stream& is, prevector<N, T>& v)
 {
-    Unserialize_impl(is, v, T());
+    Unserialize_impl(is, v, container_serialize_tag<T>());
 }
 
 
@@ -862,7 +939,7 @@ void Serialize_impl(Stream& os, const std::vector<T, A>& v, const V&)
 template<typename Stream, typename T, typename A>
 inline void Serialize(Stream& os, const std::vector<T, A>& v)
 {
-    Serialize_impl(os, v, T());
+    Serialize_impl(os, v, container_serialize_tag<T>());
 }
 
 
@@ -903,7 +980,7 @@ void Unserialize_impl(Stream& is, std::vector<T, A>& v, const V&)
 template<typename Stream, typename T, typename A>
 inline void Unserialize(Stream& is, std::vector<T, A>& v)
 {
-    Unserialize_impl(is, v, T());
+    Unserialize_impl(is, v, container_serialize_tag<T>());
 }
 
 
@@ -369,5 +369,32 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+/** Running totals of all address index deltas of an address, keyed by CAddressIndexIteratorKey */
+struct CAddressBalanceValue {
+    CAmount balance;
+    CAmount received;
+    // height of the last block applied to the totals, so that replaying a block is a no-op
+    int blockHeight;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(blockHeight);
+    }
+
+    CAddressBalanceValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        blockHeight = -1;
+    }
+};
+
 
 #endif // BITCOIN_SPENTINDEX_H
@@ -15,8 +15,6 @@
 
 #include <string>
 
-CSporkManager sporkManager;
-
 const std::string CSporkManager::SERIALIZATION_VERSION_STRING = "CSporkManager-Version-2";
 
 std::map<int, int64_t> mapSporkDefaults = {
@@ -37,6 +35,20 @@ std::map<int, int64_t> mapSporkDefaults = {
     {SPORK_20_INSTANTSEND_LLMQ_BASED,        4070908800ULL}, // OFF
 };
 
+// defined after mapSporkDefaults, the constructor needs it
+CSporkManager sporkManager;
+
+CSporkManager::CSporkManager()
+{
+    // no locking here, this runs during static initialization
+    for (auto& value : arrSporkValues) {
+        value = SPORK_VALUE_UNKNOWN;
+    }
+    for (const auto& pair : mapSporkDefaults) {
+        arrSporkValues[pair.first - SPORK_START] = pair.second;
+    }
+}
+
 bool CSporkManager::SporkValueIsActive(int nSporkID, int64_t &nActiveValueRet) const
 {
     LOCK(cs);
@@ -58,11 +70,35 @@ bool CSporkManager::SporkValueIsActive(int nSporkID, int64_t &nActiveValueRet) c
     return false;
 }
 
+void CSporkManager::UpdateSporkValue(int nSporkID)
+{
+    AssertLockHeld(cs);
+
+    if (nSporkID < SPORK_START || nSporkID > SPORK_END) return;
+
+    int64_t nValue;
+    if (!SporkValueIsActive(nSporkID, nValue)) {
+        const auto it = mapSporkDefaults.find(nSporkID);
+        nValue = it != mapSporkDefaults.end() ? it->second : SPORK_VALUE_UNKNOWN;
+    }
+    arrSporkValues[nSporkID - SPORK_START] = nValue;
+}
+
+void CSporkManager::UpdateSporkValues()
+{
+    AssertLockHeld(cs);
+
+    for (int nSporkID = SPORK_START; nSporkID <= SPORK_END; nSporkID++) {
+        UpdateSporkValue(nSporkID);
+    }
+}
+
 void CSporkManager::Clear()
 {
     LOCK(cs);
     mapSporksActive.clear();
     mapSporksByHash.clear();
+    UpdateSporkValues();
     // sporkPubKeyID and sporkPrivKey should be set in init.cpp,
     // we should not alter them here.
 }
@@ -113,6 +149,8 @@ void CSporkManager::CheckAndRemove()
         }
         ++itByHash;
     }
+
+    UpdateSporkValues();
 }
 
 void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
@@ -179,6 +217,7 @@ void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CD
             LOCK(cs); // make sure to not lock this together with cs_main
             mapSporksByHash[hash] = spork;
             mapSporksActive[spork.nSporkID][keyIDSigner] = spork;
+            UpdateSporkValue(spork.nSporkID);
         }
         spork.Relay(connman);
 
@@ -243,6 +282,7 @@ bool CSporkManager::UpdateSpork(int nSporkID, int64_t nValue, CConnman& connman)
             LOCK(cs);
             mapSporksByHash[spork.GetHash()] = spork;
             mapSporksActive[nSporkID][keyIDSigner] = spork;
+            UpdateSporkValue(nSporkID);
         }
         spork.Relay(connman);
         return true;
@@ -251,38 +291,36 @@ bool CSporkManager::UpdateSpork(int nSporkID, int64_t nValue, CConnman& connman)
     return false;
 }
 
-bool CSporkManager::IsSporkActive(int nSporkID)
+int64_t CSporkManager::GetEffectiveSporkValue(int nSporkID) const
 {
-    LOCK(cs);
-    int64_t nSporkValue = -1;
-
-    if (SporkValueIsActive(nSporkID, nSporkValue)) {
-        return nSporkValue < GetAdjustedTime();
+    if (nSporkID >= SPORK_START && nSporkID <= SPORK_END) {
+        return arrSporkValues[nSporkID - SPORK_START];
     }
 
-    if (mapSporkDefaults.count(nSporkID)) {
-        return  mapSporkDefaults[nSporkID] < GetAdjustedTime();
-    }
-
-    LogPrint("spork", "CSporkManager::IsSporkActive -- Unknown Spork ID %d\n", nSporkID);
-    return false;
+    // not in the table and never has a default, but a signed value could still be known
+    int64_t nSporkValue = SPORK_VALUE_UNKNOWN;
+    SporkValueIsActive(nSporkID, nSporkValue);
+    return nSporkValue;
 }
 
-int64_t CSporkManager::GetSporkValue(int nSporkID)
+bool CSporkManager::IsSporkActive(int nSporkID)
 {
-    LOCK(cs);
-
-    int64_t nSporkValue = -1;
-    if (SporkValueIsActive(nSporkID, nSporkValue)) {
-        return nSporkValue;
+    int64_t nSporkValue = GetEffectiveSporkValue(nSporkID);
+    if (nSporkValue == SPORK_VALUE_UNKNOWN) {
+        LogPrint("spork", "CSporkManager::IsSporkActive -- Unknown Spork ID %d\n", nSporkID);
+        return false;
     }
+    return nSporkValue < GetAdjustedTime();
+}
 
-    if (mapSporkDefaults.count(nSporkID)) {
-        return mapSporkDefaults[nSporkID];
+int64_t CSporkManager::GetSporkValue(int nSporkID)
+{
+    int64_t nSporkValue = GetEffectiveSporkValue(nSporkID);
+    if (nSporkValue == SPORK_VALUE_UNKNOWN) {
+        LogPrint("spork", "CSporkManager::GetSporkValue -- Unknown Spork ID %d\n", nSporkID);
+        return -1;
     }
-
-    LogPrint("spork", "CSporkManager::GetSporkValue -- Unknown Spork ID %d\n", nSporkID);
-    return -1;
+    return nSporkValue;
 }
 
 int CSporkManager::GetSporkIDByName(const std::string& strName)
@@ -359,12 +397,14 @@ bool CSporkManager::SetSporkAddress(const std::string& strAddress) {
 
 bool CSporkManager::SetMinSporkKeys(int minSporkKeys)
 {
+    LOCK(cs);
     int maxKeysNumber = setSporkPubKeyIDs.size();
     if ((minSporkKeys <= maxKeysNumber / 2) || (minSporkKeys > maxKeysNumber)) {
         LogPrintf("CSporkManager::SetMinSporkKeys -- Invalid min spork signers number: %d\n", minSporkKeys);
         return false;
     }
     nMinSporkKeys = minSporkKeys;
+    UpdateSporkValues();
     return true;
 }
 
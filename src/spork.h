@@ -12,6 +12,9 @@
 #include "utilstrencodings.h"
 #include "key.h"
 
+#include <array>
+#include <atomic>
+#include <limits>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -157,14 +160,34 @@ private:
      */
     bool SporkValueIsActive(int nSporkID, int64_t& nActiveValueRet) const;
 
+    /** Marks spork IDs in arrSporkValues which have neither an active value nor a default */
+    static const int64_t SPORK_VALUE_UNKNOWN = std::numeric_limits<int64_t>::min();
+
+    /**
+     * The effective value of every spork ID from SPORK_START to SPORK_END, i.e. the active
+     * value if there is one and the default otherwise. Written under cs whenever the spork
+     * messages change and read without any lock by IsSporkActive and GetSporkValue.
+     */
+    std::array<std::atomic<int64_t>, SPORK_END - SPORK_START + 1> arrSporkValues;
+
+    /** Recalculate the effective value of a single spork, cs must be held */
+    void UpdateSporkValue(int nSporkID);
+    /** Recalculate the effective values of all sporks, cs must be held */
+    void UpdateSporkValues();
+    /** Lock-free for IDs in the table, SPORK_VALUE_UNKNOWN if there is no value */
+    int64_t GetEffectiveSporkValue(int nSporkID) const;
+
 public:
 
-    CSporkManager() {}
+    CSporkManager();
 
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
+        // also dumped from the scheduler while running
+        LOCK(cs);
+
         std::string strVersion;
         if(ser_action.ForRead()) {
             READWRITE(strVersion);
@@ -181,6 +204,10 @@ public:
         READWRITE(mapSporksByHash);
         READWRITE(mapSporksActive);
         // we don't serialize private key to prevent its leakage
+
+        if (ser_action.ForRead()) {
+            UpdateSporkValues();
+        }
     }
 
     /**
@@ -142,6 +142,68 @@ private:
     size_t nPos;
 };
 
+/** Minimal stream for reading from a byte buffer owned by someone else.
+ *
+ * Unlike CDataStream nothing is copied, and nothing is wiped when done, so this is
+ * for data that isn't secret, like database values.
+ */
+class CSpanReader
+{
+public:
+/*
+ * @param[in]  nTypeIn Serialization Type
+ * @param[in]  nVersionIn Serialization Version (including any flags)
+ * @param[in]  dataIn  Bytes to read from, they have to outlive the reader
+*/
+    CSpanReader(int nTypeIn, int nVersionIn, Span<const unsigned char> dataIn) : nType(nTypeIn), nVersion(nVersionIn), data(dataIn), nPos(0) {}
+
+    void read(char* pch, size_t nSize)
+    {
+        if (nSize > size()) {
+            throw std::ios_base::failure("CSpanReader::read(): end of data");
+        }
+        if (nSize) {
+            memcpy(pch, data.data() + nPos, nSize);
+        }
+        nPos += nSize;
+    }
+    void ignore(size_t nSize)
+    {
+        if (nSize > size()) {
+            throw std::ios_base::failure("CSpanReader::ignore(): end of data");
+        }
+        nPos += nSize;
+    }
+    template<typename T>
+    CSpanReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+    int GetVersion() const
+    {
+        return nVersion;
+    }
+    int GetType() const
+    {
+        return nType;
+    }
+    size_t size() const
+    {
+        return data.size() - nPos;
+    }
+    bool empty() const
+    {
+        return size() == 0;
+    }
+private:
+    const int nType;
+    const int nVersion;
+    const Span<const unsigned char> data;
+    size_t nPos;
+};
+
 /** Double ended buffer combining vector and stream-like interfaces.
  *
  * >> and << read and write unformatted data using the above serialization templates.
@@ -0,0 +1,120 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_ARENA_H
+#define BITCOIN_SUPPORT_ALLOCATORS_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+/**
+ * Memory for many small objects that all die together, like the scripts of one transaction.
+ *
+ * Allocations are carved from chunks taken with ::operator new and can't be freed on their
+ * own, everything goes back to the system when the arena is destroyed. The first chunk is
+ * just large enough for the first allocation and every further one at least doubles the
+ * previous size, so a transaction with a single large script costs one allocation as before
+ * and one with many inputs a handful instead of one per script.
+ *
+ * The arena is a single pointer and can be moved without touching the memory it handed out.
+ * Not thread safe.
+ */
+class MonotonicArena
+{
+    struct Chunk {
+        Chunk* m_next;
+        char* m_free;
+        char* m_end;
+
+        char* Begin() { return reinterpret_cast<char*>(this + 1); }
+        const char* Begin() const { return reinterpret_cast<const char*>(this + 1); }
+    };
+
+    //! Newest chunk first, only that one is allocated from
+    Chunk* m_head = nullptr;
+
+    static std::size_t Padding(const char* p, std::size_t alignment)
+    {
+        return (alignment - reinterpret_cast<std::uintptr_t>(p) % alignment) % alignment;
+    }
+
+    void* AllocateChunk(std::size_t bytes, std::size_t alignment)
+    {
+        std::size_t payload = bytes + alignment - 1;
+        if (m_head && payload < 2 * std::size_t(m_head->m_end - m_head->Begin())) {
+            payload = 2 * std::size_t(m_head->m_end - m_head->Begin());
+        }
+        Chunk* chunk = static_cast<Chunk*>(::operator new(sizeof(Chunk) + payload));
+        chunk->m_next = m_head;
+        chunk->m_free = chunk->Begin();
+        chunk->m_end = chunk->Begin() + payload;
+        m_head = chunk;
+
+        char* p = chunk->m_free + Padding(chunk->m_free, alignment);
+        chunk->m_free = p + bytes;
+        return p;
+    }
+
+public:
+    MonotonicArena() noexcept {}
+
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+    MonotonicArena(MonotonicArena&& other) noexcept : m_head(other.m_head)
+    {
+        other.m_head = nullptr;
+    }
+
+    MonotonicArena& operator=(MonotonicArena&& other) noexcept
+    {
+        if (this != &other) {
+            Release();
+            m_head = other.m_head;
+            other.m_head = nullptr;
+        }
+        return *this;
+    }
+
+    ~MonotonicArena() { Release(); }
+
+    //! alignment has to be a power of two
+    void* Allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t))
+    {
+        if (m_head) {
+            std::size_t pad = Padding(m_head->m_free, alignment);
+            if (pad + bytes <= std::size_t(m_head->m_end - m_head->m_free)) {
+                char* p = m_head->m_free + pad;
+                m_head->m_free = p + bytes;
+                return p;
+            }
+        }
+        return AllocateChunk(bytes, alignment);
+    }
+
+    //! Frees all chunks, everything allocated from the arena is gone afterwards
+    void Release() noexcept
+    {
+        while (m_head) {
+            Chunk* next = m_head->m_next;
+            ::operator delete(m_head);
+            m_head = next;
+        }
+    }
+
+    bool empty() const { return m_head == nullptr; }
+
+    //! Calls f with the size of every chunk as passed to ::operator new
+    template <typename F>
+    void ForEachChunk(F f) const
+    {
+        for (const Chunk* chunk = m_head; chunk; chunk = chunk->m_next) {
+            f(sizeof(Chunk) + std::size_t(chunk->m_end - chunk->Begin()));
+        }
+    }
+};
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_ARENA_H
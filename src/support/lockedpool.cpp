@@ -27,6 +27,8 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
+#include <vector>
 
 LockedPoolManager* LockedPoolManager::_instance = NULL;
 std::once_flag LockedPoolManager::init_flag;
@@ -257,18 +259,123 @@ size_t PosixLockedPageAllocator::GetLimit()
 /*******************************************************************************/
 // Implementation: LockedPool
 
-LockedPool::LockedPool(std::unique_ptr<LockedPageAllocator> allocator_in, LockingFailed_Callback lf_cb_in):
-    allocator(std::move(allocator_in)), lf_cb(lf_cb_in), cumulative_bytes_locked(0)
+/** Size class of a cacheable allocation, and the chunk size of one */
+static inline size_t cache_class(size_t size)
+{
+    return align_up(size, LockedPool::ARENA_ALIGN) / LockedPool::ARENA_ALIGN - 1;
+}
+static inline size_t cache_class_size(size_t cls)
+{
+    return (cls + 1) * LockedPool::ARENA_ALIGN;
+}
+static inline size_t cache_batch(size_t cls)
+{
+    return std::max<size_t>(1, std::min<size_t>(size_t(LockedPool::CACHE_BATCH), LockedPool::CACHE_BATCH_BYTES / cache_class_size(cls)));
+}
+
+struct LockedPool::ThreadCache
+{
+    //! nullptr until bound and after the pool went away
+    LockedPool* pool = nullptr;
+    std::vector<void*> chunks[CACHE_CLASSES];
+    //! Only written by the thread itself, stats() reads them under the pool mutex
+    std::atomic<size_t> bytes{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+
+    void add_bytes(size_t n) { bytes.store(bytes.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    void sub_bytes(size_t n) { bytes.store(bytes.load(std::memory_order_relaxed) - n, std::memory_order_relaxed); }
+    static void inc(std::atomic<uint64_t>& n) { n.store(n.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+    ~ThreadCache()
+    {
+        if (!pool)
+            return;
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        for (size_t cls = 0; cls < CACHE_CLASSES; cls++)
+            pool->release(*this, cls, chunks[cls].size());
+        pool->cache_hits_done += hits.load(std::memory_order_relaxed);
+        pool->cache_misses_done += misses.load(std::memory_order_relaxed);
+        pool->caches.erase(this);
+    }
+};
+
+LockedPool::LockedPool(std::unique_ptr<LockedPageAllocator> allocator_in, LockingFailed_Callback lf_cb_in, bool thread_caching_in):
+    allocator(std::move(allocator_in)), lf_cb(lf_cb_in), cumulative_bytes_locked(0), thread_caching(thread_caching_in),
+    cache_hits_done(0), cache_misses_done(0)
 {
 }
 
 LockedPool::~LockedPool()
 {
+    // the chunks of the caches go away with the arenas
+    std::lock_guard<std::mutex> lock(mutex);
+    for (ThreadCache* cache : caches) {
+        cache->pool = nullptr;
+        for (auto& chunks : cache->chunks)
+            chunks.clear();
+    }
+}
+
+LockedPool::ThreadCache* LockedPool::thread_cache()
+{
+    static thread_local ThreadCache cache;
+    if (cache.pool == this)
+        return &cache;
+    if (cache.pool != nullptr)
+        return nullptr;
+    std::lock_guard<std::mutex> lock(mutex);
+    cache.pool = this;
+    caches.insert(&cache);
+    return &cache;
 }
+
+void LockedPool::release(ThreadCache& cache, size_t cls, size_t count)
+{
+    // the oldest ones, the cache keeps handing out the ones which were used last
+    std::vector<void*>& chunks = cache.chunks[cls];
+    count = std::min(count, chunks.size());
+    for (size_t i = 0; i < count; i++)
+        free_locked(chunks[i]);
+    chunks.erase(chunks.begin(), chunks.begin() + count);
+    cache.sub_bytes(count * cache_class_size(cls));
+}
+
 void* LockedPool::alloc(size_t size)
 {
+    if (thread_caching && size != 0 && size <= CACHE_MAX_SIZE) {
+        ThreadCache* cache = thread_cache();
+        if (cache) {
+            size_t cls = cache_class(size);
+            std::vector<void*>& chunks = cache->chunks[cls];
+            if (chunks.empty()) {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (size_t i = 0, n = cache_batch(cls); i < n; i++) {
+                    void *addr = alloc_locked(cache_class_size(cls));
+                    if (!addr)
+                        break;
+                    chunks.push_back(addr);
+                }
+                if (chunks.empty())
+                    return nullptr;
+                cache->add_bytes(chunks.size() * cache_class_size(cls));
+                ThreadCache::inc(cache->misses);
+            } else {
+                ThreadCache::inc(cache->hits);
+            }
+            void *addr = chunks.back();
+            chunks.pop_back();
+            cache->sub_bytes(cache_class_size(cls));
+            return addr;
+        }
+    }
+
     std::lock_guard<std::mutex> lock(mutex);
+    return alloc_locked(size);
+}
 
+void* LockedPool::alloc_locked(size_t size)
+{
     // Don't handle impossible sizes
     if (size == 0 || size > ARENA_SIZE)
         return nullptr;
@@ -287,9 +394,35 @@ void* LockedPool::alloc(size_t size)
     return nullptr;
 }
 
+void LockedPool::free(void *ptr, size_t size)
+{
+    if (ptr != nullptr && thread_caching && size != 0 && size <= CACHE_MAX_SIZE) {
+        ThreadCache* cache = thread_cache();
+        if (cache) {
+            // Unlike free_locked this doesn't notice invalid or double frees, the arena does once
+            // the chunk goes back to it.
+            size_t cls = cache_class(size);
+            std::vector<void*>& chunks = cache->chunks[cls];
+            chunks.push_back(ptr);
+            cache->add_bytes(cache_class_size(cls));
+            if (chunks.size() > 2 * cache_batch(cls)) {
+                std::lock_guard<std::mutex> lock(mutex);
+                release(*cache, cls, cache_batch(cls));
+            }
+            return;
+        }
+    }
+    free(ptr);
+}
+
 void LockedPool::free(void *ptr)
 {
     std::lock_guard<std::mutex> lock(mutex);
+    free_locked(ptr);
+}
+
+void LockedPool::free_locked(void *ptr)
+{
     // TODO we can do better than this linear search by keeping a map of arena
     // extents to arena, and looking up the address.
     for (auto &arena: arenas) {
@@ -304,7 +437,7 @@ void LockedPool::free(void *ptr)
 LockedPool::Stats LockedPool::stats() const
 {
     std::lock_guard<std::mutex> lock(mutex);
-    LockedPool::Stats r{0, 0, 0, cumulative_bytes_locked, 0, 0};
+    LockedPool::Stats r{0, 0, 0, cumulative_bytes_locked, 0, 0, 0, caches.size(), cache_hits_done, cache_misses_done};
     for (const auto &arena: arenas) {
         Arena::Stats i = arena.stats();
         r.used += i.used;
@@ -313,6 +446,11 @@ LockedPool::Stats LockedPool::stats() const
         r.chunks_used += i.chunks_used;
         r.chunks_free += i.chunks_free;
     }
+    for (const ThreadCache* cache : caches) {
+        r.cached += cache->bytes.load(std::memory_order_relaxed);
+        r.cache_hits += cache->hits.load(std::memory_order_relaxed);
+        r.cache_misses += cache->misses.load(std::memory_order_relaxed);
+    }
     return r;
 }
 
@@ -358,7 +496,7 @@ LockedPool::LockedPageArena::~LockedPageArena()
 // Implementation: LockedPoolManager
 //
 LockedPoolManager::LockedPoolManager(std::unique_ptr<LockedPageAllocator> allocator_in):
-    LockedPool(std::move(allocator_in), &LockedPoolManager::LockingFailed)
+    LockedPool(std::move(allocator_in), &LockedPoolManager::LockingFailed, true)
 {
 }
 
@@ -10,6 +10,7 @@
 #include <map>
 #include <mutex>
 #include <memory>
+#include <set>
 
 /**
  * OS-dependent allocation and deallocation of locked/pinned memory pages.
@@ -113,6 +114,12 @@ private:
  * memory. This has been done as the sizes and bases of objects are not in themselves sensitive
  * information, as to conserve precious locked memory. In some operating systems
  * the amount of memory that can be locked is small.
+ *
+ * With thread caching enabled, every thread keeps the small chunks it freed by size class and
+ * reuses them for its next allocations of that class, so threads which make and drop many keys
+ * only take the mutex once per batch of allocations or frees. Only frees which pass the size go
+ * to the cache. A caching pool has to outlive the threads which use it, except the one which
+ * destroys it.
  */
 class LockedPool
 {
@@ -127,6 +134,17 @@ public:
      * memory, setting it too low will facilitate fragmentation.
      */
     static const size_t ARENA_ALIGN = 16;
+    /** Largest allocation served from the thread caches. The size classes are the multiples
+     * of ARENA_ALIGN up to this.
+     */
+    static const size_t CACHE_MAX_SIZE = 256;
+    static const size_t CACHE_CLASSES = CACHE_MAX_SIZE / ARENA_ALIGN;
+    /** Chunks a thread moves between its cache and the arenas at once, fewer for the large
+     * classes so a batch takes at most CACHE_BATCH_BYTES. A cache holds at most two batches
+     * per size class.
+     */
+    static const size_t CACHE_BATCH = 16;
+    static const size_t CACHE_BATCH_BYTES = 1024;
 
     /** Callback when allocation succeeds but locking fails.
      */
@@ -141,6 +159,12 @@ public:
         size_t locked;
         size_t chunks_used;
         size_t chunks_free;
+        /** Part of used which sits in thread caches */
+        size_t cached;
+        size_t cache_threads;
+        /** Allocations served from a thread cache, and the ones which had to refill it first */
+        uint64_t cache_hits;
+        uint64_t cache_misses;
     };
 
     /** Create a new LockedPool. This takes ownership of the MemoryPageLocker,
@@ -150,7 +174,7 @@ public:
      * If this callback is provided and returns false, the allocation fails (hard fail), if
      * it returns true the allocation proceeds, but it could warn.
      */
-    LockedPool(std::unique_ptr<LockedPageAllocator> allocator, LockingFailed_Callback lf_cb_in = 0);
+    LockedPool(std::unique_ptr<LockedPageAllocator> allocator, LockingFailed_Callback lf_cb_in = 0, bool thread_caching_in = false);
     ~LockedPool();
 
     /** Allocate size bytes from this arena.
@@ -165,12 +189,26 @@ public:
      */
     void free(void *ptr);
 
+    /** Free a chunk allocated with alloc(size), small ones go to the thread cache.
+     * The caller has to cleanse the memory before.
+     */
+    void free(void *ptr, size_t size);
+
     /** Get pool usage statistics */
     Stats stats() const;
 private:
     LockedPool(const LockedPool& other) = delete; // non construction-copyable
     LockedPool& operator=(const LockedPool&) = delete; // non copyable
 
+    struct ThreadCache;
+
+    void* alloc_locked(size_t size);
+    void free_locked(void *ptr);
+    /** The cache of this thread if it belongs to this pool, binds an unused one to it */
+    ThreadCache* thread_cache();
+    /** Moves count chunks of size class cls from the cache back to the arenas, mutex held */
+    void release(ThreadCache& cache, size_t cls, size_t count);
+
     std::unique_ptr<LockedPageAllocator> allocator;
 
     /** Create an arena from locked pages */
@@ -190,6 +228,12 @@ private:
     std::list<LockedPageArena> arenas;
     LockingFailed_Callback lf_cb;
     size_t cumulative_bytes_locked;
+    const bool thread_caching;
+    /** Caches of the threads bound to this pool */
+    std::set<ThreadCache*> caches;
+    /** Counters of the caches which went away already */
+    uint64_t cache_hits_done;
+    uint64_t cache_misses_done;
     /** Mutex protects access to this pool's data structures, including arenas.
      */
     mutable std::mutex mutex;
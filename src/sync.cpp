@@ -9,9 +9,105 @@
 
 #include <stdio.h>
 
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <tuple>
+
 #include <boost/foreach.hpp>
 #include <boost/thread.hpp>
 
+std::atomic<unsigned int> nLockProfileRate(DEFAULT_LOCK_PROFILE_RATE);
+
+namespace {
+
+// Keyed by the string literals of LOCK(), the pointers are stable and cheap to compare. A
+// name used in several translation units may show up once per unit, GetLockProfileStats
+// leaves merging those to the caller.
+typedef std::tuple<const char*, const char*, int> LockSite;
+
+struct LockSiteStats {
+    uint64_t nSamples = 0;
+    uint64_t nContended = 0;
+    int64_t nTotalWaitMicros = 0;
+    int64_t nMaxWaitMicros = 0;
+    int64_t nTotalHoldMicros = 0;
+    int64_t nMaxHoldMicros = 0;
+    uint64_t waitHistogram[CLockProfileStats::HISTOGRAM_BUCKETS] = {};
+    uint64_t holdHistogram[CLockProfileStats::HISTOGRAM_BUCKETS] = {};
+};
+
+// A plain std::mutex, a CCriticalSection here would profile itself
+std::mutex csLockProfile;
+std::map<LockSite, LockSiteStats> mapLockProfile;
+
+int HistogramBucket(int64_t nMicros)
+{
+    int nBucket = 0;
+    while (nMicros > 0 && nBucket < CLockProfileStats::HISTOGRAM_BUCKETS - 1) {
+        nMicros >>= 1;
+        nBucket++;
+    }
+    return nBucket;
+}
+
+} // namespace
+
+bool LockProfileSampleNext(unsigned int nRate)
+{
+    static thread_local unsigned int nCounter = 0;
+    return ++nCounter % nRate == 0;
+}
+
+int64_t LockProfileTime()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LockProfileRecord(const char* pszName, const char* pszFile, int nLine, bool fContended, int64_t nWaitMicros, int64_t nHoldMicros)
+{
+    std::lock_guard<std::mutex> lock(csLockProfile);
+    LockSiteStats& stats = mapLockProfile[LockSite(pszName, pszFile, nLine)];
+    stats.nSamples++;
+    if (fContended)
+        stats.nContended++;
+    stats.nTotalWaitMicros += nWaitMicros;
+    stats.nMaxWaitMicros = std::max(stats.nMaxWaitMicros, nWaitMicros);
+    stats.nTotalHoldMicros += nHoldMicros;
+    stats.nMaxHoldMicros = std::max(stats.nMaxHoldMicros, nHoldMicros);
+    stats.waitHistogram[HistogramBucket(nWaitMicros)]++;
+    stats.holdHistogram[HistogramBucket(nHoldMicros)]++;
+}
+
+std::vector<CLockProfileStats> GetLockProfileStats()
+{
+    std::vector<CLockProfileStats> result;
+    std::lock_guard<std::mutex> lock(csLockProfile);
+    result.reserve(mapLockProfile.size());
+    for (const auto& p : mapLockProfile) {
+        CLockProfileStats s;
+        s.strName = std::get<0>(p.first);
+        s.strFile = std::get<1>(p.first);
+        s.nLine = std::get<2>(p.first);
+        s.nSamples = p.second.nSamples;
+        s.nContended = p.second.nContended;
+        s.nTotalWaitMicros = p.second.nTotalWaitMicros;
+        s.nMaxWaitMicros = p.second.nMaxWaitMicros;
+        s.nTotalHoldMicros = p.second.nTotalHoldMicros;
+        s.nMaxHoldMicros = p.second.nMaxHoldMicros;
+        std::copy(std::begin(p.second.waitHistogram), std::end(p.second.waitHistogram), s.waitHistogram);
+        std::copy(std::begin(p.second.holdHistogram), std::end(p.second.holdHistogram), s.holdHistogram);
+        result.push_back(s);
+    }
+    return result;
+}
+
+void ResetLockProfileStats()
+{
+    std::lock_guard<std::mutex> lock(csLockProfile);
+    mapLockProfile.clear();
+}
+
 #ifdef DEBUG_LOCKCONTENTION
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 {
@@ -8,6 +8,11 @@
 
 #include "threadsafety.h"
 
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
@@ -111,6 +116,45 @@ typedef boost::condition_variable CConditionVariable;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/**
+ * Sampled lock profiling. When nLockProfileRate is n > 0, one in n LOCK()s of every thread
+ * measures how long it waited for the mutex and how long it was held, and adds that to the
+ * histograms of its lock name and source location. 0 turns it off, the unsampled path then
+ * only costs a relaxed atomic load.
+ */
+static const unsigned int DEFAULT_LOCK_PROFILE_RATE = 0;
+extern std::atomic<unsigned int> nLockProfileRate;
+
+struct CLockProfileStats
+{
+    //! Bucket i counts the times below 2^i microseconds, the last one everything longer
+    static const int HISTOGRAM_BUCKETS = 24;
+
+    std::string strName;
+    std::string strFile;
+    int nLine;
+    uint64_t nSamples;
+    uint64_t nContended;
+    int64_t nTotalWaitMicros;
+    int64_t nMaxWaitMicros;
+    int64_t nTotalHoldMicros;
+    int64_t nMaxHoldMicros;
+    uint64_t waitHistogram[HISTOGRAM_BUCKETS];
+    uint64_t holdHistogram[HISTOGRAM_BUCKETS];
+};
+
+bool LockProfileSampleNext(unsigned int nRate);
+int64_t LockProfileTime();
+void LockProfileRecord(const char* pszName, const char* pszFile, int nLine, bool fContended, int64_t nWaitMicros, int64_t nHoldMicros);
+std::vector<CLockProfileStats> GetLockProfileStats();
+void ResetLockProfileStats();
+
+static inline bool LockProfileSample()
+{
+    unsigned int nRate = nLockProfileRate.load(std::memory_order_relaxed);
+    return nRate != 0 && LockProfileSampleNext(nRate);
+}
+
 /** Wrapper around boost::unique_lock<Mutex> */
 template <typename Mutex>
 class SCOPED_LOCKABLE CMutexLock
@@ -118,9 +162,38 @@ class SCOPED_LOCKABLE CMutexLock
 private:
     boost::unique_lock<Mutex> lock;
 
+    //! Set when this acquisition is sampled by the lock profiler
+    const char* pszProfileName = nullptr;
+    const char* pszProfileFile;
+    int nProfileLine;
+    bool fProfileContended;
+    int64_t nProfileWaitMicros;
+    int64_t nProfileAcquired;
+
+    void EnterProfiled(const char* pszName, const char* pszFile, int nLine)
+    {
+        int64_t nStart = LockProfileTime();
+        fProfileContended = !lock.try_lock();
+        if (fProfileContended) {
+#ifdef DEBUG_LOCKCONTENTION
+            PrintLockContention(pszName, pszFile, nLine);
+#endif
+            lock.lock();
+        }
+        nProfileAcquired = LockProfileTime();
+        nProfileWaitMicros = nProfileAcquired - nStart;
+        pszProfileName = pszName;
+        pszProfileFile = pszFile;
+        nProfileLine = nLine;
+    }
+
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
+        if (LockProfileSample()) {
+            EnterProfiled(pszName, pszFile, nLine);
+            return;
+        }
 #ifdef DEBUG_LOCKCONTENTION
         if (!lock.try_lock()) {
             PrintLockContention(pszName, pszFile, nLine);
@@ -162,6 +235,8 @@ public:
 
     ~CMutexLock() UNLOCK_FUNCTION()
     {
+        if (pszProfileName)
+            LockProfileRecord(pszProfileName, pszProfileFile, nProfileLine, fProfileContended, nProfileWaitMicros, LockProfileTime() - nProfileAcquired);
         if (lock.owns_lock())
             LeaveCritical();
     }
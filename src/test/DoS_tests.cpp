@@ -9,6 +9,7 @@
 #include "net.h"
 #include "net_processing.h"
 #include "pow.h"
+#include "saltedhasher.h"
 #include "script/sign.h"
 #include "serialize.h"
 #include "util.h"
@@ -17,6 +18,7 @@
 #include "test/test_epmcoin.h"
 
 #include <stdint.h>
+#include <unordered_map>
 
 #include <boost/assign/list_of.hpp> // for 'map_list_of()'
 #include <boost/date_time/posix_time/posix_time_types.hpp>
@@ -27,12 +29,17 @@
 extern bool AddOrphanTx(const CTransactionRef& tx, NodeId peer);
 extern void EraseOrphansFor(NodeId peer);
 extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans);
+extern unsigned int LimitOrphanTxSizeForPeer(NodeId peer, unsigned int nMaxPeerOrphansSize);
 struct COrphanTx {
     CTransactionRef tx;
     NodeId fromPeer;
     int64_t nTimeExpire;
+    size_t nTxSize;
+    size_t nListPos;
+    size_t nPeerPos;
 };
-extern std::map<uint256, COrphanTx> mapOrphanTransactions;
+extern std::unordered_map<uint256, COrphanTx, StaticSaltedHasher> mapOrphanTransactions;
+extern size_t nMapOrphanTransactionsSize;
 
 CService ip(uint32_t i)
 {
@@ -128,13 +135,33 @@ BOOST_AUTO_TEST_CASE(DoS_bantime)
 
 CTransactionRef RandomOrphan()
 {
-    std::map<uint256, COrphanTx>::iterator it;
-    it = mapOrphanTransactions.lower_bound(GetRandHash());
-    if (it == mapOrphanTransactions.end())
-        it = mapOrphanTransactions.begin();
+    auto it = mapOrphanTransactions.begin();
+    std::advance(it, GetRand(mapOrphanTransactions.size()));
     return it->second.tx;
 }
 
+static size_t OrphanSizeOf(NodeId peer)
+{
+    size_t nSize = 0;
+    for (const auto& entry : mapOrphanTransactions) {
+        if (entry.second.fromPeer == peer)
+            nSize += entry.second.nTxSize;
+    }
+    return nSize;
+}
+
+static CTransactionRef MakeOrphan()
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.n = 0;
+    tx.vin[0].prevout.hash = GetRandHash();
+    tx.vin[0].scriptSig << OP_1;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 1*CENT;
+    return MakeTransactionRef(tx);
+}
+
 BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
 {
     CKey key;
@@ -204,6 +231,7 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
         size_t sizeBefore = mapOrphanTransactions.size();
         EraseOrphansFor(i);
         BOOST_CHECK(mapOrphanTransactions.size() < sizeBefore);
+        BOOST_CHECK_EQUAL(OrphanSizeOf(i), 0);
     }
 
     // Test LimitOrphanTxSize() function:
@@ -213,6 +241,31 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     BOOST_CHECK(mapOrphanTransactions.size() <= 10);
     LimitOrphanTxSize(0);
     BOOST_CHECK(mapOrphanTransactions.empty());
+    BOOST_CHECK_EQUAL(nMapOrphanTransactionsSize, 0);
+}
+
+BOOST_AUTO_TEST_CASE(DoS_mapOrphansPeerQuota)
+{
+    for (int i = 0; i < 40; i++) {
+        BOOST_CHECK(AddOrphanTx(MakeOrphan(), i % 2));
+    }
+    size_t nSizeOther = OrphanSizeOf(1);
+    size_t nQuota = OrphanSizeOf(0) / 4;
+
+    // Only the orphans of the peer over its quota are evicted
+    BOOST_CHECK(LimitOrphanTxSizeForPeer(0, nQuota) > 0);
+    BOOST_CHECK(OrphanSizeOf(0) <= nQuota);
+    BOOST_CHECK_EQUAL(OrphanSizeOf(1), nSizeOther);
+    BOOST_CHECK_EQUAL(LimitOrphanTxSizeForPeer(1, nSizeOther), 0);
+
+    // The lists stay consistent while entries are moved around
+    EraseOrphansFor(0);
+    BOOST_CHECK_EQUAL(mapOrphanTransactions.size(), 20);
+    for (const auto& entry : mapOrphanTransactions) {
+        BOOST_CHECK_EQUAL(entry.second.fromPeer, 1);
+    }
+    LimitOrphanTxSize(0);
+    BOOST_CHECK(mapOrphanTransactions.empty());
 }
 
 BOOST_AUTO_TEST_SUITE_END()
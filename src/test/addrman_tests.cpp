@@ -203,9 +203,9 @@ BOOST_AUTO_TEST_CASE(addrman_select)
     BOOST_CHECK(addrman.size() == 7);
 
     // Test 12: Select pulls from new and tried regardless of port number.
-    BOOST_CHECK(addrman.Select().ToString() == "250.4.6.6:8333");
-    BOOST_CHECK(addrman.Select().ToString() == "250.3.2.2:9999");
-    BOOST_CHECK(addrman.Select().ToString() == "250.3.3.3:9999");
+    BOOST_CHECK(addrman.Select().ToString() == "250.4.4.4:8333");
+    BOOST_CHECK(addrman.Select().ToString() == "250.4.5.5:7777");
+    BOOST_CHECK(addrman.Select().ToString() == "250.3.1.1:8333");
     BOOST_CHECK(addrman.Select().ToString() == "250.4.4.4:8333");
 }
 
@@ -268,6 +268,57 @@ BOOST_AUTO_TEST_CASE(addrman_tried_collisions)
     BOOST_CHECK(addrman.size() == 80);
 }
 
+BOOST_AUTO_TEST_CASE(addrman_select_after_evictions)
+{
+    CAddrManTest addrman;
+
+    // Set addrman addr placement to be deterministic.
+    addrman.MakeDeterministic();
+
+    CNetAddr source = ResolveIP("252.2.2.2");
+
+    // Fill the tried table past its first collision, so entries get evicted back to new
+    for (unsigned int i = 1; i < 120; i++) {
+        CService addr = ResolveService("250.1.1." + boost::to_string(i));
+        addrman.Add(CAddress(addr, NODE_NONE), source);
+        if (i % 3)
+            addrman.Good(CAddress(addr, NODE_NONE));
+    }
+    addrman.Check();
+
+    // Selection only ever lands on entries which are still in the tables
+    for (int i = 0; i < 200; i++) {
+        CAddrInfo addr = addrman.Select();
+        BOOST_CHECK(addrman.Find(addr) != NULL);
+        CAddrInfo addrNew = addrman.Select(true);
+        BOOST_CHECK(addrman.Find(addrNew) != NULL);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(addrman_modification_count)
+{
+    CAddrManTest addrman;
+    addrman.MakeDeterministic();
+
+    CNetAddr source = ResolveIP("252.2.2.2");
+    CService addr1 = ResolveService("250.1.1.1", 8333);
+
+    // Lookups leave the modification count alone, anything that may change the tables bumps it
+    uint64_t nCount = addrman.GetModificationCount();
+    addrman.Select();
+    addrman.GetAddressInfo(addr1);
+    BOOST_CHECK_EQUAL(addrman.GetModificationCount(), nCount);
+
+    addrman.Add(CAddress(addr1, NODE_NONE), source);
+    BOOST_CHECK(addrman.GetModificationCount() != nCount);
+    nCount = addrman.GetModificationCount();
+
+    addrman.Select();
+    BOOST_CHECK_EQUAL(addrman.GetModificationCount(), nCount);
+    addrman.Good(CAddress(addr1, NODE_NONE));
+    BOOST_CHECK(addrman.GetModificationCount() != nCount);
+}
+
 BOOST_AUTO_TEST_CASE(addrman_find)
 {
     CAddrManTest addrman;
@@ -4,9 +4,12 @@
 
 #include "util.h"
 
+#include "support/allocators/pool.h"
 #include "support/allocators/secure.h"
 #include "test/test_epmcoin.h"
 
+#include <unordered_map>
+
 #include <boost/test/unit_test.hpp>
 
 BOOST_FIXTURE_TEST_SUITE(allocator_tests, BasicTestingSetup)
@@ -227,8 +230,90 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live)
     }
     // If more than one new arena was allocated for the above tests, something is wrong
     BOOST_CHECK(pool.stats().total <= (initial.total + LockedPool::ARENA_SIZE));
-    // Usage must be back to where it started
-    BOOST_CHECK(pool.stats().used == initial.used);
+    // Usage outside of the thread cache must be back to where it started
+    BOOST_CHECK(pool.stats().used - pool.stats().cached == initial.used - initial.cached);
+}
+
+BOOST_AUTO_TEST_CASE(lockedpool_tests_thread_cache)
+{
+    std::unique_ptr<LockedPageAllocator> x(new TestLockedPageAllocator(1, 1));
+    LockedPool pool(std::move(x), nullptr, true);
+
+    // the first small allocation fills the cache with a batch of its class
+    void *a0 = pool.alloc(20);
+    BOOST_CHECK(a0);
+    LockedPool::Stats stats = pool.stats();
+    BOOST_CHECK_EQUAL(stats.cache_threads, 1U);
+    BOOST_CHECK_EQUAL(stats.cache_misses, 1U);
+    BOOST_CHECK_EQUAL(stats.chunks_used, size_t(LockedPool::CACHE_BATCH));
+    BOOST_CHECK_EQUAL(stats.cached, (LockedPool::CACHE_BATCH - 1) * 32);
+
+    // a freed chunk is handed out again for the same class
+    pool.free(a0, 20);
+    void *a1 = pool.alloc(32);
+    BOOST_CHECK(a1 == a0);
+    BOOST_CHECK_EQUAL(pool.stats().cache_hits, 1U);
+
+    // frees beyond two batches go back to the arena
+    std::vector<void*> chunks{a1};
+    for (size_t i = 1; i < 3 * LockedPool::CACHE_BATCH; i++) {
+        chunks.push_back(pool.alloc(32));
+        BOOST_CHECK(chunks.back());
+    }
+    for (void *p : chunks)
+        pool.free(p, 32);
+    stats = pool.stats();
+    BOOST_CHECK(stats.cached <= 2 * LockedPool::CACHE_BATCH * 32);
+    BOOST_CHECK_EQUAL(stats.used, stats.cached);
+
+    // large ones and frees without a size don't involve the cache
+    void *a2 = pool.alloc(LockedPool::CACHE_MAX_SIZE + 1);
+    BOOST_CHECK(a2);
+    pool.free(a2, LockedPool::CACHE_MAX_SIZE + 1);
+    BOOST_CHECK_EQUAL(pool.stats().used, stats.cached);
+    void *a3 = pool.alloc(16);
+    pool.free(a3);
+    BOOST_CHECK_EQUAL(pool.stats().used, pool.stats().cached);
+}
+
+BOOST_AUTO_TEST_CASE(pool_resource_tests)
+{
+    typedef PoolResource<64, 8> Resource;
+    Resource resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK_EQUAL(resource.ChunkSizeBytes(), 1024U);
+
+    // freed blocks are handed out again for the same size
+    void* a = resource.Allocate(24, 8);
+    void* b = resource.Allocate(24, 8);
+    BOOST_CHECK(a != b);
+    resource.Deallocate(a, 24, 8);
+    BOOST_CHECK(resource.Allocate(24, 8) == a);
+    resource.Deallocate(b, 24, 8);
+
+    // blocks too large for the pool don't touch the chunks
+    void* large = resource.Allocate(2048, 8);
+    resource.Deallocate(large, 2048, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+
+    // running out of a chunk allocates the next one
+    for (int i = 0; i < 32; i++) {
+        resource.Allocate(64, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 3U);
+
+    // containers using the allocator just work, with or without a resource
+    std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, PoolAllocator<std::pair<const int, int>, 64, 8> > map(0, std::hash<int>(), std::equal_to<int>(), &resource);
+    std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, PoolAllocator<std::pair<const int, int>, 64, 8> > mapNoResource;
+    for (int i = 0; i < 1000; i++) {
+        map[i] = i;
+        mapNoResource[i] = i;
+    }
+    for (int i = 0; i < 1000; i++) {
+        BOOST_CHECK_EQUAL(map[i], i);
+        BOOST_CHECK_EQUAL(mapNoResource[i], i);
+    }
+    BOOST_CHECK(resource.NumAllocatedChunks() > 3U);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -14,6 +14,7 @@
 #include "util.h"
 #include "utilstrencodings.h"
 #include "test/test_epmcoin.h"
+#include "test/test_random.h"
 
 #include <boost/foreach.hpp>
 #include <boost/test/unit_test.hpp>
@@ -266,6 +267,46 @@ BOOST_AUTO_TEST_CASE(base58_keys_invalid)
     }
 }
 
+// Goal: check the limb boundaries of the encoder, every length and leading zeroes included
+BOOST_AUTO_TEST_CASE(base58_EncodeBase58_lengths)
+{
+    for (size_t nLen = 0; nLen < 100; nLen++) {
+        for (int nFill = 0; nFill < 3; nFill++) {
+            std::vector<unsigned char> vch(nLen);
+            for (size_t i = 0; i < nLen; i++) {
+                vch[i] = nFill == 0 ? 0xff : nFill == 1 ? (i < nLen / 3 ? 0 : i) : insecure_rand();
+            }
+            std::string str = EncodeBase58(vch);
+            std::vector<unsigned char> vchDecoded;
+            BOOST_CHECK(DecodeBase58(str, vchDecoded));
+            BOOST_CHECK(vchDecoded == vch);
+            BOOST_CHECK(str.empty() || str[0] != '1' || vch[0] == 0);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(base58_address_memo)
+{
+    CBitcoinAddress addr1(CKeyID(uint160(ParseHex("00112233445566778899aabbccddeeff00112233"))));
+    CBitcoinAddress addr2(CScriptID(uint160(ParseHex("00112233445566778899aabbccddeeff00112233"))));
+    std::string str1 = addr1.ToString();
+    std::string str2 = addr2.ToString();
+    BOOST_CHECK(str1 != str2);
+    {
+        CAddressMemo memo;
+        BOOST_CHECK_EQUAL(addr1.ToString(), str1);
+        BOOST_CHECK_EQUAL(addr1.ToString(), str1);
+        {
+            CAddressMemo inner;
+            BOOST_CHECK_EQUAL(addr2.ToString(), str2);
+        }
+        // the inner memo leaves the outer one in place
+        BOOST_CHECK_EQUAL(addr2.ToString(), str2);
+        BOOST_CHECK_EQUAL(addr1.ToString(), str1);
+    }
+    BOOST_CHECK_EQUAL(addr1.ToString(), str1);
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
 
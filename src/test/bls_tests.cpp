@@ -6,6 +6,7 @@
 
 #include "bls/bls.h"
 #include "bls/bls_batchverifier.h"
+#include "bls/bls_sigcache.h"
 #include "test/test_epmcoin.h"
 
 #include <boost/test/unit_test.hpp>
@@ -48,6 +49,58 @@ BOOST_AUTO_TEST_CASE(bls_sig_tests)
     BOOST_CHECK(sig2.VerifyInsecure(sk2.GetPublicKey(), msgHash1));
 }
 
+BOOST_AUTO_TEST_CASE(bls_lazy_tests)
+{
+    CBLSSecretKey sk;
+    sk.MakeNewKey();
+    auto sig = sk.Sign(uint256S("0000000000000000000000000000000000000000000000000000000000000005"));
+
+    CBLSLazySignature nullSig;
+    BOOST_CHECK(!nullSig.IsValid());
+
+    CBLSLazySignature lazySig;
+    lazySig.Set(sig);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << lazySig << nullSig;
+
+    // nothing is deserialized until it's needed, the hash comes from the buffer
+    CBLSLazySignature lazySig2, nullSig2;
+    ss >> lazySig2 >> nullSig2;
+    BOOST_CHECK(lazySig2.GetHash() == sig.GetHash());
+    BOOST_CHECK(lazySig2.IsValid());
+    BOOST_CHECK(lazySig2.Get() == sig);
+    BOOST_CHECK(!nullSig2.IsValid());
+}
+
+BOOST_AUTO_TEST_CASE(bls_sigcache_tests)
+{
+    CBLSSecretKey sk1, sk2;
+    sk1.MakeNewKey();
+    sk2.MakeNewKey();
+
+    uint256 msgHash1 = uint256S("0000000000000000000000000000000000000000000000000000000000000003");
+    uint256 msgHash2 = uint256S("0000000000000000000000000000000000000000000000000000000000000004");
+
+    auto sig1 = sk1.Sign(msgHash1);
+    auto entry = ComputeBLSSignatureCacheEntry(sk1.GetPublicKey().GetHash(), msgHash1, sig1);
+    BOOST_CHECK(!BLSSignatureCacheContains(entry));
+    BOOST_CHECK(VerifyBLSSignatureCached(sig1, sk1.GetPublicKey(), msgHash1));
+    BOOST_CHECK(BLSSignatureCacheContains(entry));
+    BOOST_CHECK(VerifyBLSSignatureCached(sig1, sk1.GetPublicKey(), msgHash1));
+
+    // invalid signatures are never cached, and a cached one doesn't match other keys or messages
+    BOOST_CHECK(!VerifyBLSSignatureCached(sig1, sk1.GetPublicKey(), msgHash2));
+    BOOST_CHECK(!BLSSignatureCacheContains(ComputeBLSSignatureCacheEntry(sk1.GetPublicKey().GetHash(), msgHash2, sig1)));
+    BOOST_CHECK(!VerifyBLSSignatureCached(sig1, sk2.GetPublicKey(), msgHash1));
+    BOOST_CHECK(!VerifyBLSSignatureCached(sig1, sk2.GetPublicKey(), msgHash1));
+
+    std::vector<CBLSPublicKey> pubKeys = {sk1.GetPublicKey(), sk2.GetPublicKey()};
+    auto aggSig = CBLSSignature::AggregateSecure({sk1.Sign(msgHash2), sk2.Sign(msgHash2)}, pubKeys, msgHash2);
+    BOOST_CHECK(VerifyBLSAggregatedSignatureCached(aggSig, pubKeys, msgHash2));
+    BOOST_CHECK(VerifyBLSAggregatedSignatureCached(aggSig, pubKeys, msgHash2));
+    BOOST_CHECK(!VerifyBLSAggregatedSignatureCached(aggSig, {sk1.GetPublicKey()}, msgHash2));
+}
+
 struct Message
 {
     uint32_t sourceId;
@@ -135,4 +135,26 @@ BOOST_AUTO_TEST_CASE(cachemap_test)
     BOOST_CHECK(Compare(cmapTest1, mapTest4));
 }
 
+BOOST_AUTO_TEST_CASE(cachemap_memusage_test)
+{
+    CacheMap<int,int> cmap(100);
+    BOOST_CHECK_EQUAL(cmap.DynamicMemoryUsage(), 0);
+
+    for(int i = 0; i < 100; ++i) {
+        cmap.Insert(i, i);
+    }
+    size_t nUsage = cmap.DynamicMemoryUsage();
+    BOOST_CHECK(nUsage >= 100 * sizeof(CacheItem<int,int>));
+
+    // a full cache reuses the nodes of the items it evicts
+    for(int i = 100; i < 1000; ++i) {
+        cmap.Insert(i, i);
+    }
+    BOOST_CHECK_EQUAL(cmap.DynamicMemoryUsage(), nUsage);
+
+    // the nodes are freed, only the emptied vectors are kept
+    cmap.Clear();
+    BOOST_CHECK(cmap.DynamicMemoryUsage() < nUsage);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
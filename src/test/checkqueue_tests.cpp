@@ -146,9 +146,9 @@ typedef CCheckQueue<FrozenCleanupCheck> FrozenCleanup_Queue;
 /** This test case checks that the CCheckQueue works properly
  * with each specified size_t Checks pushed.
  */
-void Correct_Queue_range(std::vector<size_t> range)
+void Correct_Queue_range(std::vector<size_t> range, unsigned int nWorkQueues = 0)
 {
-    auto small_queue = std::unique_ptr<Correct_Queue>(new Correct_Queue {QUEUE_BATCH_SIZE});
+    auto small_queue = std::unique_ptr<Correct_Queue>(new Correct_Queue(QUEUE_BATCH_SIZE, nWorkQueues));
     boost::thread_group tg;
     for (auto x = 0; x < nScriptCheckThreads; ++x) {
        tg.create_thread([&]{small_queue->Thread();});
@@ -209,6 +209,46 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_Random)
     Correct_Queue_range(range);
 }
 
+/** Test the same with per-worker queues, with fewer, as many and more queues than threads
+ */
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_WorkStealing)
+{
+    std::vector<size_t> range;
+    for (size_t i : {0, 1, 2, 3, 10, 31, 500, 100000})
+        range.push_back(i);
+    for (unsigned int nWorkQueues : {1, nScriptCheckThreads + 1, 2 * nScriptCheckThreads + 1})
+        Correct_Queue_range(range, nWorkQueues);
+}
+
+/** Test that the work-stealing queues catch failures and recover from them */
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Catches_Failure_WorkStealing)
+{
+    auto fail_queue = std::unique_ptr<Failing_Queue>(new Failing_Queue(QUEUE_BATCH_SIZE, nScriptCheckThreads + 1));
+    BOOST_REQUIRE(fail_queue->IsWorkStealing());
+
+    boost::thread_group tg;
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+       tg.create_thread([&]{fail_queue->Thread();});
+    }
+
+    for (size_t i = 0; i < 1001; ++i) {
+        CCheckQueueControl<FailingCheck> control(fail_queue.get());
+        size_t remaining = i;
+        while (remaining) {
+            size_t r = GetRand(10);
+
+            std::vector<FailingCheck> vChecks;
+            vChecks.reserve(r);
+            for (size_t k = 0; k < r && remaining; k++, remaining--)
+                vChecks.emplace_back(remaining == 1);
+            control.Add(vChecks);
+        }
+        BOOST_REQUIRE_EQUAL(control.Wait(), i == 0);
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
 
 /** Test that failing checks are caught */
 BOOST_AUTO_TEST_CASE(test_CheckQueue_Catches_Failure)
@@ -856,4 +856,47 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(coins_prefetch)
+{
+    CCoinsViewTest base;
+    COutPoint outpoint(GetRandHash(), 0);
+    COutPoint missing(GetRandHash(), 1);
+    {
+        CCoinsViewCache cache(&base);
+        cache.AddCoin(outpoint, Coin(CTxOut(VALUE1, CScript() << OP_TRUE), 1, false, false), false);
+        cache.Flush();
+    }
+
+    CCoinsViewPrefetch prefetch(&base, 10);
+    prefetch.Prefetch({outpoint, missing});
+    BOOST_CHECK_EQUAL(prefetch.Size(), 1U);
+    BOOST_CHECK(prefetch.HaveCoin(outpoint));
+
+    // Prefetched coins are handed out once, further reads go to the base view
+    Coin coin;
+    BOOST_CHECK(prefetch.GetCoin(outpoint, coin));
+    BOOST_CHECK_EQUAL(coin.out.nValue, VALUE1);
+    BOOST_CHECK_EQUAL(prefetch.Size(), 0U);
+    BOOST_CHECK(prefetch.GetCoin(outpoint, coin));
+    BOOST_CHECK(!prefetch.GetCoin(missing, coin));
+
+    // Writing through the view drops whatever it had read before
+    prefetch.Prefetch({outpoint});
+    BOOST_CHECK_EQUAL(prefetch.Size(), 1U);
+    {
+        CCoinsViewCache cache(&prefetch);
+        BOOST_CHECK(cache.SpendCoin(outpoint));
+        cache.Flush();
+    }
+    BOOST_CHECK_EQUAL(prefetch.Size(), 0U);
+    BOOST_CHECK(!prefetch.GetCoin(outpoint, coin) || coin.IsSpent());
+
+    // Spent coins are never kept, and neither is anything past the limit
+    prefetch.Prefetch({outpoint});
+    BOOST_CHECK_EQUAL(prefetch.Size(), 0U);
+    CCoinsViewPrefetch prefetchSmall(&base, 0);
+    prefetchSmall.Prefetch({outpoint, missing});
+    BOOST_CHECK_EQUAL(prefetchSmall.Size(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,9 @@
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/muhash.h"
+#include "hash.h"
+#include "streams.h"
 #include "utilstrencodings.h"
 #include "test/test_epmcoin.h"
 #include "test/test_random.h"
@@ -462,4 +465,64 @@ BOOST_AUTO_TEST_CASE(pbkdf2_hmac_sha512_test) {
     BOOST_CHECK(HexStr(k, k + 64) == "8c0511f4c6e597c6ac6315d8f0362e225f3c501495ba23b868c005174dc4ee71115b59f9e60cd9532fa33e0f75aefe30225c583a186cd82bd4daea9724a3d3b8");
 }
 
+BOOST_AUTO_TEST_CASE(sha256d64)
+{
+    for (int i = 0; i <= 32; ++i) {
+        unsigned char in[64 * 32];
+        unsigned char out1[32 * 32], out2[32 * 32];
+        for (int j = 0; j < 64 * i; ++j) {
+            in[j] = insecure_rand();
+        }
+        for (int j = 0; j < i; ++j) {
+            CHash256().Write(in + 64 * j, 64).Finalize(out1 + 32 * j);
+        }
+        SHA256D64(out2, in, i);
+        BOOST_CHECK(memcmp(out1, out2, 32 * i) == 0);
+        // in place, the way the merkle root uses it
+        SHA256D64(in, in, i);
+        BOOST_CHECK(memcmp(out1, in, 32 * i) == 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests) {
+    unsigned char a[] = {1, 2, 3}, b[] = {4, 5}, c[] = {6};
+    uint256 hashEmpty, hash1, hash2, hash3;
+
+    MuHash3072().Finalize(hashEmpty.begin());
+
+    // inserting and removing the same element is the empty set
+    MuHash3072 set;
+    set.Insert(a, sizeof(a)).Remove(a, sizeof(a));
+    set.Finalize(hash1.begin());
+    BOOST_CHECK(hash1 == hashEmpty);
+
+    // the order doesn't matter, and neither does splitting the set
+    MuHash3072 set1, set2, set3;
+    set1.Insert(a, sizeof(a)).Insert(b, sizeof(b)).Insert(c, sizeof(c)).Remove(b, sizeof(b));
+    set2.Insert(c, sizeof(c)).Insert(a, sizeof(a));
+    set3.Insert(a, sizeof(a));
+    MuHash3072 part;
+    part.Insert(b, sizeof(b)).Insert(c, sizeof(c));
+    set3 *= part;
+    MuHash3072 removed;
+    removed.Insert(b, sizeof(b));
+    set3 /= removed;
+    set1.Finalize(hash1.begin());
+    set2.Finalize(hash2.begin());
+    set3.Finalize(hash3.begin());
+    BOOST_CHECK(hash1 == hash2);
+    BOOST_CHECK(hash1 == hash3);
+    BOOST_CHECK(hash1 != hashEmpty);
+
+    // a serialized set, including its pending removals, finalizes to the same hash
+    MuHash3072 ser, deser;
+    ser.Insert(a, sizeof(a)).Insert(b, sizeof(b)).Insert(c, sizeof(c)).Remove(b, sizeof(b));
+    CDataStream ss(SER_DISK, 0);
+    ss << ser;
+    BOOST_CHECK_EQUAL(ss.size(), 2 * Num3072::BYTE_SIZE);
+    ss >> deser;
+    deser.Finalize(hash3.begin());
+    BOOST_CHECK(hash3 == hash1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "dbwrapper.h"
+#include "txdb.h"
 #include "uint256.h"
 #include "random.h"
 #include "test/test_epmcoin.h"
@@ -320,4 +321,124 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
 
 
 
+BOOST_AUTO_TEST_CASE(dbwrapper_readmany_prefix)
+{
+    // Perform tests both obfuscated and non-obfuscated.
+    for (int i = 0; i < 2; i++) {
+        bool obfuscate = (bool)i;
+        boost::filesystem::path ph = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate);
+
+        CDBBatch batch(dbw);
+        for (uint32_t x = 0; x < 100; x += 2) {
+            batch.Write(std::make_pair('a', x), x * 3);
+            batch.Write(std::make_pair('b', x), x);
+        }
+        BOOST_CHECK(dbw.WriteBatch(batch));
+
+        // unsorted, with missing keys and a duplicate
+        std::vector<std::pair<char, uint32_t> > keys = {{'a', 10}, {'a', 3}, {'a', 98}, {'a', 0}, {'a', 11}, {'a', 10}, {'c', 0}};
+        std::vector<uint32_t> values;
+        std::vector<bool> vFound;
+        BOOST_CHECK_EQUAL(dbw.ReadMany(keys, values, vFound), 4U);
+        BOOST_CHECK(vFound == std::vector<bool>({true, false, true, true, false, true, false}));
+        BOOST_CHECK_EQUAL(values[0], 30U);
+        BOOST_CHECK_EQUAL(values[2], 294U);
+        BOOST_CHECK_EQUAL(values[3], 0U);
+        BOOST_CHECK_EQUAL(values[5], 30U);
+
+        uint32_t nCount = 0;
+        for (CDBPrefixIterator it(dbw, 'a'); it.Valid(); it.Next()) {
+            std::pair<char, uint32_t> key;
+            uint32_t value;
+            BOOST_CHECK(it.GetKey(key) && it.GetValue(value));
+            BOOST_CHECK_EQUAL(key.first, 'a');
+            BOOST_CHECK_EQUAL(value, key.second * 3);
+            nCount++;
+        }
+        BOOST_CHECK_EQUAL(nCount, 50U);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(dbwrapper_tuning)
+{
+    std::string strError;
+    CDBTuning tuning(1 << 20);
+    BOOST_CHECK_EQUAL(tuning.nBlockCacheSize, (size_t)1 << 19);
+    BOOST_CHECK_EQUAL(tuning.nBloomBits, 10);
+
+    ForceSetMultiArgs("-dbtuning", {"test:cache=8", "test:bloombits=0", "other:maxopenfiles=1000"});
+    BOOST_CHECK(CheckDBTuningArgs(strError));
+    BOOST_CHECK(ApplyDBTuningArgs("test", tuning, strError));
+    BOOST_CHECK_EQUAL(tuning.nBlockCacheSize, (size_t)8 << 20);
+    BOOST_CHECK_EQUAL(tuning.nBloomBits, 0);
+    BOOST_CHECK_EQUAL(tuning.nMaxOpenFiles, 64);
+
+    {
+        boost::filesystem::path ph = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+        CDBWrapper dbw(ph, (1 << 20), true, false, false, "test");
+        BOOST_CHECK(dbw.Write('k', GetRandHash()));
+        CDBStats stats = dbw.GetStats();
+        BOOST_CHECK_EQUAL(stats.strName, "test");
+        BOOST_CHECK_EQUAL(stats.tuning.nBlockCacheSize, (size_t)8 << 20);
+        BOOST_CHECK_EQUAL(stats.nBatchesWritten, 1U);
+
+        std::vector<CDBStats> vStats = CDBWrapper::GetAllStats();
+        BOOST_CHECK(std::any_of(vStats.begin(), vStats.end(), [](const CDBStats& s) { return s.strName == "test"; }));
+    }
+    std::vector<CDBStats> vStats = CDBWrapper::GetAllStats();
+    BOOST_CHECK(std::none_of(vStats.begin(), vStats.end(), [](const CDBStats& s) { return s.strName == "test"; }));
+
+    ForceSetMultiArgs("-dbtuning", {"test:cache"});
+    BOOST_CHECK(!CheckDBTuningArgs(strError));
+    ForceSetMultiArgs("-dbtuning", {"test:speed=1"});
+    BOOST_CHECK(!CheckDBTuningArgs(strError));
+    ForceSetMultiArgs("-dbtuning", {});
+}
+
+BOOST_AUTO_TEST_CASE(txindexdb)
+{
+    CBlockTreeDB blocktree(1 << 20, true);
+    std::vector<std::pair<uint256, CDiskTxPos> > vLegacy, vPos;
+    for (unsigned int i = 0; i < 100; i++) {
+        vLegacy.emplace_back(GetRandHash(), CDiskTxPos(CDiskBlockPos(0, i), i));
+        BOOST_CHECK(blocktree.Write(std::make_pair('t', vLegacy.back().first), vLegacy.back().second));
+    }
+    // indexed again by a newer block
+    vPos.emplace_back(vLegacy[0].first, CDiskTxPos(CDiskBlockPos(1, 0), 80));
+    for (unsigned int i = 1; i < 2000; i++) {
+        vPos.emplace_back(GetRandHash(), CDiskTxPos(CDiskBlockPos(1, i), 80 + i));
+    }
+    uint256 hashBlock = GetRandHash();
+
+    CTxIndexDB txindex(blocktree, 1 << 20, true, true);
+    BOOST_CHECK(txindex.GetBestBlock().IsNull());
+    txindex.AddBlock(hashBlock, std::vector<std::pair<uint256, CDiskTxPos> >(vPos));
+
+    // queued and legacy entries are found before anything is written
+    CDiskTxPos pos;
+    for (const auto& p : vPos) {
+        BOOST_CHECK(txindex.ReadTxIndex(p.first, pos) && pos == p.second);
+    }
+    BOOST_CHECK(txindex.ReadTxIndex(vLegacy[1].first, pos) && pos == vLegacy[1].second);
+    BOOST_CHECK(!txindex.HasTxIndex(GetRandHash()));
+
+    // the writer moves the legacy entries when there is nothing else to do
+    txindex.Start();
+    for (int i = 0; i < 1000 && blocktree.HasTxIndex(vLegacy.back().first); i++) {
+        MilliSleep(10);
+    }
+    txindex.Stop();
+    BOOST_CHECK(txindex.GetBestBlock() == hashBlock);
+    for (const auto& p : vLegacy) {
+        BOOST_CHECK(!blocktree.HasTxIndex(p.first));
+    }
+    for (const auto& p : vPos) {
+        BOOST_CHECK(txindex.ReadTxIndex(p.first, pos) && pos == p.second);
+    }
+    for (unsigned int i = 1; i < vLegacy.size(); i++) {
+        BOOST_CHECK(txindex.ReadTxIndex(vLegacy[i].first, pos) && pos == vLegacy[i].second);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
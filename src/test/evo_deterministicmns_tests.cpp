@@ -215,6 +215,110 @@ static CDeterministicMNCPtr FindPayoutDmn(const CBlock& block)
 
 BOOST_AUTO_TEST_SUITE(evo_dip3_activation_tests)
 
+BOOST_FIXTURE_TEST_CASE(special_tx_payload_cache, BasicTestingSetup)
+{
+    CMutableTransaction mtx;
+    mtx.nVersion = 3;
+    mtx.nType = TRANSACTION_PROVIDER_UPDATE_REVOKE;
+    mtx.vin.emplace_back(COutPoint(GetRandHash(), 1));
+    CProUpRevTx proTx;
+    proTx.proTxHash = GetRandHash();
+    proTx.nReason = CProUpRevTx::REASON_CHANGE_OF_KEYS;
+    proTx.inputsHash = CalcTxInputsHash(mtx);
+    SetTxPayload(mtx, proTx);
+    CTransaction tx(mtx);
+
+    // decoded once, later calls share the same object
+    auto ptr = GetTxPayloadShared<CProUpRevTx>(tx);
+    BOOST_REQUIRE(ptr);
+    BOOST_CHECK(ptr == GetTxPayloadShared<CProUpRevTx>(tx));
+    BOOST_CHECK(ptr->proTxHash == proTx.proTxHash && ptr->nReason == proTx.nReason);
+    BOOST_CHECK(CalcTxInputsHash(tx) == proTx.inputsHash);
+
+    CProUpRevTx proTx2;
+    BOOST_CHECK(GetTxPayload(tx, proTx2));
+    BOOST_CHECK(proTx2.proTxHash == proTx.proTxHash);
+
+    // asking for another type decodes again and fails, also when cached
+    CProRegTx proRegTx;
+    BOOST_CHECK(!GetTxPayload(tx, proRegTx));
+    BOOST_CHECK(!GetTxPayloadShared<CProRegTx>(tx));
+    BOOST_CHECK(CalcTxInputsHash(tx) == proTx.inputsHash);
+
+    // copies carry the cache along, a fresh transaction starts without
+    CTransaction txCopy(tx);
+    BOOST_CHECK(txCopy.GetPayloadCache() == tx.GetPayloadCache());
+    BOOST_CHECK(!CTransaction(mtx).GetPayloadCache());
+}
+
+static CDeterministicMNCPtr MakeTestMN(uint64_t internalId)
+{
+    auto dmn = std::make_shared<CDeterministicMN>();
+    dmn->proTxHash = GetRandHash();
+    dmn->internalId = internalId;
+    dmn->collateralOutpoint = COutPoint(GetRandHash(), 0);
+    dmn->nOperatorReward = 0;
+    auto state = std::make_shared<CDeterministicMNState>();
+    uint256 keyHash = GetRandHash();
+    state->keyIDOwner = CKeyID(uint160(std::vector<unsigned char>(keyHash.begin(), keyHash.begin() + 20)));
+    dmn->pdmnState = state;
+    return dmn;
+}
+
+static CDeterministicMNStateDiff MakeTestStateDiff(const CDeterministicMNCPtr& dmn, int nPoSePenalty, int nLastPaidHeight)
+{
+    CDeterministicMNState state = *dmn->pdmnState;
+    state.nPoSePenalty = nPoSePenalty;
+    state.nLastPaidHeight = nLastPaidHeight;
+    return CDeterministicMNStateDiff(*dmn->pdmnState, state);
+}
+
+BOOST_FIXTURE_TEST_CASE(mnlist_diff_merge, BasicTestingSetup)
+{
+    std::vector<uint256> hashes{GetRandHash(), GetRandHash(), GetRandHash(), GetRandHash()};
+    std::vector<CBlockIndex> blocks(hashes.size());
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i].phashBlock = &hashes[i];
+        blocks[i].nHeight = i;
+    }
+
+    CDeterministicMNListDiff diff0;
+    for (uint64_t i = 0; i < 3; i++) {
+        diff0.addedMNs.emplace_back(MakeTestMN(i));
+    }
+    CDeterministicMNList list0 = CDeterministicMNList().ApplyDiff(&blocks[0], diff0);
+    BOOST_CHECK_EQUAL(list0.GetAllMNsCount(), 3U);
+
+    // update one, add one, then update both of them and remove another one
+    auto mn3 = MakeTestMN(3);
+    CDeterministicMNListDiff diff1;
+    diff1.updatedMNs.emplace(0, MakeTestStateDiff(list0.GetMNByInternalId(0), 5, 0));
+    diff1.addedMNs.emplace_back(mn3);
+    CDeterministicMNList list1 = list0.ApplyDiff(&blocks[1], diff1);
+
+    CDeterministicMNListDiff diff2;
+    diff2.updatedMNs.emplace(0, MakeTestStateDiff(list1.GetMNByInternalId(0), 4, 2));
+    diff2.updatedMNs.emplace(3, MakeTestStateDiff(mn3, 0, 2));
+    diff2.removedMns.emplace(1);
+    CDeterministicMNList list2 = list1.ApplyDiff(&blocks[2], diff2);
+
+    CDeterministicMNListDiff merged = diff1;
+    BOOST_CHECK(merged.Merge(diff2));
+    CDeterministicMNList list2Merged = list0.ApplyDiff(&blocks[2], merged);
+    BOOST_CHECK(!list2.BuildDiff(list2Merged).HasChanges());
+    BOOST_CHECK(list2Merged.GetBlockHash() == hashes[2]);
+    BOOST_CHECK_EQUAL(list2Merged.GetTotalRegisteredCount(), 4U);
+    BOOST_CHECK_EQUAL(list2Merged.GetMNByInternalId(0)->pdmnState->nPoSePenalty, 4);
+    BOOST_CHECK_EQUAL(list2Merged.GetMNByInternalId(3)->pdmnState->nLastPaidHeight, 2);
+    BOOST_CHECK(!list2Merged.GetMNByInternalId(1));
+
+    // removing a MN the merged diff adds can't be merged
+    CDeterministicMNListDiff diff3;
+    diff3.removedMns.emplace(3);
+    BOOST_CHECK(!merged.Merge(diff3));
+    BOOST_CHECK_EQUAL(merged.addedMNs.size(), 1U);
+}
+
 BOOST_FIXTURE_TEST_CASE(dip3_activation, TestChainDIP3BeforeActivationSetup)
 {
     auto utxos = BuildSimpleUtxoMap(coinbaseTxns);
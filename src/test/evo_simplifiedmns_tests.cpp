@@ -7,6 +7,7 @@
 #include "test/test_epmcoin.h"
 
 #include "bls/bls.h"
+#include "evo/deterministicmns.h"
 #include "evo/simplifiedmns.h"
 #include "netbase.h"
 
@@ -72,4 +73,48 @@ BOOST_AUTO_TEST_CASE(simplifiedmns_merkleroots)
 
     BOOST_CHECK(expectedMerkleRoot == calculatedMerkleRoot);
 }
+
+BOOST_AUTO_TEST_CASE(simplifiedmns_merkle_cache)
+{
+    CDeterministicMNList mnList(uint256(), 0, 0);
+    for (size_t i = 0; i < 15; i++) {
+        auto state = std::make_shared<CDeterministicMNState>();
+        state->confirmedHash = GetRandHash();
+        Lookup(strprintf("1.1.1.%d", i + 1).c_str(), state->addr, 1000, false);
+        state->keyIDOwner.SetHex(strprintf("%040x", i));
+        state->keyIDVoting = state->keyIDOwner;
+        CBLSSecretKey sk;
+        sk.MakeNewKey();
+        state->pubKeyOperator.Set(sk.GetPublicKey());
+
+        auto dmn = std::make_shared<CDeterministicMN>();
+        dmn->proTxHash = GetRandHash();
+        dmn->internalId = i;
+        dmn->collateralOutpoint = COutPoint(GetRandHash(), 0);
+        dmn->pdmnState = state;
+        mnList.AddMN(dmn);
+    }
+
+    CSimplifiedMNListMerkleCache cache;
+    BOOST_CHECK(cache.CalcMerkleRoot(mnList) == CSimplifiedMNList(mnList).CalcMerkleRoot());
+    BOOST_CHECK(cache.CalcMerkleRoot(mnList) == CSimplifiedMNList(mnList).CalcMerkleRoot());
+
+    // changed, banned and removed masternodes all show up in the root
+    std::vector<CDeterministicMNCPtr> dmns;
+    mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) { dmns.push_back(dmn); });
+    auto state = std::make_shared<CDeterministicMNState>(*dmns[3]->pdmnState);
+    state->confirmedHash = GetRandHash();
+    mnList.UpdateMN(dmns[3]->proTxHash, state);
+    uint256 root = cache.CalcMerkleRoot(mnList);
+    BOOST_CHECK(root == CSimplifiedMNList(mnList).CalcMerkleRoot());
+
+    state = std::make_shared<CDeterministicMNState>(*dmns[5]->pdmnState);
+    state->nPoSeBanHeight = 1;
+    mnList.UpdateMN(dmns[5]->proTxHash, state);
+    BOOST_CHECK(cache.CalcMerkleRoot(mnList) == CSimplifiedMNList(mnList).CalcMerkleRoot());
+
+    mnList.RemoveMN(dmns[7]->proTxHash);
+    BOOST_CHECK(cache.CalcMerkleRoot(mnList) == CSimplifiedMNList(mnList).CalcMerkleRoot());
+    BOOST_CHECK(cache.CalcMerkleRoot(mnList) != root);
+}
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,8 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "hash.h"
+#include "primitives/block.h"
+#include "streams.h"
 #include "utilstrencodings.h"
 #include "test/test_epmcoin.h"
 
@@ -149,4 +151,97 @@ BOOST_AUTO_TEST_CASE(siphash)
     BOOST_CHECK_EQUAL(SipHashUint256(1, 2, ss.GetHash()), 0x79751e980c2a0a35ULL);
 }
 
+BOOST_AUTO_TEST_CASE(x11_testvectors)
+{
+    // Whatever X11AutoDetect() selected must match the portable sphlib code
+    BOOST_TEST_MESSAGE("X11 implementation: " << X11AutoDetect());
+
+    unsigned char empty[1];
+    std::string abc = "abc";
+    std::vector<unsigned char> header(80), data(256);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = i;
+        if (i < header.size())
+            header[i] = i;
+    }
+
+    BOOST_CHECK_EQUAL(HashX11(empty, empty).GetHex(), "ba4e5867eb17cdc33dccb6cc7175256320e2b4627ec221a26e5783902072b551");
+    BOOST_CHECK_EQUAL(HashX11(abc.begin(), abc.end()).GetHex(), "f436558e99a70493b0f242f1ef355bbf6b1a8736f55cb8855dab0f86555f67cb");
+    BOOST_CHECK_EQUAL(HashX11(header.begin(), header.end()).GetHex(), "ceece3d4f75f36c26b50278c1ae635eef54fde24e49cea10e29ea3a97a762e41");
+
+    // Longer than one ECHO block, so the counter carries into a second compression
+    sph_echo512_context ctx_echo;
+    unsigned char out[64];
+    sph_echo512_init(&ctx_echo);
+    sph_echo512(&ctx_echo, data.data(), data.size());
+    sph_echo512_close(&ctx_echo, out);
+    BOOST_CHECK_EQUAL(HexStr(out, out + sizeof(out)), "73ca1dc9468fa4ecf4a75de87d425d35972a6e08aeeea396f951e9026426a6d3f1a3939336244f5c799a30f5ceb5c455af521aa4b445183fb5da875c666be02d");
+}
+
+static uint256 HashHeaderUncached(const CBlockHeader& header)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << header;
+    return HashX11((const char *)&ss[0], (const char *)&ss[0] + ss.size());
+}
+
+BOOST_AUTO_TEST_CASE(block_header_hash_cache)
+{
+    CBlock block;
+    block.nVersion = 1;
+    block.hashPrevBlock = GetRandHash();
+    block.hashMerkleRoot = GetRandHash();
+    block.nTime = 1560000000;
+    block.nBits = 0x1e0ffff0;
+    block.nNonce = 42;
+    BOOST_CHECK(block.GetHash() == HashHeaderUncached(block));
+
+    // Deserializing a block fills the cache, copies keep it
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    CBlock blockRead;
+    ss >> blockRead;
+    BOOST_CHECK(blockRead.GetHash() == block.GetHash());
+    CBlockHeader header = blockRead.GetBlockHeader();
+    BOOST_CHECK(header.GetHash() == block.GetHash());
+
+    // Any change to the header fields must not return the stale hash
+    blockRead.nNonce++;
+    BOOST_CHECK(blockRead.GetHash() != block.GetHash());
+    BOOST_CHECK(blockRead.GetHash() == HashHeaderUncached(blockRead));
+    blockRead.UpdateHashCache();
+    blockRead.nTime++;
+    BOOST_CHECK(blockRead.GetHash() == HashHeaderUncached(blockRead));
+    blockRead.nTime--;
+    blockRead.hashMerkleRoot = GetRandHash();
+    BOOST_CHECK(blockRead.GetHash() == HashHeaderUncached(blockRead));
+
+    blockRead.SetNull();
+    BOOST_CHECK(blockRead.GetHash() == HashHeaderUncached(blockRead));
+}
+
+BOOST_AUTO_TEST_CASE(x11_batch)
+{
+    std::vector<unsigned char> data(80 * 20);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = GetRandInt(256);
+
+    for (size_t nCount = 0; nCount <= 20; nCount++) {
+        std::vector<uint256> vHashes(nCount);
+        HashX11Batch(data.data(), 80, nCount, vHashes.data());
+        for (size_t i = 0; i < nCount; i++)
+            BOOST_CHECK(vHashes[i] == HashX11(data.begin() + 80 * i, data.begin() + 80 * (i + 1)));
+    }
+
+    std::vector<CBlockHeader> headers(11);
+    for (size_t i = 0; i < headers.size(); i++) {
+        headers[i].nVersion = 1;
+        headers[i].hashPrevBlock = GetRandHash();
+        headers[i].nNonce = i;
+    }
+    CacheBlockHeaderHashes(MakeSpan(headers));
+    for (const CBlockHeader& header : headers)
+        BOOST_CHECK(header.GetHash() == HashHeaderUncached(header));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
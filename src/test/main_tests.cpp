@@ -2,10 +2,17 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "chainparams.h"
 #include "net.h"
+#include "random.h"
+#include "txdb.h"
+#include "validation.h"
 
 #include "test/test_epmcoin.h"
 
+#include <limits>
+#include <memory>
+
 #include <boost/signals2/signal.hpp>
 #include <boost/test/unit_test.hpp>
 
@@ -27,4 +34,114 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+
+BOOST_AUTO_TEST_CASE(header_checks_context_free)
+{
+    std::vector<CBlockHeader> headers(1000);
+    for (size_t i = 0; i < headers.size(); i++) {
+        headers[i].nVersion = 1;
+        headers[i].hashPrevBlock = i ? headers[i - 1].GetHash() : GetRandHash();
+        headers[i].nNonce = i;
+    }
+    std::vector<CBlockHeader> vCopy(headers);
+    BOOST_CHECK(!vCopy.back().IsHashCacheValid());
+
+    // Use the header check workers, compare with the serial path
+    int nScriptCheckThreadsOld = nScriptCheckThreads;
+    nScriptCheckThreads = 4;
+    CheckBlockHeadersContextFree(vCopy);
+    StopContextFreeCheckWorkers();
+    nScriptCheckThreads = nScriptCheckThreadsOld;
+
+    for (size_t i = 0; i < headers.size(); i++) {
+        BOOST_CHECK(vCopy[i].IsHashCacheValid());
+        BOOST_CHECK(vCopy[i].GetHash() == headers[i].GetHash());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(block_index_snapshot)
+{
+    const int nBlocks = 100;
+    std::vector<uint256> vHashes(nBlocks);
+    std::vector<CBlockIndex> vIndex(nBlocks);
+    std::vector<const CBlockIndex*> vIndexPtrs;
+    for (int i = 0; i < nBlocks; i++) {
+        vHashes[i] = GetRandHash();
+        vIndex[i].phashBlock = &vHashes[i];
+        vIndex[i].pprev = i ? &vIndex[i - 1] : NULL;
+        vIndex[i].nHeight = i;
+        vIndex[i].nTime = 1560000000 + i;
+        vIndex[i].nStakeModifier = GetRand(std::numeric_limits<uint64_t>::max());
+        vIndexPtrs.push_back(&vIndex[i]);
+    }
+
+    std::map<uint256, CBlockIndex*> mapLoaded;
+    std::vector<std::unique_ptr<CBlockIndex>> vOwned;
+    auto insertBlockIndex = [&](const uint256& hash) -> CBlockIndex* {
+        if (hash.IsNull())
+            return NULL;
+        CBlockIndex*& pindex = mapLoaded[hash];
+        if (!pindex) {
+            vOwned.emplace_back(new CBlockIndex());
+            pindex = vOwned.back().get();
+        }
+        return pindex;
+    };
+
+    boost::filesystem::path path = pathTemp / "blockindex.dat";
+    uint256 hashBestChain = vHashes.back();
+    BOOST_CHECK(pblocktree->WriteBlockIndexSnapshot(path, hashBestChain, vIndexPtrs));
+
+    // A different best chain means the snapshot is stale, and it is gone after one attempt
+    BOOST_CHECK(!pblocktree->LoadBlockIndexSnapshot(path, vHashes.front(), insertBlockIndex));
+    BOOST_CHECK(!pblocktree->LoadBlockIndexSnapshot(path, hashBestChain, insertBlockIndex));
+    BOOST_CHECK(mapLoaded.empty());
+
+    BOOST_CHECK(pblocktree->WriteBlockIndexSnapshot(path, hashBestChain, vIndexPtrs));
+    BOOST_CHECK(pblocktree->LoadBlockIndexSnapshot(path, hashBestChain, insertBlockIndex));
+    BOOST_CHECK_EQUAL(mapLoaded.size(), (size_t)nBlocks);
+    for (int i = 0; i < nBlocks; i++) {
+        const CBlockIndex* pindex = mapLoaded[vHashes[i]];
+        BOOST_CHECK_EQUAL(pindex->nHeight, i);
+        BOOST_CHECK_EQUAL(pindex->nTime, vIndex[i].nTime);
+        BOOST_CHECK_EQUAL(pindex->nStakeModifier, vIndex[i].nStakeModifier);
+        BOOST_CHECK(pindex->pprev == (i ? mapLoaded[vHashes[i - 1]] : NULL));
+    }
+
+    // Writing to the block index invalidates the snapshot
+    mapLoaded.clear();
+    BOOST_CHECK(pblocktree->WriteBlockIndexSnapshot(path, hashBestChain, vIndexPtrs));
+    BOOST_CHECK(pblocktree->WriteBatchSync({}, 0, {}));
+    BOOST_CHECK(!pblocktree->LoadBlockIndexSnapshot(path, hashBestChain, insertBlockIndex));
+    BOOST_CHECK(mapLoaded.empty());
+}
+
+BOOST_AUTO_TEST_CASE(block_file_writer)
+{
+    const CChainParams& chainparams = Params();
+    const CBlock& genesis = chainparams.GenesisBlock();
+
+    // Appended blocks can be read back while they are still buffered
+    CDiskBlockPos posFirst(99, 0);
+    BOOST_CHECK(WriteBlockToDisk(genesis, posFirst, chainparams.MessageStart()));
+    BOOST_CHECK_EQUAL(posFirst.nPos, 8U);
+    CDiskBlockPos posSecond(99, posFirst.nPos + ::GetSerializeSize(genesis, SER_DISK, CLIENT_VERSION));
+    BOOST_CHECK(WriteBlockToDisk(genesis, posSecond, chainparams.MessageStart()));
+    BOOST_CHECK_EQUAL(posSecond.nPos, 2 * posFirst.nPos + ::GetSerializeSize(genesis, SER_DISK, CLIENT_VERSION));
+
+    for (const CDiskBlockPos& pos : {posFirst, posSecond}) {
+        CBlock block;
+        BOOST_CHECK(ReadBlockFromDisk(block, pos, chainparams.GetConsensus()));
+        BOOST_CHECK(block.GetHash() == genesis.GetHash());
+    }
+
+    // Switching files leaves the previous one complete
+    CDiskBlockPos posOther(100, 0);
+    BOOST_CHECK(WriteBlockToDisk(genesis, posOther, chainparams.MessageStart()));
+    CBlock block;
+    BOOST_CHECK(ReadBlockFromDisk(block, posSecond, chainparams.GetConsensus()));
+    BOOST_CHECK(ReadBlockFromDisk(block, posOther, chainparams.GetConsensus()));
+    BOOST_CHECK(block.GetHash() == genesis.GetHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 #include "addrman.h"
+#include "arith_uint256.h"
 #include "test/test_epmcoin.h"
 #include <string>
 #include <boost/test/unit_test.hpp>
@@ -172,4 +173,174 @@ BOOST_AUTO_TEST_CASE(cnode_simple_test)
     BOOST_CHECK(pnode2->fFeeler == false);
 }
 
+BOOST_AUTO_TEST_CASE(socket_events_mode_parse)
+{
+    SocketEventsMode mode = SOCKETEVENTS_POLL;
+    BOOST_CHECK(ParseSocketEventsMode("select", mode));
+    BOOST_CHECK_EQUAL(mode, SOCKETEVENTS_SELECT);
+    BOOST_CHECK(!ParseSocketEventsMode("", mode));
+    BOOST_CHECK(!ParseSocketEventsMode("SELECT", mode));
+    BOOST_CHECK(!ParseSocketEventsMode("iocp", mode));
+    BOOST_CHECK_EQUAL(mode, SOCKETEVENTS_SELECT);
+
+    // The default has to be one of the supported modes
+    BOOST_CHECK(ParseSocketEventsMode(DEFAULT_SOCKETEVENTS, mode));
+    BOOST_CHECK(GetSupportedSocketEventsStr().find(std::string("'") + DEFAULT_SOCKETEVENTS + "'") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(chainstate_free_messages)
+{
+    BOOST_CHECK(IsChainstateFreeMessage(NetMsgType::QSIGSHARESINV));
+    BOOST_CHECK(IsChainstateFreeMessage(NetMsgType::QBSIGSHARES));
+    BOOST_CHECK(IsChainstateFreeMessage(NetMsgType::QCONTRIB));
+    BOOST_CHECK(IsChainstateFreeMessage(NetMsgType::ISLOCK));
+    BOOST_CHECK(IsChainstateFreeMessage(NetMsgType::CLSIG));
+    BOOST_CHECK(IsChainstateFreeMessage(NetMsgType::MNGOVERNANCEOBJECTVOTE));
+
+    // Everything that feeds validation or is ordered with the handshake stays on the message handler
+    BOOST_CHECK(!IsChainstateFreeMessage(NetMsgType::VERSION));
+    BOOST_CHECK(!IsChainstateFreeMessage(NetMsgType::GETDATA));
+    BOOST_CHECK(!IsChainstateFreeMessage(NetMsgType::BLOCK));
+    BOOST_CHECK(!IsChainstateFreeMessage(NetMsgType::TX));
+    BOOST_CHECK(!IsChainstateFreeMessage(NetMsgType::HEADERS));
+    BOOST_CHECK(!IsChainstateFreeMessage(NetMsgType::QFCOMMITMENT));
+    BOOST_CHECK(!IsChainstateFreeMessage(""));
+}
+
+static std::vector<char> MakeWireMessage(const char* pszCommand, const std::vector<char>& vPayload)
+{
+    CMessageHeader hdr(Params().MessageStart(), pszCommand, vPayload.size());
+    uint256 hash = Hash(vPayload.begin(), vPayload.end());
+    memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    CDataStream ss(SER_NETWORK, INIT_PROTO_VERSION);
+    ss << hdr;
+    std::vector<char> vMsg(ss.begin(), ss.end());
+    vMsg.insert(vMsg.end(), vPayload.begin(), vPayload.end());
+    return vMsg;
+}
+
+BOOST_AUTO_TEST_CASE(netmessage_receive_in_place)
+{
+    std::vector<char> vPayload(300 * 1024);
+    for (size_t i = 0; i < vPayload.size(); i++)
+        vPayload[i] = (char)(i * 7);
+    std::vector<char> vWire = MakeWireMessage(NetMsgType::BLOCK, vPayload);
+    const char* pch = vWire.data();
+
+    CNetMessage msg(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+    BOOST_CHECK_EQUAL(msg.readHeader(pch, CMessageHeader::HEADER_SIZE), (int)CMessageHeader::HEADER_SIZE);
+    pch += CMessageHeader::HEADER_SIZE;
+    BOOST_CHECK(msg.in_data);
+    BOOST_CHECK_EQUAL(msg.readData(pch, 1000), 1000);
+    pch += 1000;
+
+    // The rest is written straight into the message, at most 256 KiB ahead at a time
+    while (!msg.complete()) {
+        unsigned int nSpace = 0;
+        char* pchSpace = msg.GetDataSpace(nSpace);
+        BOOST_CHECK(nSpace > 0 && nSpace <= 256 * 1024);
+        unsigned int nCopy = std::min(nSpace, (unsigned int)(vWire.data() + vWire.size() - pch));
+        memcpy(pchSpace, pch, nCopy);
+        msg.DataReceived(nCopy);
+        pch += nCopy;
+    }
+    BOOST_CHECK(pch == vWire.data() + vWire.size());
+    BOOST_CHECK(std::equal(msg.vRecv.begin(), msg.vRecv.end(), vPayload.begin()));
+    BOOST_CHECK(memcmp(msg.GetMessageHash().begin(), msg.hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) == 0);
+
+    // A reset message parses the next one like a fresh one
+    std::vector<char> vSmallPayload(100, 'x');
+    std::vector<char> vSmallWire = MakeWireMessage(NetMsgType::INV, vSmallPayload);
+    msg.Reset(Params().MessageStart(), INIT_PROTO_VERSION);
+    BOOST_CHECK(!msg.in_data);
+    BOOST_CHECK_EQUAL(msg.readHeader(vSmallWire.data(), vSmallWire.size()), (int)CMessageHeader::HEADER_SIZE);
+    BOOST_CHECK_EQUAL(msg.readData(vSmallWire.data() + CMessageHeader::HEADER_SIZE, vSmallWire.size()), (int)vSmallPayload.size());
+    BOOST_CHECK(msg.complete());
+    BOOST_CHECK_EQUAL(msg.hdr.GetCommand(), NetMsgType::INV);
+    BOOST_CHECK(std::equal(msg.vRecv.begin(), msg.vRecv.end(), vSmallPayload.begin()));
+    BOOST_CHECK(memcmp(msg.GetMessageHash().begin(), msg.hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(shared_net_msg)
+{
+    std::vector<char> vPayload(1000, 'y');
+    CSerializedNetMsg msg;
+    msg.command = NetMsgType::CLSIG;
+    msg.data.assign(vPayload.begin(), vPayload.end());
+    const unsigned char* pchData = msg.data.data();
+
+    CSharedNetMsg sharedMsg = CConnman::ShareMessage(std::move(msg));
+    BOOST_CHECK_EQUAL(sharedMsg.command, NetMsgType::CLSIG);
+    // The payload is moved, not copied
+    BOOST_CHECK(sharedMsg.data->data() == pchData);
+
+    // Header and payload together are what a peer would have gotten before
+    std::vector<char> vWire = MakeWireMessage(NetMsgType::CLSIG, vPayload);
+    BOOST_CHECK_EQUAL(sharedMsg.header->size(), CMessageHeader::HEADER_SIZE);
+    BOOST_CHECK(std::equal(sharedMsg.header->begin(), sharedMsg.header->end(), (const unsigned char*)vWire.data()));
+    BOOST_CHECK(std::equal(sharedMsg.data->begin(), sharedMsg.data->end(), (const unsigned char*)vWire.data() + CMessageHeader::HEADER_SIZE));
+}
+
+BOOST_AUTO_TEST_CASE(tx_announce_queue)
+{
+    CTxAnnounceQueue queue(4);
+    std::map<uint256, CTxAnnounceQueue::Priority> mapPriority;
+    auto getPriority = [&](const uint256& hash, CTxAnnounceQueue::Priority& priority) {
+        auto it = mapPriority.find(hash);
+        if (it == mapPriority.end()) return false;
+        priority = it->second;
+        return true;
+    };
+    std::vector<uint256> vHashes;
+    for (int i = 0; i < 6; i++) {
+        vHashes.push_back(ArithToUint256(i + 1));
+    }
+    mapPriority[vHashes[0]] = {1, 1000};
+    mapPriority[vHashes[1]] = {1, 5000};
+    mapPriority[vHashes[2]] = {2, 9000};
+    mapPriority[vHashes[3]] = {1, 5000};
+    mapPriority[vHashes[4]] = {3, 100};
+    // vHashes[5] is not in the "mempool"
+
+    BOOST_CHECK(queue.Push(vHashes[5]));
+    BOOST_CHECK(queue.Push(vHashes[0]));
+    BOOST_CHECK(queue.Push(vHashes[1]));
+    BOOST_CHECK(queue.Push(vHashes[4]));
+    // duplicates are ignored, no more than the maximum size waits, and nothing is sorted before Prioritize
+    BOOST_CHECK(!queue.Push(vHashes[0]));
+    BOOST_CHECK(!queue.Push(vHashes[2]));
+    uint256 hash;
+    BOOST_CHECK(!queue.Pop(hash));
+    BOOST_CHECK(queue.Contains(vHashes[5]));
+
+    // the unknown one is dropped
+    queue.Prioritize(getPriority);
+    BOOST_CHECK_EQUAL(queue.Size(), 3U);
+    BOOST_CHECK(!queue.Contains(vHashes[5]));
+
+    // and the lowest priority one beyond the maximum size
+    BOOST_CHECK(queue.Push(vHashes[2]));
+    BOOST_CHECK(queue.Push(vHashes[3]));
+    queue.Prioritize(getPriority);
+    BOOST_CHECK_EQUAL(queue.Size(), 4U);
+    BOOST_CHECK(!queue.Contains(vHashes[4]));
+
+    // fewer ancestors first, then the higher feerate, then the one which came first
+    BOOST_CHECK(queue.Pop(hash) && hash == vHashes[1]);
+    BOOST_CHECK(queue.Pop(hash) && hash == vHashes[3]);
+
+    // hashes pushed later are sorted in with the ones left
+    mapPriority[vHashes[4]] = {1, 2000};
+    BOOST_CHECK(queue.Push(vHashes[4]));
+    BOOST_CHECK(queue.Push(vHashes[1]));
+    queue.Erase(vHashes[1]);
+    queue.Prioritize(getPriority);
+    BOOST_CHECK_EQUAL(queue.Size(), 3U);
+    BOOST_CHECK(queue.Pop(hash) && hash == vHashes[4]);
+    BOOST_CHECK(queue.Pop(hash) && hash == vHashes[0]);
+    BOOST_CHECK(queue.Pop(hash) && hash == vHashes[2]);
+    BOOST_CHECK(!queue.Pop(hash));
+    BOOST_CHECK(queue.Empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
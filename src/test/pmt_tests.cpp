@@ -108,6 +108,43 @@ BOOST_AUTO_TEST_CASE(pmt_test1)
     }
 }
 
+BOOST_AUTO_TEST_CASE(pmt_merkle_levels)
+{
+    seed_insecure_rand(false);
+    for (unsigned int nTx : {1, 2, 3, 17, 100}) {
+        CBlock block;
+        for (unsigned int j = 0; j < nTx; j++) {
+            CMutableTransaction tx;
+            tx.nLockTime = j;
+            block.vtx.push_back(MakeTransactionRef(std::move(tx)));
+        }
+        std::vector<uint256> vTxid;
+        for (const auto& tx : block.vtx)
+            vTxid.push_back(tx->GetHash());
+
+        MerkleLevels vLevels = ComputeMerkleLevels(vTxid);
+        BOOST_CHECK(vLevels.front() == vTxid);
+        BOOST_CHECK_EQUAL(vLevels.back().size(), 1U);
+        BOOST_CHECK(vLevels.back()[0] == BlockMerkleRoot(block));
+
+        // the same levels serve any number of proofs, each the same as one built from the block
+        for (int att = 0; att < 4; att++) {
+            std::vector<bool> vMatch(nTx, false);
+            std::set<uint256> setTxids;
+            for (unsigned int j = 0; j < nTx; j++) {
+                if (insecure_rand() % 3 == 0) {
+                    vMatch[j] = true;
+                    setTxids.insert(vTxid[j]);
+                }
+            }
+            CDataStream ss1(SER_NETWORK, PROTOCOL_VERSION), ss2(SER_NETWORK, PROTOCOL_VERSION);
+            ss1 << CMerkleBlock(block, setTxids);
+            ss2 << CMerkleBlock(block.GetBlockHeader(), vLevels, vMatch);
+            BOOST_CHECK(ss1.str() == ss2.str());
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(pmt_malleability)
 {
     std::vector<uint256> vTxid = boost::assign::list_of
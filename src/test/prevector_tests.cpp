@@ -266,4 +266,43 @@ BOOST_AUTO_TEST_CASE(PrevectorTestInt)
     }
 }
 
+BOOST_AUTO_TEST_CASE(PrevectorBorrowTest)
+{
+    typedef prevector<8, unsigned char> pretype;
+    std::vector<unsigned char> storage(20);
+    for (size_t i = 0; i < storage.size(); i++) {
+        storage[i] = i;
+    }
+    const pretype expected(storage.begin(), storage.end());
+
+    pretype borrowed;
+    borrowed.borrow(storage.data(), storage.size());
+    BOOST_CHECK(borrowed == expected);
+    BOOST_CHECK(borrowed.data() == storage.data());
+    BOOST_CHECK_EQUAL(borrowed.capacity(), 20U);
+    BOOST_CHECK_EQUAL(borrowed.allocated_memory(), 0U);
+
+    // copies, moves and swaps never take the storage along
+    pretype copy(borrowed);
+    BOOST_CHECK(copy == expected && copy.data() != storage.data());
+    pretype moved(std::move(copy));
+    BOOST_CHECK(moved == expected && copy.empty());
+    pretype other(3, (unsigned char)9);
+    other.swap(borrowed);
+    BOOST_CHECK(other == expected && other.data() != storage.data());
+    BOOST_CHECK(borrowed == pretype(3, (unsigned char)9));
+
+    // growing moves to memory of its own and leaves the storage alone
+    pretype grown;
+    grown.borrow(storage.data(), storage.size());
+    grown.push_back(20);
+    BOOST_CHECK(grown.data() != storage.data());
+    BOOST_CHECK_EQUAL(grown.size(), 21U);
+    BOOST_CHECK_EQUAL(storage[19], 19);
+    grown.shrink_to_fit();
+    grown.resize(4);
+    grown.shrink_to_fit();
+    BOOST_CHECK(grown == pretype(storage.begin(), storage.begin() + 4));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
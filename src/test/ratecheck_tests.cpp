@@ -3,6 +3,8 @@
 // Copyright (c) 2019 The Extreme Private MasternodeCoin developers
 
 #include "governance.h"
+#include "ratelimit.h"
+#include "streams.h"
 
 #include "test/test_epmcoin.h"
 
@@ -83,4 +85,45 @@ BOOST_AUTO_TEST_CASE(ratecheck_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(window_ratelimiter_test)
+{
+    CWindowRateLimiter limiter;
+
+    // windows start with the first event and end nWindow seconds later
+    BOOST_CHECK_EQUAL(limiter.Count(1, 100), 0);
+    BOOST_CHECK_EQUAL(limiter.Add(1, 100, 10), 1);
+    BOOST_CHECK_EQUAL(limiter.Add(1, 105, 10), 2);
+    BOOST_CHECK_EQUAL(limiter.Count(1, 109), 2);
+    BOOST_CHECK_EQUAL(limiter.Count(1, 110), 0);
+    BOOST_CHECK_EQUAL(limiter.Add(1, 110, 10), 1);
+    BOOST_CHECK_EQUAL(limiter.Count(2, 110), 0);
+
+    limiter.Reset(1);
+    BOOST_CHECK_EQUAL(limiter.Count(1, 111), 0);
+
+    // grow far beyond the initial size, expired keys make room for new ones
+    for (uint64_t i = 0; i < 10000; i++) {
+        BOOST_CHECK_EQUAL(limiter.Add(i * 0x9E3779B97F4A7C15ULL, 1000 + i / 100, 5), 1);
+    }
+    BOOST_CHECK_EQUAL(limiter.Size(1099), 500);
+    for (uint64_t i = 9900; i < 10000; i++) {
+        BOOST_CHECK_EQUAL(limiter.Count(i * 0x9E3779B97F4A7C15ULL, 1099), 1);
+    }
+
+    limiter.Compact(1099);
+    BOOST_CHECK_EQUAL(limiter.Size(1099), 500);
+    BOOST_CHECK_EQUAL(limiter.Count(9999 * 0x9E3779B97F4A7C15ULL, 1099), 1);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << limiter;
+    CWindowRateLimiter limiter2;
+    ss >> limiter2;
+    BOOST_CHECK_EQUAL(limiter2.Size(1099), 500);
+    BOOST_CHECK_EQUAL(limiter2.Count(9999 * 0x9E3779B97F4A7C15ULL, 1099), 1);
+    BOOST_CHECK(limiter2.GetHasher().Write(1).Finalize() == limiter.GetHasher().Write(1).Finalize());
+
+    limiter2.Clear();
+    BOOST_CHECK_EQUAL(limiter2.Size(0), 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
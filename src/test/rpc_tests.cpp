@@ -4,6 +4,7 @@
 
 #include "rpc/server.h"
 #include "rpc/client.h"
+#include "rpc/jsonwriter.h"
 
 #include "base58.h"
 #include "netbase.h"
@@ -320,6 +321,56 @@ BOOST_AUTO_TEST_CASE(rpc_ban)
     BOOST_CHECK_EQUAL(adr.get_str(), "2001:4d48:ac57:400:cacf:e9ff:fe1d:9c63/128");
 }
 
+BOOST_AUTO_TEST_CASE(rpc_jsonwriter)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("str", std::string("quote\" backslash\\ tab\t ctrl\x01 del\x7f utf8\xc3\xa9")));
+    obj.push_back(Pair("int", -42));
+    obj.push_back(Pair("uint", (uint64_t)18446744073709551615ULL));
+    obj.push_back(Pair("float", 0.1));
+    obj.push_back(Pair("amount", ValueFromAmount(123456789)));
+    obj.push_back(Pair("bool", true));
+    obj.push_back(Pair("null", NullUniValue));
+    UniValue arr(UniValue::VARR);
+    arr.push_back(UniValue(UniValue::VOBJ));
+    arr.push_back(UniValue(UniValue::VARR));
+    arr.push_back("x");
+    obj.push_back(Pair("arr", arr));
+
+    // Written as one UniValue and element by element, with chunks much smaller than the output
+    std::string strOut;
+    {
+        CJSONWriter writer([&strOut](const char* data, size_t size) { strOut.append(data, size); }, 8);
+        writer.Value(obj);
+        writer.Flush();
+        BOOST_CHECK(writer.HasFlushed());
+    }
+    BOOST_CHECK_EQUAL(strOut, obj.write());
+
+    strOut.clear();
+    {
+        CJSONWriter writer([&strOut](const char* data, size_t size) { strOut.append(data, size); }, 8);
+        writer.BeginObject();
+        writer.Key("str").Value(obj["str"].get_str());
+        writer.Key("int").Value(-42);
+        writer.Key("uint").Value((uint64_t)18446744073709551615ULL);
+        writer.Key("float").Value(0.1);
+        writer.Key("amount").Value(ValueFromAmount(123456789));
+        writer.Key("bool").Value(true);
+        writer.Key("null").Null();
+        writer.Key("arr").BeginArray().BeginObject().EndObject().BeginArray().EndArray().Value("x").EndArray();
+        writer.EndObject();
+        writer.Flush();
+    }
+    BOOST_CHECK_EQUAL(strOut, obj.write());
+
+    // Nothing reaches the sink before a chunk is full
+    CJSONWriter writer([](const char*, size_t) { BOOST_ERROR("unexpected flush"); });
+    writer.BeginArray().Value(1).EndArray();
+    BOOST_CHECK(!writer.HasFlushed());
+    BOOST_CHECK_EQUAL(writer.GetBuffer(), "[1]");
+}
+
 #if ENABLE_MINER
 BOOST_AUTO_TEST_CASE(rpc_convert_values_generatetoaddress)
 {
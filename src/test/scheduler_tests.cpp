@@ -114,4 +114,54 @@ BOOST_AUTO_TEST_CASE(manythreads)
     BOOST_CHECK_EQUAL(counterSum, 200);
 }
 
+BOOST_AUTO_TEST_CASE(namedtasks)
+{
+    // Tasks of the same name must never overlap, and the tasks of a dedicated
+    // name must only be run by the thread servicing it
+    CScheduler scheduler;
+    boost::mutex mutex;
+    std::map<std::string, int> mapRunning;
+    bool fOverlap = false;
+    bool fWrongThread = false;
+    int nRuns = 0;
+    boost::thread::id dedicatedId;
+
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++)
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    boost::thread* dedicated = threads.create_thread(boost::bind(&CScheduler::serviceDedicated, &scheduler, std::string("heavy")));
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        dedicatedId = dedicated->get_id();
+    }
+
+    boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+    for (int i = 0; i < 200; i++) {
+        std::string strName = i % 3 == 0 ? "heavy" : i % 3 == 1 ? "a" : "";
+        scheduler.schedule([&, strName]() {
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                if (mapRunning[strName]++)
+                    fOverlap = true;
+                if ((strName == "heavy") != (boost::this_thread::get_id() == dedicatedId))
+                    fWrongThread = true;
+            }
+            MicroSleep(50);
+            boost::unique_lock<boost::mutex> lock(mutex);
+            mapRunning[strName]--;
+            nRuns++;
+        }, now + boost::chrono::milliseconds(50) + boost::chrono::microseconds(i * 10), strName);
+    }
+
+    scheduler.stop(true);
+    threads.join_all();
+
+    BOOST_CHECK(!fOverlap);
+    BOOST_CHECK(!fWrongThread);
+    BOOST_CHECK_EQUAL(nRuns, 200);
+    std::map<std::string, CScheduler::TaskStats> mapStats = scheduler.getTaskStats();
+    BOOST_CHECK_EQUAL(mapStats.size(), 3U);
+    BOOST_CHECK_EQUAL(mapStats["heavy"].nRuns, 67U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,7 @@
 #include "core_io.h"
 #include "key.h"
 #include "keystore.h"
+#include "primitives/block.h"
 #include "script/script.h"
 #include "script/script_error.h"
 #include "script/sign.h"
@@ -1178,4 +1179,63 @@ BOOST_AUTO_TEST_CASE(script_FindAndDelete)
     BOOST_CHECK(s == expect);
 }
 
+#if defined(HAVE_CONSENSUS_LIB)
+BOOST_AUTO_TEST_CASE(script_libconsensus_batch)
+{
+    std::vector<CScript> scriptPubKeys = {
+        CScript() << OP_1,
+        CScript() << OP_3 << OP_EQUAL,
+        CScript() << OP_2 << OP_EQUAL,
+    };
+    CMutableTransaction txCredit = BuildCreditingTransaction(CScript() << OP_1);
+    CMutableTransaction txSpend = BuildSpendingTransaction(CScript(), txCredit);
+    txSpend.vin.resize(scriptPubKeys.size(), txSpend.vin[0]);
+    // the second input doesn't satisfy its output
+    txSpend.vin[1].scriptSig = CScript() << OP_2;
+    txSpend.vin[2].scriptSig = CScript() << OP_2;
+
+    std::vector<const unsigned char*> spentOutputs;
+    std::vector<unsigned int> spentOutputLens;
+    for (const auto& script : scriptPubKeys) {
+        spentOutputs.push_back(script.data());
+        spentOutputLens.push_back(script.size());
+    }
+
+    CDataStream streamTx(SER_NETWORK, PROTOCOL_VERSION);
+    streamTx << txSpend;
+    for (unsigned int nThreads : {0, 1, 4}) {
+        std::vector<int> results(scriptPubKeys.size(), -1);
+        epmcoinconsensus_error err;
+        BOOST_CHECK_EQUAL(epmcoinconsensus_verify_transaction(spentOutputs.data(), spentOutputLens.data(), spentOutputs.size(), (const unsigned char*)&streamTx[0], streamTx.size(), 0, nThreads, results.data(), &err), 0);
+        BOOST_CHECK_EQUAL(err, epmcoinconsensus_ERR_OK);
+        BOOST_CHECK(results == std::vector<int>({1, 0, 1}));
+    }
+    epmcoinconsensus_error err;
+    BOOST_CHECK_EQUAL(epmcoinconsensus_verify_transaction(spentOutputs.data(), spentOutputLens.data(), 2, (const unsigned char*)&streamTx[0], streamTx.size(), 0, 1, NULL, &err), 0);
+    BOOST_CHECK_EQUAL(err, epmcoinconsensus_ERR_SPENT_OUTPUTS_MISMATCH);
+
+    // the coinbase has no spent outputs, only the inputs of the other transactions count
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(txCredit));
+    block.vtx.push_back(MakeTransactionRef(txSpend));
+    txSpend.vin[1].scriptSig = CScript() << OP_3;
+    block.vtx.push_back(MakeTransactionRef(txSpend));
+    spentOutputs.insert(spentOutputs.end(), spentOutputs.begin(), spentOutputs.end());
+    spentOutputLens.insert(spentOutputLens.end(), spentOutputLens.begin(), spentOutputLens.end());
+
+    CDataStream streamBlock(SER_NETWORK, PROTOCOL_VERSION);
+    streamBlock << block;
+    std::vector<int> results(spentOutputs.size(), -1);
+    BOOST_CHECK_EQUAL(epmcoinconsensus_verify_block(spentOutputs.data(), spentOutputLens.data(), spentOutputs.size(), (const unsigned char*)&streamBlock[0], streamBlock.size(), 0, 2, results.data(), &err), 0);
+    BOOST_CHECK_EQUAL(err, epmcoinconsensus_ERR_OK);
+    BOOST_CHECK(results == std::vector<int>({1, 0, 1, 1, 1, 1}));
+
+    block.vtx.pop_back();
+    CDataStream streamBlock2(SER_NETWORK, PROTOCOL_VERSION);
+    streamBlock2 << block;
+    BOOST_CHECK_EQUAL(epmcoinconsensus_verify_block(spentOutputs.data(), spentOutputLens.data(), 3, (const unsigned char*)&streamBlock2[0], streamBlock2.size(), 0, 2, NULL, &err), 0);
+    BOOST_CHECK_EQUAL(err, epmcoinconsensus_ERR_OK);
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -291,6 +291,88 @@ BOOST_AUTO_TEST_CASE(noncanonical)
     BOOST_CHECK_EXCEPTION(ReadCompactSize(ss), std::ios_base::failure, isCanonicalException);
 }
 
+BOOST_AUTO_TEST_CASE(runlength_bitsets)
+{
+    std::vector<std::vector<bool> > patterns;
+    patterns.emplace_back(400, false);
+    patterns.emplace_back(400, true);
+    patterns.emplace_back(400, false);
+    for (size_t i = 100; i < 300; i++) {
+        patterns.back()[i] = true;
+    }
+    patterns.emplace_back(400, false);
+    for (size_t i = 0; i < 400; i += 3) {
+        patterns.back()[i] = true;
+    }
+    patterns.emplace_back();
+
+    for (auto& v : patterns) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << AUTOBITSET_RUNLENGTH(v, v.size());
+        std::vector<bool> v2;
+        ss >> AUTOBITSET_RUNLENGTH(v2, v.size());
+        BOOST_CHECK(v == v2);
+        BOOST_CHECK(ss.empty());
+    }
+
+    // runs are chosen only if they are smaller, e.g. a fully set bitset takes 4 bytes instead of 51
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << AUTOBITSET_RUNLENGTH(patterns[1], 400);
+    BOOST_CHECK_EQUAL(ss.size(), 4U);
+    BOOST_CHECK_EQUAL(ss[0], 2);
+
+    // readers which don't support runs must reject them
+    std::vector<bool> v;
+    BOOST_CHECK_THROW(ss >> AUTOBITSET(v, 400), std::ios_base::failure);
+
+    // runs beyond the size and empty runs in the middle are invalid
+    uint32_t nUnset = 300, nSet = 101, nEmpty = 0;
+    CDataStream ssBad(SER_NETWORK, PROTOCOL_VERSION);
+    ssBad << (uint8_t)2 << VARINT(nUnset) << VARINT(nSet);
+    BOOST_CHECK_THROW(ssBad >> AUTOBITSET_RUNLENGTH(v, 400), std::ios_base::failure);
+    ssBad.clear();
+    ssBad << (uint8_t)2 << VARINT(nUnset) << VARINT(nEmpty);
+    BOOST_CHECK_THROW(ssBad >> AUTOBITSET_RUNLENGTH(v, 400), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(byte_vectors)
+{
+    static_assert(is_serialized_as_bytes<uint256>::value && is_serialized_as_bytes<uint160>::value, "blobs are bytes");
+    static_assert(!is_serialized_as_bytes<uint32_t>::value && !is_serialized_as_bytes<std::string>::value, "not bytes");
+
+    // vectors of blobs are written in one go, with the same result as one element at a time
+    std::vector<uint256> v;
+    for (int i = 0; i < 100; i++) {
+        v.push_back(GetRandHash());
+    }
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << v;
+    CDataStream ssElements(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ssElements, v.size());
+    for (const uint256& h : v) {
+        ssElements << h;
+    }
+    BOOST_CHECK(ss.str() == ssElements.str());
+
+    std::vector<unsigned char> vch(ss.begin(), ss.end());
+    CSpanReader reader(SER_NETWORK, PROTOCOL_VERSION, Span<const unsigned char>(vch.data(), vch.size()));
+    std::vector<uint256> v2;
+    reader >> v2;
+    BOOST_CHECK(v == v2);
+    BOOST_CHECK(reader.empty());
+    BOOST_CHECK_THROW(reader >> v2, std::ios_base::failure);
+
+    uint160 h;
+    h.SetHex("0102");
+    prevector<4, uint160> pv(3, h);
+    ss.clear();
+    ss << pv;
+    BOOST_CHECK_EQUAL(ss.size(), 1U + 3 * 20);
+    prevector<4, uint160> pv2;
+    ss >> pv2;
+    BOOST_CHECK(pv == pv2);
+}
+
 BOOST_AUTO_TEST_CASE(insert_delete)
 {
     // Test inserting/deleting bytes.
@@ -166,6 +166,39 @@ BOOST_AUTO_TEST_CASE(sighash_test)
     #endif
 }
 
+BOOST_AUTO_TEST_CASE(sighash_precomputed)
+{
+    // The cached hashes must match the plain serialization for every input and hash type
+    seed_insecure_rand(false);
+
+    for (int i = 0; i < 200; i++) {
+        CMutableTransaction txMut;
+        RandomTransaction(txMut, false);
+        int nExtra = insecure_rand() % 30;
+        for (int j = 0; j < nExtra; j++) {
+            CTxIn txin;
+            txin.prevout.hash = GetRandHash();
+            txin.prevout.n = insecure_rand() % 4;
+            RandomScript(txin.scriptSig);
+            txin.nSequence = (insecure_rand() % 2) ? insecure_rand() : (unsigned int)-1;
+            txMut.vin.push_back(txin);
+        }
+        const CTransaction tx(txMut);
+        PrecomputedTransactionData txdata(tx);
+        BOOST_CHECK_EQUAL(txdata.ready, tx.vin.size() >= 3);
+
+        CScript scriptCode;
+        RandomScript(scriptCode);
+        for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++) {
+            int nHashType = insecure_rand();
+            if ((nHashType & 0x1f) == SIGHASH_SINGLE && nIn >= tx.vout.size())
+                nHashType = SIGHASH_ALL;
+            BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, &txdata) == SignatureHash(scriptCode, tx, nIn, nHashType));
+            BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, SIGHASH_ALL, &txdata) == SignatureHashOld(scriptCode, tx, nIn, SIGHASH_ALL));
+        }
+    }
+}
+
 // Goal: check that SignatureHash generates correct hash
 BOOST_AUTO_TEST_CASE(sighash_from_data)
 {
@@ -143,4 +143,78 @@ BOOST_AUTO_TEST_CASE(findearliestatleast_test)
         BOOST_CHECK(vBlocksMain[r].GetAncestor(ret->nHeight) == ret);
     }
 }
+
+BOOST_AUTO_TEST_CASE(findbytimestamp_test)
+{
+    std::vector<uint256> vHashMain(10000);
+    std::vector<CBlockIndex> vBlocksMain(10000);
+    for (unsigned int i=0; i<vBlocksMain.size(); i++) {
+        vHashMain[i] = ArithToUint256(insecure_rand());
+        vBlocksMain[i].nHeight = i;
+        vBlocksMain[i].pprev = i ? &vBlocksMain[i - 1] : NULL;
+        vBlocksMain[i].phashBlock = &vHashMain[i];
+        vBlocksMain[i].BuildSkip();
+        // anything after the median time past, so timestamps are often out of order
+        int64_t medianTimePast = i ? vBlocksMain[i - 1].GetMedianTimePast() : 1500000000;
+        vBlocksMain[i].nTime = medianTimePast + 1 + insecure_rand() % 240;
+        vBlocksMain[i].nTimeMax = i ? std::max(vBlocksMain[i].nTime, vBlocksMain[i - 1].nTimeMax) : vBlocksMain[i].nTime;
+    }
+    CChain chain;
+    chain.SetTip(&vBlocksMain.back());
+
+    // Verify that FindByTimestamp returns the same as a scan of the whole chain.
+    for (unsigned int i=0; i<1000; ++i) {
+        int64_t low = vBlocksMain[insecure_rand() % vBlocksMain.size()].nTime - insecure_rand() % 100;
+        int64_t high = low + insecure_rand() % 1000;
+        std::vector<CBlockIndex*> vExpected;
+        for (auto& block : vBlocksMain) {
+            if (block.GetBlockTime() >= low && block.GetBlockTime() <= high) {
+                vExpected.push_back(&block);
+            }
+        }
+        std::sort(vExpected.begin(), vExpected.end(), [](const CBlockIndex* a, const CBlockIndex* b) {
+            return a->nTime != b->nTime ? a->nTime < b->nTime : a->GetBlockHash() < b->GetBlockHash();
+        });
+        std::vector<CBlockIndex*> vFound;
+        chain.FindByTimestamp(low, high, vFound);
+        BOOST_CHECK(vFound == vExpected);
+    }
+    std::vector<CBlockIndex*> vFound;
+    chain.FindByTimestamp(5, 4, vFound);
+    BOOST_CHECK(vFound.empty());
+}
+
+BOOST_AUTO_TEST_CASE(blockindex_arena)
+{
+    CBlockIndexArena arena;
+    BOOST_CHECK_EQUAL(arena.Size(), 0U);
+
+    const size_t nEntries = CBlockIndexArena::CHUNK_SIZE * 2 + 10;
+    std::vector<CBlockIndex*> vIndex;
+    for (size_t i = 0; i < nEntries; i++) {
+        CBlockIndex* pindex = arena.Allocate();
+        pindex->nHeight = i;
+        pindex->pprev = i ? vIndex.back() : NULL;
+        vIndex.push_back(pindex);
+    }
+    BOOST_CHECK_EQUAL(arena.Size(), nEntries);
+    BOOST_CHECK_EQUAL(arena.Chunks(), 3U);
+
+    // Entries don't move when new chunks get allocated
+    for (size_t i = 0; i < nEntries; i++) {
+        BOOST_CHECK_EQUAL(vIndex[i]->nHeight, (int)i);
+        BOOST_CHECK(vIndex[i]->pprev == (i ? vIndex[i - 1] : NULL));
+    }
+    BOOST_CHECK(vIndex[1] == vIndex[0] + 1);
+
+    CBlockHeader header;
+    header.nTime = 12345;
+    CBlockIndex* pindex = arena.Allocate(header);
+    BOOST_CHECK_EQUAL(pindex->nTime, 12345U);
+
+    arena.Clear();
+    BOOST_CHECK_EQUAL(arena.Size(), 0U);
+    BOOST_CHECK_EQUAL(arena.Chunks(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
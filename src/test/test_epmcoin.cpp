@@ -9,6 +9,7 @@
 #include "chainparams.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "hash.h"
 #include "key.h"
 #include "validation.h"
 #include "miner.h"
@@ -25,6 +26,7 @@
 
 #include "test/testutil.h"
 
+#include "bls/bls_sigcache.h"
 #include "evo/specialtx.h"
 #include "evo/deterministicmns.h"
 #include "evo/cbtx.h"
@@ -45,11 +47,14 @@ extern void noui_connect();
 
 BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
 {
+        SHA256AutoDetect();
+        X11AutoDetect();
         ECC_Start();
         BLSInit();
         SetupEnvironment();
         SetupNetworking();
         InitSignatureCache();
+        InitBLSSignatureCache();
         fPrintToDebugLog = false; // don't want to write to debug.log file
         fCheckBlockIndex = true;
         SelectParams(chainName);
@@ -81,10 +86,12 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
         g_connman = std::unique_ptr<CConnman>(new CConnman(0x1337, 0x1337)); // Deterministic randomness for tests.
         connman = g_connman.get();
         pblocktree = new CBlockTreeDB(1 << 20, true);
+        ptxindexdb = new CTxIndexDB(*pblocktree, 1 << 20, true);
         pcoinsdbview = new CCoinsViewDB(1 << 23, true);
         llmq::InitLLMQSystem(*evoDb, nullptr, true);
         pcoinsTip = new CCoinsViewCache(pcoinsdbview);
         BOOST_REQUIRE(InitBlockIndex(chainparams));
+        BOOST_REQUIRE(StartTxIndex(chainparams));
         {
             CValidationState state;
             bool ok = ActivateBestChain(state, chainparams);
@@ -106,6 +113,8 @@ TestingSetup::~TestingSetup()
         delete pcoinsTip;
         llmq::DestroyLLMQSystem();
         delete pcoinsdbview;
+        delete ptxindexdb;
+        ptxindexdb = NULL;
         delete pblocktree;
         boost::filesystem::remove_all(pathTemp);
 }
@@ -286,6 +286,41 @@ SetupDummyInputs(CBasicKeyStore& keystoreRet, CCoinsViewCache& coinsRet)
     return dummyTransactions;
 }
 
+BOOST_AUTO_TEST_CASE(script_arena_roundtrip)
+{
+    CMutableTransaction mtx;
+    for (int i = 0; i < 10; i++) {
+        mtx.vin.push_back(CTxIn(COutPoint(GetRandHash(), i), CScript() << std::vector<unsigned char>(70 + i, i) << OP_TRUE));
+        mtx.vout.push_back(CTxOut(i, CScript() << std::vector<unsigned char>(i * 5, i)));
+    }
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << mtx;
+    std::string raw = ss.str();
+
+    CTransactionRef tx;
+    ss >> tx;
+    BOOST_CHECK(!tx->GetScriptArena().Get().empty());
+    BOOST_CHECK(tx->GetHash() == mtx.GetHash());
+    for (size_t i = 0; i < mtx.vin.size(); i++) {
+        BOOST_CHECK(tx->vin[i].scriptSig == mtx.vin[i].scriptSig);
+        BOOST_CHECK(tx->vout[i].scriptPubKey == mtx.vout[i].scriptPubKey);
+    }
+
+    // copies of the transaction own their scripts and outlive it
+    CMutableTransaction copy(*tx);
+    CTxOut out = tx->vout[9];
+    tx.reset();
+    BOOST_CHECK(copy.scriptArena.Get().empty());
+    BOOST_CHECK(copy.GetHash() == mtx.GetHash());
+    BOOST_CHECK(out == mtx.vout[9]);
+
+    CDataStream ss2(raw.data(), raw.data() + raw.size(), SER_NETWORK, PROTOCOL_VERSION);
+    CMutableTransaction deserialized;
+    ss2 >> deserialized;
+    CMutableTransaction moved(std::move(deserialized));
+    BOOST_CHECK(moved.GetHash() == mtx.GetHash());
+}
+
 BOOST_AUTO_TEST_CASE(test_Get)
 {
     CBasicKeyStore keystore;
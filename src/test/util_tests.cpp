@@ -581,4 +581,24 @@ BOOST_AUTO_TEST_CASE(version_info_helper)
     BOOST_CHECK_THROW(IntVersionToString(0), std::bad_cast);
 }
 
+BOOST_AUTO_TEST_CASE(util_InitThreadAffinity)
+{
+    std::string strError;
+    // nothing configured, nothing to do
+    BOOST_CHECK(InitThreadAffinity(strError));
+
+    for (const std::string& strArg : {"bls", "bls=", "foo=0", "bls=1-0", "bls=-1", "bls=0,,1", "bls=x", "bls=nodex", "bls=1024"}) {
+        ForceSetMultiArgs("-threadaffinity", {strArg});
+        BOOST_CHECK_MESSAGE(!InitThreadAffinity(strError), strArg);
+        BOOST_CHECK(!strError.empty());
+        strError.clear();
+    }
+    ForceSetMultiArgs("-threadaffinity", {});
+
+    ForceSetArg("-reservecores", "0-");
+    BOOST_CHECK(!InitThreadAffinity(strError));
+    ForceSetArg("-reservecores", "");
+    BOOST_CHECK(InitThreadAffinity(strError));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,76 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+#include "scheduler.h"
+#include "validationinterface.h"
+
+#include "test/test_epmcoin.h"
+
+#include <thread>
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(validationinterface_tests, BasicTestingSetup)
+
+class CTipRecorder : public CValidationInterface
+{
+public:
+    bool fBackground;
+    std::vector<int> vHeights;
+    std::vector<std::thread::id> vThreads;
+
+    explicit CTipRecorder(bool fBackgroundIn) : fBackground(fBackgroundIn) {}
+
+protected:
+    int GetBackgroundCallbacks() const override { return fBackground ? BG_UPDATED_BLOCK_TIP : 0; }
+
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override
+    {
+        vHeights.push_back(pindexNew->nHeight);
+        vThreads.push_back(std::this_thread::get_id());
+    }
+};
+
+BOOST_AUTO_TEST_CASE(background_callbacks)
+{
+    CScheduler scheduler;
+    boost::thread schedulerThread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    StartBackgroundValidationCallbacks(scheduler);
+
+    CTipRecorder sync(false), background(true);
+    RegisterValidationInterface(&sync);
+    RegisterValidationInterface(&background);
+
+    std::vector<CBlockIndex> vIndexes(100);
+    for (size_t i = 0; i < vIndexes.size(); i++) {
+        vIndexes[i].nHeight = i;
+        GetMainSignals().UpdatedBlockTip(&vIndexes[i], NULL, false);
+    }
+    // delivered right away to one, in the same order on the scheduler thread to the other
+    BOOST_CHECK_EQUAL(sync.vHeights.size(), vIndexes.size());
+    SyncWithBackgroundValidationCallbacks();
+    BOOST_CHECK(background.vHeights == sync.vHeights);
+    for (size_t i = 0; i < vIndexes.size(); i++) {
+        BOOST_CHECK(sync.vThreads[i] == std::this_thread::get_id());
+        BOOST_CHECK(background.vThreads[i] != std::this_thread::get_id());
+    }
+    UnregisterValidationInterface(&background);
+    UnregisterValidationInterface(&sync);
+
+    // without the scheduler they are delivered right away again
+    StopBackgroundValidationCallbacks();
+    RegisterValidationInterface(&background);
+    GetMainSignals().UpdatedBlockTip(&vIndexes[0], NULL, false);
+    BOOST_CHECK_EQUAL(background.vHeights.size(), vIndexes.size() + 1);
+    BOOST_CHECK(background.vThreads.back() == std::this_thread::get_id());
+    UnregisterValidationInterface(&background);
+
+    scheduler.stop(true);
+    schedulerThread.join();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
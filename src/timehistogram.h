@@ -0,0 +1,45 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPMCOIN_TIMEHISTOGRAM_H
+#define EPMCOIN_TIMEHISTOGRAM_H
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+/** Power of two histogram of durations in microseconds, bucket n holds values below 2^n */
+struct CTimeHistogram {
+    static const int BUCKETS = 40;
+    uint64_t vBuckets[BUCKETS] = {};
+    uint64_t nCount = 0;
+    int64_t nTotal = 0;
+    int64_t nMax = 0;
+
+    void Add(int64_t nMicros)
+    {
+        nMicros = std::max<int64_t>(nMicros, 0);
+        int nBucket = 0;
+        while (nBucket < BUCKETS - 1 && (nMicros >> nBucket) != 0)
+            nBucket++;
+        vBuckets[nBucket]++;
+        nCount++;
+        nTotal += nMicros;
+        nMax = std::max(nMax, nMicros);
+    }
+
+    int64_t Percentile(double q) const
+    {
+        uint64_t nTarget = std::max<uint64_t>(1, std::ceil(nCount * q));
+        uint64_t nSeen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            nSeen += vBuckets[i];
+            if (nSeen >= nTarget)
+                return std::min(((int64_t)1 << i) - 1, nMax);
+        }
+        return nMax;
+    }
+};
+
+#endif // EPMCOIN_TIMEHISTOGRAM_H
@@ -0,0 +1,46 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TRACING_H
+#define BITCOIN_TRACING_H
+
+#if defined(HAVE_CONFIG_H)
+#include "config/epmcoin-config.h"
+#endif
+
+/**
+ * Static tracepoints (USDT) for eBPF tools like bpftrace, see contrib/tracing for the list of
+ * them and their arguments. They are only compiled in with --enable-usdt, and even then an
+ * unattached tracepoint is a single nop, but the arguments are still evaluated, so pass things
+ * which are at hand anyway: integers, C strings and pointers to hashes (32 bytes). Without
+ * --enable-usdt nothing is left of them.
+ *
+ * TRACEn(context, event, args...) becomes the probe context:event.
+ */
+#ifdef ENABLE_TRACING
+
+#include <sys/sdt.h>
+
+#define TRACE(context, event) DTRACE_PROBE(context, event)
+#define TRACE1(context, event, a) DTRACE_PROBE1(context, event, a)
+#define TRACE2(context, event, a, b) DTRACE_PROBE2(context, event, a, b)
+#define TRACE3(context, event, a, b, c) DTRACE_PROBE3(context, event, a, b, c)
+#define TRACE4(context, event, a, b, c, d) DTRACE_PROBE4(context, event, a, b, c, d)
+#define TRACE5(context, event, a, b, c, d, e) DTRACE_PROBE5(context, event, a, b, c, d, e)
+#define TRACE6(context, event, a, b, c, d, e, f) DTRACE_PROBE6(context, event, a, b, c, d, e, f)
+
+#else
+
+// the arguments stay type checked and count as used, but are never evaluated
+#define TRACE(context, event) do {} while (0)
+#define TRACE1(context, event, a) do { if (false) { (void)(a); } } while (0)
+#define TRACE2(context, event, a, b) do { if (false) { (void)(a); (void)(b); } } while (0)
+#define TRACE3(context, event, a, b, c) do { if (false) { (void)(a); (void)(b); (void)(c); } } while (0)
+#define TRACE4(context, event, a, b, c, d) do { if (false) { (void)(a); (void)(b); (void)(c); (void)(d); } } while (0)
+#define TRACE5(context, event, a, b, c, d, e) do { if (false) { (void)(a); (void)(b); (void)(c); (void)(d); (void)(e); } } while (0)
+#define TRACE6(context, event, a, b, c, d, e, f) do { if (false) { (void)(a); (void)(b); (void)(c); (void)(d); (void)(e); (void)(f); } } while (0)
+
+#endif // ENABLE_TRACING
+
+#endif // BITCOIN_TRACING_H
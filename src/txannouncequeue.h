@@ -0,0 +1,144 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef TXANNOUNCEQUEUE_H
+#define TXANNOUNCEQUEUE_H
+
+#include "amount.h"
+#include "saltedhasher.h"
+#include "uint256.h"
+
+#include <iterator>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * The transactions we still have to announce to a peer, in the order they are to be sent:
+ * fewest in-mempool ancestors first, so parents go before their children, then highest
+ * feerate, then the order they came in.
+ *
+ * Hashes are queued without a priority. Prioritize looks up the ones which came in since it
+ * was called last, so the mempool is only asked about each transaction once and the queue
+ * stays sorted in between, the priority being a snapshot from that time. A hash which is
+ * queued already is ignored, and beyond nMaxSize entries the lowest priority ones are
+ * dropped. Not thread safe.
+ */
+class CTxAnnounceQueue
+{
+public:
+    struct Priority {
+        uint64_t nAncestors;
+        CAmount nFeePerK;
+    };
+
+private:
+    struct Entry {
+        Priority priority;
+        uint64_t nSequence;
+        uint256 hash;
+    };
+
+    struct EntryCompare {
+        bool operator()(const Entry& a, const Entry& b) const
+        {
+            if (a.priority.nAncestors != b.priority.nAncestors) return a.priority.nAncestors < b.priority.nAncestors;
+            if (a.priority.nFeePerK != b.priority.nFeePerK) return a.priority.nFeePerK > b.priority.nFeePerK;
+            return a.nSequence < b.nSequence;
+        }
+    };
+
+    typedef std::set<Entry, EntryCompare> queue_t;
+
+    size_t nMaxSize;
+    uint64_t nSequence;
+    queue_t setQueue;
+    // not prioritized yet, may hold hashes which were erased meanwhile
+    std::vector<uint256> vPending;
+    // all queued hashes, to setQueue.end() for the pending ones
+    std::unordered_map<uint256, queue_t::iterator, SaltedHasher<uint256, SaltedHasherBase>> mapQueued;
+
+public:
+    explicit CTxAnnounceQueue(size_t nMaxSizeIn) : nMaxSize(nMaxSizeIn), nSequence(0) {}
+
+    /** Queues hash unless it's queued already or there are too many waiting for Prioritize */
+    bool Push(const uint256& hash)
+    {
+        if (vPending.size() >= nMaxSize) {
+            return false;
+        }
+        if (!mapQueued.emplace(hash, setQueue.end()).second) {
+            return false;
+        }
+        vPending.push_back(hash);
+        return true;
+    }
+
+    /**
+     * Sorts in the hashes pushed since the last call. getPriority(hash, priorityRet) returns
+     * false for a transaction which is gone already, it's dropped then.
+     */
+    template<typename Callable>
+    void Prioritize(Callable&& getPriority)
+    {
+        for (const uint256& hash : vPending) {
+            auto it = mapQueued.find(hash);
+            if (it == mapQueued.end() || it->second != setQueue.end()) {
+                continue;
+            }
+            Priority priority;
+            if (!getPriority(hash, priority)) {
+                mapQueued.erase(it);
+                continue;
+            }
+            it->second = setQueue.insert(Entry{priority, nSequence++, hash}).first;
+        }
+        vPending.clear();
+        while (setQueue.size() > nMaxSize) {
+            auto itLast = std::prev(setQueue.end());
+            mapQueued.erase(itLast->hash);
+            setQueue.erase(itLast);
+        }
+    }
+
+    /** Takes the prioritized hash which is to be sent next */
+    bool Pop(uint256& hashRet)
+    {
+        if (setQueue.empty()) {
+            return false;
+        }
+        hashRet = setQueue.begin()->hash;
+        mapQueued.erase(hashRet);
+        setQueue.erase(setQueue.begin());
+        return true;
+    }
+
+    void Erase(const uint256& hash)
+    {
+        auto it = mapQueued.find(hash);
+        if (it == mapQueued.end()) {
+            return;
+        }
+        if (it->second != setQueue.end()) {
+            setQueue.erase(it->second);
+        }
+        mapQueued.erase(it);
+    }
+
+    bool Contains(const uint256& hash) const { return mapQueued.count(hash) != 0; }
+
+    /** Number of queued hashes, prioritized or not */
+    size_t Size() const { return mapQueued.size(); }
+
+    bool Empty() const { return mapQueued.empty(); }
+
+    void Clear()
+    {
+        setQueue.clear();
+        vPending.clear();
+        mapQueued.clear();
+    }
+};
+
+#endif // TXANNOUNCEQUEUE_H
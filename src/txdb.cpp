@@ -11,9 +11,15 @@
 #include "uint256.h"
 #include "ui_interface.h"
 #include "init.h"
+#include "random.h"
+#include "streams.h"
+#include "util.h"
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <functional>
+
 #include <boost/thread.hpp>
 
 static const char DB_COIN = 'C';
@@ -24,12 +30,19 @@ static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
+static const char DB_ADDRESSBALANCE = 'A';
+static const char DB_REWARDINDEX = 'r';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_BLOCK_INDEX_SNAPSHOT = 'S';
+static const char DB_INDEX_BUILD_PROGRESS = 'I';
+static const char DB_UTXO_STATS = 'M';
+
+static const uint32_t BLOCK_INDEX_SNAPSHOT_VERSION = 1;
 
 namespace {
 
@@ -53,9 +66,73 @@ struct CoinEntry {
     }
 };
 
+void BatchSpentIndex(CDBBatch& batch, const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vect) {
+    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(std::make_pair(DB_SPENTINDEX, it->first));
+        } else {
+            batch.Write(std::make_pair(DB_SPENTINDEX, it->first), it->second);
+        }
+    }
+}
+
+void BatchAddressUnspentIndex(CDBBatch& batch, const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vect) {
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
+        } else {
+            batch.Write(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+        }
+    }
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+void BatchRewardIndex(CDBBatch& batch, const std::vector<std::pair<CRewardIndexKey, CAmount> >& vect, bool fErase) {
+    for (const auto& p : vect) {
+        if (fErase) {
+            batch.Erase(std::make_pair(DB_REWARDINDEX, p.first));
+        } else {
+            batch.Write(std::make_pair(DB_REWARDINDEX, p.first), p.second);
+        }
+    }
+}
+
+void BatchAddressIndex(CDBBatch& batch, const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect, bool fErase) {
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        if (fErase) {
+            batch.Erase(std::make_pair(DB_ADDRESSINDEX, it->first));
+        } else {
+            batch.Write(std::make_pair(DB_ADDRESSINDEX, it->first), it->second);
+        }
+    }
+}
+
+template <typename K>
+bool ErasePrefix(CDBWrapper& db, char prefix) {
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(prefix);
+
+    CDBBatch batch(db);
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, K> key;
+        if (!pcursor->GetKey(key) || key.first != prefix) {
+            break;
+        }
+        batch.Erase(key);
+        if (batch.SizeEstimate() > (1 << 24)) {
+            if (!db.WriteBatch(batch)) {
+                return false;
+            }
+            batch.Clear();
+        }
+        pcursor->Next();
+    }
+    return db.WriteBatch(batch);
+}
+
+}
+
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true, "chainstate") 
 {
 }
 
@@ -91,26 +168,220 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
         CCoinsMap::iterator itOld = it++;
         mapCoins.erase(itOld);
     }
-    if (!hashBlock.IsNull())
+    if (!hashBlock.IsNull()) {
         batch.Write(DB_BEST_BLOCK, hashBlock);
+        std::unique_ptr<CUTXOSetStats> pstats = TakePendingUTXOStats(hashBlock);
+        if (pstats)
+            batch.Write(DB_UTXO_STATS, *pstats);
+    }
 
     bool ret = db.WriteBatch(batch);
     LogPrint("coindb", "Committed %u changed transaction outputs (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
     return ret;
 }
 
+bool CCoinsViewDB::WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock, const CUTXOSetStats *pstats) {
+    CDBBatch batch(db);
+    size_t changed = 0;
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            CoinEntry entry(&it->first);
+            if (it->second.coin.IsSpent())
+                batch.Erase(entry);
+            else
+                batch.Write(entry, it->second.coin);
+            changed++;
+        }
+    }
+    if (!hashBlock.IsNull()) {
+        batch.Write(DB_BEST_BLOCK, hashBlock);
+        if (pstats && pstats->hashBlock == hashBlock)
+            batch.Write(DB_UTXO_STATS, *pstats);
+    }
+
+    bool ret = db.WriteBatch(batch);
+    LogPrint("coindb", "Committed %u changed transaction outputs (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)mapCoins.size());
+    return ret;
+}
+
+void CCoinsViewDB::SetPendingUTXOStats(const CUTXOSetStats &stats) {
+    pendingStats.reset(new CUTXOSetStats(stats));
+}
+
+std::unique_ptr<CUTXOSetStats> CCoinsViewDB::TakePendingUTXOStats(const uint256 &hashBlock) {
+    if (!pendingStats || pendingStats->hashBlock != hashBlock)
+        return nullptr;
+    return std::move(pendingStats);
+}
+
+bool CCoinsViewDB::ReadUTXOStats(CUTXOSetStats &stats) const {
+    if (!db.Read(DB_UTXO_STATS, stats))
+        return false;
+    return stats.hashBlock == GetBestBlock();
+}
+
+void CUTXOSetStats::AddCoin(const COutPoint &outpoint, const Coin &coin) {
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << outpoint << VARINT(coin.nHeight * 2 + coin.fCoinBase) << coin.out;
+    muhash.Insert((const unsigned char*)ss.data(), ss.size());
+    nTransactionOutputs++;
+    nTotalAmount += coin.out.nValue;
+}
+
+void CUTXOSetStats::RemoveCoin(const COutPoint &outpoint, const Coin &coin) {
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << outpoint << VARINT(coin.nHeight * 2 + coin.fCoinBase) << coin.out;
+    muhash.Remove((const unsigned char*)ss.data(), ss.size());
+    nTransactionOutputs--;
+    nTotalAmount -= coin.out.nValue;
+}
+
 size_t CCoinsViewDB::EstimateSize() const
 {
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+CCoinsViewBackgroundFlush::CCoinsViewBackgroundFlush(CCoinsViewDB *dbIn, bool fBackgroundIn) :
+    db(dbIn), fBackground(fBackgroundIn), nFlushingUsage(0), fFlushing(false), fLastFlushOk(true) {}
+
+CCoinsViewBackgroundFlush::~CCoinsViewBackgroundFlush() {
+    Wait();
+}
+
+bool CCoinsViewBackgroundFlush::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (pmapFlushing) {
+            CCoinsMap::const_iterator it = pmapFlushing->find(outpoint);
+            if (it != pmapFlushing->end()) {
+                coin = it->second.coin;
+                return !coin.IsSpent();
+            }
+        }
+    }
+    // Anything not in the snapshot isn't touched by the running write
+    return db->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewBackgroundFlush::HaveCoin(const COutPoint &outpoint) const {
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (pmapFlushing) {
+            CCoinsMap::const_iterator it = pmapFlushing->find(outpoint);
+            if (it != pmapFlushing->end())
+                return !it->second.coin.IsSpent();
+        }
+    }
+    return db->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestBlock() const {
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (fFlushing && !hashFlushing.IsNull())
+            return hashFlushing;
+    }
+    return db->GetBestBlock();
+}
+
+bool CCoinsViewBackgroundFlush::Wait() const {
+    if (writerThread.joinable())
+        writerThread.join();
+    std::lock_guard<std::mutex> lock(cs);
+    return fLastFlushOk;
+}
+
+bool CCoinsViewBackgroundFlush::WaitForFlush() {
+    return Wait();
+}
+
+void CCoinsViewBackgroundFlush::ThreadWrite() {
+    int64_t nStart = GetTimeMicros();
+    bool fOk = false;
+    try {
+        fOk = db->WriteCoins(*pmapFlushing, hashFlushing, pstatsFlushing.get());
+    } catch (const std::exception& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+    }
+    LogPrint("coindb", "%s: wrote %u coins in %.2fms%s\n", __func__, (unsigned int)pmapFlushing->size(), (GetTimeMicros() - nStart) * 0.001, fOk ? "" : " (failed)");
+
+    std::unique_ptr<CCoinsMap> pmapDone;
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fLastFlushOk = fOk;
+        fFlushing = false;
+        // A failed write keeps the snapshot, it is still the only place with these coins
+        if (fOk) {
+            pmapFlushing.swap(pmapDone);
+            nFlushingUsage = 0;
+        }
+    }
+}
+
+bool CCoinsViewBackgroundFlush::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    if (writerThread.joinable()) {
+        int64_t nStart = GetTimeMicros();
+        if (!Wait())
+            return false;
+        LogPrint("bench", "    - Wait for previous coins write: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
+    }
+    if (!fBackground)
+        return db->BatchWrite(mapCoins, hashBlock);
+
+    // Take the dirty entries out of the cache, everything else is already in the database
+    std::unique_ptr<CCoinsMap> pmapSnapshot(new CCoinsMap());
+    size_t nUsage = 0;
+    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            nUsage += it->second.coin.DynamicMemoryUsage();
+            pmapSnapshot->emplace(it->first, std::move(it->second));
+        }
+        it = mapCoins.erase(it);
+    }
+    nUsage += memusage::DynamicUsage(*pmapSnapshot);
+
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        pmapFlushing.swap(pmapSnapshot);
+        hashFlushing = hashBlock;
+        pstatsFlushing = db->TakePendingUTXOStats(hashBlock);
+        nFlushingUsage = nUsage;
+        fFlushing = true;
+    }
+    writerThread = std::thread(&TraceThread<std::function<void()> >, "coinsflush", std::function<void()>(std::bind(&CCoinsViewBackgroundFlush::ThreadWrite, this)));
+    return true;
+}
+
+CCoinsViewCursor *CCoinsViewBackgroundFlush::Cursor() const {
+    Wait();
+    return db->Cursor();
+}
+
+size_t CCoinsViewBackgroundFlush::EstimateSize() const {
+    return db->EstimateSize();
+}
+
+size_t CCoinsViewBackgroundFlush::DynamicMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(cs);
+    return nFlushingUsage;
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, false, "blockindex") {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
     return Read(std::make_pair(DB_BLOCK_FILES, nFile), info);
 }
 
+void CBlockTreeDB::ReadBlockFileInfos(int nLastFile, std::vector<CBlockFileInfo> &vinfo) {
+    std::vector<std::pair<char, int> > vKeys;
+    vKeys.reserve(nLastFile + 1);
+    for (int nFile = 0; nFile <= nLastFile; nFile++)
+        vKeys.push_back(std::make_pair(DB_BLOCK_FILES, nFile));
+    std::vector<bool> vFound;
+    ReadMany(vKeys, vinfo, vFound);
+}
+
 bool CBlockTreeDB::WriteReindexing(bool fReindexing) {
     if (fReindexing)
         return Write(DB_REINDEX_FLAG, '1');
@@ -128,12 +399,18 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 }
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
+{
+    return Cursor(uint256());
+}
+
+CCoinsViewCursor *CCoinsViewDB::Cursor(const uint256 &hashStart) const
 {
     CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper*>(&db)->NewIterator(), GetBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    i->pcursor->Seek(DB_COIN);
+    COutPoint start(hashStart, 0);
+    i->pcursor->Seek(CoinEntry(&start));
     // Cache key of first record
     if (i->pcursor->Valid()) {
         CoinEntry entry(&i->keyTmp.second);
@@ -190,6 +467,8 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
     }
+    // Any change to the block index makes an existing snapshot stale
+    batch.Erase(DB_BLOCK_INDEX_SNAPSHOT);
     return WriteBatch(batch, true);
 }
 
@@ -198,63 +477,278 @@ bool CBlockTreeDB::HasTxIndex(const uint256& txid) {
 }
 
 bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
-    //return Read(std::make_pair(DB_TXINDEX, txid), pos);
-	bool fResult = Read(std::make_pair(DB_TXINDEX, txid), pos);
-	if (!fResult) {
-		LogPrintf("Couldn't retrieve %s\n", txid.ToString().c_str());
-	}
-	return fResult;
+    return Read(std::make_pair(DB_TXINDEX, txid), pos);
+}
+
+bool CBlockTreeDB::ReadTxIndexEntries(const uint256 &txidFrom, size_t nMax, std::vector<std::pair<uint256, CDiskTxPos> > &vEntries) {
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_TXINDEX, txidFrom));
+    while (pcursor->Valid() && vEntries.size() < nMax) {
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != DB_TXINDEX)
+            break;
+        CDiskTxPos pos;
+        if (!pcursor->GetValue(pos))
+            return error("%s: failed to read value", __func__);
+        vEntries.emplace_back(key.second, pos);
+        pcursor->Next();
+    }
+    return true;
 }
 
-bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect) {
+bool CBlockTreeDB::EraseTxIndexEntries(const std::vector<std::pair<uint256, CDiskTxPos> > &vEntries) {
     CDBBatch batch(*this);
-    for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(std::make_pair(DB_TXINDEX, it->first), it->second);
+    for (const auto& entry : vEntries) {
+        batch.Erase(std::make_pair(DB_TXINDEX, entry.first));
+    }
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
-    return Read(std::make_pair(DB_SPENTINDEX, key), value);
+//! Legacy entries moved to the txindex database at once
+static const size_t TXINDEX_MOVE_CHUNK_SIZE = 10000;
+//! Queued blocks written to the txindex database at once
+static const size_t TXINDEX_WRITE_BLOCKS = 100;
+static const char DB_TXINDEX_SALT = 'K';
+
+CTxIndexDB::CTxIndexDB(CBlockTreeDB& blocktreeIn, size_t nCacheSize, bool fMemory, bool fWipe) :
+    CDBWrapper(GetDataDir() / "blocks" / "txindex", nCacheSize, fMemory, fWipe, false, "txindex"),
+    blocktree(blocktreeIn),
+    fLegacyEntries(true),
+    fMoveLegacyEntries(true),
+    fStop(false)
+{
+    std::pair<uint64_t, uint64_t> salt;
+    if (!Read(DB_TXINDEX_SALT, salt)) {
+        salt = std::make_pair(GetRand(std::numeric_limits<uint64_t>::max()), GetRand(std::numeric_limits<uint64_t>::max()));
+        Write(DB_TXINDEX_SALT, salt, true);
+    }
+    k0 = salt.first;
+    k1 = salt.second;
 }
 
-bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(std::make_pair(DB_SPENTINDEX, it->first));
-        } else {
-            batch.Write(std::make_pair(DB_SPENTINDEX, it->first), it->second);
+CTxIndexDB::~CTxIndexDB() {
+    Stop();
+}
+
+uint64_t CTxIndexDB::GetKey(const uint256& txid) const {
+    return SipHashUint256(k0, k1, txid);
+}
+
+bool CTxIndexDB::ReadEntries(uint64_t nKey, std::vector<Entry>& vEntries) {
+    return Read(std::make_pair(DB_TXINDEX, nKey), vEntries);
+}
+
+bool CTxIndexDB::ReadEntry(const uint256& txid, CDiskTxPos& pos) {
+    std::vector<Entry> vEntries;
+    if (!ReadEntries(GetKey(txid), vEntries))
+        return false;
+    uint32_t nCheck = GetCheck(txid);
+    for (const Entry& entry : vEntries) {
+        if (entry.nCheck == nCheck) {
+            pos = entry.pos;
+            return true;
         }
     }
-    return WriteBatch(batch);
+    return false;
 }
 
-bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
-        } else {
-            batch.Write(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+void CTxIndexDB::AddEntries(std::map<uint64_t, std::vector<Entry> >& mapBatch, const TxPositions& vPos, bool fKeepExisting) {
+    for (const auto& p : vPos) {
+        uint64_t nKey = GetKey(p.first);
+        std::map<uint64_t, std::vector<Entry> >::iterator it = mapBatch.find(nKey);
+        if (it == mapBatch.end()) {
+            it = mapBatch.emplace(nKey, std::vector<Entry>()).first;
+            ReadEntries(nKey, it->second);
+        }
+        uint32_t nCheck = GetCheck(p.first);
+        std::vector<Entry>::iterator itEntry = std::find_if(it->second.begin(), it->second.end(), [nCheck](const Entry& entry) { return entry.nCheck == nCheck; });
+        if (itEntry == it->second.end()) {
+            it->second.push_back(Entry{nCheck, p.second});
+        } else if (!fKeepExisting) {
+            itEntry->pos = p.second;
         }
     }
+}
+
+bool CTxIndexDB::WriteEntries(const std::map<uint64_t, std::vector<Entry> >& mapBatch, const uint256* phashBlock) {
+    CDBBatch batch(*this);
+    for (const auto& p : mapBatch) {
+        batch.Write(std::make_pair(DB_TXINDEX, p.first), p.second);
+    }
+    if (phashBlock)
+        batch.Write(DB_BEST_BLOCK, *phashBlock);
     return WriteBatch(batch);
 }
 
+bool CTxIndexDB::MoveLegacyEntries(bool& fMoreRet) {
+    TxPositions vEntries;
+    fMoreRet = false;
+    if (!blocktree.ReadTxIndexEntries(txidLegacyNext, TXINDEX_MOVE_CHUNK_SIZE, vEntries))
+        return false;
+    if (vEntries.empty()) {
+        if (!txidLegacyNext.IsNull())
+            LogPrintf("%s: moved the transaction index out of the block tree database\n", __func__);
+        return true;
+    }
+
+    // A transaction indexed again since then is in a newer block
+    std::map<uint64_t, std::vector<Entry> > mapBatch;
+    AddEntries(mapBatch, vEntries, true);
+    if (!WriteEntries(mapBatch, nullptr) || !blocktree.EraseTxIndexEntries(vEntries))
+        return error("%s: failed to move a chunk of the transaction index", __func__);
+    txidLegacyNext = vEntries.back().first;
+    fMoreRet = true;
+    return true;
+}
+
+void CTxIndexDB::ThreadWrite() {
+    while (true) {
+        std::vector<std::pair<uint256, TxPositions> > vBlocks;
+        bool fMoveLegacy = false;
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            cond.wait(lock, [this] { return fStop || fMoveLegacyEntries || !queue.empty(); });
+            if (queue.empty()) {
+                if (fStop)
+                    return;
+                fMoveLegacy = true;
+            }
+            while (!queue.empty() && vBlocks.size() < TXINDEX_WRITE_BLOCKS) {
+                vBlocks.emplace_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+        }
+        cond.notify_all();
+
+        try {
+            if (fMoveLegacy) {
+                // only done when there is nothing else to write
+                bool fMore;
+                bool fOk = MoveLegacyEntries(fMore);
+                std::lock_guard<std::mutex> lock(cs);
+                fMoveLegacyEntries = fMoveLegacyEntries && fOk && fMore;
+                fLegacyEntries = !fOk || fMore;
+                continue;
+            }
+
+            std::map<uint64_t, std::vector<Entry> > mapBatch;
+            for (const auto& block : vBlocks) {
+                AddEntries(mapBatch, block.second, false);
+            }
+            // StartTxIndex indexes the blocks again if this fails
+            if (!WriteEntries(mapBatch, &vBlocks.back().first))
+                LogPrintf("%s: failed to write the transaction index\n", __func__);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+            if (fMoveLegacy) {
+                std::lock_guard<std::mutex> lock(cs);
+                fMoveLegacyEntries = false;
+            }
+        }
+
+        // lookups find the transactions in the database from now on
+        std::lock_guard<std::mutex> lock(cs);
+        for (const auto& block : vBlocks) {
+            for (const auto& p : block.second) {
+                auto it = mapQueued.find(p.first);
+                if (it != mapQueued.end() && --it->second.second == 0)
+                    mapQueued.erase(it);
+            }
+        }
+    }
+}
+
+uint256 CTxIndexDB::GetBestBlock() {
+    uint256 hashBlock;
+    if (!Read(DB_BEST_BLOCK, hashBlock))
+        return uint256();
+    return hashBlock;
+}
+
+void CTxIndexDB::Start() {
+    std::lock_guard<std::mutex> lock(cs);
+    if (writerThread.joinable())
+        return;
+    fStop = false;
+    writerThread = std::thread(&TraceThread<std::function<void()> >, "txindex", std::function<void()>(std::bind(&CTxIndexDB::ThreadWrite, this)));
+}
+
+void CTxIndexDB::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fStop = true;
+        // the rest is moved after the next start
+        fMoveLegacyEntries = false;
+    }
+    cond.notify_all();
+    if (writerThread.joinable()) {
+        writerThread.join();
+    } else {
+        // blocks queued without a writer running
+        ThreadWrite();
+    }
+}
+
+void CTxIndexDB::AddBlock(const uint256& hashBlock, TxPositions&& vPos) {
+    std::unique_lock<std::mutex> lock(cs);
+    cond.wait(lock, [this] { return queue.size() < MAX_TXINDEX_QUEUED_BLOCKS || !writerThread.joinable() || fStop; });
+    for (const auto& p : vPos) {
+        std::pair<CDiskTxPos, int>& queued = mapQueued[p.first];
+        queued.first = p.second;
+        queued.second++;
+    }
+    queue.emplace_back(hashBlock, std::move(vPos));
+    lock.unlock();
+    cond.notify_all();
+}
+
+bool CTxIndexDB::HasTxIndex(const uint256& txid) {
+    CDiskTxPos pos;
+    return ReadTxIndex(txid, pos);
+}
+
+bool CTxIndexDB::ReadTxIndex(const uint256& txid, CDiskTxPos& pos) {
+    bool fLegacy;
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        auto it = mapQueued.find(txid);
+        if (it != mapQueued.end()) {
+            pos = it->second.first;
+            return true;
+        }
+        fLegacy = fLegacyEntries;
+    }
+    // the writer removes entries from mapQueued only after writing them
+    if (ReadEntry(txid, pos))
+        return true;
+    return fLegacy && blocktree.ReadTxIndex(txid, pos);
+}
+
+bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
+    return Read(std::make_pair(DB_SPENTINDEX, key), value);
+}
+
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                                           const CAddressUnspentKey* pkeyFrom, size_t nMaxEntries) {
 
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    if (pkeyFrom) {
+        pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, *pkeyFrom));
+    } else {
+        pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
 
-    while (pcursor->Valid()) {
+    size_t nEntries = 0;
+    while (pcursor->Valid() && (nMaxEntries == 0 || nEntries < nMaxEntries)) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressUnspentKey> key;
         if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
             CAddressUnspentValue nValue;
             if (pcursor->GetValue(nValue)) {
                 unspentOutputs.push_back(std::make_pair(key.second, nValue));
+                nEntries++;
                 pcursor->Next();
             } else {
                 return error("failed to get address unspent value");
@@ -267,33 +761,123 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
     return true;
 }
 
-bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(std::make_pair(DB_ADDRESSINDEX, it->first), it->second);
-    return WriteBatch(batch);
+void CBlockTreeDB::UpdateAddressBalances(CDBBatch& batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fUndo) {
+    std::map<std::pair<unsigned int, uint160>, CAddressBalanceValue> mapDeltas;
+    for (const auto& p : vect) {
+        CAddressBalanceValue& delta = mapDeltas[std::make_pair(p.first.type, p.first.hashBytes)];
+        delta.blockHeight = p.first.blockHeight;
+        delta.balance += p.second;
+        if (p.second > 0) {
+            delta.received += p.second;
+        }
+    }
+
+    for (const auto& p : mapDeltas) {
+        CAddressIndexIteratorKey key(p.first.first, p.first.second);
+        const CAddressBalanceValue& delta = p.second;
+        CAddressBalanceValue value;
+        if (!Read(std::make_pair(DB_ADDRESSBALANCE, key), value)) {
+            value.SetNull();
+        }
+
+        // The index rows of a block may be written again, e.g. when it is connected again after
+        // an unclean shutdown, so only apply a block the totals don't already reflect
+        if (!fUndo) {
+            if (value.blockHeight >= delta.blockHeight) {
+                continue;
+            }
+            value.balance += delta.balance;
+            value.received += delta.received;
+            value.blockHeight = delta.blockHeight;
+        } else {
+            if (value.blockHeight < delta.blockHeight) {
+                continue;
+            }
+            value.balance -= delta.balance;
+            value.received -= delta.received;
+            value.blockHeight = delta.blockHeight - 1;
+        }
+        batch.Write(std::make_pair(DB_ADDRESSBALANCE, key), value);
+    }
+}
+
+bool CBlockTreeDB::ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value) {
+    if (!Read(std::make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(type, addressHash)), value)) {
+        // never seen addresses simply have no balance
+        value.SetNull();
+    }
+    return true;
 }
 
-bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
+bool CBlockTreeDB::RebuildAddressBalanceIndex() {
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(DB_ADDRESSINDEX);
+
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Erase(std::make_pair(DB_ADDRESSINDEX, it->first));
+    CAddressIndexIteratorKey curKey;
+    CAddressBalanceValue curValue;
+    size_t nAddresses = 0;
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX) {
+            break;
+        }
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue)) {
+            return error("failed to get address index value");
+        }
+
+        // rows are sorted by address, so all deltas of an address are next to each other
+        if (key.second.type != curKey.type || key.second.hashBytes != curKey.hashBytes) {
+            if (curValue.blockHeight != -1) {
+                batch.Write(std::make_pair(DB_ADDRESSBALANCE, curKey), curValue);
+                nAddresses++;
+            }
+            if (batch.SizeEstimate() > (1 << 24)) {
+                if (!WriteBatch(batch)) {
+                    return false;
+                }
+                batch.Clear();
+            }
+            curKey = CAddressIndexIteratorKey(key.second.type, key.second.hashBytes);
+            curValue.SetNull();
+        }
+
+        curValue.balance += nValue;
+        if (nValue > 0) {
+            curValue.received += nValue;
+        }
+        curValue.blockHeight = std::max(curValue.blockHeight, key.second.blockHeight);
+        pcursor->Next();
+    }
+    if (curValue.blockHeight != -1) {
+        batch.Write(std::make_pair(DB_ADDRESSBALANCE, curKey), curValue);
+        nAddresses++;
+    }
+
+    LogPrintf("%s: built balances of %d addresses\n", __func__, nAddresses);
     return WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
+                                    int start, int end,
+                                    const CAddressIndexKey* pkeyFrom, size_t nMaxEntries) {
 
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
-    if (start > 0 && end > 0) {
+    if (pkeyFrom) {
+        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, *pkeyFrom));
+    } else if (start > 0 && end > 0) {
         pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
     } else {
         pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
     }
 
-    while (pcursor->Valid()) {
+    size_t nEntries = 0;
+    while (pcursor->Valid() && (nMaxEntries == 0 || nEntries < nMaxEntries)) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressIndexKey> key;
         if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
@@ -303,6 +887,7 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
             CAmount nValue;
             if (pcursor->GetValue(nValue)) {
                 addressIndex.push_back(std::make_pair(key.second, nValue));
+                nEntries++;
                 pcursor->Next();
             } else {
                 return error("failed to get address index value");
@@ -315,9 +900,60 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
-bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
+bool CBlockTreeDB::ReadRewardIndex(uint160 addressHash, int type,
+                                   std::vector<std::pair<CRewardIndexKey, CAmount> > &rewardIndex,
+                                   int start, int end,
+                                   const CRewardIndexKey* pkeyFrom, size_t nMaxEntries) {
+
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    // the keys start like the address index ones, so the same iterator keys find the first one
+    if (pkeyFrom) {
+        pcursor->Seek(std::make_pair(DB_REWARDINDEX, *pkeyFrom));
+    } else if (start > 0) {
+        pcursor->Seek(std::make_pair(DB_REWARDINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
+    } else {
+        pcursor->Seek(std::make_pair(DB_REWARDINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
+
+    size_t nEntries = 0;
+    while (pcursor->Valid() && (nMaxEntries == 0 || nEntries < nMaxEntries)) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CRewardIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_REWARDINDEX && key.second.hashBytes == addressHash && (int)key.second.type == type) {
+            if (end > 0 && key.second.blockHeight > end) {
+                break;
+            }
+            CAmount nValue;
+            if (pcursor->GetValue(nValue)) {
+                rewardIndex.push_back(std::make_pair(key.second, nValue));
+                nEntries++;
+                pcursor->Next();
+            } else {
+                return error("failed to get reward index value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CBlockTreeDB::WriteBlockIndexes(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vAddressIndex, bool fErase,
+                                     const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vAddressUnspentIndex,
+                                     const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > &vSpentIndex,
+                                     const std::vector<std::pair<CRewardIndexKey, CAmount> > &vRewardIndex,
+                                     const CTimestampIndexKey* pTimestampIndex) {
     CDBBatch batch(*this);
-    batch.Write(std::make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
+    BatchAddressIndex(batch, vAddressIndex, fErase);
+    UpdateAddressBalances(batch, vAddressIndex, fErase);
+    BatchAddressUnspentIndex(batch, vAddressUnspentIndex);
+    BatchSpentIndex(batch, vSpentIndex);
+    BatchRewardIndex(batch, vRewardIndex, fErase);
+    if (pTimestampIndex) {
+        batch.Write(std::make_pair(DB_TIMESTAMPINDEX, *pTimestampIndex), 0);
+    }
     return WriteBatch(batch);
 }
 
@@ -341,6 +977,38 @@ bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned i
     return true;
 }
 
+bool CBlockTreeDB::WriteIndexBuildProgress(const uint256 &hashBlock, bool fAddressIndex, bool fSpentIndex) {
+    return Write(DB_INDEX_BUILD_PROGRESS, std::make_pair(hashBlock, std::make_pair(fAddressIndex, fSpentIndex)));
+}
+
+bool CBlockTreeDB::ReadIndexBuildProgress(uint256 &hashBlock, bool &fAddressIndex, bool &fSpentIndex) {
+    std::pair<uint256, std::pair<bool, bool> > progress;
+    if (!Read(DB_INDEX_BUILD_PROGRESS, progress))
+        return false;
+    hashBlock = progress.first;
+    fAddressIndex = progress.second.first;
+    fSpentIndex = progress.second.second;
+    return true;
+}
+
+bool CBlockTreeDB::EraseIndexBuildProgress() {
+    return Erase(DB_INDEX_BUILD_PROGRESS);
+}
+
+bool CBlockTreeDB::WipeIndexes(bool fAddressIndex, bool fSpentIndex) {
+    if (fAddressIndex) {
+        if (!ErasePrefix<CAddressIndexKey>(*this, DB_ADDRESSINDEX) ||
+            !ErasePrefix<CAddressUnspentKey>(*this, DB_ADDRESSUNSPENTINDEX) ||
+            !ErasePrefix<CAddressIndexIteratorKey>(*this, DB_ADDRESSBALANCE))
+            return false;
+    }
+    if (fSpentIndex) {
+        if (!ErasePrefix<CSpentIndexKey>(*this, DB_SPENTINDEX))
+            return false;
+    }
+    return true;
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -353,6 +1021,35 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
+static CBlockIndex* InsertDiskBlockIndex(const CDiskBlockIndex& diskindex, const boost::function<CBlockIndex*(const uint256&)>& insertBlockIndex)
+{
+    // Construct block index object
+    CBlockIndex* pindexNew      = insertBlockIndex(diskindex.GetBlockHash());
+    pindexNew->pprev            = insertBlockIndex(diskindex.hashPrev);
+    pindexNew->nHeight          = diskindex.nHeight;
+    pindexNew->nFile            = diskindex.nFile;
+    pindexNew->nDataPos         = diskindex.nDataPos;
+    pindexNew->nUndoPos         = diskindex.nUndoPos;
+    pindexNew->nVersion         = diskindex.nVersion;
+    pindexNew->hashMerkleRoot   = diskindex.hashMerkleRoot;
+    pindexNew->nTime            = diskindex.nTime;
+    pindexNew->nBits            = diskindex.nBits;
+    pindexNew->nNonce           = diskindex.nNonce;
+    pindexNew->nStatus          = diskindex.nStatus;
+    pindexNew->nTx              = diskindex.nTx;
+
+    //Proof Of Stake
+    pindexNew->nMint            = diskindex.nMint;
+    pindexNew->nMoneySupply     = diskindex.nMoneySupply;
+    pindexNew->nFlags           = diskindex.nFlags;
+    pindexNew->nStakeModifier   = diskindex.nStakeModifier;
+    pindexNew->prevoutStake     = diskindex.prevoutStake;
+    pindexNew->nStakeTime       = diskindex.nStakeTime;
+    pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
+
+    return pindexNew;
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex)
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
@@ -366,29 +1063,7 @@ bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256
         if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
             CDiskBlockIndex diskindex;
             if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew      = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev            = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight          = diskindex.nHeight;
-                pindexNew->nFile            = diskindex.nFile;
-                pindexNew->nDataPos         = diskindex.nDataPos;
-                pindexNew->nUndoPos         = diskindex.nUndoPos;
-                pindexNew->nVersion         = diskindex.nVersion;
-                pindexNew->hashMerkleRoot   = diskindex.hashMerkleRoot;
-                pindexNew->nTime            = diskindex.nTime;
-                pindexNew->nBits            = diskindex.nBits;
-                pindexNew->nNonce           = diskindex.nNonce;
-                pindexNew->nStatus          = diskindex.nStatus;
-                pindexNew->nTx              = diskindex.nTx;
-
-                //Proof Of Stake
-                pindexNew->nMint            = diskindex.nMint;
-                pindexNew->nMoneySupply     = diskindex.nMoneySupply;
-                pindexNew->nFlags           = diskindex.nFlags;
-                pindexNew->nStakeModifier   = diskindex.nStakeModifier;
-                pindexNew->prevoutStake     = diskindex.prevoutStake;
-                pindexNew->nStakeTime       = diskindex.nStakeTime;
-                pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
+                CBlockIndex* pindexNew = InsertDiskBlockIndex(diskindex, insertBlockIndex);
 
                 if (pindexNew->nNonce != uint32_t(0) &&
                     !CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits, Params().GetConsensus()))
@@ -406,6 +1081,114 @@ bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256
     return true;
 }
 
+bool CBlockTreeDB::WriteBlockIndexSnapshot(const boost::filesystem::path& path, const uint256& hashBestChain, const std::vector<const CBlockIndex*>& vIndex)
+{
+    int nLastFile = 0;
+    CBlockFileInfo infoLastFile;
+    ReadLastBlockFile(nLastFile);
+    ReadBlockFileInfo(nLastFile, infoLastFile);
+
+    uint256 nonce = GetRandHash();
+    boost::filesystem::path pathTmp = path;
+    pathTmp += ".new";
+    FILE* filestr = fopen(pathTmp.string().c_str(), "wb");
+    if (!filestr)
+        return error("%s: failed to open %s", __func__, pathTmp.string());
+
+    try {
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+        CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+        hasher << BLOCK_INDEX_SNAPSHOT_VERSION << nonce << hashBestChain << nLastFile << infoLastFile << (uint64_t)vIndex.size();
+        file << BLOCK_INDEX_SNAPSHOT_VERSION << nonce << hashBestChain << nLastFile << infoLastFile << (uint64_t)vIndex.size();
+        for (const CBlockIndex* pindex : vIndex) {
+            CDiskBlockIndex diskindex(pindex);
+            hasher << diskindex;
+            file << diskindex;
+        }
+        file << hasher.GetHash();
+        FileCommit(file.Get());
+        file.fclose();
+    } catch (const std::exception& e) {
+        return error("%s: failed to write %s: %s", __func__, pathTmp.string(), e.what());
+    }
+    if (!RenameOver(pathTmp, path))
+        return error("%s: failed to rename %s", __func__, pathTmp.string());
+
+    // Only now the snapshot matches the database
+    return Write(DB_BLOCK_INDEX_SNAPSHOT, nonce, true);
+}
+
+bool CBlockTreeDB::LoadBlockIndexSnapshot(const boost::filesystem::path& path, const uint256& hashBestChain, boost::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+{
+    uint256 nonce;
+    if (!Read(DB_BLOCK_INDEX_SNAPSHOT, nonce))
+        return false;
+    // A snapshot is good for one start only, the block index changes right after it
+    if (!Erase(DB_BLOCK_INDEX_SNAPSHOT, true))
+        return false;
+
+    FILE* filestr = fopen(path.string().c_str(), "rb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("%s: failed to open %s, loading the block index from the database\n", __func__, path.string());
+        return false;
+    }
+
+    int nLastFile = 0;
+    CBlockFileInfo infoLastFile;
+    ReadLastBlockFile(nLastFile);
+    ReadBlockFileInfo(nLastFile, infoLastFile);
+
+    std::vector<CDiskBlockIndex> vDiskIndex;
+    try {
+        CHashVerifier<CAutoFile> verifier(&file);
+        uint32_t nVersion;
+        uint256 nonceFile, hashBestChainFile;
+        int nLastFileFile;
+        CBlockFileInfo infoLastFileFile;
+        uint64_t nCount;
+        verifier >> nVersion;
+        if (nVersion != BLOCK_INDEX_SNAPSHOT_VERSION) {
+            LogPrintf("%s: unknown snapshot version %d, loading the block index from the database\n", __func__, nVersion);
+            return false;
+        }
+        verifier >> nonceFile >> hashBestChainFile >> nLastFileFile >> infoLastFileFile >> nCount;
+        if (nonceFile != nonce || hashBestChainFile != hashBestChain || nLastFileFile != nLastFile ||
+                SerializeHash(infoLastFileFile) != SerializeHash(infoLastFile)) {
+            LogPrintf("%s: snapshot is stale, loading the block index from the database\n", __func__);
+            return false;
+        }
+
+        vDiskIndex.reserve(std::min<uint64_t>(nCount, 1 << 20));
+        for (uint64_t i = 0; i < nCount; i++) {
+            boost::this_thread::interruption_point();
+            vDiskIndex.emplace_back();
+            CDiskBlockIndex& diskindex = vDiskIndex.back();
+            verifier >> diskindex;
+            if (diskindex.nNonce != uint32_t(0) &&
+                !CheckProofOfWork(diskindex.GetBlockHash(), diskindex.nBits, Params().GetConsensus()))
+                return error("%s: CheckProofOfWork failed: %s", __func__, diskindex.ToString());
+        }
+
+        uint256 hashChecksum;
+        uint256 hashComputed = verifier.GetHash();
+        file >> hashChecksum;
+        if (hashChecksum != hashComputed) {
+            LogPrintf("%s: snapshot checksum mismatch, loading the block index from the database\n", __func__);
+            return false;
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("%s: failed to read snapshot: %s, loading the block index from the database\n", __func__, e.what());
+        return false;
+    }
+
+    // Nothing was inserted until the whole snapshot checked out
+    for (const CDiskBlockIndex& diskindex : vDiskIndex)
+        InsertDiskBlockIndex(diskindex, insertBlockIndex);
+
+    return true;
+}
+
 namespace {
 
 //! Legacy class to deserialize pre-pertxout database entries without reindex.
@@ -7,15 +7,25 @@
 #define BITCOIN_TXDB_H
 
 #include "coins.h"
+#include "crypto/muhash.h"
 #include "dbwrapper.h"
 #include "chain.h"
+#include "rewardindex.h"
+#include "saltedhasher.h"
 #include "spentindex.h"
 
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include <boost/filesystem/path.hpp>
 #include <boost/function.hpp>
 
 class CBlockIndex;
@@ -40,6 +50,10 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! -backgroundflush default
+static const bool DEFAULT_BACKGROUND_FLUSH = false;
+//! Blocks ConnectBlock may queue for the txindex writer before it waits for it
+static const size_t MAX_TXINDEX_QUEUED_BLOCKS = 1000;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -66,11 +80,41 @@ struct CDiskTxPos : public CDiskBlockPos
     }
 };
 
+/**
+ * Running totals of the UTXO set as of hashBlock, updated with every connected and
+ * disconnected block so gettxoutsetinfo doesn't have to read the whole chainstate.
+ * The muhash covers every coin as (outpoint, height * 2 + coinbase, txout).
+ */
+struct CUTXOSetStats
+{
+    uint256 hashBlock;
+    uint64_t nTransactionOutputs;
+    CAmount nTotalAmount;
+    MuHash3072 muhash;
+
+    CUTXOSetStats() : nTransactionOutputs(0), nTotalAmount(0) {}
+
+    void AddCoin(const COutPoint &outpoint, const Coin &coin);
+    void RemoveCoin(const COutPoint &outpoint, const Coin &coin);
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hashBlock);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nTotalAmount);
+        READWRITE(muhash);
+    }
+};
+
 /** CCoinsView backed by the coin database (chainstate/) */
 class CCoinsViewDB : public CCoinsView
 {
 protected:
     CDBWrapper db;
+    //! Stats to write with the coins of their block, see SetPendingUTXOStats (protected by cs_main)
+    std::unique_ptr<CUTXOSetStats> pendingStats;
 public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -81,11 +125,69 @@ public:
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
 
+    //! Like BatchWrite, but leaves mapCoins untouched so others can keep reading it
+    bool WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock, const CUTXOSetStats *pstats = nullptr);
+    //! Cursor starting at the first coin of the given txid rather than at the first coin
+    CCoinsViewCursor *Cursor(const uint256 &hashStart) const;
+
+    //! Write these stats along with the coins when the best block is flushed next
+    void SetPendingUTXOStats(const CUTXOSetStats &stats);
+    //! The pending stats, if they belong to hashBlock
+    std::unique_ptr<CUTXOSetStats> TakePendingUTXOStats(const uint256 &hashBlock);
+    //! The stats written with the best block, false if there are none for it
+    bool ReadUTXOStats(CUTXOSetStats &stats) const;
+
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
 };
 
+/**
+ * CCoinsView between the coins cache and CCoinsViewDB that writes flushed coins in the
+ * background. With fBackground set, BatchWrite only moves the dirty entries into a snapshot
+ * and hands it to a writer thread, and until the database has them reads are answered from
+ * the snapshot. Only one write runs at a time: the next BatchWrite, WaitForFlush or Cursor
+ * waits for it first, and a failed write is reported by the next BatchWrite or WaitForFlush.
+ * The best block is written in the same batch as the coins, so the database never claims a
+ * block whose coins it doesn't have. Reads are thread safe, the rest is for the thread
+ * holding cs_main.
+ */
+class CCoinsViewBackgroundFlush : public CCoinsView
+{
+private:
+    CCoinsViewDB *db;
+    const bool fBackground;
+
+    mutable std::mutex cs;
+    //! Coins being written, only changed by the thread calling BatchWrite while no write runs
+    std::unique_ptr<CCoinsMap> pmapFlushing;
+    uint256 hashFlushing;
+    std::unique_ptr<CUTXOSetStats> pstatsFlushing;
+    size_t nFlushingUsage;
+    bool fFlushing;
+    bool fLastFlushOk;
+    mutable std::thread writerThread;
+
+    void ThreadWrite();
+    bool Wait() const;
+
+public:
+    CCoinsViewBackgroundFlush(CCoinsViewDB *dbIn, bool fBackgroundIn);
+    ~CCoinsViewBackgroundFlush();
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    uint256 GetBestBlock() const override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    CCoinsViewCursor *Cursor() const override;
+    size_t EstimateSize() const override;
+
+    //! Wait until the database has everything written so far, returns false if a write failed
+    bool WaitForFlush();
+    //! Memory held by the coins still being written
+    size_t DynamicMemoryUsage() const;
+};
+
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
 class CCoinsViewDBCursor: public CCoinsViewCursor
 {
@@ -119,27 +221,135 @@ private:
 public:
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &fileinfo);
+    /** Read the info of all files 0..nLastFile in one pass, missing ones are left null */
+    void ReadBlockFileInfos(int nLastFile, std::vector<CBlockFileInfo> &vinfo);
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindex);
     bool ReadReindexing(bool &fReindex);
+    /** Entries of the txindex written here by older versions, CTxIndexDB moves them to its own database */
     bool HasTxIndex(const uint256 &txid);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
-    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
+    /** Up to nMax txindex entries starting at (and including) txidFrom */
+    bool ReadTxIndexEntries(const uint256 &txidFrom, size_t nMax, std::vector<std::pair<uint256, CDiskTxPos> > &vEntries);
+    bool EraseTxIndexEntries(const std::vector<std::pair<uint256, CDiskTxPos> > &vEntries);
     bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
-    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
-    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
+    /** pkeyFrom resumes reading at (and including) that key, nMaxEntries limits the number of entries read */
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
-    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
+                                 const CAddressUnspentKey* pkeyFrom = nullptr, size_t nMaxEntries = 0);
+    /** pkeyFrom resumes reading at (and including) that key, nMaxEntries limits the number of entries read */
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                          int start = 0, int end = 0);
-    bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
+                          int start = 0, int end = 0,
+                          const CAddressIndexKey* pkeyFrom = nullptr, size_t nMaxEntries = 0);
+    bool ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value);
+    /** Build the address balances from the address index, for databases created before they existed */
+    bool RebuildAddressBalanceIndex();
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
+    /** pkeyFrom resumes reading at (and including) that key, nMaxEntries limits the number of entries read */
+    bool ReadRewardIndex(uint160 addressHash, int type,
+                         std::vector<std::pair<CRewardIndexKey, CAmount> > &rewardIndex,
+                         int start = 0, int end = 0,
+                         const CRewardIndexKey* pkeyFrom = nullptr, size_t nMaxEntries = 0);
+    /** Write all index changes of a connected (or with fErase, disconnected) block in a single batch */
+    bool WriteBlockIndexes(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vAddressIndex, bool fErase,
+                           const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vAddressUnspentIndex,
+                           const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > &vSpentIndex,
+                           const std::vector<std::pair<CRewardIndexKey, CAmount> > &vRewardIndex,
+                           const CTimestampIndexKey* pTimestampIndex);
+    /** Where a background build of the address and spent indexes got to, see ThreadBuildIndexes */
+    bool WriteIndexBuildProgress(const uint256 &hashBlock, bool fAddressIndex, bool fSpentIndex);
+    bool ReadIndexBuildProgress(uint256 &hashBlock, bool &fAddressIndex, bool &fSpentIndex);
+    bool EraseIndexBuildProgress();
+    /** Remove all rows of the address (including balances) and/or spent indexes */
+    bool WipeIndexes(bool fAddressIndex, bool fSpentIndex);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+
+    /** Write all of vIndex to a flat file that LoadBlockIndexSnapshot can read back instead of
+     * iterating the database. It is only valid until the next block index write. */
+    bool WriteBlockIndexSnapshot(const boost::filesystem::path& path, const uint256& hashBestChain, const std::vector<const CBlockIndex*>& vIndex);
+    /** Load the block index from a snapshot, returns false without touching it if the snapshot
+     * is missing, stale or corrupt, in which case use LoadBlockIndexGuts */
+    bool LoadBlockIndexSnapshot(const boost::filesystem::path& path, const uint256& hashBestChain, boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+
+private:
+    /** Add (or with fUndo remove) the deltas of a single block to the address balances */
+    void UpdateAddressBalances(CDBBatch& batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fUndo);
+};
+
+/**
+ * The transaction index (blocks/txindex/), in a database of its own so its lookups don't compete
+ * with the rest of the block tree for the block cache. Keys are 64 bit SipHashes of the txids under
+ * a salt stored in the database, a value lists (next 32 bits of the txid, position) for all txids
+ * with that key.
+ *
+ * ConnectBlock only queues the positions of a block's transactions, a thread writes them out
+ * together with the hash of the last block written, so whatever a crash loses is indexed again on
+ * startup (see StartTxIndex). Queued transactions are found by lookups as well. Entries which older
+ * versions wrote to the block tree database are moved over by the same thread when it is idle, and
+ * looked up there until then.
+ */
+class CTxIndexDB : public CDBWrapper
+{
+private:
+    struct Entry
+    {
+        uint32_t nCheck;
+        CDiskTxPos pos;
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action) {
+            READWRITE(nCheck);
+            READWRITE(pos);
+        }
+    };
+    typedef std::vector<std::pair<uint256, CDiskTxPos> > TxPositions;
+
+    CBlockTreeDB& blocktree;
+    uint64_t k0, k1;
+
+    std::mutex cs;
+    std::condition_variable cond;
+    //! Blocks waiting to be written, in the order they were connected
+    std::deque<std::pair<uint256, TxPositions> > queue;
+    //! Latest position of every queued transaction and the number of queued blocks with it
+    std::unordered_map<uint256, std::pair<CDiskTxPos, int>, StaticSaltedHasher> mapQueued;
+    //! Whether lookups have to check the block tree database, and whether the writer moves entries from it
+    bool fLegacyEntries;
+    bool fMoveLegacyEntries;
+    //! Where moving the legacy entries continues
+    uint256 txidLegacyNext;
+    bool fStop;
+    std::thread writerThread;
+
+    uint64_t GetKey(const uint256& txid) const;
+    static uint32_t GetCheck(const uint256& txid) { return ReadLE32(txid.begin() + 8); }
+    bool ReadEntries(uint64_t nKey, std::vector<Entry>& vEntries);
+    bool ReadEntry(const uint256& txid, CDiskTxPos& pos);
+    //! Adds the positions to the lists of their keys in mapBatch, read from the database first
+    void AddEntries(std::map<uint64_t, std::vector<Entry> >& mapBatch, const TxPositions& vPos, bool fKeepExisting);
+    bool WriteEntries(const std::map<uint64_t, std::vector<Entry> >& mapBatch, const uint256* phashBlock);
+    //! Moves a chunk of legacy entries over, fMoreRet is false when there are none left
+    bool MoveLegacyEntries(bool& fMoreRet);
+    void ThreadWrite();
+
+public:
+    CTxIndexDB(CBlockTreeDB& blocktreeIn, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CTxIndexDB();
+
+    /** The last block whose transactions were written, null for a new database */
+    uint256 GetBestBlock();
+    void Start();
+    /** Writes everything queued and stops the writer */
+    void Stop();
+    /** Queues the positions of the transactions of a connected block, vPos may be empty */
+    void AddBlock(const uint256& hashBlock, TxPositions&& vPos);
+    bool HasTxIndex(const uint256& txid);
+    bool ReadTxIndex(const uint256& txid, CDiskTxPos& pos);
 };
 
 #endif // BITCOIN_TXDB_H
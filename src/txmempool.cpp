@@ -18,6 +18,7 @@
 #include "util.h"
 #include "utilmoneystr.h"
 #include "utiltime.h"
+#include "validationinterface.h"
 #include "version.h"
 #include "hash.h"
 
@@ -64,18 +65,39 @@ void CTxMemPoolEntry::UpdateLockPoints(const LockPoints& lp)
     lockPoints = lp;
 }
 
+CTxMemPool::EpochGuard::EpochGuard(const CTxMemPool& in) : pool(in)
+{
+    AssertLockHeld(pool.cs);
+    assert(!pool.m_has_epoch_guard);
+    ++pool.m_epoch;
+    pool.m_has_epoch_guard = true;
+}
+
+CTxMemPool::EpochGuard::~EpochGuard()
+{
+    // so that entries marked during this traversal count as unseen in the next one
+    ++pool.m_epoch;
+    pool.m_has_epoch_guard = false;
+}
+
 // Update the given tx for any in-mempool descendants.
 // Assumes that setMemPoolChildren is correct for the given tx and all
 // descendants.
 void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap &cachedDescendants, const std::set<uint256> &setExclude)
 {
-    setEntries stageEntries, setAllDescendants;
-    stageEntries = GetMemPoolChildren(updateIt);
+    setEntries setAllDescendants;
+    {
+    const EpochGuard epoch(*this);
+    std::vector<txiter> stageEntries;
+    BOOST_FOREACH(const txiter childEntry, GetMemPoolChildren(updateIt)) {
+        if (!visited(childEntry))
+            stageEntries.push_back(childEntry);
+    }
 
     while (!stageEntries.empty()) {
-        const txiter cit = *stageEntries.begin();
+        const txiter cit = stageEntries.back();
+        stageEntries.pop_back();
         setAllDescendants.insert(cit);
-        stageEntries.erase(cit);
         const setEntries &setChildren = GetMemPoolChildren(cit);
         BOOST_FOREACH(const txiter childEntry, setChildren) {
             cacheMap::iterator cacheIt = cachedDescendants.find(childEntry);
@@ -85,12 +107,13 @@ void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap &cachedDescendan
                 BOOST_FOREACH(const txiter cacheEntry, cacheIt->second) {
                     setAllDescendants.insert(cacheEntry);
                 }
-            } else if (!setAllDescendants.count(childEntry)) {
+            } else if (!setAllDescendants.count(childEntry) && !visited(childEntry)) {
                 // Schedule for later processing
-                stageEntries.insert(childEntry);
+                stageEntries.push_back(childEntry);
             }
         }
     }
+    }
     // setAllDescendants now contains all in-mempool descendants of updateIt.
     // Update and add to cached descendant map
     int64_t modifySize = 0;
@@ -161,7 +184,9 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
 {
     LOCK(cs);
 
-    setEntries parentHashes;
+    const EpochGuard epoch(*this);
+    // The ancestors found but not walked yet, every entry is staged only once
+    std::vector<txiter> stage;
     const CTransaction &tx = entry.GetTx();
 
     if (fSearchForParents) {
@@ -170,9 +195,9 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // iterate mapTx to find parents.
         for (unsigned int i = 0; i < tx.vin.size(); i++) {
             txiter piter = mapTx.find(tx.vin[i].prevout.hash);
-            if (piter != mapTx.end()) {
-                parentHashes.insert(piter);
-                if (parentHashes.size() + 1 > limitAncestorCount) {
+            if (piter != mapTx.end() && !visited(piter)) {
+                stage.push_back(piter);
+                if (stage.size() + 1 > limitAncestorCount) {
                     errString = strprintf("too many unconfirmed parents [limit: %u]", limitAncestorCount);
                     return false;
                 }
@@ -182,16 +207,19 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // If we're not searching for parents, we require this to be an
         // entry in the mempool already.
         txiter it = mapTx.iterator_to(entry);
-        parentHashes = GetMemPoolParents(it);
+        BOOST_FOREACH(const txiter &piter, GetMemPoolParents(it)) {
+            if (!visited(piter))
+                stage.push_back(piter);
+        }
     }
 
     size_t totalSizeWithAncestors = entry.GetTxSize();
 
-    while (!parentHashes.empty()) {
-        txiter stageit = *parentHashes.begin();
+    while (!stage.empty()) {
+        txiter stageit = stage.back();
+        stage.pop_back();
 
         setAncestors.insert(stageit);
-        parentHashes.erase(stageit);
         totalSizeWithAncestors += stageit->GetTxSize();
 
         if (stageit->GetSizeWithDescendants() + entry.GetTxSize() > limitDescendantSize) {
@@ -207,11 +235,12 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
 
         const setEntries & setMemPoolParents = GetMemPoolParents(stageit);
         BOOST_FOREACH(const txiter &phash, setMemPoolParents) {
-            // If this is a new ancestor, add it.
-            if (setAncestors.count(phash) == 0) {
-                parentHashes.insert(phash);
+            // If this is a new ancestor, add it. Entries of setAncestors from before the
+            // call are not marked, those are skipped by the insert above.
+            if (!visited(phash) && !setAncestors.count(phash)) {
+                stage.push_back(phash);
             }
-            if (parentHashes.size() + setAncestors.size() + 1 > limitAncestorCount) {
+            if (stage.size() + setAncestors.size() + 1 > limitAncestorCount) {
                 errString = strprintf("too many unconfirmed ancestors [limit: %u]", limitAncestorCount);
                 return false;
             }
@@ -282,6 +311,12 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
             }
         }
     }
+    struct DescendantStateUpdate {
+        int64_t nSize = 0;
+        CAmount nFee = 0;
+        int64_t nCount = 0;
+    };
+    std::map<txiter, DescendantStateUpdate, CompareIteratorByHash> mapAncestorUpdates;
     BOOST_FOREACH(txiter removeIt, entriesToRemove) {
         setEntries setAncestors;
         const CTxMemPoolEntry &entry = *removeIt;
@@ -304,9 +339,25 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
         // and it's important that we use the mapLinks[] notion of ancestor
         // transactions as the set of things to update for removal.
         CalculateMemPoolAncestors(entry, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
-        // Note that UpdateAncestorsOf severs the child links that point to
-        // removeIt in the entries for the parents of removeIt.
-        UpdateAncestorsOf(false, removeIt, setAncestors);
+        // Sever the child links that point to removeIt in the entries for the parents of removeIt.
+        setEntries parentIters = GetMemPoolParents(removeIt);
+        BOOST_FOREACH(txiter piter, parentIters) {
+            UpdateChild(piter, removeIt, false);
+        }
+        // Ancestors that are removed as well need no update. The others usually are shared by
+        // many of the entries removed together, like the rest of a chain, so sum up their
+        // changes and reindex each of them in mapTx only once below.
+        BOOST_FOREACH(txiter ancestorIt, setAncestors) {
+            if (entriesToRemove.count(ancestorIt))
+                continue;
+            DescendantStateUpdate& update = mapAncestorUpdates[ancestorIt];
+            update.nSize -= removeIt->GetTxSize();
+            update.nFee -= removeIt->GetModifiedFee();
+            update.nCount--;
+        }
+    }
+    for (const auto& update : mapAncestorUpdates) {
+        mapTx.modify(update.first, update_descendant_state(update.second.nSize, update.second.nFee, update.second.nCount));
     }
     // After updating all the ancestor sizes, we can now sever the link between each
     // transaction being removed and any mempool children (ie, update setMemPoolParents
@@ -423,6 +474,7 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
 
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
+    nTxCount = mapTx.size();
     minerPolicyEstimator->processTransaction(entry, validFeeEstimate);
 
     vTxHashes.emplace_back(hash, newit);
@@ -431,6 +483,13 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     // Invalid ProTxes should never get this far because transactions should be
     // fully checked by AcceptToMemoryPool() at this point, so we just assume that
     // everything is fine here.
+    auto addMinedProTxRef = [&](const CDeterministicMNCPtr& dmn) {
+        mapProTxRefs.emplace(dmn->proTxHash, tx.GetHash());
+        if (mapProTxRefCollateralsByProTx.emplace(dmn->proTxHash, dmn->collateralOutpoint).second) {
+            mapProTxRefCollaterals.emplace(dmn->collateralOutpoint, dmn->proTxHash);
+        }
+    };
+
     if (tx.nType == TRANSACTION_PROVIDER_REGISTER) {
         CProRegTx proTx;
         bool ok = GetTxPayload(tx, proTx);
@@ -448,16 +507,18 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
         CProUpServTx proTx;
         bool ok = GetTxPayload(tx, proTx);
         assert(ok);
-        mapProTxRefs.emplace(proTx.proTxHash, tx.GetHash());
+        auto dmn = deterministicMNManager->GetListAtChainTip().GetMN(proTx.proTxHash);
+        assert(dmn);
+        addMinedProTxRef(dmn);
         mapProTxAddresses.emplace(proTx.addr, tx.GetHash());
     } else if (tx.nType == TRANSACTION_PROVIDER_UPDATE_REGISTRAR) {
         CProUpRegTx proTx;
         bool ok = GetTxPayload(tx, proTx);
         assert(ok);
-        mapProTxRefs.emplace(proTx.proTxHash, tx.GetHash());
         mapProTxBlsPubKeyHashes.emplace(proTx.pubKeyOperator.GetHash(), tx.GetHash());
         auto dmn = deterministicMNManager->GetListAtChainTip().GetMN(proTx.proTxHash);
         assert(dmn);
+        addMinedProTxRef(dmn);
         newit->validForProTxKey = ::SerializeHash(dmn->pdmnState->pubKeyOperator);
         if (dmn->pdmnState->pubKeyOperator.Get() != proTx.pubKeyOperator) {
             newit->isKeyChangeProTx = true;
@@ -466,9 +527,9 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
         CProUpRevTx proTx;
         bool ok = GetTxPayload(tx, proTx);
         assert(ok);
-        mapProTxRefs.emplace(proTx.proTxHash, tx.GetHash());
         auto dmn = deterministicMNManager->GetListAtChainTip().GetMN(proTx.proTxHash);
         assert(dmn);
+        addMinedProTxRef(dmn);
         newit->validForProTxKey = ::SerializeHash(dmn->pdmnState->pubKeyOperator);
         if (dmn->pdmnState->pubKeyOperator.Get() != CBLSPublicKey()) {
             newit->isKeyChangeProTx = true;
@@ -482,7 +543,7 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
 {
     LOCK(cs);
     const CTransaction& tx = entry.GetTx();
-    std::vector<CMempoolAddressDeltaKey> inserted;
+    addressDeltaVector inserted;
 
     uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
@@ -493,20 +554,17 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
             std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22);
             CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, j, 1);
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            inserted.push_back(std::make_pair(key, delta));
         } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
             std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23);
             CMempoolAddressDeltaKey key(1, uint160(hashBytes), txhash, j, 1);
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            inserted.push_back(std::make_pair(key, delta));
         } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
             uint160 hashBytes(Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1));
             CMempoolAddressDeltaKey key(1, hashBytes, txhash, j, 1);
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            inserted.push_back(std::make_pair(key, delta));
         }
     }
 
@@ -515,53 +573,72 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
         if (out.scriptPubKey.IsPayToScriptHash()) {
             std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
             CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            inserted.push_back(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
         } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
             std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-            std::pair<addressDeltaMap::iterator,bool> ret;
             CMempoolAddressDeltaKey key(1, uint160(hashBytes), txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            inserted.push_back(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
         } else if (out.scriptPubKey.IsPayToPublicKey()) {
             uint160 hashBytes(Hash160(out.scriptPubKey.begin()+1, out.scriptPubKey.end()-1));
-            std::pair<addressDeltaMap::iterator,bool> ret;
             CMempoolAddressDeltaKey key(1, hashBytes, txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            inserted.push_back(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
         }
     }
 
-    mapAddressInserted.insert(std::make_pair(txhash, inserted));
+    if (inserted.empty()) {
+        return;
+    }
+    for (const auto& p : inserted) {
+        mapAddress[std::make_pair(p.first.addressBytes, p.first.type)].insert(txhash);
+    }
+    mapAddressInserted[txhash] = std::move(inserted);
 }
 
 bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresses,
                                  std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > &results)
 {
     LOCK(cs);
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        addressDeltaMap::iterator ait = mapAddress.lower_bound(CMempoolAddressDeltaKey((*it).second, (*it).first));
-        while (ait != mapAddress.end() && (*ait).first.addressBytes == (*it).first && (*ait).first.type == (*it).second) {
-            results.push_back(*ait);
-            ait++;
+    for (const auto& address : addresses) {
+        addressTxMap::const_iterator ait = mapAddress.find(address);
+        if (ait == mapAddress.end()) {
+            continue;
+        }
+        for (const uint256& txhash : ait->second) {
+            for (const auto& p : mapAddressInserted.at(txhash)) {
+                if (p.first.addressBytes == address.first && p.first.type == address.second) {
+                    results.push_back(p);
+                }
+            }
         }
     }
     return true;
 }
 
-bool CTxMemPool::removeAddressIndex(const uint256 txhash)
+void CTxMemPool::removeAddressIndexUnlocked(const uint256& txhash)
 {
-    LOCK(cs);
     addressDeltaMapInserted::iterator it = mapAddressInserted.find(txhash);
+    if (it == mapAddressInserted.end()) {
+        return;
+    }
 
-    if (it != mapAddressInserted.end()) {
-        std::vector<CMempoolAddressDeltaKey> keys = (*it).second;
-        for (std::vector<CMempoolAddressDeltaKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapAddress.erase(*mit);
+    for (const auto& p : it->second) {
+        addressTxMap::iterator ait = mapAddress.find(std::make_pair(p.first.addressBytes, p.first.type));
+        if (ait == mapAddress.end()) {
+            // an earlier delta of this transaction already removed the address
+            continue;
+        }
+        ait->second.erase(txhash);
+        if (ait->second.empty()) {
+            mapAddress.erase(ait);
         }
-        mapAddressInserted.erase(it);
     }
+    mapAddressInserted.erase(it);
+}
 
+bool CTxMemPool::removeAddressIndex(const uint256 txhash)
+{
+    LOCK(cs);
+    removeAddressIndexUnlocked(txhash);
     return true;
 }
 
@@ -570,7 +647,8 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
     LOCK(cs);
 
     const CTransaction& tx = entry.GetTx();
-    std::vector<CSpentIndexKey> inserted;
+    std::vector<COutPoint> inserted;
+    inserted.reserve(tx.vin.size());
 
     uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
@@ -594,15 +672,14 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
             addressType = 0;
         }
 
-        CSpentIndexKey key = CSpentIndexKey(input.prevout.hash, input.prevout.n);
         CSpentIndexValue value = CSpentIndexValue(txhash, j, -1, prevout.nValue, addressType, addressHash);
 
-        mapSpent.insert(std::make_pair(key, value));
-        inserted.push_back(key);
+        mapSpent.insert(std::make_pair(input.prevout, value));
+        inserted.push_back(input.prevout);
 
     }
 
-    mapSpentInserted.insert(make_pair(txhash, inserted));
+    mapSpentInserted.insert(make_pair(txhash, std::move(inserted)));
 }
 
 bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
@@ -610,7 +687,7 @@ bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     LOCK(cs);
     mapSpentIndex::iterator it;
 
-    it = mapSpent.find(key);
+    it = mapSpent.find(COutPoint(key.txid, key.outputIndex));
     if (it != mapSpent.end()) {
         value = it->second;
         return true;
@@ -618,25 +695,42 @@ bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     return false;
 }
 
-bool CTxMemPool::removeSpentIndex(const uint256 txhash)
+void CTxMemPool::removeSpentIndexUnlocked(const uint256& txhash)
 {
-    LOCK(cs);
     mapSpentIndexInserted::iterator it = mapSpentInserted.find(txhash);
+    if (it == mapSpentInserted.end()) {
+        return;
+    }
 
-    if (it != mapSpentInserted.end()) {
-        std::vector<CSpentIndexKey> keys = (*it).second;
-        for (std::vector<CSpentIndexKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapSpent.erase(*mit);
-        }
-        mapSpentInserted.erase(it);
+    for (const COutPoint& outpoint : it->second) {
+        mapSpent.erase(outpoint);
     }
+    mapSpentInserted.erase(it);
+}
 
+bool CTxMemPool::removeSpentIndex(const uint256 txhash)
+{
+    LOCK(cs);
+    removeSpentIndexUnlocked(txhash);
     return true;
 }
 
+void CTxMemPool::removeIndexes(const std::vector<uint256>& vTxHashes)
+{
+    LOCK(cs);
+    if (mapAddressInserted.empty() && mapSpentInserted.empty()) {
+        return;
+    }
+    for (const uint256& txhash : vTxHashes) {
+        removeAddressIndexUnlocked(txhash);
+        removeSpentIndexUnlocked(txhash);
+    }
+}
+
 void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 {
     NotifyEntryRemoved(it->GetSharedTx(), reason);
+    GetMainSignals().TransactionRemovedFromMempool(it->GetSharedTx(), reason);
     const uint256 hash = it->GetTx().GetHash();
     BOOST_FOREACH(const CTxIn& txin, it->GetTx().vin)
         mapNextTx.erase(txin.prevout);
@@ -659,6 +753,13 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
                 ++it;
             }
         }
+        if (!mapProTxRefs.count(proTxHash)) {
+            auto collateralIt = mapProTxRefCollateralsByProTx.find(proTxHash);
+            if (collateralIt != mapProTxRefCollateralsByProTx.end()) {
+                mapProTxRefCollaterals.erase(collateralIt->second);
+                mapProTxRefCollateralsByProTx.erase(collateralIt);
+            }
+        }
     };
 
     if (it->GetTx().nType == TRANSACTION_PROVIDER_REGISTER) {
@@ -700,10 +801,11 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
     cachedInnerUsage -= memusage::DynamicUsage(mapLinks[it].parents) + memusage::DynamicUsage(mapLinks[it].children);
     mapLinks.erase(it);
     mapTx.erase(it);
+    nTxCount = mapTx.size();
     nTransactionsUpdated++;
     minerPolicyEstimator->removeTx(hash);
-    removeAddressIndex(hash);
-    removeSpentIndex(hash);
+    removeAddressIndexUnlocked(hash);
+    removeSpentIndexUnlocked(hash);
 }
 
 // Calculates descendants of entry that are not already in setDescendants, and adds to
@@ -714,22 +816,24 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 // can save time by not iterating over those entries.
 void CTxMemPool::CalculateDescendants(txiter entryit, setEntries &setDescendants)
 {
-    setEntries stage;
+    const EpochGuard epoch(*this);
+    std::vector<txiter> stage;
     if (setDescendants.count(entryit) == 0) {
-        stage.insert(entryit);
+        visited(entryit);
+        stage.push_back(entryit);
     }
     // Traverse down the children of entry, only adding children that are not
     // accounted for in setDescendants already (because those children have either
     // already been walked, or will be walked in this iteration).
     while (!stage.empty()) {
-        txiter it = *stage.begin();
+        txiter it = stage.back();
+        stage.pop_back();
         setDescendants.insert(it);
-        stage.erase(it);
 
         const setEntries &setChildren = GetMemPoolChildren(it);
         BOOST_FOREACH(const txiter &childiter, setChildren) {
-            if (!setDescendants.count(childiter)) {
-                stage.insert(childiter);
+            if (!visited(childiter) && !setDescendants.count(childiter)) {
+                stage.push_back(childiter);
             }
         }
     }
@@ -823,8 +927,9 @@ void CTxMemPool::removeConflicts(const CTransaction &tx)
 
 void CTxMemPool::removeProTxPubKeyConflicts(const CTransaction &tx, const CKeyID &keyId)
 {
-    if (mapProTxPubKeyIDs.count(keyId)) {
-        uint256 conflictHash = mapProTxPubKeyIDs[keyId];
+    auto it = mapProTxPubKeyIDs.find(keyId);
+    if (it != mapProTxPubKeyIDs.end()) {
+        uint256 conflictHash = it->second;
         if (conflictHash != tx.GetHash() && mapTx.count(conflictHash)) {
             removeRecursive(mapTx.find(conflictHash)->GetTx(), MemPoolRemovalReason::CONFLICT);
         }
@@ -833,8 +938,9 @@ void CTxMemPool::removeProTxPubKeyConflicts(const CTransaction &tx, const CKeyID
 
 void CTxMemPool::removeProTxPubKeyConflicts(const CTransaction &tx, const CBLSPublicKey &pubKey)
 {
-    if (mapProTxBlsPubKeyHashes.count(pubKey.GetHash())) {
-        uint256 conflictHash = mapProTxBlsPubKeyHashes[pubKey.GetHash()];
+    auto it = mapProTxBlsPubKeyHashes.find(pubKey.GetHash());
+    if (it != mapProTxBlsPubKeyHashes.end()) {
+        uint256 conflictHash = it->second;
         if (conflictHash != tx.GetHash() && mapTx.count(conflictHash)) {
             removeRecursive(mapTx.find(conflictHash)->GetTx(), MemPoolRemovalReason::CONFLICT);
         }
@@ -843,8 +949,9 @@ void CTxMemPool::removeProTxPubKeyConflicts(const CTransaction &tx, const CBLSPu
 
 void CTxMemPool::removeProTxCollateralConflicts(const CTransaction &tx, const COutPoint &collateralOutpoint)
 {
-    if (mapProTxCollaterals.count(collateralOutpoint)) {
-        uint256 conflictHash = mapProTxCollaterals[collateralOutpoint];
+    auto it = mapProTxCollaterals.find(collateralOutpoint);
+    if (it != mapProTxCollaterals.end()) {
+        uint256 conflictHash = it->second;
         if (conflictHash != tx.GetHash() && mapTx.count(conflictHash)) {
             removeRecursive(mapTx.find(conflictHash)->GetTx(), MemPoolRemovalReason::CONFLICT);
         }
@@ -872,17 +979,19 @@ void CTxMemPool::removeProTxSpentCollateralConflicts(const CTransaction &tx)
             }
         }
     };
-    auto mnList = deterministicMNManager->GetListAtChainTip();
+    // The entries are copied as removeRecursive erases them from the maps
     for (const auto& in : tx.vin) {
         auto collateralIt = mapProTxCollaterals.find(in.prevout);
         if (collateralIt != mapProTxCollaterals.end()) {
             // These are not yet mined ProRegTxs
-            removeSpentCollateralConflict(collateralIt->second);
+            uint256 proTxHash = collateralIt->second;
+            removeSpentCollateralConflict(proTxHash);
         }
-        auto dmn = mnList.GetMNByCollateral(in.prevout);
-        if (dmn) {
+        auto refCollateralIt = mapProTxRefCollaterals.find(in.prevout);
+        if (refCollateralIt != mapProTxRefCollaterals.end()) {
             // These are updates refering to a mined ProRegTx
-            removeSpentCollateralConflict(dmn->proTxHash);
+            uint256 proTxHash = refCollateralIt->second;
+            removeSpentCollateralConflict(proTxHash);
         }
     }
 }
@@ -916,8 +1025,9 @@ void CTxMemPool::removeProTxConflicts(const CTransaction &tx)
             return;
         }
 
-        if (mapProTxAddresses.count(proTx.addr)) {
-            uint256 conflictHash = mapProTxAddresses[proTx.addr];
+        auto it = mapProTxAddresses.find(proTx.addr);
+        if (it != mapProTxAddresses.end()) {
+            uint256 conflictHash = it->second;
             if (conflictHash != tx.GetHash() && mapTx.count(conflictHash)) {
                 removeRecursive(mapTx.find(conflictHash)->GetTx(), MemPoolRemovalReason::CONFLICT);
             }
@@ -934,8 +1044,9 @@ void CTxMemPool::removeProTxConflicts(const CTransaction &tx)
             return;
         }
 
-        if (mapProTxAddresses.count(proTx.addr)) {
-            uint256 conflictHash = mapProTxAddresses[proTx.addr];
+        auto it = mapProTxAddresses.find(proTx.addr);
+        if (it != mapProTxAddresses.end()) {
+            uint256 conflictHash = it->second;
             if (conflictHash != tx.GetHash() && mapTx.count(conflictHash)) {
                 removeRecursive(mapTx.find(conflictHash)->GetTx(), MemPoolRemovalReason::CONFLICT);
             }
@@ -977,6 +1088,13 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
     }
     // Before the txs in the new block have been removed from the mempool, update policy estimates
     minerPolicyEstimator->processBlock(nBlockHeight, entries);
+    // Drop the address and spent index entries of the whole block in one go, removeUnchecked
+    // then only misses on them
+    std::vector<uint256> vTxHashes;
+    vTxHashes.reserve(entries.size());
+    for (const CTxMemPoolEntry* entry : entries)
+        vTxHashes.push_back(entry->GetTx().GetHash());
+    removeIndexes(vTxHashes);
     for (const auto& tx : vtx)
     {
         txiter it = mapTx.find(tx->GetHash());
@@ -998,9 +1116,15 @@ void CTxMemPool::_clear()
     mapLinks.clear();
     mapTx.clear();
     mapNextTx.clear();
+    mapProTxRefs.clear();
     mapProTxAddresses.clear();
     mapProTxPubKeyIDs.clear();
+    mapProTxBlsPubKeyHashes.clear();
+    mapProTxCollaterals.clear();
+    mapProTxRefCollaterals.clear();
+    mapProTxRefCollateralsByProTx.clear();
     totalTxSize = 0;
+    nTxCount = 0;
     cachedInnerUsage = 0;
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = false;
@@ -1615,3 +1739,5 @@ bool CTxMemPool::TransactionWithinChainLimit(const uint256& txid, size_t chainLi
 }
 
 SaltedTxidHasher::SaltedTxidHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+SaltedAddressHasher::SaltedAddressHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
@@ -6,9 +6,12 @@
 #ifndef BITCOIN_TXMEMPOOL_H
 #define BITCOIN_TXMEMPOOL_H
 
+#include <atomic>
 #include <memory>
 #include <set>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <utility>
 #include <string>
@@ -23,6 +26,7 @@
 #include "random.h"
 #include "netaddress.h"
 #include "bls/bls.h"
+#include "saltedhasher.h"
 
 #include "boost/multi_index_container.hpp"
 #include "boost/multi_index/ordered_index.hpp"
@@ -139,6 +143,9 @@ public:
     CAmount GetModFeesWithAncestors() const { return nModFeesWithAncestors; }
     unsigned int GetSigOpCountWithAncestors() const { return nSigOpCountWithAncestors; }
 
+    //! Last traversal of the mempool graph that visited this entry, see CTxMemPool::EpochGuard
+    mutable uint64_t m_epoch = 0;
+
     mutable size_t vTxHashesIdx; //!< Index in mempool's vTxHashes
 
     // If this is a proTx, this will be the hash of the key for which this ProTx was valid
@@ -347,6 +354,20 @@ public:
     }
 };
 
+class SaltedAddressHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedAddressHasher();
+
+    size_t operator()(const std::pair<uint160, int>& address) const {
+        return CSipHasher(k0, k1).Write(address.first.begin(), address.first.size()).Write((uint64_t)address.second).Finalize();
+    }
+};
+
 /**
  * CTxMemPool stores valid-according-to-the-current-best-chain transactions
  * that may be included in the next block.
@@ -433,7 +454,8 @@ private:
     unsigned int nTransactionsUpdated; //!< Used by getblocktemplate to trigger CreateNewBlock() invocation
     CBlockPolicyEstimator* minerPolicyEstimator;
 
-    uint64_t totalTxSize;      //!< sum of all mempool tx' byte sizes
+    std::atomic<uint64_t> totalTxSize; //!< sum of all mempool tx' byte sizes, readable without cs
+    std::atomic<unsigned long> nTxCount; //!< mapTx.size(), readable without cs
     uint64_t cachedInnerUsage; //!< sum of dynamic memory usage of all the map elements (NOT the maps themselves)
 
     mutable int64_t lastRollingFeeUpdate;
@@ -442,6 +464,9 @@ private:
 
     void trackPackageRemoved(const CFeeRate& rate);
 
+    mutable uint64_t m_epoch = 0;
+    mutable bool m_has_epoch_guard = false;
+
 public:
 
     static const int ROLLING_FEE_HALFLIFE = 60 * 60 * 12; // public only for testing
@@ -493,6 +518,30 @@ public:
 
     const setEntries & GetMemPoolParents(txiter entry) const;
     const setEntries & GetMemPoolChildren(txiter entry) const;
+
+    /**
+     * Starts a new traversal of the mempool graph (requires cs). Instead of collecting the
+     * entries seen so far in a setEntries, a traversal marks them with a number that is larger
+     * than any mark before, so whether an entry was seen is a single comparison and nothing
+     * is allocated. Only one traversal can run at a time.
+     */
+    class EpochGuard {
+        const CTxMemPool& pool;
+    public:
+        explicit EpochGuard(const CTxMemPool& in);
+        ~EpochGuard();
+        EpochGuard(const EpochGuard&) = delete;
+        EpochGuard& operator=(const EpochGuard&) = delete;
+    };
+
+    /** Whether the running traversal saw the entry already, marking it as seen */
+    bool visited(txiter it) const
+    {
+        assert(m_has_epoch_guard);
+        bool ret = it->m_epoch >= m_epoch;
+        it->m_epoch = std::max(it->m_epoch, m_epoch);
+        return ret;
+    }
 private:
     typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
 
@@ -504,23 +553,33 @@ private:
     typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
     txlinksMap mapLinks;
 
-    typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> addressDeltaMap;
-    addressDeltaMap mapAddress;
+    // address (hash, type) -> the transactions with deltas for it
+    typedef std::unordered_map<std::pair<uint160, int>, std::unordered_set<uint256, SaltedTxidHasher>, SaltedAddressHasher> addressTxMap;
+    addressTxMap mapAddress;
 
-    typedef std::map<uint256, std::vector<CMempoolAddressDeltaKey> > addressDeltaMapInserted;
+    // transaction -> its address deltas
+    typedef std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > addressDeltaVector;
+    typedef std::unordered_map<uint256, addressDeltaVector, SaltedTxidHasher> addressDeltaMapInserted;
     addressDeltaMapInserted mapAddressInserted;
 
-    typedef std::map<CSpentIndexKey, CSpentIndexValue, CSpentIndexKeyCompare> mapSpentIndex;
+    typedef std::unordered_map<COutPoint, CSpentIndexValue, SaltedOutpointHasher> mapSpentIndex;
     mapSpentIndex mapSpent;
 
-    typedef std::map<uint256, std::vector<CSpentIndexKey> > mapSpentIndexInserted;
+    typedef std::unordered_map<uint256, std::vector<COutPoint>, SaltedTxidHasher> mapSpentIndexInserted;
     mapSpentIndexInserted mapSpentInserted;
 
-    std::multimap<uint256, uint256> mapProTxRefs; // proTxHash -> transaction (all TXs that refer to an existing proTx)
-    std::map<CService, uint256> mapProTxAddresses;
-    std::map<CKeyID, uint256> mapProTxPubKeyIDs;
-    std::map<uint256, uint256> mapProTxBlsPubKeyHashes;
-    std::map<COutPoint, uint256> mapProTxCollaterals;
+    void removeAddressIndexUnlocked(const uint256& txhash);
+    void removeSpentIndexUnlocked(const uint256& txhash);
+
+    std::unordered_multimap<uint256, uint256, StaticSaltedHasher> mapProTxRefs; // proTxHash -> transaction (all TXs that refer to an existing proTx)
+    std::unordered_map<CService, uint256, StaticSaltedHasher> mapProTxAddresses;
+    std::unordered_map<uint160, uint256, StaticSaltedHasher> mapProTxPubKeyIDs; // keyIDOwner -> ProRegTx
+    std::unordered_map<uint256, uint256, StaticSaltedHasher> mapProTxBlsPubKeyHashes;
+    std::unordered_map<COutPoint, uint256, StaticSaltedHasher> mapProTxCollaterals; // collateral -> ProRegTx in the mempool
+    // collateral -> proTxHash of the mined MNs which TXs in mapProTxRefs refer to, so spending a collateral doesn't
+    // need a MN list lookup per input. The collateral of a MN never changes, so this is kept up to date incrementally.
+    std::unordered_map<COutPoint, uint256, StaticSaltedHasher> mapProTxRefCollaterals;
+    std::unordered_map<uint256, COutPoint, StaticSaltedHasher> mapProTxRefCollateralsByProTx;
 
     void UpdateParent(txiter entry, txiter parent, bool add);
     void UpdateChild(txiter entry, txiter child, bool add);
@@ -556,6 +615,8 @@ public:
     bool getAddressIndex(std::vector<std::pair<uint160, int> > &addresses,
                          std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > &results);
     bool removeAddressIndex(const uint256 txhash);
+    /** Remove the address and spent index entries of all of vTxHashes under a single lock */
+    void removeIndexes(const std::vector<uint256>& vTxHashes);
 
     void addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view);
     bool getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
@@ -660,6 +721,10 @@ public:
         return totalTxSize;
     }
 
+    /** size() and GetTotalTxSize() without taking cs, for monitoring */
+    unsigned long SizeNoLock() const { return nTxCount; }
+    uint64_t GetTotalTxSizeNoLock() const { return totalTxSize; }
+
     bool exists(uint256 hash) const
     {
         LOCK(cs);
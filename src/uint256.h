@@ -14,6 +14,7 @@
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include "crypto/common.h"
 
@@ -25,6 +26,9 @@ protected:
     enum { WIDTH=BITS/8 };
     uint8_t data[WIDTH];
 public:
+    //! Serialized as its bytes, so vectors of blobs are (un)serialized with one copy
+    typedef std::true_type SerializedAsBytes;
+
     base_blob()
     {
         memset(data, 0, sizeof(data));
@@ -150,6 +150,38 @@ void unescape_unicode_test()
     f_assert(val[0].get_str() == "\xf0\x9d\x85\xa1");
 }
 
+// Test strings around the 8 character steps plain runs are scanned in
+void long_string_test()
+{
+    UniValue val;
+    const char *specials[] = {"\\\"", "\\u0191", "\xc6\x91", "\\\\"};
+    const char *decoded[] = {"\"", "\xc6\x91", "\xc6\x91", "\\"};
+    for (unsigned int len = 0; len < 40; len++) {
+        for (unsigned int i = 0; i < ARRAY_SIZE(specials); i++) {
+            for (unsigned int pos = 0; pos <= len; pos++) {
+                std::string plain(len, 'a');
+                std::string json = "[\"" + plain.substr(0, pos) + specials[i] + plain.substr(pos) + "\"]";
+                f_assert(val.read(json));
+                f_assert(val[0].get_str() == plain.substr(0, pos) + decoded[i] + plain.substr(pos));
+
+                // control characters and unterminated strings fail wherever they are
+                std::string bad = "[\"" + plain.substr(0, pos) + "\x01" + plain.substr(pos) + "\"]";
+                f_assert(!val.read(bad));
+                f_assert(!val.read("[\"" + plain.substr(0, pos)));
+            }
+        }
+    }
+
+    // an invalid UTF-8 sequence fails even if the run after it is plain
+    f_assert(!val.read("[\"\xc6" "aaaaaaaaaaaaaaaa\"]"));
+    f_assert(!val.read("[\"aaaaaaaaaaaaaaaa\x80\"]"));
+
+    // keys and numbers are taken over as well
+    f_assert(val.read("{\"aaaaaaaaaaaaaaaaaaaa\": -12.5e+3, \"b\": [1, 2, 3]}"));
+    f_assert(val["aaaaaaaaaaaaaaaaaaaa"].getValStr() == "-12.5e+3");
+    f_assert(val["b"][2].get_int() == 3);
+}
+
 int main (int argc, char *argv[])
 {
     for (unsigned int fidx = 0; fidx < ARRAY_SIZE(filenames); fidx++) {
@@ -157,6 +189,7 @@ int main (int argc, char *argv[])
     }
 
     unescape_unicode_test();
+    long_string_test();
 
     return test_failed ? 1 : 0;
 }
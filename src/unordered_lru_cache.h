@@ -7,6 +7,8 @@
 #ifndef EPMCOIN_UNORDERED_LRU_CACHE_H
 #define EPMCOIN_UNORDERED_LRU_CACHE_H
 
+#include "memusage.h"
+
 #include <unordered_map>
 
 template<typename Key, typename Value, typename Hasher, size_t MaxSize = 0, size_t TruncateThreshold = 0>
@@ -84,6 +86,25 @@ public:
         cacheMap.clear();
     }
 
+    size_t size() const
+    {
+        return cacheMap.size();
+    }
+
+    //! Not counting what the keys and values allocate themselves
+    size_t DynamicMemoryUsage() const
+    {
+        return memusage::DynamicUsage(cacheMap);
+    }
+
+    template<typename Callback>
+    void ForEach(Callback&& cb) const
+    {
+        for (const auto& p : cacheMap) {
+            cb(p.first, p.second.first);
+        }
+    }
+
 private:
     void truncate_if_needed()
     {
@@ -43,7 +43,15 @@
 #endif // __linux__
 
 #include <algorithm>
+#include <condition_variable>
 #include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <sys/resource.h>
 #include <sys/stat.h>
 
@@ -75,6 +83,11 @@
 #include <shlobj.h>
 #endif
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #ifdef HAVE_SYS_PRCTL_H
 #include <sys/prctl.h>
 #endif
@@ -142,6 +155,7 @@ bool fLogTimestamps = DEFAULT_LOGTIMESTAMPS;
 bool fLogTimeMicros = DEFAULT_LOGTIMEMICROS;
 bool fLogThreadNames = DEFAULT_LOGTHREADNAMES;
 bool fLogIPs = DEFAULT_LOGIPS;
+unsigned int nLogRateLimit = DEFAULT_LOGRATELIMIT;
 std::atomic<bool> fReopenDebugLog(false);
 CTranslationInterface translationInterface;
 
@@ -223,6 +237,31 @@ static boost::mutex* mutexDebugLog = NULL;
 static std::list<std::string>* vMsgsBeforeOpenLog;
 static std::atomic<int> logAcceptCategoryCacheCounter(0);
 
+/**
+ * With the async log every thread collects its lines in a buffer of its own, only the
+ * writer thread takes the buffer's lock too, to swap the lines out. Lines are numbered
+ * so the writer keeps them in order across threads.
+ */
+struct CLogThreadBuffer
+{
+    std::mutex cs;
+    std::vector<std::pair<uint64_t, std::string> > vLines;
+    size_t nBytes = 0;
+};
+
+//! A thread buffering more than this writes its lines out itself
+static const size_t MAX_LOG_THREAD_BUFFER = 1 << 20;
+//! How often the writer thread looks for new lines, in milliseconds
+static const int64_t ASYNC_LOG_INTERVAL = 100;
+
+static std::atomic<bool> fAsyncDebugLog(false);
+static std::atomic<uint64_t> nLogLineSequence(0);
+static std::mutex* mutexLogBuffers = NULL;
+static std::condition_variable* condLogWriter = NULL;
+static std::vector<std::shared_ptr<CLogThreadBuffer> >* vLogBuffers = NULL;
+static std::thread* threadLogWriter = NULL;
+static bool fStopLogWriter = false;
+
 static int FileWriteStr(const std::string &str, FILE *fp)
 {
     return fwrite(str.data(), 1, str.size(), fp);
@@ -233,6 +272,9 @@ static void DebugPrintInit()
     assert(mutexDebugLog == NULL);
     mutexDebugLog = new boost::mutex();
     vMsgsBeforeOpenLog = new std::list<std::string>;
+    mutexLogBuffers = new std::mutex();
+    condLogWriter = new std::condition_variable();
+    vLogBuffers = new std::vector<std::shared_ptr<CLogThreadBuffer> >();
 }
 
 void OpenDebugLog()
@@ -374,6 +416,159 @@ static std::string LogThreadNameStr(const std::string &str, std::atomic_bool *fS
     return strThreadLogged;
 }
 
+/** Write to the opened debug.log, mutexDebugLog has to be held */
+static int DebugLogWriteStr(const std::string &str)
+{
+    // reopen the log file, if requested
+    if (fReopenDebugLog) {
+        fReopenDebugLog = false;
+        boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+        if (freopen(pathDebug.string().c_str(),"a",fileout) != NULL)
+            setbuf(fileout, NULL); // unbuffered
+    }
+
+    return FileWriteStr(str, fileout);
+}
+
+/** Take the lines out of the buffers, in the order they were logged */
+static std::string TakeBufferedLogLines()
+{
+    std::vector<std::pair<uint64_t, std::string> > vLines;
+    {
+        std::lock_guard<std::mutex> lock(*mutexLogBuffers);
+        for (auto it = vLogBuffers->begin(); it != vLogBuffers->end();) {
+            CLogThreadBuffer& buffer = **it;
+            std::lock_guard<std::mutex> lockBuffer(buffer.cs);
+            std::move(buffer.vLines.begin(), buffer.vLines.end(), std::back_inserter(vLines));
+            buffer.vLines.clear();
+            buffer.nBytes = 0;
+            // the thread has ended when only the list still holds its buffer
+            if (it->use_count() == 1)
+                it = vLogBuffers->erase(it);
+            else
+                ++it;
+        }
+    }
+    std::sort(vLines.begin(), vLines.end(), [](const std::pair<uint64_t, std::string>& a, const std::pair<uint64_t, std::string>& b) {
+        return a.first < b.first;
+    });
+
+    std::string strLines;
+    for (const auto& line : vLines)
+        strLines += line.second;
+    return strLines;
+}
+
+static void ThreadLogWriter()
+{
+    RenameThread("epmcoin-logwriter");
+    std::unique_lock<std::mutex> lock(*mutexLogBuffers);
+    while (!fStopLogWriter) {
+        condLogWriter->wait_for(lock, std::chrono::milliseconds(ASYNC_LOG_INTERVAL));
+        lock.unlock();
+        // one write for everything that came in since the last time
+        std::string strLines = TakeBufferedLogLines();
+        if (!strLines.empty()) {
+            boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+            DebugLogWriteStr(strLines);
+        }
+        lock.lock();
+    }
+}
+
+void StartAsyncDebugLog()
+{
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    std::lock_guard<std::mutex> lock(*mutexLogBuffers);
+    if (threadLogWriter != NULL || fileout == NULL)
+        return;
+    fStopLogWriter = false;
+    threadLogWriter = new std::thread(ThreadLogWriter);
+    fAsyncDebugLog = true;
+}
+
+void StopAsyncDebugLog()
+{
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    {
+        std::lock_guard<std::mutex> lock(*mutexLogBuffers);
+        if (threadLogWriter == NULL)
+            return;
+        fAsyncDebugLog = false;
+        fStopLogWriter = true;
+    }
+    condLogWriter->notify_all();
+    threadLogWriter->join();
+    delete threadLogWriter;
+    threadLogWriter = NULL;
+
+    // lines logged while the writer was stopping
+    std::string strLines = TakeBufferedLogLines();
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+    DebugLogWriteStr(strLines);
+}
+
+/**
+ * Queue a line of the async log. If the thread's buffer is full, returns false and the
+ * buffered lines along with this one in strFlush, for the thread to write them itself.
+ */
+static bool BufferLogLine(const std::string &str, std::string &strFlush)
+{
+    thread_local std::shared_ptr<CLogThreadBuffer> buffer;
+    if (!buffer) {
+        buffer = std::make_shared<CLogThreadBuffer>();
+        std::lock_guard<std::mutex> lock(*mutexLogBuffers);
+        vLogBuffers->push_back(buffer);
+    }
+
+    std::lock_guard<std::mutex> lock(buffer->cs);
+    if (buffer->nBytes + str.size() > MAX_LOG_THREAD_BUFFER) {
+        for (const auto& line : buffer->vLines)
+            strFlush += line.second;
+        strFlush += str;
+        buffer->vLines.clear();
+        buffer->nBytes = 0;
+        return false;
+    }
+    buffer->vLines.emplace_back(nLogLineSequence++, str);
+    buffer->nBytes += str.size();
+    return true;
+}
+
+bool LogRateLimitAllow(const char* category)
+{
+    if (nLogRateLimit == 0 || category == NULL)
+        return true;
+
+    struct RateState {
+        int64_t nSecond = 0;
+        unsigned int nCount = 0;
+        unsigned int nSuppressed = 0;
+    };
+    static std::mutex* mutexRate = new std::mutex();
+    static std::map<std::string, RateState>* mapRates = new std::map<std::string, RateState>();
+
+    int64_t nNow = GetTime();
+    unsigned int nSuppressed = 0;
+    {
+        std::lock_guard<std::mutex> lock(*mutexRate);
+        RateState& state = (*mapRates)[category];
+        if (state.nSecond != nNow) {
+            nSuppressed = state.nSuppressed;
+            state.nSecond = nNow;
+            state.nCount = 0;
+            state.nSuppressed = 0;
+        }
+        if (++state.nCount > nLogRateLimit) {
+            state.nSuppressed++;
+            return false;
+        }
+    }
+    if (nSuppressed > 0)
+        LogPrintStr(strprintf("%u %s messages suppressed by -lograte\n", nSuppressed, category));
+    return true;
+}
+
 int LogPrintStr(const std::string &str)
 {
     int ret = 0; // Returns total number of characters written
@@ -396,6 +591,16 @@ int LogPrintStr(const std::string &str)
     else if (fPrintToDebugLog)
     {
         boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+
+        if (fAsyncDebugLog) {
+            std::string strFlush;
+            if (BufferLogLine(strTimestamped, strFlush))
+                return strTimestamped.length();
+            boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+            DebugLogWriteStr(strFlush);
+            return strTimestamped.length();
+        }
+
         boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
 
         // buffer if we haven't opened the log yet
@@ -406,15 +611,7 @@ int LogPrintStr(const std::string &str)
         }
         else
         {
-            // reopen the log file, if requested
-            if (fReopenDebugLog) {
-                fReopenDebugLog = false;
-                boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
-                if (freopen(pathDebug.string().c_str(),"a",fileout) != NULL)
-                    setbuf(fileout, NULL); // unbuffered
-            }
-
-            ret = FileWriteStr(strTimestamped, fileout);
+            ret = DebugLogWriteStr(strTimestamped);
         }
     }
     return ret;
@@ -894,6 +1091,177 @@ void SetThreadPriority(int nPriority)
 #endif // WIN32
 }
 
+/** The subsystems whose threads can be placed with -threadaffinity, by the prefixes of their thread names */
+static const std::vector<std::pair<std::string, std::vector<std::string> > > threadAffinityGroups = {
+    {"validation", {"epmcoin-scriptch", "epmcoin-cfcheck", "epmcoin-prefetch", "epmcoin-loadblk"}},
+    {"msghand", {"epmcoin-msghand", "epmcoin-msgproc"}},
+    {"net", {"epmcoin-net", "epmcoin-dnsseed", "epmcoin-addcon", "epmcoin-opencon", "epmcoin-mncon"}},
+    {"bls", {"epmcoin-bls-worker"}},
+    {"dkg", {"epmcoin-q-msg", "epmcoin-q-phase"}},
+    {"sigshares", {"epmcoin-sigshares"}},
+    {"instantsend", {"epmcoin-instantsend"}},
+    {"http", {"epmcoin-http"}},
+};
+
+static std::mutex csThreadAffinity;
+//! The cpus of every group which was given a placement, threads of other groups run on defaultThreadCpus
+static std::map<std::string, std::set<int> > mapThreadAffinity;
+static std::set<int> defaultThreadCpus;
+
+/** Parses a list like "0-3,8" or "node1", the latter meaning all cpus of that NUMA node */
+static bool ParseCpuList(const std::string& strList, std::set<int>& setCpus)
+{
+    std::string str = strList;
+    if (boost::algorithm::starts_with(str, "node")) {
+        std::ifstream file("/sys/devices/system/node/" + str + "/cpulist");
+        str.clear();
+        if (!file || !std::getline(file, str))
+            return false;
+    }
+    std::vector<std::string> vRanges;
+    boost::split(vRanges, str, boost::is_any_of(","));
+    for (const std::string& strRange : vRanges) {
+        size_t nDash = strRange.find('-');
+        int32_t nFirst, nLast;
+        if (!ParseInt32(strRange.substr(0, nDash), &nFirst))
+            return false;
+        nLast = nFirst;
+        if (nDash != std::string::npos && !ParseInt32(strRange.substr(nDash + 1), &nLast))
+            return false;
+        if (nFirst < 0 || nLast < nFirst || nLast >= MAX_THREAD_AFFINITY_CPUS)
+            return false;
+        for (int i = nFirst; i <= nLast; i++)
+            setCpus.insert(i);
+    }
+    return !setCpus.empty();
+}
+
+static std::string FormatCpuList(const std::set<int>& setCpus)
+{
+    std::string str;
+    for (auto it = setCpus.begin(); it != setCpus.end(); ) {
+        int nFirst = *it, nLast = *it;
+        while (++it != setCpus.end() && *it == nLast + 1)
+            nLast = *it;
+        if (!str.empty())
+            str += ",";
+        str += nFirst == nLast ? strprintf("%d", nFirst) : strprintf("%d-%d", nFirst, nLast);
+    }
+    return str;
+}
+
+bool InitThreadAffinity(std::string& strError)
+{
+    std::map<std::string, std::set<int> > mapAffinity;
+    if (mapMultiArgs.count("-threadaffinity")) {
+        for (const std::string& strArg : mapMultiArgs.at("-threadaffinity")) {
+            size_t nPos = strArg.find('=');
+            std::string strGroup = strArg.substr(0, nPos);
+            auto it = std::find_if(threadAffinityGroups.begin(), threadAffinityGroups.end(),
+                                   [&](const std::pair<std::string, std::vector<std::string> >& group) { return group.first == strGroup; });
+            if (nPos == std::string::npos || it == threadAffinityGroups.end()) {
+                strError = strprintf("Invalid -threadaffinity=%s, expected <group>=<cpus> with group one of validation, msghand, net, bls, dkg, sigshares, instantsend, http", strArg);
+                return false;
+            }
+            std::set<int> setCpus;
+            if (!ParseCpuList(strArg.substr(nPos + 1), setCpus)) {
+                strError = strprintf("Invalid cpus in -threadaffinity=%s", strArg);
+                return false;
+            }
+            mapAffinity[strGroup] = setCpus;
+        }
+    }
+
+    std::set<int> setReserved;
+    std::string strReserved = GetArg("-reservecores", "");
+    if (!strReserved.empty() && !ParseCpuList(strReserved, setReserved)) {
+        strError = strprintf("Invalid -reservecores=%s", strReserved);
+        return false;
+    }
+
+    if (mapAffinity.empty() && setReserved.empty())
+        return true;
+
+#ifdef __linux__
+    // everything the process may run on, the reserved cores are taken out of it for all but
+    // the message handler and validation
+    std::set<int> setAll;
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    if (sched_getaffinity(0, sizeof(cpuset), &cpuset) != 0) {
+        strError = strprintf("Unable to get the cpus of the process: %s", strerror(errno));
+        return false;
+    }
+    for (int i = 0; i < std::min(CPU_SETSIZE, MAX_THREAD_AFFINITY_CPUS); i++) {
+        if (CPU_ISSET(i, &cpuset))
+            setAll.insert(i);
+    }
+
+    std::set<int> setDefault;
+    if (!setReserved.empty()) {
+        std::set_difference(setAll.begin(), setAll.end(), setReserved.begin(), setReserved.end(), std::inserter(setDefault, setDefault.end()));
+        if (setDefault.empty()) {
+            strError = strprintf("-reservecores=%s leaves no cpus for the other threads", strReserved);
+            return false;
+        }
+        mapAffinity.emplace("validation", setReserved);
+        mapAffinity.emplace("msghand", setReserved);
+    }
+
+    for (const auto& p : mapAffinity) {
+        if (!std::includes(setAll.begin(), setAll.end(), p.second.begin(), p.second.end())) {
+            strError = strprintf("The cpus %s of the %s threads aren't all available to the process (%s)", FormatCpuList(p.second), p.first, FormatCpuList(setAll));
+            return false;
+        }
+        LogPrintf("%s: %s threads run on cpus %s\n", __func__, p.first, FormatCpuList(p.second));
+    }
+    if (!setDefault.empty())
+        LogPrintf("%s: other threads run on cpus %s\n", __func__, FormatCpuList(setDefault));
+
+    std::lock_guard<std::mutex> lock(csThreadAffinity);
+    mapThreadAffinity = std::move(mapAffinity);
+    defaultThreadCpus = std::move(setDefault);
+    return true;
+#else
+    strError = "-threadaffinity and -reservecores are only supported on Linux";
+    return false;
+#endif
+}
+
+/** Binds the calling thread to the cpus configured for the group its name belongs to, if any */
+static void ApplyThreadAffinity(const std::string& strName)
+{
+#ifdef __linux__
+    std::set<int> setCpus;
+    {
+        std::lock_guard<std::mutex> lock(csThreadAffinity);
+        setCpus = defaultThreadCpus;
+        for (const auto& group : threadAffinityGroups) {
+            bool fMatch = std::any_of(group.second.begin(), group.second.end(),
+                                      [&](const std::string& strPrefix) { return boost::algorithm::starts_with(strName, strPrefix); });
+            if (!fMatch)
+                continue;
+            auto it = mapThreadAffinity.find(group.first);
+            if (it != mapThreadAffinity.end())
+                setCpus = it->second;
+            break;
+        }
+    }
+    if (setCpus.empty())
+        return;
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (int nCpu : setCpus)
+        CPU_SET(nCpu, &cpuset);
+    int nErr = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    if (nErr != 0)
+        LogPrintf("%s: unable to bind thread %s to cpus %s: %s\n", __func__, strName, FormatCpuList(setCpus), strerror(nErr));
+#else
+    (void)strName;
+#endif
+}
+
 void RenameThread(const char* name)
 {
 #if defined(PR_SET_NAME)
@@ -909,6 +1277,7 @@ void RenameThread(const char* name)
     (void)name;
 #endif
     LogPrintf("%s: thread new name %s\n", __func__, name);
+    ApplyThreadAffinity(name);
 }
 
 std::string GetThreadName()
@@ -58,6 +58,8 @@ static const bool DEFAULT_LOGTIMEMICROS  = false;
 static const bool DEFAULT_LOGIPS         = false;
 static const bool DEFAULT_LOGTIMESTAMPS  = true;
 static const bool DEFAULT_LOGTHREADNAMES = false;
+static const bool DEFAULT_ASYNCLOG       = false;
+static const unsigned int DEFAULT_LOGRATELIMIT = 0;
 
 /** Signals for translation. */
 class CTranslationInterface
@@ -76,6 +78,7 @@ extern bool fLogTimestamps;
 extern bool fLogTimeMicros;
 extern bool fLogThreadNames;
 extern bool fLogIPs;
+extern unsigned int nLogRateLimit;
 extern std::atomic<bool> fReopenDebugLog;
 extern CTranslationInterface translationInterface;
 
@@ -101,6 +104,12 @@ bool LogAcceptCategory(const char* category);
 void ResetLogAcceptCategoryCache();
 /** Send a string to the log output */
 int LogPrintStr(const std::string &str);
+/** From now on hand debug.log writes to a background thread instead of writing from the logging thread */
+void StartAsyncDebugLog();
+/** Write out whatever is still buffered and go back to writing synchronously */
+void StopAsyncDebugLog();
+/** Whether another LogPrint message of the category fits into the current second of -lograte */
+bool LogRateLimitAllow(const char* category);
 
 /** Formats a string without throwing exceptions. Instead, it'll return an error string instead of formatted string. */
 template<typename... Args>
@@ -116,7 +125,7 @@ std::string SafeStringFormat(const std::string& fmt, const Args&... args)
 }
 
 #define LogPrint(category, ...) do { \
-    if (LogAcceptCategory((category))) { \
+    if (LogAcceptCategory((category)) && LogRateLimitAllow((category))) { \
         LogPrintStr(SafeStringFormat(__VA_ARGS__)); \
     } \
 } while(0)
@@ -249,6 +258,16 @@ std::string HelpMessageOpt(const std::string& option, const std::string& message
  */
 int GetNumCores();
 
+/** The cpus -threadaffinity and -reservecores can name are below this */
+static const int MAX_THREAD_AFFINITY_CPUS = 1024;
+
+/**
+ * Parses -threadaffinity and -reservecores. Threads which are renamed afterwards are bound to the
+ * cpus of the subsystem their name belongs to. Returns false with strError set if the options are invalid.
+ */
+bool InitThreadAffinity(std::string& strError);
+
+/** Names the calling thread and places it according to -threadaffinity and -reservecores */
 void RenameThread(const char* name);
 std::string GetThreadName();
 
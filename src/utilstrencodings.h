@@ -92,20 +92,24 @@ bool ParseUInt64(const std::string& str, uint64_t *out);
  */
 bool ParseDouble(const std::string& str, double *out);
 
+/** The two hex digits of every byte value, "000102...ff" */
+extern const char p_util_hexpairs[513];
+
 template<typename T>
 std::string HexStr(const T itbegin, const T itend, bool fSpaces=false)
 {
-    std::string rv;
-    static const char hexmap[16] = { '0', '1', '2', '3', '4', '5', '6', '7',
-                                     '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
-    rv.reserve((itend-itbegin)*3);
-    for(T it = itbegin; it < itend; ++it)
+    if (!(itbegin < itend))
+        return std::string();
+    // size the string once and write two digits per byte, the spaces are there from the start
+    size_t nBytes = itend - itbegin;
+    size_t nStep = fSpaces ? 3 : 2;
+    std::string rv(nBytes * nStep - (fSpaces ? 1 : 0), ' ');
+    char* p = &rv[0];
+    for(T it = itbegin; it < itend; ++it, p += nStep)
     {
-        unsigned char val = (unsigned char)(*it);
-        if(fSpaces && it != itbegin)
-            rv.push_back(' ');
-        rv.push_back(hexmap[val>>4]);
-        rv.push_back(hexmap[val&15]);
+        const char* pair = p_util_hexpairs + 2 * (unsigned char)(*it);
+        p[0] = pair[0];
+        p[1] = pair[1];
     }
 
     return rv;
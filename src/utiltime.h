@@ -24,6 +24,8 @@ int64_t GetTimeMillis();
 int64_t GetTimeMicros();
 int64_t GetSystemTimeInSeconds(); // Like GetTime(), but not mockable
 int64_t GetLogTimeMicros();
+/** CPU time consumed by the calling thread in microseconds, 0 where the platform can't tell */
+int64_t GetThreadCPUTimeMicros();
 void SetMockTime(int64_t nMockTimeIn);
 bool IsMockTime();
 void MilliSleep(int64_t n);
@@ -24,19 +24,24 @@
 #include "hash.h"
 #include "init.h"
 #include "kernel.h"
+#include "metrics.h"
 #include "policy/policy.h"
 #include "pow.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
+#include "saltedhasher.h"
 #include "script/script.h"
 #include "script/sigcache.h"
 #include "script/standard.h"
 #include "timedata.h"
+#include "timehistogram.h"
 #include "tinyformat.h"
+#include "tracing.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include "ui_interface.h"
 #include "undo.h"
+#include "unordered_lru_cache.h"
 #include "util.h"
 #include "spork.h"
 #include "utilmoneystr.h"
@@ -46,7 +51,10 @@
 #include "warnings.h"
 #include "wallet/wallet.h"
 
+#include <ctpl.h>
+
 #include "instantx.h"
+#include "governance-classes.h"
 #include "masternode-payments.h"
 
 #include "evo/specialtx.h"
@@ -58,7 +66,10 @@
 #include "llmq/quorums_chainlocks.h"
 
 #include <atomic>
+#include <deque>
+#include <future>
 #include <sstream>
+#include <unordered_set>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -67,6 +78,11 @@
 #include <boost/math/distributions/poisson.hpp>
 #include <boost/thread.hpp>
 
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #if defined(NDEBUG)
 # error "EPMCoin Core cannot be compiled without assertions."
 #endif
@@ -80,26 +96,97 @@ static std::map<uint256, uint256> mapProofOfStake;
 CCriticalSection cs_main;
 
 BlockMap mapBlockIndex;
+CBlockIndexArena blockIndexArena;
 PrevBlockMap mapPrevBlockIndex;
+std::set<const CBlockIndex*> setChainTips;
 CChain chainActive;
-std::set<std::pair<COutPoint, unsigned int>> setStakeSeen;
+
+/**
+ * Kernels (stake prevout and block time) of PoS blocks seen recently. Entries more than
+ * STAKE_SEEN_PRUNE_DEPTH blocks below the highest block seen are dropped, so memory stays
+ * bounded on long running nodes instead of growing with every PoS block ever seen.
+ */
+class CStakeSeenFilter
+{
+private:
+    typedef std::pair<COutPoint, unsigned int> Kernel;
+
+    struct KernelHasher
+    {
+        SaltedOutpointHasher hasher;
+        size_t operator()(const Kernel& kernel) const
+        {
+            return hasher(kernel.first) ^ ((size_t)kernel.second * 0x9e3779b97f4a7c15ULL);
+        }
+    };
+
+    std::unordered_set<Kernel, KernelHasher> setKernels;
+    std::multimap<int, Kernel> mapKernelsByHeight;
+    int nBestHeight{0};
+
+public:
+    static const int STAKE_SEEN_PRUNE_DEPTH = 2000;
+
+    void Insert(const COutPoint& prevoutStake, unsigned int nTime, int nHeight)
+    {
+        Kernel kernel(prevoutStake, nTime);
+        if (nHeight < nBestHeight - STAKE_SEEN_PRUNE_DEPTH || !setKernels.emplace(kernel).second)
+            return;
+        mapKernelsByHeight.emplace(nHeight, kernel);
+
+        if (nHeight > nBestHeight) {
+            nBestHeight = nHeight;
+            auto itEnd = mapKernelsByHeight.lower_bound(nBestHeight - STAKE_SEEN_PRUNE_DEPTH);
+            for (auto it = mapKernelsByHeight.begin(); it != itEnd; ++it) {
+                setKernels.erase(it->second);
+            }
+            mapKernelsByHeight.erase(mapKernelsByHeight.begin(), itEnd);
+        }
+    }
+
+    bool Contains(const COutPoint& prevoutStake, unsigned int nTime) const
+    {
+        return setKernels.count(Kernel(prevoutStake, nTime)) != 0;
+    }
+
+    size_t Size() const { return setKernels.size(); }
+
+    size_t DynamicMemoryUsage() const
+    {
+        return memusage::DynamicUsage(setKernels) + memusage::DynamicUsage(mapKernelsByHeight);
+    }
+};
+CStakeSeenFilter stakeSeen;
+
+memusage::SubsystemUsage GetStakeSeenMemoryUsage()
+{
+    LOCK(cs_main);
+    memusage::SubsystemUsage usage;
+    usage.nEntries = stakeSeen.Size();
+    usage.nBytes = stakeSeen.DynamicMemoryUsage();
+    return usage;
+}
 CBlockIndex *pindexBestHeader = NULL;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
 std::atomic_bool fImporting(false);
+std::atomic_bool fMempoolLoaded(false);
 bool fReindex = false;
 bool fTxIndex = true;
 bool fAddressIndex = false;
 bool fTimestampIndex = false;
 bool fSpentIndex = false;
+bool fRewardIndex = false;
 bool fHavePruned = false;
 bool fPruneMode = false;
+bool fMapBlockFiles = DEFAULT_MMAP_BLOCKS;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 unsigned int nBytesPerSigOp = DEFAULT_BYTES_PER_SIGOP;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
+bool fAssumeChainLocked = DEFAULT_ASSUME_CHAINLOCKED;
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
 bool fAlerts = DEFAULT_ALERTS;
@@ -214,7 +301,7 @@ public:
     ~MemPoolConflictRemovalTracker() {
         pool.NotifyEntryRemoved.disconnect(boost::bind(&MemPoolConflictRemovalTracker::NotifyEntryRemoved, this, _1, _2));
         for (const auto& tx : conflictedTxs) {
-            GetMainSignals().SyncTransaction(*tx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+            GetMainSignals().SyncTransaction(tx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
         }
         conflictedTxs.clear();
     }
@@ -236,8 +323,14 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewDB *pcoinsdbview = NULL;
+CCoinsViewBackgroundFlush *pcoinsflusher = NULL;
+/** Rolling stats of pcoinsTip, only meaningful while fUTXOStatsValid (protected by cs_main) */
+static CUTXOSetStats utxoStats;
+static bool fUTXOStatsValid = false;
+CCoinsViewPrefetch *pcoinsprefetch = NULL;
 CCoinsViewCache *pcoinsTip = NULL;
 CBlockTreeDB *pblocktree = NULL;
+CTxIndexDB *ptxindexdb = NULL;
 
 enum FlushStateMode {
     FLUSH_STATE_NONE,
@@ -655,6 +748,8 @@ static bool IsCurrentForFeeEstimation()
     return true;
 }
 
+static bool CheckInputsParallel(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, unsigned int flags, PrecomputedTransactionData& txdata);
+
 bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx, bool fLimitFree,
                               bool* pfMissingInputs, int64_t nAcceptTime, bool fOverrideMempoolLimit,
                               const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache, bool fDryRun)
@@ -884,7 +979,8 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
 
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-        if (!CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true))
+        PrecomputedTransactionData txdata(tx);
+        if (!CheckInputsParallel(tx, state, view, STANDARD_SCRIPT_VERIFY_FLAGS, txdata))
             return false; // state filled in by CheckInputs
 
         // Check again against just the consensus-critical mandatory script
@@ -896,7 +992,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         // There is a similar check in CreateNewBlock() to prevent creating
         // invalid blocks, however allowing such transactions into the mempool
         // can be exploited as a DoS attack.
-        if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true))
+        if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true, NULL, &txdata))
         {
             return error("%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s, %s",
                 __func__, hash.ToString(), FormatStateMessage(state));
@@ -909,6 +1005,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
 
         // Store transaction in memory
         pool.addUnchecked(hash, entry, setAncestors, validForFeeEstimation);
+        TRACE3(mempool, added, hash.begin(), nSize, nFees);
 
         // Add memory address index
         if (fAddressIndex) {
@@ -929,7 +1026,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
     }
 
     if(!fDryRun)
-        GetMainSignals().SyncTransaction(tx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+        GetMainSignals().SyncTransaction(ptx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
 
     return true;
 }
@@ -941,7 +1038,10 @@ bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState &state, const
     std::vector<COutPoint> coins_to_uncache;
     bool res = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, nAcceptTime, fOverrideMempoolLimit, nAbsurdFee, coins_to_uncache, fDryRun);
     if (!res || fDryRun) {
-        if(!res) LogPrint("mempool", "%s: %s %s (%s)\n", __func__, tx->GetHash().ToString(), state.GetRejectReason(), state.GetDebugMessage());
+        if(!res) {
+            LogPrint("mempool", "%s: %s %s (%s)\n", __func__, tx->GetHash().ToString(), state.GetRejectReason(), state.GetDebugMessage());
+            TRACE2(mempool, rejected, tx->GetHash().begin(), state.GetRejectReason().c_str());
+        }
         BOOST_FOREACH(const COutPoint& hashTx, coins_to_uncache)
             pcoinsTip->Uncache(hashTx);
     }
@@ -957,10 +1057,66 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return AcceptToMemoryPoolWithTime(pool, state, tx, fLimitFree, pfMissingInputs, GetTime(), fOverrideMempoolLimit, nAbsurdFee, fDryRun);
 }
 
+size_t AcceptPackageToMemoryPool(CTxMemPool& pool, const std::vector<CTransactionRef>& vtx, std::vector<CValidationState>& vStates,
+                                 std::vector<bool>& vAccepted, std::vector<bool>& vMissingInputs, bool fLimitFree, const CAmount nAbsurdFee,
+                                 const std::vector<int64_t>* pvAcceptTime)
+{
+    LOCK(cs_main);
+    vStates.assign(vtx.size(), CValidationState());
+    vAccepted.assign(vtx.size(), false);
+    vMissingInputs.assign(vtx.size(), false);
+
+    const int64_t nAcceptTime = GetTime();
+    std::vector<COutPoint> coins_to_uncache;
+    for (size_t i = 0; i < vtx.size(); i++) {
+        // Earlier transactions of the batch are in the pool already, so children find their parents there
+        std::vector<COutPoint> tx_coins_to_uncache;
+        bool fMissingInputs = false;
+        vAccepted[i] = AcceptToMemoryPoolWorker(pool, vStates[i], vtx[i], fLimitFree, &fMissingInputs, pvAcceptTime ? (*pvAcceptTime)[i] : nAcceptTime,
+                                                true, nAbsurdFee, tx_coins_to_uncache, false);
+        if (!vAccepted[i]) {
+            LogPrint("mempool", "%s: %s %s (%s)\n", __func__, vtx[i]->GetHash().ToString(), vStates[i].GetRejectReason(), vStates[i].GetDebugMessage());
+            TRACE2(mempool, rejected, vtx[i]->GetHash().begin(), vStates[i].GetRejectReason().c_str());
+            vMissingInputs[i] = fMissingInputs;
+            coins_to_uncache.insert(coins_to_uncache.end(), tx_coins_to_uncache.begin(), tx_coins_to_uncache.end());
+        }
+    }
+
+    // Trim once for the whole batch instead of after every transaction
+    LimitMempoolSize(pool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+    size_t nAccepted = 0;
+    for (size_t i = 0; i < vtx.size(); i++) {
+        if (!vAccepted[i])
+            continue;
+        if (!pool.exists(vtx[i]->GetHash())) {
+            vAccepted[i] = false;
+            vStates[i].DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
+            continue;
+        }
+        nAccepted++;
+    }
+
+    BOOST_FOREACH(const COutPoint& outpoint, coins_to_uncache)
+        pcoinsTip->Uncache(outpoint);
+    CValidationState stateDummy;
+    FlushStateToDisk(stateDummy, FLUSH_STATE_PERIODIC);
+    return nAccepted;
+}
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes)
 {
-    if (!fTimestampIndex)
-        return error("Timestamp index not enabled");
+    if (!fTimestampIndex) {
+        // the index also has the blocks which were reorged away, the active chain is enough otherwise
+        std::vector<CBlockIndex*> vBlocks;
+        {
+            LOCK(cs_main);
+            chainActive.FindByTimestamp(low, high, vBlocks);
+        }
+        for (const CBlockIndex* pindex : vBlocks) {
+            hashes.push_back(pindex->GetBlockHash());
+        }
+        return true;
+    }
 
     if (!pblocktree->ReadTimestampIndex(high, low, hashes))
         return error("Unable to get hashes for timestamps");
@@ -983,24 +1139,53 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 }
 
 bool GetAddressIndex(uint160 addressHash, int type,
-                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end)
+                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end,
+                     const CAddressIndexKey* pkeyFrom, size_t nMaxEntries)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end, pkeyFrom, nMaxEntries))
         return error("unable to get txids for address");
 
     return true;
 }
 
+bool GetRewardIndex(uint160 addressHash, int type,
+                    std::vector<std::pair<CRewardIndexKey, CAmount> > &rewardIndex, int start, int end,
+                    const CRewardIndexKey* pkeyFrom, size_t nMaxEntries)
+{
+    if (!fRewardIndex)
+        return error("reward index not enabled");
+
+    if (!pblocktree->ReadRewardIndex(addressHash, type, rewardIndex, start, end, pkeyFrom, nMaxEntries))
+        return error("unable to get rewards for address");
+
+    return true;
+}
+
+bool GetAddressBalance(uint160 addressHash, int type, CAmount &balance, CAmount &received)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    CAddressBalanceValue value;
+    if (!pblocktree->ReadAddressBalance(addressHash, type, value))
+        return error("unable to get balance for address");
+
+    balance = value.balance;
+    received = value.received;
+    return true;
+}
+
 bool GetAddressUnspent(uint160 addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       const CAddressUnspentKey* pkeyFrom, size_t nMaxEntries)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
+    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs, pkeyFrom, nMaxEntries))
         return error("unable to get txids for address");
 
     return true;
@@ -1022,7 +1207,7 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
 
     if (fTxIndex) {
         CDiskTxPos postx;
-        if (pblocktree->ReadTxIndex(hash, postx)) {
+        if (ptxindexdb->ReadTxIndex(hash, postx)) {
             CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
             if (file.IsNull())
                 return error("%s: OpenBlockFile failed", __func__);
@@ -1065,6 +1250,121 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
     return false;
 }
 
+/** The merkle levels of recently proven blocks, so proofs for more transactions of them don't read the block again */
+static CCriticalSection cs_merkleLevelsCache;
+static unordered_lru_cache<uint256, CBlockMerkleLevelsCPtr, StaticSaltedHasher, 64> merkleLevelsCache;
+
+CBlockMerkleLevelsCPtr GetBlockMerkleLevels(const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    const uint256 hashBlock = pindex->GetBlockHash();
+    CBlockMerkleLevelsCPtr levels;
+    {
+        LOCK(cs_merkleLevelsCache);
+        if (merkleLevelsCache.get(hashBlock, levels))
+            return levels;
+    }
+
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex, consensusParams))
+        return nullptr;
+    std::vector<uint256> vTxid;
+    vTxid.reserve(block.vtx.size());
+    for (const auto& tx : block.vtx)
+        vTxid.push_back(tx->GetHash());
+    auto newLevels = std::make_shared<CBlockMerkleLevels>();
+    newLevels->header = block.GetBlockHeader();
+    newLevels->vLevels = ComputeMerkleLevels(vTxid);
+
+    LOCK(cs_merkleLevelsCache);
+    merkleLevelsCache.insert(hashBlock, newLevels);
+    return newLevels;
+}
+
+bool GetTxOutProofs(const std::vector<uint256>& vTxids, std::vector<std::pair<CMerkleBlock, std::vector<uint256> > >& vProofs, std::string& strError)
+{
+    LOCK(cs_main);
+
+    // the blocks in the order they first show up, with the txids to prove in each
+    std::vector<std::pair<const CBlockIndex*, std::vector<uint256> > > vBlocks;
+    std::map<const CBlockIndex*, size_t> mapBlocks;
+    // a transaction index lookup only tells the position of the block, its hash is read once per block
+    std::map<std::pair<int, unsigned int>, const CBlockIndex*> mapBlockPos;
+    for (const uint256& txid : vTxids) {
+        const CBlockIndex* pindex = NULL;
+        if (fTxIndex) {
+            CDiskTxPos postx;
+            if (ptxindexdb->ReadTxIndex(txid, postx)) {
+                auto key = std::make_pair(postx.nFile, postx.nPos);
+                auto it = mapBlockPos.find(key);
+                if (it != mapBlockPos.end()) {
+                    pindex = it->second;
+                } else {
+                    CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+                    CBlockHeader header;
+                    try {
+                        if (file.IsNull())
+                            throw std::runtime_error("OpenBlockFile failed");
+                        file >> header;
+                    } catch (const std::exception& e) {
+                        strError = "Can't read block from disk";
+                        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+                    }
+                    BlockMap::const_iterator mi = mapBlockIndex.find(header.GetHash());
+                    if (mi == mapBlockIndex.end()) {
+                        strError = "Transaction index corrupt";
+                        return false;
+                    }
+                    pindex = mi->second;
+                    mapBlockPos.emplace(key, pindex);
+                }
+            }
+        } else {
+            const Coin& coin = AccessByTxid(*pcoinsTip, txid);
+            if (!coin.IsSpent() && coin.nHeight > 0 && coin.nHeight <= chainActive.Height())
+                pindex = chainActive[coin.nHeight];
+        }
+        if (pindex == NULL) {
+            strError = "Transaction not yet in block: " + txid.GetHex();
+            return false;
+        }
+
+        auto it = mapBlocks.emplace(pindex, vBlocks.size()).first;
+        if (it->second == vBlocks.size())
+            vBlocks.emplace_back(pindex, std::vector<uint256>());
+        vBlocks[it->second].second.push_back(txid);
+    }
+
+    vProofs.clear();
+    for (const auto& p : vBlocks) {
+        const CBlockIndex* pindex = p.first;
+        if (fHavePruned && !(pindex->nStatus & BLOCK_HAVE_DATA) && pindex->nTx > 0) {
+            strError = "Block not available (pruned data)";
+            return false;
+        }
+        CBlockMerkleLevelsCPtr levels = GetBlockMerkleLevels(pindex, Params().GetConsensus());
+        if (!levels) {
+            strError = "Can't read block from disk";
+            return false;
+        }
+        std::set<uint256> setTxids(p.second.begin(), p.second.end());
+        const std::vector<uint256>& vTxid = levels->vLevels[0];
+        std::vector<bool> vMatch(vTxid.size(), false);
+        size_t nFound = 0;
+        for (size_t i = 0; i < vTxid.size(); i++) {
+            if (setTxids.count(vTxid[i])) {
+                vMatch[i] = true;
+                nFound++;
+            }
+        }
+        if (nFound != setTxids.size()) {
+            strError = "Transaction index corrupt";
+            return false;
+        }
+        vProofs.emplace_back(CMerkleBlock(levels->header, levels->vLevels, vMatch), p.second);
+    }
+    return true;
+}
+
 
 
 
@@ -1075,43 +1375,209 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
 // CBlock and CBlockIndex
 //
 
-bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+FILE* OpenDiskFile(const CDiskBlockPos &pos, const char *prefix, bool fReadOnly);
+
+namespace {
+
+/**
+ * Keeps the block or undo file that is being appended to open, with a large stdio buffer,
+ * instead of opening, seeking and closing it for every block. Data only reaches the disk
+ * for sure in Commit, which FlushBlockFile calls, so fsyncs still only happen when the
+ * block file info gets written out (or the file is finished). Anything opening the file
+ * goes through OpenBlockFile/OpenUndoFile, which flush the buffer first.
+ */
+class CBlockFileWriter
 {
-    // Open history file to append
-    CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("WriteBlockToDisk: OpenBlockFile failed");
+private:
+    CCriticalSection cs;
+    const char* prefix;
+    FILE* file;
+    int nFile;
+    //! Position in file after the last write
+    unsigned int nPos;
+
+    void CloseFile()
+    {
+        if (file)
+            fclose(file);
+        file = NULL;
+        nFile = -1;
+    }
 
-    // Write index header
-    unsigned int nSize = GetSerializeSize(fileout, block);
-    fileout << FLATDATA(messageStart) << nSize;
+public:
+    CBlockFileWriter(const char* prefixIn) : prefix(prefixIn), file(NULL), nFile(-1), nPos(0) {}
+    ~CBlockFileWriter() { Close(); }
 
-    // Write block
-    long fileOutPos = ftell(fileout.Get());
-    if (fileOutPos < 0)
-        return error("WriteBlockToDisk: ftell failed");
-    pos.nPos = (unsigned int)fileOutPos;
-    fileout << block;
+    //! Write data at the given position
+    bool Write(const CDiskBlockPos& pos, const CDataStream& data)
+    {
+        LOCK(cs);
+        if (!file || nFile != pos.nFile) {
+            CloseFile();
+            file = OpenDiskFile(CDiskBlockPos(pos.nFile, 0), prefix, false);
+            if (!file)
+                return false;
+            setvbuf(file, NULL, _IOFBF, BLOCKFILE_WRITE_BUFFER_SIZE);
+            nFile = pos.nFile;
+            nPos = 0;
+        }
+        if (nPos != pos.nPos) {
+            if (fseek(file, pos.nPos, SEEK_SET)) {
+                CloseFile();
+                return false;
+            }
+        }
+        if (fwrite(data.data(), 1, data.size(), file) != data.size()) {
+            CloseFile();
+            return false;
+        }
+        nPos = pos.nPos + data.size();
+        return true;
+    }
 
-    return true;
-}
+    //! Hand buffered data for the given file to the OS, before somebody else opens it
+    void Flush(int nFileIn)
+    {
+        LOCK(cs);
+        if (file && nFile == nFileIn)
+            fflush(file);
+    }
 
-#if __APPLE__
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams) {
-#else
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, const char* str) {
+    //! Flush the given file to disk, truncating it to nSize first if fFinalize is set
+    void Commit(int nFileIn, bool fFinalize, unsigned int nSize)
+    {
+        LOCK(cs);
+        // Undo data can go to older files, it has to be on disk before the index refers to it
+        if (file && nFile != nFileIn)
+            FileCommit(file);
+        FILE* fileCommit = (file && nFile == nFileIn) ? file : OpenDiskFile(CDiskBlockPos(nFileIn, 0), prefix, false);
+        if (!fileCommit)
+            return;
+        if (fFinalize) {
+            fflush(fileCommit);
+            TruncateFile(fileCommit, nSize);
+        }
+        FileCommit(fileCommit);
+        if (fileCommit != file)
+            fclose(fileCommit);
+        else if (fFinalize)
+            CloseFile();
+    }
+
+    void Close()
+    {
+        LOCK(cs);
+        CloseFile();
+    }
+};
+
+CBlockFileWriter blockFileWriter("blk");
+CBlockFileWriter undoFileWriter("rev");
+
+#ifndef WIN32
+/**
+ * Read-only memory maps of the completed block files for -mmapblocks, so reading a historical
+ * block is a copy out of the page cache instead of an open, seek, read and close of the file.
+ * The file being appended to is never mapped. At most MAX_MAPPED_BLOCK_FILES are kept, the least
+ * recently used one is dropped beyond that, and readers hold on to a mapping until they are done.
+ */
+class CBlockFileMapper
+{
+public:
+    struct Mapping
+    {
+        const unsigned char* data;
+        size_t size;
+
+        Mapping(const unsigned char* dataIn, size_t sizeIn) : data(dataIn), size(sizeIn) {}
+        ~Mapping() { munmap(const_cast<unsigned char*>(data), size); }
+    };
+
+private:
+    static const size_t MAX_MAPPED_BLOCK_FILES = 64;
+
+    CCriticalSection cs;
+    //! Most recently used first
+    std::list<std::pair<int, std::shared_ptr<const Mapping> > > listMapped;
+
+public:
+    std::shared_ptr<const Mapping> Get(int nFile)
+    {
+        LOCK(cs);
+        for (auto it = listMapped.begin(); it != listMapped.end(); ++it) {
+            if (it->first == nFile) {
+                listMapped.splice(listMapped.begin(), listMapped, it);
+                return it->second;
+            }
+        }
+
+        FILE* file = OpenDiskFile(CDiskBlockPos(nFile, 0), "blk", true);
+        if (!file)
+            return nullptr;
+        struct stat st;
+        void* p = MAP_FAILED;
+        if (fstat(fileno(file), &st) == 0 && st.st_size > 0)
+            p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fileno(file), 0);
+        // the mapping stays valid without the descriptor
+        fclose(file);
+        if (p == MAP_FAILED) {
+            LogPrintf("%s: unable to map block file %05u, reading it without\n", __func__, nFile);
+            return nullptr;
+        }
+
+        auto mapping = std::make_shared<const Mapping>(static_cast<const unsigned char*>(p), (size_t)st.st_size);
+        listMapped.emplace_front(nFile, mapping);
+        if (listMapped.size() > MAX_MAPPED_BLOCK_FILES)
+            listMapped.pop_back();
+        return mapping;
+    }
+
+    //! Drops the mapping of a file that is about to be deleted
+    void Remove(int nFile)
+    {
+        LOCK(cs);
+        listMapped.remove_if([nFile](const std::pair<int, std::shared_ptr<const Mapping> >& p) { return p.first == nFile; });
+    }
+};
+
+CBlockFileMapper blockFileMapper;
 #endif
-    LOCK(cs_main);
-    block.SetNull();
 
-    // Open history file to read
+/**
+ * Calls read with a stream positioned at pos in the block files and returns its result. The
+ * stream reads from a memory map when fComplete says nothing gets appended to the file anymore.
+ */
+template <typename Reader>
+bool ReadFromBlockFile(const CDiskBlockPos& pos, bool fComplete, Reader read)
+{
+#ifndef WIN32
+    if (fMapBlockFiles && fComplete) {
+        std::shared_ptr<const CBlockFileMapper::Mapping> mapping = blockFileMapper.Get(pos.nFile);
+        if (mapping) {
+            if (pos.nPos >= mapping->size)
+                return error("%s: %s is beyond the end of the file", __func__, pos.ToString());
+            CSpanReader stream(SER_DISK, CLIENT_VERSION, Span<const unsigned char>(mapping->data + pos.nPos, mapping->size - pos.nPos));
+            return read(stream);
+        }
+    }
+#endif
     CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+    return read(filein);
+}
+
+} // namespace
+
+/** ReadBlockFromDisk without cs_main, fComplete tells whether nothing is appended to the file of pos anymore */
+static bool ReadBlockFromFile(CBlock& block, const CDiskBlockPos& pos, bool fComplete, const Consensus::Params& consensusParams)
+{
+    block.SetNull();
 
     // Read block
     try {
-        filein >> block;
+        if (!ReadFromBlockFile(pos, fComplete, [&block](auto& stream) { stream >> block; return true; }))
+            return false;
     }
     catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
@@ -1124,6 +1590,31 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
     return true;
 }
 
+bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+{
+    // Write index header and block
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    unsigned int nSize = GetSerializeSize(ss, block);
+    ss.reserve(sizeof(CMessageHeader::MessageStartChars) + sizeof(nSize) + nSize);
+    ss << FLATDATA(messageStart) << nSize << block;
+
+    // Append to history file
+    if (!blockFileWriter.Write(pos, ss))
+        return error("WriteBlockToDisk: writing to %s failed", pos.ToString());
+    pos.nPos += sizeof(CMessageHeader::MessageStartChars) + sizeof(nSize);
+
+    return true;
+}
+
+#if __APPLE__
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams) {
+#else
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, const char* str) {
+#endif
+    LOCK(cs_main);
+    return ReadBlockFromFile(block, pos, (int)pos.nFile < nLastBlockFile, consensusParams);
+}
+
 #if __APPLE__
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams) {
 #else
@@ -1144,6 +1635,59 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart)
+{
+    CDiskBlockPos blockPos;
+    uint256 hash;
+    bool fComplete;
+    {
+        LOCK(cs_main);
+        blockPos = pindex->GetBlockPos();
+        hash = pindex->GetBlockHash();
+        fComplete = (int)blockPos.nFile < nLastBlockFile;
+    }
+
+    // the block is preceded by the message start and its size, see WriteBlockToDisk
+    unsigned int nSize;
+    if (blockPos.nPos < sizeof(CMessageHeader::MessageStartChars) + sizeof(nSize))
+        return error("%s: invalid block position %s", __func__, blockPos.ToString());
+    blockPos.nPos -= sizeof(CMessageHeader::MessageStartChars) + sizeof(nSize);
+
+    try {
+        bool fRead = ReadFromBlockFile(blockPos, fComplete, [&](auto& stream) {
+            CMessageHeader::MessageStartChars blkMessageStart;
+            stream >> FLATDATA(blkMessageStart) >> nSize;
+            if (memcmp(blkMessageStart, messageStart, sizeof(CMessageHeader::MessageStartChars)))
+                return error("%s: block at %s has the wrong message start", "ReadRawBlockFromDisk", blockPos.ToString());
+            if (nSize < 80 || nSize > MAX_SIZE)
+                return error("%s: block at %s has an invalid size %u", "ReadRawBlockFromDisk", blockPos.ToString(), nSize);
+
+            vchBlock.resize(nSize);
+            stream.read((char*)vchBlock.data(), nSize);
+            return true;
+        });
+        if (!fRead)
+            return false;
+    }
+    catch (const std::exception& e) {
+        return error("%s: Read or I/O error - %s at %s", __func__, e.what(), blockPos.ToString());
+    }
+
+    // only the header gets decoded, to check the data belongs to the index entry
+    CBlockHeader header;
+    try {
+        CDataStream ssHeader((const char*)vchBlock.data(), (const char*)vchBlock.data() + 80, SER_DISK, CLIENT_VERSION);
+        ssHeader >> header;
+    }
+    catch (const std::exception& e) {
+        return error("%s: Deserialize error - %s at %s", __func__, e.what(), blockPos.ToString());
+    }
+    if (header.GetHash() != hash)
+        return error("%s: GetHash() doesn't match index for %s at %s", __func__, pindex->ToString(), blockPos.ToString());
+
+    return true;
+}
+
 double ConvertBitsToDouble(unsigned int nBits)
 {
     int nShift = (nBits >> 24) & 0xff;
@@ -1369,7 +1913,7 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight)
 
 bool CScriptCheck::operator()() {
     const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
-    if (!VerifyScript(scriptSig, scriptPubKey, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, cacheStore), &error)) {
+    if (!VerifyScript(scriptSig, scriptPubKey, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, cacheStore, txdata), &error)) {
         return false;
     }
     return true;
@@ -1430,7 +1974,7 @@ bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoins
 }
 }// namespace Consensus
 
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheStore, std::vector<CScriptCheck> *pvChecks)
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheStore, std::vector<CScriptCheck> *pvChecks, PrecomputedTransactionData* txdata)
 {
     if (!tx.IsCoinBase())
     {
@@ -1467,7 +2011,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                 const CAmount amount = coin.out.nValue;
 
                 // Verify signature
-                CScriptCheck check(scriptPubKey, amount, tx, i, flags, cacheStore);
+                CScriptCheck check(scriptPubKey, amount, tx, i, flags, cacheStore, txdata);
                 if (pvChecks) {
                     pvChecks->push_back(CScriptCheck());
                     check.swap(pvChecks->back());
@@ -1480,7 +2024,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                         // avoid splitting the network between upgraded and
                         // non-upgraded nodes.
                         CScriptCheck check2(scriptPubKey, amount, tx, i,
-                                flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore);
+                                flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore, txdata);
                         if (check2())
                             return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
                     }
@@ -1504,31 +2048,28 @@ namespace {
 
 bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
 {
-    // Open history file to append
-    CAutoFile fileout(OpenUndoFile(pos), SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s: OpenUndoFile failed", __func__);
-
-    // Write index header
-    unsigned int nSize = GetSerializeSize(fileout, blockundo);
-    fileout << FLATDATA(messageStart) << nSize;
-
-    // Write undo data
-    long fileOutPos = ftell(fileout.Get());
-    if (fileOutPos < 0)
-        return error("%s: ftell failed", __func__);
-    pos.nPos = (unsigned int)fileOutPos;
-    fileout << blockundo;
+    // Write index header and undo data
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    unsigned int nSize = GetSerializeSize(ss, blockundo);
+    ss.reserve(sizeof(CMessageHeader::MessageStartChars) + sizeof(nSize) + nSize + sizeof(uint256));
+    ss << FLATDATA(messageStart) << nSize << blockundo;
 
     // calculate & write checksum
     CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
     hasher << hashBlock;
     hasher << blockundo;
-    fileout << hasher.GetHash();
+    ss << hasher.GetHash();
+
+    // Append to undo file
+    if (!undoFileWriter.Write(pos, ss))
+        return error("%s: writing to %s failed", __func__, pos.ToString());
+    pos.nPos += sizeof(CMessageHeader::MessageStartChars) + sizeof(nSize);
 
     return true;
 }
 
+} // anon namespace
+
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
 {
     // Open history file to read
@@ -1555,32 +2096,176 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uin
     return true;
 }
 
-/** Abort with a message */
-bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
-{
-    SetMiscWarning(strMessage);
-    LogPrintf("*** %s\n", strMessage);
-    uiInterface.ThreadSafeMessageBox(
-        userMessage.empty() ? _("Error: A fatal internal error occurred, see debug.log for details") : userMessage,
-        "", CClientUIInterface::MSG_ERROR);
-    StartShutdown();
-    return false;
-}
+namespace {
 
-bool AbortNode(CValidationState& state, const std::string& strMessage, const std::string& userMessage="")
+static void GetScriptAddress(const CScript& script, uint160& hashBytes, int& addressType)
 {
-    AbortNode(strMessage, userMessage);
-    return state.Error(strMessage);
+    if (script.IsPayToScriptHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(script.begin()+2, script.begin()+22));
+        addressType = 2;
+    } else if (script.IsPayToPublicKeyHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(script.begin()+3, script.begin()+23));
+        addressType = 1;
+    } else if (script.IsPayToPublicKey()) {
+        hashBytes = Hash160(script.begin()+1, script.end()-1);
+        addressType = 1;
+    } else {
+        hashBytes.SetNull();
+        addressType = 0;
+    }
 }
 
 } // anon namespace
 
-enum DisconnectResult
+void GetBlockRewards(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& blockUndo,
+                     std::vector<CBlockReward>& vRewards)
 {
-    DISCONNECT_OK,      // All good.
-    DISCONNECT_UNCLEAN, // Rolled back, but UTXO set was inconsistent with block.
-    DISCONNECT_FAILED   // Something else went wrong.
-};
+    bool fProofOfStake = block.IsProofOfStake();
+    size_t nRewardTx = fProofOfStake ? 1 : 0;
+    if (block.vtx.size() <= nRewardTx)
+        return;
+    // the reward transaction pays the miner or staker first, the masternode and superblock outputs follow
+    const CTransaction& txReward = *block.vtx[nRewardTx];
+    if (txReward.vout.size() <= nRewardTx)
+        return;
+    const CScript& scriptStaker = txReward.vout[nRewardTx].scriptPubKey;
+    CScript scriptPayout, scriptOperatorPayout;
+    CDeterministicMNCPtr payee = pindex->pprev ? mnpayments.GetBlockPayee(pindex->pprev) : nullptr;
+    if (payee) {
+        scriptPayout = payee->pdmnState->scriptPayout;
+        scriptOperatorPayout = payee->pdmnState->scriptOperatorPayout;
+    }
+    bool fSuperblockHeight = CSuperblock::IsValidBlockHeight(pindex->nHeight);
+
+    CAmount nStakeReward = 0;
+    for (size_t j = nRewardTx; j < txReward.vout.size(); j++) {
+        const CTxOut& txout = txReward.vout[j];
+        if (txout.scriptPubKey == scriptStaker) {
+            nStakeReward += txout.nValue;
+        } else if (payee && (txout.scriptPubKey == scriptPayout || (!scriptOperatorPayout.empty() && txout.scriptPubKey == scriptOperatorPayout))) {
+            vRewards.emplace_back(REWARD_MASTERNODE, txout.scriptPubKey, j, txout.nValue);
+        } else if (fSuperblockHeight) {
+            vRewards.emplace_back(REWARD_SUPERBLOCK, txout.scriptPubKey, j, txout.nValue);
+        } else {
+            vRewards.emplace_back(REWARD_OTHER, txout.scriptPubKey, j, txout.nValue);
+        }
+    }
+    if (fProofOfStake && !blockUndo.vtxundo.empty()) {
+        for (const Coin& coin : blockUndo.vtxundo[0].vprevout)
+            nStakeReward -= coin.out.nValue;
+    }
+    vRewards.emplace(vRewards.begin(), REWARD_STAKE, scriptStaker, nRewardTx, nStakeReward);
+}
+
+// The reward index entries of a block, only for scripts the address index knows as well
+static void GetRewardIndexEntries(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& blockUndo,
+                                  std::vector<std::pair<CRewardIndexKey, CAmount> >& rewardIndex)
+{
+    std::vector<CBlockReward> vRewards;
+    GetBlockRewards(block, pindex, blockUndo, vRewards);
+    for (const CBlockReward& reward : vRewards) {
+        uint160 hashBytes;
+        int addressType;
+        GetScriptAddress(reward.scriptPubKey, hashBytes, addressType);
+        if (addressType == 0)
+            continue;
+        rewardIndex.push_back(std::make_pair(CRewardIndexKey(addressType, hashBytes, pindex->nHeight, reward.nType, reward.nIndex), reward.nAmount));
+    }
+}
+
+bool GetBlockIndexEntries(const CBlockIndex* pindex, bool fAddress, bool fSpent,
+                          std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex,
+                          std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& addressUnspentIndex,
+                          std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& spentIndex)
+{
+    // The genesis block is never connected, so it has no index entries either
+    if (!pindex->pprev)
+        return true;
+
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus()))
+        return error("%s: failed to read block %s", __func__, pindex->GetBlockHash().ToString());
+
+    CBlockUndo blockUndo;
+    CDiskBlockPos pos = pindex->GetUndoPos();
+    if (pos.IsNull() || !UndoReadFromDisk(blockUndo, pos, pindex->pprev->GetBlockHash()))
+        return error("%s: failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+    if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s: block and undo data of block %s inconsistent", __func__, pindex->GetBlockHash().ToString());
+
+    // Same entries, in the same order, as ConnectBlock
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        const uint256 txhash = tx.GetHash();
+
+        if (!tx.IsCoinBase()) {
+            const CTxUndo& txundo = blockUndo.vtxundo[i - 1];
+            if (txundo.vprevout.size() != tx.vin.size())
+                return error("%s: undo data of transaction %s inconsistent", __func__, txhash.ToString());
+
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                const COutPoint& prevout = tx.vin[j].prevout;
+                const CTxOut& out = txundo.vprevout[j].out;
+                uint160 hashBytes;
+                int addressType;
+                GetScriptAddress(out.scriptPubKey, hashBytes, addressType);
+
+                if (fAddress && addressType > 0) {
+                    addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, j, true), out.nValue * -1));
+                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, prevout.hash, prevout.n), CAddressUnspentValue()));
+                }
+                if (fSpent) {
+                    spentIndex.push_back(std::make_pair(CSpentIndexKey(prevout.hash, prevout.n), CSpentIndexValue(txhash, j, pindex->nHeight, out.nValue, addressType, hashBytes)));
+                }
+            }
+        }
+
+        if (fAddress) {
+            for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                const CTxOut& out = tx.vout[k];
+                uint160 hashBytes;
+                int addressType;
+                GetScriptAddress(out.scriptPubKey, hashBytes, addressType);
+                if (addressType == 0)
+                    continue;
+
+                addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
+                addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
+            }
+        }
+    }
+
+    return true;
+}
+
+namespace {
+
+/** Abort with a message */
+bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
+{
+    SetMiscWarning(strMessage);
+    LogPrintf("*** %s\n", strMessage);
+    uiInterface.ThreadSafeMessageBox(
+        userMessage.empty() ? _("Error: A fatal internal error occurred, see debug.log for details") : userMessage,
+        "", CClientUIInterface::MSG_ERROR);
+    StartShutdown();
+    return false;
+}
+
+bool AbortNode(CValidationState& state, const std::string& strMessage, const std::string& userMessage="")
+{
+    AbortNode(strMessage, userMessage);
+    return state.Error(strMessage);
+}
+
+} // anon namespace
+
+enum DisconnectResult
+{
+    DISCONNECT_OK,      // All good.
+    DISCONNECT_UNCLEAN, // Rolled back, but UTXO set was inconsistent with block.
+    DISCONNECT_FAILED   // Something else went wrong.
+};
 
 /**
  * Restore the UTXO in a Coin at a given COutPoint
@@ -1753,8 +2438,12 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
 
                     } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
                         uint160 hashBytes(Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1));
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, pindex->nHeight, i, hash, j, false), prevout.nValue));
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, hash, j), CAddressUnspentValue()));
+
+                        // undo spending activity, with the same key ConnectBlock used
+                        addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, pindex->nHeight, i, hash, j, true), prevout.nValue * -1));
+
+                        // restore unspent index
+                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, input.prevout.hash, input.prevout.n), CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undoHeight)));
                     } else {
                         continue;
                     }
@@ -1768,20 +2457,13 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
-    if (fSpentIndex) {
-        if (!pblocktree->UpdateSpentIndex(spentIndex)) {
-            AbortNode("Failed to delete spent index");
-            return DISCONNECT_FAILED;
-        }
-    }
-
-    if (fAddressIndex) {
-        if (!pblocktree->EraseAddressIndex(addressIndex)) {
-            AbortNode(state, "Failed to delete address index");
-            return DISCONNECT_FAILED;
-        }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            AbortNode(state, "Failed to write address unspent index");
+    if (fSpentIndex || fAddressIndex || fRewardIndex) {
+        // the vectors are only filled for the enabled indexes
+        std::vector<std::pair<CRewardIndexKey, CAmount> > rewardIndex;
+        if (fRewardIndex)
+            GetRewardIndexEntries(block, pindex, blockUndo, rewardIndex);
+        if (!pblocktree->WriteBlockIndexes(addressIndex, true, addressUnspentIndex, spentIndex, rewardIndex, nullptr)) {
+            AbortNode(state, "Failed to undo block indexes");
             return DISCONNECT_FAILED;
         }
     }
@@ -1799,34 +2481,62 @@ void static FlushBlockFile(bool fFinalize = false)
 {
     LOCK(cs_LastBlockFile);
 
-    CDiskBlockPos posOld(nLastBlockFile, 0);
-
-    FILE *fileOld = OpenBlockFile(posOld);
-    if (fileOld) {
-        if (fFinalize)
-            TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nSize);
-        FileCommit(fileOld);
-        fclose(fileOld);
-    }
-
-    fileOld = OpenUndoFile(posOld);
-    if (fileOld) {
-        if (fFinalize)
-            TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nUndoSize);
-        FileCommit(fileOld);
-        fclose(fileOld);
-    }
+    blockFileWriter.Commit(nLastBlockFile, fFinalize, vinfoBlockFile[nLastBlockFile].nSize);
+    undoFileWriter.Commit(nLastBlockFile, fFinalize, vinfoBlockFile[nLastBlockFile].nUndoSize);
 }
 
 bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigned int nAddSize);
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+static CCheckQueue<CScriptCheck> scriptcheckqueue(DEFAULT_SCRIPTCHECK_BATCH_SIZE);
+
+bool InitScriptCheckQueue(unsigned int nBatchSize, bool fWorkStealing)
+{
+    scriptcheckqueue.Configure(nBatchSize, fWorkStealing ? nScriptCheckThreads : 0);
+    return scriptcheckqueue.IsWorkStealing();
+}
 
 void ThreadScriptCheck() {
     RenameThread("epmcoin-scriptch");
     scriptcheckqueue.Thread();
 }
 
+/**
+ * CheckInputs for the mempool, with the scripts of transactions with many inputs spread over
+ * the script check threads instead of being verified one after the other while holding
+ * cs_main. The queue only says whether all passed, so a failure is checked again serially to
+ * fill in the exact reject reason. Valid signatures are in the signature cache by then, which
+ * also keeps the MANDATORY_SCRIPT_VERIFY_FLAGS pass that follows cheap.
+ */
+static bool CheckInputsParallel(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, unsigned int flags, PrecomputedTransactionData& txdata)
+{
+    if (nScriptCheckThreads == 0 || tx.vin.size() < MIN_PARALLEL_SCRIPTCHECK_INPUTS)
+        return CheckInputs(tx, state, view, true, flags, true, NULL, &txdata);
+
+    std::vector<CScriptCheck> vChecks;
+    if (!CheckInputs(tx, state, view, true, flags, true, &vChecks, &txdata))
+        return false;
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    if (control.Wait())
+        return true;
+    return CheckInputs(tx, state, view, true, flags, true, NULL, &txdata);
+}
+
+bool RunScriptChecks(std::vector<CScriptCheck>& vChecks)
+{
+    if (nScriptCheckThreads == 0 || vChecks.size() < MIN_PARALLEL_SCRIPTCHECK_INPUTS) {
+        for (auto& check : vChecks) {
+            if (!check())
+                return false;
+        }
+        return true;
+    }
+
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    return control.Wait();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1901,11 +2611,108 @@ static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
+static const char* const BLOCK_STAGE_NAMES[BLOCK_STAGE_COUNT] = {
+    "checkproofofstake",
+    "readfromdisk",
+    "check",
+    "forks",
+    "connecttxs",
+    "verify",
+    "isfilter",
+    "subsidy",
+    "valuevalid",
+    "payeevalid",
+    "specialtxloop",
+    "quorumblockprocessor",
+    "deterministicmns",
+    "cbtxmerkleroots",
+    "processspecial",
+    "epmcoinspecific",
+    "index",
+    "callbacks",
+    "connectblock",
+    "flush",
+    "chainstate",
+    "postconnect",
+    "total",
+};
+
+struct CBlockStageTimes {
+    CTimeHistogram histogram;
+    int64_t nLast = 0;
+    //! Ring buffer of the last BLOCK_STATS_WINDOW times
+    std::vector<int64_t> vWindow;
+    size_t nWindowPos = 0;
+};
+
+static CCriticalSection cs_blockStageTimes;
+static CBlockStageTimes blockStageTimes[BLOCK_STAGE_COUNT]; // protected by cs_blockStageTimes
+
+void RecordBlockStageTime(BlockProcessingStage stage, int64_t nMicros)
+{
+    assert(stage < BLOCK_STAGE_COUNT);
+    TRACE2(validation, block_stage, BLOCK_STAGE_NAMES[stage], nMicros);
+    LOCK(cs_blockStageTimes);
+    CBlockStageTimes& times = blockStageTimes[stage];
+    times.histogram.Add(nMicros);
+    times.nLast = nMicros;
+    if (times.vWindow.size() < BLOCK_STATS_WINDOW) {
+        times.vWindow.push_back(nMicros);
+    } else {
+        times.vWindow[times.nWindowPos] = nMicros;
+        times.nWindowPos = (times.nWindowPos + 1) % BLOCK_STATS_WINDOW;
+    }
+}
+
+std::vector<CBlockProcessingStageStats> GetBlockProcessingStats()
+{
+    std::vector<CBlockProcessingStageStats> vStats(BLOCK_STAGE_COUNT);
+    std::vector<int64_t> vSorted;
+    LOCK(cs_blockStageTimes);
+    for (int i = 0; i < BLOCK_STAGE_COUNT; i++) {
+        const CBlockStageTimes& times = blockStageTimes[i];
+        CBlockProcessingStageStats& stats = vStats[i];
+        stats.strStage = BLOCK_STAGE_NAMES[i];
+        stats.nCount = times.histogram.nCount;
+        stats.nTimeTotal = times.histogram.nTotal;
+        stats.nTimeMax = times.histogram.nMax;
+        stats.nTimeP50 = times.histogram.Percentile(0.5);
+        stats.nTimeP99 = times.histogram.Percentile(0.99);
+        stats.nTimeLast = times.nLast;
+
+        vSorted = times.vWindow;
+        std::sort(vSorted.begin(), vSorted.end());
+        auto percentile = [&](double q) -> int64_t {
+            if (vSorted.empty()) return 0;
+            size_t nRank = std::max<size_t>(1, std::ceil(vSorted.size() * q));
+            return vSorted[nRank - 1];
+        };
+        stats.nWindowCount = vSorted.size();
+        stats.nWindowTotal = 0;
+        for (int64_t nTime : vSorted) {
+            stats.nWindowTotal += nTime;
+        }
+        stats.nWindowMax = vSorted.empty() ? 0 : vSorted.back();
+        stats.nWindowP50 = percentile(0.5);
+        stats.nWindowP99 = percentile(0.99);
+    }
+    return vStats;
+}
+
+void ResetBlockProcessingStats()
+{
+    LOCK(cs_blockStageTimes);
+    for (auto& times : blockStageTimes) {
+        times = CBlockStageTimes();
+    }
+}
+
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
 static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
-                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false)
+                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false,
+                  CBlockUndo* pblockundoOut = NULL)
 {
     AssertLockHeld(cs_main);
     assert(pindex);
@@ -1974,8 +2781,15 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
             }
         }
     }
+    if (fScriptChecks && fAssumeChainLocked && !fJustCheck && pindex->phashBlock &&
+        llmq::chainLocksHandler->HasChainLock(pindex->nHeight, pindex->GetBlockHash())) {
+        // A verified ChainLock covers this block, so the signing quorum has already accepted it and no other chain can
+        // replace it. This is mostly hit when catching up after downtime, where the ChainLock arrives before the blocks
+        fScriptChecks = false;
+    }
 
     int64_t nTime1 = GetTimeMicros(); nTimeCheck += nTime1 - nTimeStart;
+    RecordBlockStageTime(BLOCK_STAGE_CHECK, nTime1 - nTimeStart);
     LogPrint("bench", "    - Sanity checks: %.2fms [%.2fs]\n", 0.001 * (nTime1 - nTimeStart), nTimeCheck * 0.000001);
 
     // Do not allow blocks that contain transactions which 'overwrite' older transactions,
@@ -2052,10 +2866,14 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     }
 
     int64_t nTime2 = GetTimeMicros(); nTimeForks += nTime2 - nTime1;
+    RecordBlockStageTime(BLOCK_STAGE_FORKS, nTime2 - nTime1);
     LogPrint("bench", "    - Fork checks: %.2fms [%.2fs]\n", 0.001 * (nTime2 - nTime1), nTimeForks * 0.000001);
 
     CBlockUndo blockundo;
 
+    // Declared before control, whose destructor still waits for the checks pointing into it
+    std::vector<PrecomputedTransactionData> txdata;
+    txdata.reserve(block.vtx.size());
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
 
     std::vector<int> prevheights;
@@ -2068,8 +2886,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
     vPos.reserve(block.vtx.size());
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
-    std::vector<PrecomputedTransactionData> txdata;
-    txdata.reserve(block.vtx.size());
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
     std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
@@ -2170,7 +2986,7 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
 
             std::vector<CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, nScriptCheckThreads ? &vChecks : NULL))
+            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, nScriptCheckThreads ? &vChecks : NULL, &txdata.back()))
                 return error("ConnectBlock(): CheckInputs on %s failed with %s",
                     tx.GetHash().ToString(), FormatStateMessage(state));
             control.Add(vChecks);
@@ -2227,11 +3043,13 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     pindex->nMint = pindex->nMoneySupply - nMoneySupplyPrev;
 
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
+    RecordBlockStageTime(BLOCK_STAGE_CONNECT_TXS, nTime3 - nTime2);
     LogPrint("bench", "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs]\n", (unsigned)block.vtx.size(), 0.001 * (nTime3 - nTime2), 0.001 * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : 0.001 * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * 0.000001);
 
     if (!control.Wait())
         return state.DoS(100, false);
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
+    RecordBlockStageTime(BLOCK_STAGE_VERIFY, nTime4 - nTime2);
     LogPrint("bench", "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]\n", nInputs - 1, 0.001 * (nTime4 - nTime2), nInputs <= 1 ? 0 : 0.001 * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * 0.000001);
 
 
@@ -2283,6 +3101,7 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     }
 
     int64_t nTime5_1 = GetTimeMicros(); nTimeISFilter += nTime5_1 - nTime4;
+    RecordBlockStageTime(BLOCK_STAGE_IS_FILTER, nTime5_1 - nTime4);
     LogPrint("bench", "      - IS filter: %.2fms [%.2fs]\n", 0.001 * (nTime5_1 - nTime4), nTimeISFilter * 0.000001);
 
     // EPM : MODIFIED TO CHECK MASTERNODE PAYMENTS AND SUPERBLOCKS
@@ -2292,6 +3111,7 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     std::string strError = "";
 
     int64_t nTime5_2 = GetTimeMicros(); nTimeSubsidy += nTime5_2 - nTime5_1;
+    RecordBlockStageTime(BLOCK_STAGE_SUBSIDY, nTime5_2 - nTime5_1);
     LogPrint("bench", "      - GetBlockSubsidy: %.2fms [%.2fs]\n", 0.001 * (nTime5_2 - nTime5_1), nTimeSubsidy * 0.000001);
 
     if (!IsBlockValueValid(block, pindex->nHeight, blockReward, strError)) {
@@ -2299,6 +3119,7 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     }
 
     int64_t nTime5_3 = GetTimeMicros(); nTimeValueValid += nTime5_3 - nTime5_2;
+    RecordBlockStageTime(BLOCK_STAGE_VALUE_VALID, nTime5_3 - nTime5_2);
     LogPrint("bench", "      - IsBlockValueValid: %.2fms [%.2fs]\n", 0.001 * (nTime5_3 - nTime5_2), nTimeValueValid * 0.000001);
 
     bool isProofOfStake = !block.IsProofOfWork();
@@ -2311,6 +3132,7 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     }
 
     int64_t nTime5_4 = GetTimeMicros(); nTimePayeeValid += nTime5_4 - nTime5_3;
+    RecordBlockStageTime(BLOCK_STAGE_PAYEE_VALID, nTime5_4 - nTime5_3);
     LogPrint("bench", "      - IsBlockPayeeValid: %.2fms [%.2fs]\n", 0.001 * (nTime5_4 - nTime5_3), nTimePayeeValid * 0.000001);
 
     if (!ProcessSpecialTxsInBlock(block, pindex, state, fJustCheck, fScriptChecks)) {
@@ -2318,9 +3140,11 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     }
 
     int64_t nTime5_5 = GetTimeMicros(); nTimeProcessSpecial += nTime5_5 - nTime5_4;
+    RecordBlockStageTime(BLOCK_STAGE_PROCESS_SPECIAL, nTime5_5 - nTime5_4);
     LogPrint("bench", "      - ProcessSpecialTxsInBlock: %.2fms [%.2fs]\n", 0.001 * (nTime5_5 - nTime5_4), nTimeProcessSpecial * 0.000001);
 
     int64_t nTime5 = GetTimeMicros(); nTimeEPMCoinSpecific += nTime5 - nTime4;
+    RecordBlockStageTime(BLOCK_STAGE_EPMCOIN_SPECIFIC, nTime5 - nTime4);
     LogPrint("bench", "    - EPMCoin specific: %.2fms [%.2fs]\n", 0.001 * (nTime5 - nTime4), nTimeEPMCoinSpecific * 0.000001);
 
     // END EPM
@@ -2347,32 +3171,26 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         setDirtyBlockIndex.insert(pindex);
     }
 
-    if (fTxIndex)
-        if (!pblocktree->WriteTxIndex(vPos))
-            return AbortNode(state, "Failed to write transaction index");
-
-    if (fAddressIndex) {
-        if (!pblocktree->WriteAddressIndex(addressIndex)) {
-            return AbortNode(state, "Failed to write address index");
-        }
-
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            return AbortNode(state, "Failed to write address unspent index");
-        }
+    // All indexes of the block go into a single batch, the address and spent index vectors are
+    // only filled when those indexes are enabled
+    if (fAddressIndex || fSpentIndex || fTimestampIndex || fRewardIndex) {
+        CTimestampIndexKey timestampIndex(pindex->nTime, pindex->GetBlockHash());
+        std::vector<std::pair<CRewardIndexKey, CAmount> > rewardIndex;
+        if (fRewardIndex)
+            GetRewardIndexEntries(block, pindex, blockundo, rewardIndex);
+        if (!pblocktree->WriteBlockIndexes(addressIndex, false, addressUnspentIndex, spentIndex, rewardIndex,
+                                           fTimestampIndex ? &timestampIndex : nullptr))
+            return AbortNode(state, "Failed to write block indexes");
     }
-
-    if (fSpentIndex)
-        if (!pblocktree->UpdateSpentIndex(spentIndex))
-            return AbortNode(state, "Failed to write transaction index");
-
-    if (fTimestampIndex)
-        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
-            return AbortNode(state, "Failed to write timestamp index");
+    // the txindex is written in the background
+    if (fTxIndex)
+        ptxindexdb->AddBlock(pindex->GetBlockHash(), std::move(vPos));
 
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
     int64_t nTime6 = GetTimeMicros(); nTimeIndex += nTime6 - nTime5;
+    RecordBlockStageTime(BLOCK_STAGE_INDEX, nTime6 - nTime5);
     LogPrint("bench", "    - Index writing: %.2fms [%.2fs]\n", 0.001 * (nTime6 - nTime5), nTimeIndex * 0.000001);
 
     // Watch for changes to the previous coinbase transaction.
@@ -2383,11 +3201,100 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     evoDb->WriteBestBlock(pindex->GetBlockHash());
 
     int64_t nTime7 = GetTimeMicros(); nTimeCallbacks += nTime7 - nTime6;
+    RecordBlockStageTime(BLOCK_STAGE_CALLBACKS, nTime7 - nTime6);
     LogPrint("bench", "    - Callbacks: %.2fms [%.2fs]\n", 0.001 * (nTime7 - nTime6), nTimeCallbacks * 0.000001);
+    TRACE6(validation, block_connected, pindex->phashBlock ? pindex->phashBlock->begin() : nullptr, pindex->nHeight,
+           block.vtx.size(), nInputs, nSigOps, nTime7 - nTimeStart);
+
+    if (pblockundoOut)
+        *pblockundoOut = std::move(blockundo);
+
+    return true;
+}
+
+/**
+ * Apply the UTXO set changes of a block that was just connected, or with fDisconnect just
+ * disconnected, to utxoStats. Outputs are taken exactly like AddCoins does, spent coins come
+ * from the undo data of the block.
+ */
+static void UpdateUTXOSetStats(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, bool fDisconnect)
+{
+    AssertLockHeld(cs_main);
+    if (!fUTXOStatsValid)
+        return;
+
+    const uint256 hashPrev = pindex->pprev ? pindex->pprev->GetBlockHash() : uint256();
+    if (utxoStats.hashBlock != (fDisconnect ? pindex->GetBlockHash() : hashPrev)) {
+        LogPrintf("%s: UTXO set stats at %s don't match block %s, dropping them\n", __func__, utxoStats.hashBlock.ToString(), pindex->GetBlockHash().ToString());
+        fUTXOStatsValid = false;
+        return;
+    }
+
+    // The outputs of the genesis block never enter the UTXO set
+    if (block.GetHash() != Params().GetConsensus().hashGenesisBlock) {
+        if (blockundo.vtxundo.size() + 1 != block.vtx.size()) {
+            LogPrintf("%s: block and undo data of block %s inconsistent\n", __func__, pindex->GetBlockHash().ToString());
+            fUTXOStatsValid = false;
+            return;
+        }
+        for (size_t i = 0; i < block.vtx.size(); i++) {
+            const CTransaction& tx = *block.vtx[i];
+            const uint256& txid = tx.GetHash();
+            for (size_t j = 0; j < tx.vout.size(); j++) {
+                if (tx.vout[j].scriptPubKey.IsUnspendable())
+                    continue;
+                Coin coin(tx.vout[j], pindex->nHeight, tx.IsCoinBase(), tx.IsCoinStake());
+                if (fDisconnect)
+                    utxoStats.RemoveCoin(COutPoint(txid, j), coin);
+                else
+                    utxoStats.AddCoin(COutPoint(txid, j), coin);
+            }
+            if (i == 0)
+                continue;
+            const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+            for (size_t j = 0; j < tx.vin.size() && j < txundo.vprevout.size(); j++) {
+                if (fDisconnect)
+                    utxoStats.AddCoin(tx.vin[j].prevout, txundo.vprevout[j]);
+                else
+                    utxoStats.RemoveCoin(tx.vin[j].prevout, txundo.vprevout[j]);
+            }
+        }
+    }
+    utxoStats.hashBlock = fDisconnect ? hashPrev : pindex->GetBlockHash();
+}
 
+bool GetUTXOSetStats(CUTXOSetStats& stats)
+{
+    AssertLockHeld(cs_main);
+    if (!fUTXOStatsValid || utxoStats.hashBlock != pcoinsTip->GetBestBlock())
+        return false;
+    stats = utxoStats;
     return true;
 }
 
+void SetUTXOSetStats(const CUTXOSetStats& stats)
+{
+    AssertLockHeld(cs_main);
+    if (!GetBoolArg("-utxosetstats", DEFAULT_UTXOSET_STATS) || stats.hashBlock != pcoinsTip->GetBestBlock())
+        return;
+    utxoStats = stats;
+    fUTXOStatsValid = true;
+}
+
+/** Pick up the UTXO set stats written with the best block of the coins database */
+static void LoadUTXOSetStats()
+{
+    utxoStats = CUTXOSetStats();
+    fUTXOStatsValid = false;
+    if (!GetBoolArg("-utxosetstats", DEFAULT_UTXOSET_STATS))
+        return;
+    // An empty chainstate has empty stats, everything else needs them on disk
+    if (pcoinsdbview->GetBestBlock().IsNull() || pcoinsdbview->ReadUTXOStats(utxoStats))
+        fUTXOStatsValid = true;
+    else
+        LogPrintf("%s: no UTXO set stats for the best block, gettxoutsetinfo \"muhash\" will scan the chainstate once\n", __func__);
+}
+
 /**
  * Update the on-disk chain state.
  * The caches and indexes are flushed depending on the mode we're called with
@@ -2432,6 +3339,9 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode, int n
     }
     int64_t nMempoolSizeMax = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     int64_t cacheSize = pcoinsTip->DynamicMemoryUsage() * DB_PEAK_USAGE_FACTOR;
+    // Coins still being written in the background count against the cache until they are on disk
+    if (pcoinsflusher)
+        cacheSize += pcoinsflusher->DynamicMemoryUsage();
     cacheSize += evoDb->GetMemoryUsage() * DB_PEAK_USAGE_FACTOR;
     int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
     // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
@@ -2483,9 +3393,18 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode, int n
         // overwrite one. Still, use a conservative safety factor of 2.
         if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
             return state.Error("out of disk space");
-        // Flush the chainstate (which may refer to block index entries).
+        if (fUTXOStatsValid && utxoStats.hashBlock == pcoinsTip->GetBestBlock())
+            pcoinsdbview->SetPendingUTXOStats(utxoStats);
+        int64_t nFlushStart = GetTimeMicros();
+        size_t nFlushCoins = pcoinsTip->GetCacheSize();
+        size_t nFlushUsage = pcoinsTip->DynamicMemoryUsage();
+        // Flush the chainstate (which may refer to block index entries). With -backgroundflush
+        // this only hands the coins to the writer thread, unless the caller needs them on disk.
         if (!pcoinsTip->Flush())
             return AbortNode(state, "Failed to write to coin database");
+        if (mode == FLUSH_STATE_ALWAYS && pcoinsflusher && !pcoinsflusher->WaitForFlush())
+            return AbortNode(state, "Failed to write to coin database");
+        TRACE5(utxocache, flush, GetTimeMicros() - nFlushStart, (int)mode, nFlushCoins, nFlushUsage, fFlushForPrune);
         if (!evoDb->CommitRootTransaction()) {
             return AbortNode(state, "Failed to commit EvoDB");
         }
@@ -2516,6 +3435,8 @@ void PruneAndFlush() {
 /** Update chainActive and related internal data structures. */
 void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
     chainActive.SetTip(pindexNew);
+    g_metrics.nChainHeight = pindexNew->nHeight;
+    g_metrics.nCoinsCacheUsage = pcoinsTip->DynamicMemoryUsage();
 
     // New best block
     mempool.AddTransactionsUpdated(1);
@@ -2576,8 +3497,94 @@ void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
     LogPrintf("%s\n", strMessage);
 }
 
-/** Disconnect chainActive's tip. You probably want to call mempool.removeForReorg and manually re-limit mempool size after this, with cs_main held. */
-bool static DisconnectTip(CValidationState& state, const CChainParams& chainparams)
+/**
+ * What a range of DisconnectTip calls share, so a reorg undoes its blocks in one go: their coins
+ * collect in one cache on top of pcoinsTip, and their transactions are offered back to the mempool
+ * and announced to listeners once the new chain is connected instead of after every block. What
+ * is still pending is done on destruction. Requires cs_main.
+ */
+class CDisconnectBatch
+{
+private:
+    std::unique_ptr<CCoinsViewCache> view;
+    //! Transactions of the disconnected blocks, the oldest block first
+    std::deque<CTransactionRef> vtx;
+
+public:
+    CDisconnectBatch() {}
+    CDisconnectBatch(const CDisconnectBatch&) = delete;
+    CDisconnectBatch& operator=(const CDisconnectBatch&) = delete;
+    ~CDisconnectBatch() { UpdateMempool(); }
+
+    CCoinsViewCache& View()
+    {
+        if (!view)
+            view.reset(new CCoinsViewCache(pcoinsTip));
+        return *view;
+    }
+
+    size_t DynamicMemoryUsage() const { return view ? view->DynamicMemoryUsage() : 0; }
+
+    void AddBlock(const CBlock& block) { vtx.insert(vtx.begin(), block.vtx.begin(), block.vtx.end()); }
+
+    /** Moves the coins into pcoinsTip */
+    void FlushCoins()
+    {
+        if (view) {
+            bool flushed = view->Flush();
+            assert(flushed);
+            view.reset();
+        }
+    }
+
+    /** Moves the coins into pcoinsTip and writes the chain state to disk, if necessary */
+    bool Flush(CValidationState& state)
+    {
+        FlushCoins();
+        return FlushStateToDisk(state, FLUSH_STATE_IF_NEEDED);
+    }
+
+    /**
+     * Resurrects the mempool transactions of the disconnected blocks and lets listeners know they
+     * went from 1-confirmed to 0-confirmed or conflicted. Those in psetConfirmed, which made it into
+     * the new chain already, are left alone.
+     */
+    void UpdateMempool(const std::unordered_set<uint256, StaticSaltedHasher>* psetConfirmed = nullptr)
+    {
+        FlushCoins();
+        if (vtx.empty())
+            return;
+        std::vector<uint256> vHashUpdate;
+        for (const auto& ptx : vtx) {
+            if (psetConfirmed && psetConfirmed->count(ptx->GetHash()))
+                continue;
+            // ignore validation errors in resurrected transactions
+            CValidationState stateDummy;
+            if (ptx->IsCoinBase() || !AcceptToMemoryPool(mempool, stateDummy, ptx, false, NULL, true)) {
+                mempool.removeRecursive(*ptx, MemPoolRemovalReason::REORG);
+            } else if (mempool.exists(ptx->GetHash())) {
+                vHashUpdate.push_back(ptx->GetHash());
+            }
+        }
+        // AcceptToMemoryPool/addUnchecked all assume that new mempool entries have
+        // no in-mempool children, which is generally not true when adding
+        // previously-confirmed transactions back to the mempool.
+        // UpdateTransactionsFromBlock finds descendants of any transactions in the
+        // disconnected blocks that were added back and cleans up the mempool state.
+        mempool.UpdateTransactionsFromBlock(vHashUpdate);
+        for (const auto& ptx : vtx) {
+            if (psetConfirmed && psetConfirmed->count(ptx->GetHash()))
+                continue;
+            GetMainSignals().SyncTransaction(ptx, chainActive.Tip(), CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+        }
+        vtx.clear();
+    }
+};
+
+/** Disconnect chainActive's tip into disconnected, which updates the mempool once it is done with the
+ *  reorg. You probably want to call mempool.removeForReorg and manually re-limit mempool size after that,
+ *  with cs_main held. */
+bool static DisconnectTip(CValidationState& state, const CChainParams& chainparams, CDisconnectBatch& disconnected)
 {
     CBlockIndex *pindexDelete = chainActive.Tip();
     assert(pindexDelete);
@@ -2588,44 +3595,30 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
     // Apply the block atomically to the chain state.
     int64_t nStart = GetTimeMicros();
     {
+        // EvoDB changes are committed per block, just into memory, so a failing block is rolled back alone
         auto dbTx = evoDb->BeginTransaction();
 
-        CCoinsViewCache view(pcoinsTip);
+        CCoinsViewCache view(&disconnected.View());
         if (DisconnectBlock(block, state, pindexDelete, view) != DISCONNECT_OK)
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         bool flushed = view.Flush();
         assert(flushed);
         dbTx->Commit();
     }
+    if (fUTXOStatsValid) {
+        CBlockUndo blockUndo;
+        if (UndoReadFromDisk(blockUndo, pindexDelete->GetUndoPos(), pindexDelete->pprev->GetBlockHash()))
+            UpdateUTXOSetStats(block, blockUndo, pindexDelete, true);
+        else
+            fUTXOStatsValid = false;
+    }
     LogPrint("bench", "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
-    // Write the chain state to disk, if necessary.
-    if (!FlushStateToDisk(state, FLUSH_STATE_IF_NEEDED))
+    // A deep reorg flushes the coins on the way, so they stay within -dbcache
+    if (disconnected.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage() > nCoinCacheUsage && !disconnected.Flush(state))
         return false;
-    // Resurrect mempool transactions from the disconnected block.
-    std::vector<uint256> vHashUpdate;
-    for (const auto& it : block.vtx) {
-        const CTransaction& tx = *it;
-        // ignore validation errors in resurrected transactions
-        CValidationState stateDummy;
-        if (tx.IsCoinBase() || !AcceptToMemoryPool(mempool, stateDummy, it, false, NULL, true)) {
-            mempool.removeRecursive(tx, MemPoolRemovalReason::REORG);
-        } else if (mempool.exists(tx.GetHash())) {
-            vHashUpdate.push_back(tx.GetHash());
-        }
-    }
-    // AcceptToMemoryPool/addUnchecked all assume that new mempool entries have
-    // no in-mempool children, which is generally not true when adding
-    // previously-confirmed transactions back to the mempool.
-    // UpdateTransactionsFromBlock finds descendants of any transactions in this
-    // block that were added back and cleans up the mempool state.
-    mempool.UpdateTransactionsFromBlock(vHashUpdate);
+    disconnected.AddBlock(block);
     // Update chainActive and related variables.
     UpdateTip(pindexDelete->pprev, chainparams);
-    // Let wallets know transactions went from 1-confirmed to
-    // 0-confirmed or conflicted:
-    for (const auto& tx : block.vtx) {
-        GetMainSignals().SyncTransaction(*tx, pindexDelete->pprev, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
-    }
     return true;
 }
 
@@ -2667,13 +3660,15 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     const CBlock& blockConnecting = *connectTrace.blocksConnected.back().second;
     // Apply the block atomically to the chain state.
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
+    RecordBlockStageTime(BLOCK_STAGE_READ_FROM_DISK, nTime2 - nTime1);
     int64_t nTime3;
     LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
     {
         auto dbTx = evoDb->BeginTransaction();
 
         CCoinsViewCache view(pcoinsTip);
-        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
+        CBlockUndo blockundo;
+        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams, false, &blockundo);
         GetMainSignals().BlockChecked(blockConnecting, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -2681,17 +3676,21 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
             return error("ConnectTip(): ConnectBlock %s failed with %s", pindexNew->GetBlockHash().ToString(), FormatStateMessage(state));
         }
         nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
+        RecordBlockStageTime(BLOCK_STAGE_CONNECT_BLOCK, nTime3 - nTime2);
         LogPrint("bench", "  - Connect total: %.2fms [%.2fs]\n", (nTime3 - nTime2) * 0.001, nTimeConnectTotal * 0.000001);
         bool flushed = view.Flush();
         assert(flushed);
         dbTx->Commit();
+        UpdateUTXOSetStats(blockConnecting, blockundo, pindexNew, false);
     }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
+    RecordBlockStageTime(BLOCK_STAGE_FLUSH, nTime4 - nTime3);
     LogPrint("bench", "  - Flush: %.2fms [%.2fs]\n", (nTime4 - nTime3) * 0.001, nTimeFlush * 0.000001);
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(state, FLUSH_STATE_IF_NEEDED))
         return false;
     int64_t nTime5 = GetTimeMicros(); nTimeChainState += nTime5 - nTime4;
+    RecordBlockStageTime(BLOCK_STAGE_CHAINSTATE, nTime5 - nTime4);
     LogPrint("bench", "  - Writing chainstate: %.2fms [%.2fs]\n", (nTime5 - nTime4) * 0.001, nTimeChainState * 0.000001);
     // Remove conflicting transactions from the mempool.;
     mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
@@ -2699,6 +3698,8 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     UpdateTip(pindexNew, chainparams);
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
+    RecordBlockStageTime(BLOCK_STAGE_POST_CONNECT, nTime6 - nTime5);
+    RecordBlockStageTime(BLOCK_STAGE_TOTAL, nTime6 - nTime1);
     LogPrint("bench", "  - Connect postprocess: %.2fms [%.2fs]\n", (nTime6 - nTime5) * 0.001, nTimePostConnect * 0.000001);
     LogPrint("bench", "- Connect block: %.2fms [%.2fs]\n", (nTime6 - nTime1) * 0.001, nTimeTotal * 0.000001);
     return true;
@@ -2712,13 +3713,14 @@ bool DisconnectBlocks(int blocks)
     const CChainParams& chainparams = Params();
 
     LogPrintf("DisconnectBlocks -- Got command to replay %d blocks\n", blocks);
+    CDisconnectBatch disconnected;
     for(int i = 0; i < blocks; i++) {
-        if(!DisconnectTip(state, chainparams) || !state.IsValid()) {
+        if(!DisconnectTip(state, chainparams, disconnected) || !state.IsValid()) {
             return false;
         }
     }
 
-    return true;
+    return disconnected.Flush(state);
 }
 
 void ReprocessBlocks(int nBlocks)
@@ -2776,6 +3778,16 @@ static CBlockIndex* FindMostWorkChain() {
             // to a chain unless we have all the non-active-chain parent blocks.
             bool fFailedChain = pindexTest->nStatus & BLOCK_FAILED_MASK;
             bool fMissingData = !(pindexTest->nStatus & BLOCK_HAVE_DATA);
+            if (!fFailedChain && pindexTest->pprev && chainActive.Contains(pindexTest->pprev) &&
+                llmq::chainLocksHandler->HasConflictingChainLock(pindexTest->nHeight, pindexTest->GetBlockHash())) {
+                // This candidate forks off below the best ChainLock, so it can never become the active chain. Prune
+                // the whole branch now instead of evaluating and trying to connect it first
+                LogPrint("chainlocks", "%s: pruning candidate %s, branch forks off at %s conflicting with ChainLock\n", __func__,
+                         pindexNew->GetBlockHash().ToString(), pindexTest->GetBlockHash().ToString());
+                pindexTest->nStatus |= BLOCK_FAILED_VALID;
+                setDirtyBlockIndex.insert(pindexTest);
+                fFailedChain = true;
+            }
             if (fFailedChain || fMissingData) {
                 // Candidate chain is not usable (either invalid or missing data)
                 if (fFailedChain && (pindexBestInvalid == nullptr || pindexNew->nChainTrust > pindexBestInvalid->nChainTrust))
@@ -2829,11 +3841,14 @@ static bool ActivateBestChainStep(CValidationState& state, const CChainParams& c
 
     // Disconnect active blocks which are no longer in the best chain.
     bool fBlocksDisconnected = false;
+    CDisconnectBatch disconnected;
     while (chainActive.Tip() && chainActive.Tip() != pindexFork) {
-        if (!DisconnectTip(state, chainparams))
+        if (!DisconnectTip(state, chainparams, disconnected))
             return false;
         fBlocksDisconnected = true;
     }
+    if (fBlocksDisconnected && !disconnected.Flush(state))
+        return false;
 
     // Build list of new blocks to connect.
     std::vector<CBlockIndex*> vpindexToConnect;
@@ -2881,6 +3896,13 @@ static bool ActivateBestChainStep(CValidationState& state, const CChainParams& c
     }
 
     if (fBlocksDisconnected) {
+        // Transactions the new chain confirmed again don't go through the mempool
+        std::unordered_set<uint256, StaticSaltedHasher> setConfirmed;
+        for (const auto& pair : connectTrace.blocksConnected) {
+            for (const auto& ptx : pair.second->vtx)
+                setConfirmed.insert(ptx->GetHash());
+        }
+        disconnected.UpdateMempool(&setConfirmed);
         mempool.removeForReorg(pcoinsTip, chainActive.Tip()->nHeight + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
         LimitMempoolSize(mempool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
     }
@@ -2985,7 +4007,7 @@ bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams,
                 assert(pair.second);
                 const CBlock& block = *(pair.second);
                 for (unsigned int i = 0; i < block.vtx.size(); i++)
-                    GetMainSignals().SyncTransaction(*block.vtx[i], pair.first, i);
+                    GetMainSignals().SyncTransaction(block.vtx[i], pair.first, i);
             }
         }
         // When we reach this point, we switched to a new tip (stored in pindexNewTip).
@@ -3054,6 +4076,7 @@ bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, C
         pindexBestHeader = pindexBestHeader->pprev;
     }
 
+    CDisconnectBatch disconnected;
     while (chainActive.Contains(pindex)) {
         CBlockIndex *pindexWalk = chainActive.Tip();
         pindexWalk->nStatus |= BLOCK_FAILED_CHILD;
@@ -3061,7 +4084,8 @@ bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, C
         setBlockIndexCandidates.erase(pindexWalk);
         // ActivateBestChain considers blocks already in chainActive
         // unconditionally valid already, so force disconnect away from it.
-        if (!DisconnectTip(state, chainparams)) {
+        if (!DisconnectTip(state, chainparams, disconnected)) {
+            disconnected.UpdateMempool();
             mempool.removeForReorg(pcoinsTip, chainActive.Tip()->nHeight + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
             return false;
         }
@@ -3070,6 +4094,12 @@ bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, C
             pindexBestHeader = pindexBestHeader->pprev;
         }
     }
+    bool fFlushed = disconnected.Flush(state);
+    disconnected.UpdateMempool();
+    if (!fFlushed) {
+        mempool.removeForReorg(pcoinsTip, chainActive.Tip()->nHeight + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
+        return false;
+    }
 
     LimitMempoolSize(mempool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
 
@@ -3132,17 +4162,13 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block, enum BlockStatus nStatus
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
+    CBlockIndex* pindexNew = blockIndexArena.Allocate(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
     pindexNew->nSequenceId = 0;
     BlockMap::iterator mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
 
-    //mark as PoS seen
-    if (pindexNew->IsProofOfStake())
-        setStakeSeen.insert(std::make_pair(pindexNew->prevoutStake, pindexNew->nTime));
-
     pindexNew->phashBlock = &((*mi).first);
     BlockMap::iterator miPrev = mapBlockIndex.find(block.hashPrevBlock);
     if (miPrev != mapBlockIndex.end())
@@ -3151,6 +4177,10 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block, enum BlockStatus nStatus
         pindexNew->nHeight = pindexNew->pprev->nHeight + 1;
         pindexNew->BuildSkip();
 
+        //mark as PoS seen
+        if (pindexNew->IsProofOfStake())
+            stakeSeen.Insert(pindexNew->prevoutStake, pindexNew->nTime, pindexNew->nHeight);
+
         // ppcoin: compute chain trust score
         pindexNew->nChainTrust = (pindexNew->pprev ? pindexNew->pprev->nChainTrust : 0) + GetBlockTrust(*pindexNew);
 
@@ -3180,6 +4210,10 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block, enum BlockStatus nStatus
     if (pindexBestHeader == nullptr || pindexBestHeader->nChainTrust < pindexNew->nChainTrust)
         pindexBestHeader = pindexNew;
 
+    if (pindexNew->pprev)
+        setChainTips.erase(pindexNew->pprev);
+    setChainTips.insert(pindexNew);
+
     setDirtyBlockIndex.insert(pindexNew);
 
     return pindexNew;
@@ -3336,7 +4370,8 @@ bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const
     return true;
 }
 
-bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSignature)
+/** CheckBlock, with the sigops failsafe passed in instead of read from the last connected block */
+static bool CheckBlockContextFree(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot, bool fIgnoreSigops)
 {
     // These are checks that are independent of context.
 
@@ -3388,7 +4423,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
     }
 
     // Check transactions
-    if (!IgnoreSigopsLimits(-1)) {
+    if (!fIgnoreSigops) {
         for (const auto& tx : block.vtx)
             if (!CheckTransaction(*tx, state))
                 return state.Invalid(false, state.GetRejectCode(), state.GetRejectReason(),
@@ -3396,7 +4431,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
     }
 
     // Don't know height here, use failsafe
-    if (!IgnoreSigopsLimits(-1)) {
+    if (!fIgnoreSigops) {
         unsigned int nSigOps = 0;
         for (const auto& tx : block.vtx) {
             nSigOps += GetLegacySigOpCount(*tx);
@@ -3412,6 +4447,11 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
     return true;
 }
 
+bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSignature)
+{
+    return CheckBlockContextFree(block, state, consensusParams, fCheckPOW, fCheckMerkleRoot, IgnoreSigopsLimits(-1));
+}
+
 static bool CheckIndexAgainstCheckpoint(const CBlockIndex* pindexPrev, CValidationState& state, const CChainParams& chainparams, const uint256& hash)
 {
     if (*pindexPrev->phashBlock == chainparams.GetConsensus().hashGenesisBlock)
@@ -3609,7 +4649,54 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
     return true;
 }
 
-// Exposed wrapper for AcceptBlockHeader
+/** Workers for context-free header and block checks, sized like script verification (-par) */
+static CCriticalSection cs_contextFreeCheckWorkers;
+static std::unique_ptr<ctpl::thread_pool> contextFreeCheckWorkers;
+
+static ctpl::thread_pool& GetContextFreeCheckWorkers()
+{
+    AssertLockHeld(cs_contextFreeCheckWorkers);
+    if (!contextFreeCheckWorkers) {
+        contextFreeCheckWorkers.reset(new ctpl::thread_pool(nScriptCheckThreads));
+        RenameThreadPool(*contextFreeCheckWorkers, "epmcoin-cfcheck");
+    }
+    return *contextFreeCheckWorkers;
+}
+
+//! Number of headers hashed per header check task
+static const size_t HEADER_CHECK_BATCH_SIZE = 64;
+
+void CheckBlockHeadersContextFree(std::vector<CBlockHeader>& headers)
+{
+    if (nScriptCheckThreads == 0 || headers.size() <= HEADER_CHECK_BATCH_SIZE) {
+        CacheBlockHeaderHashes(MakeSpan(headers));
+        return;
+    }
+
+    std::vector<std::future<void>> vFutures;
+    {
+        LOCK(cs_contextFreeCheckWorkers);
+        ctpl::thread_pool& workers = GetContextFreeCheckWorkers();
+        for (size_t nFirst = 0; nFirst < headers.size(); nFirst += HEADER_CHECK_BATCH_SIZE) {
+            Span<CBlockHeader> batch(headers.data() + nFirst, std::min(HEADER_CHECK_BATCH_SIZE, headers.size() - nFirst));
+            vFutures.emplace_back(workers.push([batch](int) {
+                CacheBlockHeaderHashes(batch);
+            }));
+        }
+    }
+    for (auto& future : vFutures)
+        future.get();
+}
+
+void StopContextFreeCheckWorkers()
+{
+    LOCK(cs_contextFreeCheckWorkers);
+    if (contextFreeCheckWorkers) {
+        contextFreeCheckWorkers->stop(true);
+        contextFreeCheckWorkers.reset();
+    }
+}
+
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex)
 {
     {
@@ -3687,7 +4774,10 @@ static bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidation
     uint256 hashProofOfStake = uint256();
     if (block.IsProofOfStake())
     {
-		if (!CheckProofOfStake(block, hashProofOfStake, pindex->pprev)) {
+        int64_t nTimeStart = GetTimeMicros();
+        bool fValidProofOfStake = CheckProofOfStake(block, hashProofOfStake, pindex->pprev);
+        RecordBlockStageTime(BLOCK_STAGE_CHECK_PROOF_OF_STAKE, GetTimeMicros() - nTimeStart);
+		if (!fValidProofOfStake) {
 			LogPrintf("WARNING: %s: check proof-of-stake failed for block %s\n", __func__, block.GetHash().ToString());
 			return false;
 		}
@@ -3723,10 +4813,73 @@ static bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidation
     return true;
 }
 
+/** Workers reading the inputs of blocks waiting for connection from the coins database */
+static CCriticalSection cs_inputPrefetchWorkers;
+static std::unique_ptr<ctpl::thread_pool> inputPrefetchWorkers;
+
+//! Number of coins read per input prefetch task
+static const size_t INPUT_PREFETCH_BATCH_SIZE = 64;
+
+/** Collect the inputs of a block that the coins cache doesn't have yet */
+static std::vector<COutPoint> GetUncachedBlockInputs(const CBlock& block)
+{
+    AssertLockHeld(cs_main);
+    std::vector<COutPoint> vOutPoints;
+    if (!pcoinsprefetch)
+        return vOutPoints;
+    for (const CTransactionRef& tx : block.vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin) {
+            if (!pcoinsTip->HaveCoinInCache(txin.prevout))
+                vOutPoints.push_back(txin.prevout);
+        }
+    }
+    return vOutPoints;
+}
+
+/**
+ * Start reading the given coins into pcoinsprefetch, so ConnectBlock finds them in memory
+ * instead of doing one database read per input on the thread holding cs_main. pcoinsprefetch
+ * sits below pcoinsTip, so this doesn't need cs_main, and it drops everything on flush.
+ */
+static void PrefetchBlockInputs(const std::vector<COutPoint>& vOutPoints)
+{
+    int nThreads = GetArg("-inputprefetchthreads", DEFAULT_INPUT_PREFETCH_THREADS);
+    if (nThreads <= 0 || vOutPoints.empty())
+        return;
+
+    LOCK(cs_inputPrefetchWorkers);
+    if (!inputPrefetchWorkers) {
+        inputPrefetchWorkers.reset(new ctpl::thread_pool(std::min(nThreads, MAX_INPUT_PREFETCH_THREADS)));
+        RenameThreadPool(*inputPrefetchWorkers, "epmcoin-prefetch");
+    }
+    for (size_t nFirst = 0; nFirst < vOutPoints.size(); nFirst += INPUT_PREFETCH_BATCH_SIZE) {
+        auto first = vOutPoints.begin() + nFirst;
+        std::vector<COutPoint> vBatch(first, first + std::min(INPUT_PREFETCH_BATCH_SIZE, vOutPoints.size() - nFirst));
+        inputPrefetchWorkers->push([vBatch](int) {
+            pcoinsprefetch->Prefetch(vBatch);
+        });
+    }
+    LogPrint("bench", "    - Prefetching %u inputs\n", vOutPoints.size());
+}
+
+void StopInputPrefetchWorkers()
+{
+    LOCK(cs_inputPrefetchWorkers);
+    if (inputPrefetchWorkers) {
+        // Nothing waits for the results, skip what hasn't started yet
+        inputPrefetchWorkers->clear_queue();
+        inputPrefetchWorkers->stop(true);
+        inputPrefetchWorkers.reset();
+    }
+}
+
 bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool *fNewBlock)
 {
     AssertLockNotHeld(cs_main);
 
+    std::vector<COutPoint> vPrefetch;
     {
         CBlockIndex *pindex = NULL;
         if (fNewBlock) *fNewBlock = false;
@@ -3746,8 +4899,11 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
             GetMainSignals().BlockChecked(*pblock, state);
             return error("%s: AcceptBlock FAILED: %s", __func__, FormatStateMessage(state));
         }
+        if (!chainActive.Contains(pindex))
+            vPrefetch = GetUncachedBlockInputs(*pblock);
     }
 
+    PrefetchBlockInputs(vPrefetch);
     NotifyHeaderTip();
 
     CValidationState state; // Only used to report errors, not invalidity - ignore it
@@ -3842,8 +4998,14 @@ void PruneOneBlockFile(const int fileNumber)
 
 void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
+    // Don't keep appending to a file that may be gone
+    blockFileWriter.Close();
+    undoFileWriter.Close();
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+#ifndef WIN32
+        blockFileMapper.Remove(*it);
+#endif
         boost::filesystem::remove(GetBlockPosFilename(pos, "blk"));
         boost::filesystem::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -3962,10 +5124,12 @@ FILE* OpenDiskFile(const CDiskBlockPos &pos, const char *prefix, bool fReadOnly)
 }
 
 FILE* OpenBlockFile(const CDiskBlockPos &pos, bool fReadOnly) {
+    blockFileWriter.Flush(pos.nFile);
     return OpenDiskFile(pos, "blk", fReadOnly);
 }
 
 FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly) {
+    undoFileWriter.Flush(pos.nFile);
     return OpenDiskFile(pos, "rev", fReadOnly);
 }
 
@@ -3985,18 +5149,28 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw std::runtime_error(std::string(__func__) + ": new CBlockIndex failed");
+    CBlockIndex* pindexNew = blockIndexArena.Allocate();
     mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
     return pindexNew;
 }
 
+static boost::filesystem::path GetBlockIndexSnapshotPath()
+{
+    return GetDataDir() / "blockindex.dat";
+}
+
 bool static LoadBlockIndexDB(const CChainParams& chainparams)
 {
-    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex))
+    bool fFromSnapshot = false;
+    if (GetBoolArg("-blockindexsnapshot", DEFAULT_BLOCKINDEX_SNAPSHOT)) {
+        int64_t nStart = GetTimeMillis();
+        fFromSnapshot = pblocktree->LoadBlockIndexSnapshot(GetBlockIndexSnapshotPath(), pcoinsTip->GetBestBlock(), InsertBlockIndex);
+        if (fFromSnapshot)
+            LogPrintf("%s: loaded %u block index entries from snapshot in %dms\n", __func__, mapBlockIndex.size(), GetTimeMillis() - nStart);
+    }
+    if (!fFromSnapshot && !pblocktree->LoadBlockIndexGuts(InsertBlockIndex))
         return false;
 
     boost::this_thread::interruption_point();
@@ -4040,17 +5214,19 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
             pindexBestInvalid = pindex;
         if (pindex->pprev)
             pindex->BuildSkip();
+        pindex->BuildStakeModifierLast();
         if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
             pindexBestHeader = pindex;
+        // parents come first, so every tip is left over once its children were seen
+        if (pindex->pprev)
+            setChainTips.erase(pindex->pprev);
+        setChainTips.insert(pindex);
     }
 
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
-    vinfoBlockFile.resize(nLastBlockFile + 1);
     LogPrintf("%s: last block file = %i\n", __func__, nLastBlockFile);
-    for (int nFile = 0; nFile <= nLastBlockFile; nFile++) {
-        pblocktree->ReadBlockFileInfo(nFile, vinfoBlockFile[nFile]);
-    }
+    pblocktree->ReadBlockFileInfos(nLastBlockFile, vinfoBlockFile);
     LogPrintf("%s: last block file info: %s\n", __func__, vinfoBlockFile[nLastBlockFile].ToString());
     for (int nFile = nLastBlockFile + 1; true; nFile++) {
         CBlockFileInfo info;
@@ -4097,10 +5273,23 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadFlag("addressindex", fAddressIndex);
     LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
 
+    // Address indexes created before the address balances existed need them built once
+    bool fAddressBalanceIndex = false;
+    pblocktree->ReadFlag("addressbalanceindex", fAddressBalanceIndex);
+    if (fAddressIndex && !fAddressBalanceIndex) {
+        LogPrintf("%s: building address balances from the address index...\n", __func__);
+        if (!pblocktree->RebuildAddressBalanceIndex() || !pblocktree->WriteFlag("addressbalanceindex", true))
+            return error("%s: failed to build address balances", __func__);
+    }
+
     // Check whether we have a timestamp index
     pblocktree->ReadFlag("timestampindex", fTimestampIndex);
     LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
 
+    // Check whether block rewards are indexed
+    pblocktree->ReadFlag("rewardindex", fRewardIndex);
+    LogPrintf("%s: reward index %s\n", __func__, fRewardIndex ? "enabled" : "disabled");
+
     // Check whether we have a spent index
     pblocktree->ReadFlag("spentindex", fSpentIndex);
     LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
@@ -4121,6 +5310,136 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     return true;
 }
 
+//! Number of blocks VerifyDB reads and checks at once, the next ones are read while it disconnects them
+static const size_t VERIFYDB_WINDOW_SIZE = 64;
+
+namespace {
+
+/** A block VerifyDB reads and checks as far as that doesn't need the chain, on the context free check workers */
+struct VerifyDBBlock
+{
+    CBlockIndex* pindex;
+    CDiskBlockPos pos;
+    bool fComplete;
+    CDiskBlockPos posUndo;
+    uint256 hashPrev;
+
+    CBlock block;
+    //! Empty when the block passed
+    std::string strError;
+
+    //! Check levels 0 to 2, touches nothing but the block
+    void ReadAndCheck(int nCheckLevel, const Consensus::Params& consensusParams)
+    {
+        // check level 0: read from disk
+        if (!ReadBlockFromFile(block, pos, fComplete, consensusParams) || block.GetHash() != pindex->GetBlockHash()) {
+            strError = strprintf("ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+            return;
+        }
+        // check level 1: verify block validity
+        CValidationState state;
+        if (nCheckLevel >= 1 && !CheckBlock(block, state, consensusParams)) {
+            strError = strprintf("found bad block at %d, hash=%s (%s)", pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
+            return;
+        }
+        // check level 2: verify undo validity
+        if (nCheckLevel >= 2 && !posUndo.IsNull()) {
+            CBlockUndo undo;
+            if (!UndoReadFromDisk(undo, posUndo, hashPrev))
+                strError = strprintf("found bad undo data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+        }
+    }
+};
+
+/**
+ * Reads and checks windows of blocks for VerifyDB in parallel, one window ahead of the one it
+ * works on. Has to be used with cs_main held the whole time, which keeps the block files as they
+ * are, so the workers don't need it.
+ */
+class VerifyDBReader
+{
+private:
+    const std::vector<CBlockIndex*>& vIndexes;
+    const int nCheckLevel;
+    const Consensus::Params& consensusParams;
+
+    std::vector<VerifyDBBlock> vWindows[2];
+    std::vector<std::future<void> > vFutures[2];
+    size_t nNextBegin;
+    int nNextWindow;
+
+    void Start(int nWindow)
+    {
+        std::vector<VerifyDBBlock>& vBlocks = vWindows[nWindow];
+        vBlocks.clear();
+        size_t nEnd = std::min(nNextBegin + VERIFYDB_WINDOW_SIZE, vIndexes.size());
+        vBlocks.resize(nEnd - nNextBegin);
+        for (size_t i = 0; i < vBlocks.size(); i++) {
+            CBlockIndex* pindex = vIndexes[nNextBegin + i];
+            vBlocks[i].pindex = pindex;
+            vBlocks[i].pos = pindex->GetBlockPos();
+            vBlocks[i].fComplete = (int)vBlocks[i].pos.nFile < nLastBlockFile;
+            vBlocks[i].posUndo = pindex->GetUndoPos();
+            vBlocks[i].hashPrev = pindex->pprev ? pindex->pprev->GetBlockHash() : uint256();
+        }
+        nNextBegin = nEnd;
+
+        if (nScriptCheckThreads == 0) {
+            for (auto& block : vBlocks)
+                block.ReadAndCheck(nCheckLevel, consensusParams);
+            return;
+        }
+        LOCK(cs_contextFreeCheckWorkers);
+        ctpl::thread_pool& workers = GetContextFreeCheckWorkers();
+        for (auto& block : vBlocks) {
+            VerifyDBBlock* pblock = &block;
+            vFutures[nWindow].emplace_back(workers.push([this, pblock](int) {
+                try {
+                    pblock->ReadAndCheck(nCheckLevel, consensusParams);
+                } catch (const std::exception& e) {
+                    pblock->strError = strprintf("%s at %d", e.what(), pblock->pindex->nHeight);
+                }
+            }));
+        }
+    }
+
+    void Wait(int nWindow)
+    {
+        for (auto& future : vFutures[nWindow])
+            future.wait();
+        vFutures[nWindow].clear();
+    }
+
+public:
+    VerifyDBReader(const std::vector<CBlockIndex*>& vIndexesIn, int nCheckLevelIn, const Consensus::Params& consensusParamsIn) :
+        vIndexes(vIndexesIn), nCheckLevel(nCheckLevelIn), consensusParams(consensusParamsIn), nNextBegin(0), nNextWindow(0)
+    {
+        Start(0);
+    }
+
+    ~VerifyDBReader()
+    {
+        // the workers write to the windows
+        Wait(0);
+        Wait(1);
+    }
+
+    /** The next window of blocks in the order of vIndexes, once read and checked, empty at the end */
+    std::vector<VerifyDBBlock>& Next()
+    {
+        int nWindow = nNextWindow;
+        Wait(nWindow);
+        nNextWindow = 1 - nWindow;
+        if (!vWindows[nWindow].empty() && nNextBegin < vIndexes.size())
+            Start(nNextWindow);
+        else
+            vWindows[nNextWindow].clear();
+        return vWindows[nWindow];
+    }
+};
+
+} // namespace
+
 CVerifyDB::CVerifyDB()
 {
     uiInterface.ShowProgress(_("Verifying blocks..."), 0);
@@ -4147,6 +5466,19 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         nCheckDepth = chainActive.Height();
     nCheckLevel = std::max(0, std::min(4, nCheckLevel));
     LogPrintf("Verifying last %i blocks at level %i\n", nCheckDepth, nCheckLevel);
+
+    std::vector<CBlockIndex*> vIndexes;
+    for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev) {
+        if (pindex->nHeight < chainActive.Height()-nCheckDepth)
+            break;
+        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+            // If pruning, only go back as far as we have data.
+            LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
+            break;
+        }
+        vIndexes.push_back(pindex);
+    }
+
     CCoinsViewCache coins(coinsview);
     CBlockIndex* pindexState = chainActive.Tip();
     CBlockIndex* pindexFailure = NULL;
@@ -4154,72 +5486,60 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
     CValidationState state;
     int reportDone = 0;
     LogPrintf("[0%%]...");
-    for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev)
     {
-        boost::this_thread::interruption_point();
-        int percentageDone = std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100))));
-        if (reportDone < percentageDone/10) {
-            // report every 10% step
-            LogPrintf("[%d%%]...", percentageDone);
-            reportDone = percentageDone/10;
-        }
-        uiInterface.ShowProgress(_("Verifying blocks..."), percentageDone);
-        if (pindex->nHeight < chainActive.Height()-nCheckDepth)
-            break;
-        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
-            // If pruning, only go back as far as we have data.
-            LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
-            break;
-        }
-        CBlock block;
-        // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
-            return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-        // check level 1: verify block validity
-        if (nCheckLevel >= 1 && !CheckBlock(block, state, chainparams.GetConsensus()))
-            return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__,
-                         pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            CDiskBlockPos pos = pindex->GetUndoPos();
-            if (!pos.IsNull()) {
-                if (!UndoReadFromDisk(undo, pos, pindex->pprev->GetBlockHash()))
-                    return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-            }
-        }
-        // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
-            DisconnectResult res = DisconnectBlock(block, state, pindex, coins);
-            if (res == DISCONNECT_FAILED) {
-                return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-            }
-            pindexState = pindex->pprev;
-            if (res == DISCONNECT_UNCLEAN) {
-                nGoodTransactions = 0;
-                pindexFailure = pindex;
-            } else {
-                nGoodTransactions += block.vtx.size();
+        // check levels 0 to 2 run ahead in parallel, only level 3 is done here
+        VerifyDBReader reader(vIndexes, nCheckLevel, chainparams.GetConsensus());
+        for (std::vector<VerifyDBBlock>* pvBlocks = &reader.Next(); !pvBlocks->empty(); pvBlocks = &reader.Next()) {
+            for (VerifyDBBlock& entry : *pvBlocks) {
+                CBlockIndex* pindex = entry.pindex;
+                boost::this_thread::interruption_point();
+                int percentageDone = std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100))));
+                if (reportDone < percentageDone/10) {
+                    // report every 10% step
+                    LogPrintf("[%d%%]...", percentageDone);
+                    reportDone = percentageDone/10;
+                }
+                uiInterface.ShowProgress(_("Verifying blocks..."), percentageDone);
+                if (!entry.strError.empty())
+                    return error("VerifyDB(): *** %s", entry.strError);
+                // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
+                if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
+                    DisconnectResult res = DisconnectBlock(entry.block, state, pindex, coins);
+                    if (res == DISCONNECT_FAILED) {
+                        return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+                    }
+                    pindexState = pindex->pprev;
+                    if (res == DISCONNECT_UNCLEAN) {
+                        nGoodTransactions = 0;
+                        pindexFailure = pindex;
+                    } else {
+                        nGoodTransactions += entry.block.vtx.size();
+                    }
+                }
+                if (ShutdownRequested())
+                    return true;
             }
         }
-        if (ShutdownRequested())
-            return true;
     }
     if (pindexFailure)
         return error("VerifyDB(): *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", chainActive.Height() - pindexFailure->nHeight + 1, nGoodTransactions);
 
-    // check level 4: try reconnecting blocks
+    // check level 4: try reconnecting blocks, the next ones are read while connecting
     if (nCheckLevel >= 4) {
-        CBlockIndex *pindex = pindexState;
-        while (pindex != chainActive.Tip()) {
-            boost::this_thread::interruption_point();
-            uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, 100 - (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * 50))));
-            pindex = chainActive.Next(pindex);
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
-                return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-            if (!ConnectBlock(block, state, pindex, coins, chainparams))
-                return error("VerifyDB(): *** found unconnectable block at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+        std::vector<CBlockIndex*> vReconnect;
+        for (CBlockIndex* pindex = chainActive.Next(pindexState); pindex; pindex = chainActive.Next(pindex))
+            vReconnect.push_back(pindex);
+        VerifyDBReader reader(vReconnect, 0, chainparams.GetConsensus());
+        for (std::vector<VerifyDBBlock>* pvBlocks = &reader.Next(); !pvBlocks->empty(); pvBlocks = &reader.Next()) {
+            for (VerifyDBBlock& entry : *pvBlocks) {
+                CBlockIndex* pindex = entry.pindex;
+                boost::this_thread::interruption_point();
+                uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, 100 - (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * 50))));
+                if (!entry.strError.empty())
+                    return error("VerifyDB(): *** %s", entry.strError);
+                if (!ConnectBlock(entry.block, state, pindex, coins, chainparams))
+                    return error("VerifyDB(): *** found unconnectable block at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+            }
         }
     }
 
@@ -4229,18 +5549,75 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
     return true;
 }
 
+bool ReplayTipBlocks(const CChainParams& chainparams, int nBlocks, CBlockReplayResult& result, std::string& strError)
+{
+    LOCK(cs_main);
+
+    // all changes to the evodb are rolled back, the coins only go into a cache on top of pcoinsTip
+    auto dbTx = evoDb->BeginTransaction();
+    CCoinsViewCache coins(pcoinsTip);
+    CValidationState state;
+
+    // blocks are read and disconnected before the clock starts, the replay only connects them
+    std::vector<std::pair<CBlockIndex*, CBlock>> vBlocks;
+    for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev && (int)vBlocks.size() < nBlocks; pindex = pindex->pprev) {
+        vBlocks.emplace_back(pindex, CBlock());
+        if (!ReadBlockFromDisk(vBlocks.back().second, pindex, chainparams.GetConsensus())) {
+            strError = strprintf("can't read block %s from disk", pindex->GetBlockHash().ToString());
+            return false;
+        }
+        if (DisconnectBlock(vBlocks.back().second, state, pindex, coins) != DISCONNECT_OK) {
+            strError = strprintf("can't disconnect block %s", pindex->GetBlockHash().ToString());
+            return false;
+        }
+    }
+
+    std::vector<CBlockProcessingStageStats> vBefore = GetBlockProcessingStats();
+    int64_t nTimeStart = GetTimeMicros();
+    for (auto it = vBlocks.rbegin(); it != vBlocks.rend(); ++it) {
+        CBlockIndex* pindex = it->first;
+        const CBlock& block = it->second;
+        boost::this_thread::interruption_point();
+        if (block.IsProofOfStake()) {
+            uint256 hashProofOfStake;
+            int64_t nTime1 = GetTimeMicros();
+            bool fValidProofOfStake = CheckProofOfStake(block, hashProofOfStake, pindex->pprev);
+            RecordBlockStageTime(BLOCK_STAGE_CHECK_PROOF_OF_STAKE, GetTimeMicros() - nTime1);
+            if (!fValidProofOfStake) {
+                strError = strprintf("check proof-of-stake failed for block %s", pindex->GetBlockHash().ToString());
+                return false;
+            }
+        }
+        if (!ConnectBlock(block, state, pindex, coins, chainparams)) {
+            strError = strprintf("can't connect block %s: %s", pindex->GetBlockHash().ToString(), FormatStateMessage(state));
+            return false;
+        }
+    }
+    result.nBlocks = vBlocks.size();
+    result.nTimeMicros = GetTimeMicros() - nTimeStart;
+
+    result.vStages = GetBlockProcessingStats();
+    for (size_t i = 0; i < result.vStages.size(); i++) {
+        result.vStages[i].nCount -= vBefore[i].nCount;
+        result.vStages[i].nTimeTotal -= vBefore[i].nTimeTotal;
+    }
+    return true;
+}
+
 // May NOT be used after any connections are up as much
 // of the peer-processing logic assumes a consistent
 // block index state
 void UnloadBlockIndex()
 {
     LOCK(cs_main);
+    fUTXOStatsValid = false;
     setBlockIndexCandidates.clear();
     chainActive.SetTip(NULL);
     pindexBestInvalid = NULL;
     pindexBestHeader = NULL;
     mempool.clear();
     mapBlocksUnlinked.clear();
+    setChainTips.clear();
     vinfoBlockFile.clear();
     nLastBlockFile = 0;
     nBlockSequenceId = 1;
@@ -4251,15 +5628,15 @@ void UnloadBlockIndex()
         warningcache[b].clear();
     }
 
-    BOOST_FOREACH(BlockMap::value_type& entry, mapBlockIndex) {
-        delete entry.second;
-    }
     mapBlockIndex.clear();
+    blockIndexArena.Clear();
     fHavePruned = false;
 }
 
 bool LoadBlockIndex(const CChainParams& chainparams)
 {
+    LoadUTXOSetStats();
+
     // Load block index from databases
     if (!fReindex && !LoadBlockIndexDB(chainparams))
         return false;
@@ -4281,6 +5658,49 @@ static bool AddGenesisBlock(const CChainParams& chainparams, const CBlock& block
     return true;
 }
 
+static std::vector<std::pair<uint256, CDiskTxPos> > GetTxPositions(const CBlock& block, const CBlockIndex* pindex)
+{
+    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
+    vPos.reserve(block.vtx.size());
+    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
+    for (const auto& tx : block.vtx) {
+        vPos.emplace_back(tx->GetHash(), pos);
+        pos.nTxOffset += ::GetSerializeSize(*tx, SER_DISK, CLIENT_VERSION);
+    }
+    return vPos;
+}
+
+bool StartTxIndex(const CChainParams& chainparams)
+{
+    if (!fTxIndex)
+        return true;
+    ptxindexdb->Start();
+
+    LOCK(cs_main);
+    uint256 hashBest = ptxindexdb->GetBestBlock();
+    if (hashBest.IsNull()) {
+        // A new database, older versions indexed everything up to the tip in the block tree database
+        if (chainActive.Tip())
+            ptxindexdb->AddBlock(chainActive.Tip()->GetBlockHash(), std::vector<std::pair<uint256, CDiskTxPos> >());
+        return true;
+    }
+
+    BlockMap::const_iterator it = mapBlockIndex.find(hashBest);
+    const CBlockIndex* pindexFork = it == mapBlockIndex.end() ? nullptr : chainActive.FindFork(it->second);
+    const CBlockIndex* pindex = pindexFork ? chainActive.Next(pindexFork) : chainActive.Genesis();
+    if (!pindexFork)
+        LogPrintf("%s: last indexed block %s is unknown, indexing the whole chain again\n", __func__, hashBest.ToString());
+    else if (pindex)
+        LogPrintf("%s: indexing the transactions of blocks %d to %d again\n", __func__, pindex->nHeight, chainActive.Height());
+    for (; pindex; pindex = chainActive.Next(pindex)) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+            return error("%s: failed to read block %s", __func__, pindex->GetBlockHash().ToString());
+        ptxindexdb->AddBlock(pindex->GetBlockHash(), GetTxPositions(block, pindex));
+    }
+    return true;
+}
+
 bool InitBlockIndex(const CChainParams& chainparams)
 {
     LOCK(cs_main);
@@ -4296,11 +5716,15 @@ bool InitBlockIndex(const CChainParams& chainparams)
     // Use the provided setting for -addressindex in the new database
     fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
     pblocktree->WriteFlag("addressindex", fAddressIndex);
+    pblocktree->WriteFlag("addressbalanceindex", fAddressIndex);
 
     // Use the provided setting for -timestampindex in the new database
     fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
     pblocktree->WriteFlag("timestampindex", fTimestampIndex);
 
+    fRewardIndex = GetBoolArg("-rewardindex", DEFAULT_REWARDINDEX);
+    pblocktree->WriteFlag("rewardindex", fRewardIndex);
+
     fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
     pblocktree->WriteFlag("spentindex", fSpentIndex);
 
@@ -4333,21 +5757,136 @@ bool InitBlockIndex(const CChainParams& chainparams)
     return true;
 }
 
+//! Number of blocks LoadExternalBlockFile reads ahead of the one it is accepting
+static const size_t BLOCK_IMPORT_READAHEAD = 64;
+
+// Map of disk positions for blocks with unknown parent (only used for reindex)
+static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+
+/**
+ * Deserialize a block read by LoadExternalBlockFile, and do the context-free checks of
+ * AcceptBlock ahead of time. Sigops are always checked here, so fChecked is only set if the
+ * block passes regardless of the failsafe. Runs on the context-free check workers.
+ */
+static std::shared_ptr<CBlock> DeserializeAndCheckBlock(const std::vector<char>& vData, const Consensus::Params& consensusParams)
+{
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+    try {
+        CDataStream ss(vData, SER_DISK, CLIENT_VERSION);
+        ss >> *pblock;
+    } catch (const std::exception& e) {
+        LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+        return nullptr;
+    }
+    CValidationState state;
+    CheckBlockContextFree(*pblock, state, consensusParams, true, true, false);
+    return pblock;
+}
+
+/** Accept a block read by LoadExternalBlockFile, returns false if the import should stop */
+static bool AcceptImportedBlock(const CChainParams& chainparams, const std::shared_ptr<CBlock>& pblock, CDiskBlockPos* dbp, int& nLoaded)
+{
+    const CBlock& block = *pblock;
+
+    // detect out of order blocks, and store them for later
+    uint256 hash = block.GetHash();
+    {
+        LOCK(cs_main);
+        if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+            LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                    block.hashPrevBlock.ToString());
+            if (dbp)
+                mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+            return true;
+        }
+
+        // process in case the block isn't known yet
+        if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+            CValidationState state;
+            if (AcceptBlock(pblock, state, chainparams, NULL, true, dbp, NULL))
+                nLoaded++;
+            if (state.IsError())
+                return false;
+        } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+            LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+        }
+
+        // Activate the genesis block so normal node progress can continue
+        if (hash == chainparams.GetConsensus().hashGenesisBlock) {
+            CValidationState state;
+            if (!ActivateBestChain(state, chainparams)) {
+                return false;
+            }
+        }
+    }
+
+    NotifyHeaderTip();
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
+            if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
+            {
+                LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                        head.ToString());
+                LOCK(cs_main);
+                CValidationState dummy;
+                if (AcceptBlock(pblockrecursive, dummy, chainparams, NULL, true, &it->second, NULL))
+                {
+                    nLoaded++;
+                    queue.push_back(pblockrecursive->GetHash());
+                }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+            NotifyHeaderTip();
+        }
+    }
+    return true;
+}
+
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
 {
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
     int64_t nStart = GetTimeMillis();
 
+    // Blocks are read in order on this thread, deserialized and checked on the
+    // context-free check workers, and accepted here in the order they were read.
+    struct PendingBlock {
+        CDiskBlockPos pos;
+        std::future<std::shared_ptr<CBlock> > block;
+    };
+    std::deque<PendingBlock> pipeline;
+
     int nLoaded = 0;
     try {
         unsigned int nMaxBlockSize = MaxBlockSize(true);
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2*nMaxBlockSize, nMaxBlockSize+8, SER_DISK, CLIENT_VERSION);
         uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
+        bool fReadDone = false;
+        while (true) {
             boost::this_thread::interruption_point();
 
+            if (!fReadDone && blkdat.eof())
+                fReadDone = true;
+            if (fReadDone || pipeline.size() >= BLOCK_IMPORT_READAHEAD) {
+                if (pipeline.empty())
+                    break;
+                PendingBlock pending = std::move(pipeline.front());
+                pipeline.pop_front();
+                std::shared_ptr<CBlock> pblock = pending.block.get();
+                if (pblock && !AcceptImportedBlock(chainparams, pblock, dbp ? &pending.pos : NULL, nLoaded))
+                    break;
+                continue;
+            }
+
             blkdat.SetPos(nRewind);
             nRewind++; // start one byte further next time, in case of failure
             blkdat.SetLimit(); // remove former limit
@@ -4366,80 +5905,35 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                     continue;
             } catch (const std::exception&) {
                 // no valid block header found; don't complain
-                break;
+                fReadDone = true;
+                continue;
             }
             try {
                 // read block
+                PendingBlock pending;
                 uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
+                if (dbp) {
+                    pending.pos = *dbp;
+                    pending.pos.nPos = nBlockPos;
+                }
                 blkdat.SetLimit(nBlockPos + nSize);
                 blkdat.SetPos(nBlockPos);
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
+                std::shared_ptr<std::vector<char> > pdata = std::make_shared<std::vector<char> >(nSize);
+                blkdat.read(pdata->data(), nSize);
                 nRewind = blkdat.GetPos();
 
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                LOCK(cs_main);
-                if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                            block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
-
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    LOCK(cs_main);
-                    CValidationState state;
-                    if (AcceptBlock(pblock, state, chainparams, NULL, true, dbp, NULL))
-                        nLoaded++;
-                    if (state.IsError())
-                        break;
-                } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
-                }
-
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus().hashGenesisBlock) {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
-                        break;
-                    }
-                }
-
-                NotifyHeaderTip();
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
-                        {
-                            LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (AcceptBlock(pblockrecursive, dummy, chainparams, NULL, true, &it->second, NULL))
-                            {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
-                    }
+                const Consensus::Params& consensusParams = chainparams.GetConsensus();
+                if (nScriptCheckThreads) {
+                    LOCK(cs_contextFreeCheckWorkers);
+                    pending.block = GetContextFreeCheckWorkers().push([pdata, &consensusParams](int) {
+                        return DeserializeAndCheckBlock(*pdata, consensusParams);
+                    });
+                } else {
+                    pending.block = std::async(std::launch::deferred, [pdata, &consensusParams]() {
+                        return DeserializeAndCheckBlock(*pdata, consensusParams);
+                    });
                 }
+                pipeline.push_back(std::move(pending));
             } catch (const std::exception& e) {
                 LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
@@ -4679,6 +6173,20 @@ bool LoadMempool(void)
     int64_t failed = 0;
     int64_t nNow = GetTime();
 
+    // The dump lists parents before their children, so consecutive runs of it can go through
+    // AcceptPackageToMemoryPool, which takes cs_main and trims the pool once per batch
+    std::vector<CTransactionRef> vtx;
+    std::vector<int64_t> vTime;
+    auto acceptBatch = [&]() {
+        std::vector<CValidationState> vStates;
+        std::vector<bool> vAccepted, vMissingInputs;
+        size_t nAccepted = AcceptPackageToMemoryPool(mempool, vtx, vStates, vAccepted, vMissingInputs, true, 0, &vTime);
+        count += nAccepted;
+        failed += vtx.size() - nAccepted;
+        vtx.clear();
+        vTime.clear();
+    };
+
     try {
         uint64_t version;
         file >> version;
@@ -4687,6 +6195,7 @@ bool LoadMempool(void)
         }
         uint64_t num;
         file >> num;
+        vtx.reserve(std::min(num, (uint64_t)MEMPOOL_LOAD_BATCH_SIZE));
         while (num--) {
             CTransactionRef tx;
             int64_t nTime;
@@ -4699,21 +6208,20 @@ bool LoadMempool(void)
             if (amountdelta) {
                 mempool.PrioritiseTransaction(tx->GetHash(), amountdelta);
             }
-            CValidationState state;
             if (nTime + nExpiryTimeout > nNow) {
-                LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(mempool, state, tx, true, NULL, nTime);
-                if (state.IsValid()) {
-                    ++count;
-                } else {
-                    ++failed;
-                }
+                vtx.push_back(std::move(tx));
+                vTime.push_back(nTime);
+                if (vtx.size() >= MEMPOOL_LOAD_BATCH_SIZE)
+                    acceptBatch();
             } else {
                 ++skipped;
             }
             if (ShutdownRequested())
                 return false;
         }
+        if (!vtx.empty())
+            acceptBatch();
+
         std::map<uint256, CAmount> mapDeltas;
         file >> mapDeltas;
 
@@ -4729,7 +6237,7 @@ bool LoadMempool(void)
     return true;
 }
 
-void DumpMempool(void)
+bool DumpMempool(void)
 {
     int64_t start = GetTimeMicros();
 
@@ -4749,7 +6257,7 @@ void DumpMempool(void)
     try {
         FILE* filestr = fopen((GetDataDir() / "mempool.dat.new").string().c_str(), "wb");
         if (!filestr) {
-            return;
+            return false;
         }
 
         CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
@@ -4773,7 +6281,24 @@ void DumpMempool(void)
         LogPrintf("Dumped mempool: %gs to copy, %gs to dump\n", (mid-start)*0.000001, (last-mid)*0.000001);
     } catch (const std::exception& e) {
         LogPrintf("Failed to dump mempool: %s. Continuing anyway.\n", e.what());
+        return false;
     }
+    return true;
+}
+
+void DumpBlockIndexSnapshot()
+{
+    AssertLockHeld(cs_main);
+    if (!pblocktree || !pcoinsTip || mapBlockIndex.empty())
+        return;
+
+    int64_t nStart = GetTimeMillis();
+    std::vector<const CBlockIndex*> vIndex;
+    vIndex.reserve(mapBlockIndex.size());
+    for (const auto& item : mapBlockIndex)
+        vIndex.push_back(item.second);
+    if (pblocktree->WriteBlockIndexSnapshot(GetBlockIndexSnapshotPath(), pcoinsTip->GetBestBlock(), vIndex))
+        LogPrintf("%s: wrote %u block index entries in %dms\n", __func__, vIndex.size(), GetTimeMillis() - nStart);
 }
 
 //! Guess how far we are in the verification process at the given block index
@@ -4836,9 +6361,8 @@ public:
     CMainCleanup() {}
     ~CMainCleanup() {
         // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
+        setChainTips.clear();
         mapBlockIndex.clear();
+        blockIndexArena.Clear();
     }
 } instance_of_cmaincleanup;
@@ -16,15 +16,18 @@
 #include "amount.h"
 #include "chain.h"
 #include "coins.h"
+#include "merkleblock.h"
 #include "protocol.h" // For CMessageHeader::MessageStartChars
 #include "script/script_error.h"
 #include "sync.h"
 #include "versionbits.h"
+#include "rewardindex.h"
 #include "spentindex.h"
 
 #include <algorithm>
 #include <exception>
 #include <map>
+#include <memory>
 #include <set>
 #include <stdint.h>
 #include <string>
@@ -38,12 +41,16 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
 class CBloomFilter;
 class CChainParams;
+class CCoinsViewBackgroundFlush;
+struct CUTXOSetStats;
 class CCoinsViewDB;
 class CInv;
 class CConnman;
 class CScriptCheck;
+class CTxIndexDB;
 class CTxMemPool;
 class CValidationInterface;
 class CValidationState;
@@ -80,19 +87,45 @@ static const unsigned int DEFAULT_DESCENDANT_LIMIT = 25;
 static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
 /** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 336;
+/** Default for -persistmempool, saving the mempool on shutdown and loading it on startup */
+static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Number of transactions of mempool.dat accepted under one lock when loading it */
+static const unsigned int MEMPOOL_LOAD_BATCH_SIZE = 200;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
 static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
 /** The pre-allocation chunk size for rev?????.dat files (since 0.8) */
 static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
+/** The stdio buffer size for appending to block and undo files */
+static const unsigned int BLOCKFILE_WRITE_BUFFER_SIZE = 0x400000; // 4 MiB
 
 /** Maximum number of script-checking threads allowed */
-static const int MAX_SCRIPTCHECK_THREADS = 16;
+static const int MAX_SCRIPTCHECK_THREADS = 64;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Script verification threads from which on the work-stealing check queue is used by default */
+static const int SCRIPTCHECK_WORK_STEALING_THREADS = 8;
+/** -scriptcheckbatch default (maximum number of script checks a thread takes at once) */
+static const unsigned int DEFAULT_SCRIPTCHECK_BATCH_SIZE = 128;
+/** Transactions with at least this many inputs have their scripts checked in parallel when entering the mempool */
+static const unsigned int MIN_PARALLEL_SCRIPTCHECK_INPUTS = 4;
+/** -inputprefetchthreads default (number of threads reading block inputs ahead of ConnectBlock) */
+static const int DEFAULT_INPUT_PREFETCH_THREADS = 4;
+/** Default for -utxosetstats, keeping a rolling hash and totals of the UTXO set per block */
+static const bool DEFAULT_UTXOSET_STATS = false;
+/** Default for -mmapblocks, reading blocks from memory maps of the completed block files */
+static const bool DEFAULT_MMAP_BLOCKS = false;
+/** Maximum number of input prefetch threads */
+static const int MAX_INPUT_PREFETCH_THREADS = 16;
+/** Maximum number of coins held by pcoinsprefetch */
+static const size_t MAX_PREFETCHED_COINS = 100000;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 512;
+/** Number of blocks we request at once from a peer before we know how fast it sends them. */
+static const int MIN_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** How long (in microseconds) the blocks in flight from a peer should keep it busy, for sizing its download queue. */
+static const int64_t BLOCK_DOWNLOAD_QUEUE_TIME = 2 * 1000000;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
@@ -106,7 +139,7 @@ static const int MAX_BLOCKTXN_DEPTH = 10;
 /** Size of the "block download window": how far ahead of our current height do we fetch?
  *  Larger windows tolerate larger download speed differences between peer, but increase the potential
  *  degree of disordering of blocks on disk (which make reindexing and in the future perhaps pruning
- *  harder). We'll probably want to make this a per-peer adaptive value at some point. */
+ *  harder). The number of blocks in flight from each peer adapts to its speed instead. */
 static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
 /** Time to wait (in seconds) between writing blocks/block index to disk. */
 static const unsigned int DATABASE_WRITE_INTERVAL = 60 * 60;
@@ -139,10 +172,14 @@ static const int64_t MAX_FEE_ESTIMATION_TIP_AGE = 3 * 60 * 60;
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const unsigned int DEFAULT_BYTES_PER_SIGOP = 20;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
+/** Default for -assumechainlocked */
+static const bool DEFAULT_ASSUME_CHAINLOCKED = false;
 static const bool DEFAULT_TXINDEX = true;
+static const bool DEFAULT_BLOCKINDEX_SNAPSHOT = false;
 static const bool DEFAULT_ADDRESSINDEX = false;
 static const bool DEFAULT_TIMESTAMPINDEX = false;
 static const bool DEFAULT_SPENTINDEX = false;
+static const bool DEFAULT_REWARDINDEX = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 
 /** Maximum number of headers to announce when relaying blocks with headers message.*/
@@ -164,21 +201,32 @@ extern CTxMemPool mempool;
 typedef boost::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
 typedef std::unordered_multimap<uint256, CBlockIndex*, BlockHasher> PrevBlockMap;
 extern BlockMap mapBlockIndex;
+/** Owns all entries of mapBlockIndex, guarded by cs_main */
+extern CBlockIndexArena blockIndexArena;
 extern PrevBlockMap mapPrevBlockIndex;
+/** Entries of mapBlockIndex no other entry builds on, the tips of all branches of the block tree, guarded by cs_main */
+extern std::set<const CBlockIndex*> setChainTips;
 extern uint64_t nLastBlockTx;
 extern uint64_t nLastBlockSize;
 extern const std::string strMessageMagic;
 extern CWaitableCriticalSection csBestBlock;
 extern CConditionVariable cvBlockChange;
 extern std::atomic_bool fImporting;
+/** Whether LoadMempool is done, before that a dump would overwrite mempool.dat with a partial pool */
+extern std::atomic_bool fMempoolLoaded;
 extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fAddressIndex;
+extern bool fSpentIndex;
+extern bool fRewardIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern unsigned int nBytesPerSigOp;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
+/** Skip script verification of blocks which are covered by a ChainLock */
+extern bool fAssumeChainLocked;
 extern size_t nCoinCacheUsage;
 /** A fee rate smaller than this is considered zero fee (for relaying, mining and transaction creation) */
 extern CFeeRate minRelayTxFee;
@@ -209,6 +257,8 @@ static const uint64_t nMinDiskSpace = 52428800;
 extern bool fHavePruned;
 /** True if we're running in -prune mode. */
 extern bool fPruneMode;
+/** True if blocks are read from memory maps of the block files (-mmapblocks). */
+extern bool fMapBlockFiles;
 /** Number of MiB of block files that we're trying to stay below. */
 extern uint64_t nPruneTarget;
 /** Block files containing a block-height within MIN_BLOCKS_TO_KEEP of chainActive.Tip() will not be pruned. */
@@ -260,6 +310,19 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
  */
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& block, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex=NULL);
 
+/**
+ * Do the context-free work of validating a batch of headers, i.e. computing and caching
+ * their X11 hashes, spread over the context-free check workers. This leaves only the cheap
+ * contextual checks and linking for ProcessNewBlockHeaders.
+ *
+ * Call without cs_main held.
+ */
+void CheckBlockHeadersContextFree(std::vector<CBlockHeader>& headers);
+/** Stop the workers behind CheckBlockHeadersContextFree and the block import checks, call once the network and import threads are gone */
+void StopContextFreeCheckWorkers();
+/** Stop the threads prefetching block inputs, call before pcoinsprefetch is deleted */
+void StopInputPrefetchWorkers();
+
 /** Check whether enough disk space is available for an incoming block */
 bool CheckDiskSpace(uint64_t nAdditionalBytes = 0);
 /** Open a block file (blk?????.dat) */
@@ -272,12 +335,94 @@ boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos &pos, const char
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = NULL);
 /** Initialize a new block tree database + block data on disk */
 bool InitBlockIndex(const CChainParams& chainparams);
+/** Start writing the txindex, indexing the blocks of the active chain it missed before */
+bool StartTxIndex(const CChainParams& chainparams);
 /** Load the block tree and coins database from disk */
 bool LoadBlockIndex(const CChainParams& chainparams);
 /** Unload database information */
 void UnloadBlockIndex();
+/** The rolling UTXO set stats of pcoinsTip, false if they aren't known (-utxosetstats) */
+bool GetUTXOSetStats(CUTXOSetStats& stats);
+/** Start the rolling stats from a full scan, if it was of the current pcoinsTip */
+void SetUTXOSetStats(const CUTXOSetStats& stats);
+
+/** The stages of block processing which are timed, the same the -debug=bench output shows */
+enum BlockProcessingStage {
+    BLOCK_STAGE_CHECK_PROOF_OF_STAKE,
+    BLOCK_STAGE_READ_FROM_DISK,
+    BLOCK_STAGE_CHECK,
+    BLOCK_STAGE_FORKS,
+    BLOCK_STAGE_CONNECT_TXS,
+    BLOCK_STAGE_VERIFY,
+    BLOCK_STAGE_IS_FILTER,
+    BLOCK_STAGE_SUBSIDY,
+    BLOCK_STAGE_VALUE_VALID,
+    BLOCK_STAGE_PAYEE_VALID,
+    BLOCK_STAGE_SPECIAL_TX_LOOP,
+    BLOCK_STAGE_QUORUM_BLOCK_PROCESSOR,
+    BLOCK_STAGE_DETERMINISTIC_MNS,
+    BLOCK_STAGE_CBTX_MERKLE_ROOTS,
+    BLOCK_STAGE_PROCESS_SPECIAL,
+    BLOCK_STAGE_EPMCOIN_SPECIFIC,
+    BLOCK_STAGE_INDEX,
+    BLOCK_STAGE_CALLBACKS,
+    BLOCK_STAGE_CONNECT_BLOCK,
+    BLOCK_STAGE_FLUSH,
+    BLOCK_STAGE_CHAINSTATE,
+    BLOCK_STAGE_POST_CONNECT,
+    BLOCK_STAGE_TOTAL,
+    BLOCK_STAGE_COUNT
+};
+
+/** Number of recent blocks the window statistics of each stage cover */
+static const unsigned int BLOCK_STATS_WINDOW = 144;
+
+/** Time spent in one block processing stage, all times in microseconds */
+struct CBlockProcessingStageStats {
+    std::string strStage;
+    uint64_t nCount;
+    int64_t nTimeTotal;
+    int64_t nTimeMax;
+    //! Percentiles since startup are the upper bounds of power of two buckets
+    int64_t nTimeP50;
+    int64_t nTimeP99;
+    //! The last time recorded, i.e. that of the latest block which got this far
+    int64_t nTimeLast;
+    //! Exact statistics of the last (up to) BLOCK_STATS_WINDOW times
+    uint32_t nWindowCount;
+    int64_t nWindowTotal;
+    int64_t nWindowMax;
+    int64_t nWindowP50;
+    int64_t nWindowP99;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(strStage);
+        READWRITE(nCount);
+        READWRITE(nTimeTotal);
+        READWRITE(nTimeMax);
+        READWRITE(nTimeP50);
+        READWRITE(nTimeP99);
+        READWRITE(nTimeLast);
+        READWRITE(nWindowCount);
+        READWRITE(nWindowTotal);
+        READWRITE(nWindowMax);
+        READWRITE(nWindowP50);
+        READWRITE(nWindowP99);
+    }
+};
+
+/** Record nMicros spent in a block processing stage */
+void RecordBlockStageTime(BlockProcessingStage stage, int64_t nMicros);
+/** Statistics for every stage since startup or the last reset, in processing order */
+std::vector<CBlockProcessingStageStats> GetBlockProcessingStats();
+void ResetBlockProcessingStats();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Set up the script check queue for nScriptCheckThreads, before starting ThreadScriptCheck. Returns whether it is work-stealing. */
+bool InitScriptCheckQueue(unsigned int nBatchSize, bool fWorkStealing);
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Format a string that describes several potential problems detected by the core.
@@ -290,6 +435,24 @@ bool IsInitialBlockDownload();
 std::string GetWarnings(const std::string& strFor);
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256 &hash, CTransactionRef &tx, const Consensus::Params& params, uint256 &hashBlock, bool fAllowSlow = false);
+
+/** The header of a block and the levels of its merkle tree, enough to prove any of its transactions */
+struct CBlockMerkleLevels
+{
+    CBlockHeader header;
+    MerkleLevels vLevels;
+};
+typedef std::shared_ptr<const CBlockMerkleLevels> CBlockMerkleLevelsCPtr;
+
+/** The merkle levels of a block, from a cache of the recently used ones or built from the block on disk. Null if it can't be read. */
+CBlockMerkleLevelsCPtr GetBlockMerkleLevels(const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+
+/**
+ * Builds one merkle proof per block for the txids in it, the blocks in the order they first show up
+ * in vTxids and each with the txids it proves. The blocks are found through the transaction index or,
+ * without it, the unspent outputs of the transactions. Returns false with strError set otherwise.
+ */
+bool GetTxOutProofs(const std::vector<uint256>& vTxids, std::vector<std::pair<CMerkleBlock, std::vector<uint256> > >& vProofs, std::string& strError);
 /** Find the best known block, and make it the tip of the block chain */
 bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams, std::shared_ptr<const CBlock> pblock = std::shared_ptr<const CBlock>());
 
@@ -347,6 +510,17 @@ bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState &state, const
                                 bool* pfMissingInputs, int64_t nAcceptTime, bool fOverrideMempoolLimit=false,
                                 const CAmount nAbsurdFee=0, bool fDryRun=false);
 
+/**
+ * Add a batch of transactions to the memory pool under a single cs_main lock, trimming the pool
+ * once at the end rather than after every transaction. Parents have to come before their
+ * children. vStates, vAccepted and vMissingInputs get one entry per transaction. The entry times
+ * are now, unless pvAcceptTime gives one per transaction. Returns the number of transactions that
+ * made it into the pool.
+ */
+size_t AcceptPackageToMemoryPool(CTxMemPool& pool, const std::vector<CTransactionRef>& vtx, std::vector<CValidationState>& vStates,
+                                 std::vector<bool>& vAccepted, std::vector<bool>& vMissingInputs, bool fLimitFree, const CAmount nAbsurdFee=0,
+                                 const std::vector<int64_t>* pvAcceptTime=NULL);
+
 bool GetUTXOCoin(const COutPoint& outpoint, Coin& coin);
 int GetUTXOHeight(const COutPoint& outpoint);
 int GetUTXOConfirmations(const COutPoint& outpoint);
@@ -380,10 +554,10 @@ unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& ma
 /**
  * Check whether all inputs of this transaction are valid (no double spends, scripts & sigs, amounts)
  * This does not modify the UTXO set. If pvChecks is not NULL, script checks are pushed onto it
- * instead of being performed inline.
+ * instead of being performed inline. txdata, if given, has to outlive those checks.
  */
 bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &view, bool fScriptChecks,
-                 unsigned int flags, bool cacheStore, std::vector<CScriptCheck> *pvChecks = NULL);
+                 unsigned int flags, bool cacheStore, std::vector<CScriptCheck> *pvChecks = NULL, PrecomputedTransactionData* txdata = NULL);
 
 /** Apply the effects of this transaction on the UTXO set represented by view */
 void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight);
@@ -459,10 +633,10 @@ private:
     PrecomputedTransactionData *txdata;
 
 public:
-    CScriptCheck(): ptxTo(0), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
-    CScriptCheck(const CScript& scriptPubKeyIn, const CAmount amountIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn) :
+    CScriptCheck(): ptxTo(0), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(nullptr) {}
+    CScriptCheck(const CScript& scriptPubKeyIn, const CAmount amountIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, PrecomputedTransactionData* txdataIn = nullptr) :
         scriptPubKey(scriptPubKeyIn),
-        ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR) { }
+        ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn) { }
 
     bool operator()();
 
@@ -473,18 +647,49 @@ public:
         std::swap(nFlags, check.nFlags);
         std::swap(cacheStore, check.cacheStore);
         std::swap(error, check.error);
+        std::swap(txdata, check.txdata);
     }
 
     ScriptError GetScriptError() const { return error; }
 };
 
+/**
+ * Run script checks on the script check threads, or one after the other when there are none
+ * or only a few checks. Returns whether all of them passed.
+ */
+bool RunScriptChecks(std::vector<CScriptCheck>& vChecks);
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes);
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 bool GetAddressIndex(uint160 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                     int start = 0, int end = 0);
+                     int start = 0, int end = 0,
+                     const CAddressIndexKey* pkeyFrom = nullptr, size_t nMaxEntries = 0);
+bool GetAddressBalance(uint160 addressHash, int type, CAmount &balance, CAmount &received);
 bool GetAddressUnspent(uint160 addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       const CAddressUnspentKey* pkeyFrom = nullptr, size_t nMaxEntries = 0);
+/** Build the address and spent index entries ConnectBlock writes for an already connected block
+ * from its block and undo data, used to build those indexes after the fact */
+bool GetBlockIndexEntries(const CBlockIndex* pindex, bool fAddress, bool fSpent,
+                          std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex,
+                          std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& addressUnspentIndex,
+                          std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& spentIndex);
+bool GetRewardIndex(uint160 addressHash, int type,
+                    std::vector<std::pair<CRewardIndexKey, CAmount> > &rewardIndex,
+                    int start = 0, int end = 0,
+                    const CRewardIndexKey* pkeyFrom = nullptr, size_t nMaxEntries = 0);
+/**
+ * The payouts of the reward transaction of a connected block (vtx[1] for proof of stake,
+ * the coinbase otherwise): the staker output(s) as a single REWARD_STAKE net of the stake,
+ * then the outputs to the masternode which was due at pindex and, at superblock heights,
+ * the superblock payments. Requires the undo data of the block.
+ */
+void GetBlockRewards(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& blockUndo,
+                     std::vector<CBlockReward>& vRewards);
+
+/** Estimated heap usage of the stake kernels seen recently, the ones duplicate stakes are checked against */
+memusage::SubsystemUsage GetStakeSeenMemoryUsage();
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
@@ -497,6 +702,11 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, const char* str = __builtin_FUNCTION());
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, const char* str = __builtin_FUNCTION());
 #endif
+/** Read the serialized block as stored on disk, for sending it on without decoding it. The
+ * header hash is checked against the index, the transactions are not looked at. */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart);
+/** Read the undo data of a block, hashBlock is the hash of its parent */
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -525,6 +735,22 @@ public:
     bool VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth);
 };
 
+/** The replayed blocks are all held in memory */
+static const int MAX_REPLAY_BLOCKS = 10000;
+
+/** Outcome of ReplayTipBlocks, the stage counts and totals only cover the replay */
+struct CBlockReplayResult {
+    int nBlocks{0};
+    int64_t nTimeMicros{0};
+    std::vector<CBlockProcessingStageStats> vStages;
+};
+
+/**
+ * Disconnect the last nBlocks blocks of the active chain in memory and connect them again, timing the
+ * proof-of-stake checks and ConnectBlock. Nothing is written, the evodb changes are rolled back.
+ */
+bool ReplayTipBlocks(const CChainParams& chainparams, int nBlocks, CBlockReplayResult& result, std::string& strError);
+
 inline CBlockIndex* LookupBlockIndex(const uint256& hash)
 {
     AssertLockHeld(cs_main);
@@ -550,12 +776,21 @@ extern CChain chainActive;
 /** Global variable that points to the coins database (protected by cs_main) */
 extern CCoinsViewDB *pcoinsdbview;
 
+/** Global variable that points to the view writing flushed coins to pcoinsdbview (see CCoinsViewBackgroundFlush) */
+extern CCoinsViewBackgroundFlush *pcoinsflusher;
+
+/** Global variable that points to the coins prefetched for pcoinsTip (thread safe, see CCoinsViewPrefetch) */
+extern CCoinsViewPrefetch *pcoinsprefetch;
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
+/** Global variable that points to the transaction index if -txindex is on (thread safe) */
+extern CTxIndexDB *ptxindexdb;
+
 /**
  * Return the spend height, which is one more than the inputs.GetBestBlock().
  * While checking, GetBestBlock() refers to the parent block. (protected by cs_main)
@@ -592,11 +827,15 @@ static const unsigned int REJECT_CONFLICT = 0x102;
 CBlockFileInfo* GetBlockFileInfo(size_t n);
 
 /** Dump the mempool to disk. */
-void DumpMempool();
+bool DumpMempool();
 
 /** Load the mempool from disk. */
 bool LoadMempool();
 
+/** Write a snapshot of the flushed block index for a fast next start (-blockindexsnapshot).
+ * Call with cs_main held, right after the final FlushStateToDisk. */
+void DumpBlockIndexSnapshot();
+
 //! Returns the current minimum protocol version in use
 int CurrentProtocol();
 
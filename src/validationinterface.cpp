@@ -5,6 +5,14 @@
 
 #include "validationinterface.h"
 
+#include "scheduler.h"
+#include "util.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
 static CMainSignals g_signals;
 
 CMainSignals& GetMainSignals()
@@ -12,13 +20,182 @@ CMainSignals& GetMainSignals()
     return g_signals;
 }
 
+namespace {
+
+/**
+ * The background callbacks, delivered one after another in the order they were queued. One
+ * scheduler task runs at a time and takes the next one, so the scheduler decides on which thread.
+ */
+class CBackgroundCallbackQueue
+{
+private:
+    std::mutex cs;
+    std::condition_variable cond;
+    CScheduler* pscheduler = nullptr;
+    std::deque<std::function<void()> > queue;
+    //! Whether a task is scheduled, and whether it is delivering a callback
+    bool fScheduled = false;
+    bool fRunning = false;
+
+    void ScheduleNext()
+    {
+        if (fScheduled || queue.empty() || !pscheduler)
+            return;
+        fScheduled = true;
+        pscheduler->scheduleFromNow(std::bind(&CBackgroundCallbackQueue::ProcessNext, this), 0, "validationinterface");
+    }
+
+    static void Run(const std::function<void()>& callback)
+    {
+        try {
+            callback();
+        } catch (const std::exception&) {
+            PrintExceptionContinue(std::current_exception(), "validationinterface");
+        }
+    }
+
+    void ProcessNext()
+    {
+        std::function<void()> callback;
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            if (!pscheduler || queue.empty()) {
+                // stopped, the rest was delivered by Stop
+                fScheduled = false;
+                cond.notify_all();
+                return;
+            }
+            callback = std::move(queue.front());
+            queue.pop_front();
+            fRunning = true;
+        }
+        try {
+            Run(callback);
+        } catch (...) {
+            // e.g. the thread being interrupted
+            std::lock_guard<std::mutex> lock(cs);
+            fScheduled = fRunning = false;
+            cond.notify_all();
+            throw;
+        }
+        std::lock_guard<std::mutex> lock(cs);
+        fScheduled = fRunning = false;
+        ScheduleNext();
+        cond.notify_all();
+    }
+
+public:
+    void Start(CScheduler& scheduler)
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        pscheduler = &scheduler;
+        ScheduleNext();
+    }
+
+    void Stop()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        pscheduler = nullptr;
+        cond.wait(lock, [this] { return !fRunning; });
+        // a task which is still scheduled returns right away now, if it runs at all
+        while (!queue.empty()) {
+            std::function<void()> callback = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            Run(callback);
+            lock.lock();
+        }
+    }
+
+    void Add(std::function<void()> callback)
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            if (pscheduler) {
+                queue.emplace_back(std::move(callback));
+                ScheduleNext();
+                return;
+            }
+        }
+        Run(callback);
+    }
+
+    void Sync()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        cond.wait(lock, [this] { return !pscheduler || (queue.empty() && !fScheduled); });
+    }
+};
+
+CBackgroundCallbackQueue backgroundCallbacks;
+
+} // namespace
+
+void StartBackgroundValidationCallbacks(CScheduler& scheduler)
+{
+    backgroundCallbacks.Start(scheduler);
+}
+
+void StopBackgroundValidationCallbacks()
+{
+    backgroundCallbacks.Stop();
+}
+
+void SyncWithBackgroundValidationCallbacks()
+{
+    backgroundCallbacks.Sync();
+}
+
+void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    signalUpdatedBlockTip.sync(pindexNew, pindexFork, fInitialDownload);
+    if (!signalUpdatedBlockTip.background.empty())
+        backgroundCallbacks.Add([this, pindexNew, pindexFork, fInitialDownload] { signalUpdatedBlockTip.background(pindexNew, pindexFork, fInitialDownload); });
+}
+
+void CMainSignals::SyncTransaction(const std::shared_ptr<const CTransaction>& ptx, const CBlockIndex *pindex, int posInBlock)
+{
+    signalSyncTransaction.sync(*ptx, pindex, posInBlock);
+    if (!signalSyncTransaction.background.empty())
+        backgroundCallbacks.Add([this, ptx, pindex, posInBlock] { signalSyncTransaction.background(*ptx, pindex, posInBlock); });
+}
+
+void CMainSignals::NotifyTransactionLock(const std::shared_ptr<const CTransaction>& ptx)
+{
+    signalNotifyTransactionLock.sync(*ptx);
+    if (!signalNotifyTransactionLock.background.empty())
+        backgroundCallbacks.Add([this, ptx] { signalNotifyTransactionLock.background(*ptx); });
+}
+
+void CMainSignals::NotifyChainLock(const CBlockIndex* pindex)
+{
+    signalNotifyChainLock.sync(pindex);
+    if (!signalNotifyChainLock.background.empty())
+        backgroundCallbacks.Add([this, pindex] { signalNotifyChainLock.background(pindex); });
+}
+
+void CMainSignals::TransactionRemovedFromMempool(const std::shared_ptr<const CTransaction>& ptx, MemPoolRemovalReason reason)
+{
+    signalTransactionRemovedFromMempool.sync(ptx, reason);
+    if (!signalTransactionRemovedFromMempool.background.empty())
+        backgroundCallbacks.Add([this, ptx, reason] { signalTransactionRemovedFromMempool.background(ptx, reason); });
+}
+
+void CMainSignals::NotifyRecoveredSig(const std::shared_ptr<const llmq::CRecoveredSig>& sig)
+{
+    signalNotifyRecoveredSig.sync(sig);
+    if (!signalNotifyRecoveredSig.background.empty())
+        backgroundCallbacks.Add([this, sig] { signalNotifyRecoveredSig.background(sig); });
+}
+
 void RegisterValidationInterface(CValidationInterface* pwalletIn) {
+    int nBackground = pwalletIn->GetBackgroundCallbacks();
     g_signals.AcceptedBlockHeader.connect(boost::bind(&CValidationInterface::AcceptedBlockHeader, pwalletIn, _1));
     g_signals.NotifyHeaderTip.connect(boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2));
-    g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
-    g_signals.NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
-    g_signals.NotifyChainLock.connect(boost::bind(&CValidationInterface::NotifyChainLock, pwalletIn, _1));
+    g_signals.signalUpdatedBlockTip.Select(nBackground & CValidationInterface::BG_UPDATED_BLOCK_TIP).connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
+    g_signals.signalSyncTransaction.Select(nBackground & CValidationInterface::BG_SYNC_TRANSACTION).connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
+    g_signals.signalNotifyTransactionLock.Select(nBackground & CValidationInterface::BG_NOTIFY_TRANSACTION_LOCK).connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
+    g_signals.signalNotifyChainLock.Select(nBackground & CValidationInterface::BG_NOTIFY_CHAIN_LOCK).connect(boost::bind(&CValidationInterface::NotifyChainLock, pwalletIn, _1));
     g_signals.UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
     g_signals.SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
     g_signals.Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
@@ -31,6 +208,8 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.NotifyGovernanceVote.connect(boost::bind(&CValidationInterface::NotifyGovernanceVote, pwalletIn, _1));
     g_signals.NotifyInstantSendDoubleSpendAttempt.connect(boost::bind(&CValidationInterface::NotifyInstantSendDoubleSpendAttempt, pwalletIn, _1, _2));
     g_signals.NotifyMasternodeListChanged.connect(boost::bind(&CValidationInterface::NotifyMasternodeListChanged, pwalletIn, _1, _2, _3));
+    g_signals.signalTransactionRemovedFromMempool.Select(nBackground & CValidationInterface::BG_TRANSACTION_REMOVED_FROM_MEMPOOL).connect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1, _2));
+    g_signals.signalNotifyRecoveredSig.Select(nBackground & CValidationInterface::BG_NOTIFY_RECOVERED_SIG).connect(boost::bind(&CValidationInterface::NotifyRecoveredSig, pwalletIn, _1));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
@@ -41,10 +220,14 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.Inventory.disconnect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
     g_signals.SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
     g_signals.UpdatedTransaction.disconnect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
-    g_signals.NotifyChainLock.disconnect(boost::bind(&CValidationInterface::NotifyChainLock, pwalletIn, _1));
-    g_signals.NotifyTransactionLock.disconnect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
-    g_signals.SyncTransaction.disconnect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
-    g_signals.UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
+    g_signals.signalNotifyChainLock.sync.disconnect(boost::bind(&CValidationInterface::NotifyChainLock, pwalletIn, _1));
+    g_signals.signalNotifyChainLock.background.disconnect(boost::bind(&CValidationInterface::NotifyChainLock, pwalletIn, _1));
+    g_signals.signalNotifyTransactionLock.sync.disconnect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
+    g_signals.signalNotifyTransactionLock.background.disconnect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
+    g_signals.signalSyncTransaction.sync.disconnect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
+    g_signals.signalSyncTransaction.background.disconnect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
+    g_signals.signalUpdatedBlockTip.sync.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
+    g_signals.signalUpdatedBlockTip.background.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
     g_signals.NewPoWValidBlock.disconnect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
     g_signals.NotifyHeaderTip.disconnect(boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2));
     g_signals.AcceptedBlockHeader.disconnect(boost::bind(&CValidationInterface::AcceptedBlockHeader, pwalletIn, _1));
@@ -52,6 +235,13 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.NotifyGovernanceVote.disconnect(boost::bind(&CValidationInterface::NotifyGovernanceVote, pwalletIn, _1));
     g_signals.NotifyInstantSendDoubleSpendAttempt.disconnect(boost::bind(&CValidationInterface::NotifyInstantSendDoubleSpendAttempt, pwalletIn, _1, _2));
     g_signals.NotifyMasternodeListChanged.disconnect(boost::bind(&CValidationInterface::NotifyMasternodeListChanged, pwalletIn, _1, _2, _3));
+    g_signals.signalTransactionRemovedFromMempool.sync.disconnect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1, _2));
+    g_signals.signalTransactionRemovedFromMempool.background.disconnect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1, _2));
+    g_signals.signalNotifyRecoveredSig.sync.disconnect(boost::bind(&CValidationInterface::NotifyRecoveredSig, pwalletIn, _1));
+    g_signals.signalNotifyRecoveredSig.background.disconnect(boost::bind(&CValidationInterface::NotifyRecoveredSig, pwalletIn, _1));
+    // nothing queued may call it anymore
+    if (pwalletIn->GetBackgroundCallbacks())
+        backgroundCallbacks.Sync();
 }
 
 void UnregisterAllValidationInterfaces() {
@@ -62,10 +252,14 @@ void UnregisterAllValidationInterfaces() {
     g_signals.Inventory.disconnect_all_slots();
     g_signals.SetBestChain.disconnect_all_slots();
     g_signals.UpdatedTransaction.disconnect_all_slots();
-    g_signals.NotifyTransactionLock.disconnect_all_slots();
-    g_signals.NotifyChainLock.disconnect_all_slots();
-    g_signals.SyncTransaction.disconnect_all_slots();
-    g_signals.UpdatedBlockTip.disconnect_all_slots();
+    g_signals.signalNotifyTransactionLock.sync.disconnect_all_slots();
+    g_signals.signalNotifyTransactionLock.background.disconnect_all_slots();
+    g_signals.signalNotifyChainLock.sync.disconnect_all_slots();
+    g_signals.signalNotifyChainLock.background.disconnect_all_slots();
+    g_signals.signalSyncTransaction.sync.disconnect_all_slots();
+    g_signals.signalSyncTransaction.background.disconnect_all_slots();
+    g_signals.signalUpdatedBlockTip.sync.disconnect_all_slots();
+    g_signals.signalUpdatedBlockTip.background.disconnect_all_slots();
     g_signals.NewPoWValidBlock.disconnect_all_slots();
     g_signals.NotifyHeaderTip.disconnect_all_slots();
     g_signals.AcceptedBlockHeader.disconnect_all_slots();
@@ -73,4 +267,8 @@ void UnregisterAllValidationInterfaces() {
     g_signals.NotifyGovernanceVote.disconnect_all_slots();
     g_signals.NotifyInstantSendDoubleSpendAttempt.disconnect_all_slots();
     g_signals.NotifyMasternodeListChanged.disconnect_all_slots();
+    g_signals.signalTransactionRemovedFromMempool.sync.disconnect_all_slots();
+    g_signals.signalTransactionRemovedFromMempool.background.disconnect_all_slots();
+    g_signals.signalNotifyRecoveredSig.sync.disconnect_all_slots();
+    g_signals.signalNotifyRecoveredSig.background.disconnect_all_slots();
 }
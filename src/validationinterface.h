@@ -15,6 +15,7 @@ class CBlockIndex;
 struct CBlockLocator;
 class CConnman;
 class CReserveScript;
+class CScheduler;
 class CTransaction;
 class CValidationInterface;
 class CValidationState;
@@ -23,6 +24,11 @@ class CGovernanceObject;
 class CDeterministicMNList;
 class CDeterministicMNListDiff;
 class uint256;
+enum class MemPoolRemovalReason;
+
+namespace llmq {
+    class CRecoveredSig;
+}
 
 // These functions dispatch to one or all registered wallets
 
@@ -33,8 +39,39 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
 void UnregisterAllValidationInterfaces();
 
+/**
+ * Starts delivering the background callbacks (see CValidationInterface::GetBackgroundCallbacks)
+ * with tasks named "validationinterface" on the scheduler. Until then they are delivered right away.
+ */
+void StartBackgroundValidationCallbacks(CScheduler& scheduler);
+/** Delivers what is still queued on the calling thread, later callbacks are delivered right away again */
+void StopBackgroundValidationCallbacks();
+/**
+ * Waits until the background callbacks queued so far were delivered. Must not be called with
+ * locks the listeners take, e.g. cs_main, or from a background callback.
+ */
+void SyncWithBackgroundValidationCallbacks();
+
 class CValidationInterface {
+public:
+    /** The callbacks which a listener can take in the background */
+    enum BackgroundCallback {
+        BG_UPDATED_BLOCK_TIP = 1 << 0,
+        BG_SYNC_TRANSACTION = 1 << 1,
+        BG_NOTIFY_TRANSACTION_LOCK = 1 << 2,
+        BG_NOTIFY_CHAIN_LOCK = 1 << 3,
+        BG_TRANSACTION_REMOVED_FROM_MEMPOOL = 1 << 4,
+        BG_NOTIFY_RECOVERED_SIG = 1 << 5,
+    };
+
 protected:
+    /**
+     * The callbacks, as BackgroundCallback flags, which are delivered to this listener on one
+     * background thread instead of right away. They come in the order they happened, but without
+     * the locks the caller held, e.g. cs_main, so the chain or the mempool may have moved on.
+     * Unregistering drops the ones still queued and waits for the one being delivered.
+     */
+    virtual int GetBackgroundCallbacks() const { return 0; }
     virtual void AcceptedBlockHeader(const CBlockIndex *pindexNew) {}
     virtual void NotifyHeaderTip(const CBlockIndex *pindexNew, bool fInitialDownload) {}
     virtual void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {}
@@ -45,6 +82,8 @@ protected:
     virtual void NotifyGovernanceObject(const CGovernanceObject &object) {}
     virtual void NotifyInstantSendDoubleSpendAttempt(const CTransaction &currentTx, const CTransaction &previousTx) {}
     virtual void NotifyMasternodeListChanged(bool undo, const CDeterministicMNList& oldMNList, const CDeterministicMNListDiff& diff) {}
+    virtual void TransactionRemovedFromMempool(const std::shared_ptr<const CTransaction>& ptx, MemPoolRemovalReason reason) {}
+    virtual void NotifyRecoveredSig(const std::shared_ptr<const llmq::CRecoveredSig>& sig) {}
     virtual void SetBestChain(const CBlockLocator &locator) {}
     virtual bool UpdatedTransaction(const uint256 &hash) { return false;}
     virtual void Inventory(const uint256 &hash) {}
@@ -58,13 +97,22 @@ protected:
     friend void ::UnregisterAllValidationInterfaces();
 };
 
+/** A callback with the listeners taking it right away and the ones taking it in the background */
+template <typename Signature>
+struct CMainSignal {
+    boost::signals2::signal<Signature> sync;
+    boost::signals2::signal<Signature> background;
+
+    boost::signals2::signal<Signature>& Select(bool fBackground) { return fBackground ? background : sync; }
+};
+
 struct CMainSignals {
     /** Notifies listeners of accepted block header */
     boost::signals2::signal<void (const CBlockIndex *)> AcceptedBlockHeader;
     /** Notifies listeners of updated block header tip */
     boost::signals2::signal<void (const CBlockIndex *, bool fInitialDownload)> NotifyHeaderTip;
     /** Notifies listeners of updated block chain tip */
-    boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
     /** A posInBlock value for SyncTransaction calls for transactions not
      * included in connected blocks such as transactions removed from mempool,
      * accepted to mempool or appearing in disconnected blocks.*/
@@ -75,11 +123,11 @@ struct CMainSignals {
      * transaction was accepted to mempool, removed from mempool (only when
      * removal was due to conflict from connected block), or appeared in a
      * disconnected block.*/
-    boost::signals2::signal<void (const CTransaction &, const CBlockIndex *pindex, int posInBlock)> SyncTransaction;
+    void SyncTransaction(const std::shared_ptr<const CTransaction>& ptx, const CBlockIndex *pindex, int posInBlock);
     /** Notifies listeners of an updated transaction lock without new data. */
-    boost::signals2::signal<void (const CTransaction &)> NotifyTransactionLock;
+    void NotifyTransactionLock(const std::shared_ptr<const CTransaction>& ptx);
     /** Notifies listeners of a ChainLock. */
-    boost::signals2::signal<void (const CBlockIndex* pindex)> NotifyChainLock;
+    void NotifyChainLock(const CBlockIndex* pindex);
     /** Notifies listeners of a new governance vote. */
     boost::signals2::signal<void (const CGovernanceVote &)> NotifyGovernanceVote;
     /** Notifies listeners of a new governance object. */
@@ -88,6 +136,10 @@ struct CMainSignals {
     boost::signals2::signal<void(const CTransaction &currentTx, const CTransaction &previousTx)> NotifyInstantSendDoubleSpendAttempt;
     /** Notifies listeners that the MN list changed */
     boost::signals2::signal<void(bool undo, const CDeterministicMNList& oldMNList, const CDeterministicMNListDiff& diff)> NotifyMasternodeListChanged;
+    /** Notifies listeners of a transaction leaving the mempool, for any reason including inclusion in a block */
+    void TransactionRemovedFromMempool(const std::shared_ptr<const CTransaction>& ptx, MemPoolRemovalReason reason);
+    /** Notifies listeners of a new LLMQ recovered signature */
+    void NotifyRecoveredSig(const std::shared_ptr<const llmq::CRecoveredSig>& sig);
     /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible). */
     boost::signals2::signal<bool (const uint256 &)> UpdatedTransaction;
     /** Notifies listeners of a new active block chain. */
@@ -106,6 +158,13 @@ struct CMainSignals {
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
     boost::signals2::signal<void (const CBlockIndex *, const std::shared_ptr<const CBlock>&)> NewPoWValidBlock;
+
+    CMainSignal<void (const CBlockIndex *, const CBlockIndex *, bool)> signalUpdatedBlockTip;
+    CMainSignal<void (const CTransaction &, const CBlockIndex *, int)> signalSyncTransaction;
+    CMainSignal<void (const CTransaction &)> signalNotifyTransactionLock;
+    CMainSignal<void (const CBlockIndex *)> signalNotifyChainLock;
+    CMainSignal<void (const std::shared_ptr<const CTransaction>&, MemPoolRemovalReason)> signalTransactionRemovedFromMempool;
+    CMainSignal<void (const std::shared_ptr<const llmq::CRecoveredSig>&)> signalNotifyRecoveredSig;
 };
 
 CMainSignals& GetMainSignals();
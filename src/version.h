@@ -15,7 +15,7 @@
  */
 
 
-static const int PROTOCOL_VERSION = 70218;
+static const int PROTOCOL_VERSION = 70219;
 
 //! initial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
@@ -59,6 +59,9 @@ static const int DMN_PROTO_VERSION = 70213;
 //! introduction of LLMQs
 static const int LLMQS_PROTO_VERSION = 70214;
 
+//! sig share inventories (QSIGSHARESINV/QGETSIGSHARES) may be run-length encoded
+static const int SIGSHARESINV_RUNLENGTH_PROTO_VERSION = 70219;
+
 //! introduction of SENDDSQUEUE
 //! TODO we can remove this in 0.15.0.0
 static const int SENDDSQUEUE_PROTO_VERSION = 70214;
@@ -10,10 +10,14 @@
 #include "script/standard.h"
 #include "util.h"
 
+#include <atomic>
 #include <string>
+#include <thread>
 #include <vector>
 #include <boost/foreach.hpp>
 
+static const int MAX_UNLOCK_THREADS = 8;
+
 int CCrypter::BytesToKeySHA512AES(const std::vector<unsigned char>& chSalt, const SecureString& strKeyData, int count, unsigned char *key,unsigned char *iv) const
 {
     // This mimics the behavior of openssl's EVP_BytesToKey with an aes256cbc
@@ -225,19 +229,41 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn, bool fForMixin
         bool keyPass = false;
         bool keyFail = false;
         CryptedKeyMap::const_iterator mi = mapCryptedKeys.begin();
-        for (; mi != mapCryptedKeys.end(); ++mi)
+        if (mi != mapCryptedKeys.end())
         {
-            const CPubKey &vchPubKey = (*mi).second.first;
-            const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second;
+            // A wrong passphrase already fails on the first key
             CKey key;
-            if (!DecryptKey(vMasterKeyIn, vchCryptedSecret, vchPubKey, key))
-            {
+            if (!DecryptKey(vMasterKeyIn, mi->second.second, mi->second.first, key))
                 keyFail = true;
-                break;
-            }
-            keyPass = true;
-            if (fDecryptionThoroughlyChecked)
-                break;
+            else
+                keyPass = true;
+        }
+        if (keyPass && !fDecryptionThoroughlyChecked)
+        {
+            // The first unlock checks all the other keys too, spread over the cores as each
+            // one costs an AES decryption and an EC key check
+            std::vector<const std::pair<CPubKey, std::vector<unsigned char> >*> vKeys;
+            vKeys.reserve(mapCryptedKeys.size());
+            for (++mi; mi != mapCryptedKeys.end(); ++mi)
+                vKeys.push_back(&mi->second);
+
+            std::atomic<size_t> nNextKey(0);
+            std::atomic<bool> fAnyFail(false);
+            auto checkKeys = [&]() {
+                for (size_t i = nNextKey++; i < vKeys.size() && !fAnyFail; i = nNextKey++) {
+                    CKey key;
+                    if (!DecryptKey(vMasterKeyIn, vKeys[i]->second, vKeys[i]->first, key))
+                        fAnyFail = true;
+                }
+            };
+            std::vector<std::thread> vThreads;
+            int nThreads = std::min<int>(std::min(GetNumCores(), MAX_UNLOCK_THREADS), vKeys.size() / 1000 + 1);
+            for (int i = 1; i < nThreads; i++)
+                vThreads.emplace_back(checkKeys);
+            checkKeys();
+            for (std::thread& thread : vThreads)
+                thread.join();
+            keyFail = fAnyFail;
         }
         if (keyPass && keyFail)
         {
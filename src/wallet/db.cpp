@@ -49,7 +49,7 @@ void CDBEnv::Reset()
     fMockDb = false;
 }
 
-CDBEnv::CDBEnv() : dbenv(NULL)
+CDBEnv::CDBEnv() : dbenv(NULL), nLogFlushRequested(0), nLogFlushDone(0), fLogFlushing(false)
 {
     Reset();
 }
@@ -423,12 +423,43 @@ void CDB::Flush()
     if (activeTxn)
         return;
 
-    // Flush database activity from memory pool to disk log
+    // The log makes the writes durable, the database files are only checkpointed once
+    // -dblogsize of log has accumulated (or after a minute for readers), and when idle by
+    // CDB::PeriodicFlush.
+    if (!fReadOnly)
+        bitdb.FlushLog();
+
     unsigned int nMinutes = 0;
     if (fReadOnly)
         nMinutes = 1;
 
-    bitdb.dbenv->txn_checkpoint(nMinutes ? GetArg("-dblogsize", DEFAULT_WALLET_DBLOGSIZE) * 1024 : 0, nMinutes, 0);
+    bitdb.dbenv->txn_checkpoint(GetArg("-dblogsize", DEFAULT_WALLET_DBLOGSIZE) * 1024, nMinutes, 0);
+}
+
+void CDBEnv::FlushLog()
+{
+    if (fMockDb)
+        return;
+
+    boost::unique_lock<boost::mutex> lock(cs_logflush);
+    // everything committed before taking the ticket is in any flush that starts afterwards
+    const uint64_t nTicket = ++nLogFlushRequested;
+    while (nLogFlushDone < nTicket) {
+        if (fLogFlushing) {
+            cvLogFlush.wait(lock);
+            continue;
+        }
+        fLogFlushing = true;
+        const uint64_t nCovered = nLogFlushRequested;
+        lock.unlock();
+        int ret = dbenv->log_flush(NULL);
+        lock.lock();
+        fLogFlushing = false;
+        if (ret != 0)
+            LogPrintf("CDBEnv::FlushLog: Error %d flushing log: %s\n", ret, DbEnv::strerror(ret));
+        nLogFlushDone = std::max(nLogFlushDone, nCovered);
+        cvLogFlush.notify_all();
+    }
 }
 
 void CDB::Close()
@@ -32,6 +32,13 @@ private:
     // shutdown problems/crashes caused by a static initialized internal pointer.
     std::string strPath;
 
+    //! Group commit of the log: tickets handed out and covered by a finished flush
+    CWaitableCriticalSection cs_logflush;
+    CConditionVariable cvLogFlush;
+    uint64_t nLogFlushRequested;
+    uint64_t nLogFlushDone;
+    bool fLogFlushing;
+
     void EnvShutdown();
 
 public:
@@ -71,6 +78,12 @@ public:
     void Close();
     void Flush(bool fShutdown);
     void CheckpointLSN(const std::string& strFile);
+    /**
+     * Make all transactions committed so far durable by flushing the log to disk. Callers
+     * that arrive while a flush runs wait for the next one, which then covers all of them,
+     * so concurrent writers share a single sync.
+     */
+    void FlushLog();
 
     void CloseDb(const std::string& strFile);
     bool RemoveDb(const std::string& strFile);
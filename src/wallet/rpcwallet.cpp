@@ -138,7 +138,7 @@ UniValue getnewaddress(const JSONRPCRequest& request)
         strAccount = AccountFromValue(request.params[0]);
 
     if (!pwallet->IsLocked(true)) {
-        pwallet->TopUpKeyPool();
+        pwallet->ScheduleTopUpKeyPool();
     }
 
     // Generate a new key that is added to wallet
@@ -220,7 +220,7 @@ UniValue getrawchangeaddress(const JSONRPCRequest& request)
     LOCK2(cs_main, pwallet->cs_wallet);
 
     if (!pwallet->IsLocked(true)) {
-        pwallet->TopUpKeyPool();
+        pwallet->ScheduleTopUpKeyPool();
     }
 
     CReserveKey reservekey(pwallet);
@@ -1848,8 +1848,10 @@ UniValue listsinceblock(const JSONRPCRequest& request)
 
     UniValue transactions(UniValue::VARR);
 
-    for (const std::pair<uint256, CWalletTx>& pairWtx : pwallet->mapWallet) {
-        CWalletTx tx = pairWtx.second;
+    std::set<uint256> setTxs;
+    pwallet->GetTxsSinceBlock(pindex, setTxs);
+    for (const uint256& hash : setTxs) {
+        const CWalletTx& tx = pwallet->mapWallet.at(hash);
 
         if (depth == -1 || tx.GetDepthInMainChain() < depth)
             ListTransactions(pwallet, tx, "*", 0, true, transactions, filter);
@@ -2068,6 +2070,7 @@ static void LockWallet(CWallet* pWallet)
     LOCK(pWallet->cs_wallet);
     pWallet->nRelockTime = 0;
     pWallet->Lock();
+    pWallet->ClearStakingKeys();
 }
 
 UniValue walletpassphrase(const JSONRPCRequest& request)
@@ -2077,15 +2080,17 @@ UniValue walletpassphrase(const JSONRPCRequest& request)
         return NullUniValue;
     }
 
-    if (pwallet->IsCrypted() && (request.fHelp || request.params.size() < 2 || request.params.size() > 3)) {
+    if (pwallet->IsCrypted() && (request.fHelp || request.params.size() < 2 || request.params.size() > 4)) {
         throw std::runtime_error(
-            "walletpassphrase \"passphrase\" timeout ( mixingonly )\n"
+            "walletpassphrase \"passphrase\" timeout ( mixingonly stakingonly )\n"
             "\nStores the wallet decryption key in memory for 'timeout' seconds.\n"
             "This is needed prior to performing transactions related to private keys such as sending epmcoins\n"
             "\nArguments:\n"
             "1. \"passphrase\"        (string, required) The wallet passphrase\n"
             "2. timeout             (numeric, required) The time to keep the decryption key in seconds.\n"
             "3. mixingonly          (boolean, optional, default=false) If is true sending functions are disabled.\n"
+            "4. stakingonly         (boolean, optional, default=false) If is true only the keys of the coins that can stake\n"
+            "                       are kept in memory and the wallet stays locked for everything else.\n"
             "\nNote:\n"
             "Issuing the walletpassphrase command while the wallet is already unlocked will set a new unlock\n"
             "time that overrides the old one.\n"
@@ -2094,6 +2099,8 @@ UniValue walletpassphrase(const JSONRPCRequest& request)
             + HelpExampleCli("walletpassphrase", "\"my pass phrase\" 60") +
             "\nUnlock the wallet for 60 seconds but allow PrivateSend mixing only\n"
             + HelpExampleCli("walletpassphrase", "\"my pass phrase\" 60 true") +
+            "\nUnlock the wallet for staking only for one day\n"
+            + HelpExampleCli("walletpassphrase", "\"my pass phrase\" 86400 false true") +
             "\nLock the wallet again (before 60 seconds)\n"
             + HelpExampleCli("walletlock", "") +
             "\nAs json rpc call\n"
@@ -2122,16 +2129,30 @@ UniValue walletpassphrase(const JSONRPCRequest& request)
     if (request.params.size() >= 3)
         fForMixingOnly = request.params[2].get_bool();
 
+    bool fForStakingOnly = false;
+    if (request.params.size() >= 4)
+        fForStakingOnly = request.params[3].get_bool();
+
+    if (fForMixingOnly && fForStakingOnly)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Error: mixingonly and stakingonly can't be combined.");
+
     if (fForMixingOnly && !pwallet->IsLocked(true) && pwallet->IsLocked())
         throw JSONRPCError(RPC_WALLET_ALREADY_UNLOCKED, "Error: Wallet is already unlocked for mixing only.");
 
     if (!pwallet->IsLocked())
         throw JSONRPCError(RPC_WALLET_ALREADY_UNLOCKED, "Error: Wallet is already fully unlocked.");
 
-    if (!pwallet->Unlock(strWalletPass, fForMixingOnly))
-        throw JSONRPCError(RPC_WALLET_PASSPHRASE_INCORRECT, "Error: The wallet passphrase entered was incorrect.");
+    if (fForStakingOnly) {
+        if (!pwallet->IsLocked(true))
+            throw JSONRPCError(RPC_WALLET_ALREADY_UNLOCKED, "Error: Wallet is already unlocked for mixing only.");
+        if (!pwallet->UnlockForStaking(strWalletPass))
+            throw JSONRPCError(RPC_WALLET_PASSPHRASE_INCORRECT, "Error: The wallet passphrase entered was incorrect.");
+    } else {
+        if (!pwallet->Unlock(strWalletPass, fForMixingOnly))
+            throw JSONRPCError(RPC_WALLET_PASSPHRASE_INCORRECT, "Error: The wallet passphrase entered was incorrect.");
 
-    pwallet->TopUpKeyPool();
+        pwallet->ScheduleTopUpKeyPool();
+    }
 
     pwallet->nRelockTime = GetTime() + nSleepTime;
     RPCRunLater(strprintf("lockwallet(%s)", pwallet->strWalletFile), boost::bind(LockWallet, pwallet), nSleepTime);
@@ -2225,6 +2246,7 @@ UniValue walletlock(const JSONRPCRequest& request)
     }
 
     pwallet->Lock();
+    pwallet->ClearStakingKeys();
     pwallet->nRelockTime = 0;
 
     return NullUniValue;
@@ -3041,7 +3063,7 @@ static const CRPCCommand commands[] =
     { "wallet",             "signmessage",              &signmessage,              true,   {"address","message"} },
     { "wallet",             "walletlock",               &walletlock,               true,   {} },
     { "wallet",             "walletpassphrasechange",   &walletpassphrasechange,   true,   {"oldpassphrase","newpassphrase"} },
-    { "wallet",             "walletpassphrase",         &walletpassphrase,         true,   {"passphrase","timeout","mixingonly"} },
+    { "wallet",             "walletpassphrase",         &walletpassphrase,         true,   {"passphrase","timeout","mixingonly","stakingonly"} },
     { "wallet",             "removeprunedfunds",        &removeprunedfunds,        true,   {"txid"} },
 
     { "wallet",             "keepass",                  &keepass,                  true,   {} },
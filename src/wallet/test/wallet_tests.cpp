@@ -9,6 +9,7 @@
 #include <utility>
 #include <vector>
 
+#include "arith_uint256.h"
 #include "rpc/server.h"
 #include "test/test_epmcoin.h"
 #include "validation.h"
@@ -520,7 +521,7 @@ static int64_t AddTx(CWallet& wallet, uint32_t lockTime, int64_t mockTime, int64
     SetMockTime(mockTime);
     CBlockIndex* block = nullptr;
     if (blockTime > 0) {
-        auto inserted = mapBlockIndex.emplace(GetRandHash(), new CBlockIndex);
+        auto inserted = mapBlockIndex.emplace(GetRandHash(), blockIndexArena.Allocate());
         assert(inserted.second);
         const uint256& hash = inserted.first->first;
         block = inserted.first->second;
@@ -566,4 +567,68 @@ BOOST_AUTO_TEST_CASE(ComputeTimeSmart)
     SetMockTime(0);
 }
 
+BOOST_AUTO_TEST_CASE(stake_maintenance_plan)
+{
+    CScript scriptA = CScript() << OP_1;
+    CScript scriptB = CScript() << OP_2;
+    CScript scriptC = CScript() << OP_3;
+    std::vector<CStakeMaintenanceCoin> vStakeCoins;
+    auto addCoin = [&](const CScript& script, CAmount nValue) {
+        vStakeCoins.push_back({COutPoint(ArithToUint256(vStakeCoins.size() + 1), 0), script, nValue});
+        return vStakeCoins.back().outpoint;
+    };
+    const CAmount nTarget = 100 * COIN;
+    const CAmount nMaxFee = 1 * COIN;
+    std::vector<COutPoint> vInputs;
+    std::vector<CRecipient> vRecipients;
+
+    // the small coins of an address are combined smallest first until they reach the target
+    COutPoint a1 = addCoin(scriptA, 30 * COIN);
+    COutPoint a2 = addCoin(scriptA, 40 * COIN);
+    COutPoint a3 = addCoin(scriptA, 50 * COIN);
+    COutPoint a4 = addCoin(scriptA, 20 * COIN);
+    addCoin(scriptA, 90 * COIN);
+    addCoin(scriptB, 60 * COIN);
+    COutPoint c1 = addCoin(scriptC, 1000 * COIN);
+    BOOST_CHECK(PlanStakeMaintenance(vStakeCoins, nTarget, nMaxFee, vInputs, vRecipients));
+    BOOST_CHECK(std::set<COutPoint>(vInputs.begin(), vInputs.end()) == std::set<COutPoint>({a1, a2, a3, a4}));
+    BOOST_CHECK_EQUAL(vRecipients.size(), 1U);
+    BOOST_CHECK(vRecipients[0].scriptPubKey == scriptA);
+    BOOST_CHECK_EQUAL(vRecipients[0].nAmount, 140 * COIN);
+    BOOST_CHECK(vRecipients[0].fSubtractFeeFromAmount);
+
+    // a single small coin stays, the large one is split into outputs of at least the target
+    vStakeCoins.erase(vStakeCoins.begin(), vStakeCoins.begin() + 5);
+    BOOST_CHECK(PlanStakeMaintenance(vStakeCoins, nTarget, nMaxFee, vInputs, vRecipients));
+    BOOST_CHECK(vInputs == std::vector<COutPoint>({c1}));
+    BOOST_CHECK_EQUAL(vRecipients.size(), 9U);
+    CAmount nTotal = 0;
+    for (const auto& recipient : vRecipients) {
+        BOOST_CHECK(recipient.scriptPubKey == scriptC);
+        BOOST_CHECK(recipient.nAmount - (recipient.fSubtractFeeFromAmount ? nMaxFee : 0) >= nTarget);
+        nTotal += recipient.nAmount;
+    }
+    BOOST_CHECK_EQUAL(nTotal, 1000 * COIN);
+    BOOST_CHECK(vRecipients.back().fSubtractFeeFromAmount);
+
+    // nothing to do with coins of the right size, a few small ones and dust
+    vStakeCoins.clear();
+    addCoin(scriptA, 150 * COIN);
+    addCoin(scriptA, 200 * COIN);
+    for (int i = 0; i < 9; i++) {
+        addCoin(scriptB, 1 * COIN);
+        addCoin(scriptC, COIN / 1000);
+    }
+    BOOST_CHECK(!PlanStakeMaintenance(vStakeCoins, nTarget, nMaxFee, vInputs, vRecipients));
+    BOOST_CHECK(vInputs.empty() && vRecipients.empty());
+
+    // but enough small ones are combined even if they don't add up to the target
+    addCoin(scriptB, 1 * COIN);
+    BOOST_CHECK(PlanStakeMaintenance(vStakeCoins, nTarget, nMaxFee, vInputs, vRecipients));
+    BOOST_CHECK_EQUAL(vInputs.size(), MIN_STAKE_COMBINE_INPUTS);
+    BOOST_CHECK_EQUAL(vRecipients.size(), 1U);
+    BOOST_CHECK(vRecipients[0].scriptPubKey == scriptB);
+    BOOST_CHECK_EQUAL(vRecipients[0].nAmount, 10 * COIN);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -21,6 +21,7 @@
 #include "key.h"
 #include "keystore.h"
 #include "masternode-payments.h"
+#include "metrics.h"
 #include "validation.h"
 #include "net.h"
 #include "policy/policy.h"
@@ -47,6 +48,8 @@
 #include "llmq/quorums_chainlocks.h"
 
 #include <assert.h>
+#include <atomic>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
@@ -199,6 +202,114 @@ void CWallet::DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, u
         throw std::runtime_error(std::string(__func__) + ": AddHDPubKey failed");
 }
 
+/** Fewer keys than this are derived on the calling thread alone */
+static const size_t MIN_PARALLEL_DERIVE_KEYS = 16;
+static const int MAX_DERIVE_THREADS = 8;
+
+void CWallet::DeriveNewChildKeys(CWalletDB& walletdb, uint32_t nAccountIndex, bool fInternal, size_t nCount, std::vector<CPubKey>& vPubKeysRet)
+{
+    AssertLockHeld(cs_wallet); // mapKeyMetadata, mapHdPubKeys
+
+    CHDChain hdChainTmp;
+    if (!GetHDChain(hdChainTmp)) {
+        throw std::runtime_error(std::string(__func__) + ": GetHDChain failed");
+    }
+
+    if (!DecryptHDChain(hdChainTmp))
+        throw std::runtime_error(std::string(__func__) + ": DecryptHDChainSeed failed");
+    // make sure seed matches this chain
+    if (hdChainTmp.GetID() != hdChainTmp.GetSeedHash())
+        throw std::runtime_error(std::string(__func__) + ": Wrong HD chain!");
+
+    CHDAccount acc;
+    if (!hdChainTmp.GetAccount(nAccountIndex, acc))
+        throw std::runtime_error(std::string(__func__) + ": Wrong HD account!");
+
+    // the hardened part of the path only once, then the child keys on a few threads
+    CExtKey changeKey;
+    hdChainTmp.DeriveChangeExtKey(nAccountIndex, fInternal, changeKey);
+
+    CHDChain hdChainCurrent;
+    GetHDChain(hdChainCurrent);
+
+    CKeyMetadata metadata(GetTime());
+    uint32_t nChildIndex = fInternal ? acc.nInternalChainCounter : acc.nExternalChainCounter;
+    vPubKeysRet.clear();
+    while (vPubKeysRet.size() < nCount) {
+        std::vector<CExtPubKey> vChildKeys(nCount - vPubKeysRet.size());
+        std::atomic<size_t> nNextKey(0);
+        auto deriveKeys = [&]() {
+            for (size_t i = nNextKey++; i < vChildKeys.size(); i = nNextKey++) {
+                CExtKey childKey;
+                changeKey.Derive(childKey, nChildIndex + i);
+                vChildKeys[i] = childKey.Neuter();
+                assert(childKey.key.VerifyPubKey(vChildKeys[i].pubkey));
+            }
+        };
+        std::vector<std::thread> vThreads;
+        if (vChildKeys.size() >= MIN_PARALLEL_DERIVE_KEYS) {
+            for (int i = 1; i < std::min(GetNumCores(), MAX_DERIVE_THREADS); i++)
+                vThreads.emplace_back(deriveKeys);
+        }
+        deriveKeys();
+        for (std::thread& thread : vThreads)
+            thread.join();
+
+        // skip keys already known to the wallet, the loop derives replacements for them
+        for (const CExtPubKey& extPubKey : vChildKeys) {
+            nChildIndex++;
+            const CKeyID keyID = extPubKey.pubkey.GetID();
+            if (HaveKey(keyID))
+                continue;
+
+            mapKeyMetadata[keyID] = metadata;
+
+            CHDPubKey hdPubKey;
+            hdPubKey.extPubKey = extPubKey;
+            hdPubKey.hdchainID = hdChainCurrent.GetID();
+            hdPubKey.nAccountIndex = nAccountIndex;
+            hdPubKey.nChangeIndex = fInternal ? 1 : 0;
+            mapHdPubKeys[keyID] = hdPubKey;
+            AddToMineFilter(keyID);
+
+            // check if we need to remove from watch-only, like AddHDPubKey but through walletdb
+            for (const CScript& script : {GetScriptForDestination(keyID), GetScriptForRawPubKey(extPubKey.pubkey)}) {
+                if (HaveWatchOnly(script) && CCryptoKeyStore::RemoveWatchOnly(script)) {
+                    if (!HaveWatchOnly())
+                        NotifyWatchonlyChanged(false);
+                    if (fFileBacked && !walletdb.EraseWatchOnly(script))
+                        throw std::runtime_error(std::string(__func__) + ": EraseWatchOnly failed");
+                }
+            }
+
+            if (fFileBacked && !walletdb.WriteHDPubKey(hdPubKey, metadata))
+                throw std::runtime_error(std::string(__func__) + ": WriteHDPubKey failed");
+            vPubKeysRet.push_back(extPubKey.pubkey);
+        }
+    }
+    UpdateTimeFirstKey(metadata.nCreateTime);
+
+    // update the chain model in the database
+    if (fInternal) {
+        acc.nInternalChainCounter = nChildIndex;
+    }
+    else {
+        acc.nExternalChainCounter = nChildIndex;
+    }
+
+    if (!hdChainCurrent.SetAccount(nAccountIndex, acc))
+        throw std::runtime_error(std::string(__func__) + ": SetAccount failed");
+
+    if (IsCrypted()) {
+        if (!SetCryptedHDChain(hdChainCurrent, true) || (fFileBacked && !walletdb.WriteCryptedHDChain(hdChainCurrent)))
+            throw std::runtime_error(std::string(__func__) + ": SetCryptedHDChain failed");
+    }
+    else {
+        if (!SetHDChain(hdChainCurrent, true) || (fFileBacked && !walletdb.WriteHDChain(hdChainCurrent)))
+            throw std::runtime_error(std::string(__func__) + ": SetHDChain failed");
+    }
+}
+
 bool CWallet::GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const
 {
     LOCK(cs_wallet);
@@ -254,9 +365,42 @@ bool CWallet::LoadHDPubKey(const CHDPubKey &hdPubKey)
     AssertLockHeld(cs_wallet);
 
     mapHdPubKeys[hdPubKey.extPubKey.pubkey.GetID()] = hdPubKey;
+    AddToMineFilter(hdPubKey.extPubKey.pubkey.GetID());
     return true;
 }
 
+/** The id a P2PKH, P2SH or P2PK script pays to, for the IsMine prefilter */
+static bool GetMineFilterId(const CScript& script, uint160& idRet)
+{
+    if (script.IsPayToPublicKeyHash()) {
+        memcpy(idRet.begin(), &script[3], 20);
+        return true;
+    }
+    if (script.IsPayToScriptHash()) {
+        memcpy(idRet.begin(), &script[2], 20);
+        return true;
+    }
+    // a push of 33 or 65 bytes and OP_CHECKSIG
+    if ((script.size() == 35 || script.size() == 67) && script[0] == script.size() - 2 && script.back() == OP_CHECKSIG) {
+        idRet = Hash160(script.begin() + 1, script.end() - 1);
+        return true;
+    }
+    return false;
+}
+
+void CWallet::AddToMineFilter(const uint160& id)
+{
+    LOCK(cs_mineFilter);
+    setMineFilter.insert(id);
+}
+
+void CWallet::AddToMineFilter(const CScript& script)
+{
+    uint160 id;
+    if (GetMineFilterId(script, id))
+        AddToMineFilter(id);
+}
+
 bool CWallet::AddHDPubKey(const CExtPubKey &extPubKey, bool fInternal)
 {
     AssertLockHeld(cs_wallet);
@@ -269,6 +413,7 @@ bool CWallet::AddHDPubKey(const CExtPubKey &extPubKey, bool fInternal)
     hdPubKey.hdchainID = hdChainCurrent.GetID();
     hdPubKey.nChangeIndex = fInternal ? 1 : 0;
     mapHdPubKeys[extPubKey.pubkey.GetID()] = hdPubKey;
+    AddToMineFilter(extPubKey.pubkey.GetID());
 
     // check if we need to remove from watch-only
     CScript script;
@@ -288,6 +433,7 @@ bool CWallet::AddHDPubKey(const CExtPubKey &extPubKey, bool fInternal)
 bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
 {
     AssertLockHeld(cs_wallet); // mapKeyMetadata
+    AddToMineFilter(pubkey.GetID());
     if (!CCryptoKeyStore::AddKeyPubKey(secret, pubkey))
         return false;
 
@@ -313,6 +459,7 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
 bool CWallet::AddCryptedKey(const CPubKey &vchPubKey,
                             const std::vector<unsigned char> &vchCryptedSecret)
 {
+    AddToMineFilter(vchPubKey.GetID());
     if (!CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret))
         return false;
     if (!fFileBacked)
@@ -341,6 +488,7 @@ bool CWallet::LoadKeyMetadata(const CTxDestination& keyID, const CKeyMetadata &m
 
 bool CWallet::LoadCryptedKey(const CPubKey &vchPubKey, const std::vector<unsigned char> &vchCryptedSecret)
 {
+    AddToMineFilter(vchPubKey.GetID());
     return CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret);
 }
 
@@ -358,6 +506,7 @@ void CWallet::UpdateTimeFirstKey(int64_t nCreateTime)
 
 bool CWallet::AddCScript(const CScript& redeemScript)
 {
+    AddToMineFilter(CScriptID(redeemScript));
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
     if (!fFileBacked)
@@ -378,11 +527,13 @@ bool CWallet::LoadCScript(const CScript& redeemScript)
         return true;
     }
 
+    AddToMineFilter(CScriptID(redeemScript));
     return CCryptoKeyStore::AddCScript(redeemScript);
 }
 
 bool CWallet::AddWatchOnly(const CScript& dest)
 {
+    AddToMineFilter(dest);
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
     const CKeyMetadata& meta = mapKeyMetadata[CScriptID(dest)];
@@ -420,6 +571,7 @@ bool CWallet::RemoveWatchOnly(const CScript &dest)
 
 bool CWallet::LoadWatchOnly(const CScript &dest)
 {
+    AddToMineFilter(dest);
     return CCryptoKeyStore::AddWatchOnly(dest);
 }
 
@@ -1023,12 +1175,12 @@ void CWallet::MarkDirty()
 {
     {
         LOCK(cs_wallet);
+        fBalanceCacheValid = false;
         BOOST_FOREACH(PAIRTYPE(const uint256, CWalletTx)& item, mapWallet)
             item.second.MarkDirty();
     }
 
-    fAnonymizableTallyCached = false;
-    fAnonymizableTallyCachedNonDenom = false;
+    ResetTallyCache();
 }
 
 bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
@@ -1100,6 +1252,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 
     // Break debit/credit balance caches:
     wtx.MarkDirty();
+    IndexTxHistory(hash);
 
     // Notify UI of new or updated transaction
     NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -1113,8 +1266,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         boost::thread t(runCommand, strCmd); // thread runs free
     }
 
-    fAnonymizableTallyCached = false;
-    fAnonymizableTallyCachedNonDenom = false;
+    ResetTallyCache();
 
     return true;
 }
@@ -1123,11 +1275,11 @@ bool CWallet::LoadToWallet(const CWalletTx& wtxIn)
 {
     uint256 hash = wtxIn.GetHash();
 
-    mapWallet[hash] = wtxIn;
-    CWalletTx& wtx = mapWallet[hash];
+    CWalletTx& wtx = (mapWallet[hash] = wtxIn);
     wtx.BindWallet(this);
     wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
     AddToSpends(hash);
+    IndexTxHistory(hash);
     BOOST_FOREACH(const CTxIn& txin, wtx.tx->vin) {
         if (mapWallet.count(txin.prevout.hash)) {
             CWalletTx& prevtx = mapWallet[txin.prevout.hash];
@@ -1140,6 +1292,55 @@ bool CWallet::LoadToWallet(const CWalletTx& wtxIn)
     return true;
 }
 
+void CWallet::IndexTxHistory(const uint256& hash, bool fDisconnected)
+{
+    AssertLockHeld(cs_wallet);
+
+    std::map<uint256, uint256>::iterator itListed = mapTxHistoryBlock.find(hash);
+    if (itListed != mapTxHistoryBlock.end()) {
+        std::map<uint256, std::set<uint256> >::iterator itBlock = mapTxsByBlock.find(itListed->second);
+        itBlock->second.erase(hash);
+        if (itBlock->second.empty())
+            mapTxsByBlock.erase(itBlock);
+        mapTxHistoryBlock.erase(itListed);
+    }
+
+    std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+    if (it == mapWallet.end())
+        return;
+    const CWalletTx& wtx = it->second;
+    uint256 hashListed;
+    if (!fDisconnected && !wtx.hashUnset() && wtx.nIndex != -1)
+        hashListed = wtx.hashBlock;
+    mapTxsByBlock[hashListed].insert(hash);
+    mapTxHistoryBlock.emplace(hash, hashListed);
+}
+
+void CWallet::GetTxsSinceBlock(const CBlockIndex* pindex, std::set<uint256>& setTxsRet) const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    setTxsRet.clear();
+    if (!pindex) {
+        for (const auto& item : mapWallet)
+            setTxsRet.insert(item.first);
+        return;
+    }
+
+    // the transactions not confirmed in a block, and those in the blocks after pindex. A
+    // transaction listed under a block that isn't in chainActive anymore was disconnected
+    // and listed under the null hash by SyncTransaction.
+    std::map<uint256, std::set<uint256> >::const_iterator it = mapTxsByBlock.find(uint256());
+    if (it != mapTxsByBlock.end())
+        setTxsRet.insert(it->second.begin(), it->second.end());
+    for (const CBlockIndex* pindexNext = chainActive.Next(pindex); pindexNext; pindexNext = chainActive.Next(pindexNext)) {
+        it = mapTxsByBlock.find(pindexNext->GetBlockHash());
+        if (it != mapTxsByBlock.end())
+            setTxsRet.insert(it->second.begin(), it->second.end());
+    }
+}
+
 /**
  * Add a transaction to the wallet, or update it.  pIndex and posInBlock should
  * be set when the transaction was known to be included in a block.  When
@@ -1221,6 +1422,7 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             wtx.nIndex = -1;
             wtx.setAbandoned();
             wtx.MarkDirty();
+            IndexTxHistory(now);
             walletdb.WriteTx(wtx);
             NotifyTransactionChanged(this, wtx.GetHash(), CT_UPDATED);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them abandoned too
@@ -1241,8 +1443,7 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
         }
     }
 
-    fAnonymizableTallyCached = false;
-    fAnonymizableTallyCachedNonDenom = false;
+    ResetTallyCache();
 
     return true;
 }
@@ -1286,6 +1487,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             wtx.nIndex = -1;
             wtx.hashBlock = hashBlock;
             wtx.MarkDirty();
+            IndexTxHistory(now);
             walletdb.WriteTx(wtx);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them conflicted too
             TxSpends::const_iterator iter = mapTxSpends.lower_bound(COutPoint(now, 0));
@@ -1305,8 +1507,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
         }
     }
 
-    fAnonymizableTallyCached = false;
-    fAnonymizableTallyCachedNonDenom = false;
+    ResetTallyCache();
 }
 
 void CWallet::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock)
@@ -1315,13 +1516,16 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex,
 
     // v0.14.0.x: Simulates the behavior found in the develop branch when ::BlockConnected/BlockDisconnected are called
     if (pindex != nullptr && (posInBlock == 0 || posInBlock == CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK)) {
-        fAnonymizableTallyCached = false;
-        fAnonymizableTallyCachedNonDenom = false;
+        ResetTallyCache();
     }
 
     if (!AddToWalletIfInvolvingMe(tx, pindex, posInBlock, true))
         return; // Not one of ours
 
+    // AddToWallet keeps the block of a transaction that got disconnected
+    if (posInBlock == CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK)
+        IndexTxHistory(tx.GetHash(), true);
+
     // If a transaction changes 'conflicted' state, that changes the balance
     // available of the outputs it spends. So force those to be
     // recomputed, also:
@@ -1331,8 +1535,7 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex,
             mapWallet[txin.prevout.hash].MarkDirty();
     }
 
-    fAnonymizableTallyCached = false;
-    fAnonymizableTallyCachedNonDenom = false;
+    ResetTallyCache();
 }
 
 
@@ -1477,6 +1680,12 @@ bool CWallet::IsDenominated(const COutPoint& outpoint) const
 
 isminetype CWallet::IsMine(const CTxOut& txout) const
 {
+    uint160 id;
+    if (GetMineFilterId(txout.scriptPubKey, id)) {
+        LOCK(cs_mineFilter);
+        if (!setMineFilter.count(id))
+            return ISMINE_NO;
+    }
     return ::IsMine(*this, txout.scriptPubKey);
 }
 
@@ -1821,6 +2030,73 @@ void CWalletTx::GetAccountAmounts(const std::string& strAccount, CAmount& nRecei
     }
 }
 
+void CWallet::GetRescanFilter(std::set<CKeyID>& setKeyIDs, std::set<CScriptID>& setScriptIDs, std::set<CScript>& setScripts) const
+{
+    LOCK2(cs_wallet, cs_KeyStore);
+    GetKeys(setKeyIDs);
+    for (const auto& item : mapHdPubKeys)
+        setKeyIDs.insert(item.first);
+    for (const auto& item : mapWatchKeys)
+        setKeyIDs.insert(item.first);
+    for (const auto& item : mapScripts)
+        setScriptIDs.insert(item.first);
+    setScripts = setWatchOnly;
+}
+
+/** Blocks read ahead at a time by the rescan threads */
+static const int RESCAN_BATCH_SIZE = 256;
+static const int MAX_RESCAN_THREADS = 8;
+
+namespace {
+
+/** A snapshot of the wallet's keys and scripts, to test outputs without any lock */
+struct CRescanFilter
+{
+    std::set<CKeyID> setKeyIDs;
+    std::set<CScriptID> setScriptIDs;
+    std::set<CScript> setScripts;
+
+    //! True for every output IsMine accepts, and for a few it doesn't, like partly owned multisig
+    bool MayBeMine(const CTxOut& txout) const
+    {
+        if (setScripts.count(txout.scriptPubKey))
+            return true;
+
+        std::vector<std::vector<unsigned char> > vSolutions;
+        txnouttype whichType;
+        if (!Solver(txout.scriptPubKey, whichType, vSolutions))
+            return false;
+        switch (whichType) {
+        case TX_PUBKEY:
+            return setKeyIDs.count(CPubKey(vSolutions[0]).GetID()) > 0;
+        case TX_PUBKEYHASH:
+            return setKeyIDs.count(CKeyID(uint160(vSolutions[0]))) > 0;
+        case TX_SCRIPTHASH:
+            return setScriptIDs.count(CScriptID(uint160(vSolutions[0]))) > 0;
+        case TX_MULTISIG:
+            for (size_t i = 1; i + 1 < vSolutions.size(); i++) {
+                if (setKeyIDs.count(CPubKey(vSolutions[i]).GetID()))
+                    return true;
+            }
+            return false;
+        default:
+            return false;
+        }
+    }
+};
+
+struct CRescanBlock
+{
+    CBlockIndex* pindex;
+    CDiskBlockPos pos;
+    bool fRead = false;
+    CBlock block;
+    //! Per tx, whether one of its outputs may be ours
+    std::vector<char> vfMayBeMine;
+};
+
+} // namespace
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
@@ -1833,45 +2109,110 @@ void CWalletTx::GetAccountAmounts(const std::string& strAccount, CAmount& nRecei
 CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
     CBlockIndex* ret = nullptr;
-    int64_t nNow = GetTime();
+    int64_t nStartTime = GetTime();
+    int64_t nNow = nStartTime;
     const CChainParams& chainParams = Params();
+    const int nThreads = std::max(1, std::min(GetNumCores(), MAX_RESCAN_THREADS));
+
+    CRescanFilter filter;
+    GetRescanFilter(filter.setKeyIDs, filter.setScriptIDs, filter.setScripts);
 
     CBlockIndex* pindex = pindexStart;
+    double dProgressStart, dProgressTip;
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK(cs_main);
 
         // no need to read and scan block, if block was created before
         // our wallet birthday (as adjusted for block time variability)
         while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - TIMESTAMP_WINDOW)))
             pindex = chainActive.Next(pindex);
 
-        ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindex);
-        double dProgressTip = GuessVerificationProgress(chainParams.TxData(), chainActive.Tip());
-        while (pindex)
+        dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindex);
+        dProgressTip = GuessVerificationProgress(chainParams.TxData(), chainActive.Tip());
+    }
+    ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
+
+    // Blocks are read, deserialized and run through the filter by a few threads a batch at a
+    // time, the locks are only taken to find the next batch and to add what was found. Any
+    // tx the filter lets through, or that spends from or already is in the wallet, goes to
+    // AddToWalletIfInvolvingMe in chain order as before.
+    std::vector<CRescanBlock> vBatch;
+    while (pindex)
+    {
+        vBatch.clear();
         {
+            LOCK(cs_main);
+            for (CBlockIndex* pindexBatch = pindex; pindexBatch && (int)vBatch.size() < RESCAN_BATCH_SIZE; pindexBatch = chainActive.Next(pindexBatch)) {
+                vBatch.emplace_back();
+                vBatch.back().pindex = pindexBatch;
+                vBatch.back().pos = pindexBatch->nStatus & BLOCK_HAVE_DATA ? pindexBatch->GetBlockPos() : CDiskBlockPos();
+            }
+        }
+
+        std::atomic<size_t> nNextBlock(0);
+        auto readBlocks = [&]() {
+            for (size_t i = nNextBlock++; i < vBatch.size(); i = nNextBlock++) {
+                CRescanBlock& entry = vBatch[i];
+                if (entry.pos.IsNull() || !ReadBlockFromDisk(entry.block, entry.pos, chainParams.GetConsensus()))
+                    continue;
+                if (entry.block.GetHash() != entry.pindex->GetBlockHash())
+                    continue;
+                entry.fRead = true;
+                entry.vfMayBeMine.assign(entry.block.vtx.size(), false);
+                for (size_t posInBlock = 0; posInBlock < entry.block.vtx.size(); ++posInBlock) {
+                    for (const CTxOut& txout : entry.block.vtx[posInBlock]->vout) {
+                        if (filter.MayBeMine(txout)) {
+                            entry.vfMayBeMine[posInBlock] = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        };
+        std::vector<std::thread> vThreads;
+        for (int i = 1; i < nThreads; i++)
+            vThreads.emplace_back(readBlocks);
+        readBlocks();
+        for (std::thread& thread : vThreads)
+            thread.join();
+
+        LOCK2(cs_main, cs_wallet);
+        for (CRescanBlock& entry : vBatch)
+        {
+            pindex = entry.pindex;
             if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
                 ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((GuessVerificationProgress(chainParams.TxData(), pindex) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
             if (GetTime() >= nNow + 60) {
                 nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
+                double dProgress = GuessVerificationProgress(chainParams.TxData(), pindex);
+                double dDone = dProgressTip - dProgressStart > 0.0 ? (dProgress - dProgressStart) / (dProgressTip - dProgressStart) : 0.0;
+                int64_t nRemaining = dDone > 0.0 ? (int64_t)((nNow - nStartTime) * (1.0 - dDone) / dDone) : 0;
+                LogPrintf("Still rescanning. At block %d. Progress=%f, about %d seconds left\n", pindex->nHeight, dProgress, nRemaining);
             }
 
-            CBlock block;
-            if (ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
-                for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
-                    AddToWalletIfInvolvingMe(*block.vtx[posInBlock], pindex, posInBlock, fUpdate);
-                }
-                if (!ret) {
-                    ret = pindex;
-                }
-            } else {
+            if (!entry.fRead) {
                 ret = nullptr;
+                continue;
+            }
+            for (size_t posInBlock = 0; posInBlock < entry.block.vtx.size(); ++posInBlock) {
+                const CTransaction& tx = *entry.block.vtx[posInBlock];
+                bool fRelevant = entry.vfMayBeMine[posInBlock] || mapWallet.count(tx.GetHash());
+                for (size_t i = 0; i < tx.vin.size() && !fRelevant; i++) {
+                    // it may spend from us or conflict with one of our txs
+                    fRelevant = mapWallet.count(tx.vin[i].prevout.hash) || mapTxSpends.count(tx.vin[i].prevout);
+                }
+                if (fRelevant)
+                    AddToWalletIfInvolvingMe(tx, pindex, posInBlock, fUpdate);
+            }
+            if (!ret) {
+                ret = pindex;
             }
-            pindex = chainActive.Next(pindex);
         }
-        ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+        // stops early if the chain was reorganized away from the scanned blocks meanwhile,
+        // the new blocks reach the wallet through SyncTransaction
+        pindex = chainActive.Next(vBatch.back().pindex);
     }
+    ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     return ret;
 }
 
@@ -2188,6 +2529,25 @@ CAmount CWalletTx::GetChange() const
     return nChangeCached;
 }
 
+void CWalletTx::MarkDirty()
+{
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fImmatureCreditCached = false;
+    fAnonymizedCreditCached = false;
+    fDenomUnconfCreditCached = false;
+    fDenomConfCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+
+    if (pwallet)
+        pwallet->MarkBalanceDirty(GetHash());
+}
+
 bool CWalletTx::InMempool() const
 {
     LOCK(mempool.cs);
@@ -2297,20 +2657,84 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman
  */
 
 
-CAmount CWallet::GetBalance() const
+void CWallet::MarkBalanceDirty(const uint256& hash) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+    LOCK(cs_wallet);
+    // nothing to track until the next full recompute
+    if (fBalanceCacheValid)
+        setBalanceDirtyTxs.insert(hash);
+}
+
+void CWallet::UpdateBalanceContribution(const uint256& hash) const
+{
+    AssertLockHeld(cs_wallet);
+
+    CWalletBalance contribution;
+    bool fVolatile = false;
+    std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+    if (it != mapWallet.end()) {
+        const CWalletTx& wtx = it->second;
+        int nDepth = wtx.GetDepthInMainChain();
+        if (wtx.IsTrusted()) {
+            contribution.nTrusted = wtx.GetAvailableCredit();
+            contribution.nWatchTrusted = wtx.GetAvailableWatchOnlyCredit();
+        } else if (nDepth == 0 && !wtx.IsLockedByInstaEPM() && wtx.InMempool()) {
+            contribution.nUntrustedPending = wtx.GetAvailableCredit();
+            contribution.nWatchUntrustedPending = wtx.GetAvailableWatchOnlyCredit();
         }
+        contribution.nImmature = wtx.GetImmatureCredit();
+        contribution.nWatchImmature = wtx.GetImmatureWatchOnlyCredit();
+
+        // Mempool, InstaEPM and maturity changes are not notified to the transaction.
+        // A conflicted one only comes back with a reorg, which recomputes everything.
+        fVolatile = nDepth == 0 || ((wtx.IsCoinBase() || wtx.IsCoinStake()) && wtx.GetBlocksToMaturity() > 0);
     }
 
-    return nTotal;
+    std::map<uint256, CWalletBalance>::iterator itContribution = mapBalanceContributions.find(hash);
+    if (itContribution != mapBalanceContributions.end()) {
+        balanceCached -= itContribution->second;
+        mapBalanceContributions.erase(itContribution);
+    }
+    if (!contribution.IsNull()) {
+        balanceCached += contribution;
+        mapBalanceContributions.emplace(hash, contribution);
+    }
+
+    if (fVolatile)
+        setBalanceVolatileTxs.insert(hash);
+    else
+        setBalanceVolatileTxs.erase(hash);
+}
+
+CWalletBalance CWallet::GetWalletBalance() const
+{
+    LOCK2(cs_main, cs_wallet);
+
+    // Blocks on top of the last tip only change the transactions they confirm, which got
+    // marked dirty, and the volatile ones. Anything else, like a reorg, starts over.
+    if (!fBalanceCacheValid || pindexBalanceTip == NULL || !chainActive.Contains(pindexBalanceTip)) {
+        balanceCached = CWalletBalance();
+        mapBalanceContributions.clear();
+        setBalanceDirtyTxs.clear();
+        setBalanceVolatileTxs.clear();
+        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+            UpdateBalanceContribution(it->first);
+        fBalanceCacheValid = true;
+    } else {
+        std::set<uint256> setUpdate;
+        setUpdate.swap(setBalanceDirtyTxs);
+        setUpdate.insert(setBalanceVolatileTxs.begin(), setBalanceVolatileTxs.end());
+        for (const uint256& hash : setUpdate)
+            UpdateBalanceContribution(hash);
+    }
+    pindexBalanceTip = chainActive.Tip();
+
+    return balanceCached;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    return GetWalletBalance().nTrusted;
 }
 
 CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated, bool fSkipUnconfirmed) const
@@ -2426,76 +2850,27 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && !pcoin->IsLockedByInstaEPM() && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    return GetWalletBalance().nUntrustedPending;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetWalletBalance().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetWalletBalance().nWatchTrusted;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && !pcoin->IsLockedByInstaEPM() && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetWalletBalance().nWatchUntrustedPending;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetWalletBalance().nWatchImmature;
 }
 
 void CWallet::AvailableCoins(std::vector<COutput>& vCoins, bool fOnlySafe, const CCoinControl *coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseInstantSend) const
@@ -2517,6 +2892,11 @@ void CWallet::AvailableCoins(std::vector<COutput>& vCoins, bool fOnlySafe, const
             if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
                 continue;
 
+            // Most txs of a long-lived wallet are fully spent, the cached credits tell without
+            // running IsSpent and IsMine on each of their outputs
+            if (!fIncludeZeroValue && pcoin->GetAvailableCredit() == 0 && pcoin->GetAvailableWatchOnlyCredit() == 0)
+                continue;
+
             int nDepth = pcoin->GetDepthInMainChain();
             // do not use IX for inputs that have less then nInstantSendConfirmationsRequired blockchain confirmations
             if (fUseInstantSend && nDepth < nInstantSendConfirmationsRequired)
@@ -2563,7 +2943,7 @@ void CWallet::AvailableCoins(std::vector<COutput>& vCoins, bool fOnlySafe, const
     }
 }
 
-static void ApproximateBestSubset(std::vector<std::pair<CAmount, std::pair<const CWalletTx*,unsigned int> > >vValue, const CAmount& nTotalLower, const CAmount& nTargetValue,
+static void ApproximateBestSubset(const std::vector<std::pair<CAmount, std::pair<const CWalletTx*,unsigned int> > >& vValue, const CAmount& nTotalLower, const CAmount& nTargetValue,
                                   std::vector<char>& vfBest, CAmount& nBest, bool fUseInstantSend = false, int iterations = 1000)
 {
     std::vector<char> vfIncluded;
@@ -2623,6 +3003,58 @@ static void ApproximateBestSubset(std::vector<std::pair<CAmount, std::pair<const
     }
 }
 
+/** Give up looking for an exact match after this many steps */
+static const int BNB_MAX_TRIES = 100000;
+
+/**
+ * Branch and bound search for a subset of vValue, sorted by descending value, adding up to
+ * exactly nTargetValue so the transaction needs no change. Branches that went over the target
+ * or can't reach it with the coins left are cut, and coins of the same value as one just
+ * left out are skipped, as they would only find the same sums again.
+ */
+static bool SelectCoinsBnB(const std::vector<std::pair<CAmount, std::pair<const CWalletTx*,unsigned int> > >& vValue, const CAmount& nTargetValue,
+                           std::vector<char>& vfBest)
+{
+    // vRemaining[i] is the value of all coins from i on
+    std::vector<CAmount> vRemaining(vValue.size() + 1, 0);
+    for (size_t i = vValue.size(); i-- > 0; )
+        vRemaining[i] = vRemaining[i + 1] + vValue[i].first;
+    if (vRemaining[0] < nTargetValue)
+        return false;
+
+    std::vector<char> vfIncluded(vValue.size(), false);
+    std::vector<size_t> vIncluded;
+    CAmount nTotal = 0;
+    size_t i = 0;
+    for (int nTries = 0; nTries < BNB_MAX_TRIES; nTries++)
+    {
+        if (nTotal == nTargetValue)
+        {
+            vfBest = vfIncluded;
+            return true;
+        }
+        if (nTotal > nTargetValue || i == vValue.size() || nTotal + vRemaining[i] < nTargetValue)
+        {
+            // backtrack to the last included coin and go on without it
+            if (vIncluded.empty())
+                return false;
+            size_t j = vIncluded.back();
+            vIncluded.pop_back();
+            vfIncluded[j] = false;
+            nTotal -= vValue[j].first;
+            for (i = j + 1; i < vValue.size() && vValue[i].first == vValue[j].first; i++);
+        }
+        else
+        {
+            vfIncluded[i] = true;
+            vIncluded.push_back(i);
+            nTotal += vValue[i].first;
+            i++;
+        }
+    }
+    return false;
+}
+
 struct CompareByPriority
 {
     bool operator()(const COutput& t1,
@@ -2632,22 +3064,6 @@ struct CompareByPriority
     }
 };
 
-// move denoms down
-bool less_then_denom (const COutput& out1, const COutput& out2)
-{
-    const CWalletTx *pcoin1 = out1.tx;
-    const CWalletTx *pcoin2 = out2.tx;
-
-    bool found1 = false;
-    bool found2 = false;
-    for (const auto& d : CPrivateSend::GetStandardDenominations()) // loop through predefined denoms
-    {
-        if(pcoin1->tx->vout[out1.i].nValue == d) found1 = true;
-        if(pcoin2->tx->vout[out2.i].nValue == d) found2 = true;
-    }
-    return (!found1 && found2);
-}
-
 bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMine, const int nConfTheirs, const uint64_t nMaxAncestors, std::vector<COutput> vCoins,
                                  std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, AvailableCoinsType nCoinType, bool fUseInstantSend) const
 {
@@ -2684,7 +3100,9 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
     } else {
         // move denoms down on the list
         // try not to use denominated coins when not needed, save denoms for privatesend
-        std::sort(vCoins.begin(), vCoins.end(), less_then_denom);
+        std::stable_partition(vCoins.begin(), vCoins.end(), [](const COutput& out) {
+            return !CPrivateSend::IsDenominatedAmount(out.tx->tx->vout[out.i].nValue);
+        });
     }
 
     // try to find nondenom first to prevent unneeded spending of mixed coins
@@ -2706,7 +3124,8 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
             if (output.nDepth < (pcoin->IsFromMe(ISMINE_ALL) ? nConfMine : nConfTheirs) && !fLockedByIS)
                 continue;
 
-            if (!mempool.TransactionWithinChainLimit(pcoin->GetHash(), nMaxAncestors))
+            // confirmed txs can't be in the mempool
+            if (output.nDepth == 0 && !mempool.TransactionWithinChainLimit(pcoin->GetHash(), nMaxAncestors))
                 continue;
 
             int i = output.i;
@@ -2778,9 +3197,15 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
     std::vector<char> vfBest;
     CAmount nBest;
 
-    ApproximateBestSubset(vValue, nTotalLower, nTargetValue, vfBest, nBest, fUseInstantSend);
-    if (nBest != nTargetValue && nMinChange != 0 && nTotalLower >= nTargetValue + nMinChange)
-        ApproximateBestSubset(vValue, nTotalLower, nTargetValue + nMinChange, vfBest, nBest, fUseInstantSend);
+    // An exact match needs no change, the stochastic approximation is only needed without one.
+    // InstaEPM limits the total, which the exact search doesn't know about.
+    if (!fUseInstantSend && SelectCoinsBnB(vValue, nTargetValue, vfBest)) {
+        nBest = nTargetValue;
+    } else {
+        ApproximateBestSubset(vValue, nTotalLower, nTargetValue, vfBest, nBest, fUseInstantSend);
+        if (nBest != nTargetValue && nMinChange != 0 && nTotalLower >= nTargetValue + nMinChange)
+            ApproximateBestSubset(vValue, nTotalLower, nTargetValue + nMinChange, vfBest, nBest, fUseInstantSend);
+    }
 
     // If we have a bigger coin and (either the stochastic approximation didn't find a good solution,
     //                                   or the next bigger coin is closer), return the bigger coin
@@ -3013,98 +3438,104 @@ bool CWallet::SelectPSInOutPairsByDenominations(int nDenom, CAmount nValueMin, C
     return nValueTotal >= nValueMin && nDenom == nDenomResult;
 }
 
+void CWallet::ResetTallyCache()
+{
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            fTallyCached[i][j] = false;
+            vecTallyCached[i][j].clear();
+        }
+    }
+}
+
 bool CWallet::SelectCoinsGroupedByAddresses(std::vector<CompactTallyItem>& vecTallyRet, bool fSkipDenominated, bool fAnonymizable, bool fSkipUnconfirmed, int nMaxOupointsPerAddress) const
 {
     LOCK2(cs_main, cs_wallet);
 
     isminefilter filter = ISMINE_SPENDABLE;
 
-    // Try using the cache for already confirmed anonymizable inputs.
-    // This should only be used if nMaxOupointsPerAddress was NOT specified.
-    if(nMaxOupointsPerAddress == -1 && fAnonymizable && fSkipUnconfirmed) {
-        if(fSkipDenominated && fAnonymizableTallyCachedNonDenom) {
-            vecTallyRet = vecAnonymizableTallyCachedNonDenom;
-            LogPrint("selectcoins", "SelectCoinsGroupedByAddresses - using cache for non-denom inputs %d\n", vecTallyRet.size());
-            return vecTallyRet.size() > 0;
-        }
-        if(!fSkipDenominated && fAnonymizableTallyCached) {
-            vecTallyRet = vecAnonymizableTallyCached;
-            LogPrint("selectcoins", "SelectCoinsGroupedByAddresses - using cache for all inputs %d\n", vecTallyRet.size());
-            return vecTallyRet.size() > 0;
-        }
-    }
-
     CAmount nSmallestDenom = CPrivateSend::GetSmallestDenomination();
 
-    // Tally
-    std::map<CTxDestination, CompactTallyItem> mapTally;
-    std::set<uint256> setWalletTxesCounted;
-    for (const auto& outpoint : setWalletUTXO) {
-
-        if (!setWalletTxesCounted.emplace(outpoint.hash).second) continue;
+    // Confirmed tallies are cached until the coins of the wallet change. The cache holds
+    // them before the per address limit and the minimum amount are applied: outpoints are
+    // tallied in order, so cutting each address down to its first nMaxOupointsPerAddress
+    // gives what the limited tally would have.
+    std::vector<CompactTallyItem> vecTallyUnconfirmed;
+    std::vector<CompactTallyItem>& vecTally = fSkipUnconfirmed ? vecTallyCached[fSkipDenominated][fAnonymizable] : vecTallyUnconfirmed;
+    if (fSkipUnconfirmed && fTallyCached[fSkipDenominated][fAnonymizable]) {
+        LogPrint("selectcoins", "SelectCoinsGroupedByAddresses - using cache for %s inputs %d\n", fSkipDenominated ? "non-denom" : "all", vecTally.size());
+    } else {
+        // Tally
+        std::map<CTxDestination, CompactTallyItem> mapTally;
+        std::set<uint256> setWalletTxesCounted;
+        for (const auto& outpoint : setWalletUTXO) {
 
-        std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
-        if (it == mapWallet.end()) continue;
+            if (!setWalletTxesCounted.emplace(outpoint.hash).second) continue;
 
-        const CWalletTx& wtx = (*it).second;
+            std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+            if (it == mapWallet.end()) continue;
 
-        if(wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0) continue;
-        if(fSkipUnconfirmed && !wtx.IsTrusted()) continue;
+            const CWalletTx& wtx = (*it).second;
 
-        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
-            CTxDestination txdest;
-            if (!ExtractDestination(wtx.tx->vout[i].scriptPubKey, txdest)) continue;
+            if(wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0) continue;
+            if(fSkipUnconfirmed && !wtx.IsTrusted()) continue;
 
-            isminefilter mine = ::IsMine(*this, txdest);
-            if(!(mine & filter)) continue;
+            for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+                CTxDestination txdest;
+                if (!ExtractDestination(wtx.tx->vout[i].scriptPubKey, txdest)) continue;
 
-            auto itTallyItem = mapTally.find(txdest);
-            if (nMaxOupointsPerAddress != -1 && itTallyItem != mapTally.end() && itTallyItem->second.vecOutPoints.size() >= nMaxOupointsPerAddress) continue;
+                isminefilter mine = ::IsMine(*this, txdest);
+                if(!(mine & filter)) continue;
 
-            if(IsSpent(outpoint.hash, i) || IsLockedCoin(outpoint.hash, i)) continue;
+                if(IsSpent(outpoint.hash, i) || IsLockedCoin(outpoint.hash, i)) continue;
 
-            if(fSkipDenominated && CPrivateSend::IsDenominatedAmount(wtx.tx->vout[i].nValue)) continue;
+                if(fSkipDenominated && CPrivateSend::IsDenominatedAmount(wtx.tx->vout[i].nValue)) continue;
 
-            if(fAnonymizable) {
-                // ignore collaterals
-                if(CPrivateSend::IsCollateralAmount(wtx.tx->vout[i].nValue)) continue;
-                if(fMasternodeMode && wtx.tx->vout[i].nValue == Params().GetConsensus().nMasternodeCollateral) continue;
-                // ignore outputs that are 10 times smaller then the smallest denomination
-                // otherwise they will just lead to higher fee / lower priority
-                if(wtx.tx->vout[i].nValue <= nSmallestDenom/10) continue;
-                // ignore anonymized
-                if(GetCappedOutpointPrivateSendRounds(COutPoint(outpoint.hash, i)) >= privateSendClient.nPrivateSendRounds) continue;
-            }
+                if(fAnonymizable) {
+                    // ignore collaterals
+                    if(CPrivateSend::IsCollateralAmount(wtx.tx->vout[i].nValue)) continue;
+                    if(fMasternodeMode && wtx.tx->vout[i].nValue == Params().GetConsensus().nMasternodeCollateral) continue;
+                    // ignore outputs that are 10 times smaller then the smallest denomination
+                    // otherwise they will just lead to higher fee / lower priority
+                    if(wtx.tx->vout[i].nValue <= nSmallestDenom/10) continue;
+                    // ignore anonymized
+                    if(GetCappedOutpointPrivateSendRounds(COutPoint(outpoint.hash, i)) >= privateSendClient.nPrivateSendRounds) continue;
+                }
 
-            if (itTallyItem == mapTally.end()) {
-                itTallyItem = mapTally.emplace(txdest, CompactTallyItem()).first;
-                itTallyItem->second.txdest = txdest;
+                auto itTallyItem = mapTally.find(txdest);
+                if (itTallyItem == mapTally.end()) {
+                    itTallyItem = mapTally.emplace(txdest, CompactTallyItem()).first;
+                    itTallyItem->second.txdest = txdest;
+                }
+                itTallyItem->second.nAmount += wtx.tx->vout[i].nValue;
+                itTallyItem->second.vecOutPoints.emplace_back(outpoint.hash, i);
             }
-            itTallyItem->second.nAmount += wtx.tx->vout[i].nValue;
-            itTallyItem->second.vecOutPoints.emplace_back(outpoint.hash, i);
         }
+
+        vecTally.clear();
+        for (auto& item : mapTally)
+            vecTally.push_back(std::move(item.second));
+        if (fSkipUnconfirmed)
+            fTallyCached[fSkipDenominated][fAnonymizable] = true;
     }
 
     // construct resulting vector
     // NOTE: vecTallyRet is "sorted" by txdest (i.e. address), just like mapTally
     vecTallyRet.clear();
-    for (const auto& item : mapTally) {
-        if(fAnonymizable && item.second.nAmount < nSmallestDenom) continue;
-        vecTallyRet.push_back(item.second);
-    }
-
-    // Cache already confirmed anonymizable entries for later use.
-    // This should only be used if nMaxOupointsPerAddress was NOT specified.
-    if(nMaxOupointsPerAddress == -1 && fAnonymizable && fSkipUnconfirmed) {
-        if(fSkipDenominated) {
-            vecAnonymizableTallyCachedNonDenom = vecTallyRet;
-            fAnonymizableTallyCachedNonDenom = true;
-        } else {
-            vecAnonymizableTallyCached = vecTallyRet;
-            fAnonymizableTallyCached = true;
+    for (const auto& item : vecTally) {
+        if (nMaxOupointsPerAddress != -1 && item.vecOutPoints.size() > (size_t)nMaxOupointsPerAddress) {
+            CompactTallyItem itemLimited;
+            itemLimited.txdest = item.txdest;
+            itemLimited.vecOutPoints.assign(item.vecOutPoints.begin(), item.vecOutPoints.begin() + nMaxOupointsPerAddress);
+            for (const COutPoint& outpoint : itemLimited.vecOutPoints)
+                itemLimited.nAmount += mapWallet.at(outpoint.hash).tx->vout[outpoint.n].nValue;
+            if(fAnonymizable && itemLimited.nAmount < nSmallestDenom) continue;
+            vecTallyRet.push_back(std::move(itemLimited));
+            continue;
         }
+        if(fAnonymizable && item.nAmount < nSmallestDenom) continue;
+        vecTallyRet.push_back(item);
     }
-
     // debug
     if (LogAcceptCategory("selectcoins")) {
         std::string strMessage = "SelectCoinsGroupedByAddresses - vecTallyRet:\n";
@@ -3709,13 +4140,14 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CWalletT
         if (sign)
         {
             CTransaction txNewConst(txNew);
+            PrecomputedTransactionData txdata(txNewConst);
             int nIn = 0;
             for(const auto& txdsin : vecTxDSInTmp)
             {
                 const CScript& scriptPubKey = txdsin.prevPubKey;
                 CScript& scriptSigRes = txNew.vin[nIn].scriptSig;
 
-                if (!ProduceSignature(TransactionSignatureCreator(this, &txNewConst, nIn, SIGHASH_ALL), scriptPubKey, scriptSigRes))
+                if (!ProduceSignature(TransactionSignatureCreator(this, &txNewConst, nIn, SIGHASH_ALL, &txdata), scriptPubKey, scriptSigRes))
                 {
                     strFailReason = _("Signing transaction failed");
                     return false;
@@ -3747,41 +4179,117 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CWalletT
     return true;
 }
 
-bool CWallet::CreateCoinStakeKernel(CScript &kernelScript, const CScript &stakeScript, unsigned int nBits, const CBlock &blockFrom, unsigned int nTxPrevOffset, const CTransactionRef &txPrev, const COutPoint &prevout, unsigned int &nTimeTx, bool fPrintProofOfStake) const
+void CWallet::AvailableStakeCoins(std::vector<COutput>& vCoins, bool fIncludeWatchOnly) const
 {
-    unsigned int nTryTime = 0;
-    uint256 hashProofOfStake = uint256();
+    vCoins.clear();
 
-    if (blockFrom.GetBlockTime() + Params().GetConsensus().nStakeMinAge + nHashDrift > nTimeTx) // Min age requirement
+    LOCK2(cs_main, cs_wallet);
+    const Consensus::Params& params = Params().GetConsensus();
+    std::map<uint256, int> mapDepthCache;
+
+    for (const auto& outpoint : setWalletUTXO) {
+        const auto it = mapWallet.find(outpoint.hash);
+        if (it == mapWallet.end())
+            continue;
+        const CWalletTx* pcoin = &it->second;
+        const CTxOut& txout = pcoin->tx->vout[outpoint.n];
+
+        // cheap per output checks first, most outputs of a large wallet are filtered here
+        if (txout.nValue < params.nMinimumStakeValue || txout.nValue == params.nMasternodeCollateral)
+            continue;
+        if (IsSpent(outpoint.hash, outpoint.n) || IsLockedCoin(outpoint.hash, outpoint.n))
+            continue;
+
+        isminetype mine = IsMine(txout);
+        bool fSpendable = (mine & ISMINE_SPENDABLE) != ISMINE_NO || (fIncludeWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO);
+        if (!fSpendable)
+            continue;
+
+        if (!CheckFinalTx(*pcoin))
+            continue;
+        if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
+            continue;
+
+        auto itDepth = mapDepthCache.find(outpoint.hash);
+        if (itDepth == mapDepthCache.end()) {
+            itDepth = mapDepthCache.emplace(outpoint.hash, pcoin->GetDepthInMainChain()).first;
+        }
+        int nDepth = itDepth->second;
+        if (nDepth < 1)
+            continue;
+
+        vCoins.emplace_back(pcoin, outpoint.n, nDepth, true, (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO, true);
+    }
+}
+
+CStakingStats CWallet::GetStakingStats() const
+{
+    LOCK(cs_stakingStats);
+    return stakingStats;
+}
+
+bool CWallet::UnlockForStaking(const SecureString& strWalletPassphrase)
+{
+    LOCK(cs_wallet);
+    if (!IsLocked(true))
         return false;
+    if (!Unlock(strWalletPassphrase))
+        return false;
+
+    std::vector<COutput> vCoins;
+    AvailableStakeCoins(vCoins, false);
 
-    for(unsigned int i = 0; i < nHashDrift; ++i)
+    std::map<CKeyID, CKey> mapKeys;
+    for (const COutput& out : vCoins) {
+        CTxDestination dest;
+        if (!ExtractDestination(out.tx->tx->vout[out.i].scriptPubKey, dest))
+            continue;
+        const CKeyID* keyID = boost::get<CKeyID>(&dest);
+        if (!keyID || mapKeys.count(*keyID))
+            continue;
+        CKey key;
+        if (GetKey(*keyID, key))
+            mapKeys.emplace(*keyID, key);
+    }
+    Lock();
+
+    LogPrintf("CWallet::UnlockForStaking -- %d staking keys\n", mapKeys.size());
     {
-        nTryTime = nTimeTx - i;
-        if (CheckStakeKernelHash(nBits, chainActive.Tip(), blockFrom, nTxPrevOffset, txPrev, prevout, nTryTime, hashProofOfStake, true, false))
-        {
-            //Double check that this will pass time requirements
-            if (nTryTime <= chainActive.Tip()->GetMedianTimePast()) {
-                LogPrintf("CreateCoinStakeKernel() : kernel found, but it is too far in the past \n");
-                continue;
-            }
+        LOCK(cs_stakingKeys);
+        mapStakingKeys.swap(mapKeys);
+    }
+    return true;
+}
+
+void CWallet::ClearStakingKeys()
+{
+    LOCK(cs_stakingKeys);
+    mapStakingKeys.clear();
+}
+
+bool CWallet::IsUnlockedForStaking() const
+{
+    LOCK(cs_stakingKeys);
+    return !mapStakingKeys.empty();
+}
 
-            // Found a kernel
-            LogPrintf("CreateCoinStakeKernel : kernel found\n");
-            kernelScript.clear();
-            kernelScript = stakeScript;
-            nTimeTx = nTryTime;
+bool CWallet::GetStakingKey(const CKeyID& keyID, CKey& keyRet) const
+{
+    {
+        LOCK(cs_stakingKeys);
+        auto it = mapStakingKeys.find(keyID);
+        if (it != mapStakingKeys.end()) {
+            keyRet = it->second;
             return true;
         }
     }
-    return false;
+    return !IsLocked() && GetKey(keyID, keyRet);
 }
 
 bool CWallet::MintableCoins()
 {
     std::vector<COutput> vCoins;
-    LOCK2(cs_main, cs_wallet);
-    AvailableCoins(vCoins, true);
+    AvailableStakeCoins(vCoins, false);
 
     for (const COutput& out : vCoins)
     {
@@ -3799,10 +4307,7 @@ bool CWallet::SelectStakeCoins(StakeCoinsSet &setCoins, CAmount nTargetAmount, c
     std::vector<COutput> vCoins;
     CCoinControl coinControl;
     coinControl.fAllowWatchOnly = !scriptFilterPubKey.empty();
-    {
-        LOCK2(cs_main, cs_wallet);
-        AvailableCoins(vCoins, !scriptFilterPubKey.empty(), &coinControl);
-    }
+    AvailableStakeCoins(vCoins, coinControl.fAllowWatchOnly);
     CAmount nAmountSelected = 0;
 
     std::set<CScript> rejectCache;
@@ -3819,6 +4324,14 @@ bool CWallet::SelectStakeCoins(StakeCoinsSet &setCoins, CAmount nTargetAmount, c
         if(!ExtractDestination(scriptPubKeyKernel, dest))
             continue;
 
+        // unlocked for staking only, coins that arrived since are left out until the next unlock
+        if (!coinControl.fAllowWatchOnly && IsLocked()) {
+            const CKeyID* keyID = boost::get<CKeyID>(&dest);
+            LOCK(cs_stakingKeys);
+            if (!keyID || !mapStakingKeys.count(*keyID))
+                continue;
+        }
+
         if (GetTime() - out.tx->GetTxTime() < Params().GetConsensus().nStakeMinAge)
             continue;
 
@@ -3847,6 +4360,154 @@ bool CWallet::SelectStakeCoins(StakeCoinsSet &setCoins, CAmount nTargetAmount, c
     return true;
 }
 
+CAmount CWallet::GetStakeTargetValue() const
+{
+    return std::max<CAmount>(nStakeSplitThreshold * COIN, Params().GetConsensus().nMinimumStakeValue);
+}
+
+bool PlanStakeMaintenance(const std::vector<CStakeMaintenanceCoin>& vCoins, CAmount nTarget, CAmount nMaxFee,
+                          std::vector<COutPoint>& vInputsRet, std::vector<CRecipient>& vRecipientsRet)
+{
+    vInputsRet.clear();
+    vRecipientsRet.clear();
+    if (nTarget <= 0) {
+        return false;
+    }
+    CAmount nDust = nMaxFee / MAX_STAKE_COMBINE_INPUTS;
+
+    std::map<CScript, std::vector<const CStakeMaintenanceCoin*>> mapSmallCoins;
+    for (const auto& coin : vCoins) {
+        if (coin.nValue > nDust && coin.nValue < nTarget) {
+            mapSmallCoins[coin.scriptPubKey].push_back(&coin);
+        }
+    }
+    std::vector<std::vector<const CStakeMaintenanceCoin*>*> vGroups;
+    for (auto& p : mapSmallCoins) {
+        vGroups.push_back(&p.second);
+    }
+    std::stable_sort(vGroups.begin(), vGroups.end(), [](const std::vector<const CStakeMaintenanceCoin*>* a, const std::vector<const CStakeMaintenanceCoin*>* b) {
+        return a->size() > b->size();
+    });
+    for (auto pGroup : vGroups) {
+        auto& vGroup = *pGroup;
+        if (vGroup.size() < 2) {
+            break;
+        }
+        std::stable_sort(vGroup.begin(), vGroup.end(), [](const CStakeMaintenanceCoin* a, const CStakeMaintenanceCoin* b) {
+            return a->nValue < b->nValue;
+        });
+        CAmount nTotal = 0;
+        size_t nInputs = 0;
+        while (nInputs < vGroup.size() && nInputs < MAX_STAKE_COMBINE_INPUTS && nTotal < nTarget + nMaxFee) {
+            nTotal += vGroup[nInputs++]->nValue;
+        }
+        if (nTotal < nTarget + nMaxFee && nInputs < MIN_STAKE_COMBINE_INPUTS) {
+            continue;
+        }
+        for (size_t i = 0; i < nInputs; i++) {
+            vInputsRet.push_back(vGroup[i]->outpoint);
+        }
+        vRecipientsRet.push_back({vGroup[0]->scriptPubKey, nTotal, true});
+        return true;
+    }
+
+    const CStakeMaintenanceCoin* pLargest = nullptr;
+    for (const auto& coin : vCoins) {
+        if (coin.nValue / 2 > nTarget && coin.nValue - nMaxFee >= 2 * nTarget && (!pLargest || coin.nValue > pLargest->nValue)) {
+            pLargest = &coin;
+        }
+    }
+    if (!pLargest) {
+        return false;
+    }
+    CAmount nSplit = pLargest->nValue - nMaxFee;
+    CAmount nOutputs = std::min<CAmount>(nSplit / nTarget, MAX_STAKE_SPLIT_OUTPUTS);
+    CAmount nEach = nSplit / nOutputs;
+    vInputsRet.push_back(pLargest->outpoint);
+    for (CAmount i = 0; i < nOutputs; i++) {
+        vRecipientsRet.push_back({pLargest->scriptPubKey, nEach, false});
+    }
+    // the last one gets what's left and pays the fee
+    vRecipientsRet.back().nAmount += pLargest->nValue - nEach * nOutputs;
+    vRecipientsRet.back().fSubtractFeeFromAmount = true;
+    return true;
+}
+
+void CWallet::MaintainStakeCoins(CConnman* connman)
+{
+    if (IsInitialBlockDownload() || !GetBroadcastTransactions()) {
+        return;
+    }
+
+    // what the largest transaction could cost, P2PKH inputs and outputs
+    unsigned int nMaxTxBytes = 10 + MAX_STAKE_COMBINE_INPUTS * 148 + MAX_STAKE_SPLIT_OUTPUTS * 34;
+    CAmount nMaxFee = GetMinimumFee(nMaxTxBytes, nTxConfirmTarget, mempool);
+
+    std::vector<CStakeMaintenanceCoin> vCoins;
+    {
+        LOCK2(cs_main, cs_wallet);
+        if (IsLocked()) {
+            return;
+        }
+        auto it = mapWallet.find(hashLastStakeMaintenance);
+        if (it != mapWallet.end() && it->second.GetDepthInMainChain() == 0 && it->second.InMempool()) {
+            return;
+        }
+
+        const Consensus::Params& params = Params().GetConsensus();
+        std::vector<COutput> vAvailable;
+        AvailableCoins(vAvailable, true, NULL, false, ONLY_NONDENOMINATED);
+        for (const COutput& out : vAvailable) {
+            const CTxOut& txout = out.tx->tx->vout[out.i];
+            if (!out.fSpendable || out.nDepth < 1 || txout.nValue == params.nMasternodeCollateral)
+                continue;
+            // coins which couldn't even stake yet keep their age
+            if (GetTime() - out.tx->GetTxTime() < params.nStakeMinAge)
+                continue;
+            vCoins.push_back({COutPoint(out.tx->GetHash(), out.i), txout.scriptPubKey, txout.nValue});
+        }
+    }
+
+    std::vector<COutPoint> vInputs;
+    std::vector<CRecipient> vRecipients;
+    if (!PlanStakeMaintenance(vCoins, GetStakeTargetValue(), nMaxFee, vInputs, vRecipients)) {
+        return;
+    }
+
+    CCoinControl coinControl;
+    coinControl.fUsePrivateSend = false;
+    for (const auto& outpoint : vInputs) {
+        coinControl.Select(outpoint);
+    }
+    CWalletTx wtx;
+    CReserveKey reservekey(this);
+    CAmount nFee;
+    int nChangePos = -1;
+    std::string strError;
+    if (!CreateTransaction(vRecipients, wtx, reservekey, nFee, nChangePos, strError, &coinControl, true, ONLY_NONDENOMINATED)) {
+        LogPrintf("CWallet::%s -- CreateTransaction failed: %s\n", __func__, strError);
+        return;
+    }
+    if (nFee > nMaxFee) {
+        LogPrintf("CWallet::%s -- fee %s is more than %s, not sending\n", __func__, FormatMoney(nFee), FormatMoney(nMaxFee));
+        return;
+    }
+    CValidationState state;
+    if (!CommitTransaction(wtx, reservekey, connman, state)) {
+        LogPrintf("CWallet::%s -- CommitTransaction failed: %s\n", __func__, state.GetRejectReason());
+        return;
+    }
+
+    {
+        LOCK(cs_wallet);
+        hashLastStakeMaintenance = wtx.GetHash();
+    }
+    // the minter must not keep staking with the coins which were just spent
+    nLastStakeSetUpdate = 0;
+    LogPrintf("CWallet::%s -- %s %d coins into %d, txid=%s\n", __func__, vInputs.size() > 1 ? "combined" : "split",
+              vInputs.size(), vRecipients.size(), wtx.GetHash().ToString());
+}
+
 void CWallet::FillCoinStakePayments(CMutableTransaction &transaction,
                                     const CScript &scriptPubKeyOut,
                                     const COutPoint &stakePrevout,
@@ -3864,7 +4525,7 @@ void CWallet::FillCoinStakePayments(CMutableTransaction &transaction,
     transaction.vout.emplace_back(nCoinStakeReward, scriptPubKeyOut);
     {
         CTxOut &lastTx = transaction.vout.back();
-        if(lastTx.nValue / 2 > nStakeSplitThreshold * COIN)
+        if(lastTx.nValue / 2 > GetStakeTargetValue())
         {
             lastTx.nValue /= 2;
             transaction.vout.emplace_back(lastTx.nValue, lastTx.scriptPubKey);
@@ -3891,7 +4552,6 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, CAm
 
     // presstab HyperStake - Initialize as static and don't update the set on every run of CreateCoinStake() in order to lighten resource use
     static StakeCoinsSet setStakeCoins;
-    static int nLastStakeSetUpdate = 0;
     if (GetTime() - nLastStakeSetUpdate > nStakeSetUpdateTime)
     {
         setStakeCoins.clear();
@@ -3906,13 +4566,18 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, CAm
     if (setStakeCoins.empty())
         return error("CreateCoinStake() : No Coins to stake");
 
-    CScript scriptPubKeyKernel;
-
     // potential mitigation of 'assert: pindexPrev == chainActive.Tip()'
     // if (GetAdjustedTime() <= chainActive.Tip()->nTime)
     //     MilliSleep(10000);
 
-    bool fKernelFound = false;
+    // Resolve the slot independent part of all kernels first (this needs cs_main, which is held by
+    // our caller), the time slots are then hashed by FindStakeKernel without touching the chain.
+    int64_t nSearchStart = GetTimeMicros();
+    nTxNewTime = GetAdjustedTime();
+    std::vector<CStakeKernel> vKernels;
+    std::vector<std::pair<const CWalletTx*, unsigned int>> vKernelCoins;
+    vKernels.reserve(setStakeCoins.size());
+    vKernelCoins.reserve(setStakeCoins.size());
     for(const std::pair<const CWalletTx*, unsigned int> &pcoin : setStakeCoins)
     {
         //make sure that enough time has elapsed between
@@ -3927,15 +4592,47 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, CAm
 
         // Read block header
         CBlockHeader block = pindex->GetBlockHeader();
+        if (block.GetBlockTime() + Params().GetConsensus().nStakeMinAge + nHashDrift > nTxNewTime) // Min age requirement
+            continue;
+
         COutPoint prevoutStake = COutPoint(pcoin.first->GetHash(), pcoin.second);
-        nTxNewTime = GetAdjustedTime();
-        //iterates each utxo inside of CheckStakeKernelHash()
-        CScript kernelScript;
-        auto stakeScript = pcoin.first->tx->vout[pcoin.second].scriptPubKey;
-        fKernelFound = CreateCoinStakeKernel(kernelScript, stakeScript, nBits, block, sizeof(CBlock), pcoin.first->tx, prevoutStake, nTxNewTime, false);
-        if(fKernelFound) {
-            FillCoinStakePayments(txNew, kernelScript, prevoutStake, blockReward);
-            break;
+        CStakeKernel kernel;
+        if (!kernel.Init(nBits, chainActive.Tip(), block, sizeof(CBlock), pcoin.first->tx->vout[pcoin.second].nValue, prevoutStake))
+            continue;
+        vKernels.emplace_back(kernel);
+        vKernelCoins.emplace_back(pcoin);
+    }
+
+    size_t nKernel = 0;
+    unsigned int nTryTime = 0;
+    uint256 hashProofOfStake;
+    bool fKernelFound = FindStakeKernel(vKernels, nTxNewTime, nHashDrift, chainActive.Tip()->GetMedianTimePast(), nKernel, nTryTime, hashProofOfStake);
+
+    {
+        LOCK(cs_stakingStats);
+        int64_t nSearchMicros = GetTimeMicros() - nSearchStart;
+        stakingStats.nSearches++;
+        g_metrics.nStakeSearches++;
+        stakingStats.nLastSearchMicros = nSearchMicros;
+        stakingStats.nTotalSearchMicros += nSearchMicros;
+        for (auto& p : stakingStats.mapKeys) {
+            p.second.nCoins = 0;
+        }
+        std::set<CTxDestination> setSearched;
+        for (size_t i = 0; i < vKernelCoins.size(); i++) {
+            CTxDestination dest;
+            if (!ExtractDestination(vKernelCoins[i].first->tx->vout[vKernelCoins[i].second].scriptPubKey, dest))
+                continue;
+            CStakingKeyStats& keyStats = stakingStats.mapKeys[dest];
+            keyStats.nCoins++;
+            if (setSearched.emplace(dest).second)
+                keyStats.nSearches++;
+            if (fKernelFound && i == nKernel) {
+                keyStats.nKernelsFound++;
+                keyStats.nLastKernelTime = nTryTime;
+                stakingStats.nKernelsFound++;
+                g_metrics.nStakeKernelsFound++;
+            }
         }
     }
 
@@ -3944,6 +4641,11 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, CAm
         return false;
     }
 
+    LogPrintf("CreateCoinStake : kernel found\n");
+    const auto& pcoin = vKernelCoins[nKernel];
+    nTxNewTime = nTryTime;
+    FillCoinStakePayments(txNew, pcoin.first->tx->vout[pcoin.second].scriptPubKey, COutPoint(pcoin.first->GetHash(), pcoin.second), blockReward);
+
     nLastStakeSetUpdate = 0;
     return true;
 }
@@ -4116,8 +4818,10 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
     AssertLockHeld(cs_wallet); // mapWallet
     vchDefaultKey = CPubKey();
     DBErrors nZapSelectTxRet = CWalletDB(strWalletFile,"cr+").ZapSelectTx(vHashIn, vHashOut);
-    for (uint256 hash : vHashOut)
+    for (uint256 hash : vHashOut) {
         mapWallet.erase(hash);
+        IndexTxHistory(hash);
+    }
 
     if (nZapSelectTxRet == DB_NEED_REWRITE)
     {
@@ -4265,6 +4969,9 @@ size_t CWallet::KeypoolCountInternalKeys()
 
 bool CWallet::TopUpKeyPool(unsigned int kpSize)
 {
+    // Keys are added KEYPOOL_BATCH_SIZE at a time, each batch in one database transaction,
+    // and cs_wallet is released in between unless the caller holds it.
+    while (true)
     {
         LOCK(cs_wallet);
 
@@ -4292,39 +4999,71 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         } else {
             nTargetSize *= 2;
         }
-        bool fInternal = false;
+        if (missingInternal + missingExternal == 0)
+            break;
+
+        // fill the external pool first, like getnewaddress would use it
+        bool fInternal = missingExternal == 0;
+        int64_t nMissing = std::min(fInternal ? missingInternal : missingExternal, (int64_t) KEYPOOL_BATCH_SIZE);
+
+        int64_t nEnd = 1;
+        if (!setInternalKeyPool.empty()) {
+            nEnd = *(--setInternalKeyPool.end()) + 1;
+        }
+        if (!setExternalKeyPool.empty()) {
+            nEnd = std::max(nEnd, *(--setExternalKeyPool.end()) + 1);
+        }
+
         CWalletDB walletdb(strWalletFile);
-        for (int64_t i = missingInternal + missingExternal; i--;)
-        {
-            int64_t nEnd = 1;
-            if (i < missingInternal) {
-                fInternal = true;
-            }
-            if (!setInternalKeyPool.empty()) {
-                nEnd = *(--setInternalKeyPool.end()) + 1;
-            }
-            if (!setExternalKeyPool.empty()) {
-                nEnd = std::max(nEnd, *(--setExternalKeyPool.end()) + 1);
-            }
+        std::vector<CPubKey> vPubKeys;
+        if (IsHDEnabled()) {
+            if (!walletdb.TxnBegin())
+                throw std::runtime_error(std::string(__func__) + ": TxnBegin failed");
             // TODO: implement keypools for all accounts?
-            if (!walletdb.WritePool(nEnd, CKeyPool(GenerateNewKey(0, fInternal), fInternal)))
-                throw std::runtime_error(std::string(__func__) + ": writing generated key failed");
+            DeriveNewChildKeys(walletdb, 0, fInternal, nMissing, vPubKeys);
+        } else {
+            // non HD keys are written one by one by AddKeyPubKey, outside of the transaction
+            for (int64_t i = 0; i < nMissing; i++)
+                vPubKeys.push_back(GenerateNewKey(0, fInternal));
+            if (!walletdb.TxnBegin())
+                throw std::runtime_error(std::string(__func__) + ": TxnBegin failed");
+        }
 
+        for (const CPubKey& pubkey : vPubKeys) {
+            if (!walletdb.WritePool(nEnd, CKeyPool(pubkey, fInternal)))
+                throw std::runtime_error(std::string(__func__) + ": writing generated key failed");
             if (fInternal) {
                 setInternalKeyPool.insert(nEnd);
             } else {
                 setExternalKeyPool.insert(nEnd);
             }
-            LogPrintf("keypool added key %d, size=%u, internal=%d\n", nEnd, setInternalKeyPool.size() + setExternalKeyPool.size(), fInternal);
-
-            double dProgress = 100.f * nEnd / (nTargetSize + 1);
-            std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
-            uiInterface.InitMessage(strMsg);
+            nEnd++;
         }
+        if (!walletdb.TxnCommit())
+            throw std::runtime_error(std::string(__func__) + ": TxnCommit failed");
+        LogPrintf("keypool added %d keys, last %d, size=%u, internal=%d\n", vPubKeys.size(), nEnd - 1, setInternalKeyPool.size() + setExternalKeyPool.size(), fInternal);
+
+        double dProgress = 100.f * (setInternalKeyPool.size() + setExternalKeyPool.size()) / (nTargetSize + 1);
+        std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
+        uiInterface.InitMessage(strMsg);
     }
     return true;
 }
 
+void CWallet::ScheduleTopUpKeyPool()
+{
+    if (!pschedulerTopUp) {
+        TopUpKeyPool();
+        return;
+    }
+    if (fTopUpScheduled.exchange(true))
+        return;
+    pschedulerTopUp->scheduleFromNow([this]() {
+        fTopUpScheduled = false;
+        TopUpKeyPool();
+    }, 0);
+}
+
 void CWallet::ReserveKeyFromKeyPool(int64_t& nIndex, CKeyPool& keypool, bool fInternal)
 {
     nIndex = -1;
@@ -4332,12 +5071,16 @@ void CWallet::ReserveKeyFromKeyPool(int64_t& nIndex, CKeyPool& keypool, bool fIn
     {
         LOCK(cs_wallet);
 
-        if (!IsLocked(true))
-            TopUpKeyPool();
-
         fInternal = fInternal && IsHDEnabled();
         std::set<int64_t>& setKeyPool = fInternal ? setInternalKeyPool : setExternalKeyPool;
 
+        // only wait for one key if the pool ran dry, the rest is refilled in the background
+        if (!IsLocked(true)) {
+            if (setKeyPool.empty())
+                TopUpKeyPool(1);
+            ScheduleTopUpKeyPool();
+        }
+
         // Get the oldest key
         if(setKeyPool.empty())
             return;
@@ -4717,8 +5460,7 @@ void CWallet::LockCoin(const COutPoint& output)
     std::map<uint256, CWalletTx>::iterator it = mapWallet.find(output.hash);
     if (it != mapWallet.end()) it->second.MarkDirty(); // recalculate all credits for this tx
 
-    fAnonymizableTallyCached = false;
-    fAnonymizableTallyCachedNonDenom = false;
+    ResetTallyCache();
 }
 
 void CWallet::UnlockCoin(const COutPoint& output)
@@ -4728,14 +5470,15 @@ void CWallet::UnlockCoin(const COutPoint& output)
     std::map<uint256, CWalletTx>::iterator it = mapWallet.find(output.hash);
     if (it != mapWallet.end()) it->second.MarkDirty(); // recalculate all credits for this tx
 
-    fAnonymizableTallyCached = false;
-    fAnonymizableTallyCachedNonDenom = false;
+    ResetTallyCache();
 }
 
 void CWallet::UnlockAllCoins()
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.clear();
+
+    ResetTallyCache();
 }
 
 bool CWallet::IsLockedCoin(uint256 hash, unsigned int n) const
@@ -4973,6 +5716,8 @@ std::string CWallet::GetWalletHelpString(bool showDebug)
     strUsage += HelpMessageOpt("-keypool=<n>", strprintf(_("Set key pool size to <n> (default: %u)"), DEFAULT_KEYPOOL_SIZE));
     strUsage += HelpMessageOpt("-rescan", _("Rescan the block chain for missing wallet transactions on startup"));
     strUsage += HelpMessageOpt("-salvagewallet", _("Attempt to recover private keys from a corrupt wallet on startup"));
+    strUsage += HelpMessageOpt("-stakesearchthreads=<n>", strprintf(_("Number of threads used to search for stake kernels, 0 = half the available cores (default: %d)"), DEFAULT_STAKE_SEARCH_THREADS));
+    strUsage += HelpMessageOpt("-stakemaintenance", strprintf(_("Combine small coins and split large ones in the background, so the wallet stakes with few coins of about the stake split threshold. Needs the wallet to be unlocked fully, moved coins start over with their stake age (default: %u)"), DEFAULT_STAKE_MAINTENANCE));
     strUsage += HelpMessageOpt("-spendzeroconfchange", strprintf(_("Spend unconfirmed change when sending transactions (default: %u)"), DEFAULT_SPEND_ZEROCONF_CHANGE));
     strUsage += HelpMessageOpt("-txconfirmtarget=<n>", strprintf(_("If paytxfee is not set, include enough fee so transactions begin confirmation on average within n blocks (default: %u)"), DEFAULT_TX_CONFIRM_TARGET));
     strUsage += HelpMessageOpt("-usehd", _("Use hierarchical deterministic key generation (HD) after BIP39/BIP44. Only has effect during wallet creation/first start") + " " + strprintf(_("(default: %u)"), DEFAULT_USE_HD_WALLET));
@@ -5244,10 +5989,18 @@ void CWallet::postInitProcess(CScheduler& scheduler)
     // Do this here as mempool requires genesis block to be loaded
     ReacceptWalletTransactions();
 
+    // Refill the keypool in the background from now on
+    pschedulerTopUp = &scheduler;
+    ScheduleTopUpKeyPool();
+
     // Run a thread to flush wallet periodically
     if (!CWallet::fFlushScheduled.exchange(true)) {
         scheduler.scheduleEvery(MaybeCompactWalletDB, 500);
     }
+
+    if (GetBoolArg("-stakemaintenance", DEFAULT_STAKE_MAINTENANCE)) {
+        scheduler.scheduleEvery([this]() { MaintainStakeCoins(g_connman.get()); }, STAKE_MAINTENANCE_INTERVAL * 1000, "stakemaintenance");
+    }
 }
 
 bool CWallet::ParameterInteraction()
@@ -23,6 +23,7 @@
 #include "wallet/rpcwallet.h"
 
 #include "privatesend.h"
+#include "saltedhasher.h"
 
 #include <algorithm>
 #include <atomic>
@@ -32,6 +33,7 @@
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -47,6 +49,8 @@ extern unsigned int nTxConfirmTarget;
 extern bool bSpendZeroConfChange;
 
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 1000;
+//! Keys added to the keypool per database transaction and per hold of cs_wallet
+static const unsigned int KEYPOOL_BATCH_SIZE = 1000;
 //! -paytxfee default
 static const CAmount DEFAULT_TRANSACTION_FEE = 0;
 //! -fallbackfee default
@@ -69,6 +73,16 @@ static const bool DEFAULT_WALLET_REJECT_LONG_CHAINS = false;
 static const unsigned int DEFAULT_TX_CONFIRM_TARGET = 2;
 static const bool DEFAULT_WALLETBROADCAST = true;
 static const bool DEFAULT_DISABLE_WALLET = false;
+//! -stakemaintenance default
+static const bool DEFAULT_STAKE_MAINTENANCE = false;
+//! Seconds between two runs of the stake maintenance
+static const int64_t STAKE_MAINTENANCE_INTERVAL = 10 * 60;
+//! Most coins combined by one stake maintenance transaction
+static const unsigned int MAX_STAKE_COMBINE_INPUTS = 50;
+//! Fewest coins worth combining when they don't add up to the stake target value
+static const unsigned int MIN_STAKE_COMBINE_INPUTS = 10;
+//! Most outputs a coin is split into by one stake maintenance transaction
+static const unsigned int MAX_STAKE_SPLIT_OUTPUTS = 20;
 
 extern const char * DEFAULT_WALLET_DAT;
 
@@ -178,6 +192,25 @@ struct CRecipient
     bool fSubtractFeeFromAmount;
 };
 
+/** A coin the stake maintenance may move, see PlanStakeMaintenance */
+struct CStakeMaintenanceCoin
+{
+    COutPoint outpoint;
+    CScript scriptPubKey;
+    CAmount nValue;
+};
+
+/**
+ * Picks the next stake maintenance transaction. Coins below nTarget are combined first: the
+ * smallest ones of the address which has the most of them, into one output to the same
+ * address, until they reach nTarget or MAX_STAKE_COMBINE_INPUTS. Otherwise the largest coin
+ * of more than twice nTarget is split into outputs of at least nTarget. Either leaves room
+ * for a fee of up to nMaxFee, and coins which are worth less than what it costs to spend
+ * them are left out. Returns false if there is nothing to do.
+ */
+bool PlanStakeMaintenance(const std::vector<CStakeMaintenanceCoin>& vCoins, CAmount nTarget, CAmount nMaxFee,
+                          std::vector<COutPoint>& vInputsRet, std::vector<CRecipient>& vRecipientsRet);
+
 typedef std::map<std::string, std::string> mapValue_t;
 
 
@@ -463,21 +496,8 @@ public:
     }
 
     //! make sure balances are recalculated
-    void MarkDirty()
-    {
-        fCreditCached = false;
-        fAvailableCreditCached = false;
-        fImmatureCreditCached = false;
-        fAnonymizedCreditCached = false;
-        fDenomUnconfCreditCached = false;
-        fDenomConfCreditCached = false;
-        fWatchDebitCached = false;
-        fWatchCreditCached = false;
-        fAvailableWatchCreditCached = false;
-        fImmatureWatchCreditCached = false;
-        fDebitCached = false;
-        fChangeCached = false;
-    }
+    //! Drop the cached credits, and let the wallet know its balance changed
+    void MarkDirty();
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -669,10 +689,72 @@ private:
 };
 
 
+/** Staking counters of a single stake destination, reported by getstakingstatus */
+struct CStakingKeyStats
+{
+    //! stake inputs of this destination in the last search round
+    int nCoins{0};
+    //! search rounds this destination took part in
+    int64_t nSearches{0};
+    //! kernels found for this destination
+    int64_t nKernelsFound{0};
+    //! time of the last kernel found
+    int64_t nLastKernelTime{0};
+};
+
+/** Staking counters of a wallet, guarded by CWallet::cs_stakingStats */
+struct CStakingStats
+{
+    std::map<CTxDestination, CStakingKeyStats> mapKeys;
+    int64_t nSearches{0};
+    int64_t nKernelsFound{0};
+    int64_t nLastSearchMicros{0};
+    int64_t nTotalSearchMicros{0};
+};
+
 /** 
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
  */
+/** The balances of a wallet by kind, see CWallet::GetWalletBalance */
+struct CWalletBalance
+{
+    CAmount nTrusted = 0;               //!< GetBalance
+    CAmount nUntrustedPending = 0;      //!< GetUnconfirmedBalance
+    CAmount nImmature = 0;              //!< GetImmatureBalance
+    CAmount nWatchTrusted = 0;          //!< GetWatchOnlyBalance
+    CAmount nWatchUntrustedPending = 0; //!< GetUnconfirmedWatchOnlyBalance
+    CAmount nWatchImmature = 0;         //!< GetImmatureWatchOnlyBalance
+
+    bool IsNull() const
+    {
+        return nTrusted == 0 && nUntrustedPending == 0 && nImmature == 0 &&
+               nWatchTrusted == 0 && nWatchUntrustedPending == 0 && nWatchImmature == 0;
+    }
+
+    CWalletBalance& operator+=(const CWalletBalance& b)
+    {
+        nTrusted += b.nTrusted;
+        nUntrustedPending += b.nUntrustedPending;
+        nImmature += b.nImmature;
+        nWatchTrusted += b.nWatchTrusted;
+        nWatchUntrustedPending += b.nWatchUntrustedPending;
+        nWatchImmature += b.nWatchImmature;
+        return *this;
+    }
+
+    CWalletBalance& operator-=(const CWalletBalance& b)
+    {
+        nTrusted -= b.nTrusted;
+        nUntrustedPending -= b.nUntrustedPending;
+        nImmature -= b.nImmature;
+        nWatchTrusted -= b.nWatchTrusted;
+        nWatchUntrustedPending -= b.nWatchUntrustedPending;
+        nWatchImmature -= b.nWatchImmature;
+        return *this;
+    }
+};
+
 class CWallet : public CCryptoKeyStore, public CValidationInterface
 {
 private:
@@ -701,11 +783,55 @@ private:
     unsigned int nHashDrift = 45;
     unsigned int nHashInterval = 22;
     int nStakeSetUpdateTime = 300; // 5 mins
+    //! When CreateCoinStake selected its coins last, 0 makes it select them again
+    std::atomic<int64_t> nLastStakeSetUpdate{0};
+    //! The last stake maintenance transaction, the next one waits until it confirmed
+    uint256 hashLastStakeMaintenance;
+
+    mutable CCriticalSection cs_stakingStats;
+    CStakingStats stakingStats;
+
+    /**
+     * Keys of the stake-eligible coins, filled by UnlockForStaking. With these the minter can
+     * sign blocks while the wallet itself is locked, and without taking cs_KeyStore. CKey
+     * keeps its secret in locked (mlock'ed) memory.
+     */
+    mutable CCriticalSection cs_stakingKeys;
+    std::map<CKeyID, CKey> mapStakingKeys;
+
+    /**
+     * Confirmed SelectCoinsGroupedByAddresses tallies by [fSkipDenominated][fAnonymizable],
+     * without the per address limit and the minimum amount applied
+     */
+    mutable bool fTallyCached[2][2];
+    mutable std::vector<CompactTallyItem> vecTallyCached[2][2];
+    void ResetTallyCache();
+
+    /**
+     * Balance ledger: the total balance and what each transaction adds to it. Only the
+     * transactions marked dirty since, the unconfirmed and the immature ones are looked at
+     * again on the next GetWalletBalance. Everything is recomputed after a reorg or a wallet
+     * wide MarkDirty.
+     */
+    mutable bool fBalanceCacheValid;
+    mutable const CBlockIndex* pindexBalanceTip;
+    mutable CWalletBalance balanceCached;
+    mutable std::map<uint256, CWalletBalance> mapBalanceContributions;
+    mutable std::set<uint256> setBalanceDirtyTxs;
+    //! Transactions whose balance can change without them being marked dirty
+    mutable std::set<uint256> setBalanceVolatileTxs;
+    void UpdateBalanceContribution(const uint256& hash) const;
 
-    mutable bool fAnonymizableTallyCached;
-    mutable std::vector<CompactTallyItem> vecAnonymizableTallyCached;
-    mutable bool fAnonymizableTallyCachedNonDenom;
-    mutable std::vector<CompactTallyItem> vecAnonymizableTallyCachedNonDenom;
+    /**
+     * History index for listsinceblock: the wallet transactions by the block they are
+     * confirmed in, under the null hash if unconfirmed, conflicted, abandoned or disconnected.
+     */
+    std::map<uint256, std::set<uint256> > mapTxsByBlock;
+    std::map<uint256, uint256> mapTxHistoryBlock;
+    void IndexTxHistory(const uint256& hash, bool fDisconnected = false);
+
+    /** The keys, P2SH scripts and watch-only scripts of the wallet, for filtering a rescan */
+    void GetRescanFilter(std::set<CKeyID>& setKeyIDs, std::set<CScriptID>& setScriptIDs, std::set<CScript>& setScripts) const;
 
     /**
      * Used to keep track of spent outpoints, and
@@ -726,10 +852,12 @@ private:
 
     /* HD derive new child key (on internal or external chain) */
     void DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal /*= false*/);
-    bool CreateCoinStakeKernel(CScript &kernelScript, const CScript &stakeScript,
-                               unsigned int nBits, const CBlock& blockFrom,
-                               unsigned int nTxPrevOffset, const CTransactionRef &txPrev,
-                               const COutPoint& prevout, unsigned int &nTimeTx, bool fPrintProofOfStake) const;
+    /* HD derive nCount new child keys in parallel and write them through walletdb */
+    void DeriveNewChildKeys(CWalletDB& walletdb, uint32_t nAccountIndex, bool fInternal, size_t nCount, std::vector<CPubKey>& vPubKeysRet);
+
+    //! Runs background keypool top-ups once set by postInitProcess
+    CScheduler* pschedulerTopUp;
+    std::atomic<bool> fTopUpScheduled;
     void FillCoinStakePayments(CMutableTransaction &transaction,
                                const CScript &kernelScript,
                                const COutPoint &stakePrevout, CAmount blockReward) const;
@@ -752,6 +880,17 @@ private:
      */
     bool AddWatchOnly(const CScript& dest) override;
 
+    /**
+     * Prefilter for IsMine(const CTxOut&): the key and script ids of all keys, HD pubkeys,
+     * redeem scripts and watch-only scripts, behind a lock of its own. A P2PKH, P2SH or P2PK
+     * output whose id isn't in it can't be ours, so it skips Solver and the keystore lookups.
+     * Ids are never removed, a stale one only costs the full check.
+     */
+    mutable CCriticalSection cs_mineFilter;
+    std::unordered_set<uint160, SaltedHasher<uint160, SaltedHasherBase> > setMineFilter;
+    void AddToMineFilter(const uint160& id);
+    void AddToMineFilter(const CScript& script);
+
 public:
     /*
      * Main wallet lock.
@@ -821,10 +960,11 @@ public:
         nLastResend = 0;
         nTimeFirstKey = 0;
         fBroadcastTransactions = false;
-        fAnonymizableTallyCached = false;
-        fAnonymizableTallyCachedNonDenom = false;
-        vecAnonymizableTallyCached.clear();
-        vecAnonymizableTallyCachedNonDenom.clear();
+        ResetTallyCache();
+        fBalanceCacheValid = false;
+        pindexBalanceTip = NULL;
+        pschedulerTopUp = NULL;
+        fTopUpScheduled = false;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -870,8 +1010,23 @@ public:
     bool GetCollateralTxDSIn(CTxDSIn& txdsinRet, CAmount& nValueRet) const;
     bool SelectPrivateCoins(CAmount nValueMin, CAmount nValueMax, std::vector<CTxIn>& vecTxInRet, CAmount& nValueRet, int nPrivateSendRoundsMin, int nPrivateSendRoundsMax) const;
     using StakeCoinsSet = std::set<std::pair<const CWalletTx*, unsigned int>>;
+    /**
+     * populate vCoins with the outputs which can be used as stake inputs. Only walks setWalletUTXO
+     * (maintained by AddToWallet/AddToSpends) instead of the whole of mapWallet.
+     */
+    void AvailableStakeCoins(std::vector<COutput>& vCoins, bool fIncludeWatchOnly) const;
     bool MintableCoins();
+    CStakingStats GetStakingStats() const;
     bool SelectStakeCoins(StakeCoinsSet &setCoins, CAmount nTargetAmount, const CScript &scriptFilterPubKey) const;
+    /** The size stake outputs are split and combined to: nStakeSplitThreshold, but never below the minimum stake value */
+    CAmount GetStakeTargetValue() const;
+    /**
+     * Combines or splits coins, see PlanStakeMaintenance, so the stake set stays small and of
+     * stakeable coins. Only moves coins which are past the minimum stake age, leaves denominated
+     * and collateral coins alone, and runs only while the wallet is unlocked fully and no
+     * earlier maintenance transaction waits for a confirmation.
+     */
+    void MaintainStakeCoins(CConnman* connman);
 
     bool SelectCoinsGroupedByAddresses(std::vector<CompactTallyItem>& vecTallyRet, bool fSkipDenominated = true, bool fAnonymizable = true, bool fSkipUnconfirmed = true, int nMaxOupointsPerAddress = -1) const;
 
@@ -917,7 +1072,7 @@ public:
     //! Adds a key to the store, and saves it to disk.
     bool AddKeyPubKey(const CKey& key, const CPubKey &pubkey) override;
     //! Adds a key to the store, without saving it to disk (used by LoadWallet)
-    bool LoadKey(const CKey& key, const CPubKey &pubkey) { return CCryptoKeyStore::AddKeyPubKey(key, pubkey); }
+    bool LoadKey(const CKey& key, const CPubKey &pubkey) { AddToMineFilter(pubkey.GetID()); return CCryptoKeyStore::AddKeyPubKey(key, pubkey); }
     //! Load metadata (used by LoadWallet)
     bool LoadKeyMetadata(const CTxDestination& pubKey, const CKeyMetadata &metadata);
 
@@ -951,6 +1106,14 @@ public:
     int64_t nRelockTime;
 
     bool Unlock(const SecureString& strWalletPassphrase, bool fForMixingOnly = false);
+    //! Decrypt the keys of the stake-eligible coins into mapStakingKeys and leave the wallet locked
+    bool UnlockForStaking(const SecureString& strWalletPassphrase);
+    void ClearStakingKeys();
+    bool IsUnlockedForStaking() const;
+    //! Whether the minter has the keys it needs, from a full unlock or UnlockForStaking
+    bool CanStake() const { return !IsLocked() || IsUnlockedForStaking(); }
+    //! The key to sign a staked block with, from mapStakingKeys or else the unlocked keystore
+    bool GetStakingKey(const CKeyID& keyID, CKey& keyRet) const;
     bool ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase, const SecureString& strNewWalletPassphrase);
     bool EncryptWallet(const SecureString& strWalletPassphrase);
 
@@ -975,6 +1138,12 @@ public:
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman) override;
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime, CConnman* connman);
+    /** Note that the credits of a transaction changed, called by CWalletTx::MarkDirty */
+    void MarkBalanceDirty(const uint256& hash) const;
+    /** All the balances below at once, only updating what changed since the last call */
+    CWalletBalance GetWalletBalance() const;
+    /** A superset of the transactions less deep than pindex, all of them if pindex is NULL */
+    void GetTxsSinceBlock(const CBlockIndex* pindex, std::set<uint256>& setTxsRet) const;
     CAmount GetBalance() const;
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;
@@ -1040,6 +1209,8 @@ public:
     size_t KeypoolCountExternalKeys();
     size_t KeypoolCountInternalKeys();
     bool TopUpKeyPool(unsigned int kpSize = 0);
+    //! Top up the keypool on the scheduler thread, or right away if there is none yet
+    void ScheduleTopUpKeyPool();
     void ReserveKeyFromKeyPool(int64_t& nIndex, CKeyPool& keypool, bool fInternal);
     void KeepKey(int64_t nIndex);
     void ReturnKey(int64_t nIndex, bool fInternal);
@@ -19,6 +19,7 @@
 #include "wallet/wallet.h"
 
 #include <atomic>
+#include <thread>
 
 #include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
@@ -269,15 +270,60 @@ public:
     bool fAnyUnordered;
     int nFileVersion;
     std::vector<uint256> vWalletUpgrade;
+    //! Collect tx records in vTxRecords instead of loading them one by one
+    bool fDeferTx;
+    std::vector<std::pair<CDataStream, CDataStream> > vTxRecords;
 
     CWalletScanState() {
         nKeys = nCKeys = nWatchKeys = nKeyMeta = 0;
         fIsEncrypted = false;
         fAnyUnordered = false;
         nFileVersion = 0;
+        fDeferTx = false;
     }
 };
 
+/** Tx records deserialized and checked together by LoadWallet */
+static const size_t LOAD_TX_BATCH_SIZE = 10000;
+static const int MAX_LOAD_TX_THREADS = 8;
+
+/** Deserialize and check a tx record, the key stream positioned after the type */
+static bool ReadWalletTx(CDataStream& ssKey, CDataStream& ssValue, CWalletTx& wtx, bool& fUpgradedRet, std::string& strErr)
+{
+    try {
+        uint256 hash;
+        ssKey >> hash;
+        ssValue >> wtx;
+        CValidationState state;
+        if (!(CheckTransaction(wtx, state) && (wtx.GetHash() == hash) && state.IsValid()))
+            return false;
+
+        // Undo serialize changes in 31600
+        fUpgradedRet = false;
+        if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
+        {
+            if (!ssValue.empty())
+            {
+                char fTmp;
+                char fUnused;
+                ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
+                strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
+                                   wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
+                wtx.fTimeReceivedIsTxTime = fTmp;
+            }
+            else
+            {
+                strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
+                wtx.fTimeReceivedIsTxTime = 0;
+            }
+            fUpgradedRet = true;
+        }
+    } catch (...) {
+        return false;
+    }
+    return true;
+}
+
 bool
 ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
              CWalletScanState &wss, std::string& strType, std::string& strErr)
@@ -301,33 +347,17 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         }
         else if (strType == "tx")
         {
-            uint256 hash;
-            ssKey >> hash;
+            if (wss.fDeferTx) {
+                wss.vTxRecords.emplace_back(ssKey, ssValue);
+                return true;
+            }
+
             CWalletTx wtx;
-            ssValue >> wtx;
-            CValidationState state;
-            if (!(CheckTransaction(wtx, state) && (wtx.GetHash() == hash) && state.IsValid()))
+            bool fUpgraded;
+            if (!ReadWalletTx(ssKey, ssValue, wtx, fUpgraded, strErr))
                 return false;
-
-            // Undo serialize changes in 31600
-            if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
-            {
-                if (!ssValue.empty())
-                {
-                    char fTmp;
-                    char fUnused;
-                    ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
-                    strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
-                                       wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = fTmp;
-                }
-                else
-                {
-                    strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = 0;
-                }
-                wss.vWalletUpgrade.push_back(hash);
-            }
+            if (fUpgraded)
+                wss.vWalletUpgrade.push_back(wtx.GetHash());
 
             if (wtx.nOrderPos == -1)
                 wss.fAnyUnordered = true;
@@ -578,6 +608,53 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
     return true;
 }
 
+/**
+ * Deserialize and check the collected tx records on a few threads, then add them to the
+ * wallet in file order. A bad record is treated like in ReadKeyValue.
+ */
+static void LoadWalletTxBatch(CWallet* pwallet, CWalletScanState& wss, bool& fNoncriticalErrors)
+{
+    AssertLockHeld(pwallet->cs_wallet);
+
+    const size_t nRecords = wss.vTxRecords.size();
+    std::vector<CWalletTx> vWtx(nRecords);
+    std::vector<char> vfRead(nRecords, false);
+    std::vector<char> vfUpgraded(nRecords, false);
+    std::vector<std::string> vErr(nRecords);
+
+    std::atomic<size_t> nNextRecord(0);
+    auto readRecords = [&]() {
+        for (size_t i = nNextRecord++; i < nRecords; i = nNextRecord++) {
+            bool fUpgraded = false;
+            vfRead[i] = ReadWalletTx(wss.vTxRecords[i].first, wss.vTxRecords[i].second, vWtx[i], fUpgraded, vErr[i]);
+            vfUpgraded[i] = fUpgraded;
+        }
+    };
+    std::vector<std::thread> vThreads;
+    for (int i = 1; i < std::min(GetNumCores(), MAX_LOAD_TX_THREADS); i++)
+        vThreads.emplace_back(readRecords);
+    readRecords();
+    for (std::thread& thread : vThreads)
+        thread.join();
+    wss.vTxRecords.clear();
+
+    for (size_t i = 0; i < nRecords; i++) {
+        if (!vErr[i].empty())
+            LogPrintf("%s\n", vErr[i]);
+        if (!vfRead[i]) {
+            fNoncriticalErrors = true;
+            // Rescan if there is a bad transaction record:
+            SoftSetBoolArg("-rescan", true);
+            continue;
+        }
+        if (vfUpgraded[i])
+            wss.vWalletUpgrade.push_back(vWtx[i].GetHash());
+        if (vWtx[i].nOrderPos == -1)
+            wss.fAnyUnordered = true;
+        pwallet->LoadToWallet(vWtx[i]);
+    }
+}
+
 bool CWalletDB::IsKeyType(const std::string& strType)
 {
     return (strType== "key" || strType == "wkey" ||
@@ -589,6 +666,7 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
 {
     pwallet->vchDefaultKey = CPubKey();
     CWalletScanState wss;
+    wss.fDeferTx = true;
     bool fNoncriticalErrors = false;
     DBErrors result = DB_LOAD_OK;
 
@@ -643,8 +721,11 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             }
             if (!strErr.empty())
                 LogPrintf("%s\n", strErr);
+            if (wss.vTxRecords.size() >= LOAD_TX_BATCH_SIZE)
+                LoadWalletTxBatch(pwallet, wss, fNoncriticalErrors);
         }
         pcursor->close();
+        LoadWalletTxBatch(pwallet, wss, fNoncriticalErrors);
 
         // Store initial external keypool size since we mostly use external keys in mixing
         pwallet->nKeysLeftSinceAutoBackup = pwallet->KeypoolCountExternalKeys();
@@ -45,3 +45,18 @@ bool CZMQAbstractNotifier::NotifyInstantSendDoubleSpendAttempt(const CTransactio
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyMasternodeListChanged(bool /*undo*/, const CDeterministicMNList& /*oldMNList*/, const CDeterministicMNListDiff& /*diff*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyTransactionRemovedFromMempool(const CTransaction& /*transaction*/, MemPoolRemovalReason /*reason*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyRecoveredSig(const llmq::CRecoveredSig& /*sig*/)
+{
+    return true;
+}
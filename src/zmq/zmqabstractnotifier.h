@@ -8,12 +8,29 @@
 #include "zmqconfig.h"
 
 class CBlockIndex;
+class CDeterministicMNList;
+class CDeterministicMNListDiff;
 class CGovernanceObject;
 class CGovernanceVote;
 class CZMQAbstractNotifier;
+enum class MemPoolRemovalReason;
+
+namespace llmq {
+    class CRecoveredSig;
+}
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
+/** Message counters of a notifier, as reported by getzmqnotifications */
+struct CZMQNotifierStats
+{
+    uint64_t nQueued = 0;    //!< waiting for the send thread right now
+    uint64_t nMaxQueued = 0; //!< most messages waiting at once
+    uint64_t nSent = 0;
+    uint64_t nDropped = 0;   //!< not queued because the send queue was full
+    uint64_t nFailed = 0;    //!< zmq failed to send
+};
+
 class CZMQAbstractNotifier
 {
 public:
@@ -34,6 +51,8 @@ public:
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
+    virtual CZMQNotifierStats GetStats() const { return CZMQNotifierStats(); }
+
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyChainLock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
@@ -41,7 +60,9 @@ public:
     virtual bool NotifyGovernanceVote(const CGovernanceVote &vote);
     virtual bool NotifyGovernanceObject(const CGovernanceObject &object);
     virtual bool NotifyInstantSendDoubleSpendAttempt(const CTransaction &currentTx, const CTransaction &previousTx);
-
+    virtual bool NotifyMasternodeListChanged(bool undo, const CDeterministicMNList& oldMNList, const CDeterministicMNListDiff& diff);
+    virtual bool NotifyTransactionRemovedFromMempool(const CTransaction &transaction, MemPoolRemovalReason reason);
+    virtual bool NotifyRecoveredSig(const llmq::CRecoveredSig &sig);
 
 protected:
     void *psocket;
@@ -6,12 +6,18 @@
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
 #include "validationinterface.h"
+#include <list>
 #include <string>
 #include <map>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
+/** Minimum time between two block template updates, in milliseconds */
+static const int64_t DEFAULT_ZMQ_BLOCKTEMPLATE_INTERVAL = 250;
+/** Maximum number of messages waiting for the zmq send thread, more are dropped */
+static const unsigned int DEFAULT_ZMQ_SEND_QUEUE_SIZE = 10000;
+
 class CZMQNotificationInterface : public CValidationInterface
 {
 public:
@@ -19,11 +25,19 @@ public:
 
     static CZMQNotificationInterface* Create();
 
+    std::list<const CZMQAbstractNotifier*> GetActiveNotifiers() const;
+
 protected:
     bool Initialize();
     void Shutdown();
 
     // CValidationInterface
+    // publishing doesn't have to hold up validation, the notifications keep their order
+    int GetBackgroundCallbacks() const override
+    {
+        return BG_UPDATED_BLOCK_TIP | BG_SYNC_TRANSACTION | BG_NOTIFY_TRANSACTION_LOCK | BG_NOTIFY_CHAIN_LOCK |
+               BG_TRANSACTION_REMOVED_FROM_MEMPOOL | BG_NOTIFY_RECOVERED_SIG;
+    }
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
     void NotifyChainLock(const CBlockIndex *pindex) override;
@@ -31,6 +45,9 @@ protected:
     void NotifyGovernanceVote(const CGovernanceVote& vote) override;
     void NotifyGovernanceObject(const CGovernanceObject& object) override;
     void NotifyInstantSendDoubleSpendAttempt(const CTransaction &currentTx, const CTransaction &previousTx) override;
+    void NotifyMasternodeListChanged(bool undo, const CDeterministicMNList& oldMNList, const CDeterministicMNListDiff& diff) override;
+    void TransactionRemovedFromMempool(const std::shared_ptr<const CTransaction>& ptx, MemPoolRemovalReason reason) override;
+    void NotifyRecoveredSig(const std::shared_ptr<const llmq::CRecoveredSig>& sig) override;
 
 
 private:
@@ -40,4 +57,6 @@ private:
     std::list<CZMQAbstractNotifier*> notifiers;
 };
 
+extern CZMQNotificationInterface* pzmqNotificationInterface;
+
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
@@ -3,11 +3,22 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chainparams.h"
+#include "init.h"
+#include "evo/deterministicmns.h"
+#include "llmq/quorums_signing.h"
+#include "miner.h"
+#include "net_processing.h"
+#include "saltedhasher.h"
 #include "streams.h"
+#include "txmempool.h"
+#include "zmqnotificationinterface.h"
 #include "zmqpublishnotifier.h"
 #include "validation.h"
 #include "util.h"
 
+#include <deque>
+#include <unordered_set>
+
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
 static const char *MSG_HASHBLOCK     = "hashblock";
@@ -24,45 +35,204 @@ static const char *MSG_RAWTXLOCK     = "rawtxlock";
 static const char *MSG_RAWGVOTE      = "rawgovernancevote";
 static const char *MSG_RAWGOBJ       = "rawgovernanceobject";
 static const char *MSG_RAWISCON      = "rawinstantsenddoublespend";
-
-// Internal function to send multipart message
-static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
+static const char *MSG_RAWMSGSTATS   = "rawmessagestats";
+static const char *MSG_RAWBLOCKSTATS = "rawblockprocessingstats";
+static const char *MSG_BLOCKTEMPLATE = "blocktemplate";
+static const char *MSG_BLOCKTEMPLATEDIFF = "blocktemplatediff";
+static const char *MSG_RAWMNLISTDIFF = "rawmnlistdiff";
+static const char *MSG_HASHMEMPOOLREMOVED = "hashmempoolremoved";
+static const char *MSG_RAWRECSIG     = "rawrecoveredsig";
+
+/**
+ * All publish notifiers hand their messages to one send thread, so the validation callbacks
+ * never wait for zmq and the sockets are only used from a single thread. Data parts are
+ * passed to zmq without copying them, the send thread holds a reference until zmq is done.
+ * When more than -zmqsendqueuesize messages are waiting new ones are dropped, subscribers
+ * notice by the gap in the sequence numbers.
+ */
+class CZMQSendQueue
 {
-    va_list args;
-    va_start(args, size);
+private:
+    typedef std::shared_ptr<const std::vector<unsigned char> > DataRef;
+
+    struct Message {
+        CZMQAbstractPublishNotifier* notifier;
+        void *psocket;
+        const char *command;
+        DataRef data;
+        uint32_t nSequence;
+    };
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::condition_variable condIdle;
+    std::deque<Message> queue;
+    std::thread thread;
+    int nUsers = 0;
+    bool fInterrupt = false;
+    bool fSending = false;
+    size_t nMaxSize = DEFAULT_ZMQ_SEND_QUEUE_SIZE;
+
+    static void FreeData(void * /*data*/, void *hint)
+    {
+        delete static_cast<DataRef*>(hint);
+    }
 
-    while (1)
+    static bool SendPart(void *sock, zmq_msg_t& msg, bool fMore)
+    {
+        if (zmq_msg_send(&msg, sock, fMore ? ZMQ_SNDMORE : 0) == -1) {
+            zmqError("Unable to send ZMQ msg");
+            zmq_msg_close(&msg);
+            return false;
+        }
+        return true;
+    }
+
+    /* send three parts, command & data & a LE 4byte sequence number */
+    static bool Send(const Message& message)
     {
         zmq_msg_t msg;
 
-        int rc = zmq_msg_init_size(&msg, size);
-        if (rc != 0)
-        {
+        // commands are string constants, nothing to free
+        if (zmq_msg_init_data(&msg, (void*)message.command, strlen(message.command), NULL, NULL) != 0) {
             zmqError("Unable to initialize ZMQ msg");
-            return -1;
+            return false;
         }
+        if (!SendPart(message.psocket, msg, true))
+            return false;
 
-        void *buf = zmq_msg_data(&msg);
-        memcpy(buf, data, size);
+        DataRef* hint = new DataRef(message.data);
+        if (zmq_msg_init_data(&msg, (void*)message.data->data(), message.data->size(), FreeData, hint) != 0) {
+            delete hint;
+            zmqError("Unable to initialize ZMQ msg");
+            return false;
+        }
+        if (!SendPart(message.psocket, msg, true))
+            return false;
 
-        data = va_arg(args, const void*);
+        if (zmq_msg_init_size(&msg, sizeof(uint32_t)) != 0) {
+            zmqError("Unable to initialize ZMQ msg");
+            return false;
+        }
+        WriteLE32((unsigned char*)zmq_msg_data(&msg), message.nSequence);
+        return SendPart(message.psocket, msg, false);
+    }
+
+    void ThreadSend()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            cond.wait(lock, [this] { return fInterrupt || !queue.empty(); });
+            // what is queued still goes out before stopping
+            if (queue.empty())
+                break;
+
+            Message message = std::move(queue.front());
+            queue.pop_front();
+            message.notifier->stats.nQueued--;
+            fSending = true;
+
+            lock.unlock();
+            bool fSent = Send(message);
+            message.data.reset();
+            lock.lock();
+
+            fSending = false;
+            if (fSent)
+                message.notifier->stats.nSent++;
+            else
+                message.notifier->stats.nFailed++;
+            if (queue.empty())
+                condIdle.notify_all();
+        }
+    }
+
+public:
+    void Start()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (nUsers++ > 0)
+            return;
+        fInterrupt = false;
+        nMaxSize = std::max<int64_t>(GetArg("-zmqsendqueuesize", DEFAULT_ZMQ_SEND_QUEUE_SIZE), 1);
+        thread = std::thread(&TraceThread<std::function<void()> >, "zmqsend", std::function<void()>(std::bind(&CZMQSendQueue::ThreadSend, this)));
+    }
 
-        rc = zmq_msg_send(&msg, sock, data ? ZMQ_SNDMORE : 0);
-        if (rc == -1)
+    void Stop()
+    {
         {
-            zmqError("Unable to send ZMQ msg");
-            zmq_msg_close(&msg);
-            return -1;
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--nUsers > 0)
+                return;
+            fInterrupt = true;
         }
+        cond.notify_all();
+        if (thread.joinable())
+            thread.join();
+    }
 
-        zmq_msg_close(&msg);
+    //! Wait for everything queued so far to be sent, before closing a socket
+    void WaitIdle()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condIdle.wait(lock, [this] { return queue.empty() && !fSending; });
+    }
 
-        if (!data)
-            break;
+    //! Returns false if the message had to be dropped
+    bool Push(CZMQAbstractPublishNotifier* notifier, void *psocket, const char *command, const DataRef& data)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            uint32_t nSequence = notifier->nSequence++;
+            if (queue.size() >= nMaxSize) {
+                notifier->stats.nDropped++;
+                LogPrint("zmq", "zmq: Send queue full, dropped %s message %u\n", command, nSequence);
+                return false;
+            }
+            queue.push_back(Message{notifier, psocket, command, data, nSequence});
+            notifier->stats.nQueued++;
+            notifier->stats.nMaxQueued = std::max(notifier->stats.nMaxQueued, notifier->stats.nQueued);
+        }
+        cond.notify_one();
+        return true;
+    }
+
+    CZMQNotifierStats GetStats(const CZMQAbstractPublishNotifier* notifier)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return notifier->stats;
+    }
+};
 
-        size = va_arg(args, size_t);
+static CZMQSendQueue zmqSendQueue;
+
+template <typename T>
+static std::shared_ptr<const std::vector<unsigned char> > SerializeShared(const T& obj)
+{
+    auto data = std::make_shared<std::vector<unsigned char> >();
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, *data, 0, obj);
+    return data;
+}
+
+/**
+ * The block last published by a raw notifier as stored on disk, rawblock and rawchainlock
+ * mostly publish the same one and can share it
+ */
+static std::shared_ptr<const std::vector<unsigned char> > GetRawBlock(const CBlockIndex *pindex)
+{
+    static std::mutex mutex;
+    static uint256 hashLast;
+    static std::shared_ptr<const std::vector<unsigned char> > dataLast;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!dataLast || hashLast != pindex->GetBlockHash()) {
+        auto data = std::make_shared<std::vector<unsigned char> >();
+        if (!ReadRawBlockFromDisk(*data, pindex, Params().MessageStart()))
+            return nullptr;
+        dataLast = data;
+        hashLast = pindex->GetBlockHash();
     }
-    return 0;
+    return dataLast;
 }
 
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
@@ -91,6 +261,7 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 
         // register this notifier for the address, so it can be reused for other publish notifier
         mapPublishNotifiers.insert(std::make_pair(address, this));
+        zmqSendQueue.Start();
         return true;
     }
     else
@@ -99,6 +270,7 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 
         psocket = i->second->psocket;
         mapPublishNotifiers.insert(std::make_pair(address, this));
+        zmqSendQueue.Start();
 
         return true;
     }
@@ -108,6 +280,10 @@ void CZMQAbstractPublishNotifier::Shutdown()
 {
     assert(psocket);
 
+    // the send thread may still have messages for this notifier and socket
+    zmqSendQueue.WaitIdle();
+    zmqSendQueue.Stop();
+
     int count = mapPublishNotifiers.count(address);
 
     // remove this notifier from the list of publishers using this address
@@ -136,21 +312,23 @@ void CZMQAbstractPublishNotifier::Shutdown()
 
 bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
 {
-    assert(psocket);
-
-    /* send three parts, command & data & a LE 4byte sequence number */
-    unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), (void*)0);
-    if (rc == -1)
-        return false;
-
-    /* increment memory only sequence number after sending */
-    nSequence++;
+    const unsigned char* pdata = (const unsigned char*)data;
+    return SendMessage(command, std::make_shared<const std::vector<unsigned char> >(pdata, pdata + size));
+}
 
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const std::shared_ptr<const std::vector<unsigned char> >& data)
+{
+    assert(psocket);
+    // a full queue is not a reason to give up on the notifier, drops only show in the stats
+    zmqSendQueue.Push(this, psocket, command, data);
     return true;
 }
 
+CZMQNotifierStats CZMQAbstractPublishNotifier::GetStats() const
+{
+    return zmqSendQueue.GetStats(this);
+}
+
 bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     uint256 hash = pindex->GetBlockHash();
@@ -229,86 +407,261 @@ bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    auto data = GetRawBlock(pindex);
+    if (!data)
     {
-        LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        {
-            zmqError("Can't read block from disk");
-            return false;
-        }
-
-        ss << block;
+        zmqError("Can't read block from disk");
+        return false;
     }
-
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWBLOCK, data);
 }
 
 bool CZMQPublishRawChainLockNotifier::NotifyChainLock(const CBlockIndex *pindex)
 {
     LogPrint("zmq", "zmq: Publish rawchainlock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    auto data = GetRawBlock(pindex);
+    if (!data)
     {
-        LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        {
-            zmqError("Can't read block from disk");
-            return false;
-        }
-
-        ss << block;
+        zmqError("Can't read block from disk");
+        return false;
     }
-
-    return SendMessage(MSG_RAWCHAINLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWCHAINLOCK, data);
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish rawtx %s\n", hash.GetHex());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss << transaction;
-    return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWTX, SerializeShared(transaction));
 }
 
 bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish rawtxlock %s\n", hash.GetHex());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss << transaction;
-    return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWTXLOCK, SerializeShared(transaction));
 }
 
 bool CZMQPublishRawGovernanceVoteNotifier::NotifyGovernanceVote(const CGovernanceVote &vote)
 {
     uint256 nHash = vote.GetHash();
     LogPrint("gobject", "gobject: Publish rawgovernanceobject: hash = %s, vote = %d\n", nHash.ToString(), vote.ToString());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss << vote;
-    return SendMessage(MSG_RAWGVOTE, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWGVOTE, SerializeShared(vote));
 }
 
 bool CZMQPublishRawGovernanceObjectNotifier::NotifyGovernanceObject(const CGovernanceObject &govobj)
 {
     uint256 nHash = govobj.GetHash();
     LogPrint("gobject", "gobject: Publish rawgovernanceobject: hash = %s, type = %d\n", nHash.ToString(), govobj.GetObjectType());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss << govobj;
-    return SendMessage(MSG_RAWGOBJ, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWGOBJ, SerializeShared(govobj));
 }
 
 bool CZMQPublishRawInstaEPMDoubleSpendNotifier::NotifyInstantSendDoubleSpendAttempt(const CTransaction &currentTx, const CTransaction &previousTx)
 {
     LogPrint("zmq", "zmq: Publish rawinstantsenddoublespend %s conflicts with %s\n", currentTx.GetHash().ToString(), previousTx.GetHash().ToString());
-    CDataStream ssCurrent(SER_NETWORK, PROTOCOL_VERSION), ssPrevious(SER_NETWORK, PROTOCOL_VERSION);
-    ssCurrent << currentTx;
-    ssPrevious << previousTx;
-    return SendMessage(MSG_RAWISCON, &(*ssCurrent.begin()), ssCurrent.size())
-        && SendMessage(MSG_RAWISCON, &(*ssPrevious.begin()), ssPrevious.size());
+    return SendMessage(MSG_RAWISCON, SerializeShared(currentTx))
+        && SendMessage(MSG_RAWISCON, SerializeShared(previousTx));
+}
+
+bool CZMQPublishRawMessageStatsNotifier::NotifyBlock(const CBlockIndex *pindex)
+{
+    LogPrint("zmq", "zmq: Publish rawmessagestats at %s\n", pindex->GetBlockHash().GetHex());
+
+    return SendMessage(MSG_RAWMSGSTATS, SerializeShared(GetMessageProcessingStats()));
+}
+
+bool CZMQPublishRawBlockProcessingStatsNotifier::NotifyBlock(const CBlockIndex *pindex)
+{
+    LogPrint("zmq", "zmq: Publish rawblockprocessingstats at %s\n", pindex->GetBlockHash().GetHex());
+
+    return SendMessage(MSG_RAWBLOCKSTATS, SerializeShared(GetBlockProcessingStats()));
+}
+
+bool CZMQPublishRawMNListDiffNotifier::NotifyMasternodeListChanged(bool undo, const CDeterministicMNList& oldMNList, const CDeterministicMNListDiff& diff)
+{
+    LogPrint("zmq", "zmq: Publish rawmnlistdiff on %s%s\n", oldMNList.GetBlockHash().ToString(), undo ? " (undo)" : "");
+
+    // the diff applies to the list at that block, when undoing a block it leads back to its parent
+    auto data = std::make_shared<std::vector<unsigned char> >();
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, *data, 0, oldMNList.GetBlockHash(), undo, diff);
+    return SendMessage(MSG_RAWMNLISTDIFF, data);
+}
+
+bool CZMQPublishHashMempoolRemovedNotifier::NotifyTransactionRemovedFromMempool(const CTransaction &transaction, MemPoolRemovalReason reason)
+{
+    uint256 hash = transaction.GetHash();
+    LogPrint("zmq", "zmq: Publish hashmempoolremoved %s, reason %d\n", hash.GetHex(), (int)reason);
+    char data[33];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    data[32] = (char)reason;
+    return SendMessage(MSG_HASHMEMPOOLREMOVED, data, 33);
+}
+
+bool CZMQPublishRawRecoveredSigNotifier::NotifyRecoveredSig(const llmq::CRecoveredSig &sig)
+{
+    LogPrint("zmq", "zmq: Publish rawrecoveredsig id=%s, msgHash=%s\n", sig.id.ToString(), sig.msgHash.ToString());
+    return SendMessage(MSG_RAWRECSIG, SerializeShared(sig));
+}
+
+bool CZMQPublishBlockTemplateNotifier::Initialize(void *pcontext)
+{
+    if (!CZMQAbstractPublishNotifier::Initialize(pcontext))
+        return false;
+
+    fInterrupt = false;
+    thread = std::thread(&TraceThread<std::function<void()> >, "zmqtemplate", std::function<void()>(std::bind(&CZMQPublishBlockTemplateNotifier::ThreadPublish, this)));
+    return true;
+}
+
+void CZMQPublishBlockTemplateNotifier::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fInterrupt = true;
+    }
+    cond.notify_all();
+    if (thread.joinable())
+        thread.join();
+
+    CZMQAbstractPublishNotifier::Shutdown();
+}
+
+bool CZMQPublishBlockTemplateNotifier::NotifyBlock(const CBlockIndex *pindex)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fNewTip = true;
+        fHaveTip = true;
+    }
+    cond.notify_one();
+    return true;
+}
+
+bool CZMQPublishBlockTemplateNotifier::NotifyTransaction(const CTransaction &transaction)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fTxChanged = true;
+    }
+    cond.notify_one();
+    return true;
+}
+
+void CZMQPublishBlockTemplateNotifier::ThreadPublish()
+{
+    const int64_t nInterval = std::max<int64_t>(GetArg("-zmqblocktemplateinterval", DEFAULT_ZMQ_BLOCKTEMPLATE_INTERVAL), 0);
+    // Transactions leaving the mempool without a block are not notified, look for those every now and then
+    const int64_t nPollInterval = std::max<int64_t>(nInterval, 1000);
+    int64_t nLastPublish = 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cond.wait_for(lock, std::chrono::milliseconds(nPollInterval), [this] { return fInterrupt || fNewTip || fTxChanged; });
+        if (fInterrupt)
+            break;
+        if (!fHaveTip) {
+            // Nothing to diff against before the first full template
+            fTxChanged = false;
+            continue;
+        }
+
+        bool fFull = fNewTip;
+        if (!fFull) {
+            // A new tip goes out right away, transaction updates are held back to the interval
+            int64_t nWait = nLastPublish + nInterval - GetTimeMillis();
+            if (nWait > 0) {
+                cond.wait_for(lock, std::chrono::milliseconds(nWait), [this] { return fInterrupt || fNewTip; });
+                continue;
+            }
+        }
+        fNewTip = false;
+        fTxChanged = false;
+
+        lock.unlock();
+        if (PublishTemplate(fFull))
+            nLastPublish = GetTimeMillis();
+        lock.lock();
+    }
+}
+
+bool CZMQPublishBlockTemplateNotifier::PublishTemplate(bool fFull)
+{
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    {
+        LOCK(cs_main);
+        // pcoinsTip is deleted under cs_main during shutdown, before the notifiers are stopped
+        if (ShutdownRequested() || pcoinsTip == NULL || IsInitialBlockDownload())
+            return false;
+
+        unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+        if (!fFull && nTransactionsUpdated == nLastTransactionsUpdated)
+            return false;
+        nLastTransactionsUpdated = nTransactionsUpdated;
+
+        try {
+            // Same as getblocktemplate, the pool servers build their own coinbase outputs
+            CScript scriptDummy = CScript() << OP_TRUE;
+            pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptDummy, false);
+        } catch (const std::exception& e) {
+            LogPrint("zmq", "zmq: Unable to create block template: %s\n", e.what());
+            return false;
+        }
+        if (!pblocktemplate)
+            return false;
+    }
+
+    const CBlock& block = pblocktemplate->block;
+    // A diff only makes sense against the template of the same tip
+    if (block.hashPrevBlock != hashLastPrevBlock)
+        fFull = true;
+
+    std::vector<uint256> vTxHashes;
+    vTxHashes.reserve(block.vtx.size());
+    for (size_t i = 1; i < block.vtx.size(); i++)
+        vTxHashes.push_back(block.vtx[i]->GetHash());
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    const char *command;
+    if (fFull) {
+        LogPrint("zmq", "zmq: Publish blocktemplate on %s with %u txs\n", block.hashPrevBlock.GetHex(), vTxHashes.size());
+        ss << block << pblocktemplate->vTxFees;
+        command = MSG_BLOCKTEMPLATE;
+    } else {
+        std::unordered_set<uint256, StaticSaltedHasher> setLast(vLastTxHashes.begin(), vLastTxHashes.end());
+        std::unordered_set<uint256, StaticSaltedHasher> setNew(vTxHashes.begin(), vTxHashes.end());
+
+        std::vector<uint256> vRemoved;
+        for (const uint256& hash : vLastTxHashes) {
+            if (!setNew.count(hash))
+                vRemoved.push_back(hash);
+        }
+        // Appending the added txs to what is left keeps the order valid, as a parent can't be
+        // added to a template that already had its child
+        std::vector<CTransactionRef> vAdded;
+        std::vector<CAmount> vAddedFees;
+        for (size_t i = 1; i < block.vtx.size(); i++) {
+            if (!setLast.count(vTxHashes[i - 1])) {
+                vAdded.push_back(block.vtx[i]);
+                vAddedFees.push_back(pblocktemplate->vTxFees[i]);
+            }
+        }
+        if (vRemoved.empty() && vAdded.empty())
+            return false;
+
+        LogPrint("zmq", "zmq: Publish blocktemplatediff on %s, %u txs removed, %u added\n", block.hashPrevBlock.GetHex(), vRemoved.size(), vAdded.size());
+        ss << block.hashPrevBlock << vRemoved << vAdded << vAddedFees << block.vtx[0];
+        command = MSG_BLOCKTEMPLATEDIFF;
+    }
+
+    if (!zmqSendQueue.Push(this, psocket, command, std::make_shared<const std::vector<unsigned char> >(ss.begin(), ss.end()))) {
+        // Subscribers may have missed this one, start over with a full template
+        hashLastPrevBlock.SetNull();
+        vLastTxHashes.clear();
+        return false;
+    }
+    hashLastPrevBlock = block.hashPrevBlock;
+    vLastTxHashes.swap(vTxHashes);
+    return true;
 }
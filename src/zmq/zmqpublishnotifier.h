@@ -7,27 +7,40 @@
 
 #include "zmqabstractnotifier.h"
 
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 class CBlockIndex;
 class CGovernanceVote;
 class CGovernanceObject;
 
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
+    friend class CZMQSendQueue;
+
 private:
-    uint32_t nSequence; //!< upcounting per message sequence number
+    uint32_t nSequence = 0; //!< upcounting per message sequence number, dropped messages leave a gap
+    CZMQNotifierStats stats; //!< guarded by the send queue
 
 public:
 
-    /* send zmq multipart message
+    /* queue zmq multipart message for the send thread
        parts:
-          * command
+          * command, which has to be a string constant
           * data
           * message sequence number
     */
     bool SendMessage(const char *command, const void* data, size_t size);
+    //! Same without copying the data, which may also be queued by other notifiers
+    bool SendMessage(const char *command, const std::shared_ptr<const std::vector<unsigned char> >& data);
 
     bool Initialize(void *pcontext) override;
     void Shutdown() override;
+
+    CZMQNotifierStats GetStats() const override;
 };
 
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
@@ -113,4 +126,68 @@ class CZMQPublishRawInstaEPMDoubleSpendNotifier : public CZMQAbstractPublishNoti
 public:
     bool NotifyInstantSendDoubleSpendAttempt(const CTransaction &currentTx, const CTransaction &previousTx) override;
 };
+
+class CZMQPublishRawMessageStatsNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlock(const CBlockIndex *pindex) override;
+};
+
+class CZMQPublishRawBlockProcessingStatsNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlock(const CBlockIndex *pindex) override;
+};
+
+class CZMQPublishRawMNListDiffNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyMasternodeListChanged(bool undo, const CDeterministicMNList& oldMNList, const CDeterministicMNListDiff& diff) override;
+};
+
+class CZMQPublishHashMempoolRemovedNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionRemovedFromMempool(const CTransaction &transaction, MemPoolRemovalReason reason) override;
+};
+
+class CZMQPublishRawRecoveredSigNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyRecoveredSig(const llmq::CRecoveredSig &sig) override;
+};
+
+/**
+ * Publishes block templates, so pool servers don't have to long-poll getblocktemplate.
+ * A full template is published as soon as the tip changes, after that only the
+ * transactions added to and removed from it, at most once every
+ * -zmqblocktemplateinterval milliseconds. Templates are built on a thread of their own
+ * to keep CreateNewBlock out of block and transaction validation.
+ */
+class CZMQPublishBlockTemplateNotifier : public CZMQAbstractPublishNotifier
+{
+private:
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool fInterrupt = false;
+    bool fNewTip = false;
+    bool fHaveTip = false;
+    bool fTxChanged = false;
+
+    //! Transactions of the last published template, without the coinbase
+    uint256 hashLastPrevBlock;
+    std::vector<uint256> vLastTxHashes;
+    unsigned int nLastTransactionsUpdated = 0;
+
+    void ThreadPublish();
+    bool PublishTemplate(bool fFull);
+
+public:
+    bool Initialize(void *pcontext) override;
+    void Shutdown() override;
+
+    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyTransaction(const CTransaction &transaction) override;
+};
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
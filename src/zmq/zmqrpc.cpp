@@ -0,0 +1,66 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zmq/zmqrpc.h"
+
+#include "rpc/server.h"
+#include "zmq/zmqabstractnotifier.h"
+#include "zmq/zmqnotificationinterface.h"
+
+#include <univalue.h>
+
+UniValue getzmqnotifications(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getzmqnotifications\n"
+            "\nReturns information about the active ZeroMQ notifications.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"type\": \"pubhashtx\",     (string) Type of notification\n"
+            "    \"address\": \"...\",        (string) Address of the publisher\n"
+            "    \"queued\": n,             (numeric) Messages waiting for the send thread\n"
+            "    \"maxqueued\": n,          (numeric) Most messages that were waiting at once\n"
+            "    \"sent\": n,               (numeric) Messages sent\n"
+            "    \"dropped\": n,            (numeric) Messages dropped because the send queue was full (see -zmqsendqueuesize)\n"
+            "    \"failed\": n              (numeric) Messages zmq failed to send\n"
+            "  },\n"
+            "  ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getzmqnotifications", "")
+            + HelpExampleRpc("getzmqnotifications", "")
+        );
+
+    UniValue result(UniValue::VARR);
+    if (pzmqNotificationInterface != NULL) {
+        for (const auto* notifier : pzmqNotificationInterface->GetActiveNotifiers()) {
+            CZMQNotifierStats stats = notifier->GetStats();
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("type", notifier->GetType()));
+            obj.push_back(Pair("address", notifier->GetAddress()));
+            obj.push_back(Pair("queued", stats.nQueued));
+            obj.push_back(Pair("maxqueued", stats.nMaxQueued));
+            obj.push_back(Pair("sent", stats.nSent));
+            obj.push_back(Pair("dropped", stats.nDropped));
+            obj.push_back(Pair("failed", stats.nFailed));
+            result.push_back(obj);
+        }
+    }
+
+    return result;
+}
+
+static const CRPCCommand commands[] =
+{ //  category              name                      actor (function)         okSafeMode
+  //  --------------------- ------------------------  -----------------------  ----------
+    { "zmq",                "getzmqnotifications",    &getzmqnotifications,    true,  {} },
+};
+
+void RegisterZMQRPCCommands(CRPCTable& t)
+{
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
+        t.appendCommand(commands[vcidx].name, &commands[vcidx]);
+}